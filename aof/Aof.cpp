@@ -0,0 +1,543 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Aof.hpp"
+#include "components/AofFormat.hpp"
+#include "components/AofRecord.hpp"
+#include "../command-executor/CommandExecutor.hpp"
+#include "../rdb/Rdb.hpp"
+#include "../response/types/ErrResponse.hpp"
+#include "../utils/file_utils.hpp"
+#include "../utils/intrusive_data_structure_utils.hpp"
+#include "../utils/log.hpp"
+#include "../utils/proc_utils.hpp"
+#include "../utils/time_utils.hpp"
+
+/**
+ * Writes all of a buffer to a file.
+ * 
+ * @param fd    The file.
+ * @param data  Pointer to the bytes.
+ * @param n     The number of bytes.
+ * 
+ * @return  The number of bytes written, less than n if a write failed.
+ */
+size_t write_all(int fd, const char *data, size_t n) {
+    size_t pos = 0;
+    while (pos < n) {
+        ssize_t written = write(fd, data + pos, n - pos);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        pos += written;
+    }
+    return pos;
+}
+
+/* Argument for the append_entry() callback */
+struct AppendEntryArg {
+    Buffer buf;
+    time_t now_ms;
+    int fd;
+    bool ok;
+};
+
+/**
+ * Callback which appends the records that recreate an Entry, skipping it if its TTL has passed. The records are written 
+ * out in chunks, so a big kv store is never buffered all at once.
+ * 
+ * @param node  The HNode contained by the Entry.
+ * @param arg   Void pointer to an AppendEntryArg.
+ */
+void append_entry(HNode *node, void *arg) {
+    AppendEntryArg *append_arg = (AppendEntryArg *) arg;
+    Entry *entry = container_of(node, Entry, node);
+    if (!append_arg->ok || entry->ttl_timer.is_expired(append_arg->now_ms)) {
+        return;
+    }
+
+    append_entry_records(append_arg->buf, entry);
+    if (append_arg->buf.size() >= Aof::REWRITE_CHUNK_SIZE) {
+        size_t n = append_arg->buf.size();
+        append_arg->ok = write_all(append_arg->fd, append_arg->buf.data(), n) == n;
+        append_arg->buf.consume(n);
+    }
+}
+
+Aof &Aof::shared() {
+    static Aof aof;
+    return aof;
+}
+
+void Aof::fsync_task(void *arg) {
+    Aof *aof = (Aof *) arg;
+    if (fdatasync(aof->fd) == -1) {
+        log("failed to fsync append-only file: %s", strerror(errno));
+    }
+    aof->fsync_in_progress = false;
+}
+
+void Aof::wait_for_fsync() {
+    while (fsync_in_progress) {
+        usleep(100);
+    }
+}
+
+bool Aof::open_file() {
+    fd = open(filename.data(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd == -1) {
+        log("failed to open append-only file '%s': %s", filename.data(), strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    stats.size = st.st_size;
+    stats.base_size = st.st_size;
+    last_fsync_ms = get_time_ms();
+    return true;
+}
+
+void Aof::append_record(const std::vector<std::string> &command) {
+    append_aof_record(buf, command);
+    if (rewrite_child_pid != -1) {
+        append_aof_record(rewrite_buf, command);
+    }
+}
+
+bool Aof::write_dataset(HMap &kv_store, int fd, bool preamble) {
+    if (preamble) {
+        // the length goes in the header once the snapshot is written
+        char header[AOF_PREAMBLE_HEADER_SIZE] = {};
+        memcpy(header, AOF_PREAMBLE_MAGIC, AOF_PREAMBLE_MAGIC_LEN);
+        uint64_t preamble_len;
+        if (write_all(fd, header, sizeof(header)) != sizeof(header) || 
+            !Rdb::write_snapshot(kv_store, fd, &preamble_len)) {
+            return false;
+        }
+        memcpy(header + AOF_PREAMBLE_MAGIC_LEN, &preamble_len, sizeof(preamble_len));
+        return pwrite(fd, header, sizeof(header), 0) == sizeof(header);
+    }
+
+    AppendEntryArg arg;
+    arg.now_ms = get_cached_time_ms();
+    arg.fd = fd;
+    arg.ok = true;
+    kv_store.for_each(append_entry, &arg);
+
+    size_t n = arg.buf.size();
+    return arg.ok && write_all(fd, arg.buf.data(), n) == n;
+}
+
+bool Aof::load(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor) {
+    int read_fd = open(filename.data(), O_RDONLY);
+    if (read_fd == -1 && errno != ENOENT) {
+        log("failed to open append-only file '%s': %s", filename.data(), strerror(errno));
+        return false;
+    }
+
+    const char *data = NULL;
+    size_t len = 0;
+    if (read_fd != -1) {
+        struct stat st;
+        fstat(read_fd, &st);
+        len = st.st_size;
+        void *map = len > 0 ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, read_fd, 0) : NULL;
+        close(read_fd);
+        if (map == MAP_FAILED) {
+            log("failed to map append-only file '%s': %s", filename.data(), strerror(errno));
+            return false;
+        }
+        data = (const char *) map;
+        madvise(map, len, MADV_WILLNEED);
+    }
+
+    bool ok = replay(data, len, kv_store, timers, thread_pool, evictor);
+    if (data != NULL) {
+        munmap((void *) data, len);
+    }
+    return ok && open_file();
+}
+
+bool Aof::replay(const char *data, size_t len, HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, 
+                 Evictor &evictor) {
+    size_t pos = 0;
+    if (len >= AOF_PREAMBLE_HEADER_SIZE && memcmp(data, AOF_PREAMBLE_MAGIC, AOF_PREAMBLE_MAGIC_LEN) == 0) {
+        uint64_t preamble_len;
+        memcpy(&preamble_len, data + AOF_PREAMBLE_MAGIC_LEN, sizeof(preamble_len));
+        if (preamble_len > len - AOF_PREAMBLE_HEADER_SIZE || 
+            !Rdb::load_snapshot(data + AOF_PREAMBLE_HEADER_SIZE, preamble_len, kv_store, timers, evictor)) {
+            log("append-only file '%s' has a corrupt snapshot preamble", filename.data());
+            return false;
+        }
+        pos = AOF_PREAMBLE_HEADER_SIZE + preamble_len;
+    }
+
+    time_t start_ms = get_time_ms();
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    loading = true;
+    uint64_t replayed = 0, failed = 0;
+    std::vector<std::string> command;
+    while (pos < len) {
+        AofRecordStatus status = read_aof_record(data, len, &pos, &command);
+        if (status == AofRecordStatus::INCOMPLETE) {
+            log("append-only file '%s' ends with a partial record, cutting off its last %lu bytes", filename.data(), 
+                len - pos);
+            if (truncate(filename.data(), pos) == -1) {
+                log("failed to truncate append-only file: %s", strerror(errno));
+                loading = false;
+                return false;
+            }
+            break;
+        } else if (status == AofRecordStatus::CORRUPT) {
+            log("append-only file '%s' is corrupt at offset %lu", filename.data(), pos);
+            loading = false;
+            return false;
+        }
+
+        // commands that normally run in the background are run in place, in log order
+        std::unique_ptr<Response> response = executor.execute_now(command);
+        if (dynamic_cast<ErrResponse *>(response.get()) != NULL) {
+            failed++;
+        }
+        replayed++;
+    }
+    loading = false;
+
+    if (failed > 0) {
+        log("%lu commands from the append-only file failed when replayed", failed);
+    }
+    log("replayed %lu commands from '%s' in %ld ms", replayed, filename.data(), get_time_ms() - start_ms);
+    return true;
+}
+
+/* Argument for write_dataset_cb() and rewrite_child() */
+struct DatasetArg {
+    HMap *kv_store;
+    bool preamble;
+    const std::string *path;
+};
+
+bool Aof::write_dataset_cb(int fd, void *arg) {
+    DatasetArg *dataset_arg = (DatasetArg *) arg;
+    return write_dataset(*dataset_arg->kv_store, fd, dataset_arg->preamble);
+}
+
+bool Aof::rewrite_child(void *arg) {
+    DatasetArg *dataset_arg = (DatasetArg *) arg;
+    int fd = open(dataset_arg->path->data(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd != -1 && write_dataset(*dataset_arg->kv_store, fd, dataset_arg->preamble) && fsync(fd) == 0;
+    if (!ok) {
+        log("bgrewriteaof: failed to write '%s': %s", dataset_arg->path->data(), strerror(errno));
+    }
+    return ok;
+}
+
+bool Aof::start(HMap &kv_store) {
+    if (fd != -1) {
+        return true;
+    }
+
+    DatasetArg arg = { &kv_store, use_rdb_preamble, &filename };
+    if (!write_file_atomically(filename, write_dataset_cb, &arg)) {
+        log("failed to write append-only file '%s': %s", filename.data(), strerror(errno));
+        return false;
+    }
+
+    log("started append-only file '%s' with %u keys", filename.data(), kv_store.length());
+    return open_file();
+}
+
+void Aof::stop() {
+    if (fd == -1) {
+        return;
+    }
+
+    cancel_rewrite();
+    wait_for_fsync();
+    if (write_all(fd, buf.data(), buf.size()) != buf.size() || fsync(fd) == -1) {
+        log("failed to write append-only file before stopping it: %s", strerror(errno));
+    }
+    buf.reset();
+    close(fd);
+    fd = -1;
+    unsynced = false;
+    log("stopped append-only file");
+}
+
+bool Aof::is_enabled() {
+    return fd != -1;
+}
+
+void Aof::feed(const std::vector<std::string> &command) {
+    if (fd == -1 || loading) {
+        return;
+    }
+    append_record(command);
+}
+
+void Aof::feed_entry(const std::string &key, Entry *entry) {
+    if (fd == -1 || loading) {
+        return;
+    }
+    append_record({ "del", key });
+    if (entry != NULL) {
+        append_entry_records(buf, entry);
+        if (rewrite_child_pid != -1) {
+            append_entry_records(rewrite_buf, entry);
+        }
+    }
+}
+
+void Aof::flush(ThreadPool &thread_pool) {
+    if (fd == -1) {
+        return;
+    }
+
+    time_t now_ms = get_time_ms();
+    if (buf.size() > 0) {
+        size_t n = buf.size();
+        size_t written = write_all(fd, buf.data(), n);
+        buf.consume(written);
+        stats.size += written;
+        stats.writes++;
+        stats.last_write_ok = written == n;
+
+        if (written < n) {
+            if (fsync_policy == AofFsync::ALWAYS) {
+                // the replies being held back would acknowledge writes that aren't on disk
+                fatal("failed to write append-only file with appendfsync always: %s", strerror(errno));
+            }
+            log("failed to write append-only file, %lu bytes left to retry: %s", n - written, strerror(errno));
+        } else {
+            buf.release();
+        }
+
+        if (fsync_policy == AofFsync::ALWAYS) {
+            wait_for_fsync();
+            if (fdatasync(fd) == -1) {
+                fatal("failed to fsync append-only file with appendfsync always: %s", strerror(errno));
+            }
+            stats.fsyncs++;
+            last_fsync_ms = now_ms;
+        } else {
+            unsynced = unsynced || written > 0;
+        }
+    }
+
+    if (fsync_policy == AofFsync::EVERYSEC && unsynced && now_ms - last_fsync_ms >= EVERYSEC_INTERVAL_MS) {
+        if (fsync_in_progress) {
+            stats.delayed_fsyncs++;
+            return;
+        }
+        fsync_in_progress = true;
+        unsynced = false;
+        last_fsync_ms = now_ms;
+        stats.fsyncs++;
+        thread_pool.add_task({ &fsync_task, (void *) this });
+    }
+}
+
+bool Aof::needs_flush() {
+    return fd != -1 && (buf.size() > 0 || (fsync_policy == AofFsync::EVERYSEC && unsynced));
+}
+
+bool Aof::holds_replies() {
+    return fd != -1 && fsync_policy == AofFsync::ALWAYS && buf.size() > 0;
+}
+
+bool Aof::bgrewrite(HMap &kv_store) {
+    if (fd == -1) {
+        log("bgrewriteaof: append-only file is off");
+        return false;
+    } else if (rewrite_child_pid != -1) {
+        log("bgrewriteaof: rewrite already in progress");
+        return false;
+    }
+
+    last_rewrite_try_ms = get_time_ms();
+    rewrite_path = filename + ".rewrite-" + std::to_string(getpid());
+    DatasetArg arg = { &kv_store, use_rdb_preamble, &rewrite_path };
+    pid_t pid = fork_child(rewrite_child, &arg);
+    if (pid == -1) {
+        log("bgrewriteaof: failed to fork: %s", strerror(errno));
+        stats.last_rewrite_ok = false;
+        return false;
+    }
+
+    rewrite_child_pid = pid;
+    rewrite_start_ms = get_time_ms();
+    stats.rewrite_in_progress = true;
+    log("bgrewriteaof: started child %d", pid);
+    return true;
+}
+
+void Aof::finish_rewrite(bool ok) {
+    rewrite_child_pid = -1;
+    ok = ok && install_rewrite();
+    if (!ok) {
+        unlink(rewrite_path.data());
+    }
+    rewrite_buf.reset();
+
+    stats.rewrite_in_progress = false;
+    stats.last_rewrite_ok = ok;
+    stats.last_rewrite_ms = get_time_ms() - rewrite_start_ms;
+    if (ok) {
+        stats.rewrites++;
+    }
+    log("bgrewriteaof: %s in %ld ms, file is now %lu bytes", ok ? "done" : "failed", stats.last_rewrite_ms, 
+        stats.size);
+}
+
+bool Aof::install_rewrite() {
+    int new_fd = open(rewrite_path.data(), O_WRONLY | O_APPEND);
+    if (new_fd == -1) {
+        log("bgrewriteaof: failed to open '%s': %s", rewrite_path.data(), strerror(errno));
+        return false;
+    }
+
+    // blocks the event loop, but only for the writes made while the child ran
+    size_t n = rewrite_buf.size();
+    if (write_all(new_fd, rewrite_buf.data(), n) != n || fdatasync(new_fd) == -1 || 
+        rename(rewrite_path.data(), filename.data()) == -1) {
+        log("bgrewriteaof: failed to install '%s': %s", rewrite_path.data(), strerror(errno));
+        close(new_fd);
+        return false;
+    }
+
+    // every record still waiting to be written is either in the child's file or in the rewrite buffer
+    wait_for_fsync();
+    close(fd);
+    fd = new_fd;
+    buf.reset();
+    unsynced = false;
+
+    struct stat st;
+    fstat(fd, &st);
+    stats.size = st.st_size;
+    stats.base_size = st.st_size;
+    last_fsync_ms = get_time_ms();
+    return true;
+}
+
+void Aof::cancel_rewrite() {
+    if (rewrite_child_pid == -1) {
+        return;
+    }
+
+    kill(rewrite_child_pid, SIGKILL);
+    waitpid(rewrite_child_pid, NULL, 0);
+    log("bgrewriteaof: cancelled child %d", rewrite_child_pid);
+    rewrite_child_pid = -1;
+    unlink(rewrite_path.data());
+    rewrite_buf.reset();
+    stats.rewrite_in_progress = false;
+}
+
+void Aof::cron(HMap &kv_store) {
+    if (rewrite_child_pid != -1) {
+        ChildState state = reap_child(rewrite_child_pid, "bgrewriteaof");
+        if (state != ChildState::RUNNING) {
+            finish_rewrite(state == ChildState::SUCCEEDED);
+        }
+        return;
+    }
+
+    if (fd == -1 || auto_rewrite_percentage == 0 || stats.size < auto_rewrite_min_size || 
+        stats.size <= stats.base_size) {
+        return;
+    }
+    if (!stats.last_rewrite_ok && get_time_ms() - last_rewrite_try_ms < REWRITE_RETRY_MS) {
+        return;
+    }
+
+    uint64_t base_size = stats.base_size > 0 ? stats.base_size : 1;
+    uint64_t growth = (stats.size - stats.base_size) * 100 / base_size;
+    if (growth >= auto_rewrite_percentage) {
+        log("append-only file grew by %lu%% to %lu bytes, rewriting", growth, stats.size);
+        bgrewrite(kv_store);
+    }
+}
+
+bool Aof::needs_cron() {
+    return rewrite_child_pid != -1;
+}
+
+void Aof::set_auto_rewrite_percentage(uint32_t percentage) {
+    auto_rewrite_percentage = percentage;
+}
+
+uint32_t Aof::get_auto_rewrite_percentage() {
+    return auto_rewrite_percentage;
+}
+
+void Aof::set_auto_rewrite_min_size(uint64_t size) {
+    auto_rewrite_min_size = size;
+}
+
+uint64_t Aof::get_auto_rewrite_min_size() {
+    return auto_rewrite_min_size;
+}
+
+void Aof::set_use_rdb_preamble(bool use) {
+    use_rdb_preamble = use;
+}
+
+bool Aof::get_use_rdb_preamble() {
+    return use_rdb_preamble;
+}
+
+void Aof::set_fsync_policy(AofFsync policy) {
+    fsync_policy = policy;
+}
+
+AofFsync Aof::get_fsync_policy() {
+    return fsync_policy;
+}
+
+bool Aof::parse_fsync_policy(const std::string &name, AofFsync *policy) {
+    if (name == "always") {
+        *policy = AofFsync::ALWAYS;
+    } else if (name == "everysec") {
+        *policy = AofFsync::EVERYSEC;
+    } else if (name == "no") {
+        *policy = AofFsync::NO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *Aof::fsync_policy_name(AofFsync policy) {
+    switch (policy) {
+        case AofFsync::ALWAYS:
+            return "always";
+        case AofFsync::EVERYSEC:
+            return "everysec";
+        default:
+            return "no";
+    }
+}
+
+void Aof::set_filename(const std::string &filename) {
+    this->filename = filename;
+}
+
+const std::string &Aof::get_filename() {
+    return filename;
+}
+
+const AofStats &Aof::get_stats() {
+    return stats;
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "../buffer/Buffer.hpp"
+#include "../entry/Entry.hpp"
+#include "../evictor/Evictor.hpp"
+#include "../hashmap/HMap.hpp"
+#include "../thread-pool/ThreadPool.hpp"
+#include "../timers/TimerManager.hpp"
+
+/* When the append-only file is synced to disk */
+enum class AofFsync {
+    ALWAYS, // after every write, before the replies to the logged commands are sent
+    EVERYSEC, // at most once a second, on a thread pool worker
+    NO // whenever the operating system flushes it
+};
+
+/* Stats for the append-only file */
+struct AofStats {
+    uint64_t size = 0; // bytes in the file
+    uint64_t writes = 0; // write() calls, at most one per event loop iteration
+    uint64_t fsyncs = 0;
+    uint64_t delayed_fsyncs = 0; // everysec fsyncs put off because the previous one was still running
+    bool last_write_ok = true;
+    uint64_t base_size = 0; // size of the file after it was last started, loaded, or rewritten
+    bool rewrite_in_progress = false;
+    uint64_t rewrites = 0; // successful rewrites
+    bool last_rewrite_ok = true;
+    time_t last_rewrite_ms = 0; // how long the last rewrite took
+};
+
+/**
+ * Append-only file: logs every write command so that the kv store can be rebuilt by replaying them at startup.
+ * 
+ * Commands are logged after they succeed, rewritten where needed so replaying them gives the same result later (e.g. 
+ * relative expiries become absolute). They are buffered and written with a single write() per event loop iteration 
+ * (group commit), then synced according to the fsync policy. Under ALWAYS, replies to the commands of an iteration are 
+ * held back until the write and fsync are done, so an acknowledged write is never lost.
+ * 
+ * Since the file only grows, it is rewritten in the background once it has grown by a percentage since the last 
+ * rewrite. A forked child writes the kv store as it was at the fork, while the parent keeps logging to the old file and 
+ * also copies new records to a rewrite buffer. Once the child exits, the rewrite buffer is appended to the new file, 
+ * which is then renamed over the old one.
+ * 
+ * The kv store is written as a snapshot preamble (see AofFormat.hpp), which loads as fast as a snapshot, or, with the 
+ * preamble turned off, as the smallest set of commands that recreates it (one set or a few zadds per key). Either way, 
+ * only the commands logged since the last rewrite are replayed one by one at startup. Every record has a checksum, so a 
+ * record torn by a crash is cut off, while damage anywhere else stops the load.
+ */
+class Aof {
+    private:
+        std::string filename = "appendonly.aof";
+        AofFsync fsync_policy = AofFsync::EVERYSEC;
+        bool use_rdb_preamble = true; // whether the file starts with a snapshot of the kv store instead of commands
+        int fd = -1; // the file, -1 if the AOF is off
+        Buffer buf; // records not yet written to the file
+        bool loading = false; // whether the file is being replayed, so the commands aren't logged again
+        bool unsynced = false; // whether written records haven't been fsynced yet
+        time_t last_fsync_ms = 0;
+        std::atomic<bool> fsync_in_progress{false}; // whether an everysec fsync is running on a worker
+        AofStats stats;
+
+        uint32_t auto_rewrite_percentage = 100; // growth over the base size that triggers a rewrite, 0 to disable
+        uint64_t auto_rewrite_min_size = 64 * 1024 * 1024; // the file is never rewritten automatically below this size
+        pid_t rewrite_child_pid = -1; // rewrite child, -1 if there is none
+        std::string rewrite_path; // file the rewrite child writes to
+        Buffer rewrite_buf; // records logged since the rewrite child was forked
+        time_t rewrite_start_ms = 0;
+        time_t last_rewrite_try_ms = 0;
+
+        /**
+         * Thread pool task which fsyncs the file.
+         * 
+         * @param arg   Void pointer to the Aof.
+         */
+        static void fsync_task(void *arg);
+
+        /* Blocks until a running everysec fsync is done */
+        void wait_for_fsync();
+
+        /**
+         * Loads the contents of the file into the kv store: the snapshot preamble if there is one, then the records.
+         * 
+         * @param data          Pointer to the contents of the file.
+         * @param len           Length of the file.
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool.
+         * @param evictor       Reference to the evictor.
+         * 
+         * @return  True on success, including when a partial last record was cut off.
+         *          False if the file is corrupt.
+         */
+        bool replay(const char *data, size_t len, HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, 
+                    Evictor &evictor);
+
+        /* Opens the file for appending, creating it if it doesn't exist */
+        bool open_file();
+
+        /**
+         * Appends a record to the records waiting to be written, and to the rewrite buffer if a rewrite is running.
+         * 
+         * @param command   The command, broken up into its individual strings.
+         */
+        void append_record(const std::vector<std::string> &command);
+
+        /**
+         * Writes the kv store as it is now to the start of an empty file, as a snapshot preamble or as the commands that 
+         * recreate it. Expired keys are skipped.
+         * 
+         * Only reads the kv store, so it's safe to call from a forked child.
+         * 
+         * @param kv_store  Reference to the kv store.
+         * @param fd        The file.
+         * @param preamble  Whether to write a snapshot preamble.
+         * 
+         * @return  True on success.
+         *          False if a write failed.
+         */
+        static bool write_dataset(HMap &kv_store, int fd, bool preamble);
+
+        /* Callback for write_file_atomically() that writes the kv store with write_dataset() */
+        static bool write_dataset_cb(int fd, void *arg);
+
+        /* Task for the rewrite child: writes the kv store as of the fork, i.e. everything logged before it */
+        static bool rewrite_child(void *arg);
+
+        /**
+         * Handles the rewrite child exiting. If it wrote the new file, the rewrite buffer is appended to it and it 
+         * replaces the old file.
+         * 
+         * @param ok    Whether the child wrote the new file.
+         */
+        void finish_rewrite(bool ok);
+
+        /* Appends the rewrite buffer to the file written by the rewrite child, then swaps it in for the old file */
+        bool install_rewrite();
+
+        /* Kills a running rewrite child and throws away its file */
+        void cancel_rewrite();
+    public:
+        static const uint32_t CRON_INTERVAL_MS = 100; // how often flush() and cron() should run while busy
+        static const uint32_t EVERYSEC_INTERVAL_MS = 1000;
+        static const uint32_t REWRITE_RETRY_MS = 5000; // wait before an automatic rewrite is retried after a failure
+        static const uint32_t REWRITE_CHUNK_SIZE = 1024 * 1024; // bytes of records buffered before writing them out
+
+        /* Returns the Aof used by the event loop */
+        static Aof &shared();
+
+        /**
+         * Loads the file into the kv store, then starts logging to it. Called at startup instead of loading the 
+         * snapshot. A snapshot preamble is loaded in parallel like a snapshot file, then the records after it are 
+         * replayed. If the file ends partway through a record or its last record fails its checksum, e.g. because the 
+         * server died while writing it, the partial record is cut off.
+         * 
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool.
+         * @param evictor       Reference to the evictor.
+         * 
+         * @return  True if the file was replayed or doesn't exist.
+         *          False if it's corrupt or can't be opened.
+         */
+        bool load(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor);
+
+        /**
+         * Turns the AOF on at runtime. The file is replaced by the commands that recreate the kv store as it is now, so 
+         * that replaying it gives back everything rather than only the writes made from now on.
+         * 
+         * @param kv_store  Reference to the kv store.
+         * 
+         * @return  True on success.
+         *          False if the file couldn't be written.
+         */
+        bool start(HMap &kv_store);
+
+        /* Turns the AOF off, writing and syncing what has been logged so far. A running rewrite is cancelled. */
+        void stop();
+
+        /* Returns whether the AOF is on */
+        bool is_enabled();
+
+        /**
+         * Logs a command. Does nothing while the AOF is off or being replayed.
+         * 
+         * @param command   The command, broken up into its individual strings.
+         */
+        void feed(const std::vector<std::string> &command);
+
+        /**
+         * Logs the commands that recreate an Entry as it is now, replacing whatever was at its key.
+         * 
+         * @param key   The key.
+         * @param entry Pointer to the Entry, NULL if the key doesn't exist anymore.
+         */
+        void feed_entry(const std::string &key, Entry *entry);
+
+        /**
+         * Writes the logged commands to the file, then syncs it according to the fsync policy. Called once per event 
+         * loop iteration.
+         * 
+         * @param thread_pool   Reference to the thread pool, to run everysec fsyncs on.
+         */
+        void flush(ThreadPool &thread_pool);
+
+        /* Returns whether flush() has work to do: commands to write or an everysec fsync to run */
+        bool needs_flush();
+
+        /* Returns whether replies must wait for the next flush() before being sent */
+        bool holds_replies();
+
+        /**
+         * Starts rewriting the file in a forked child. cron() finishes the rewrite once the child exits.
+         * 
+         * @param kv_store  Reference to the kv store.
+         * 
+         * @return  True if the child was started.
+         *          False if the AOF is off, a rewrite is already in progress, or the fork failed.
+         */
+        bool bgrewrite(HMap &kv_store);
+
+        /**
+         * Finishes a rewrite whose child has exited, then starts a rewrite if the file has grown by the auto rewrite 
+         * percentage since the last one. Called from the event loop.
+         * 
+         * @param kv_store  Reference to the kv store.
+         */
+        void cron(HMap &kv_store);
+
+        /* Returns whether cron() has a rewrite child to wait for */
+        bool needs_cron();
+
+        /* Sets the growth over the base size, in percent, that triggers an automatic rewrite. 0 disables them. */
+        void set_auto_rewrite_percentage(uint32_t percentage);
+
+        /* Returns the growth over the base size, in percent, that triggers an automatic rewrite */
+        uint32_t get_auto_rewrite_percentage();
+
+        /* Sets the size in bytes below which the file is never rewritten automatically */
+        void set_auto_rewrite_min_size(uint64_t size);
+
+        /* Returns the size in bytes below which the file is never rewritten automatically */
+        uint64_t get_auto_rewrite_min_size();
+
+        /* Sets whether the file is started and rewritten with a snapshot preamble */
+        void set_use_rdb_preamble(bool use);
+
+        /* Returns whether the file is started and rewritten with a snapshot preamble */
+        bool get_use_rdb_preamble();
+
+        /* Sets the fsync policy */
+        void set_fsync_policy(AofFsync policy);
+
+        /* Returns the fsync policy */
+        AofFsync get_fsync_policy();
+
+        /**
+         * Parses the name of an fsync policy.
+         * 
+         * @param name      The name: "always", "everysec", or "no".
+         * @param policy    Pointer to store the policy in.
+         * 
+         * @return  True on success.
+         *          False if the name isn't a policy.
+         */
+        static bool parse_fsync_policy(const std::string &name, AofFsync *policy);
+
+        /* Returns the name of an fsync policy */
+        static const char *fsync_policy_name(AofFsync policy);
+
+        /* Sets the path of the file. Only takes effect the next time the AOF is turned on. */
+        void set_filename(const std::string &filename);
+
+        /* Returns the path of the file */
+        const std::string &get_filename();
+
+        /* Returns the stats for the append-only file */
+        const AofStats &get_stats();
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Layout of an append-only file with a snapshot preamble:
+ * +------------+----------------------+------------------------------+--------+-----+
+ * | magic (5B) | preamble length (8B) | snapshot (see RdbFormat.hpp) | record | ... |
+ * +------------+----------------------+------------------------------+--------+-----+
+ * 
+ * The preamble is a whole snapshot, with its section index and checksums, whose offsets are relative to its own start. 
+ * It holds the kv store as of the last time the file was started or rewritten, and the records that follow (see 
+ * AofRecord.hpp) are the commands logged since. A file without the magic is records only.
+ */
+
+static const char AOF_PREAMBLE_MAGIC[] = "MYAOF";
+static const uint32_t AOF_PREAMBLE_MAGIC_LEN = 5;
+static const uint32_t AOF_PREAMBLE_HEADER_SIZE = AOF_PREAMBLE_MAGIC_LEN + sizeof(uint64_t);
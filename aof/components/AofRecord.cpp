@@ -0,0 +1,128 @@
+#include <cstdio>
+#include <cstring>
+
+#include "AofRecord.hpp"
+#include "../../utils/buf_utils.hpp"
+#include "../../utils/checksum_utils.hpp"
+#include "../../utils/time_utils.hpp"
+
+void append_aof_record(Buffer &buf, const std::vector<std::string> &command) {
+    uint32_t len = sizeof(uint32_t);
+    for (const std::string &str : command) {
+        len += sizeof(uint32_t) + str.length();
+    }
+
+    size_t start = buf.size();
+    buf.append_uint32(len);
+    buf.append_uint32(crc32_update(0, &len, sizeof(len)));
+    buf.append_uint32(0); // CRC-32, filled in once the rest of the record is in place
+    buf.append_uint32(command.size());
+    for (const std::string &str : command) {
+        buf.append_uint32(str.length());
+        buf.append(str.data(), str.length());
+    }
+
+    char *record = buf.data() + start;
+    uint32_t crc = crc32_update(0, record + AOF_RECORD_HEADER_SIZE, len);
+    memcpy(record + 2 * sizeof(uint32_t), &crc, sizeof(crc));
+}
+
+/**
+ * Formats a score so that parsing it gives back the exact same double.
+ * 
+ * @param score The score.
+ * 
+ * @return  The formatted score.
+ */
+std::string format_score(double score) {
+    char str[32];
+    snprintf(str, sizeof(str), "%.17g", score);
+    return str;
+}
+
+/* Argument for the append_pair() callback */
+struct AppendPairArg {
+    Buffer *buf;
+    std::vector<std::string> command; // zadd being built
+};
+
+/* Callback which adds a sorted set pair to a zadd, appending the zadd once it is full */
+void append_pair(const SPairView &pair, void *arg) {
+    AppendPairArg *append_arg = (AppendPairArg *) arg;
+    append_arg->command.push_back(format_score(pair.score));
+    append_arg->command.push_back(std::string(pair.name, pair.len));
+
+    if (append_arg->command.size() == 2 + 2 * AOF_PAIRS_PER_COMMAND) {
+        append_aof_record(*append_arg->buf, append_arg->command);
+        append_arg->command.resize(2);
+    }
+}
+
+void append_entry_records(Buffer &buf, Entry *entry) {
+    if (entry->type == EntryType::STR) {
+        append_aof_record(buf, { "set", entry->key, std::string(entry->str.data(), entry->str.size()) });
+    } else {
+        AppendPairArg arg = { &buf, { "zadd", entry->key } };
+        entry->zset.for_each(append_pair, &arg);
+        if (arg.command.size() > 2) {
+            append_aof_record(buf, arg.command);
+        }
+    }
+
+    if (entry->ttl_timer.is_expiry_set()) {
+        time_t expiry_unix_ms = monotonic_to_unix_ms(entry->ttl_timer.expiry_time_ms);
+        append_aof_record(buf, { "pexpireat", entry->key, std::to_string(expiry_unix_ms) });
+    }
+}
+
+AofRecordStatus read_aof_record(const char *data, size_t len, size_t *pos, std::vector<std::string> *command) {
+    if (len - *pos < AOF_RECORD_HEADER_SIZE) {
+        return AofRecordStatus::INCOMPLETE;
+    }
+
+    // a whole header with a bad length isn't a torn write, and trusting the length could cut valid records off the end
+    char *src = (char *) data + *pos;
+    uint32_t record_len, len_crc, crc;
+    read_uint32(&record_len, &src);
+    read_uint32(&len_crc, &src);
+    read_uint32(&crc, &src);
+    if (crc32_update(0, &record_len, sizeof(record_len)) != len_crc) {
+        return AofRecordStatus::CORRUPT;
+    }
+    if (len - *pos - AOF_RECORD_HEADER_SIZE < record_len) {
+        return AofRecordStatus::INCOMPLETE;
+    }
+
+    // a bad last record is most likely a write cut short by a crash, anywhere else the file has been damaged
+    char *end = src + record_len;
+    if (crc32_update(0, src, record_len) != crc) {
+        return end == data + len ? AofRecordStatus::INCOMPLETE : AofRecordStatus::CORRUPT;
+    }
+
+    // every string must fit in the record, and the record must be exactly its strings
+    uint32_t num_strs;
+    if (record_len < sizeof(uint32_t)) {
+        return AofRecordStatus::CORRUPT;
+    }
+    read_uint32(&num_strs, &src);
+
+    command->clear();
+    for (uint32_t i = 0; i < num_strs; i++) {
+        uint32_t str_len;
+        if ((size_t) (end - src) < sizeof(uint32_t)) {
+            return AofRecordStatus::CORRUPT;
+        }
+        read_uint32(&str_len, &src);
+        if ((size_t) (end - src) < str_len) {
+            return AofRecordStatus::CORRUPT;
+        }
+        command->emplace_back(src, str_len);
+        src += str_len;
+    }
+    if (src != end || num_strs == 0) {
+        return AofRecordStatus::CORRUPT;
+    }
+
+    *pos = end - data;
+    return AofRecordStatus::OK;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../buffer/Buffer.hpp"
+#include "../../entry/Entry.hpp"
+
+/**
+ * Layout of a record of the append-only file, one per logged command:
+ * +-------------+--------------------+-------------+------------------+--------------------+--------+-----+
+ * | length (4B) | length CRC-32 (4B) | CRC-32 (4B) | num strings (4B) | string length (4B) | string | ... |
+ * +-------------+--------------------+-------------+------------------+--------------------+--------+-----+
+ * 
+ * The length and the CRC-32 cover everything after the header. The length has a CRC-32 of its own, so a damaged length 
+ * is caught before it is used to find the end of the record. Past the checksums, this is the layout of a Request, minus 
+ * its size limit, since a command recreating a key (e.g. a zadd of part of a big sorted set) can be larger than any 
+ * client request.
+ */
+
+static const uint32_t AOF_RECORD_HEADER_SIZE = 3 * sizeof(uint32_t); // length, length CRC-32 and CRC-32
+
+/* Number of sorted set pairs per zadd when recreating a sorted set, so no single record gets too big */
+static const uint32_t AOF_PAIRS_PER_COMMAND = 64;
+
+/* Result of reading a record */
+enum class AofRecordStatus {
+    OK, // a record was read
+    INCOMPLETE, // the data ends partway through a record with a valid length, or the last record fails its checksum, 
+                // e.g. the server died while writing it
+    CORRUPT // the record is malformed, its length fails its checksum, or it fails its checksum with more data after it
+};
+
+/**
+ * Appends a record for a command.
+ * 
+ * @param buf       Reference to the Buffer to append to.
+ * @param command   The command, broken up into its individual strings.
+ */
+void append_aof_record(Buffer &buf, const std::vector<std::string> &command);
+
+/**
+ * Appends the records of the commands that recreate an Entry as it is now: a set or zadds, then a pexpireat if it has 
+ * a TTL.
+ * 
+ * @param buf       Reference to the Buffer to append to.
+ * @param entry     Pointer to the Entry.
+ */
+void append_entry_records(Buffer &buf, Entry *entry);
+
+/**
+ * Reads the record at an offset.
+ * 
+ * @param data      Pointer to the records.
+ * @param len       Length of the records.
+ * @param pos       Pointer to the offset of the record. Moved past it if it was read.
+ * @param command   Pointer to store the command in.
+ * 
+ * @return  The status of the read.
+ */
+AofRecordStatus read_aof_record(const char *data, size_t len, size_t *pos, std::vector<std::string> *command);
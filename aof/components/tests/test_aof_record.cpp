@@ -0,0 +1,212 @@
+#include <assert.h>
+
+#include "../AofRecord.hpp"
+#include "../../../utils/checksum_utils.hpp"
+#include "../../../utils/time_utils.hpp"
+
+/**
+ * Appends a record with the given bytes after its checksums, so malformed records can be built with valid checksums.
+ * 
+ * @param buf   Reference to the Buffer to append to.
+ * @param body  Reference to the bytes.
+ */
+void append_raw_record(Buffer &buf, Buffer &body) {
+    uint32_t len = body.size();
+    buf.append_uint32(len);
+    buf.append_uint32(crc32_update(0, &len, sizeof(len)));
+    buf.append_uint32(crc32_update(0, body.data(), body.size()));
+    buf.append(body.data(), body.size());
+}
+
+/**
+ * Reads every record in a Buffer.
+ * 
+ * @param buf   Reference to the Buffer.
+ * 
+ * @return  Vector containing the commands, in order.
+ */
+std::vector<std::vector<std::string>> read_all(Buffer &buf) {
+    std::vector<std::vector<std::string>> commands;
+    size_t pos = 0;
+    std::vector<std::string> command;
+    while (pos < buf.size()) {
+        assert(read_aof_record(buf.data(), buf.size(), &pos, &command) == AofRecordStatus::OK);
+        commands.push_back(command);
+    }
+    return commands;
+}
+
+void test_round_trip() {
+    Buffer buf;
+    append_aof_record(buf, { "set", "name", "tyler" });
+    append_aof_record(buf, { "del", "" });
+    append_aof_record(buf, { "set", "big", std::string(10000, 'x') });
+
+    std::vector<std::vector<std::string>> commands = read_all(buf);
+    assert(commands.size() == 3);
+    assert((commands[0] == std::vector<std::string>{ "set", "name", "tyler" }));
+    assert((commands[1] == std::vector<std::string>{ "del", "" }));
+    assert(commands[2][2] == std::string(10000, 'x'));
+}
+
+void test_incomplete() {
+    Buffer buf;
+    append_aof_record(buf, { "set", "name", "tyler" });
+    size_t full_len = buf.size();
+    append_aof_record(buf, { "set", "other", "value" });
+
+    // every prefix of the second record is incomplete, and leaves the position at its start
+    for (size_t len = full_len; len < buf.size(); len++) {
+        size_t pos = 0;
+        std::vector<std::string> command;
+        assert(read_aof_record(buf.data(), len, &pos, &command) == AofRecordStatus::OK);
+        assert(pos == full_len);
+        assert(read_aof_record(buf.data(), len, &pos, &command) == AofRecordStatus::INCOMPLETE);
+        assert(pos == full_len);
+    }
+}
+
+void test_corrupt() {
+    // a string longer than its record
+    Buffer body;
+    body.append_uint32(1);
+    body.append_uint32(100);
+    body.append("abcd", 4);
+    Buffer buf;
+    append_raw_record(buf, body);
+
+    size_t pos = 0;
+    std::vector<std::string> command;
+    assert(read_aof_record(buf.data(), buf.size(), &pos, &command) == AofRecordStatus::CORRUPT);
+    assert(pos == 0);
+
+    // a record with bytes left over after its strings
+    Buffer extra_body;
+    extra_body.append_uint32(1);
+    extra_body.append_uint32(0);
+    extra_body.append("abcd", 4);
+    Buffer extra;
+    append_raw_record(extra, extra_body);
+    assert(read_aof_record(extra.data(), extra.size(), &pos, &command) == AofRecordStatus::CORRUPT);
+
+    // an empty command
+    Buffer empty_body;
+    empty_body.append_uint32(0);
+    Buffer empty;
+    append_raw_record(empty, empty_body);
+    assert(read_aof_record(empty.data(), empty.size(), &pos, &command) == AofRecordStatus::CORRUPT);
+}
+
+void test_checksum() {
+    Buffer buf;
+    append_aof_record(buf, { "set", "name", "tyler" });
+    size_t first_len = buf.size();
+    append_aof_record(buf, { "set", "other", "value" });
+
+    // a damaged last record is taken to be torn by a crash
+    buf.data()[buf.size() - 1] ^= 1;
+    size_t pos = 0;
+    std::vector<std::string> command;
+    assert(read_aof_record(buf.data(), buf.size(), &pos, &command) == AofRecordStatus::OK);
+    assert(read_aof_record(buf.data(), buf.size(), &pos, &command) == AofRecordStatus::INCOMPLETE);
+    assert(pos == first_len);
+
+    // but a damaged record with more after it means the file itself is damaged
+    buf.data()[buf.size() - 1] ^= 1;
+    buf.data()[first_len - 1] ^= 1;
+    pos = 0;
+    assert(read_aof_record(buf.data(), buf.size(), &pos, &command) == AofRecordStatus::CORRUPT);
+    assert(pos == 0);
+}
+
+void test_length_checksum() {
+    Buffer buf;
+    append_aof_record(buf, { "set", "name", "tyler" });
+    size_t first_len = buf.size();
+    append_aof_record(buf, { "set", "other", "value" });
+    size_t last_start = buf.size();
+    append_aof_record(buf, { "set", "last", "value" });
+
+    // a damaged length that runs past the end of the data isn't mistaken for a torn last record
+    buf.data()[first_len + 3] ^= 1;
+    size_t pos = 0;
+    std::vector<std::string> command;
+    assert(read_aof_record(buf.data(), buf.size(), &pos, &command) == AofRecordStatus::OK);
+    assert(read_aof_record(buf.data(), buf.size(), &pos, &command) == AofRecordStatus::CORRUPT);
+    assert(pos == first_len);
+
+    // a whole header with a damaged length is corrupt even in the last record
+    buf.data()[first_len + 3] ^= 1;
+    buf.data()[last_start] ^= 1;
+    assert(read_aof_record(buf.data(), buf.size(), &pos, &command) == AofRecordStatus::OK);
+    assert(read_aof_record(buf.data(), buf.size(), &pos, &command) == AofRecordStatus::CORRUPT);
+    assert(pos == last_start);
+}
+
+void test_entry_records_str() {
+    TimerManager timers;
+    Entry *entry = new Entry();
+    entry->key = "name";
+    entry->str = "tyler";
+
+    Buffer buf;
+    append_entry_records(buf, entry);
+    std::vector<std::vector<std::string>> commands = read_all(buf);
+    assert(commands.size() == 1);
+    assert((commands[0] == std::vector<std::string>{ "set", "name", "tyler" }));
+
+    // a TTL is recreated with an absolute expiry
+    entry->ttl_timer.set_expiry_at(get_cached_time_ms() + 10000, &timers);
+    Buffer ttl_buf;
+    append_entry_records(ttl_buf, entry);
+    commands = read_all(ttl_buf);
+    assert(commands.size() == 2);
+    assert(commands[1][0] == "pexpireat" && commands[1][1] == "name");
+    int64_t expiry = std::stoll(commands[1][2]);
+    assert(expiry > get_unix_time_ms() + 9000 && expiry <= get_unix_time_ms() + 10000);
+
+    entry->ttl_timer.clear_expiry(&timers);
+    delete entry;
+}
+
+void test_entry_records_zset() {
+    Entry *entry = new Entry();
+    entry->key = "myset";
+    entry->type = EntryType::SORTED_SET;
+    for (uint32_t i = 0; i < 150; i++) {
+        std::string name = "name" + std::to_string(i);
+        entry->zset.insert(i + 0.1, name.data(), name.length());
+    }
+
+    Buffer buf;
+    append_entry_records(buf, entry);
+    std::vector<std::vector<std::string>> commands = read_all(buf);
+
+    // split into zadds of at most AOF_PAIRS_PER_COMMAND pairs, in score order, with exact scores
+    assert(commands.size() == 3);
+    assert(commands[0].size() == 2 + 2 * AOF_PAIRS_PER_COMMAND);
+    assert(commands[2].size() == 2 + 2 * (150 - 2 * AOF_PAIRS_PER_COMMAND));
+    uint32_t i = 0;
+    for (const std::vector<std::string> &command : commands) {
+        assert(command[0] == "zadd" && command[1] == "myset");
+        for (uint32_t j = 2; j < command.size(); j += 2, i++) {
+            assert(std::stod(command[j]) == i + 0.1);
+            assert(command[j + 1] == "name" + std::to_string(i));
+        }
+    }
+    assert(i == 150);
+
+    delete entry;
+}
+
+int main() {
+    test_round_trip();
+    test_incomplete();
+    test_corrupt();
+    test_checksum();
+    test_length_checksum();
+    test_entry_records_str();
+    test_entry_records_zset();
+
+    return 0;
+}
@@ -0,0 +1,460 @@
+#include <assert.h>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../Aof.hpp"
+#include "../components/AofFormat.hpp"
+#include "../components/AofRecord.hpp"
+#include "../../command-executor/CommandExecutor.hpp"
+#include "../../utils/hash_utils.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+#include "../../utils/time_utils.hpp"
+
+TimerManager timers;
+ThreadPool thread_pool(2);
+Evictor evictor;
+
+/* Returns a path for an append-only file unique to this process */
+std::string temp_path(const std::string &name) {
+    return "/tmp/test_aof_" + std::to_string(getpid()) + "_" + name + ".aof";
+}
+
+/* Returns the size of a file */
+off_t file_size(const std::string &path) {
+    struct stat st;
+    assert(stat(path.data(), &st) == 0);
+    return st.st_size;
+}
+
+/* Writes bytes to a file, replacing it */
+void write_file(const std::string &path, const char *data, size_t n) {
+    int fd = open(path.data(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd != -1);
+    assert(write(fd, data, n) == (ssize_t) n);
+    close(fd);
+}
+
+/**
+ * Gets the entry stored at a key.
+ * 
+ * @return  Pointer to the entry.
+ *          NULL if the key doesn't exist.
+ */
+Entry *get_entry(HMap &kv_store, const std::string &key) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = key;
+    lookup_entry.node.hval = str_hash(key);
+    HNode *node = kv_store.lookup(&lookup_entry.node, are_entries_equal);
+    return node == NULL ? NULL : container_of(node, Entry, node);
+}
+
+void test_log_and_replay() {
+    std::string path = temp_path("replay");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    assert(aof.start(kv_store));
+    assert(aof.is_enabled());
+
+    executor.execute_now({"set", "name", "tyler", "EX", "100"});
+    executor.execute_now({"set", "gone", "soon"});
+    executor.execute_now({"pexpireat", "gone", "1"});
+    executor.execute_now({"get", "gone"}); // expires the key
+    executor.execute_now({"set", "kept", "value", "PX", "100000"});
+    executor.execute_now({"persist", "kept"});
+    executor.execute_now({"set", "nx", "first"});
+    executor.execute_now({"set", "nx", "second", "NX"}); // not set, so replaying it must not set it either
+    executor.execute_now({"zadd", "set1", "1", "a", "2", "b"});
+    executor.execute_now({"zadd", "set2", "10", "b", "20", "c"});
+    executor.execute_now({"zunionstore", "dest", "2", "set1", "set2"});
+    executor.execute_now({"zadd", "set1", "100", "a"}); // after the union, so it must not change dest when replayed
+    executor.execute_now({"del", "set2"});
+    executor.execute_now({"get", "name"}); // reads aren't logged
+    executor.execute_now({"zadd", "name", "1", "a"}); // neither are failed writes
+    aof.flush(thread_pool);
+    aof.stop();
+    assert(!aof.is_enabled());
+
+    HMap loaded;
+    assert(aof.load(loaded, timers, thread_pool, evictor));
+    assert(aof.is_enabled());
+    aof.stop();
+
+    Entry *name = get_entry(loaded, "name");
+    assert(name != NULL && name->str == "tyler");
+    time_t remaining = name->ttl_timer.expiry_time_ms - get_cached_time_ms();
+    assert(remaining > 90000 && remaining <= 100000);
+
+    Entry *gone = get_entry(loaded, "gone");
+    assert(gone == NULL || gone->ttl_timer.is_expired(get_cached_time_ms()));
+    Entry *kept = get_entry(loaded, "kept");
+    assert(kept != NULL && !kept->ttl_timer.is_expiry_set());
+    assert(get_entry(loaded, "nx")->str == "first");
+    assert(get_entry(loaded, "set2") == NULL);
+
+    double score;
+    Entry *dest = get_entry(loaded, "dest");
+    assert(dest != NULL && dest->zset.length() == 3);
+    assert(dest->zset.lookup("a", 1, &score) && score == 1);
+    assert(dest->zset.lookup("b", 1, &score) && score == 12);
+    Entry *set1 = get_entry(loaded, "set1");
+    assert(set1->zset.lookup("a", 1, &score) && score == 100);
+
+    unlink(path.data());
+}
+
+void test_start_logs_existing_keys() {
+    std::string path = temp_path("start");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    executor.execute_now({"set", "before", "1"});
+    executor.execute_now({"zadd", "myset", "1", "a"});
+
+    assert(aof.start(kv_store));
+    executor.execute_now({"set", "after", "2"});
+    aof.stop();
+
+    HMap loaded;
+    assert(aof.load(loaded, timers, thread_pool, evictor));
+    aof.stop();
+    assert(loaded.length() == 3);
+    assert(get_entry(loaded, "before")->str == "1");
+    assert(get_entry(loaded, "after")->str == "2");
+    assert(get_entry(loaded, "myset")->zset.length() == 1);
+
+    unlink(path.data());
+}
+
+void test_load_truncated_file() {
+    std::string path = temp_path("truncated");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    Buffer buf;
+    append_aof_record(buf, {"set", "name", "tyler"});
+    uint32_t complete_len = buf.size();
+    append_aof_record(buf, {"set", "other", "value"});
+    write_file(path, buf.data(), buf.size() - 3);
+
+    HMap loaded;
+    assert(aof.load(loaded, timers, thread_pool, evictor));
+    aof.stop();
+    assert(loaded.length() == 1);
+    assert(get_entry(loaded, "name")->str == "tyler");
+    assert(file_size(path) == complete_len);
+
+    unlink(path.data());
+}
+
+void test_load_torn_record() {
+    std::string path = temp_path("torn");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    Buffer buf;
+    append_aof_record(buf, {"set", "name", "tyler"});
+    uint32_t complete_len = buf.size();
+    append_aof_record(buf, {"set", "other", "value"});
+    buf.data()[buf.size() - 1] = 0; // e.g. a block of the last write never made it to disk
+    write_file(path, buf.data(), buf.size());
+
+    HMap loaded;
+    assert(aof.load(loaded, timers, thread_pool, evictor));
+    aof.stop();
+    assert(loaded.length() == 1);
+    assert(file_size(path) == complete_len);
+
+    unlink(path.data());
+}
+
+void test_load_corrupt_file() {
+    std::string path = temp_path("corrupt");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    Buffer buf;
+    append_aof_record(buf, {"set", "name", "tyler"});
+    append_aof_record(buf, {"set", "other", "value"});
+    buf.data()[10] ^= 1; // inside the first record
+    write_file(path, buf.data(), buf.size());
+
+    HMap loaded;
+    assert(!aof.load(loaded, timers, thread_pool, evictor));
+    assert(!aof.is_enabled());
+
+    unlink(path.data());
+}
+
+void test_load_corrupt_length() {
+    std::string path = temp_path("corrupt_length");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    Buffer buf;
+    append_aof_record(buf, {"set", "name", "tyler"});
+    uint32_t first_len = buf.size();
+    append_aof_record(buf, {"set", "other", "value"});
+    append_aof_record(buf, {"set", "last", "value"});
+    buf.data()[first_len + 3] ^= 0x10; // the second record's length now runs far past the end of the file
+    write_file(path, buf.data(), buf.size());
+
+    // the valid records after it aren't cut off as if it were a torn last record
+    HMap loaded;
+    assert(!aof.load(loaded, timers, thread_pool, evictor));
+    assert(!aof.is_enabled());
+    assert(file_size(path) == buf.size());
+
+    unlink(path.data());
+}
+
+void test_load_missing_file() {
+    std::string path = temp_path("missing");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    HMap loaded;
+    assert(aof.load(loaded, timers, thread_pool, evictor));
+    assert(loaded.length() == 0);
+    assert(aof.is_enabled()); // the file is created to log to
+    aof.stop();
+
+    unlink(path.data());
+}
+
+void test_group_commit() {
+    std::string path = temp_path("group");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    HMap kv_store;
+    assert(aof.start(kv_store));
+    aof.set_fsync_policy(AofFsync::ALWAYS);
+
+    // every command of an iteration goes out in one write and one fsync, and replies wait for it
+    uint64_t writes = aof.get_stats().writes;
+    uint64_t fsyncs = aof.get_stats().fsyncs;
+    assert(!aof.holds_replies());
+    for (uint32_t i = 0; i < 10; i++) {
+        aof.feed({"set", "key" + std::to_string(i), "value"});
+    }
+    assert(aof.holds_replies());
+    assert(aof.needs_flush());
+    aof.flush(thread_pool);
+    assert(!aof.holds_replies());
+    assert(!aof.needs_flush());
+    assert(aof.get_stats().writes == writes + 1);
+    assert(aof.get_stats().fsyncs == fsyncs + 1);
+    assert((uint64_t) file_size(path) == aof.get_stats().size);
+
+    // everysec writes right away but syncs on a worker once a second has passed
+    aof.set_fsync_policy(AofFsync::EVERYSEC);
+    aof.feed({"set", "name", "tyler"});
+    assert(!aof.holds_replies());
+    aof.flush(thread_pool);
+    assert(aof.get_stats().writes == writes + 2);
+    assert(aof.needs_flush());
+    usleep(Aof::EVERYSEC_INTERVAL_MS * 1000);
+    aof.flush(thread_pool);
+    assert(aof.get_stats().fsyncs == fsyncs + 2);
+    assert(!aof.needs_flush());
+
+    aof.stop();
+    unlink(path.data());
+}
+
+/* Runs cron() until the rewrite child has exited and its file has been installed */
+void wait_for_rewrite(Aof &aof, HMap &kv_store) {
+    while (aof.get_stats().rewrite_in_progress) {
+        usleep(1000);
+        aof.cron(kv_store);
+    }
+}
+
+void test_bgrewrite() {
+    std::string path = temp_path("rewrite");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    assert(!aof.bgrewrite(kv_store)); // nothing to rewrite while the AOF is off
+    assert(aof.start(kv_store));
+
+    for (uint32_t i = 0; i < 100; i++) {
+        executor.execute_now({"set", "counter", std::to_string(i)});
+        executor.execute_now({"zadd", "myset", std::to_string(i), "name" + std::to_string(i % 10)});
+    }
+    executor.execute_now({"set", "deleted", "value"});
+    executor.execute_now({"del", "deleted"});
+    executor.execute_now({"set", "expiring", "value", "EX", "100"});
+    aof.flush(thread_pool);
+    uint64_t old_size = aof.get_stats().size;
+
+    assert(aof.bgrewrite(kv_store));
+    assert(!aof.bgrewrite(kv_store)); // already in progress
+
+    // writes made while the child runs go to the old file and the rewrite buffer, one of them before being flushed
+    executor.execute_now({"set", "during", "rewrite"});
+    aof.flush(thread_pool);
+    executor.execute_now({"zadd", "myset", "1000", "name0"});
+    wait_for_rewrite(aof, kv_store);
+    aof.flush(thread_pool);
+
+    const AofStats &stats = aof.get_stats();
+    assert(stats.last_rewrite_ok);
+    assert(stats.rewrites == 1);
+    assert(stats.size < old_size);
+    assert((uint64_t) file_size(path) == stats.size);
+    assert(stats.base_size <= stats.size);
+    aof.stop();
+
+    HMap loaded;
+    assert(aof.load(loaded, timers, thread_pool, evictor));
+    aof.stop();
+    assert(loaded.length() == 4);
+    assert(get_entry(loaded, "counter")->str == "99");
+    assert(get_entry(loaded, "during")->str == "rewrite");
+    assert(get_entry(loaded, "deleted") == NULL);
+    assert(get_entry(loaded, "expiring")->ttl_timer.is_expiry_set());
+
+    double score;
+    Entry *myset = get_entry(loaded, "myset");
+    assert(myset->zset.length() == 10);
+    assert(myset->zset.lookup("name0", 5, &score) && score == 1000);
+    assert(myset->zset.lookup("name9", 5, &score) && score == 99);
+
+    unlink(path.data());
+}
+
+void test_auto_rewrite() {
+    std::string path = temp_path("auto");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+    aof.set_auto_rewrite_min_size(1024);
+    aof.set_auto_rewrite_percentage(100);
+
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    assert(aof.start(kv_store));
+    uint64_t rewrites = aof.get_stats().rewrites;
+
+    // below the minimum size the file is never rewritten, however much it grew
+    executor.execute_now({"set", "name", "tyler"});
+    aof.flush(thread_pool);
+    aof.cron(kv_store);
+    assert(!aof.get_stats().rewrite_in_progress);
+
+    while (aof.get_stats().size < 2048) {
+        executor.execute_now({"set", "name", "tyler"});
+        aof.flush(thread_pool);
+    }
+    aof.cron(kv_store);
+    assert(aof.get_stats().rewrite_in_progress);
+    wait_for_rewrite(aof, kv_store);
+    assert(aof.get_stats().rewrites == rewrites + 1);
+    assert(aof.get_stats().base_size == aof.get_stats().size);
+
+    // the file has to double again before the next one
+    executor.execute_now({"set", "name", "tyler"});
+    aof.flush(thread_pool);
+    aof.cron(kv_store);
+    assert(!aof.get_stats().rewrite_in_progress);
+
+    // stopping the AOF cancels a running rewrite
+    assert(aof.bgrewrite(kv_store));
+    aof.stop();
+    assert(!aof.get_stats().rewrite_in_progress);
+
+    aof.set_auto_rewrite_min_size(64 * 1024 * 1024);
+    unlink(path.data());
+}
+
+void test_preamble() {
+    std::string path = temp_path("preamble");
+    Aof &aof = Aof::shared();
+    aof.set_filename(path);
+
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    for (uint32_t i = 0; i < 100; i++) {
+        executor.execute_now({"set", "key" + std::to_string(i), "value"});
+    }
+    executor.execute_now({"zadd", "myset", "1", "a", "2", "b"});
+    executor.execute_now({"pexpire", "myset", "100000"});
+
+    // the kv store goes in as a snapshot, and what's logged after it as records
+    assert(aof.get_use_rdb_preamble());
+    assert(aof.start(kv_store));
+    executor.execute_now({"del", "key0"});
+    executor.execute_now({"zadd", "myset", "3", "c"});
+    aof.flush(thread_pool);
+    aof.stop();
+
+    int fd = open(path.data(), O_RDONLY);
+    char magic[AOF_PREAMBLE_MAGIC_LEN];
+    assert(read(fd, magic, sizeof(magic)) == sizeof(magic));
+    close(fd);
+    assert(memcmp(magic, AOF_PREAMBLE_MAGIC, AOF_PREAMBLE_MAGIC_LEN) == 0);
+
+    HMap loaded;
+    assert(aof.load(loaded, timers, thread_pool, evictor));
+    aof.stop();
+    assert(loaded.length() == 100);
+    assert(get_entry(loaded, "key0") == NULL);
+    assert(get_entry(loaded, "key99")->str == "value");
+    Entry *myset = get_entry(loaded, "myset");
+    assert(myset->zset.length() == 3);
+    assert(myset->ttl_timer.is_expiry_set());
+
+    // a damaged preamble stops the load, since there is no telling what's missing
+    off_t size = file_size(path);
+    fd = open(path.data(), O_RDWR);
+    char byte;
+    assert(pread(fd, &byte, 1, AOF_PREAMBLE_HEADER_SIZE + 20) == 1);
+    byte ^= 1;
+    assert(pwrite(fd, &byte, 1, AOF_PREAMBLE_HEADER_SIZE + 20) == 1);
+    close(fd);
+    HMap corrupt;
+    assert(!aof.load(corrupt, timers, thread_pool, evictor));
+    assert(file_size(path) == size);
+
+    // without the preamble, the file is records only
+    aof.set_use_rdb_preamble(false);
+    unlink(path.data());
+    assert(aof.start(kv_store));
+    aof.stop();
+    fd = open(path.data(), O_RDONLY);
+    assert(read(fd, magic, sizeof(magic)) == sizeof(magic));
+    close(fd);
+    assert(memcmp(magic, AOF_PREAMBLE_MAGIC, AOF_PREAMBLE_MAGIC_LEN) != 0);
+    HMap from_records;
+    assert(aof.load(from_records, timers, thread_pool, evictor));
+    aof.stop();
+    assert(from_records.length() == 100);
+
+    aof.set_use_rdb_preamble(true);
+    unlink(path.data());
+}
+
+int main() {
+    test_log_and_replay();
+    test_start_logs_existing_keys();
+    test_load_truncated_file();
+    test_load_torn_record();
+    test_load_corrupt_file();
+    test_load_corrupt_length();
+    test_load_missing_file();
+    test_group_commit();
+    test_bgrewrite();
+    test_auto_rewrite();
+    test_preamble();
+
+    return 0;
+}
@@ -132,6 +132,26 @@ AVLNode *AVLTree::remove(AVLNode *node) {
     return root;
 }
 
+void AVLTree::replace(AVLNode *old_node, AVLNode *new_node) {
+    *new_node = *old_node;
+
+    AVLNode *parent = new_node->parent;
+    if (parent == NULL) {
+        root = new_node;
+    } else if (parent->left == old_node) {
+        parent->left = new_node;
+    } else {
+        parent->right = new_node;
+    }
+
+    if (new_node->left != NULL) {
+        new_node->left->parent = new_node;
+    }
+    if (new_node->right != NULL) {
+        new_node->right->parent = new_node;
+    }
+}
+
 uint64_t AVLTree::rank(AVLNode *node) {
     uint64_t offset_from_root = 0;
     while (node->parent != NULL) {
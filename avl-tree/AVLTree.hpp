@@ -74,6 +74,15 @@ class AVLTree {
          */
         static AVLNode *remove(AVLNode *node);
 
+        /**
+         * Puts a node in the place of another node in the AVLTree, e.g. when the struct holding the node has moved in 
+         * memory. The new node takes on the old node's links and metadata.
+         * 
+         * @param old_node  Pointer to the node in the AVLTree.
+         * @param new_node  Pointer to the node to put in its place.
+         */
+        void replace(AVLNode *old_node, AVLNode *new_node);
+
         /**
          * Finds the rank (position in sorted order) of the given node in its AVLTree.
          * 
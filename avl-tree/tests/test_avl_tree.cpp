@@ -553,6 +553,41 @@ void test_rank_largest_node() {
     clean_up_tree(tree);
 }
 
+void test_replace_root() {
+    AVLTree *tree = create_tree(3);
+    Item *old_item = container_of(tree->root, Item, node);
+    Item *new_item = new Item(old_item->key);
+
+    tree->replace(&old_item->node, &new_item->node);
+    delete old_item;
+
+    assert(tree->root == &new_item->node);
+    assert(tree->root->left->parent == &new_item->node);
+    assert(tree->root->right->parent == &new_item->node);
+    assert(tree->root->size == 3);
+
+    clean_up_tree(tree);
+}
+
+void test_replace_inner_node() {
+    AVLTree *tree = create_tree(25);
+    Item key(15);
+    Item *old_item = container_of(tree->lookup(&key.node, compare_items), Item, node);
+    Item *new_item = new Item(old_item->key);
+
+    tree->replace(&old_item->node, &new_item->node);
+    delete old_item;
+
+    assert(tree->lookup(&key.node, compare_items) == &new_item->node);
+    assert(AVLTree::rank(&new_item->node) == 15);
+    for (uint32_t i = 0; i < 25; i++) {
+        AVLNode *node = tree->find_offset(&new_item->node, (int64_t) i - 15);
+        assert(container_of(node, Item, node)->key == i);
+    }
+
+    clean_up_tree(tree);
+}
+
 int main() {
     test_insert_into_empty_tree();
     test_insert_smaller_node();
@@ -591,5 +626,8 @@ int main() {
     test_rank_middle_node();
     test_rank_largest_node();
 
+    test_replace_root();
+    test_replace_inner_node();
+
     return 0;
 }
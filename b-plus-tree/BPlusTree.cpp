@@ -0,0 +1,968 @@
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "BPlusTree.hpp"
+
+const double INF = std::numeric_limits<double>::infinity();
+
+/**
+ * Inserts a score and item into a node's arrays, shifting later slots up.
+ * 
+ * @param node  Pointer to the node.
+ * @param n     Number of slots in use.
+ * @param pos   Slot to insert at.
+ * @param score The score.
+ * @param item  Pointer to the item.
+ */
+void insert_slot(BPlusNode *node, uint16_t n, uint16_t pos, double score, void *item) {
+    memmove(&node->scores[pos + 1], &node->scores[pos], (n - pos) * sizeof(double));
+    memmove(&node->items[pos + 1], &node->items[pos], (n - pos) * sizeof(void *));
+    node->scores[pos] = score;
+    node->items[pos] = item;
+}
+
+/**
+ * Removes a score and item from a node's arrays, shifting later slots down.
+ * 
+ * @param node  Pointer to the node.
+ * @param n     Number of slots in use.
+ * @param pos   Slot to remove.
+ */
+void erase_slot(BPlusNode *node, uint16_t n, uint16_t pos) {
+    memmove(&node->scores[pos], &node->scores[pos + 1], (n - pos - 1) * sizeof(double));
+    memmove(&node->items[pos], &node->items[pos + 1], (n - pos - 1) * sizeof(void *));
+    node->scores[n - 1] = INF;
+    node->items[n - 1] = NULL;
+}
+
+/**
+ * Inserts a child into an inner node along with the separator to its left.
+ * 
+ * @param inner     Pointer to the inner node.
+ * @param pos       Index for the child. Must be at least 1.
+ * @param child     Pointer to the child.
+ * @param count     Number of items under the child.
+ * @param sep_score Score of the separator.
+ * @param sep_item  The separator.
+ */
+void insert_child(BPlusInner *inner, uint16_t pos, BPlusNode *child, uint32_t count, double sep_score, void *sep_item) {
+    insert_slot(inner, inner->count - 1, pos - 1, sep_score, sep_item);
+    memmove(&inner->children[pos + 1], &inner->children[pos], (inner->count - pos) * sizeof(BPlusNode *));
+    memmove(&inner->counts[pos + 1], &inner->counts[pos], (inner->count - pos) * sizeof(uint32_t));
+    inner->children[pos] = child;
+    inner->counts[pos] = count;
+    inner->count++;
+}
+
+/**
+ * Removes a child from an inner node along with the separator to its left.
+ * 
+ * @param inner Pointer to the inner node.
+ * @param pos   Index of the child. Must be at least 1.
+ */
+void erase_child(BPlusInner *inner, uint16_t pos) {
+    erase_slot(inner, inner->count - 1, pos - 1);
+    memmove(&inner->children[pos], &inner->children[pos + 1], (inner->count - pos - 1) * sizeof(BPlusNode *));
+    memmove(&inner->counts[pos], &inner->counts[pos + 1], (inner->count - pos - 1) * sizeof(uint32_t));
+    inner->count--;
+}
+
+BPlusTree::~BPlusTree() {
+    if (root != NULL) {
+        free_node(root);
+    }
+}
+
+void BPlusTree::insert(double score, void *item, int32_t (*cmp)(const void *, void *)) {
+    if (root == NULL) {
+        root = new BPlusLeaf();
+        num_leaves++;
+    }
+
+    double sep_score;
+    void *sep_item;
+    BPlusNode *split = insert_into(root, score, item, cmp, &sep_score, &sep_item);
+    if (split != NULL) {
+        // grow the tree by a level
+        BPlusInner *new_root = new BPlusInner();
+        num_inners++;
+        new_root->children[0] = root;
+        new_root->counts[0] = node_size(root);
+        new_root->children[1] = split;
+        new_root->counts[1] = node_size(split);
+        new_root->scores[0] = sep_score;
+        new_root->items[0] = sep_item;
+        new_root->count = 2;
+        root = new_root;
+    }
+
+    size++;
+}
+
+void *BPlusTree::remove(double score, const void *key, int32_t (*cmp)(const void *, void *)) {
+    if (root == NULL) {
+        return NULL;
+    }
+
+    void *removed = remove_from(root, score, key, cmp);
+    if (removed == NULL) {
+        return NULL;
+    }
+    size--;
+
+    // shrink the tree by a level
+    if (!root->is_leaf && root->count == 1) {
+        BPlusInner *old_root = (BPlusInner *) root;
+        root = old_root->children[0];
+        delete old_root;
+        num_inners--;
+    } else if (root->is_leaf && root->count == 0) {
+        delete (BPlusLeaf *) root;
+        root = NULL;
+        num_leaves--;
+    }
+
+    return removed;
+}
+
+bool BPlusTree::replace(double score, void *old_item, void *new_item, int32_t (*cmp)(const void *, void *)) {
+    if (root == NULL) {
+        return false;
+    }
+
+    // the item is also a separator in at most one inner node on the way down
+    BPlusNode *node = root;
+    while (!node->is_leaf) {
+        BPlusInner *inner = (BPlusInner *) node;
+        uint16_t idx = child_index(inner, score, old_item, cmp);
+        if (idx > 0 && inner->items[idx - 1] == old_item) {
+            inner->items[idx - 1] = new_item;
+        }
+        node = inner->children[idx];
+    }
+
+    bool equal;
+    uint16_t pos = search(node, node->count, score, old_item, cmp, &equal);
+    if (!equal || node->items[pos] != old_item) {
+        return false;
+    }
+    node->items[pos] = new_item;
+    return true;
+}
+
+int64_t BPlusTree::rank(double score, const void *key, int32_t (*cmp)(const void *, void *)) {
+    if (root == NULL) {
+        return -1;
+    }
+
+    uint64_t rank = 0;
+    BPlusNode *node = root;
+    while (!node->is_leaf) {
+        BPlusInner *inner = (BPlusInner *) node;
+        uint16_t idx = child_index(inner, score, key, cmp);
+        for (uint16_t i = 0; i < idx; i++) {
+            rank += inner->counts[i];
+        }
+        node = inner->children[idx];
+    }
+
+    bool equal;
+    uint16_t pos = search(node, node->count, score, key, cmp, &equal);
+    if (!equal) {
+        return -1;
+    }
+    return rank + pos;
+}
+
+BPlusCursor BPlusTree::find_first_ge(double score, const void *key, int32_t (*cmp)(const void *, void *),
+                                     uint64_t *rank) {
+    BPlusCursor cursor;
+    if (root == NULL) {
+        if (rank != NULL) {
+            *rank = 0;
+        }
+        return cursor;
+    }
+
+    uint64_t curr_rank = 0;
+    BPlusNode *node = root;
+    while (!node->is_leaf) {
+        BPlusInner *inner = (BPlusInner *) node;
+        uint16_t idx = child_index(inner, score, key, cmp);
+        for (uint16_t i = 0; i < idx; i++) {
+            curr_rank += inner->counts[i];
+        }
+        node = inner->children[idx];
+    }
+
+    bool equal;
+    cursor.leaf = (BPlusLeaf *) node;
+    cursor.pos = search(node, node->count, score, key, cmp, &equal);
+    curr_rank += cursor.pos;
+    if (cursor.pos == node->count) {
+        // every item in the leaf is lower, so the first item of the next leaf is the answer
+        cursor.leaf = cursor.leaf->next;
+        cursor.pos = 0;
+    }
+
+    if (rank != NULL) {
+        *rank = curr_rank;
+    }
+    return cursor;
+}
+
+BPlusCursor BPlusTree::seek(uint64_t rank) {
+    BPlusCursor cursor;
+    if (rank >= size) {
+        return cursor;
+    }
+
+    BPlusNode *node = root;
+    while (!node->is_leaf) {
+        BPlusInner *inner = (BPlusInner *) node;
+        uint16_t idx = 0;
+        while (rank >= inner->counts[idx]) {
+            rank -= inner->counts[idx];
+            idx++;
+        }
+        node = inner->children[idx];
+    }
+
+    cursor.leaf = (BPlusLeaf *) node;
+    cursor.pos = rank;
+    return cursor;
+}
+
+void *BPlusTree::get(const BPlusCursor &cursor) {
+    if (cursor.leaf == NULL || cursor.pos >= cursor.leaf->count) {
+        return NULL;
+    }
+    return cursor.leaf->items[cursor.pos];
+}
+
+void BPlusTree::next(BPlusCursor &cursor) {
+    if (cursor.leaf == NULL) {
+        return;
+    }
+    if (++cursor.pos >= cursor.leaf->count) {
+        cursor.leaf = cursor.leaf->next;
+        cursor.pos = 0;
+    }
+}
+
+void BPlusTree::prev(BPlusCursor &cursor) {
+    if (cursor.leaf == NULL) {
+        return;
+    }
+    if (cursor.pos == 0) {
+        cursor.leaf = cursor.leaf->prev;
+        cursor.pos = cursor.leaf != NULL ? cursor.leaf->count - 1 : 0;
+    } else {
+        cursor.pos--;
+    }
+}
+
+void BPlusTree::for_each(void (*cb)(void *, void *), void *cb_arg) {
+    for (BPlusCursor cursor = seek(0); cursor.leaf != NULL; next(cursor)) {
+        cb(get(cursor), cb_arg);
+    }
+}
+
+void BPlusTree::remove_range(uint64_t first, uint64_t last, BPlusTree &removed) {
+    Subtree low, rest, mid, high;
+    split({ root, height_of(root) }, first, &low, &rest);
+    split(rest, last - first + 1, &mid, &high);
+
+    // detach the leaves of the removed range from their neighbours
+    if (low.root != NULL) {
+        last_leaf(low.root)->next = NULL;
+    }
+    if (high.root != NULL) {
+        first_leaf(high.root)->prev = NULL;
+    }
+    first_leaf(mid.root)->prev = NULL;
+    last_leaf(mid.root)->next = NULL;
+
+    Subtree remaining = join(low, high);
+    root = remaining.root;
+
+    uint64_t leaves = 0;
+    uint64_t inners = 0;
+    count_nodes(mid.root, &leaves, &inners);
+    removed.root = mid.root;
+    removed.size = last - first + 1;
+    removed.num_leaves = leaves;
+    removed.num_inners = inners;
+    size -= removed.size;
+    num_leaves -= leaves;
+    num_inners -= inners;
+}
+
+void BPlusTree::join(BPlusTree &other) {
+    Subtree joined = join({ root, height_of(root) }, { other.root, height_of(other.root) });
+    root = joined.root;
+    size += other.size;
+    num_leaves += other.num_leaves;
+    num_inners += other.num_inners;
+
+    other.root = NULL;
+    other.size = 0;
+    other.num_leaves = 0;
+    other.num_inners = 0;
+}
+
+/* A node made by BPlusTree::build(), with what its parent needs to know about it */
+struct BuiltNode {
+    BPlusNode *node;
+    uint32_t count; // number of items under the node
+    double first_score; // score of the lowest item under the node
+    void *first_item; // lowest item under the node
+};
+
+void BPlusTree::build(const double *scores, void *const *items, uint64_t n) {
+    if (n == 0) {
+        return;
+    }
+
+    // spreading n items over ceil(n / CAPACITY) nodes leaves each node with at least MIN_FILL when there is more than
+    // one, and the same goes for each level of inner nodes over the level below
+    std::vector<BuiltNode> level;
+    uint64_t num_nodes = (n + BPlusNode::CAPACITY - 1) / BPlusNode::CAPACITY;
+    level.reserve(num_nodes);
+    BPlusLeaf *prev = NULL;
+    for (uint64_t i = 0; i < num_nodes; i++) {
+        uint64_t begin = i * n / num_nodes;
+        uint64_t end = (i + 1) * n / num_nodes;
+
+        BPlusLeaf *leaf = new BPlusLeaf();
+        memcpy(leaf->scores, &scores[begin], (end - begin) * sizeof(double));
+        memcpy(leaf->items, &items[begin], (end - begin) * sizeof(void *));
+        leaf->count = end - begin;
+        leaf->prev = prev;
+        if (prev != NULL) {
+            prev->next = leaf;
+        }
+        prev = leaf;
+
+        level.push_back({ leaf, (uint32_t) (end - begin), scores[begin], items[begin] });
+    }
+    num_leaves += num_nodes;
+
+    while (level.size() > 1) {
+        std::vector<BuiltNode> parents;
+        num_nodes = (level.size() + BPlusNode::CAPACITY - 1) / BPlusNode::CAPACITY;
+        parents.reserve(num_nodes);
+        for (uint64_t i = 0; i < num_nodes; i++) {
+            uint64_t begin = i * level.size() / num_nodes;
+            uint64_t end = (i + 1) * level.size() / num_nodes;
+
+            BPlusInner *inner = new BPlusInner();
+            uint32_t count = 0;
+            for (uint64_t j = begin; j < end; j++) {
+                uint16_t pos = j - begin;
+                inner->children[pos] = level[j].node;
+                inner->counts[pos] = level[j].count;
+                if (pos > 0) {
+                    inner->scores[pos - 1] = level[j].first_score;
+                    inner->items[pos - 1] = level[j].first_item;
+                }
+                count += level[j].count;
+            }
+            inner->count = end - begin;
+
+            parents.push_back({ inner, count, level[begin].first_score, level[begin].first_item });
+        }
+        num_inners += num_nodes;
+        level.swap(parents);
+    }
+
+    root = level[0].node;
+    size = n;
+}
+
+uint64_t BPlusTree::length() {
+    return size;
+}
+
+uint64_t BPlusTree::memory_usage() {
+    return num_leaves * sizeof(BPlusLeaf) + num_inners * sizeof(BPlusInner);
+}
+
+uint16_t BPlusTree::count_less(const double *scores, double score) {
+    // unused slots hold +infinity, so all slots can be compared without knowing how many are in use
+    uint16_t n = 0;
+#if defined(__AVX2__)
+    __m256d key = _mm256_set1_pd(score);
+    for (uint16_t i = 0; i < BPlusNode::CAPACITY; i += 4) {
+        __m256d lt = _mm256_cmp_pd(_mm256_load_pd(&scores[i]), key, _CMP_LT_OQ);
+        n += __builtin_popcount(_mm256_movemask_pd(lt));
+    }
+#elif defined(__SSE2__)
+    __m128d key = _mm_set1_pd(score);
+    for (uint16_t i = 0; i < BPlusNode::CAPACITY; i += 2) {
+        __m128d lt = _mm_cmplt_pd(_mm_load_pd(&scores[i]), key);
+        n += __builtin_popcount(_mm_movemask_pd(lt));
+    }
+#else
+    for (uint16_t i = 0; i < BPlusNode::CAPACITY; i++) {
+        n += scores[i] < score;
+    }
+#endif
+    return n;
+}
+
+uint16_t BPlusTree::search(BPlusNode *node, uint16_t n, double score, const void *key,
+                           int32_t (*cmp)(const void *, void *), bool *equal) {
+    uint16_t i = count_less(node->scores, score);
+    while (i < n && node->scores[i] == score) {
+        int32_t res = cmp(key, node->items[i]);
+        if (res <= 0) {
+            *equal = res == 0;
+            return i;
+        }
+        i++;
+    }
+    *equal = false;
+    return i;
+}
+
+uint16_t BPlusTree::child_index(BPlusInner *inner, double score, const void *key,
+                                int32_t (*cmp)(const void *, void *)) {
+    // separator i is the lowest item under child i + 1, so keys equal to it go right
+    bool equal;
+    uint16_t idx = search(inner, inner->count - 1, score, key, cmp, &equal);
+    return equal ? idx + 1 : idx;
+}
+
+uint32_t BPlusTree::node_size(BPlusNode *node) {
+    if (node->is_leaf) {
+        return node->count;
+    }
+
+    BPlusInner *inner = (BPlusInner *) node;
+    uint32_t size = 0;
+    for (uint16_t i = 0; i < inner->count; i++) {
+        size += inner->counts[i];
+    }
+    return size;
+}
+
+void BPlusTree::first_item(BPlusNode *node, double *score, void **item) {
+    while (!node->is_leaf) {
+        node = ((BPlusInner *) node)->children[0];
+    }
+    *score = node->scores[0];
+    *item = node->items[0];
+}
+
+BPlusNode *BPlusTree::insert_into(BPlusNode *node, double score, void *item, int32_t (*cmp)(const void *, void *),
+                                  double *sep_score, void **sep_item) {
+    const uint16_t half = BPlusNode::CAPACITY / 2;
+
+    if (node->is_leaf) {
+        BPlusLeaf *leaf = (BPlusLeaf *) node;
+        bool equal;
+        uint16_t pos = search(leaf, leaf->count, score, item, cmp, &equal);
+
+        if (leaf->count < BPlusNode::CAPACITY) {
+            insert_slot(leaf, leaf->count, pos, score, item);
+            leaf->count++;
+            return NULL;
+        }
+
+        // split, moving the upper half to a new leaf
+        BPlusLeaf *right = new BPlusLeaf();
+        num_leaves++;
+        memcpy(right->scores, &leaf->scores[half], half * sizeof(double));
+        memcpy(right->items, &leaf->items[half], half * sizeof(void *));
+        for (uint16_t i = half; i < BPlusNode::CAPACITY; i++) {
+            leaf->scores[i] = INF;
+            leaf->items[i] = NULL;
+        }
+        leaf->count = half;
+        right->count = half;
+
+        right->next = leaf->next;
+        if (right->next != NULL) {
+            right->next->prev = right;
+        }
+        right->prev = leaf;
+        leaf->next = right;
+
+        BPlusLeaf *target = pos < half ? leaf : right;
+        uint16_t target_pos = pos < half ? pos : pos - half;
+        insert_slot(target, target->count, target_pos, score, item);
+        target->count++;
+
+        *sep_score = right->scores[0];
+        *sep_item = right->items[0];
+        return right;
+    }
+
+    BPlusInner *inner = (BPlusInner *) node;
+    uint16_t idx = child_index(inner, score, item, cmp);
+    double child_sep_score;
+    void *child_sep_item;
+    BPlusNode *child_split = insert_into(inner->children[idx], score, item, cmp, &child_sep_score, &child_sep_item);
+    inner->counts[idx]++;
+    if (child_split == NULL) {
+        return NULL;
+    }
+
+    inner->counts[idx] = node_size(inner->children[idx]);
+    return add_child(inner, idx + 1, child_split, child_sep_score, child_sep_item, sep_score, sep_item);
+}
+
+BPlusNode *BPlusTree::add_child(BPlusInner *inner, uint16_t pos, BPlusNode *child, double sep_score, void *sep_item, 
+                                double *up_score, void **up_item) {
+    const uint16_t half = BPlusNode::CAPACITY / 2;
+    uint32_t child_count = node_size(child);
+    if (inner->count < BPlusNode::CAPACITY) {
+        insert_child(inner, pos, child, child_count, sep_score, sep_item);
+        return NULL;
+    }
+
+    // split, moving the upper half of the children to a new inner node and the separator between the halves up
+    BPlusInner *right = new BPlusInner();
+    num_inners++;
+    *up_score = inner->scores[half - 1];
+    *up_item = inner->items[half - 1];
+    memcpy(right->scores, &inner->scores[half], (half - 1) * sizeof(double));
+    memcpy(right->items, &inner->items[half], (half - 1) * sizeof(void *));
+    memcpy(right->children, &inner->children[half], half * sizeof(BPlusNode *));
+    memcpy(right->counts, &inner->counts[half], half * sizeof(uint32_t));
+    for (uint16_t i = half - 1; i < BPlusNode::CAPACITY; i++) {
+        inner->scores[i] = INF;
+        inner->items[i] = NULL;
+    }
+    inner->count = half;
+    right->count = half;
+
+    if (pos <= half) {
+        insert_child(inner, pos, child, child_count, sep_score, sep_item);
+    } else {
+        insert_child(right, pos - half, child, child_count, sep_score, sep_item);
+    }
+
+    return right;
+}
+
+void *BPlusTree::remove_from(BPlusNode *node, double score, const void *key, int32_t (*cmp)(const void *, void *)) {
+    if (node->is_leaf) {
+        bool equal;
+        uint16_t pos = search(node, node->count, score, key, cmp, &equal);
+        if (!equal) {
+            return NULL;
+        }
+        void *removed = node->items[pos];
+        erase_slot(node, node->count, pos);
+        node->count--;
+        return removed;
+    }
+
+    BPlusInner *inner = (BPlusInner *) node;
+    uint16_t idx = child_index(inner, score, key, cmp);
+    void *removed = remove_from(inner->children[idx], score, key, cmp);
+    if (removed == NULL) {
+        return NULL;
+    }
+    inner->counts[idx]--;
+
+    // the removed item may have been the separator in front of the child
+    if (idx > 0 && inner->items[idx - 1] == removed) {
+        first_item(inner->children[idx], &inner->scores[idx - 1], &inner->items[idx - 1]);
+    }
+
+    if (inner->children[idx]->count < BPlusNode::MIN_FILL) {
+        rebalance(inner, idx);
+    }
+
+    return removed;
+}
+
+void BPlusTree::rebalance(BPlusInner *parent, uint16_t idx) {
+    if (idx > 0 && parent->children[idx - 1]->count > BPlusNode::MIN_FILL) {
+        borrow_from_left(parent, idx);
+    } else if (idx + 1 < parent->count && parent->children[idx + 1]->count > BPlusNode::MIN_FILL) {
+        borrow_from_right(parent, idx);
+    } else if (idx > 0) {
+        merge_with_right(parent, idx - 1);
+    } else {
+        merge_with_right(parent, idx);
+    }
+}
+
+void BPlusTree::borrow_from_left(BPlusInner *parent, uint16_t idx) {
+    BPlusNode *left = parent->children[idx - 1];
+    BPlusNode *child = parent->children[idx];
+
+    if (child->is_leaf) {
+        insert_slot(child, child->count, 0, left->scores[left->count - 1], left->items[left->count - 1]);
+        child->count++;
+        erase_slot(left, left->count, left->count - 1);
+        left->count--;
+
+        parent->scores[idx - 1] = child->scores[0];
+        parent->items[idx - 1] = child->items[0];
+        parent->counts[idx - 1]--;
+        parent->counts[idx]++;
+        return;
+    }
+
+    // rotate the left sibling's last child through the parent's separator
+    BPlusInner *left_inner = (BPlusInner *) left;
+    BPlusInner *child_inner = (BPlusInner *) child;
+    BPlusNode *moved = left_inner->children[left_inner->count - 1];
+    uint32_t moved_count = left_inner->counts[left_inner->count - 1];
+
+    insert_slot(child_inner, child_inner->count - 1, 0, parent->scores[idx - 1], parent->items[idx - 1]);
+    memmove(&child_inner->children[1], &child_inner->children[0], child_inner->count * sizeof(BPlusNode *));
+    memmove(&child_inner->counts[1], &child_inner->counts[0], child_inner->count * sizeof(uint32_t));
+    child_inner->children[0] = moved;
+    child_inner->counts[0] = moved_count;
+    child_inner->count++;
+
+    parent->scores[idx - 1] = left_inner->scores[left_inner->count - 2];
+    parent->items[idx - 1] = left_inner->items[left_inner->count - 2];
+    left_inner->scores[left_inner->count - 2] = INF;
+    left_inner->items[left_inner->count - 2] = NULL;
+    left_inner->count--;
+
+    parent->counts[idx - 1] -= moved_count;
+    parent->counts[idx] += moved_count;
+}
+
+void BPlusTree::borrow_from_right(BPlusInner *parent, uint16_t idx) {
+    BPlusNode *child = parent->children[idx];
+    BPlusNode *right = parent->children[idx + 1];
+
+    if (child->is_leaf) {
+        child->scores[child->count] = right->scores[0];
+        child->items[child->count] = right->items[0];
+        child->count++;
+        erase_slot(right, right->count, 0);
+        right->count--;
+
+        parent->scores[idx] = right->scores[0];
+        parent->items[idx] = right->items[0];
+        parent->counts[idx]++;
+        parent->counts[idx + 1]--;
+        return;
+    }
+
+    // rotate the right sibling's first child through the parent's separator
+    BPlusInner *child_inner = (BPlusInner *) child;
+    BPlusInner *right_inner = (BPlusInner *) right;
+    BPlusNode *moved = right_inner->children[0];
+    uint32_t moved_count = right_inner->counts[0];
+
+    child_inner->scores[child_inner->count - 1] = parent->scores[idx];
+    child_inner->items[child_inner->count - 1] = parent->items[idx];
+    child_inner->children[child_inner->count] = moved;
+    child_inner->counts[child_inner->count] = moved_count;
+    child_inner->count++;
+
+    parent->scores[idx] = right_inner->scores[0];
+    parent->items[idx] = right_inner->items[0];
+    erase_slot(right_inner, right_inner->count - 1, 0);
+    memmove(&right_inner->children[0], &right_inner->children[1], (right_inner->count - 1) * sizeof(BPlusNode *));
+    memmove(&right_inner->counts[0], &right_inner->counts[1], (right_inner->count - 1) * sizeof(uint32_t));
+    right_inner->count--;
+
+    parent->counts[idx] += moved_count;
+    parent->counts[idx + 1] -= moved_count;
+}
+
+void BPlusTree::merge_with_right(BPlusInner *parent, uint16_t idx) {
+    BPlusNode *left = parent->children[idx];
+    BPlusNode *right = parent->children[idx + 1];
+
+    if (left->is_leaf) {
+        BPlusLeaf *left_leaf = (BPlusLeaf *) left;
+        BPlusLeaf *right_leaf = (BPlusLeaf *) right;
+        memcpy(&left_leaf->scores[left_leaf->count], right_leaf->scores, right_leaf->count * sizeof(double));
+        memcpy(&left_leaf->items[left_leaf->count], right_leaf->items, right_leaf->count * sizeof(void *));
+        left_leaf->count += right_leaf->count;
+
+        left_leaf->next = right_leaf->next;
+        if (left_leaf->next != NULL) {
+            left_leaf->next->prev = left_leaf;
+        }
+        delete right_leaf;
+        num_leaves--;
+    } else {
+        // the parent's separator comes down between the two halves
+        BPlusInner *left_inner = (BPlusInner *) left;
+        BPlusInner *right_inner = (BPlusInner *) right;
+        uint16_t n = left_inner->count;
+        left_inner->scores[n - 1] = parent->scores[idx];
+        left_inner->items[n - 1] = parent->items[idx];
+        memcpy(&left_inner->scores[n], right_inner->scores, (right_inner->count - 1) * sizeof(double));
+        memcpy(&left_inner->items[n], right_inner->items, (right_inner->count - 1) * sizeof(void *));
+        memcpy(&left_inner->children[n], right_inner->children, right_inner->count * sizeof(BPlusNode *));
+        memcpy(&left_inner->counts[n], right_inner->counts, right_inner->count * sizeof(uint32_t));
+        left_inner->count += right_inner->count;
+
+        delete right_inner;
+        num_inners--;
+    }
+
+    parent->counts[idx] += parent->counts[idx + 1];
+    erase_child(parent, idx + 1);
+}
+
+void BPlusTree::fix_underflow(BPlusInner *parent, uint16_t idx) {
+    while (parent->count > 1 && parent->children[idx]->count < BPlusNode::MIN_FILL) {
+        uint16_t count = parent->count;
+        rebalance(parent, idx);
+        if (parent->count < count) {
+            return; // merged
+        }
+    }
+}
+
+void BPlusTree::normalize(Subtree &tree) {
+    while (tree.root != NULL && !tree.root->is_leaf && tree.root->count <= 1) {
+        BPlusInner *inner = (BPlusInner *) tree.root;
+        tree.root = inner->count == 1 ? inner->children[0] : NULL;
+        tree.height--;
+        delete inner;
+        num_inners--;
+    }
+    if (tree.root != NULL && tree.root->is_leaf && tree.root->count == 0) {
+        delete (BPlusLeaf *) tree.root;
+        num_leaves--;
+        tree.root = NULL;
+    }
+}
+
+BPlusTree::Subtree BPlusTree::join(Subtree left, Subtree right) {
+    if (left.root == NULL) {
+        return right;
+    }
+    if (right.root == NULL) {
+        return left;
+    }
+
+    BPlusLeaf *left_last = last_leaf(left.root);
+    BPlusLeaf *right_first = first_leaf(right.root);
+    left_last->next = right_first;
+    right_first->prev = left_last;
+
+    double sep_score;
+    void *sep_item;
+    Subtree joined;
+    BPlusNode *split;
+    if (left.height == right.height) {
+        joined = left;
+        split = right.root;
+        first_item(right.root, &sep_score, &sep_item);
+    } else if (left.height > right.height) {
+        joined = left;
+        split = attach_right(left.root, left.height, right, &sep_score, &sep_item);
+    } else {
+        joined = right;
+        split = attach_left(right.root, right.height, left, &sep_score, &sep_item);
+    }
+
+    if (split != NULL) {
+        // grow the tree by a level
+        BPlusInner *new_root = new BPlusInner();
+        num_inners++;
+        new_root->children[0] = joined.root;
+        new_root->counts[0] = node_size(joined.root);
+        new_root->children[1] = split;
+        new_root->counts[1] = node_size(split);
+        new_root->scores[0] = sep_score;
+        new_root->items[0] = sep_item;
+        new_root->count = 2;
+
+        // the old roots may be under MIN_FILL now that they aren't roots
+        fix_underflow(new_root, 0);
+        fix_underflow(new_root, new_root->count - 1);
+
+        joined.root = new_root;
+        joined.height++;
+        normalize(joined);
+    }
+
+    return joined;
+}
+
+BPlusNode *BPlusTree::attach_right(BPlusNode *node, uint32_t height, Subtree right, double *up_score, void **up_item) {
+    BPlusInner *inner = (BPlusInner *) node;
+    uint16_t last = inner->count - 1;
+
+    BPlusNode *child = right.root;
+    double sep_score;
+    void *sep_item;
+    if (height - 1 == right.height) {
+        first_item(right.root, &sep_score, &sep_item);
+    } else {
+        child = attach_right(inner->children[last], height - 1, right, &sep_score, &sep_item);
+        inner->counts[last] = node_size(inner->children[last]);
+        if (child == NULL) {
+            return NULL;
+        }
+    }
+
+    // the new child is the last child of whichever half it ends up in
+    BPlusNode *split = add_child(inner, inner->count, child, sep_score, sep_item, up_score, up_item);
+    BPlusInner *holder = split != NULL ? (BPlusInner *) split : inner;
+    fix_underflow(holder, holder->count - 1);
+    return split;
+}
+
+BPlusNode *BPlusTree::attach_left(BPlusNode *node, uint32_t height, Subtree left, double *up_score, void **up_item) {
+    BPlusInner *inner = (BPlusInner *) node;
+
+    double sep_score;
+    void *sep_item;
+    if (height - 1 != left.height) {
+        BPlusNode *child = attach_left(inner->children[0], height - 1, left, &sep_score, &sep_item);
+        inner->counts[0] = node_size(inner->children[0]);
+        if (child == NULL) {
+            return NULL;
+        }
+        return add_child(inner, 1, child, sep_score, sep_item, up_score, up_item);
+    }
+
+    // the subtree becomes the first child, and the old first child is re-added after it with a separator
+    BPlusNode *old_first = inner->children[0];
+    inner->children[0] = left.root;
+    inner->counts[0] = node_size(left.root);
+    first_item(old_first, &sep_score, &sep_item);
+    BPlusNode *split = add_child(inner, 1, old_first, sep_score, sep_item, up_score, up_item);
+    fix_underflow(inner, 0);
+    return split;
+}
+
+void BPlusTree::split(Subtree tree, uint64_t rank, Subtree *left, Subtree *right) {
+    *left = Subtree();
+    *right = Subtree();
+    if (tree.root == NULL || rank == 0) {
+        *right = tree;
+        return;
+    }
+    if (rank >= node_size(tree.root)) {
+        *left = tree;
+        return;
+    }
+
+    if (tree.root->is_leaf) {
+        // move the items from the rank onwards to a new leaf
+        BPlusLeaf *leaf = (BPlusLeaf *) tree.root;
+        BPlusLeaf *upper = new BPlusLeaf();
+        num_leaves++;
+        uint16_t moved = leaf->count - rank;
+        memcpy(upper->scores, &leaf->scores[rank], moved * sizeof(double));
+        memcpy(upper->items, &leaf->items[rank], moved * sizeof(void *));
+        for (uint16_t i = rank; i < leaf->count; i++) {
+            leaf->scores[i] = INF;
+            leaf->items[i] = NULL;
+        }
+        upper->count = moved;
+        leaf->count = rank;
+
+        upper->next = leaf->next;
+        if (upper->next != NULL) {
+            upper->next->prev = upper;
+        }
+        upper->prev = leaf;
+        leaf->next = upper;
+
+        *left = { leaf, 0 };
+        *right = { upper, 0 };
+        return;
+    }
+
+    BPlusInner *inner = (BPlusInner *) tree.root;
+    uint16_t idx = 0;
+    while (rank >= inner->counts[idx]) {
+        rank -= inner->counts[idx];
+        idx++;
+    }
+
+    Subtree child_left, child_right;
+    split({ inner->children[idx], tree.height - 1 }, rank, &child_left, &child_right);
+
+    // the children after idx move to a new inner node, and the node keeps the children before idx
+    BPlusInner *upper = new BPlusInner();
+    num_inners++;
+    uint16_t moved = inner->count - idx - 1;
+    if (moved > 0) {
+        memcpy(upper->children, &inner->children[idx + 1], moved * sizeof(BPlusNode *));
+        memcpy(upper->counts, &inner->counts[idx + 1], moved * sizeof(uint32_t));
+        memcpy(upper->scores, &inner->scores[idx + 1], (moved - 1) * sizeof(double));
+        memcpy(upper->items, &inner->items[idx + 1], (moved - 1) * sizeof(void *));
+    }
+    upper->count = moved;
+    for (uint16_t i = idx > 0 ? idx - 1 : 0; i < BPlusNode::CAPACITY; i++) {
+        inner->scores[i] = INF;
+        inner->items[i] = NULL;
+    }
+    inner->count = idx;
+
+    Subtree lower_part = { inner, tree.height };
+    Subtree upper_part = { upper, tree.height };
+    normalize(lower_part);
+    normalize(upper_part);
+
+    *left = join(lower_part, child_left);
+    *right = join(child_right, upper_part);
+}
+
+uint32_t BPlusTree::height_of(BPlusNode *node) {
+    uint32_t height = 0;
+    while (node != NULL && !node->is_leaf) {
+        node = ((BPlusInner *) node)->children[0];
+        height++;
+    }
+    return height;
+}
+
+BPlusLeaf *BPlusTree::first_leaf(BPlusNode *node) {
+    while (!node->is_leaf) {
+        node = ((BPlusInner *) node)->children[0];
+    }
+    return (BPlusLeaf *) node;
+}
+
+BPlusLeaf *BPlusTree::last_leaf(BPlusNode *node) {
+    while (!node->is_leaf) {
+        BPlusInner *inner = (BPlusInner *) node;
+        node = inner->children[inner->count - 1];
+    }
+    return (BPlusLeaf *) node;
+}
+
+void BPlusTree::count_nodes(BPlusNode *node, uint64_t *leaves, uint64_t *inners) {
+    if (node->is_leaf) {
+        (*leaves)++;
+        return;
+    }
+
+    BPlusInner *inner = (BPlusInner *) node;
+    (*inners)++;
+    for (uint16_t i = 0; i < inner->count; i++) {
+        count_nodes(inner->children[i], leaves, inners);
+    }
+}
+
+void BPlusTree::free_node(BPlusNode *node) {
+    if (node->is_leaf) {
+        delete (BPlusLeaf *) node;
+        return;
+    }
+
+    BPlusInner *inner = (BPlusInner *) node;
+    for (uint16_t i = 0; i < inner->count; i++) {
+        free_node(inner->children[i]);
+    }
+    delete inner;
+}
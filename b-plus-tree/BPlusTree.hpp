@@ -0,0 +1,318 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "components/BPlusNode.hpp"
+
+/* Position of an item in a BPlusTree. Invalidated when the tree is modified. */
+struct BPlusCursor {
+    BPlusLeaf *leaf = NULL; // NULL when past either end of the tree
+    uint16_t pos = 0;
+};
+
+/**
+ * Order-statistic B+tree of items ordered by a score and then by a comparison function.
+ * 
+ * Items live in linked leaves, so range scans walk arrays instead of chasing a pointer per item, and inner nodes keep
+ * the number of items under each child for rank queries. Nodes are searched on their scores with SIMD compares, and
+ * the comparison function is only called to break ties between equal scores.
+ * 
+ * The tree stores pointers to items but doesn't own them. Items must be unique.
+ */
+class BPlusTree {
+    public:
+        ~BPlusTree();
+
+        /**
+         * Inserts the given item into the BPlusTree.
+         * 
+         * @param score The item's score.
+         * @param item  Pointer to the item. Must not already be in the tree.
+         * @param cmp   Function that compares two items. Should return < 0 if first item < second item, > 0 if first
+         *              item > second item, and 0 if the two are equal.
+         */
+        void insert(double score, void *item, int32_t (*cmp)(const void *, void *));
+
+        /**
+         * Removes the item with the given key from the BPlusTree.
+         * 
+         * @param score The key's score.
+         * @param key   Pointer to the key.
+         * @param cmp   Function that compares the key to an item. Should return < 0 if key < item, > 0 if key > item,
+         *              and 0 if the two are equal.
+         * 
+         * @return  Pointer to the item that was removed.
+         *          NULL if an item with the key does not exist in the BPlusTree.
+         */
+        void *remove(double score, const void *key, int32_t (*cmp)(const void *, void *));
+
+        /**
+         * Replaces an item in the BPlusTree with an equal item, e.g. a copy of it at a new address.
+         * 
+         * @param score     The item's score.
+         * @param old_item  Pointer to the item in the tree.
+         * @param new_item  Pointer to the item to put in its place.
+         * @param cmp       Function that compares two items. Should return < 0 if first item < second item, > 0 if
+         *                  first item > second item, and 0 if the two are equal.
+         * 
+         * @return  True if the item was replaced.
+         *          False if old_item is not in the BPlusTree.
+         */
+        bool replace(double score, void *old_item, void *new_item, int32_t (*cmp)(const void *, void *));
+
+        /**
+         * Finds the rank (position in sorted order) of the item with the given key.
+         * 
+         * The rank is 0-based, so the lowest item is rank 0.
+         * 
+         * @param score The key's score.
+         * @param key   Pointer to the key.
+         * @param cmp   Function that compares the key to an item. Should return < 0 if key < item, > 0 if key > item,
+         *              and 0 if the two are equal.
+         * 
+         * @return  The rank of the item if found.
+         *          -1 if an item with the key does not exist in the BPlusTree.
+         */
+        int64_t rank(double score, const void *key, int32_t (*cmp)(const void *, void *));
+
+        /**
+         * Finds the first item in the BPlusTree greater than or equal to the given key.
+         * 
+         * @param score The key's score.
+         * @param key   Pointer to the key.
+         * @param cmp   Function that compares the key to an item. Should return < 0 if key < item, > 0 if key > item,
+         *              and 0 if the two are equal.
+         * @param rank  (Optional) Pointer to store the rank of the item in. Set to length() if there is no such item.
+         * 
+         * @return  Cursor to the item. Past the end if no such item exists.
+         */
+        BPlusCursor find_first_ge(double score, const void *key, int32_t (*cmp)(const void *, void *),
+                                  uint64_t *rank = NULL);
+
+        /**
+         * Finds the item with the given rank.
+         * 
+         * @param rank  The rank.
+         * 
+         * @return  Cursor to the item. Past the end if rank >= length().
+         */
+        BPlusCursor seek(uint64_t rank);
+
+        /* Returns the item at the cursor, or NULL if the cursor is past either end */
+        static void *get(const BPlusCursor &cursor);
+
+        /* Moves the cursor to the next item */
+        static void next(BPlusCursor &cursor);
+
+        /* Moves the cursor to the previous item */
+        static void prev(BPlusCursor &cursor);
+
+        /**
+         * Applies a callback to each item in the BPlusTree, from low to high.
+         * 
+         * @param cb        The callback function.
+         * @param cb_arg    Void pointer to an argument for the callback.
+         */
+        void for_each(void (*cb)(void *, void *), void *cb_arg);
+
+        /**
+         * Moves the items with ranks first through last (inclusive) out of the BPlusTree and into another tree.
+         * 
+         * The range is cut out by splitting the tree at both ends and joining the outer parts back together, so the 
+         * tree work is O(log n) however many items are moved. Counting the moved nodes costs O(k / CAPACITY).
+         * 
+         * @param first     The rank of the first item. Must be <= last.
+         * @param last      The rank of the last item. Must be < length().
+         * @param removed   The tree to move the items into. Must be empty.
+         */
+        void remove_range(uint64_t first, uint64_t last, BPlusTree &removed);
+
+        /**
+         * Moves all items of another BPlusTree to the end of this one in O(log n).
+         * 
+         * @param other The other tree. Every item in it must be greater than every item in this tree. Left empty.
+         */
+        void join(BPlusTree &other);
+
+        /**
+         * Builds the BPlusTree bottom-up from items that are already in order, in O(n). The tree must be empty.
+         * 
+         * Items are spread evenly over the fewest leaves that can hold them, then each level of inner nodes is built 
+         * over the one below it the same way, so every node other than the root is between MIN_FILL and CAPACITY full 
+         * and nothing is searched, split, or shifted along the way.
+         * 
+         * @param scores    The items' scores.
+         * @param items     Pointers to the items, from low to high. Must be unique.
+         * @param n         The number of items.
+         */
+        void build(const double *scores, void *const *items, uint64_t n);
+
+        /* Returns the number of items in the BPlusTree */
+        uint64_t length();
+
+        /* Returns the number of bytes allocated for the BPlusTree's nodes */
+        uint64_t memory_usage();
+    private:
+        /* A subtree and its height, 0 being a leaf, used while splitting and joining */
+        struct Subtree {
+            BPlusNode *root = NULL; // NULL if empty
+            uint32_t height = 0;
+        };
+
+        BPlusNode *root = NULL;
+        uint64_t size = 0;
+        uint64_t num_leaves = 0;
+        uint64_t num_inners = 0;
+
+        /* Returns the number of scores in a node's score array less than the given score */
+        static uint16_t count_less(const double *scores, double score);
+
+        /**
+         * Finds the position of a key among the first n items of a node.
+         * 
+         * @param node  Pointer to the node.
+         * @param n     Number of items to search.
+         * @param score The key's score.
+         * @param key   Pointer to the key.
+         * @param cmp   Function that compares the key to an item.
+         * @param equal Pointer to store whether the item at the returned position is equal to the key.
+         * 
+         * @return  The number of items less than the key.
+         */
+        static uint16_t search(BPlusNode *node, uint16_t n, double score, const void *key,
+                               int32_t (*cmp)(const void *, void *), bool *equal);
+
+        /* Returns the index of the child of an inner node that a key belongs under */
+        static uint16_t child_index(BPlusInner *inner, double score, const void *key,
+                                    int32_t (*cmp)(const void *, void *));
+
+        /* Returns the number of items under a node */
+        static uint32_t node_size(BPlusNode *node);
+
+        /* Gets the lowest item under a node and its score */
+        static void first_item(BPlusNode *node, double *score, void **item);
+
+        /**
+         * Inserts an item under a node, splitting it if it's full.
+         * 
+         * @param node      Pointer to the node.
+         * @param score     The item's score.
+         * @param item      Pointer to the item.
+         * @param cmp       Function that compares two items.
+         * @param sep_score Pointer to store the score of the separator for the new node in, if the node was split.
+         * @param sep_item  Pointer to store the separator for the new node in, if the node was split.
+         * 
+         * @return  Pointer to the new node holding the upper half of the node if it was split.
+         *          NULL otherwise.
+         */
+        BPlusNode *insert_into(BPlusNode *node, double score, void *item, int32_t (*cmp)(const void *, void *),
+                               double *sep_score, void **sep_item);
+
+        /**
+         * Adds a child to an inner node, splitting it if it's full.
+         * 
+         * @param inner     Pointer to the inner node.
+         * @param pos       Index for the child. Must be at least 1.
+         * @param child     Pointer to the child.
+         * @param sep_score Score of the separator in front of the child.
+         * @param sep_item  The separator in front of the child.
+         * @param up_score  Pointer to store the score of the separator for the new node in, if the node was split.
+         * @param up_item   Pointer to store the separator for the new node in, if the node was split.
+         * 
+         * @return  Pointer to the new node holding the upper half of the node if it was split.
+         *          NULL otherwise.
+         */
+        BPlusNode *add_child(BPlusInner *inner, uint16_t pos, BPlusNode *child, double sep_score, void *sep_item, 
+                             double *up_score, void **up_item);
+
+        /**
+         * Removes the item with the given key from under a node, rebalancing the node's children if one becomes too
+         * small.
+         * 
+         * @return  Pointer to the item that was removed.
+         *          NULL if an item with the key does not exist under the node.
+         */
+        void *remove_from(BPlusNode *node, double score, const void *key, int32_t (*cmp)(const void *, void *));
+
+        /**
+         * Refills a child of an inner node that has fallen under MIN_FILL by borrowing from or merging with a sibling.
+         * 
+         * @param parent    Pointer to the inner node.
+         * @param idx       Index of the child.
+         */
+        void rebalance(BPlusInner *parent, uint16_t idx);
+
+        /* Moves the last item/child of a child's left sibling to the front of the child */
+        void borrow_from_left(BPlusInner *parent, uint16_t idx);
+
+        /* Moves the first item/child of a child's right sibling to the end of the child */
+        void borrow_from_right(BPlusInner *parent, uint16_t idx);
+
+        /* Merges a child's right sibling into the child */
+        void merge_with_right(BPlusInner *parent, uint16_t idx);
+
+        /* Rebalances a child of an inner node until it is at least MIN_FILL or has been merged with a sibling */
+        void fix_underflow(BPlusInner *parent, uint16_t idx);
+
+        /* Removes inner roots with a single child and empty leaf roots from a subtree */
+        void normalize(Subtree &tree);
+
+        /**
+         * Joins two subtrees, every item in the left being less than every item in the right.
+         * 
+         * The roots of the subtrees may be under MIN_FILL. The subtree of lower height is attached along the edge of 
+         * the taller one, splitting nodes on the way back up like an insert.
+         * 
+         * @return  The joined subtree.
+         */
+        Subtree join(Subtree left, Subtree right);
+
+        /**
+         * Attaches a shorter subtree after the last item under a node.
+         * 
+         * @return  Pointer to the new node holding the upper half of the node if it was split, with its separator 
+         *          stored in up_score and up_item.
+         *          NULL otherwise.
+         */
+        BPlusNode *attach_right(BPlusNode *node, uint32_t height, Subtree right, double *up_score, void **up_item);
+
+        /**
+         * Attaches a shorter subtree before the first item under a node.
+         * 
+         * @return  Pointer to the new node holding the upper half of the node if it was split, with its separator 
+         *          stored in up_score and up_item.
+         *          NULL otherwise.
+         */
+        BPlusNode *attach_left(BPlusNode *node, uint32_t height, Subtree left, double *up_score, void **up_item);
+
+        /**
+         * Splits a subtree so the items with ranks below the given rank end up in one subtree and the rest in another.
+         * 
+         * @param tree  The subtree.
+         * @param rank  The rank to split at. Must be <= the number of items in the subtree.
+         * @param left  Pointer to store the subtree of items with lower ranks in.
+         * @param right Pointer to store the subtree of the remaining items in.
+         */
+        void split(Subtree tree, uint64_t rank, Subtree *left, Subtree *right);
+
+        /* Returns the height of a node, 0 being a leaf */
+        static uint32_t height_of(BPlusNode *node);
+
+        /* Returns the first leaf under a node */
+        static BPlusLeaf *first_leaf(BPlusNode *node);
+
+        /* Returns the last leaf under a node */
+        static BPlusLeaf *last_leaf(BPlusNode *node);
+
+        /* Counts the leaves and inner nodes under a node, including the node itself */
+        static void count_nodes(BPlusNode *node, uint64_t *leaves, uint64_t *inners);
+
+        /* Deallocates a node and the nodes under it */
+        void free_node(BPlusNode *node);
+
+    #ifdef TEST_MODE
+    public:
+        BPlusNode *get_root() { return root; }
+    #endif
+};
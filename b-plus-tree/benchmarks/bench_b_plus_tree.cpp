@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../BPlusTree.hpp"
+#include "../../avl-tree/AVLTree.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+#include "../../utils/time_utils.hpp"
+
+// Compares the BPlusTree to the AVLTree it replaced behind large SortedSets on leaderboard-style workloads: building a
+// big set, rank look-ups of random members, and range scans that start at a random score (zrangebyscore) or a random
+// rank (zrange). Also compares trimming a range (zremrangebyrank) one remove at a time against remove_range, and
+// loading already sorted items (zadd of sorted input into a new set) one insert at a time against build.
+
+const uint32_t SIZES[] = { 1000000, 10000000 };
+const uint32_t NUM_RANKS = 1000000;
+const uint32_t NUM_SCANS = 100000;
+const uint32_t SCAN_LENGTH = 100;
+const uint32_t TRIM_LENGTH = 10000;
+
+struct Item {
+    AVLNode node; // only used by the AVLTree
+    double score;
+    uint32_t id;
+};
+
+int32_t compare_scores(double score1, uint32_t id1, double score2, uint32_t id2) {
+    if (score1 != score2) {
+        return score1 < score2 ? -1 : 1;
+    }
+    return id1 < id2 ? -1 : (id1 > id2 ? 1 : 0);
+}
+
+int32_t compare_avl_items(AVLNode *node1, AVLNode *node2) {
+    Item *item1 = container_of(node1, Item, node);
+    Item *item2 = container_of(node2, Item, node);
+    return compare_scores(item1->score, item1->id, item2->score, item2->id);
+}
+
+int32_t compare_bplus_items(const void *item1, void *item2) {
+    const Item *a = (const Item *) item1;
+    const Item *b = (const Item *) item2;
+    return compare_scores(a->score, a->id, b->score, b->id);
+}
+
+void report(const char *tree, uint32_t size, const char *op, uint64_t n, double ms) {
+    printf("%-8s size %-9u %-15s %10lu ops %10.2f ms %8.1f ns/op\n", tree, size, op, n, ms, ms * 1e6 / n);
+}
+
+void bench_avl_tree(uint32_t size, std::vector<Item> &items, const std::vector<uint32_t> &probes) {
+    AVLTree tree;
+    auto start = std::chrono::steady_clock::now();
+    for (Item &item : items) {
+        item.node = AVLNode();
+        tree.insert(&item.node, compare_avl_items);
+    }
+    report("avl", size, "insert", size, elapsed_ms(start));
+
+    uint64_t sum = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_RANKS; i++) {
+        sum += AVLTree::rank(&items[probes[i]].node);
+    }
+    report("avl", size, "rank", NUM_RANKS, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_SCANS; i++) {
+        Item key;
+        key.score = items[probes[i]].score;
+        key.id = 0;
+        AVLNode *node = tree.find_first_ge(&key.node, compare_avl_items);
+        for (uint32_t j = 0; node != NULL && j < SCAN_LENGTH; j++) {
+            sum += container_of(node, Item, node)->id;
+            node = AVLTree::find_offset(node, 1);
+        }
+    }
+    report("avl", size, "scan by score", (uint64_t) NUM_SCANS * SCAN_LENGTH, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_SCANS; i++) {
+        AVLNode *node = AVLTree::find_offset(tree.root, (int64_t) probes[i] - AVLTree::rank(tree.root));
+        for (uint32_t j = 0; node != NULL && j < SCAN_LENGTH; j++) {
+            sum += container_of(node, Item, node)->id;
+            node = AVLTree::find_offset(node, 1);
+        }
+    }
+    report("avl", size, "scan by rank", (uint64_t) NUM_SCANS * SCAN_LENGTH, elapsed_ms(start));
+
+    if (sum == 0) {
+        printf("unreachable\n");
+    }
+}
+
+void bench_b_plus_tree(uint32_t size, std::vector<Item> &items, const std::vector<uint32_t> &probes) {
+    BPlusTree tree;
+    auto start = std::chrono::steady_clock::now();
+    for (Item &item : items) {
+        tree.insert(item.score, &item, compare_bplus_items);
+    }
+    report("b+tree", size, "insert", size, elapsed_ms(start));
+
+    uint64_t sum = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_RANKS; i++) {
+        Item &item = items[probes[i]];
+        sum += tree.rank(item.score, &item, compare_bplus_items);
+    }
+    report("b+tree", size, "rank", NUM_RANKS, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_SCANS; i++) {
+        Item key;
+        key.score = items[probes[i]].score;
+        key.id = 0;
+        BPlusCursor cursor = tree.find_first_ge(key.score, &key, compare_bplus_items);
+        for (uint32_t j = 0; cursor.leaf != NULL && j < SCAN_LENGTH; j++, BPlusTree::next(cursor)) {
+            sum += ((Item *) BPlusTree::get(cursor))->id;
+        }
+    }
+    report("b+tree", size, "scan by score", (uint64_t) NUM_SCANS * SCAN_LENGTH, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_SCANS; i++) {
+        BPlusCursor cursor = tree.seek(probes[i]);
+        for (uint32_t j = 0; cursor.leaf != NULL && j < SCAN_LENGTH; j++, BPlusTree::next(cursor)) {
+            sum += ((Item *) BPlusTree::get(cursor))->id;
+        }
+    }
+    report("b+tree", size, "scan by rank", (uint64_t) NUM_SCANS * SCAN_LENGTH, elapsed_ms(start));
+
+    printf("%-8s size %-9u %.1f node bytes/item\n", "b+tree", size, (double) tree.memory_usage() / size);
+
+    // trim the lowest items one remove at a time, then cut a range of the same length out of the middle
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < TRIM_LENGTH; i++) {
+        BPlusCursor cursor = tree.seek(0);
+        Item *item = (Item *) BPlusTree::get(cursor);
+        tree.remove(item->score, item, compare_bplus_items);
+        sum += item->id;
+    }
+    report("b+tree", size, "trim by remove", TRIM_LENGTH, elapsed_ms(start));
+
+    BPlusTree trimmed;
+    start = std::chrono::steady_clock::now();
+    tree.remove_range(size / 2, size / 2 + TRIM_LENGTH - 1, trimmed);
+    report("b+tree", size, "trim by range", TRIM_LENGTH, elapsed_ms(start));
+
+    if (sum == 0) {
+        printf("unreachable\n");
+    }
+}
+
+void bench_b_plus_tree_build(uint32_t size, const std::vector<Item> &items) {
+    std::vector<Item *> sorted;
+    for (const Item &item : items) {
+        sorted.push_back((Item *) &item);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](Item *a, Item *b) { return compare_bplus_items(a, b) < 0; });
+    std::vector<double> scores;
+    for (Item *item : sorted) {
+        scores.push_back(item->score);
+    }
+
+    BPlusTree inserted;
+    auto start = std::chrono::steady_clock::now();
+    for (Item *item : sorted) {
+        inserted.insert(item->score, item, compare_bplus_items);
+    }
+    report("b+tree", size, "sorted insert", size, elapsed_ms(start));
+
+    BPlusTree built;
+    start = std::chrono::steady_clock::now();
+    built.build(scores.data(), (void *const *) sorted.data(), size);
+    report("b+tree", size, "sorted build", size, elapsed_ms(start));
+
+    printf("%-8s size %-9u %.1f node bytes/item inserted, %.1f built\n", "b+tree", size, 
+           (double) inserted.memory_usage() / size, (double) built.memory_usage() / size);
+}
+
+int main() {
+    srand(0);
+
+    for (uint32_t size : SIZES) {
+        // scores are random so items are inserted out of order, and some scores are tied
+        std::vector<Item> items(size);
+        for (uint32_t i = 0; i < size; i++) {
+            items[i].score = rand() % size;
+            items[i].id = i;
+        }
+
+        std::vector<uint32_t> probes(NUM_RANKS);
+        for (uint32_t &probe : probes) {
+            probe = rand() % size;
+        }
+
+        bench_avl_tree(size, items, probes);
+        bench_b_plus_tree(size, items, probes);
+        bench_b_plus_tree_build(size, items);
+    }
+
+    return 0;
+}
@@ -0,0 +1,10 @@
+#include <limits>
+
+#include "BPlusNode.hpp"
+
+BPlusNode::BPlusNode(bool is_leaf) : is_leaf(is_leaf) {
+    for (uint16_t i = 0; i < CAPACITY; i++) {
+        scores[i] = std::numeric_limits<double>::infinity();
+        items[i] = NULL;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Node in a BPlusTree, sized and aligned to whole cache lines.
+ * 
+ * The scores come first and fill exactly two cache lines, so searching a node reads two adjacent lines instead of
+ * chasing a pointer per comparison. Slots past the last score hold +infinity so a search can always compare every slot.
+ */
+struct alignas(64) BPlusNode {
+    static const uint16_t CAPACITY = 16; // items in a leaf, children in an inner node
+    static const uint16_t MIN_FILL = CAPACITY / 2; // fewest items/children a node other than the root holds
+
+    // leaf: scores of the items
+    // inner: scores of the separators, separator i being the lowest item under child i + 1
+    double scores[CAPACITY];
+    // leaf: the items
+    // inner: the separator items
+    void *items[CAPACITY];
+    uint16_t count = 0; // leaf: number of items, inner: number of children
+    bool is_leaf;
+
+    BPlusNode(bool is_leaf);
+};
+
+/* Leaf node in a BPlusTree. Leaves are linked in order so range scans don't go back up the tree. */
+struct BPlusLeaf : BPlusNode {
+    BPlusLeaf *prev = NULL;
+    BPlusLeaf *next = NULL;
+
+    BPlusLeaf() : BPlusNode(true) {}
+};
+
+/* Inner node in a BPlusTree */
+struct BPlusInner : BPlusNode {
+    BPlusNode *children[CAPACITY];
+    uint32_t counts[CAPACITY]; // number of items under each child, used for rank queries
+
+    BPlusInner() : BPlusNode(false) {}
+};
@@ -0,0 +1,581 @@
+#define TEST_MODE
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../BPlusTree.hpp"
+
+struct Item {
+    double score;
+    uint32_t id;
+
+    Item(double score, uint32_t id) {
+        this->score = score;
+        this->id = id;
+    }
+};
+
+/**
+ * Compares two Items in a BPlusTree, ordering by score and then by id.
+ * 
+ * @param item1 Pointer to the first Item.
+ * @param item2 Pointer to the second Item.
+ * 
+ * @return  < 0 if first Item < second Item
+ *          > 0 if first Item > second Item
+ *          0 if the two are equal
+ */
+int32_t compare_items(const void *item1, void *item2) {
+    const Item *a = (const Item *) item1;
+    const Item *b = (const Item *) item2;
+    if (a->score != b->score) {
+        return a->score < b->score ? -1 : 1;
+    }
+    if (a->id != b->id) {
+        return a->id < b->id ? -1 : 1;
+    }
+    return 0;
+}
+
+bool item_less(const Item *a, const Item *b) {
+    return compare_items(a, (void *) b) < 0;
+}
+
+/**
+ * Checks the structure of the subtree under a node: items are in order, counts match the items under each child, each
+ * separator is the lowest item under the child to its right, and nodes other than the root are at least half full.
+ * 
+ * @param node      Pointer to the node.
+ * @param is_root   Whether the node is the root.
+ * @param items     Vector to append the items under the node to, in order.
+ * 
+ * @return  The number of items under the node.
+ */
+uint32_t check_node(BPlusNode *node, bool is_root, std::vector<Item *> &items) {
+    if (!is_root) {
+        assert(node->count >= BPlusNode::MIN_FILL);
+    }
+    assert(node->count <= BPlusNode::CAPACITY);
+
+    if (node->is_leaf) {
+        for (uint16_t i = 0; i < node->count; i++) {
+            Item *item = (Item *) node->items[i];
+            assert(node->scores[i] == item->score);
+            items.push_back(item);
+        }
+        for (uint16_t i = node->count; i < BPlusNode::CAPACITY; i++) {
+            assert(node->scores[i] > 1e300);
+        }
+        return node->count;
+    }
+
+    BPlusInner *inner = (BPlusInner *) node;
+    uint32_t total = 0;
+    for (uint16_t i = 0; i < inner->count; i++) {
+        size_t first = items.size();
+        uint32_t count = check_node(inner->children[i], false, items);
+        assert(inner->counts[i] == count);
+        if (i > 0) {
+            assert(inner->items[i - 1] == items[first]);
+            assert(inner->scores[i - 1] == items[first]->score);
+        }
+        total += count;
+    }
+    for (uint16_t i = inner->count - 1; i < BPlusNode::CAPACITY; i++) {
+        assert(inner->scores[i] > 1e300);
+    }
+    return total;
+}
+
+/**
+ * Checks that a BPlusTree is well-formed and holds exactly the expected items.
+ * 
+ * @param tree      Pointer to the tree.
+ * @param expected  The items expected in the tree, in order.
+ */
+void check_tree(BPlusTree *tree, const std::vector<Item *> &expected) {
+    assert(tree->length() == expected.size());
+    if (expected.empty()) {
+        assert(tree->get_root() == NULL);
+        assert(tree->memory_usage() == 0);
+        return;
+    }
+
+    std::vector<Item *> items;
+    check_node(tree->get_root(), true, items);
+    assert(items == expected);
+
+    // leaves are linked in both directions
+    std::vector<Item *> forward;
+    for (BPlusCursor cursor = tree->seek(0); cursor.leaf != NULL; BPlusTree::next(cursor)) {
+        forward.push_back((Item *) BPlusTree::get(cursor));
+    }
+    assert(forward == expected);
+
+    std::vector<Item *> backward;
+    for (BPlusCursor cursor = tree->seek(expected.size() - 1); cursor.leaf != NULL; BPlusTree::prev(cursor)) {
+        backward.push_back((Item *) BPlusTree::get(cursor));
+    }
+    std::reverse(backward.begin(), backward.end());
+    assert(backward == expected);
+}
+
+/**
+ * Creates Items with ids 0 to n-1 and random scores from a small range, so many scores are tied.
+ * 
+ * @param n Number of Items to create.
+ * 
+ * @return  Vector of pointers to the Items.
+ */
+std::vector<Item *> create_items(uint32_t n) {
+    std::vector<Item *> items;
+    for (uint32_t i = 0; i < n; i++) {
+        items.push_back(new Item(rand() % 100, i));
+    }
+    return items;
+}
+
+void clean_up_items(std::vector<Item *> &items) {
+    for (Item *item : items) {
+        delete item;
+    }
+}
+
+void test_empty_tree() {
+    BPlusTree tree;
+
+    Item key(0, 0);
+    assert(tree.length() == 0);
+    assert(tree.memory_usage() == 0);
+    assert(tree.rank(key.score, &key, compare_items) == -1);
+    assert(tree.remove(key.score, &key, compare_items) == NULL);
+    assert(!tree.replace(key.score, &key, &key, compare_items));
+    assert(tree.seek(0).leaf == NULL);
+
+    uint64_t rank = 1;
+    assert(tree.find_first_ge(key.score, &key, compare_items, &rank).leaf == NULL);
+    assert(rank == 0);
+}
+
+void test_insert_ascending() {
+    BPlusTree tree;
+    std::vector<Item *> items;
+    for (uint32_t i = 0; i < 1000; i++) {
+        items.push_back(new Item(i, i));
+        tree.insert(i, items.back(), compare_items);
+    }
+
+    check_tree(&tree, items);
+    assert(tree.get_root()->is_leaf == false);
+
+    clean_up_items(items);
+}
+
+void test_insert_descending() {
+    BPlusTree tree;
+    std::vector<Item *> items;
+    for (uint32_t i = 0; i < 1000; i++) {
+        items.push_back(new Item(-(double) i, i));
+        tree.insert(items.back()->score, items.back(), compare_items);
+    }
+
+    std::vector<Item *> expected = items;
+    std::sort(expected.begin(), expected.end(), item_less);
+    check_tree(&tree, expected);
+
+    clean_up_items(items);
+}
+
+void test_insert_random() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(5000);
+    std::vector<Item *> expected;
+    for (uint32_t i = 0; i < items.size(); i++) {
+        tree.insert(items[i]->score, items[i], compare_items);
+        expected.insert(std::upper_bound(expected.begin(), expected.end(), items[i], item_less), items[i]);
+        if (i % 97 == 0) {
+            check_tree(&tree, expected);
+        }
+    }
+
+    check_tree(&tree, expected);
+
+    clean_up_items(items);
+}
+
+void test_rank() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(3000);
+    for (Item *item : items) {
+        tree.insert(item->score, item, compare_items);
+    }
+    std::vector<Item *> expected = items;
+    std::sort(expected.begin(), expected.end(), item_less);
+
+    for (uint32_t i = 0; i < expected.size(); i++) {
+        assert(tree.rank(expected[i]->score, expected[i], compare_items) == i);
+    }
+
+    Item missing(50.5, 0);
+    assert(tree.rank(missing.score, &missing, compare_items) == -1);
+
+    clean_up_items(items);
+}
+
+void test_seek() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(3000);
+    for (Item *item : items) {
+        tree.insert(item->score, item, compare_items);
+    }
+    std::vector<Item *> expected = items;
+    std::sort(expected.begin(), expected.end(), item_less);
+
+    for (uint32_t i = 0; i < expected.size(); i++) {
+        assert(BPlusTree::get(tree.seek(i)) == expected[i]);
+    }
+    assert(tree.seek(expected.size()).leaf == NULL);
+
+    clean_up_items(items);
+}
+
+void test_find_first_ge() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(3000);
+    for (Item *item : items) {
+        tree.insert(item->score, item, compare_items);
+    }
+    std::vector<Item *> expected = items;
+    std::sort(expected.begin(), expected.end(), item_less);
+
+    // keys that are in the tree, between items, and before or after every item
+    std::vector<Item> keys;
+    for (Item *item : items) {
+        keys.push_back(*item);
+        keys.push_back(Item(item->score + 0.5, 0));
+    }
+    keys.push_back(Item(-1, 0));
+    keys.push_back(Item(1000, 0));
+
+    for (Item &key : keys) {
+        uint64_t rank;
+        BPlusCursor cursor = tree.find_first_ge(key.score, &key, compare_items, &rank);
+        uint64_t expected_rank = std::lower_bound(expected.begin(), expected.end(), &key, item_less) - expected.begin();
+        assert(rank == expected_rank);
+        if (expected_rank == expected.size()) {
+            assert(cursor.leaf == NULL);
+        } else {
+            assert(BPlusTree::get(cursor) == expected[expected_rank]);
+        }
+    }
+
+    clean_up_items(items);
+}
+
+void test_remove_non_existent_item() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(100);
+    for (Item *item : items) {
+        tree.insert(item->score, item, compare_items);
+    }
+
+    Item missing(50.5, 0);
+    assert(tree.remove(missing.score, &missing, compare_items) == NULL);
+    assert(tree.length() == 100);
+
+    clean_up_items(items);
+}
+
+void test_remove_random() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(5000);
+    for (Item *item : items) {
+        tree.insert(item->score, item, compare_items);
+    }
+    std::vector<Item *> expected = items;
+    std::sort(expected.begin(), expected.end(), item_less);
+
+    std::vector<Item *> order = items;
+    std::shuffle(order.begin(), order.end(), std::mt19937(0));
+    for (uint32_t i = 0; i < order.size(); i++) {
+        // remove using a copy of the item as the key
+        Item key = *order[i];
+        assert(tree.remove(key.score, &key, compare_items) == order[i]);
+        expected.erase(std::lower_bound(expected.begin(), expected.end(), order[i], item_less));
+        if (i % 97 == 0 || expected.size() < 50) {
+            check_tree(&tree, expected);
+        }
+    }
+
+    check_tree(&tree, expected);
+
+    clean_up_items(items);
+}
+
+void test_remove_from_front() {
+    BPlusTree tree;
+    std::vector<Item *> items;
+    for (uint32_t i = 0; i < 2000; i++) {
+        items.push_back(new Item(i, i));
+        tree.insert(i, items.back(), compare_items);
+    }
+
+    std::vector<Item *> expected = items;
+    while (!expected.empty()) {
+        assert(tree.remove(expected[0]->score, expected[0], compare_items) == expected[0]);
+        expected.erase(expected.begin());
+        if (expected.size() % 50 == 0) {
+            check_tree(&tree, expected);
+        }
+    }
+
+    clean_up_items(items);
+}
+
+void test_interleaved_insert_and_remove() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(4000);
+    std::vector<Item *> expected;
+    for (uint32_t i = 0; i < items.size(); i++) {
+        tree.insert(items[i]->score, items[i], compare_items);
+        expected.insert(std::upper_bound(expected.begin(), expected.end(), items[i], item_less), items[i]);
+
+        if (i % 3 == 0) {
+            Item *victim = expected[rand() % expected.size()];
+            assert(tree.remove(victim->score, victim, compare_items) == victim);
+            expected.erase(std::lower_bound(expected.begin(), expected.end(), victim, item_less));
+        }
+    }
+
+    check_tree(&tree, expected);
+
+    clean_up_items(items);
+}
+
+void test_remove_range() {
+    std::vector<Item *> items = create_items(3000);
+    std::vector<Item *> sorted = items;
+    std::sort(sorted.begin(), sorted.end(), item_less);
+
+    // ranges at the ends, in the middle, within one leaf, and covering everything
+    uint64_t ranges[][2] = { { 0, 0 }, { 0, 99 }, { 2900, 2999 }, { 1000, 1999 }, { 17, 20 }, { 1, 2998 }, { 0, 2999 } };
+    for (auto &range : ranges) {
+        BPlusTree tree;
+        for (Item *item : items) {
+            tree.insert(item->score, item, compare_items);
+        }
+
+        BPlusTree removed;
+        tree.remove_range(range[0], range[1], removed);
+
+        std::vector<Item *> expected_removed(sorted.begin() + range[0], sorted.begin() + range[1] + 1);
+        std::vector<Item *> expected = sorted;
+        expected.erase(expected.begin() + range[0], expected.begin() + range[1] + 1);
+        check_tree(&tree, expected);
+        check_tree(&removed, expected_removed);
+    }
+
+    clean_up_items(items);
+}
+
+void test_remove_range_random() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(20000);
+    for (Item *item : items) {
+        tree.insert(item->score, item, compare_items);
+    }
+    std::vector<Item *> expected = items;
+    std::sort(expected.begin(), expected.end(), item_less);
+
+    while (!expected.empty()) {
+        uint64_t first = rand() % expected.size();
+        uint64_t last = std::min(first + rand() % 700, (uint64_t) expected.size() - 1);
+
+        BPlusTree removed;
+        tree.remove_range(first, last, removed);
+
+        std::vector<Item *> expected_removed(expected.begin() + first, expected.begin() + last + 1);
+        expected.erase(expected.begin() + first, expected.begin() + last + 1);
+        check_tree(&tree, expected);
+        check_tree(&removed, expected_removed);
+    }
+
+    clean_up_items(items);
+}
+
+void test_join() {
+    // trees of different heights on either side
+    uint32_t sizes[][2] = { { 0, 10 }, { 10, 0 }, { 5, 5 }, { 1, 3000 }, { 3000, 1 }, { 200, 5000 }, { 5000, 200 }, 
+                            { 3000, 3000 } };
+    for (auto &size : sizes) {
+        BPlusTree left;
+        BPlusTree right;
+        std::vector<Item *> items;
+        for (uint32_t i = 0; i < size[0] + size[1]; i++) {
+            items.push_back(new Item(i, i));
+            (i < size[0] ? left : right).insert(i, items.back(), compare_items);
+        }
+
+        left.join(right);
+
+        check_tree(&left, items);
+        check_tree(&right, std::vector<Item *>());
+
+        clean_up_items(items);
+    }
+}
+
+void test_build() {
+    // sizes around the edges of a full leaf and a full level of inner nodes
+    uint32_t sizes[] = { 0, 1, 15, 16, 17, 33, 256, 257, 4096, 4097, 100000 };
+    for (uint32_t size : sizes) {
+        std::vector<Item *> items = create_items(size);
+        std::sort(items.begin(), items.end(), item_less);
+        std::vector<double> scores;
+        for (Item *item : items) {
+            scores.push_back(item->score);
+        }
+
+        BPlusTree tree;
+        tree.build(scores.data(), (void *const *) items.data(), size);
+        check_tree(&tree, items);
+
+        // the built tree works like any other
+        uint32_t rank = size / 2;
+        if (size > 0) {
+            assert(tree.rank(items[rank]->score, items[rank], compare_items) == (int64_t) rank);
+            assert(tree.remove(items[rank]->score, items[rank], compare_items) == items[rank]);
+            tree.insert(items[rank]->score, items[rank], compare_items);
+        }
+        check_tree(&tree, items);
+
+        clean_up_items(items);
+    }
+}
+
+void test_build_memory_usage() {
+    std::vector<Item *> items;
+    std::vector<double> scores;
+    for (uint32_t i = 0; i < 1000; i++) {
+        items.push_back(new Item(i, i));
+        scores.push_back(i);
+    }
+
+    BPlusTree built;
+    built.build(scores.data(), (void *const *) items.data(), items.size());
+    BPlusTree inserted;
+    for (Item *item : items) {
+        inserted.insert(item->score, item, compare_items);
+    }
+
+    // inserting in order leaves every leaf half full, while building packs them
+    assert(built.memory_usage() < inserted.memory_usage());
+    assert(built.memory_usage() >= (1000 / BPlusNode::CAPACITY) * sizeof(BPlusLeaf));
+
+    clean_up_items(items);
+}
+
+void test_replace() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(2000);
+    for (Item *item : items) {
+        tree.insert(item->score, item, compare_items);
+    }
+
+    // move every item to a new address, including those used as separators
+    std::vector<Item *> copies;
+    for (Item *item : items) {
+        copies.push_back(new Item(*item));
+        assert(tree.replace(item->score, item, copies.back(), compare_items));
+    }
+    clean_up_items(items);
+
+    std::vector<Item *> expected = copies;
+    std::sort(expected.begin(), expected.end(), item_less);
+    check_tree(&tree, expected);
+
+    Item missing(50.5, 0);
+    assert(!tree.replace(missing.score, &missing, &missing, compare_items));
+
+    clean_up_items(copies);
+}
+
+void test_for_each() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(500);
+    for (Item *item : items) {
+        tree.insert(item->score, item, compare_items);
+    }
+    std::vector<Item *> expected = items;
+    std::sort(expected.begin(), expected.end(), item_less);
+
+    std::vector<Item *> visited;
+    tree.for_each([](void *item, void *arg) {
+        ((std::vector<Item *> *) arg)->push_back((Item *) item);
+    }, &visited);
+    assert(visited == expected);
+
+    clean_up_items(items);
+}
+
+void test_memory_usage() {
+    BPlusTree tree;
+    std::vector<Item *> items = create_items(1000);
+    for (Item *item : items) {
+        tree.insert(item->score, item, compare_items);
+    }
+
+    // leaves are at least half full
+    uint64_t max_leaves = 1000 / BPlusNode::MIN_FILL;
+    assert(tree.memory_usage() >= (1000 / BPlusNode::CAPACITY) * sizeof(BPlusLeaf));
+    assert(tree.memory_usage() <= 2 * max_leaves * sizeof(BPlusLeaf));
+
+    for (Item *item : items) {
+        tree.remove(item->score, item, compare_items);
+    }
+    assert(tree.memory_usage() == 0);
+
+    clean_up_items(items);
+}
+
+void test_node_layout() {
+    assert(sizeof(BPlusLeaf) % 64 == 0);
+    assert(sizeof(BPlusInner) % 64 == 0);
+    assert(alignof(BPlusNode) == 64);
+}
+
+int main() {
+    srand(0);
+
+    test_empty_tree();
+
+    test_insert_ascending();
+    test_insert_descending();
+    test_insert_random();
+
+    test_rank();
+    test_seek();
+    test_find_first_ge();
+
+    test_remove_non_existent_item();
+    test_remove_random();
+    test_remove_from_front();
+    test_interleaved_insert_and_remove();
+
+    test_remove_range();
+    test_remove_range_random();
+    test_join();
+
+    test_build();
+    test_build_memory_usage();
+
+    test_replace();
+    test_for_each();
+    test_memory_usage();
+    test_node_layout();
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "BackgroundJobs.hpp"
+#include "../utils/log.hpp"
+
+BackgroundJobs::BackgroundJobs() {
+    pthread_mutex_init(&mu, NULL);
+    if (pipe(notify_fds) == -1) {
+        fatal("failed to create background job pipe");
+    }
+
+    // neither end should ever block: a full pipe already has a wake-up pending, and an empty one has nothing to drain
+    for (int fd : notify_fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+}
+
+BackgroundJobs::~BackgroundJobs() {
+    close(notify_fds[0]);
+    close(notify_fds[1]);
+    pthread_mutex_destroy(&mu);
+}
+
+BackgroundJobs &BackgroundJobs::shared() {
+    static BackgroundJobs jobs;
+    return jobs;
+}
+
+void BackgroundJobs::run_job(void *arg) {
+    BackgroundJob *job = (BackgroundJob *) arg;
+    job->run();
+
+    BackgroundJobs *jobs = job->owner;
+    pthread_mutex_lock(&jobs->mu);
+    jobs->finished.push_back(job);
+    pthread_mutex_unlock(&jobs->mu);
+
+    char byte = 0;
+    if (write(jobs->notify_fds[1], &byte, 1) == -1) {
+        debug("background job pipe is full, event loop already has a wake-up pending");
+    }
+}
+
+void BackgroundJobs::submit(BackgroundJob *job, ThreadPool &thread_pool) {
+    job->owner = this;
+    thread_pool.add_task({ &run_job, (void *) job });
+}
+
+int BackgroundJobs::get_fd() {
+    return notify_fds[0];
+}
+
+std::vector<BackgroundJob *> BackgroundJobs::take_finished() {
+    char buf[64];
+    while (read(notify_fds[0], buf, sizeof(buf)) > 0) {}
+
+    std::vector<BackgroundJob *> jobs;
+    pthread_mutex_lock(&mu);
+    jobs.swap(finished);
+    pthread_mutex_unlock(&mu);
+    return jobs;
+}
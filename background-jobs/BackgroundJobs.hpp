@@ -0,0 +1,99 @@
+#pragma once
+
+#include <memory>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "../evictor/Evictor.hpp"
+#include "../hashmap/HMap.hpp"
+#include "../response/Response.hpp"
+#include "../thread-pool/ThreadPool.hpp"
+#include "../timers/TimerManager.hpp"
+
+// Forward declaration to break circular dependency
+class Conn;
+class BackgroundJobs;
+
+/**
+ * A command whose work is too big to do on the event loop.
+ * 
+ * The job runs on a thread pool worker against data it owns (e.g. Snapshots of the kv store entries it reads), then
+ * finishes on the event loop, where it can safely change the kv store and produce the command's response.
+ */
+class BackgroundJob {
+    public:
+        Conn *conn = NULL; // connection waiting for the response, NULL if there is none or it has closed
+
+        virtual ~BackgroundJob() {}
+
+        /* Does the work of the job. Called on a thread pool worker, so must not touch the kv store. */
+        virtual void run() = 0;
+
+        /**
+         * Applies the result of the job. Called on the event loop once run() has returned.
+         * 
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool used for asynchronous work.
+         * @param evictor       Reference to the evictor.
+         * 
+         * @return  The response to the command.
+         */
+        virtual std::unique_ptr<Response> finish(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool,
+                                                 Evictor &evictor) = 0;
+
+        /* Returns the keys finish() changed, so their new values can be logged to the append-only file */
+        virtual std::vector<std::string> get_changed_keys() {
+            return {};
+        }
+    private:
+        friend class BackgroundJobs;
+
+        BackgroundJobs *owner = NULL;
+};
+
+/**
+ * Runs BackgroundJobs on the thread pool and hands them back to the event loop once they are done.
+ * 
+ * Finished jobs are queued and a byte is written to a pipe, so the event loop can poll the pipe alongside its sockets
+ * and wake up as soon as a job finishes.
+ */
+class BackgroundJobs {
+    private:
+        pthread_mutex_t mu;
+        std::vector<BackgroundJob *> finished; // jobs that have run, waiting to be finished on the event loop
+        int notify_fds[2]; // pipe written to when a job is done running, read end first
+
+        /**
+         * Thread pool task which runs a BackgroundJob then queues it to be finished.
+         * 
+         * @param arg   Void pointer to the BackgroundJob.
+         */
+        static void run_job(void *arg);
+    public:
+        BackgroundJobs();
+
+        ~BackgroundJobs();
+
+        /* Returns the BackgroundJobs used by the event loop */
+        static BackgroundJobs &shared();
+
+        /**
+         * Runs a job on the thread pool.
+         * 
+         * @param job           Pointer to the job. Ownership passes back to the caller through take_finished().
+         * @param thread_pool   Reference to the thread pool.
+         */
+        void submit(BackgroundJob *job, ThreadPool &thread_pool);
+
+        /* Returns the file descriptor that becomes readable when a job is done running */
+        int get_fd();
+
+        /**
+         * Takes the jobs that are done running, to be finished on the event loop.
+         * 
+         * @return  Vector containing the jobs, in the order they finished running.
+         */
+        std::vector<BackgroundJob *> take_finished();
+};
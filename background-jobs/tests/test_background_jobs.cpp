@@ -0,0 +1,94 @@
+#include <assert.h>
+#include <poll.h>
+
+#include "../BackgroundJobs.hpp"
+#include "../../response/types/IntResponse.hpp"
+
+/* Job which records the thread it ran on and responds with a number */
+class TestJob : public BackgroundJob {
+    public:
+        uint32_t value;
+        pthread_t ran_on;
+
+        TestJob(uint32_t value) : value(value) {}
+
+        void run() override {
+            ran_on = pthread_self();
+        }
+
+        std::unique_ptr<Response> finish(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool,
+                                         Evictor &evictor) override {
+            (void) kv_store;
+            (void) timers;
+            (void) thread_pool;
+            (void) evictor;
+            return std::make_unique<IntResponse>(value);
+        }
+};
+
+/**
+ * Waits until the given number of jobs have finished running.
+ * 
+ * @param jobs  Reference to the BackgroundJobs.
+ * @param n     The number of jobs.
+ * 
+ * @return  Vector containing the finished jobs.
+ */
+std::vector<BackgroundJob *> wait_for_jobs(BackgroundJobs &jobs, uint32_t n) {
+    std::vector<BackgroundJob *> finished;
+    while (finished.size() < n) {
+        struct pollfd pfd = { jobs.get_fd(), POLLIN, 0 };
+        assert(poll(&pfd, 1, 5000) == 1); // the fd wakes the event loop
+        for (BackgroundJob *job : jobs.take_finished()) {
+            finished.push_back(job);
+        }
+    }
+    return finished;
+}
+
+void test_job_runs_on_thread_pool() {
+    BackgroundJobs jobs;
+    ThreadPool thread_pool(1);
+    TestJob *job = new TestJob(7);
+
+    jobs.submit(job, thread_pool);
+    std::vector<BackgroundJob *> finished = wait_for_jobs(jobs, 1);
+
+    assert(finished.size() == 1 && finished[0] == job);
+    assert(pthread_equal(job->ran_on, pthread_self()) == 0);
+    delete job;
+}
+
+void test_many_jobs() {
+    BackgroundJobs jobs;
+    ThreadPool thread_pool(4);
+    for (uint32_t i = 0; i < 100; i++) {
+        jobs.submit(new TestJob(i), thread_pool);
+    }
+
+    std::vector<BackgroundJob *> finished = wait_for_jobs(jobs, 100);
+
+    uint64_t sum = 0;
+    for (BackgroundJob *job : finished) {
+        sum += ((TestJob *) job)->value;
+        delete job;
+    }
+    assert(sum == 4950);
+}
+
+void test_take_finished_with_nothing_finished() {
+    BackgroundJobs jobs;
+
+    assert(jobs.take_finished().empty());
+
+    struct pollfd pfd = { jobs.get_fd(), POLLIN, 0 };
+    assert(poll(&pfd, 1, 0) == 0);
+}
+
+int main() {
+    test_job_runs_on_thread_pool();
+    test_many_jobs();
+    test_take_finished_with_nothing_finished();
+
+    return 0;
+}
@@ -4,24 +4,24 @@
 
 #include "../utils/log.hpp"
 #include "Buffer.hpp"
+#include "components/BufferPool.hpp"
 
-Buffer::Buffer() {
-    init(64 * 1024);
-}
+Buffer::Buffer() : initial_capacity(DEFAULT_CAPACITY) {}
 
-Buffer::Buffer(uint32_t n) {
-    init(n);
-}
+Buffer::Buffer(uint32_t n) : initial_capacity(n) {}
 
 Buffer::~Buffer() {
-    free(buffer_start);
+    reset();
 }
 
 void Buffer::append(const char *arr, uint32_t n) {
+    if (buffer_start == NULL) {
+        reallocate(std::max(initial_capacity, n));
+    }
+
     uint32_t space_at_start = data_start - buffer_start;
     uint32_t space_at_end = buffer_end - data_end;
     uint32_t data_size = data_end - data_start;
-    uint32_t buffer_size = buffer_end - buffer_start;
 
     if (n <= space_at_end) {
         // enough space at end
@@ -29,17 +29,14 @@ void Buffer::append(const char *arr, uint32_t n) {
         data_end += n;
     } else if (n <= space_at_start + space_at_end) {
         // enough space, but need to move current data to the front to make room
-        memcpy(buffer_start, data_start, data_size);
+        memmove(buffer_start, data_start, data_size);
         data_start = buffer_start;
         data_end = data_start + data_size;
         memcpy(data_end, arr, n);
         data_end += n;
     } else {
         // not enough space, need to resize
-        buffer_start = (char *) realloc(buffer_start, 2 * buffer_size);
-        buffer_end = buffer_start + 2 * buffer_size;
-        data_start = buffer_start + space_at_start;
-        data_end = data_start + data_size;
+        reallocate(data_size + n);
         append(arr, n);
     }
 }
@@ -68,6 +65,25 @@ void Buffer::consume(uint32_t n) {
     data_start += std::min(n, size());
 }
 
+bool Buffer::release() {
+    if (buffer_start == NULL || size() != 0) {
+        return false;
+    }
+    reset();
+    return true;
+}
+
+void Buffer::reset() {
+    if (buffer_start == NULL) {
+        return;
+    }
+    BufferPool::shared().release(buffer_start, capacity());
+    buffer_start = NULL;
+    buffer_end = NULL;
+    data_start = NULL;
+    data_end = NULL;
+}
+
 char *Buffer::data() {
     return data_start;
 }
@@ -76,9 +92,22 @@ uint32_t Buffer::size() {
     return data_end - data_start;
 }
 
-void Buffer::init(uint32_t n) {
-    buffer_start = (char *) malloc(n);
-    buffer_end = buffer_start + n;
+uint32_t Buffer::capacity() {
+    return buffer_end - buffer_start;
+}
+
+void Buffer::reallocate(uint32_t n) {
+    uint32_t data_size = size();
+    uint32_t cap;
+    char *arr = BufferPool::shared().alloc(std::max(n, 2 * capacity()), &cap);
+
+    if (buffer_start != NULL) {
+        memcpy(arr, data_start, data_size);
+        BufferPool::shared().release(buffer_start, capacity());
+    }
+
+    buffer_start = arr;
+    buffer_end = buffer_start + cap;
     data_start = buffer_start;
-    data_end = data_start;
+    data_end = data_start + data_size;
 }
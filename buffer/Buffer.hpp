@@ -1,22 +1,36 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
-/* Dynamic byte buffer with constant time append and remove from front */
+/**
+ * Dynamic byte buffer with constant time append and remove from front.
+ * 
+ * Memory for the Buffer is allocated lazily on the first append and comes from the shared BufferPool, so an idle 
+ * Buffer costs nothing beyond the object itself.
+ */
 class Buffer {
     private:
-        char *buffer_start;
-        char *buffer_end;
-        char *data_start;
-        char *data_end;
-        
-        /* Initializes an n-byte Buffer */
-        void init(uint32_t n);
+        static const uint32_t DEFAULT_CAPACITY = 4 * 1024; // 4 KB
+
+        char *buffer_start = NULL;
+        char *buffer_end = NULL;
+        char *data_start = NULL;
+        char *data_end = NULL;
+        uint32_t initial_capacity; // capacity to allocate on first use
+
+        /**
+         * Moves the data into a new array from the BufferPool that can hold at least n bytes, returning the old array 
+         * to the pool.
+         * 
+         * @param n The minimum capacity of the new array.
+         */
+        void reallocate(uint32_t n);
     public:
-        /* Initializes a 64 KB Buffer */
+        /* Initializes a Buffer that will allocate 4 KB on first use */
         Buffer();
 
-        /* Initializes an n-byte Buffer */
+        /* Initializes a Buffer that will allocate n bytes on first use */
         Buffer(uint32_t n);
 
         ~Buffer();
@@ -49,9 +63,23 @@ class Buffer {
          */
         void consume(uint32_t n);
 
+        /**
+         * Returns the Buffer's memory to the BufferPool if the Buffer is empty. The next append will allocate again.
+         * 
+         * @return  True if memory was released.
+         *          False if the Buffer still holds data or has nothing allocated.
+         */
+        bool release();
+
+        /* Discards any data in the Buffer and returns its memory to the BufferPool */
+        void reset();
+
         /* Returns a direct pointer to the start of the data in the Buffer */
         char *data();
 
         /* Returns the number of bytes in the Buffer */
         uint32_t size();
+
+        /* Returns the number of bytes allocated for the Buffer */
+        uint32_t capacity();
 };
@@ -0,0 +1,67 @@
+#include <cstdlib>
+
+#include "BufferPool.hpp"
+
+BufferPool::~BufferPool() {
+    for (std::vector<char *> &free_list : free_lists) {
+        for (char *arr : free_list) {
+            free(arr);
+        }
+    }
+}
+
+BufferPool &BufferPool::shared() {
+    // never destroyed so Buffers with static storage duration can still release their arrays at exit
+    static BufferPool *pool = new BufferPool();
+    return *pool;
+}
+
+uint32_t BufferPool::class_size(uint32_t n) {
+    uint32_t cap = MIN_CLASS_SIZE;
+    while (cap < n && cap < (1u << 31)) {
+        cap *= 2;
+    }
+    return cap;
+}
+
+char *BufferPool::alloc(uint32_t n, uint32_t *cap) {
+    *cap = class_size(n);
+
+    int8_t i = class_index(*cap);
+    if (i != -1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!free_lists[i].empty()) {
+            char *arr = free_lists[i].back();
+            free_lists[i].pop_back();
+            return arr;
+        }
+    }
+
+    return (char *) malloc(*cap);
+}
+
+void BufferPool::release(char *arr, uint32_t cap) {
+    int8_t i = class_index(cap);
+    if (i != -1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free_lists[i].size() < MAX_FREE_PER_CLASS) {
+            free_lists[i].push_back(arr);
+            return;
+        }
+    }
+    free(arr);
+}
+
+uint32_t BufferPool::num_free(uint32_t n) {
+    int8_t i = class_index(class_size(n));
+    std::lock_guard<std::mutex> lock(mutex);
+    return i != -1 ? free_lists[i].size() : 0;
+}
+
+int8_t BufferPool::class_index(uint32_t cap) {
+    int8_t i = 0;
+    for (uint32_t size = MIN_CLASS_SIZE; size < cap; size *= 2) {
+        i++;
+    }
+    return i < NUM_CLASSES ? i : -1;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * A pool of byte arrays grouped into power-of-two size classes.
+ * 
+ * Freed arrays are kept on a per-class free list so they can be handed out again without going back to malloc. Arrays 
+ * larger than the biggest size class bypass the pool. The pool is thread-safe, since background jobs on the thread pool 
+ * use Buffers too (e.g. migrate's connection to the target). Buffers only go to the pool when they grow or give their 
+ * memory back, not on every append, and malloc() and free() are called outside the lock.
+ */
+class BufferPool {
+    public:
+        static const uint32_t MIN_CLASS_SIZE = 1024; // 1 KB
+        static const uint8_t NUM_CLASSES = 11; // 1 KB, 2 KB, ..., 1 MB
+        static const uint32_t MAX_FREE_PER_CLASS = 64; // caps the memory held by each free list
+
+        ~BufferPool();
+
+        /* Returns the pool shared by all Buffers */
+        static BufferPool &shared();
+
+        /* Returns the capacity that an n-byte request is rounded up to */
+        static uint32_t class_size(uint32_t n);
+
+        /**
+         * Allocates an array with at least n bytes.
+         * 
+         * @param n     The minimum number of bytes required.
+         * @param cap   Pointer to a uint32_t where the actual capacity of the array will be stored.
+         * 
+         * @return  Pointer to the array.
+         */
+        char *alloc(uint32_t n, uint32_t *cap);
+
+        /**
+         * Returns an array to the pool. If the free list for its size class is full, the array is freed instead.
+         * 
+         * @param arr   Pointer to the array.
+         * @param cap   The capacity of the array, as returned by alloc().
+         */
+        void release(char *arr, uint32_t cap);
+
+        /* Returns the number of arrays on the free list for the size class that fits n bytes */
+        uint32_t num_free(uint32_t n);
+    private:
+        std::mutex mutex; // guards free_lists
+        std::vector<char *> free_lists[NUM_CLASSES];
+
+        /**
+         * Gets the index of the size class for a capacity.
+         * 
+         * @param cap   A capacity returned by class_size().
+         * 
+         * @return  The index of the size class.
+         *          -1 if the capacity is larger than the biggest size class.
+         */
+        static int8_t class_index(uint32_t cap);
+};
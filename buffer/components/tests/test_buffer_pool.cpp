@@ -0,0 +1,97 @@
+#include <assert.h>
+
+#include "../BufferPool.hpp"
+
+void test_class_size() {
+    assert(BufferPool::class_size(1) == BufferPool::MIN_CLASS_SIZE);
+    assert(BufferPool::class_size(BufferPool::MIN_CLASS_SIZE) == BufferPool::MIN_CLASS_SIZE);
+    assert(BufferPool::class_size(BufferPool::MIN_CLASS_SIZE + 1) == 2 * BufferPool::MIN_CLASS_SIZE);
+    assert(BufferPool::class_size(64 * 1024) == 64 * 1024);
+}
+
+void test_alloc_rounds_up_to_class_size() {
+    BufferPool pool;
+
+    uint32_t cap;
+    char *arr = pool.alloc(3000, &cap);
+
+    assert(arr != NULL);
+    assert(cap == 4096);
+
+    pool.release(arr, cap);
+}
+
+void test_release_then_alloc_reuses_array() {
+    BufferPool pool;
+
+    uint32_t cap;
+    char *arr = pool.alloc(4096, &cap);
+    pool.release(arr, cap);
+
+    assert(pool.num_free(4096) == 1);
+
+    uint32_t new_cap;
+    char *new_arr = pool.alloc(4000, &new_cap);
+
+    assert(new_arr == arr);
+    assert(new_cap == cap);
+    assert(pool.num_free(4096) == 0);
+
+    pool.release(new_arr, new_cap);
+}
+
+void test_release_different_class_not_reused() {
+    BufferPool pool;
+
+    uint32_t cap;
+    char *arr = pool.alloc(4096, &cap);
+    pool.release(arr, cap);
+
+    uint32_t new_cap;
+    char *new_arr = pool.alloc(1024, &new_cap);
+
+    assert(new_cap == 1024);
+    assert(pool.num_free(4096) == 1);
+
+    pool.release(new_arr, new_cap);
+}
+
+void test_release_full_free_list() {
+    BufferPool pool;
+
+    char *arrs[BufferPool::MAX_FREE_PER_CLASS + 1];
+    uint32_t cap;
+    for (uint32_t i = 0; i <= BufferPool::MAX_FREE_PER_CLASS; i++) {
+        arrs[i] = pool.alloc(1024, &cap);
+    }
+    for (uint32_t i = 0; i <= BufferPool::MAX_FREE_PER_CLASS; i++) {
+        pool.release(arrs[i], cap);
+    }
+
+    assert(pool.num_free(1024) == BufferPool::MAX_FREE_PER_CLASS);
+}
+
+void test_alloc_larger_than_biggest_class() {
+    BufferPool pool;
+
+    uint32_t cap;
+    char *arr = pool.alloc(4 * 1024 * 1024, &cap);
+
+    assert(cap == 4 * 1024 * 1024);
+
+    pool.release(arr, cap);
+
+    assert(pool.num_free(4 * 1024 * 1024) == 0);
+}
+
+int main() {
+    test_class_size();
+
+    test_alloc_rounds_up_to_class_size();
+    test_release_then_alloc_reuses_array();
+    test_release_different_class_not_reused();
+    test_release_full_free_list();
+    test_alloc_larger_than_biggest_class();
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include <cstring>
+#include <string>
 #include <assert.h>
 
 #include "../Buffer.hpp"
@@ -100,6 +101,65 @@ void test_consume_exceeds_buffer_size() {
     assert(buf.size() == 0);
 }
 
+void test_no_memory_until_first_append() {
+    Buffer buf;
+
+    assert(buf.capacity() == 0);
+    assert(buf.size() == 0);
+
+    buf.append("a", 1);
+
+    assert(buf.capacity() > 0);
+}
+
+void test_append_grows_past_size_class() {
+    Buffer buf(4);
+
+    std::string data(3000, 'x');
+    buf.append(data.data(), 1000);
+    buf.append(data.data(), 2000);
+
+    assert(buf.size() == 3000);
+    assert(buf.capacity() >= 3000);
+    assert(memcmp(buf.data(), data.data(), 3000) == 0);
+}
+
+void test_release_empty_buffer() {
+    Buffer buf(4);
+
+    const char *word = "test";
+    buf.append(word, strlen(word));
+    buf.consume(4);
+
+    assert(buf.release() == true);
+    assert(buf.capacity() == 0);
+
+    // buffer is usable again after being released
+    buf.append(word, strlen(word));
+    assert(buf.size() == 4);
+    assert(strncmp(buf.data(), "test", 4) == 0);
+}
+
+void test_release_non_empty_buffer() {
+    Buffer buf(4);
+
+    const char *word = "test";
+    buf.append(word, strlen(word));
+
+    assert(buf.release() == false);
+    assert(buf.size() == 4);
+}
+
+void test_reset() {
+    Buffer buf(4);
+
+    const char *word = "test";
+    buf.append(word, strlen(word));
+    buf.reset();
+
+    assert(buf.size() == 0);
+    assert(buf.capacity() == 0);
+}
 
 int main() {
     test_append();
@@ -114,5 +174,11 @@ int main() {
     test_consume();
     test_consume_exceeds_buffer_size();
 
+    test_no_memory_until_first_append();
+    test_append_grows_past_size_class();
+    test_release_empty_buffer();
+    test_release_non_empty_buffer();
+    test_reset();
+
     return 0;
 }
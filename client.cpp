@@ -6,6 +6,7 @@
 #include <netdb.h>
 #include <unistd.h>
 
+#include "cluster/components/ClusterClient.hpp"
 #include "utils/net_utils.hpp"
 #include "utils/log.hpp"
 #include "constants.hpp"
@@ -16,10 +17,12 @@
 /**
  * Gets the server's address info which can be used in connect(). 
  * 
+ * @param port  The server's port.
+ * 
  * @return  Pointer to a struct addrinfo on success. Should be freed when no longer in use.
  *          NULL on error.
  */
-struct addrinfo *get_server_addr_info() {
+struct addrinfo *get_server_addr_info(const char *port) {
     struct addrinfo *res;
     struct addrinfo hints;
 
@@ -27,7 +30,7 @@ struct addrinfo *get_server_addr_info() {
     hints.ai_family = AF_UNSPEC;        // IPv4 or IPv6
     hints.ai_socktype = SOCK_STREAM;    // Stream socket
 
-    if (getaddrinfo(NULL, PORT, &hints, &res) != 0) { // node == NULL so loopback address is returned
+    if (getaddrinfo(NULL, port, &hints, &res) != 0) { // node == NULL so loopback address is returned
         return NULL;
     }
 
@@ -98,7 +101,7 @@ bool send_request(int server, Request request) {
  *          False on failure.
  */
 bool recv_response(int server, char *buf, uint32_t *n) {
-    if (recv_all(server, buf, Response::HEADER_SIZE) == -1) {
+    if (recv_all(server, buf, Response::HEADER_SIZE) != 1) {
         debug("failed to receive response header: %s", strerror(errno));
         return false;
     }
@@ -110,7 +113,7 @@ bool recv_response(int server, char *buf, uint32_t *n) {
         return false;
     }
 
-    if (recv_all(server, buf, len) == -1) {
+    if (recv_all(server, buf, len) != 1) {
         debug("failed to receive response body: %s", strerror(errno));
         return false;
     }
@@ -154,7 +157,28 @@ bool handle_response(int server) {
 }
 
 int main(int argc, char *argv[]) {
-    struct addrinfo *res = get_server_addr_info();
+    // ./client [-p <port>] [-c] <command>
+    const char *port = PORT;
+    int first_arg = 1;
+    if (argc >= 3 && strcmp(argv[1], "-p") == 0) {
+        port = argv[2];
+        first_arg = 3;
+    }
+    bool cluster_mode = false;
+    if (first_arg < argc && strcmp(argv[first_arg], "-c") == 0) {
+        cluster_mode = true; // follow MOVED and ASK redirects to the node owning the key
+        first_arg++;
+    }
+
+    if (cluster_mode) {
+        std::vector<std::string> command(argv + first_arg, argv + argc);
+        ClusterClient client(std::string("127.0.0.1:") + port);
+        std::vector<std::unique_ptr<Response>> responses = client.execute({ command });
+        printf("%s\n", responses[0]->to_string().data());
+        return 0;
+    }
+
+    struct addrinfo *res = get_server_addr_info(port);
     if (res == NULL) {
         fatal("failed to get server's addrinfo");
     }
@@ -169,7 +193,7 @@ int main(int argc, char *argv[]) {
     debug("connected to server");
 
     std::vector<std::string> command;
-    for (int i = 1; i < argc; i++) {
+    for (int i = first_arg; i < argc; i++) {
         command.push_back(argv[i]);
     }
 
@@ -186,5 +210,12 @@ int main(int argc, char *argv[]) {
         fatal("failed to handle response");
     }
 
+    if (!command.empty() && (command[0] == "subscribe" || command[0] == "psubscribe")) {
+        // print the messages pushed to the subscription as they come, until the server closes the connection
+        do {
+            fflush(stdout);
+        } while (handle_response(server));
+    }
+
     return 0;
 }
@@ -0,0 +1,214 @@
+#include "Cluster.hpp"
+#include "../conn/Conn.hpp"
+#include "../response/types/ErrResponse.hpp"
+#include "../response/types/StrResponse.hpp"
+#include "../utils/hash_utils.hpp"
+#include "../utils/log.hpp"
+
+Cluster::Cluster() : owners(CLUSTER_SLOTS, NO_NODE), migrating(CLUSTER_SLOTS, NO_NODE),
+                     importing(CLUSTER_SLOTS, NO_NODE) {}
+
+Cluster &Cluster::shared() {
+    static Cluster cluster;
+    return cluster;
+}
+
+int32_t Cluster::find_node(const std::string &node) {
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i] == node) {
+            return i;
+        }
+    }
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+void Cluster::enable(const std::string &node) {
+    if (enabled) {
+        return;
+    }
+
+    enabled = true;
+    myself = find_node(node);
+    index = new SlotIndex();
+    log("cluster mode enabled as %s", node.data());
+}
+
+bool Cluster::is_enabled() {
+    return enabled;
+}
+
+void Cluster::add_key(Entry *entry) {
+    if (index != NULL) {
+        index->add(entry);
+    }
+}
+
+void Cluster::remove_key(Entry *entry) {
+    if (index != NULL) {
+        index->remove(entry);
+    }
+}
+
+void Cluster::move_key(Entry *from, Entry *to) {
+    if (index != NULL) {
+        index->replace(from, to);
+    }
+}
+
+/* Checks if a key is in the kv store, expired or not */
+bool has_key(HMap &kv_store, const std::string &key) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = key;
+    lookup_entry.node.hval = str_hash(key);
+    return kv_store.lookup(&lookup_entry.node, are_entries_equal) != NULL;
+}
+
+std::unique_ptr<Response> Cluster::route(Conn *conn, const std::vector<std::string> &command, HMap &kv_store) {
+    if (!enabled || command.empty()) {
+        return nullptr;
+    }
+
+    if (command.size() == 1 && command[0] == "asking") {
+        conn->asking = true;
+        log("connection %d asking", conn->fd);
+        return std::make_unique<StrResponse>("OK");
+    }
+    // asking only lets the command right after it through, restore-asking is sent by migrate and always asks
+    bool asking = conn->asking || command[0] == "restore-asking";
+    conn->asking = false;
+
+    std::vector<std::string> keys = get_command_keys(command);
+    if (keys.empty()) {
+        return nullptr;
+    }
+
+    uint16_t slot = key_hash_slot(keys[0]);
+    for (uint32_t i = 1; i < keys.size(); i++) {
+        if (key_hash_slot(keys[i]) != slot) {
+            log("cluster: keys of %s are in different slots", command[0].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG,
+                                                 "CROSSSLOT Keys in request don't hash to the same slot");
+        }
+    }
+
+    int32_t owner = owners[slot];
+    if (owner == NO_NODE) {
+        log("cluster: slot %u is unassigned", slot);
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "CLUSTERDOWN Hash slot not served");
+    }
+
+    if (owner != myself) {
+        if (asking && importing[slot] != NO_NODE) {
+            return nullptr;
+        }
+
+        stats.moved++;
+        log("cluster: slot %u moved to %s", slot, nodes[owner].data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_MOVED,
+                                             "MOVED " + std::to_string(slot) + " " + nodes[owner]);
+    }
+
+    if (migrating[slot] != NO_NODE) {
+        // keys still here are served here, the ones already moved (or never created) are served by the target
+        uint32_t missing = 0;
+        for (const std::string &key : keys) {
+            missing += !has_key(kv_store, key);
+        }
+
+        if (missing == keys.size()) {
+            stats.ask++;
+            log("cluster: slot %u is migrating, asking %s", slot, nodes[migrating[slot]].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_ASK,
+                                                 "ASK " + std::to_string(slot) + " " + nodes[migrating[slot]]);
+        } else if (missing > 0) {
+            log("cluster: keys of %s are split by the migration of slot %u", command[0].data(), slot);
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN,
+                                                 "TRYAGAIN Multiple keys request during rehashing of slot");
+        }
+    }
+
+    return nullptr;
+}
+
+void Cluster::set_slot_node(uint16_t slot, const std::string &node) {
+    owners[slot] = find_node(node);
+    migrating[slot] = NO_NODE;
+    importing[slot] = NO_NODE;
+}
+
+bool Cluster::set_slot_migrating(uint16_t slot, const std::string &node) {
+    if (owners[slot] != myself) {
+        return false;
+    }
+
+    migrating[slot] = find_node(node);
+    return true;
+}
+
+bool Cluster::set_slot_importing(uint16_t slot, const std::string &node) {
+    if (owners[slot] == myself) {
+        return false;
+    }
+
+    importing[slot] = find_node(node);
+    return true;
+}
+
+void Cluster::set_slot_stable(uint16_t slot) {
+    migrating[slot] = NO_NODE;
+    importing[slot] = NO_NODE;
+}
+
+std::string Cluster::get_slot_node(uint16_t slot) {
+    return owners[slot] == NO_NODE ? "" : nodes[owners[slot]];
+}
+
+std::vector<SlotRange> Cluster::get_slot_ranges() {
+    std::vector<SlotRange> ranges;
+    uint32_t start = 0;
+    while (start < CLUSTER_SLOTS) {
+        uint32_t end = start;
+        while (end + 1 < CLUSTER_SLOTS && owners[end + 1] == owners[start]) {
+            end++;
+        }
+        if (owners[start] != NO_NODE) {
+            ranges.push_back({ (uint16_t) start, (uint16_t) end, nodes[owners[start]] });
+        }
+        start = end + 1;
+    }
+    return ranges;
+}
+
+uint32_t Cluster::count_keys_in_slot(uint16_t slot) {
+    return index == NULL ? 0 : index->count(slot);
+}
+
+std::vector<std::string> Cluster::get_keys_in_slot(uint16_t slot, uint32_t max) {
+    return index == NULL ? std::vector<std::string>() : index->get_keys(slot, max);
+}
+
+const std::string &Cluster::get_myself() {
+    static const std::string none;
+    return myself == NO_NODE ? none : nodes[myself];
+}
+
+uint32_t Cluster::get_slots_assigned() {
+    uint32_t assigned = 0;
+    for (int32_t owner : owners) {
+        assigned += owner != NO_NODE;
+    }
+    return assigned;
+}
+
+uint32_t Cluster::get_slots_owned() {
+    uint32_t owned = 0;
+    for (int32_t owner : owners) {
+        owned += owner != NO_NODE && owner == myself;
+    }
+    return owned;
+}
+
+const ClusterStats &Cluster::get_stats() {
+    return stats;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "components/KeySlot.hpp"
+#include "components/SlotIndex.hpp"
+#include "../entry/Entry.hpp"
+#include "../hashmap/HMap.hpp"
+#include "../response/Response.hpp"
+
+// Forward declaration to break circular dependency
+class Conn;
+
+/* A run of consecutive slots owned by the same node */
+struct SlotRange {
+    uint16_t start;
+    uint16_t end; // inclusive
+    std::string node; // "host:port"
+};
+
+/* Stats for cluster mode */
+struct ClusterStats {
+    uint64_t moved = 0; // requests redirected to the owner of their slot
+    uint64_t ask = 0; // requests redirected to the node a slot is migrating to
+};
+
+/**
+ * Cluster mode: the key space is split into CLUSTER_SLOTS hash slots (see key_hash_slot()) and each slot is owned by 
+ * one node.
+ * 
+ * A request whose keys are in a slot owned by another node is answered with "MOVED <slot> <host:port>", telling the 
+ * client where the slot lives so it can update its map and retry there. While a slot is being migrated, the source 
+ * node keeps serving the keys it still holds and answers requests for the others with "ASK <slot> <host:port>". The 
+ * client then sends the request to the target prefixed with asking, which lets the target serve a slot it's importing 
+ * but doesn't own yet. Once every key has been moved, the slot is assigned to the target on all nodes.
+ * 
+ * Nodes don't talk to each other: the slot map is set on every node with the cluster command by whoever administers 
+ * the cluster. Each node keeps an index of its keys by slot so a slot's keys can be counted and listed for migration.
+ */
+class Cluster {
+    private:
+        static const int32_t NO_NODE = -1;
+
+        bool enabled = false;
+        int32_t myself = NO_NODE; // index of this node in nodes
+        std::vector<std::string> nodes; // "host:port" of every node named in the slot map
+        std::vector<int32_t> owners; // node owning each slot, NO_NODE if unassigned
+        std::vector<int32_t> migrating; // node each slot is migrating to, NO_NODE if it isn't
+        std::vector<int32_t> importing; // node each slot is importing from, NO_NODE if it isn't
+        SlotIndex *index = NULL; // created once cluster mode is enabled
+        ClusterStats stats;
+
+        /**
+         * Gets the index of a node in nodes, adding it if it's new.
+         * 
+         * @param node  The node's "host:port".
+         * 
+         * @return  The index.
+         */
+        int32_t find_node(const std::string &node);
+    public:
+        Cluster();
+
+        /* Returns the Cluster used by the event loop */
+        static Cluster &shared();
+
+        /**
+         * Turns cluster mode on. Must be called before any key is added to the kv store, so the index holds every key.
+         * 
+         * @param node  The "host:port" clients reach this node at.
+         */
+        void enable(const std::string &node);
+
+        /* Returns whether cluster mode is on */
+        bool is_enabled();
+
+        /**
+         * Adds an Entry just inserted into the kv store to the index. Does nothing if cluster mode is off.
+         * 
+         * @param entry Pointer to the Entry.
+         */
+        void add_key(Entry *entry);
+
+        /**
+         * Removes an Entry being deleted from the index. Does nothing if cluster mode is off.
+         * 
+         * @param entry Pointer to the Entry.
+         */
+        void remove_key(Entry *entry);
+
+        /**
+         * Puts an Entry in the place of another in the index when it's moved to a new address.
+         * 
+         * @param from  Pointer to the Entry being moved.
+         * @param to    Pointer to where it was moved.
+         */
+        void move_key(Entry *from, Entry *to);
+
+        /**
+         * Decides whether this node should execute a command sent by a client.
+         * 
+         * Also handles asking, which lets the next command from the connection be served for a slot being imported.
+         * 
+         * @param conn      Pointer to the connection.
+         * @param command   The command.
+         * @param kv_store  Reference to the kv store, to check which keys of a migrating slot are still here.
+         * 
+         * @return  One of the following:
+         *          - NULL: the command should be executed here.
+         *          - StrResponse ("OK"): the command was asking.
+         *          - ErrResponse: MOVED or ASK to the node that should execute it, or the command can't be served.
+         */
+        std::unique_ptr<Response> route(Conn *conn, const std::vector<std::string> &command, HMap &kv_store);
+
+        /**
+         * Assigns a slot to a node. Ends any migration or import of the slot.
+         * 
+         * @param slot  The slot.
+         * @param node  The node's "host:port".
+         */
+        void set_slot_node(uint16_t slot, const std::string &node);
+
+        /**
+         * Marks a slot owned by this node as migrating to another node.
+         * 
+         * @param slot  The slot.
+         * @param node  The target's "host:port".
+         * 
+         * @return  True on success.
+         *          False if this node doesn't own the slot.
+         */
+        bool set_slot_migrating(uint16_t slot, const std::string &node);
+
+        /**
+         * Marks a slot owned by another node as being imported from it.
+         * 
+         * @param slot  The slot.
+         * @param node  The source's "host:port".
+         * 
+         * @return  True on success.
+         *          False if this node already owns the slot.
+         */
+        bool set_slot_importing(uint16_t slot, const std::string &node);
+
+        /* Ends any migration or import of a slot */
+        void set_slot_stable(uint16_t slot);
+
+        /* Returns the "host:port" of the node owning a slot, empty if it's unassigned */
+        std::string get_slot_node(uint16_t slot);
+
+        /* Returns the slot map as runs of consecutive slots owned by the same node, in slot order */
+        std::vector<SlotRange> get_slot_ranges();
+
+        /* Returns the number of keys this node holds in a slot */
+        uint32_t count_keys_in_slot(uint16_t slot);
+
+        /**
+         * Gets keys this node holds in a slot.
+         * 
+         * @param slot  The slot.
+         * @param max   The maximum number of keys to get.
+         * 
+         * @return  The keys.
+         */
+        std::vector<std::string> get_keys_in_slot(uint16_t slot, uint32_t max);
+
+        /* Returns the "host:port" of this node */
+        const std::string &get_myself();
+
+        /* Returns the number of slots assigned to some node */
+        uint32_t get_slots_assigned();
+
+        /* Returns the number of slots assigned to this node */
+        uint32_t get_slots_owned();
+
+        /* Returns the stats for cluster mode */
+        const ClusterStats &get_stats();
+};
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "ClusterClient.hpp"
+#include "KeySlot.hpp"
+#include "../../buffer/Buffer.hpp"
+#include "../../request/Request.hpp"
+#include "../../response/types/ArrResponse.hpp"
+#include "../../response/types/ErrResponse.hpp"
+#include "../../response/types/IntResponse.hpp"
+#include "../../response/types/StrResponse.hpp"
+#include "../../utils/buf_utils.hpp"
+#include "../../utils/log.hpp"
+#include "../../utils/net_utils.hpp"
+
+ClusterClient::ClusterClient(const std::string &seed) : seed(seed), slot_nodes(CLUSTER_SLOTS) {}
+
+ClusterClient::~ClusterClient() {
+    for (auto &[node, fd] : sockets) {
+        close(fd);
+    }
+}
+
+int ClusterClient::get_socket(const std::string &node) {
+    auto it = sockets.find(node);
+    if (it != sockets.end()) {
+        return it->second;
+    }
+
+    size_t colon = node.rfind(':');
+    if (colon == std::string::npos) {
+        return -1;
+    }
+    std::string host = node.substr(0, colon);
+    std::string port = node.substr(colon + 1);
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.data(), port.data(), &hints, &res) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *p = res; p != NULL; p = p->ai_next) {
+        if ((fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) == -1) {
+            continue;
+        }
+        if (connect(fd, p->ai_addr, p->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd != -1 && timeout_ms > 0) {
+        struct timeval timeout = { (time_t) timeout_ms / 1000, (suseconds_t) (timeout_ms % 1000) * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    }
+    if (fd != -1) {
+        sockets[node] = fd;
+    }
+    return fd;
+}
+
+void ClusterClient::close_socket(const std::string &node) {
+    auto it = sockets.find(node);
+    if (it != sockets.end()) {
+        close(it->second);
+        sockets.erase(it);
+    }
+}
+
+Response *ClusterClient::recv_response(int fd) {
+    char buf[Response::HEADER_SIZE + Response::MAX_LEN];
+    if (recv_all(fd, buf, Response::HEADER_SIZE) != 1) {
+        return NULL;
+    }
+
+    char *p = buf;
+    uint32_t len;
+    read_uint32(&len, &p);
+    if (len > Response::MAX_LEN || recv_all(fd, buf + Response::HEADER_SIZE, len) != 1) {
+        return NULL;
+    }
+
+    auto [response, status] = Response::unmarshal(buf, Response::HEADER_SIZE + len);
+    return status == Response::UnmarshalStatus::SUCCESS ? *response : NULL;
+}
+
+std::string ClusterClient::get_node(const std::vector<std::string> &command) {
+    std::vector<std::string> keys = get_command_keys(command);
+    if (keys.empty() || slot_nodes[key_hash_slot(keys[0])].empty()) {
+        return seed;
+    }
+    return slot_nodes[key_hash_slot(keys[0])];
+}
+
+bool ClusterClient::refresh_slots() {
+    std::vector<std::unique_ptr<Response>> responses = execute({ { "cluster", "slots" } });
+    ArrResponse *ranges = dynamic_cast<ArrResponse *>(responses[0].get());
+    if (ranges == NULL) {
+        return false;
+    }
+
+    stats.slot_refreshes++;
+    std::fill(slot_nodes.begin(), slot_nodes.end(), "");
+    for (Response *element : ranges->get_elements()) {
+        std::vector<Response *> range = ((ArrResponse *) element)->get_elements();
+        int64_t start = ((IntResponse *) range[0])->get_int();
+        int64_t end = ((IntResponse *) range[1])->get_int();
+        for (int64_t slot = start; slot <= end; slot++) {
+            slot_nodes[slot] = ((StrResponse *) range[2])->get_msg();
+        }
+    }
+    return true;
+}
+
+/**
+ * Parses a MOVED or ASK redirect: "<MOVED | ASK> <slot> <host:port>".
+ * 
+ * @param msg   The error message.
+ * @param slot  Pointer to where the slot is stored.
+ * @param node  Pointer to where the node is stored.
+ * 
+ * @return  True if the message is a valid redirect, false otherwise.
+ */
+bool parse_redirect(const std::string &msg, uint16_t *slot, std::string *node) {
+    size_t first = msg.find(' ');
+    size_t second = first == std::string::npos ? std::string::npos : msg.find(' ', first + 1);
+    if (second == std::string::npos) {
+        return false;
+    }
+
+    *slot = strtoul(msg.data() + first + 1, NULL, 10) % CLUSTER_SLOTS;
+    *node = msg.substr(second + 1);
+    return true;
+}
+
+std::vector<std::unique_ptr<Response>> ClusterClient::execute(const std::vector<std::vector<std::string>> &commands) {
+    std::vector<std::unique_ptr<Response>> responses(commands.size());
+    for (uint32_t start = 0; start < commands.size(); start += MAX_BATCH) {
+        execute_batch(commands, start, std::min<uint32_t>(start + MAX_BATCH, commands.size()), responses);
+    }
+    return responses;
+}
+
+void ClusterClient::execute_batch(const std::vector<std::vector<std::string>> &commands, uint32_t start, uint32_t end, 
+                                  std::vector<std::unique_ptr<Response>> &responses) {
+    std::vector<std::string> ask_nodes(commands.size()); // node to send a command to with asking, empty if none
+    std::vector<uint32_t> pending;
+    for (uint32_t i = start; i < end; i++) {
+        pending.push_back(i);
+    }
+
+    for (uint32_t round = 0; round < MAX_ROUNDS && !pending.empty(); round++) {
+        // group the commands by node, keeping their order within a node
+        std::vector<std::string> nodes;
+        std::unordered_map<std::string, std::vector<uint32_t>> batches;
+        for (uint32_t i : pending) {
+            std::string node = ask_nodes[i].empty() ? get_node(commands[i]) : ask_nodes[i];
+            if (batches.count(node) == 0) {
+                nodes.push_back(node);
+            }
+            batches[node].push_back(i);
+        }
+
+        // send every batch before reading any reply, so the nodes work on them in parallel
+        std::unordered_map<std::string, bool> sent;
+        for (const std::string &node : nodes) {
+            Buffer buf;
+            bool ok = true;
+            for (uint32_t i : batches[node]) {
+                if (!ask_nodes[i].empty()) {
+                    Request({ "asking" }).marshal(buf);
+                }
+                ok = ok && Request(commands[i]).marshal(buf) == Request::MarshalStatus::SUCCESS;
+            }
+
+            int fd = ok ? get_socket(node) : -1;
+            sent[node] = fd != -1 && send_all(fd, buf.data(), buf.size()) != -1;
+            stats.batches += sent[node];
+        }
+
+        std::vector<uint32_t> redirected;
+        for (const std::string &node : nodes) {
+            int fd = sent[node] ? sockets[node] : -1;
+            for (uint32_t i : batches[node]) {
+                Response *response = NULL;
+                if (fd != -1 && !ask_nodes[i].empty()) {
+                    delete recv_response(fd); // OK to asking
+                }
+                if (fd != -1 && (response = recv_response(fd)) == NULL) {
+                    close_socket(node);
+                    fd = -1;
+                }
+                if (response == NULL) {
+                    responses[i] = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN,
+                                                                 "failed to send request to " + node);
+                    continue;
+                }
+
+                responses[i].reset(response);
+                ask_nodes[i].clear();
+                ErrResponse *err = dynamic_cast<ErrResponse *>(response);
+                uint16_t slot;
+                std::string target;
+                if (!follow_redirects || err == NULL || !parse_redirect(err->get_err_msg(), &slot, &target)) {
+                    continue;
+                }
+
+                if (err->get_err_code() == ErrResponse::ErrorCode::ERR_MOVED) {
+                    slot_nodes[slot] = target; // the slot has a new owner, later commands go straight there
+                    stats.moved++;
+                    redirected.push_back(i);
+                } else if (err->get_err_code() == ErrResponse::ErrorCode::ERR_ASK) {
+                    ask_nodes[i] = target; // only this command, the slot still belongs to the node that sent it
+                    stats.ask++;
+                    redirected.push_back(i);
+                }
+            }
+        }
+
+        pending = redirected;
+    }
+}
+
+void ClusterClient::set_timeout(uint32_t ms) {
+    timeout_ms = ms;
+}
+
+void ClusterClient::set_follow_redirects(bool follow) {
+    follow_redirects = follow;
+}
+
+const ClusterClientStats &ClusterClient::get_stats() {
+    return stats;
+}
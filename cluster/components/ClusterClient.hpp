@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../response/Response.hpp"
+
+/* Stats for a ClusterClient */
+struct ClusterClientStats {
+    uint64_t batches = 0; // pipelined batches of requests sent, one per node per round
+    uint64_t moved = 0; // MOVED redirects followed
+    uint64_t ask = 0; // ASK redirects followed
+    uint64_t slot_refreshes = 0; // times the slot map was fetched with cluster slots
+};
+
+/**
+ * Blocking client for a cluster that sends each command straight to the node owning its slot.
+ * 
+ * The client keeps its own copy of the slot map, fetched with cluster slots from a seed node and patched by the MOVED 
+ * redirects it gets, and a lazily opened connection per node. execute() takes a batch of commands, groups them by node, 
+ * and pipelines each group: every node is sent all of its requests before any reply is read, so a batch costs about one 
+ * round trip per node rather than one per command. Commands that are redirected are retried in the next round.
+ */
+class ClusterClient {
+    private:
+        static const uint32_t MAX_ROUNDS = 5; // a command redirected more often than this fails with the last redirect
+        static const uint32_t MAX_BATCH = 1024; // commands pipelined at a time, so a node's replies fit in the socket 
+                                                // buffers while the rest of the batch is still being sent
+
+        std::string seed; // "host:port" of the node asked for the slot map
+        std::vector<std::string> slot_nodes; // "host:port" of the node owning each slot, empty if unknown
+        std::unordered_map<std::string, int> sockets; // connection to each node, by "host:port"
+        uint32_t timeout_ms = 0; // send and receive timeout of the connections, 0 to block forever
+        bool follow_redirects = true;
+        ClusterClientStats stats;
+
+        /**
+         * Gets the connection to a node, connecting if there isn't one.
+         * 
+         * @param node  The node's "host:port".
+         * 
+         * @return  The socket on success.
+         *          -1 if the node can't be reached.
+         */
+        int get_socket(const std::string &node);
+
+        /* Closes the connection to a node after an error, so the next request reconnects */
+        void close_socket(const std::string &node);
+
+        /**
+         * Receives one response from a node.
+         * 
+         * @param fd    The node's socket.
+         * 
+         * @return  Pointer to the Response on success.
+         *          NULL if the connection failed or the response is invalid.
+         */
+        Response *recv_response(int fd);
+
+        /**
+         * Gets the node a command should be sent to: the owner of its slot if known, the seed otherwise.
+         * 
+         * @param command   The command.
+         * 
+         * @return  The node's "host:port".
+         */
+        std::string get_node(const std::vector<std::string> &command);
+
+        /**
+         * Executes up to MAX_BATCH commands. See execute().
+         * 
+         * @param commands  The commands.
+         * @param start     Index of the first command to execute.
+         * @param end       Index just past the last command to execute.
+         * @param responses Reference to where the response to each command is stored, at the command's index.
+         */
+        void execute_batch(const std::vector<std::vector<std::string>> &commands, uint32_t start, uint32_t end, 
+                           std::vector<std::unique_ptr<Response>> &responses);
+    public:
+        /**
+         * Initializes a ClusterClient. No connection is made until the first command is sent.
+         * 
+         * @param seed  The "host:port" of any node in the cluster.
+         */
+        ClusterClient(const std::string &seed);
+
+        ~ClusterClient();
+
+        ClusterClient(const ClusterClient &) = delete;
+        ClusterClient &operator=(const ClusterClient &) = delete;
+
+        /**
+         * Fetches the slot map from the seed node.
+         * 
+         * @return  True on success.
+         *          False if the seed can't be reached or isn't in cluster mode.
+         */
+        bool refresh_slots();
+
+        /**
+         * Executes a batch of commands, each on the node owning its slot, following MOVED and ASK redirects.
+         * 
+         * @param commands  The commands, each broken up into its individual strings.
+         * 
+         * @return  The response to each command, in the order of the commands. A command that can't be sent gets an 
+         *          ErrResponse.
+         */
+        std::vector<std::unique_ptr<Response>> execute(const std::vector<std::vector<std::string>> &commands);
+
+        /**
+         * Sets how long a send or receive on a connection may block before the command fails. Applies to connections 
+         * opened afterwards.
+         * 
+         * @param ms    The timeout in ms, 0 to block forever.
+         */
+        void set_timeout(uint32_t ms);
+
+        /**
+         * Sets whether MOVED and ASK redirects are followed. If not, they are returned like any other error, for callers 
+         * that must talk to one node only (e.g. migrate).
+         * 
+         * @param follow    Whether to follow redirects.
+         */
+        void set_follow_redirects(bool follow);
+
+        /* Returns the stats for the client */
+        const ClusterClientStats &get_stats();
+};
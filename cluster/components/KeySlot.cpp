@@ -0,0 +1,63 @@
+#include <cstdlib>
+#include <unordered_set>
+
+#include "KeySlot.hpp"
+#include "../../utils/checksum_utils.hpp"
+
+std::string_view key_hash_tag(const std::string &key) {
+    size_t open = key.find('{');
+    if (open != std::string::npos) {
+        size_t close = key.find('}', open + 1);
+        if (close != std::string::npos && close != open + 1) {
+            return std::string_view(key).substr(open + 1, close - open - 1);
+        }
+    }
+    return key;
+}
+
+uint16_t key_hash_slot(const std::string &key) {
+    std::string_view tag = key_hash_tag(key);
+    return crc16(tag.data(), tag.size()) % CLUSTER_SLOTS;
+}
+
+std::vector<std::string> get_command_keys(const std::vector<std::string> &command) {
+    static const std::unordered_set<std::string> single_key_commands = {
+        "get", "set", "del", "ttl", "pttl", "persist", "expire", "pexpire", "expireat", "pexpireat", "zadd", "zincrby", 
+        "zscore", "zrem", "zquery", "zrank", "zrevrank", "zcard", "zcount", "zlexcount", "zrange", "zrevrange", 
+        "zrangebyscore", "zrevrangebyscore", "zrangebylex", "zrevrangebylex", "zremrangebyrank", "zremrangebyscore", 
+        "zremrangebylex", "zpopmin", "zpopmax", "dump", "restore", "restore-asking"
+    };
+
+    if (command.size() < 2) {
+        return {};
+    }
+
+    const std::string &name = command[0];
+    if (single_key_commands.count(name) > 0) {
+        return { command[1] };
+    }
+
+    // <dest> <numkeys> <key> [<key> ...]
+    if ((name == "zunionstore" || name == "zinterstore" || name == "zdiffstore") && command.size() >= 4) {
+        std::vector<std::string> keys = { command[1] };
+        uint64_t num_keys = strtoull(command[2].data(), NULL, 10);
+        for (uint64_t i = 0; i < num_keys && 3 + i < command.size(); i++) {
+            keys.push_back(command[3 + i]);
+        }
+        return keys;
+    }
+
+    // <host> <port> <key | ""> <timeout> [COPY] [REPLACE] [KEYS <key> [<key> ...]]
+    if (name == "migrate" && command.size() >= 5) {
+        if (!command[3].empty()) {
+            return { command[3] };
+        }
+        for (uint32_t i = 5; i < command.size(); i++) {
+            if (command[i] == "keys" || command[i] == "KEYS") {
+                return std::vector<std::string>(command.begin() + i + 1, command.end());
+            }
+        }
+    }
+
+    return {};
+}
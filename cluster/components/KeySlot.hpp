@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static const uint32_t CLUSTER_SLOTS = 16384;
+
+/**
+ * Gets the part of a key that decides where it is placed: its hashtag, i.e. the non-empty substring between the first 
+ * '{' and the next '}', if it has one, the whole key otherwise.
+ * 
+ * @param key   The key.
+ * 
+ * @return  View into the key.
+ */
+std::string_view key_hash_tag(const std::string &key);
+
+/**
+ * Gets the hash slot of a key: the CRC-16 of the key modulo the number of slots.
+ * 
+ * If the key contains a hashtag, i.e. a non-empty substring between the first '{' and the next '}', only the hashtag 
+ * is hashed, so keys such as "{user:1}:name" and "{user:1}:friends" are always in the same slot.
+ * 
+ * @param key   The key.
+ * 
+ * @return  The slot.
+ */
+uint16_t key_hash_slot(const std::string &key);
+
+/**
+ * Gets the keys a command reads or writes.
+ * 
+ * @param command   The command, broken up into its individual strings.
+ * 
+ * @return  The keys, empty if the command doesn't take any (e.g. info) or is malformed.
+ */
+std::vector<std::string> get_command_keys(const std::vector<std::string> &command);
@@ -0,0 +1,59 @@
+#include "SlotIndex.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+
+SlotIndex::SlotIndex() : heads(CLUSTER_SLOTS), counts(CLUSTER_SLOTS, 0) {
+    for (SlotNode &head : heads) {
+        head.prev = &head;
+        head.next = &head;
+    }
+}
+
+void SlotIndex::add(Entry *entry) {
+    uint16_t slot = key_hash_slot(entry->key);
+    SlotNode *head = &heads[slot];
+    SlotNode *node = &entry->slot_node;
+    node->prev = head;
+    node->next = head->next;
+    head->next->prev = node;
+    head->next = node;
+    counts[slot]++;
+}
+
+void SlotIndex::remove(Entry *entry) {
+    SlotNode *node = &entry->slot_node;
+    if (node->next == NULL) {
+        return;
+    }
+
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = NULL;
+    node->next = NULL;
+    counts[key_hash_slot(entry->key)]--;
+}
+
+void SlotIndex::replace(Entry *from, Entry *to) {
+    SlotNode *node = &from->slot_node;
+    if (node->next == NULL) {
+        return;
+    }
+
+    to->slot_node = *node;
+    node->prev->next = &to->slot_node;
+    node->next->prev = &to->slot_node;
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+uint32_t SlotIndex::count(uint16_t slot) {
+    return counts[slot];
+}
+
+std::vector<std::string> SlotIndex::get_keys(uint16_t slot, uint32_t max) {
+    std::vector<std::string> keys;
+    SlotNode *head = &heads[slot];
+    for (SlotNode *node = head->next; node != head && keys.size() < max; node = node->next) {
+        keys.push_back(container_of(node, Entry, slot_node)->key);
+    }
+    return keys;
+}
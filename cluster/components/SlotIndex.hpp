@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "KeySlot.hpp"
+#include "SlotNode.hpp"
+#include "../../entry/Entry.hpp"
+
+/**
+ * Index of the keys in each hash slot, so the keys of a slot can be counted and listed (e.g. to migrate it) without 
+ * scanning the whole kv store.
+ * 
+ * Each slot has a circular doubly linked list threaded through the slot_node of its entries, so adding and removing a 
+ * key is O(1) and costs no allocation.
+ */
+class SlotIndex {
+    private:
+        std::vector<SlotNode> heads; // sentinel of each slot's list
+        std::vector<uint32_t> counts;
+    public:
+        SlotIndex();
+
+        SlotIndex(const SlotIndex &) = delete; // the lists point back at the sentinels
+        SlotIndex &operator=(const SlotIndex &) = delete;
+
+        /**
+         * Adds an Entry to the list of its key's slot.
+         * 
+         * @param entry Pointer to the Entry, which must not be in the index.
+         */
+        void add(Entry *entry);
+
+        /**
+         * Removes an Entry from the list of its key's slot. Does nothing if it isn't in the index.
+         * 
+         * @param entry Pointer to the Entry.
+         */
+        void remove(Entry *entry);
+
+        /**
+         * Puts an Entry in the place of another in the index, e.g. when an Entry is moved to a new address.
+         * 
+         * @param from  Pointer to the Entry in the index.
+         * @param to    Pointer to the Entry replacing it.
+         */
+        void replace(Entry *from, Entry *to);
+
+        /* Returns the number of keys in a slot */
+        uint32_t count(uint16_t slot);
+
+        /**
+         * Gets keys in a slot.
+         * 
+         * @param slot  The slot.
+         * @param max   The maximum number of keys to get.
+         * 
+         * @return  Up to max keys, most recently added first.
+         */
+        std::vector<std::string> get_keys(uint16_t slot, uint32_t max);
+};
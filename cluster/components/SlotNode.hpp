@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+
+/* Intrusive node linking an Entry into the list of keys in its hash slot. Unlinked nodes have NULL pointers. */
+struct SlotNode {
+    SlotNode *prev = NULL;
+    SlotNode *next = NULL;
+};
@@ -0,0 +1,52 @@
+#include <assert.h>
+
+#include "../KeySlot.hpp"
+#include "../../../utils/checksum_utils.hpp"
+
+void test_key_hash_slot() {
+    assert(crc16("123456789", 9) == 0x31C3); // CRC-16/XMODEM check value
+    assert(key_hash_slot("123456789") == 0x31C3 % CLUSTER_SLOTS);
+    assert(key_hash_slot("") == 0);
+
+    for (const char *key : { "a", "foo", "user:1000", "{", "}{" }) {
+        assert(key_hash_slot(key) < CLUSTER_SLOTS);
+    }
+}
+
+void test_hashtags() {
+    // only the hashtag is hashed
+    assert(key_hash_slot("{user:1}:name") == key_hash_slot("user:1"));
+    assert(key_hash_slot("{user:1}:name") == key_hash_slot("{user:1}:friends"));
+    assert(key_hash_slot("a{user:1}b{other}") == key_hash_slot("user:1")); // the first one
+
+    // an empty or unclosed hashtag means the whole key is hashed
+    assert(key_hash_slot("{}user:1") == crc16("{}user:1", 8) % CLUSTER_SLOTS);
+    assert(key_hash_slot("{user:1") == crc16("{user:1", 7) % CLUSTER_SLOTS);
+    assert(key_hash_slot("{{a}}") == key_hash_slot("{a")); // up to the first '}' after the first '{'
+
+    assert(key_hash_tag("{user:1}:name") == "user:1");
+    assert(key_hash_tag("{}user:1") == "{}user:1");
+}
+
+void test_get_command_keys() {
+    using Keys = std::vector<std::string>;
+    assert(get_command_keys({ "get", "a" }) == Keys({ "a" }));
+    assert(get_command_keys({ "set", "a", "1", "PX", "100" }) == Keys({ "a" }));
+    assert(get_command_keys({ "zadd", "z", "1", "m" }) == Keys({ "z" }));
+    assert(get_command_keys({ "zunionstore", "dest", "2", "a", "b", "WEIGHTS", "1", "2" }) == 
+           Keys({ "dest", "a", "b" }));
+    assert(get_command_keys({ "zdiffstore", "dest", "5", "a" }) == Keys({ "dest", "a" })); // numkeys past the end
+
+    assert(get_command_keys({ "info" }).empty());
+    assert(get_command_keys({ "keys" }).empty());
+    assert(get_command_keys({ "config", "get", "save" }).empty());
+    assert(get_command_keys({ "get" }).empty());
+}
+
+int main() {
+    test_key_hash_slot();
+    test_hashtags();
+    test_get_command_keys();
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <assert.h>
+#include <algorithm>
+
+#include "../SlotIndex.hpp"
+
+/* Creates an Entry holding a string at a key */
+Entry *new_entry(const std::string &key) {
+    Entry *entry = new Entry();
+    entry->key = key;
+    entry->type = EntryType::STR;
+    return entry;
+}
+
+void test_add_remove() {
+    SlotIndex index;
+    Entry *a = new_entry("{tag}a");
+    Entry *b = new_entry("{tag}b");
+    Entry *c = new_entry("other");
+    uint16_t slot = key_hash_slot("tag");
+
+    index.add(a);
+    index.add(b);
+    index.add(c);
+    assert(index.count(slot) == 2);
+    assert(index.count(key_hash_slot("other")) == 1);
+
+    std::vector<std::string> keys = index.get_keys(slot, 10);
+    std::sort(keys.begin(), keys.end());
+    assert(keys == std::vector<std::string>({ "{tag}a", "{tag}b" }));
+    assert(index.get_keys(slot, 1).size() == 1);
+
+    index.remove(a);
+    assert(index.count(slot) == 1);
+    assert(index.get_keys(slot, 10) == std::vector<std::string>({ "{tag}b" }));
+
+    index.remove(a); // already removed
+    assert(index.count(slot) == 1);
+
+    index.remove(b);
+    index.remove(c);
+    assert(index.count(slot) == 0);
+    assert(index.get_keys(slot, 10).empty());
+
+    delete a;
+    delete b;
+    delete c;
+}
+
+void test_replace() {
+    SlotIndex index;
+    Entry *a = new_entry("{tag}a");
+    Entry *b = new_entry("{tag}b");
+    Entry *c = new_entry("{tag}c");
+    index.add(a);
+    index.add(b);
+    index.add(c);
+
+    // b is moved to a new address, as the defragger does
+    Entry *moved = new_entry("{tag}b");
+    index.replace(b, moved);
+    delete b;
+
+    uint16_t slot = key_hash_slot("tag");
+    assert(index.count(slot) == 3);
+    std::vector<std::string> keys = index.get_keys(slot, 10);
+    std::sort(keys.begin(), keys.end());
+    assert(keys == std::vector<std::string>({ "{tag}a", "{tag}b", "{tag}c" }));
+
+    index.remove(moved);
+    assert(index.count(slot) == 2);
+
+    delete a;
+    delete c;
+    delete moved;
+}
+
+int main() {
+    test_add_remove();
+    test_replace();
+
+    return 0;
+}
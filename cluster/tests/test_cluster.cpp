@@ -0,0 +1,214 @@
+#include <assert.h>
+
+#include "../Cluster.hpp"
+#include "../components/ClusterClient.hpp"
+#include "../../command-executor/CommandExecutor.hpp"
+#include "../../conn/Conn.hpp"
+#include "../../utils/test_utils.hpp"
+
+TimerManager timers;
+ThreadPool thread_pool(2);
+Evictor evictor;
+
+void test_route() {
+    Cluster &cluster = Cluster::shared();
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    Conn conn(-1, true, false, false);
+
+    // cluster commands need cluster mode
+    assert(err_code_of(executor.execute({ "cluster", "slots" })) == ErrResponse::ErrorCode::ERR_UNKNOWN);
+    assert(cluster.route(&conn, { "get", "a" }, kv_store) == nullptr);
+
+    cluster.enable("127.0.0.1:7000");
+    uint16_t slot_a = key_hash_slot("a");
+    uint16_t slot_b = key_hash_slot("b");
+    assert(slot_a != slot_b);
+    assert(int_of(executor.execute({ "cluster", "keyslot", "a" })) == slot_a);
+
+    // nothing is served until slots are assigned
+    assert(err_msg_of(cluster.route(&conn, { "get", "a" }, kv_store)) == "CLUSTERDOWN Hash slot not served");
+
+    assert(str_of(executor.execute({ "cluster", "addslotsrange", "0", "8191" })) == "OK");
+    assert(str_of(executor.execute({ "cluster", "setslot", "8192", "node", "127.0.0.1:7001" })) == "OK");
+    for (uint32_t slot = 8193; slot < CLUSTER_SLOTS; slot++) {
+        cluster.set_slot_node(slot, "127.0.0.1:7001");
+    }
+    assert(cluster.get_slots_assigned() == CLUSTER_SLOTS);
+    assert(cluster.get_slots_owned() == 8192);
+
+    std::unique_ptr<Response> slots = executor.execute({ "cluster", "slots" });
+    std::vector<Response *> ranges = ((ArrResponse *) slots.get())->get_elements();
+    assert(ranges.size() == 2);
+    std::vector<Response *> second = ((ArrResponse *) ranges[1])->get_elements();
+    assert(((IntResponse *) second[0])->get_int() == 8192);
+    assert(((IntResponse *) second[1])->get_int() == CLUSTER_SLOTS - 1);
+    assert(((StrResponse *) second[2])->get_msg() == "127.0.0.1:7001");
+
+    // keys in slots owned elsewhere are redirected, keys without a slot aren't
+    std::string mine = slot_a < 8192 ? "a" : "b";
+    std::string theirs = slot_a < 8192 ? "b" : "a";
+    uint16_t their_slot = key_hash_slot(theirs);
+    assert(cluster.route(&conn, { "set", mine, "1" }, kv_store) == nullptr);
+    std::unique_ptr<Response> moved = cluster.route(&conn, { "get", theirs }, kv_store);
+    assert(err_code_of(moved) == ErrResponse::ErrorCode::ERR_MOVED);
+    assert(err_msg_of(moved) == "MOVED " + std::to_string(their_slot) + " 127.0.0.1:7001");
+    assert(cluster.route(&conn, { "info" }, kv_store) == nullptr);
+    std::unique_ptr<Response> crossslot = cluster.route(&conn, { "zunionstore", "{x}d", "2", "{x}a", "b" }, kv_store);
+    assert(err_msg_of(crossslot).rfind("CROSSSLOT", 0) == 0);
+    assert(cluster.get_stats().moved == 1);
+
+    // the index follows the kv store
+    uint16_t my_slot = key_hash_slot(mine);
+    executor.execute({ "set", mine, "1" });
+    assert(int_of(executor.execute({ "cluster", "countkeysinslot", std::to_string(my_slot) })) == 1);
+    std::unique_ptr<Response> keys = executor.execute({ "cluster", "getkeysinslot", std::to_string(my_slot), "10" });
+    assert(((ArrResponse *) keys.get())->get_elements().size() == 1);
+    executor.execute({ "del", mine });
+    assert(cluster.count_keys_in_slot(my_slot) == 0);
+
+    // migrating: keys still here are served here, the others are asked for at the target
+    executor.execute({ "set", mine, "1" });
+    std::unique_ptr<Response> not_owner = executor.execute({ "cluster", "setslot", std::to_string(their_slot), 
+                                                              "migrating", "127.0.0.1:7002" });
+    assert(err_code_of(not_owner) == ErrResponse::ErrorCode::ERR_INVALID_ARG);
+    cluster.set_slot_migrating(my_slot, "127.0.0.1:7002");
+    assert(cluster.route(&conn, { "get", mine }, kv_store) == nullptr);
+    std::unique_ptr<Response> ask = cluster.route(&conn, { "get", "{" + mine + "}new" }, kv_store);
+    assert(key_hash_slot("{" + mine + "}new") == my_slot);
+    assert(err_msg_of(ask) == "ASK " + std::to_string(my_slot) + " 127.0.0.1:7002");
+    assert(cluster.get_stats().ask == 1);
+    cluster.set_slot_stable(my_slot);
+    executor.execute({ "del", mine });
+
+    // importing: only served right after asking
+    assert(cluster.set_slot_importing(their_slot, "127.0.0.1:7001"));
+    assert(err_code_of(cluster.route(&conn, { "get", theirs }, kv_store)) == ErrResponse::ErrorCode::ERR_MOVED);
+    assert(str_of(cluster.route(&conn, { "asking" }, kv_store)) == "OK");
+    assert(cluster.route(&conn, { "get", theirs }, kv_store) == nullptr);
+    assert(err_code_of(cluster.route(&conn, { "get", theirs }, kv_store)) == ErrResponse::ErrorCode::ERR_MOVED);
+    cluster.set_slot_node(their_slot, "127.0.0.1:7000"); // import finished
+    assert(cluster.route(&conn, { "get", theirs }, kv_store) == nullptr);
+}
+
+/* A local cluster of server processes */
+struct LocalCluster {
+    std::vector<TestProcess> servers;
+    std::vector<std::string> nodes;
+};
+
+/**
+ * Starts server processes in cluster mode on consecutive ports and waits for them to accept connections.
+ * 
+ * @param n The number of servers.
+ * 
+ * @return  The cluster.
+ */
+LocalCluster start_cluster(uint32_t n) {
+    LocalCluster cluster;
+    for (uint32_t i = 0; i < n; i++) {
+        cluster.servers.push_back(start_test_process("server", test_base_port() + i, { "--cluster" }));
+        cluster.nodes.push_back(cluster.servers.back().addr);
+    }
+    return cluster;
+}
+
+/* Kills the servers of a local cluster */
+void stop_cluster(LocalCluster &cluster) {
+    for (TestProcess &server : cluster.servers) {
+        stop_test_process(server);
+    }
+}
+
+void test_local_cluster() {
+    LocalCluster local = start_cluster(3);
+
+    // split the slots evenly and tell every node the whole map
+    uint32_t per_node = CLUSTER_SLOTS / local.nodes.size();
+    std::vector<std::vector<std::string>> setslots;
+    for (uint32_t slot = 0; slot < CLUSTER_SLOTS; slot++) {
+        uint32_t i = std::min<uint32_t>(slot / per_node, local.nodes.size() - 1);
+        setslots.push_back({ "cluster", "setslot", std::to_string(slot), "node", local.nodes[i] });
+    }
+    for (const std::string &node : local.nodes) {
+        ClusterClient admin(node); // commands without keys all go to the seed, pipelined
+        for (const std::unique_ptr<Response> &response : admin.execute(setslots)) {
+            assert(str_of(response) == "OK");
+        }
+    }
+
+    // a client that starts from the seed alone learns the map from MOVED redirects
+    ClusterClient client(local.nodes[0]);
+    std::vector<std::vector<std::string>> sets, gets;
+    for (uint32_t i = 0; i < 300; i++) {
+        sets.push_back({ "set", "key" + std::to_string(i), std::to_string(i) });
+        gets.push_back({ "get", "key" + std::to_string(i) });
+    }
+    for (const std::unique_ptr<Response> &response : client.execute(sets)) {
+        assert(str_of(response) == "OK");
+    }
+    assert(client.get_stats().moved > 0);
+
+    // once it has the map, every command goes straight to its node
+    assert(client.refresh_slots());
+    uint64_t moved = client.get_stats().moved;
+    std::vector<std::unique_ptr<Response>> values = client.execute(gets);
+    for (uint32_t i = 0; i < values.size(); i++) {
+        assert(str_of(values[i]) == std::to_string(i));
+    }
+    assert(client.get_stats().moved == moved);
+
+    // each node holds just its own slots' keys
+    int64_t total = 0;
+    for (const std::string &node : local.nodes) {
+        std::unique_ptr<Response> keys = send_to(node, { "keys" });
+        total += ((ArrResponse *) keys.get())->get_elements().size();
+    }
+    assert(total == 300);
+
+    // migrate the slot of key0 from its owner to another node, key by key, as a resharding tool would
+    uint16_t slot = key_hash_slot("key0");
+    uint32_t source_i = std::min<uint32_t>(slot / per_node, local.nodes.size() - 1);
+    std::string source = local.nodes[source_i];
+    std::string target = local.nodes[(source_i + 1) % local.nodes.size()];
+    std::string slot_str = std::to_string(slot);
+    assert(str_of(send_to(target, { "cluster", "setslot", slot_str, "importing", source })) == "OK");
+    assert(str_of(send_to(source, { "cluster", "setslot", slot_str, "migrating", target })) == "OK");
+    assert(int_of(send_to(source, { "cluster", "countkeysinslot", slot_str })) >= 1);
+
+    // a key not on the source yet is created on the target through ASK
+    std::string tagged = "{key0}new";
+    assert(str_of(client.execute({ { "set", tagged, "v" } })[0]) == "OK");
+    assert(client.get_stats().ask == 1);
+    assert(int_of(send_to(target, { "cluster", "countkeysinslot", slot_str })) == 1);
+
+    // move the rest with migrate, then hand the slot over on every node
+    std::unique_ptr<Response> keys = send_to(source, { "cluster", "getkeysinslot", slot_str, "100" });
+    std::vector<std::string> migrate = { "migrate", "127.0.0.1", target.substr(target.rfind(':') + 1), "", "5000", 
+                                         "KEYS" };
+    for (Response *key : ((ArrResponse *) keys.get())->get_elements()) {
+        migrate.push_back(((StrResponse *) key)->get_msg());
+    }
+    assert(str_of(send_to(source, migrate)) == "OK");
+    assert(int_of(send_to(source, { "cluster", "countkeysinslot", slot_str })) == 0);
+    for (const std::string &node : local.nodes) {
+        assert(str_of(send_to(node, { "cluster", "setslot", slot_str, "node", target })) == "OK");
+    }
+
+    // the client's map is stale, so it's moved once then reads from the new owner
+    moved = client.get_stats().moved;
+    std::vector<std::unique_ptr<Response>> after = client.execute({ { "get", "key0" }, { "get", tagged } });
+    assert(str_of(after[0]) == "0");
+    assert(str_of(after[1]) == "v");
+    assert(client.get_stats().moved > moved);
+    assert(int_of(send_to(target, { "cluster", "countkeysinslot", slot_str })) >= 2);
+
+    stop_cluster(local);
+}
+
+int main() {
+    test_route();
+    test_local_cluster();
+
+    return 0;
+}
@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <unordered_set>
+
 #include "CommandExecutor.hpp"
 #include "../response/types/NilResponse.hpp"
 #include "../response/types/StrResponse.hpp"
@@ -5,6 +10,13 @@
 #include "../response/types/ErrResponse.hpp"
 #include "../response/types/ArrResponse.hpp"
 #include "../response/types/DblResponse.hpp"
+#include "../aof/Aof.hpp"
+#include "../cluster/Cluster.hpp"
+#include "../conn/Conn.hpp"
+#include "../pub-sub/PubSub.hpp"
+#include "../rdb/Rdb.hpp"
+#include "../rdb/components/DumpPayload.hpp"
+#include "../replication/Replication.hpp"
 #include "../utils/hash_utils.hpp"
 #include "../utils/intrusive_data_structure_utils.hpp"
 #include "../utils/log.hpp"
@@ -15,7 +27,56 @@ Entry *CommandExecutor::lookup_entry(const std::string &key) {
     lookup_entry.key = key;
     lookup_entry.node.hval = str_hash(key);
     HNode *node = kv_store->lookup(&lookup_entry.node, are_entries_equal);
-    return node != NULL ? container_of(node, Entry, node) : NULL;
+    if (node == NULL) {
+        return NULL;
+    }
+
+    Entry *entry = container_of(node, Entry, node);
+    if (expire_if_needed(entry)) {
+        return NULL;
+    }
+
+    evictor->touch(entry);
+    return entry;
+}
+
+Entry *CommandExecutor::remove_entry(const std::string &key) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = key;
+    lookup_entry.node.hval = str_hash(key);
+    HNode *node = kv_store->lookup(&lookup_entry.node, are_entries_equal);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    Entry *entry = container_of(node, Entry, node);
+    if (expire_if_needed(entry)) {
+        return NULL;
+    }
+
+    kv_store->remove(&entry->node, are_entries_equal);
+    return entry;
+}
+
+bool CommandExecutor::expire_if_needed(Entry *entry) {
+    if (!entry->ttl_timer.is_expired(get_cached_time_ms())) {
+        return false;
+    }
+
+    Replication &replication = Replication::shared();
+    if (replication.is_replica()) {
+        // the primary's clock decides when keys expire and it sends a del when they do, so the key is only hidden 
+        // from clients, and is still there for the commands the primary sent before that del
+        return replication.rejects_writes();
+    }
+
+    log("key '%s' expired", entry->key.data());
+    Aof::shared().feed({ "del", entry->key });
+    replication.feed({ "del", entry->key });
+    kv_store->remove(&entry->node, are_entries_equal);
+    delete_entry(entry, timers, thread_pool);
+    timers->record_lazy_expiry();
+    return true;
 }
 
 std::unique_ptr<Response> CommandExecutor::do_get(const std::string &key) {
@@ -30,37 +91,226 @@ std::unique_ptr<Response> CommandExecutor::do_get(const std::string &key) {
     }
 
     log("get: found key '%s'", key.data());
-    return std::make_unique<StrResponse>(entry->str);
+    return std::make_unique<StrResponse>(std::string(entry->str.data(), entry->str.size()));
 }
 
-std::unique_ptr<Response> CommandExecutor::do_set(const std::string &key, const std::string &value) {
+std::unique_ptr<Response> CommandExecutor::do_set(const std::string &key, const std::string &value, const SetOptions &options) {
     Entry *entry = lookup_entry(key);
 
+    std::unique_ptr<Response> old_value = std::make_unique<NilResponse>();
+    if (options.get && entry != NULL) {
+        if (entry->type != EntryType::STR) {
+            log("set: value of key '%s' isn't a string", key.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a string");
+        }
+        old_value = std::make_unique<StrResponse>(std::string(entry->str.data(), entry->str.size()));
+    }
+
+    if ((options.condition == SetOptions::Condition::NX && entry != NULL) || 
+        (options.condition == SetOptions::Condition::XX && entry == NULL)) {
+        log("set: condition not met for key '%s'", key.data());
+        return options.get ? std::move(old_value) : std::make_unique<NilResponse>();
+    }
+
+    if (options.expiry_time_ms && *options.expiry_time_ms <= get_cached_time_ms()) {
+        // expires as soon as it's set, so it's never stored
+        if (entry != NULL) {
+            delete_entry(remove_entry(key), timers, thread_pool);
+        }
+        log("set: expiry of key '%s' has already passed, deleted it", key.data());
+        return options.get ? std::move(old_value) : std::make_unique<StrResponse>("OK");
+    }
+
     if (entry != NULL) {
-        entry->str = value;
-        entry->ttl_timer.clear_expiry(timers);
+        entry->str.assign(value.data(), value.size());
+        if (!options.keep_ttl) {
+            entry->ttl_timer.clear_expiry(timers);
+        }
         log("set: updated key '%s'", key.data());
     } else {
         entry = new Entry();
         entry->key = key;
         entry->type = EntryType::STR;
-        entry->str = value;
+        entry->str.assign(value.data(), value.size());
         entry->node.hval = str_hash(key);
+        evictor->init_access(entry);
         kv_store->insert(&entry->node);
+        Cluster::shared().add_key(entry);
         log("set: created key '%s'", key.data());
     }
+    update_entry_memory(entry);
 
-    return std::make_unique<StrResponse>("OK");
+    if (options.expiry_time_ms) {
+        entry->ttl_timer.set_expiry_at(*options.expiry_time_ms, timers);
+    }
+
+    return options.get ? std::move(old_value) : std::make_unique<StrResponse>("OK");
+}
+
+/**
+ * Parses an integer argument.
+ * 
+ * @param arg   The argument.
+ * @param out   Pointer to an int64_t where the result will be stored.
+ * 
+ * @return  True on success.
+ *          False if the argument is not an integer.
+ */
+bool parse_int(const std::string &arg, int64_t *out) {
+    try {
+        size_t len;
+        *out = std::stoll(arg, &len);
+        return len == arg.length();
+    } catch (...) {
+        return false;
+    }
+}
+
+/**
+ * Parses a score. "-inf" and "+inf" are accepted, but NaN is not.
+ * 
+ * @param arg   The argument.
+ * @param score Pointer to a double where the score will be stored.
+ * 
+ * @return  True on success.
+ *          False if the argument is not a valid score.
+ */
+bool parse_score(const std::string &arg, double *score) {
+    try {
+        size_t len;
+        *score = std::stod(arg, &len);
+        return len == arg.length() && !std::isnan(*score);
+    } catch (...) {
+        return false;
+    }
+}
+
+/**
+ * Parses one end of a score range: a score, optionally prefixed with "(" to exclude it. "-inf" and "+inf" are accepted.
+ * 
+ * @param arg       The argument.
+ * @param score     Pointer to a double where the score will be stored.
+ * @param exclusive Pointer to a bool where whether the score is excluded will be stored.
+ * 
+ * @return  True on success.
+ *          False if the argument is not a valid score.
+ */
+bool parse_score_bound(const std::string &arg, double *score, bool *exclusive) {
+    *exclusive = !arg.empty() && arg[0] == '(';
+    return parse_score(*exclusive ? arg.substr(1) : arg, score);
+}
+
+/**
+ * Parses one end of a name range: a name prefixed with "[" to include it or "(" to exclude it, or "-" / "+" for an end 
+ * lower / higher than every name.
+ * 
+ * @param arg   The argument.
+ * @param bound Pointer to a LexBound where the bound will be stored.
+ * 
+ * @return  True on success.
+ *          False if the argument is not a valid bound.
+ */
+bool parse_lex_bound(const std::string &arg, LexBound *bound) {
+    if (arg == "-" || arg == "+") {
+        bound->infinity = arg == "-" ? -1 : 1;
+        return true;
+    } else if (arg.empty() || (arg[0] != '[' && arg[0] != '(')) {
+        return false;
+    }
+
+    bound->name = arg.substr(1);
+    bound->exclusive = arg[0] == '(';
+    bound->infinity = 0;
+    return true;
+}
+
+/* Returns a lowercase copy of the string */
+std::string to_lower(const std::string &str) {
+    std::string lower = str;
+    for (char &c : lower) {
+        c = std::tolower(c);
+    }
+    return lower;
+}
+
+/**
+ * Converts an expire time argument to the monotonic time in ms it refers to.
+ * 
+ * @param time      The time.
+ * @param unit_ms   The length of one unit of the time in ms: 1000 for seconds, 1 for ms.
+ * @param absolute  Whether the time is a unix time rather than relative to now.
+ * @param out       Pointer to a time_t where the monotonic time will be stored.
+ * 
+ * @return  True on success.
+ *          False if the time is out of range.
+ */
+static bool to_expiry_time_ms(int64_t time, int64_t unit_ms, bool absolute, time_t *out) {
+    int64_t ms;
+    if (__builtin_mul_overflow(time, unit_ms, &ms)) {
+        return false;
+    }
+
+    // a unix time is shifted by the difference between the clocks, see unix_to_monotonic_ms()
+    int64_t base = absolute ? get_cached_time_ms() - get_unix_time_ms() : get_cached_time_ms();
+    return !__builtin_add_overflow(ms, base, out);
+}
+
+std::unique_ptr<Response> CommandExecutor::execute_set(const std::vector<std::string> &command) {
+    SetOptions options;
+    bool has_expiry = false;
+
+    for (uint32_t i = 3; i < command.size(); i++) {
+        std::string option = to_lower(command[i]);
+
+        if (option == "nx" || option == "xx") {
+            if (options.condition != SetOptions::Condition::ALWAYS) {
+                log("set: NX and XX options given together");
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+            }
+            options.condition = option == "nx" ? SetOptions::Condition::NX : SetOptions::Condition::XX;
+        } else if (option == "get") {
+            options.get = true;
+        } else if (option == "keepttl") {
+            if (has_expiry) {
+                log("set: more than one expiry option given");
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+            }
+            has_expiry = true;
+            options.keep_ttl = true;
+        } else if (option == "ex" || option == "px" || option == "exat" || option == "pxat") {
+            if (has_expiry || i + 1 >= command.size()) {
+                log("set: more than one expiry option given, or expiry option has no time");
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+            }
+            has_expiry = true;
+
+            int64_t time;
+            if (!parse_int(command[++i], &time) || time <= 0) {
+                log("set: invalid expire time");
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid expire time");
+            }
+
+            time_t expiry_time_ms;
+            if (!to_expiry_time_ms(time, option == "ex" || option == "exat" ? 1000 : 1, 
+                                   option == "exat" || option == "pxat", &expiry_time_ms)) {
+                log("set: expire time out of range");
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid expire time");
+            }
+            options.expiry_time_ms = expiry_time_ms;
+        } else {
+            log("set: unknown option '%s'", command[i].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+        }
+    }
+
+    return do_set(command[1], command[2], options);
 }
 
 std::unique_ptr<Response> CommandExecutor::do_del(const std::string &key) {
-    LookupEntry lookup_entry;
-    lookup_entry.key = key;
-    lookup_entry.node.hval = str_hash(key);
-    HNode *node = kv_store->remove(&lookup_entry.node, are_entries_equal);
+    Entry *entry = remove_entry(key);
     
-    if (node != NULL) {
-        delete_entry(container_of(node, Entry, node), timers, thread_pool);
+    if (entry != NULL) {
+        delete_entry(entry, timers, thread_pool);
         log("del: deleted key '%s'", key.data());
         return std::make_unique<IntResponse>(1);
     }
@@ -69,21 +319,33 @@ std::unique_ptr<Response> CommandExecutor::do_del(const std::string &key) {
     return std::make_unique<IntResponse>(0);
 }
 
+/* Argument for the get_key() callback */
+struct GetKeyArg {
+    std::vector<std::string> keys;
+    time_t now_ms;
+};
+
 /**
- * Callback which gets the key for an Entry in the hash map and stores it in the provided vector.
+ * Callback which gets the key for an Entry in the hash map and stores it in the provided vector. Skips entries whose 
+ * TTL has passed.
  * 
  * @param node  The HNode contained by the Entry which we want to get the key for.
- * @param arg   Void pointer to a vector to store the key in.
+ * @param arg   Void pointer to a GetKeyArg to store the key in.
  */
 void get_key(HNode *node, void *arg) {
-    std::vector<std::string> &keys = *(std::vector<std::string> *) arg;
+    GetKeyArg *get_key_arg = (GetKeyArg *) arg;
     Entry *entry = container_of(node, Entry, node);
-    keys.push_back(entry->key);
+    if (entry->ttl_timer.is_expired(get_key_arg->now_ms)) {
+        return;
+    }
+    get_key_arg->keys.push_back(entry->key);
 }
 
 std::unique_ptr<Response> CommandExecutor::do_keys() {
-    std::vector<std::string> keys;
-    kv_store->for_each(get_key, (void *) &keys);
+    GetKeyArg arg;
+    arg.now_ms = get_cached_time_ms();
+    kv_store->for_each(get_key, (void *) &arg);
+    std::vector<std::string> &keys = arg.keys;
 
     std::vector<Response *> elements;
     for (const std::string &key : keys) {
@@ -93,25 +355,162 @@ std::unique_ptr<Response> CommandExecutor::do_keys() {
     return std::make_unique<ArrResponse>(elements);
 }
 
-std::unique_ptr<Response> CommandExecutor::do_zadd(const std::string &key, double score, const std::string &name) {
+std::unique_ptr<Response> CommandExecutor::do_zadd(const std::string &key, const std::vector<SPairView> &pairs, 
+                                                   const ZAddOptions &options) {
     Entry *entry = lookup_entry(key);
 
     if (entry == NULL) {
+        if (options.condition == ZAddOptions::Condition::XX) {
+            log("zadd: key '%s' doesn't exist", key.data());
+            if (options.incr) {
+                return std::make_unique<NilResponse>();
+            }
+            return std::make_unique<IntResponse>(0);
+        }
+
         entry = new Entry(); // sorted set initialized when Entry created
         entry->key = key;
         entry->type = EntryType::SORTED_SET;
         entry->node.hval = str_hash(key);
+        evictor->init_access(entry);
         kv_store->insert(&entry->node);
+        Cluster::shared().add_key(entry);
         log("zadd: created sorted set '%s'", key.data());
-    } else if (entry != NULL && entry->type != EntryType::SORTED_SET) {
+    } else if (entry->type != EntryType::SORTED_SET) {
         log("zadd: value of key '%s' isn't a sorted set", key.data());
         return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
     }
 
-    entry->zset.insert(score, name.data(), name.length());
-    log("zadd: added pair '(%lf, %s)' to sorted set '%s'", score, name.data(), key.data());
+    SortedSet &zset = entry->zset;
+    bool gt = options.comparison == ZAddOptions::Comparison::GT;
+    bool lt = options.comparison == ZAddOptions::Comparison::LT;
 
-    return std::make_unique<IntResponse>(1);
+    if (options.incr) {
+        const SPairView &pair = pairs[0];
+        double old_score;
+        bool exists = zset.lookup(pair.name, pair.len, &old_score);
+        if ((options.condition == ZAddOptions::Condition::NX && exists) || 
+            (options.condition == ZAddOptions::Condition::XX && !exists)) {
+            log("zadd: condition not met for name '%s' in sorted set '%s'", pair.name, key.data());
+            return std::make_unique<NilResponse>();
+        }
+
+        double score = exists ? old_score + pair.score : pair.score;
+        if (std::isnan(score)) {
+            log("zadd: incrementing name '%s' in sorted set '%s' made its score NaN", pair.name, key.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                 "resulting score is not a number (NaN)");
+        }
+        if (exists && ((gt && score <= old_score) || (lt && score >= old_score))) {
+            log("zadd: comparison not met for name '%s' in sorted set '%s'", pair.name, key.data());
+            return std::make_unique<NilResponse>();
+        }
+
+        zset.insert(score, pair.name, pair.len);
+        update_entry_memory(entry);
+        log("zadd: incremented name '%s' in sorted set '%s' to %lf", pair.name, key.data(), score);
+        return std::make_unique<DblResponse>(score);
+    }
+
+    if (zset.length() == 0 && options.condition == ZAddOptions::Condition::ALWAYS && !gt && !lt) {
+        // every pair is new, so there is nothing to check before building the set straight from the pairs
+        uint32_t added = zset.insert_all(pairs);
+        update_entry_memory(entry);
+        log("zadd: added %u pairs to sorted set '%s'", added, key.data());
+        return std::make_unique<IntResponse>(added);
+    }
+
+    uint32_t added = 0;
+    uint32_t changed = 0;
+    for (const SPairView &pair : pairs) {
+        double old_score;
+        bool exists = zset.lookup(pair.name, pair.len, &old_score);
+        if ((options.condition == ZAddOptions::Condition::NX && exists) || 
+            (options.condition == ZAddOptions::Condition::XX && !exists)) {
+            continue;
+        }
+
+        if (!exists) {
+            zset.insert(pair.score, pair.name, pair.len);
+            added++;
+        } else if (pair.score != old_score && !(gt && pair.score < old_score) && !(lt && pair.score > old_score)) {
+            zset.insert(pair.score, pair.name, pair.len);
+            changed++;
+        }
+    }
+    update_entry_memory(entry);
+    log("zadd: added %u and updated %u pairs in sorted set '%s'", added, changed, key.data());
+
+    return std::make_unique<IntResponse>(options.ch ? added + changed : added);
+}
+
+std::unique_ptr<Response> CommandExecutor::execute_zadd(const std::vector<std::string> &command) {
+    std::string name = command[0];
+    ZAddOptions options;
+    uint32_t i = 2;
+
+    if (name == "zincrby") {
+        options.incr = true;
+    } else {
+        bool nx = false, xx = false, gt = false, lt = false;
+        for (; i < command.size(); i++) {
+            std::string option = to_lower(command[i]);
+            if (option == "nx") {
+                nx = true;
+            } else if (option == "xx") {
+                xx = true;
+            } else if (option == "gt") {
+                gt = true;
+            } else if (option == "lt") {
+                lt = true;
+            } else if (option == "ch") {
+                options.ch = true;
+            } else if (option == "incr") {
+                options.incr = true;
+            } else {
+                break; // the first score
+            }
+        }
+
+        if (nx && xx) {
+            log("zadd: NX and XX options given together");
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                 "XX and NX options at the same time are not compatible");
+        } else if ((gt && lt) || (nx && (gt || lt))) {
+            log("zadd: more than one of the GT, LT, and NX options given");
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                 "GT, LT, and/or NX options at the same time are not compatible");
+        }
+
+        if (nx || xx) {
+            options.condition = nx ? ZAddOptions::Condition::NX : ZAddOptions::Condition::XX;
+        }
+        if (gt || lt) {
+            options.comparison = gt ? ZAddOptions::Comparison::GT : ZAddOptions::Comparison::LT;
+        }
+    }
+
+    if (i == command.size() || (command.size() - i) % 2 != 0) {
+        log("%s: missing score or name", name.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    } else if (options.incr && command.size() - i != 2) {
+        log("zadd: INCR option given with more than one pair");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                             "INCR option supports a single increment-element pair");
+    }
+
+    std::vector<SPairView> pairs;
+    pairs.reserve((command.size() - i) / 2);
+    for (; i < command.size(); i += 2) {
+        double score;
+        if (!parse_score(command[i], &score)) {
+            log("%s: invalid score argument", name.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid score argument");
+        }
+        pairs.push_back({ score, command[i + 1].data(), (uint32_t) command[i + 1].length() });
+    }
+
+    return do_zadd(command[1], pairs, options);
 }
 
 std::unique_ptr<Response> CommandExecutor::do_zscore(const std::string &key, const std::string &name) {
@@ -125,14 +524,14 @@ std::unique_ptr<Response> CommandExecutor::do_zscore(const std::string &key, con
         return std::make_unique<NilResponse>();
     } 
 
-    SPair *pair = entry->zset.lookup(name.data(), name.length());
-    if (pair == NULL) {
+    double score;
+    if (!entry->zset.lookup(name.data(), name.length(), &score)) {
         log("zscore: pair with name '%s' doesn't exist in sorted set '%s'", name.data(), key.data());
         return std::make_unique<NilResponse>();
     }
 
     log("zscore: found score of name '%s' in sorted set '%s'", name.data(), key.data());
-    return std::make_unique<StrResponse>(std::to_string(pair->score));
+    return std::make_unique<StrResponse>(std::to_string(score));
 }
 
 std::unique_ptr<Response> CommandExecutor::do_zrem(const std::string &key, const std::string &name) {
@@ -148,6 +547,7 @@ std::unique_ptr<Response> CommandExecutor::do_zrem(const std::string &key, const
 
     bool success = entry->zset.remove(name.data(), name.length());
     if (success) {
+        update_entry_memory(entry);
         log("zrem: removed pair with name '%s' from sorted set '%s'", name.data(), key.data());
         return std::make_unique<IntResponse>(1);
     }
@@ -167,11 +567,11 @@ std::unique_ptr<Response> CommandExecutor::do_zquery(const std::string &key, dou
         return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
     }
 
-    std::vector<SPair *> pairs = entry->zset.find_all_ge(score, name.data(), name.length(), offset, limit);
+    std::vector<SPairView> pairs = entry->zset.find_all_ge(score, name.data(), name.length(), offset, limit);
     std::vector<Response *> elements;
-    for (const SPair *pair : pairs) {
-        Response *score = new DblResponse(pair->score);
-        Response *name = new StrResponse(std::string(pair->name, pair->len));
+    for (const SPairView &pair : pairs) {
+        Response *score = new DblResponse(pair.score);
+        Response *name = new StrResponse(std::string(pair.name, pair.len));
         elements.push_back(score);
         elements.push_back(name);
     }
@@ -180,126 +580,1440 @@ std::unique_ptr<Response> CommandExecutor::do_zquery(const std::string &key, dou
     return std::make_unique<ArrResponse>(elements);
 }
 
-std::unique_ptr<Response> CommandExecutor::do_zrank(const std::string &key, const std::string &name) {
+std::unique_ptr<Response> CommandExecutor::do_zrank(const std::string &key, const std::string &name, bool reverse) {
+    const char *cmd = reverse ? "zrevrank" : "zrank";
     Entry *entry = lookup_entry(key);
     
     if (entry == NULL) {
-        log("zrank: key '%s' doesn't exist", key.data());
+        log("%s: key '%s' doesn't exist", cmd, key.data());
         return std::make_unique<NilResponse>();
     } else if (entry->type != EntryType::SORTED_SET) {
-        log("zrank: value of key '%s' isn't a sorted set", key.data());
+        log("%s: value of key '%s' isn't a sorted set", cmd, key.data());
         return std::make_unique<NilResponse>();
     }
 
-    int64_t rank = entry->zset.rank(name.data(), name.length());
+    int64_t rank = entry->zset.rank(name.data(), name.length(), reverse);
     if (rank < 0) {
-        log("zrank: pair with name '%s' doesn't exist in sorted set '%s'", name.data(), key.data());
+        log("%s: pair with name '%s' doesn't exist in sorted set '%s'", cmd, name.data(), key.data());
         return std::make_unique<NilResponse>();
     }
 
-    log("zrank: found rank of name '%s' in sorted set '%s'", name.data(), key.data());
+    log("%s: found rank of name '%s' in sorted set '%s'", cmd, name.data(), key.data());
     return std::make_unique<IntResponse>(rank);
 }
 
-std::unique_ptr<Response> CommandExecutor::do_expire(const std::string &key, time_t seconds) {
+/**
+ * Builds the response for the zrange family of commands.
+ * 
+ * @param pairs         The pairs.
+ * @param with_scores   Whether to follow each name with its score.
+ * 
+ * @return  ArrResponse: the names of the pairs, each followed by its score if with_scores is set.
+ */
+std::unique_ptr<Response> pairs_to_response(const std::vector<SPairView> &pairs, bool with_scores) {
+    std::vector<Response *> elements;
+    for (const SPairView &pair : pairs) {
+        elements.push_back(new StrResponse(std::string(pair.name, pair.len)));
+        if (with_scores) {
+            elements.push_back(new DblResponse(pair.score));
+        }
+    }
+    return std::make_unique<ArrResponse>(elements);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_zrange(const std::string &key, int64_t start, int64_t stop, 
+                                                     const ZRangeOptions &options) {
+    const char *cmd = options.reverse ? "zrevrange" : "zrange";
     Entry *entry = lookup_entry(key);
+
     if (entry == NULL) {
-        log("expire: key '%s' doesn't exist", key.data());
-        return std::make_unique<IntResponse>(0);
+        log("%s: key '%s' doesn't exist", cmd, key.data());
+        return std::make_unique<ArrResponse>(std::vector<Response *>());
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("%s: value of key '%s' isn't a sorted set", cmd, key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
     }
 
-    entry->ttl_timer.set_expiry(seconds, timers);
-    log("expire: set TTL of key '%s' to %d", key.data(), seconds);
-    return std::make_unique<IntResponse>(1);
+    std::vector<SPairView> pairs = entry->zset.range_by_rank(start, stop, options.reverse);
+    log("%s: got pairs with ranks %ld to %ld in sorted set '%s'", cmd, start, stop, key.data());
+    return pairs_to_response(pairs, options.with_scores);
 }
 
-std::unique_ptr<Response> CommandExecutor::do_ttl(const std::string &key) { 
+std::unique_ptr<Response> CommandExecutor::do_zrangebyscore(const std::string &key, const ScoreRange &range, 
+                                                            const ZRangeOptions &options) {
+    const char *cmd = options.reverse ? "zrevrangebyscore" : "zrangebyscore";
     Entry *entry = lookup_entry(key);
+
     if (entry == NULL) {
-        log("ttl: key '%s' doesn't exist", key.data());
-        return std::make_unique<IntResponse>(-2);
+        log("%s: key '%s' doesn't exist", cmd, key.data());
+        return std::make_unique<ArrResponse>(std::vector<Response *>());
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("%s: value of key '%s' isn't a sorted set", cmd, key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
     }
 
-    TTLTimer *timer = &entry->ttl_timer;
-    if (!timer->is_expiry_set()) {
-        log("ttl: key '%s' doesn't have a TTL", key.data());
-        return std::make_unique<IntResponse>(-1);
+    std::vector<SPairView> pairs = entry->zset.range_by_score(range, options.reverse, options.offset, options.count);
+    log("%s: got pairs with scores %lf to %lf in sorted set '%s'", cmd, range.min, range.max, key.data());
+    return pairs_to_response(pairs, options.with_scores);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_zrangebylex(const std::string &key, const LexRange &range, 
+                                                          const ZRangeOptions &options) {
+    const char *cmd = options.reverse ? "zrevrangebylex" : "zrangebylex";
+    Entry *entry = lookup_entry(key);
+
+    if (entry == NULL) {
+        log("%s: key '%s' doesn't exist", cmd, key.data());
+        return std::make_unique<ArrResponse>(std::vector<Response *>());
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("%s: value of key '%s' isn't a sorted set", cmd, key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
     }
 
-    time_t now_ms = get_time_ms();
-    log("ttl: found TTL of key '%s'", key.data());
-    return std::make_unique<IntResponse>((timer->expiry_time_ms - now_ms) / 1000);
+    std::vector<SPairView> pairs = entry->zset.range_by_lex(range, options.reverse, options.offset, options.count);
+    log("%s: got %lu pairs by name in sorted set '%s'", cmd, pairs.size(), key.data());
+    return pairs_to_response(pairs, false);
 }
 
-std::unique_ptr<Response> CommandExecutor::do_persist(const std::string &key) { 
+std::unique_ptr<Response> CommandExecutor::execute_zrange(const std::vector<std::string> &command) {
+    std::string name = command[0];
+    bool by_score = name == "zrangebyscore" || name == "zrevrangebyscore";
+    bool by_lex = name == "zrangebylex" || name == "zrevrangebylex";
+
+    ZRangeOptions options;
+    options.reverse = name == "zrevrange" || name == "zrevrangebyscore" || name == "zrevrangebylex";
+
+    for (uint32_t i = 4; i < command.size(); i++) {
+        std::string option = to_lower(command[i]);
+
+        if (option == "withscores" && !by_lex) {
+            options.with_scores = true;
+        } else if (option == "limit" && (by_score || by_lex)) {
+            int64_t offset;
+            if (i + 2 >= command.size() || !parse_int(command[i + 1], &offset) || 
+                !parse_int(command[i + 2], &options.count) || offset < 0) {
+                log("%s: invalid LIMIT option", name.data());
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+            }
+            options.offset = offset;
+            i += 2;
+        } else {
+            log("%s: unknown option '%s'", name.data(), command[i].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+        }
+    }
+
+    if (by_lex) {
+        // zrevrangebylex takes the bounds as max then min
+        LexRange range;
+        if (!parse_lex_bound(options.reverse ? command[3] : command[2], &range.min) || 
+            !parse_lex_bound(options.reverse ? command[2] : command[3], &range.max)) {
+            log("%s: invalid name range", name.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                 "min or max not valid string range item");
+        }
+        return do_zrangebylex(command[1], range, options);
+    }
+
+    if (!by_score) {
+        int64_t start, stop;
+        if (!parse_int(command[2], &start) || !parse_int(command[3], &stop)) {
+            log("%s: invalid rank argument", name.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid rank argument");
+        }
+        return do_zrange(command[1], start, stop, options);
+    }
+
+    // zrevrangebyscore takes the bounds as max then min
+    ScoreRange range;
+    const std::string &min = options.reverse ? command[3] : command[2];
+    const std::string &max = options.reverse ? command[2] : command[3];
+    if (!parse_score_bound(min, &range.min, &range.min_exclusive) || 
+        !parse_score_bound(max, &range.max, &range.max_exclusive)) {
+        log("%s: invalid score range", name.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "min or max is not a float");
+    }
+    return do_zrangebyscore(command[1], range, options);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_zremrangebyrank(const std::string &key, int64_t start, int64_t stop) {
     Entry *entry = lookup_entry(key);
+
     if (entry == NULL) {
-        log("persist: key '%s' doesn't exist", key.data());
+        log("zremrangebyrank: key '%s' doesn't exist", key.data());
         return std::make_unique<IntResponse>(0);
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("zremrangebyrank: value of key '%s' isn't a sorted set", key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
     }
 
-    TTLTimer *timer = &entry->ttl_timer;
-    if (!timer->is_expiry_set()) {
-        log("persist: key '%s' doesn't have a TTL", key.data());
+    BPlusTree *removed;
+    uint64_t n = entry->zset.remove_range_by_rank(start, stop, &removed);
+    delete_zset_pairs(removed, thread_pool);
+    update_entry_memory(entry);
+
+    log("zremrangebyrank: removed %lu pairs from sorted set '%s'", n, key.data());
+    return std::make_unique<IntResponse>(n);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_zremrangebyscore(const std::string &key, const ScoreRange &range) {
+    Entry *entry = lookup_entry(key);
+
+    if (entry == NULL) {
+        log("zremrangebyscore: key '%s' doesn't exist", key.data());
         return std::make_unique<IntResponse>(0);
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("zremrangebyscore: value of key '%s' isn't a sorted set", key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
     }
 
-    timer->clear_expiry(timers);
-    log("persist: removed TTL for key '%s'", key.data());
-    return std::make_unique<IntResponse>(1);
+    BPlusTree *removed;
+    uint64_t n = entry->zset.remove_range_by_score(range, &removed);
+    delete_zset_pairs(removed, thread_pool);
+    update_entry_memory(entry);
+
+    log("zremrangebyscore: removed %lu pairs from sorted set '%s'", n, key.data());
+    return std::make_unique<IntResponse>(n);
 }
 
-std::unique_ptr<Response> CommandExecutor::execute(const std::vector<std::string> &command) {
-    if (command.size() < 1) {
-        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "unknown command");
+std::unique_ptr<Response> CommandExecutor::do_zremrangebylex(const std::string &key, const LexRange &range) {
+    Entry *entry = lookup_entry(key);
+
+    if (entry == NULL) {
+        log("zremrangebylex: key '%s' doesn't exist", key.data());
+        return std::make_unique<IntResponse>(0);
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("zremrangebylex: value of key '%s' isn't a sorted set", key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
     }
 
-    std::string name = command[0];
-    if (command.size() == 1) {
-        if (name == "keys") {
-            return do_keys();
-        }
-    } else if (command.size() == 2) {
-        if (name == "get") {
-            return do_get(command[1]);
-        } else if (name == "del") {
-            return do_del(command[1]);
-        } else if (name == "ttl") {
-            return do_ttl(command[1]);
-        } else if (name == "persist") {
-            return do_persist(command[1]);
-        }
-    } else if (command.size() == 3) {
-        if (name == "set") {
-            return do_set(command[1], command[2]);
-        } else if (name == "zscore") {
-            return do_zscore(command[1], command[2]);
-        } else if (name == "zrem") {
-            return do_zrem(command[1], command[2]);
-        } else if (name == "zrank") {
-            return do_zrank(command[1], command[2]); 
-        } else if (name == "expire") {
-            uint32_t seconds;
-            try {
-                seconds = std::stol(command[2]);
-            } catch (...) {
-                log("expire: invalid seconds argument");
-                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid seconds argument");
-            }
+    BPlusTree *removed;
+    uint64_t n = entry->zset.remove_range_by_lex(range, &removed);
+    delete_zset_pairs(removed, thread_pool);
+    update_entry_memory(entry);
 
-            return do_expire(command[1], seconds);
-        }
-    } else if (command.size() == 4) {
-        if (name == "zadd") {
-            double score;
-            try {
-                score = std::stod(command[2]);
-            } catch (...) {
-                log("zadd: invalid score argument");
-                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid score argument");
+    log("zremrangebylex: removed %lu pairs from sorted set '%s'", n, key.data());
+    return std::make_unique<IntResponse>(n);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_zpop(const std::string &key, uint64_t count, bool max) {
+    const char *cmd = max ? "zpopmax" : "zpopmin";
+    Entry *entry = lookup_entry(key);
+
+    if (entry == NULL) {
+        log("%s: key '%s' doesn't exist", cmd, key.data());
+        return std::make_unique<ArrResponse>(std::vector<Response *>());
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("%s: value of key '%s' isn't a sorted set", cmd, key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    }
+
+    count = std::min(count, (uint64_t) entry->zset.length());
+    if (count == 0) {
+        log("%s: nothing to pop from sorted set '%s'", cmd, key.data());
+        return std::make_unique<ArrResponse>(std::vector<Response *>());
+    }
+
+    // build the response before the pairs are removed
+    std::unique_ptr<Response> response = pairs_to_response(entry->zset.range_by_rank(0, count - 1, max), true);
+
+    BPlusTree *removed;
+    if (max) {
+        entry->zset.remove_range_by_rank(-count, -1, &removed);
+    } else {
+        entry->zset.remove_range_by_rank(0, count - 1, &removed);
+    }
+    delete_zset_pairs(removed, thread_pool);
+    update_entry_memory(entry);
+
+    log("%s: popped %lu pairs from sorted set '%s'", cmd, count, key.data());
+    return response;
+}
+
+std::unique_ptr<Response> CommandExecutor::do_zcount(const std::string &key, const ScoreRange &range) {
+    Entry *entry = lookup_entry(key);
+
+    if (entry == NULL) {
+        log("zcount: key '%s' doesn't exist", key.data());
+        return std::make_unique<IntResponse>(0);
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("zcount: value of key '%s' isn't a sorted set", key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    }
+
+    log("zcount: counted pairs with scores %lf to %lf in sorted set '%s'", range.min, range.max, key.data());
+    return std::make_unique<IntResponse>(entry->zset.count(range));
+}
+
+std::unique_ptr<Response> CommandExecutor::do_zlexcount(const std::string &key, const LexRange &range) {
+    Entry *entry = lookup_entry(key);
+
+    if (entry == NULL) {
+        log("zlexcount: key '%s' doesn't exist", key.data());
+        return std::make_unique<IntResponse>(0);
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("zlexcount: value of key '%s' isn't a sorted set", key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    }
+
+    log("zlexcount: counted pairs by name in sorted set '%s'", key.data());
+    return std::make_unique<IntResponse>(entry->zset.count(range));
+}
+
+std::unique_ptr<Response> CommandExecutor::do_zcard(const std::string &key) {
+    Entry *entry = lookup_entry(key);
+
+    if (entry == NULL) {
+        log("zcard: key '%s' doesn't exist", key.data());
+        return std::make_unique<IntResponse>(0);
+    } else if (entry->type != EntryType::SORTED_SET) {
+        log("zcard: value of key '%s' isn't a sorted set", key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    }
+
+    log("zcard: got size of sorted set '%s'", key.data());
+    return std::make_unique<IntResponse>(entry->zset.length());
+}
+
+std::unique_ptr<Response> CommandExecutor::do_zstore(ZStoreOp op, const std::string &dest, 
+                                                     const std::vector<std::string> &keys, 
+                                                     const std::vector<double> &weights, ZAggregate aggregate) {
+    std::vector<SortedSet::Snapshot *> sources;
+    for (const std::string &key : keys) {
+        Entry *entry = lookup_entry(key);
+        if (entry != NULL && entry->type != EntryType::SORTED_SET) {
+            log("zstore: value of key '%s' isn't a sorted set", key.data());
+            for (SortedSet::Snapshot *source : sources) {
+                delete source;
+            }
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+        }
+
+        SortedSet empty;
+        sources.push_back(entry != NULL ? entry->zset.snapshot() : empty.snapshot());
+    }
+
+    ZStoreJob *job = new ZStoreJob(op, dest, sources, weights, aggregate);
+    if (job->input_size() >= LARGE_ZSET_SIZE) {
+        log("zstore: merging %lu pairs into key '%s' in the background", job->input_size(), dest.data());
+        deferred_job = job;
+        return nullptr;
+    }
+
+    job->run();
+    return finish_job(job);
+}
+
+std::unique_ptr<Response> CommandExecutor::execute_zstore(const std::vector<std::string> &command) {
+    std::string name = command[0];
+    int64_t num_keys;
+    if (!parse_int(command[2], &num_keys) || num_keys < 1) {
+        log("%s: invalid numkeys argument", name.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "at least 1 input key is needed");
+    } else if ((uint64_t) num_keys > command.size() - 3) {
+        log("%s: fewer keys than numkeys", name.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    }
+
+    std::vector<std::string> keys(command.begin() + 3, command.begin() + 3 + num_keys);
+    std::vector<double> weights(num_keys, 1);
+    ZAggregate aggregate = ZAggregate::SUM;
+    for (uint64_t i = 3 + num_keys; i < command.size(); i++) {
+        std::string option = to_lower(command[i]);
+        if (name == "zdiffstore") {
+            log("zdiffstore: unexpected argument '%s'", command[i].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+        } else if (option == "weights" && command.size() - i - 1 >= (uint64_t) num_keys) {
+            for (int64_t j = 0; j < num_keys; j++) {
+                if (!parse_score(command[++i], &weights[j])) {
+                    log("%s: invalid weight argument", name.data());
+                    return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                         "weight value is not a float");
+                }
+            }
+        } else if (option == "aggregate" && i + 1 < command.size()) {
+            std::string value = to_lower(command[++i]);
+            if (value == "sum") {
+                aggregate = ZAggregate::SUM;
+            } else if (value == "min") {
+                aggregate = ZAggregate::MIN;
+            } else if (value == "max") {
+                aggregate = ZAggregate::MAX;
+            } else {
+                log("%s: invalid aggregate argument", name.data());
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+            }
+        } else {
+            log("%s: unexpected argument '%s'", name.data(), command[i].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+        }
+    }
+
+    ZStoreOp op = name == "zunionstore" ? ZStoreOp::UNION : name == "zinterstore" ? ZStoreOp::INTER : ZStoreOp::DIFF;
+    return do_zstore(op, command[1], keys, weights, aggregate);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_expire(const std::string &key, time_t seconds) {
+    return expire_entry_at("expire", key, seconds, 1000, false);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_pexpire(const std::string &key, time_t ms) {
+    return expire_entry_at("pexpire", key, ms, 1, false);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_expireat(const std::string &key, time_t unix_time) {
+    return expire_entry_at("expireat", key, unix_time, 1000, true);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_pexpireat(const std::string &key, time_t unix_time_ms) {
+    return expire_entry_at("pexpireat", key, unix_time_ms, 1, true);
+}
+
+std::unique_ptr<Response> CommandExecutor::expire_entry_at(const char *cmd, const std::string &key, int64_t time, 
+                                                           int64_t unit_ms, bool absolute) {
+    time_t expiry_time_ms;
+    if (!to_expiry_time_ms(time, unit_ms, absolute, &expiry_time_ms)) {
+        log("%s: expire time out of range", cmd);
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid expire time");
+    }
+
+    Entry *entry = lookup_entry(key);
+    if (entry == NULL) {
+        log("%s: key '%s' doesn't exist", cmd, key.data());
+        return std::make_unique<IntResponse>(0);
+    }
+
+    if (expiry_time_ms <= get_cached_time_ms()) {
+        // already expired, don't leave it for the timers or the next read
+        delete_entry(remove_entry(key), timers, thread_pool);
+        log("%s: expiry of key '%s' has already passed, deleted it", cmd, key.data());
+        return std::make_unique<IntResponse>(1);
+    }
+
+    entry->ttl_timer.set_expiry_at(expiry_time_ms, timers);
+    log("%s: set expiry of key '%s' to %ld", cmd, key.data(), expiry_time_ms);
+    return std::make_unique<IntResponse>(1);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_pttl(const std::string &key) { 
+    Entry *entry = lookup_entry(key);
+    if (entry == NULL) {
+        log("pttl: key '%s' doesn't exist", key.data());
+        return std::make_unique<IntResponse>(-2);
+    }
+
+    TTLTimer *timer = &entry->ttl_timer;
+    if (!timer->is_expiry_set()) {
+        log("pttl: key '%s' doesn't have a TTL", key.data());
+        return std::make_unique<IntResponse>(-1);
+    }
+
+    time_t now_ms = get_cached_time_ms();
+    log("pttl: found TTL of key '%s'", key.data());
+    return std::make_unique<IntResponse>(timer->expiry_time_ms - now_ms);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_ttl(const std::string &key) { 
+    Entry *entry = lookup_entry(key);
+    if (entry == NULL) {
+        log("ttl: key '%s' doesn't exist", key.data());
+        return std::make_unique<IntResponse>(-2);
+    }
+
+    TTLTimer *timer = &entry->ttl_timer;
+    if (!timer->is_expiry_set()) {
+        log("ttl: key '%s' doesn't have a TTL", key.data());
+        return std::make_unique<IntResponse>(-1);
+    }
+
+    time_t now_ms = get_cached_time_ms();
+    log("ttl: found TTL of key '%s'", key.data());
+    return std::make_unique<IntResponse>((timer->expiry_time_ms - now_ms) / 1000);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_persist(const std::string &key) { 
+    Entry *entry = lookup_entry(key);
+    if (entry == NULL) {
+        log("persist: key '%s' doesn't exist", key.data());
+        return std::make_unique<IntResponse>(0);
+    }
+
+    TTLTimer *timer = &entry->ttl_timer;
+    if (!timer->is_expiry_set()) {
+        log("persist: key '%s' doesn't have a TTL", key.data());
+        return std::make_unique<IntResponse>(0);
+    }
+
+    timer->clear_expiry(timers);
+    log("persist: removed TTL for key '%s'", key.data());
+    return std::make_unique<IntResponse>(1);
+}
+
+/**
+ * Adds a "field:value" line to the elements of an info response.
+ * 
+ * @param elements  Reference to the elements of the response.
+ * @param field     The name of the field.
+ * @param value     The value of the field.
+ */
+void add_info_field(std::vector<Response *> &elements, const std::string &field, const std::string &value) {
+    elements.push_back(new StrResponse(field + ":" + value));
+}
+
+/* Adds a "field:value" line with an integer value to the elements of an info response */
+void add_info_field(std::vector<Response *> &elements, const std::string &field, uint64_t value) {
+    add_info_field(elements, field, std::to_string(value));
+}
+
+std::unique_ptr<Response> CommandExecutor::do_config_get(const std::string &param) {
+    std::string value;
+    if (param == "maxmemory") {
+        value = std::to_string(evictor->get_maxmemory());
+    } else if (param == "maxmemory-policy") {
+        value = Evictor::policy_name(evictor->get_policy());
+    } else if (param == "zset-max-listpack-entries") {
+        value = std::to_string(SortedSet::max_listpack_entries);
+    } else if (param == "zset-max-listpack-value") {
+        value = std::to_string(SortedSet::max_listpack_value);
+    } else if (param == "save") {
+        value = Rdb::shared().get_save_points();
+    } else if (param == "dbfilename") {
+        value = Rdb::shared().get_filename();
+    } else if (param == "appendonly") {
+        value = Aof::shared().is_enabled() ? "yes" : "no";
+    } else if (param == "appendfsync") {
+        value = Aof::fsync_policy_name(Aof::shared().get_fsync_policy());
+    } else if (param == "appendfilename") {
+        value = Aof::shared().get_filename();
+    } else if (param == "aof-use-rdb-preamble") {
+        value = Aof::shared().get_use_rdb_preamble() ? "yes" : "no";
+    } else if (param == "auto-aof-rewrite-percentage") {
+        value = std::to_string(Aof::shared().get_auto_rewrite_percentage());
+    } else if (param == "auto-aof-rewrite-min-size") {
+        value = std::to_string(Aof::shared().get_auto_rewrite_min_size());
+    } else if (param == "repl-backlog-size") {
+        value = std::to_string(Replication::shared().get_backlog_size());
+    } else if (param == "client-output-buffer-limit-pubsub") {
+        value = PubSub::shared().get_limits();
+    } else {
+        log("config get: unsupported parameter '%s'", param.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "unsupported parameter");
+    }
+
+    log("config get: got parameter '%s'", param.data());
+    return std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse(param), new StrResponse(value) });
+}
+
+std::unique_ptr<Response> CommandExecutor::do_config_set(const std::string &param, const std::string &value) {
+    if (param == "maxmemory") {
+        int64_t maxmemory;
+        if (!parse_int(value, &maxmemory) || maxmemory < 0) {
+            log("config set: invalid maxmemory '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid maxmemory");
+        }
+        evictor->set_maxmemory(maxmemory);
+    } else if (param == "maxmemory-policy") {
+        EvictionPolicy policy;
+        if (!Evictor::parse_policy(to_lower(value), &policy)) {
+            log("config set: invalid maxmemory-policy '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid maxmemory-policy");
+        }
+        evictor->set_policy(policy);
+    } else if (param == "zset-max-listpack-entries" || param == "zset-max-listpack-value") {
+        // names in a listpack have a 1-byte length
+        int64_t max = param == "zset-max-listpack-entries" ? UINT32_MAX : Listpack::MAX_NAME_LEN;
+        int64_t n;
+        if (!parse_int(value, &n) || n < 0 || n > max) {
+            log("config set: invalid %s '%s'", param.data(), value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid " + param);
+        }
+
+        if (param == "zset-max-listpack-entries") {
+            SortedSet::max_listpack_entries = n;
+        } else {
+            SortedSet::max_listpack_value = n;
+        }
+    } else if (param == "save") {
+        if (!Rdb::shared().set_save_points(value)) {
+            log("config set: invalid save '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid save");
+        }
+    } else if (param == "dbfilename") {
+        if (value.empty() || value.find('/') != std::string::npos) {
+            log("config set: invalid dbfilename '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid dbfilename");
+        }
+        Rdb::shared().set_filename(value);
+    } else if (param == "appendonly") {
+        std::string lower = to_lower(value);
+        if (lower != "yes" && lower != "no") {
+            log("config set: invalid appendonly '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid appendonly");
+        }
+
+        if (lower == "no") {
+            Aof::shared().stop();
+        } else if (!Aof::shared().start(*kv_store)) {
+            log("config set: failed to start append-only file");
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "failed to start append-only file");
+        }
+    } else if (param == "appendfsync") {
+        AofFsync policy;
+        if (!Aof::parse_fsync_policy(to_lower(value), &policy)) {
+            log("config set: invalid appendfsync '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid appendfsync");
+        }
+        Aof::shared().set_fsync_policy(policy);
+    } else if (param == "appendfilename") {
+        if (value.empty() || value.find('/') != std::string::npos || Aof::shared().is_enabled()) {
+            log("config set: invalid appendfilename '%s', or append-only file is on", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid appendfilename");
+        }
+        Aof::shared().set_filename(value);
+    } else if (param == "aof-use-rdb-preamble") {
+        std::string lower = to_lower(value);
+        if (lower != "yes" && lower != "no") {
+            log("config set: invalid aof-use-rdb-preamble '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid aof-use-rdb-preamble");
+        }
+        Aof::shared().set_use_rdb_preamble(lower == "yes");
+    } else if (param == "auto-aof-rewrite-percentage") {
+        int64_t percentage;
+        if (!parse_int(value, &percentage) || percentage < 0 || percentage > UINT32_MAX) {
+            log("config set: invalid auto-aof-rewrite-percentage '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                 "invalid auto-aof-rewrite-percentage");
+        }
+        Aof::shared().set_auto_rewrite_percentage(percentage);
+    } else if (param == "auto-aof-rewrite-min-size") {
+        int64_t size;
+        if (!parse_int(value, &size) || size < 0) {
+            log("config set: invalid auto-aof-rewrite-min-size '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                 "invalid auto-aof-rewrite-min-size");
+        }
+        Aof::shared().set_auto_rewrite_min_size(size);
+    } else if (param == "repl-backlog-size") {
+        int64_t size;
+        if (!parse_int(value, &size) || size < 1) {
+            log("config set: invalid repl-backlog-size '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid repl-backlog-size");
+        }
+        Replication::shared().set_backlog_size(size);
+    } else if (param == "client-output-buffer-limit-pubsub") {
+        if (!PubSub::shared().set_limits(value)) {
+            log("config set: invalid client-output-buffer-limit-pubsub '%s'", value.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                 "invalid client-output-buffer-limit-pubsub");
+        }
+    } else {
+        log("config set: unsupported parameter '%s'", param.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "unsupported parameter");
+    }
+
+    log("config set: set parameter '%s' to '%s'", param.data(), value.data());
+    return std::make_unique<StrResponse>("OK");
+}
+
+std::unique_ptr<Response> CommandExecutor::do_info() {
+    std::vector<Response *> elements;
+
+    add_info_field(elements, "keys", kv_store->length());
+
+    const ExpiryStats &expiry_stats = timers->get_expiry_stats();
+    add_info_field(elements, "expired_keys", expiry_stats.active_expired + expiry_stats.lazy_expired);
+    add_info_field(elements, "active_expired_keys", expiry_stats.active_expired);
+    add_info_field(elements, "lazy_expired_keys", expiry_stats.lazy_expired);
+    add_info_field(elements, "expire_cycle_expired_keys", expiry_stats.cycle_expired);
+    add_info_field(elements, "expire_cycle_us", expiry_stats.cycle_us);
+    add_info_field(elements, "expire_cycle_timed_out", expiry_stats.cycle_timed_out);
+    add_info_field(elements, "expire_cycle_effort", expiry_stats.effort);
+    add_info_field(elements, "expire_cycle_timed_out_count", expiry_stats.timed_out_cycles);
+
+    add_info_field(elements, "used_memory", get_used_memory());
+    add_info_field(elements, "maxmemory", evictor->get_maxmemory());
+    add_info_field(elements, "maxmemory_policy", Evictor::policy_name(evictor->get_policy()));
+    const EvictionStats &eviction_stats = evictor->get_stats();
+    add_info_field(elements, "evicted_keys", eviction_stats.evicted);
+    add_info_field(elements, "eviction_timed_out_count", eviction_stats.timed_out);
+
+    SlabStats slab_stats = SlabAllocator::shared().get_stats();
+    char fragmentation_ratio[32];
+    snprintf(fragmentation_ratio, sizeof(fragmentation_ratio), "%.2f", slab_stats.fragmentation_ratio());
+    add_info_field(elements, "slab_reserved_bytes", slab_stats.reserved_bytes);
+    add_info_field(elements, "slab_bytes", slab_stats.slab_bytes);
+    add_info_field(elements, "slab_used_bytes", slab_stats.used_bytes);
+    add_info_field(elements, "slab_released_bytes", slab_stats.released_bytes);
+    add_info_field(elements, "slab_fragmentation_ratio", fragmentation_ratio);
+    add_info_field(elements, "slab_allocs", slab_stats.allocs);
+    add_info_field(elements, "slab_frees", slab_stats.frees);
+    add_info_field(elements, "slab_large_allocs", slab_stats.large_allocs);
+    add_info_field(elements, "slab_defrag_hits", slab_stats.defrag_hits);
+    add_info_field(elements, "slab_defrag_misses", slab_stats.defrag_misses);
+
+    const RdbStats &rdb_stats = Rdb::shared().get_stats();
+    add_info_field(elements, "rdb_changes_since_last_save", rdb_stats.changes_since_last_save);
+    add_info_field(elements, "rdb_bgsave_in_progress", rdb_stats.bgsave_in_progress);
+    add_info_field(elements, "rdb_last_save_time", rdb_stats.last_save_time);
+    add_info_field(elements, "rdb_last_bgsave_status", rdb_stats.last_bgsave_ok ? "ok" : "err");
+    add_info_field(elements, "rdb_last_bgsave_time_ms", rdb_stats.last_bgsave_ms);
+    add_info_field(elements, "rdb_last_cow_size", rdb_stats.last_cow_bytes);
+    add_info_field(elements, "rdb_saves", rdb_stats.saves);
+
+    const AofStats &aof_stats = Aof::shared().get_stats();
+    add_info_field(elements, "aof_enabled", Aof::shared().is_enabled());
+    add_info_field(elements, "aof_fsync", Aof::fsync_policy_name(Aof::shared().get_fsync_policy()));
+    add_info_field(elements, "aof_current_size", aof_stats.size);
+    add_info_field(elements, "aof_writes", aof_stats.writes);
+    add_info_field(elements, "aof_fsyncs", aof_stats.fsyncs);
+    add_info_field(elements, "aof_delayed_fsync", aof_stats.delayed_fsyncs);
+    add_info_field(elements, "aof_last_write_status", aof_stats.last_write_ok ? "ok" : "err");
+    add_info_field(elements, "aof_base_size", aof_stats.base_size);
+    add_info_field(elements, "aof_rewrite_in_progress", aof_stats.rewrite_in_progress);
+    add_info_field(elements, "aof_rewrites", aof_stats.rewrites);
+    add_info_field(elements, "aof_last_bgrewrite_status", aof_stats.last_rewrite_ok ? "ok" : "err");
+    add_info_field(elements, "aof_last_rewrite_time_ms", aof_stats.last_rewrite_ms);
+
+    Replication &replication = Replication::shared();
+    time_t now_ms = get_time_ms();
+    add_info_field(elements, "role", replication.is_replica() ? "replica" : "primary");
+    add_info_field(elements, "repl_id", replication.get_replid());
+    add_info_field(elements, "repl_offset", replication.get_offset());
+    if (replication.is_replica()) {
+        bool link_up = replication.get_link_state() == PrimaryLinkState::CONNECTED;
+        add_info_field(elements, "primary_host", replication.get_primary_host());
+        add_info_field(elements, "primary_port", replication.get_primary_port());
+        add_info_field(elements, "primary_link_status", link_up ? "up" : "down");
+        add_info_field(elements, "primary_last_io_ms_ago", now_ms - replication.get_last_io_ms());
+        add_info_field(elements, "primary_sync_in_progress", 
+                       replication.get_link_state() == PrimaryLinkState::TRANSFER);
+    }
+    add_info_field(elements, "connected_replicas", replication.get_replicas().size());
+    for (uint32_t i = 0; i < replication.get_replicas().size(); i++) {
+        // lag is how far behind the replica's last ack is, in bytes of the stream and in time
+        const ReplicaLink *replica = replication.get_replicas()[i];
+        static const char *state_names[] = { "wait_bgsave", "wait_bgsave", "send_bulk", "online" };
+        add_info_field(elements, "replica" + std::to_string(i), 
+                       "fd=" + std::to_string(replica->conn->fd) + 
+                       ",state=" + state_names[(int) replica->state] + 
+                       ",offset=" + std::to_string(replica->ack_offset) + 
+                       ",lag_bytes=" + std::to_string(replication.get_offset() - replica->ack_offset) + 
+                       ",lag_ms=" + std::to_string(now_ms - replica->last_ack_ms));
+    }
+    const ReplStats &repl_stats = replication.get_stats();
+    add_info_field(elements, "repl_backlog_size", replication.get_backlog_size());
+    add_info_field(elements, "repl_backlog_first_byte_offset", replication.get_backlog_start_offset());
+    add_info_field(elements, "sync_full", repl_stats.full_syncs);
+    add_info_field(elements, "sync_partial_ok", repl_stats.partial_syncs);
+    add_info_field(elements, "sync_partial_err", repl_stats.partial_sync_errs);
+
+    PubSub &pub_sub = PubSub::shared();
+    add_info_field(elements, "pubsub_channels", pub_sub.get_num_channels());
+    add_info_field(elements, "pubsub_patterns", pub_sub.get_num_patterns());
+    add_info_field(elements, "pubsub_published_messages", pub_sub.get_stats().published);
+    add_info_field(elements, "pubsub_delivered_messages", pub_sub.get_stats().delivered);
+    add_info_field(elements, "pubsub_slow_subscriber_disconnects", pub_sub.get_stats().slow_disconnects);
+
+    Cluster &cluster = Cluster::shared();
+    add_info_field(elements, "cluster_enabled", cluster.is_enabled());
+    if (cluster.is_enabled()) {
+        add_info_field(elements, "cluster_slots_assigned", cluster.get_slots_assigned());
+        add_info_field(elements, "cluster_slots_owned", cluster.get_slots_owned());
+        add_info_field(elements, "cluster_moved_redirects", cluster.get_stats().moved);
+        add_info_field(elements, "cluster_ask_redirects", cluster.get_stats().ask);
+    }
+
+    return std::make_unique<ArrResponse>(elements);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_save() {
+    if (Rdb::shared().get_stats().bgsave_in_progress) {
+        log("save: bgsave already in progress");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "Background save already in progress");
+    }
+
+    if (!Rdb::shared().save(*kv_store)) {
+        log("save: failed to save snapshot");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "failed to save snapshot");
+    }
+
+    log("save: saved snapshot");
+    return std::make_unique<StrResponse>("OK");
+}
+
+std::unique_ptr<Response> CommandExecutor::do_bgsave() {
+    if (Rdb::shared().get_stats().bgsave_in_progress) {
+        log("bgsave: bgsave already in progress");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "Background save already in progress");
+    }
+
+    if (!Rdb::shared().bgsave(*kv_store)) {
+        log("bgsave: failed to start child");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "failed to start background save");
+    }
+
+    log("bgsave: started");
+    return std::make_unique<StrResponse>("Background saving started");
+}
+
+std::unique_ptr<Response> CommandExecutor::do_lastsave() {
+    log("lastsave: got last save time");
+    return std::make_unique<IntResponse>(Rdb::shared().get_stats().last_save_time);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_bgrewriteaof() {
+    if (!Aof::shared().is_enabled()) {
+        log("bgrewriteaof: append-only file is off");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "append-only file is off");
+    } else if (Aof::shared().get_stats().rewrite_in_progress) {
+        log("bgrewriteaof: rewrite already in progress");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, 
+                                             "Background append only file rewriting already in progress");
+    }
+
+    if (!Aof::shared().bgrewrite(*kv_store)) {
+        log("bgrewriteaof: failed to start child");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, 
+                                             "failed to start background append only file rewriting");
+    }
+
+    log("bgrewriteaof: started");
+    return std::make_unique<StrResponse>("Background append only file rewriting started");
+}
+
+std::unique_ptr<Response> CommandExecutor::do_replicaof(const std::string &host, const std::string &port) {
+    if (to_lower(host) == "no" && to_lower(port) == "one") {
+        Replication::shared().unset_primary();
+        log("replicaof: now a primary");
+        return std::make_unique<StrResponse>("OK");
+    }
+
+    int64_t port_num;
+    if (!parse_int(port, &port_num) || port_num < 1 || port_num > UINT16_MAX) {
+        log("replicaof: invalid port '%s'", port.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid port");
+    }
+
+    Replication::shared().set_primary(host, port);
+    log("replicaof: now a replica of %s:%s", host.data(), port.data());
+    return std::make_unique<StrResponse>("OK");
+}
+
+/**
+ * Parses a hash slot.
+ * 
+ * @param arg   The argument.
+ * @param out   Pointer to where the slot is stored.
+ * 
+ * @return  True if the argument is a valid slot, false otherwise.
+ */
+bool parse_slot(const std::string &arg, uint16_t *out) {
+    int64_t slot;
+    if (!parse_int(arg, &slot) || slot < 0 || slot >= CLUSTER_SLOTS) {
+        return false;
+    }
+
+    *out = slot;
+    return true;
+}
+
+std::unique_ptr<Response> CommandExecutor::execute_cluster(const std::vector<std::string> &command) {
+    Cluster &cluster = Cluster::shared();
+    if (!cluster.is_enabled()) {
+        log("cluster: cluster mode is off");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "This instance has cluster support disabled");
+    }
+
+    std::string sub = to_lower(command[1]);
+    if (sub == "keyslot" && command.size() == 3) {
+        log("cluster keyslot: got slot of key '%s'", command[2].data());
+        return std::make_unique<IntResponse>(key_hash_slot(command[2]));
+    } else if (sub == "myself" && command.size() == 2) {
+        log("cluster myself: got address");
+        return std::make_unique<StrResponse>(cluster.get_myself());
+    } else if (sub == "slots" && command.size() == 2) {
+        std::vector<Response *> ranges;
+        for (const SlotRange &range : cluster.get_slot_ranges()) {
+            ranges.push_back(new ArrResponse({ new IntResponse(range.start), new IntResponse(range.end), 
+                                               new StrResponse(range.node) }));
+        }
+        log("cluster slots: got %lu slot ranges", ranges.size());
+        return std::make_unique<ArrResponse>(ranges);
+    } else if (sub == "addslots" && command.size() >= 3) {
+        std::vector<uint16_t> slots;
+        for (uint32_t i = 2; i < command.size(); i++) {
+            uint16_t slot;
+            if (!parse_slot(command[i], &slot)) {
+                log("cluster addslots: invalid slot '%s'", command[i].data());
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid slot");
+            }
+            slots.push_back(slot);
+        }
+
+        for (uint16_t slot : slots) {
+            cluster.set_slot_node(slot, cluster.get_myself());
+        }
+        log("cluster addslots: assigned %lu slots", slots.size());
+        return std::make_unique<StrResponse>("OK");
+    } else if (sub == "addslotsrange" && command.size() >= 4 && command.size() % 2 == 0) {
+        std::vector<std::pair<uint16_t, uint16_t>> ranges;
+        for (uint32_t i = 2; i < command.size(); i += 2) {
+            uint16_t start, end;
+            if (!parse_slot(command[i], &start) || !parse_slot(command[i + 1], &end) || start > end) {
+                log("cluster addslotsrange: invalid range '%s' '%s'", command[i].data(), command[i + 1].data());
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid slot range");
+            }
+            ranges.push_back({ start, end });
+        }
+
+        for (auto [start, end] : ranges) {
+            for (uint32_t slot = start; slot <= end; slot++) {
+                cluster.set_slot_node(slot, cluster.get_myself());
+            }
+        }
+        log("cluster addslotsrange: assigned %lu slot ranges", ranges.size());
+        return std::make_unique<StrResponse>("OK");
+    } else if (sub == "setslot" && (command.size() == 4 || command.size() == 5)) {
+        uint16_t slot;
+        if (!parse_slot(command[2], &slot)) {
+            log("cluster setslot: invalid slot '%s'", command[2].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid slot");
+        }
+
+        std::string state = to_lower(command[3]);
+        if (state == "stable" && command.size() == 4) {
+            cluster.set_slot_stable(slot);
+        } else if (state == "node" && command.size() == 5) {
+            cluster.set_slot_node(slot, command[4]);
+        } else if (state == "migrating" && command.size() == 5) {
+            if (!cluster.set_slot_migrating(slot, command[4])) {
+                log("cluster setslot: can't migrate slot %u, not its owner", slot);
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                     "I'm not the owner of hash slot " + std::to_string(slot));
+            }
+        } else if (state == "importing" && command.size() == 5) {
+            if (!cluster.set_slot_importing(slot, command[4])) {
+                log("cluster setslot: can't import slot %u, already its owner", slot);
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                     "I'm already the owner of hash slot " + std::to_string(slot));
+            }
+        } else {
+            log("cluster setslot: invalid subcommand '%s'", command[3].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid setslot subcommand");
+        }
+
+        log("cluster setslot: slot %u %s", slot, state.data());
+        return std::make_unique<StrResponse>("OK");
+    } else if (sub == "countkeysinslot" && command.size() == 3) {
+        uint16_t slot;
+        if (!parse_slot(command[2], &slot)) {
+            log("cluster countkeysinslot: invalid slot '%s'", command[2].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid slot");
+        }
+
+        log("cluster countkeysinslot: counted keys in slot %u", slot);
+        return std::make_unique<IntResponse>(cluster.count_keys_in_slot(slot));
+    } else if (sub == "getkeysinslot" && command.size() == 4) {
+        uint16_t slot;
+        int64_t count;
+        if (!parse_slot(command[2], &slot) || !parse_int(command[3], &count) || count < 0) {
+            log("cluster getkeysinslot: invalid arguments");
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid slot or count");
+        }
+
+        std::vector<Response *> keys;
+        for (const std::string &key : cluster.get_keys_in_slot(slot, std::min<int64_t>(count, UINT32_MAX))) {
+            keys.push_back(new StrResponse(key));
+        }
+        log("cluster getkeysinslot: got %lu keys in slot %u", keys.size(), slot);
+        return std::make_unique<ArrResponse>(keys);
+    }
+
+    log("cluster: unknown subcommand '%s'", command[1].data());
+    return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "unknown cluster subcommand");
+}
+
+std::unique_ptr<Response> CommandExecutor::do_dump(const std::string &key) {
+    Entry *entry = lookup_entry(key);
+    if (entry == NULL) {
+        log("dump: key '%s' doesn't exist", key.data());
+        return std::make_unique<NilResponse>();
+    }
+
+    int64_t ttl_ms = RDB_NO_EXPIRY;
+    if (entry->ttl_timer.is_expiry_set()) {
+        ttl_ms = std::max<int64_t>(entry->ttl_timer.expiry_time_ms - get_cached_time_ms(), 1);
+    }
+
+    // the payload must fit in a restore request along with the rest of the command
+    std::string payload = dump_entry(entry, ttl_ms);
+    if (payload.size() + key.size() + 128 > Request::MAX_LEN) {
+        log("dump: value of key '%s' is too big to dump", key.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_TOO_BIG, 
+                                             "value is too big to dump, use migrate to move it");
+    }
+
+    log("dump: dumped key '%s'", key.data());
+    return std::make_unique<StrResponse>(payload);
+}
+
+std::unique_ptr<Response> CommandExecutor::do_restore(const std::string &key, Entry *restored, time_t expiry_time_ms, 
+                                                      const RestoreOptions &options) {
+    Entry *entry = lookup_entry(key);
+    if (entry != NULL && !options.replace && !options.append) {
+        log("restore: key '%s' already exists", key.data());
+        delete restored;
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, 
+                                             "BUSYKEY Target key name already exists.");
+    } else if (entry == NULL && options.append) {
+        // e.g. it expired or was deleted between chunks, so this chunk alone would be the wrong value
+        log("restore: key '%s' to append to doesn't exist", key.data());
+        delete restored;
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "no such key");
+    } else if (entry != NULL && options.append && entry->type != restored->type) {
+        log("restore: value of key '%s' isn't the type of the payload", key.data());
+        delete restored;
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, 
+                                             "value is not the type of the payload");
+    }
+
+    if (expiry_time_ms != -1 && expiry_time_ms <= get_cached_time_ms()) {
+        if (entry != NULL) {
+            kv_store->remove(&entry->node, are_entries_equal);
+            delete_entry(entry, timers, thread_pool);
+        }
+        log("restore: TTL of key '%s' has already passed", key.data());
+        delete restored;
+        return std::make_unique<StrResponse>("OK");
+    }
+
+    if (entry != NULL && options.append) {
+        if (entry->type == EntryType::STR) {
+            entry->str.append(restored->str.data(), restored->str.size());
+        } else {
+            for (const SPairView &pair : restored->zset.range_by_rank(0, -1)) {
+                entry->zset.insert(pair.score, pair.name, pair.len);
+            }
+        }
+        delete restored;
+        log("restore: appended to key '%s'", key.data());
+    } else {
+        if (entry != NULL) {
+            kv_store->remove(&entry->node, are_entries_equal);
+            delete_entry(entry, timers, thread_pool);
+        }
+
+        entry = restored;
+        entry->key = key;
+        entry->node.hval = str_hash(key);
+        evictor->init_access(entry);
+        kv_store->insert(&entry->node);
+        Cluster::shared().add_key(entry);
+        log("restore: created key '%s'", key.data());
+    }
+    update_entry_memory(entry);
+
+    if (expiry_time_ms != -1) {
+        entry->ttl_timer.set_expiry_at(expiry_time_ms, timers);
+    }
+
+    return std::make_unique<StrResponse>("OK");
+}
+
+std::unique_ptr<Response> CommandExecutor::execute_restore(const std::vector<std::string> &command) {
+    std::string name = command[0];
+    int64_t ttl;
+    if (!parse_int(command[2], &ttl) || ttl < 0) {
+        log("%s: invalid ttl argument", name.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "Invalid TTL value, must be >= 0");
+    }
+
+    RestoreOptions options;
+    bool abs_ttl = false;
+    for (uint32_t i = 4; i < command.size(); i++) {
+        std::string option = to_lower(command[i]);
+        if (option == "replace") {
+            options.replace = true;
+        } else if (option == "append") {
+            options.append = true;
+        } else if (option == "absttl") {
+            abs_ttl = true;
+        } else {
+            log("%s: unexpected argument '%s'", name.data(), command[i].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+        }
+    }
+
+    Entry *restored;
+    int64_t payload_ttl_ms;
+    if (!read_dump(command[3], &restored, &payload_ttl_ms)) {
+        log("%s: invalid payload", name.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                             "DUMP payload version or checksum are wrong");
+    }
+
+    time_t expiry_time_ms = -1;
+    bool in_range = true;
+    if (ttl > 0) {
+        in_range = to_expiry_time_ms(ttl, 1, abs_ttl, &expiry_time_ms);
+    } else if (payload_ttl_ms != RDB_NO_EXPIRY) {
+        in_range = to_expiry_time_ms(payload_ttl_ms, 1, false, &expiry_time_ms);
+    }
+    if (!in_range) {
+        log("%s: expire time out of range", name.data());
+        delete restored;
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid expire time");
+    }
+
+    return do_restore(command[1], restored, expiry_time_ms, options);
+}
+
+std::unique_ptr<Response> CommandExecutor::execute_migrate(const std::vector<std::string> &command) {
+    int64_t port, timeout;
+    if (!parse_int(command[2], &port) || port < 1 || port > UINT16_MAX) {
+        log("migrate: invalid port '%s'", command[2].data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid port");
+    } else if (!parse_int(command[4], &timeout) || timeout < 0 || timeout > UINT32_MAX) {
+        log("migrate: invalid timeout argument");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid timeout argument");
+    }
+
+    MigrateOptions options;
+    options.timeout_ms = timeout;
+    std::vector<std::string> keys;
+    if (!command[3].empty()) {
+        keys.push_back(command[3]);
+    }
+    for (uint32_t i = 5; i < command.size(); i++) {
+        std::string option = to_lower(command[i]);
+        if (option == "copy") {
+            options.copy = true;
+        } else if (option == "replace") {
+            options.replace = true;
+        } else if (option == "keys" && command[3].empty() && i + 1 < command.size()) {
+            keys.insert(keys.end(), command.begin() + i + 1, command.end());
+            break;
+        } else {
+            log("migrate: unexpected argument '%s'", command[i].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+        }
+    }
+
+    if (keys.empty()) {
+        log("migrate: no keys given");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    } else if (!options.copy && Replication::shared().rejects_writes()) {
+        log("migrate: rejected on a replica");
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_READONLY, 
+                                             "You can't write against a read only replica.");
+    }
+
+    for (const std::string &key : keys) {
+        if (MigrateJob::is_locked(key)) {
+            log("migrate: key '%s' is already being migrated", key.data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "TRYAGAIN key is being migrated");
+        }
+    }
+
+    // snapshot the values so the job can send them while the event loop keeps running
+    std::vector<MigrateItem> items;
+    std::unordered_set<std::string> seen;
+    for (const std::string &key : keys) {
+        Entry *entry = lookup_entry(key);
+        if (entry == NULL || !seen.insert(key).second) {
+            continue;
+        }
+
+        MigrateItem item;
+        item.key = key;
+        item.type = entry->type;
+        if (entry->type == EntryType::STR) {
+            item.str.assign(entry->str.data(), entry->str.size());
+        } else {
+            item.zset = entry->zset.snapshot();
+        }
+        if (entry->ttl_timer.is_expiry_set()) {
+            item.expiry_time_ms = entry->ttl_timer.expiry_time_ms;
+        }
+        items.push_back(std::move(item));
+    }
+
+    if (items.empty()) {
+        log("migrate: none of the keys exist");
+        return std::make_unique<StrResponse>("NOKEY");
+    }
+
+    log("migrate: moving %lu keys to %s:%s in the background", items.size(), command[1].data(), command[2].data());
+    deferred_job = new MigrateJob(command[1] + ":" + command[2], options, std::move(items));
+    return nullptr;
+}
+
+/**
+ * Checks if a command can change the kv store.
+ * 
+ * @param name  The name of the command.
+ * 
+ * @return  True if it can, false otherwise.
+ */
+bool is_write_command(const std::string &name) {
+    static const std::unordered_set<std::string> write_commands = {
+        "set", "del", "zadd", "zincrby", "zrem", "zremrangebyrank", "zremrangebyscore", "zremrangebylex", "zpopmin", 
+        "zpopmax", "expire", "pexpire", "expireat", "pexpireat", "persist", "zunionstore", "zinterstore", "zdiffstore", 
+        "restore", "restore-asking"
+    };
+    return write_commands.count(name) > 0;
+}
+
+std::vector<std::string> CommandExecutor::to_logged_command(const std::vector<std::string> &command) {
+    const std::string &name = command[0];
+    bool is_expire = name == "expire" || name == "pexpire" || name == "expireat" || name == "pexpireat";
+    bool is_restore = name == "restore" || name == "restore-asking";
+    if (!is_expire && !is_restore && name != "set") {
+        return command;
+    }
+
+    // log the expiry the command actually set rather than recompute it from the arguments
+    Entry *entry = lookup_entry(command[1]);
+    int64_t expiry_unix_ms = -1;
+    if (entry != NULL && entry->ttl_timer.is_expiry_set()) {
+        expiry_unix_ms = monotonic_to_unix_ms(entry->ttl_timer.expiry_time_ms);
+    }
+
+    if (is_expire) {
+        if (entry == NULL) {
+            return { "del", command[1] }; // the key had already expired, or did so right away
+        }
+        return { "pexpireat", command[1], std::to_string(expiry_unix_ms) };
+    }
+
+    if (is_restore) {
+        if (entry == NULL) {
+            return { "del", command[1] }; // the TTL had already passed
+        }
+
+        std::vector<std::string> logged = command;
+        logged[0] = "restore";
+        if (expiry_unix_ms != -1) {
+            logged[2] = std::to_string(expiry_unix_ms);
+            if (std::none_of(logged.begin() + 4, logged.end(), 
+                             [](const std::string &arg) { return to_lower(arg) == "absttl"; })) {
+                logged.push_back("ABSTTL");
             }
+        }
+        return logged;
+    }
 
-            return do_zadd(command[1], score, command[3]);
+    std::vector<std::string> logged(command.begin(), command.begin() + 3);
+    for (uint32_t i = 3; i < command.size(); i++) {
+        std::string option = to_lower(command[i]);
+        if (option != "ex" && option != "px") {
+            logged.push_back(command[i]);
+            continue;
+        }
+
+        i++;
+        if (expiry_unix_ms != -1) {
+            logged.push_back("pxat");
+            logged.push_back(std::to_string(expiry_unix_ms));
+        }
+    }
+    return logged;
+}
+
+std::unique_ptr<Response> CommandExecutor::execute(const std::vector<std::string> &command) {
+    if (!command.empty() && is_write_command(command[0]) && Replication::shared().rejects_writes()) {
+        log("%s: rejected on a replica", command[0].data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_READONLY, 
+                                             "You can't write against a read only replica.");
+    }
+
+    if (!command.empty() && is_write_command(command[0]) && MigrateJob::has_locked_keys()) {
+        for (const std::string &key : get_command_keys(command)) {
+            if (MigrateJob::is_locked(key)) {
+                log("%s: key '%s' is being migrated", command[0].data(), key.data());
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, 
+                                                     "TRYAGAIN key is being migrated");
+            }
+        }
+    }
+
+    std::unique_ptr<Response> response = dispatch(command);
+
+    // deferred commands are counted and logged once their job finishes
+    if (response != nullptr && !command.empty() && is_write_command(command[0]) && 
+        dynamic_cast<ErrResponse *>(response.get()) == NULL) {
+        Rdb::shared().add_changes(1);
+
+        // rewriting the command looks its key up again, so it's skipped when nothing would read the result
+        if (Aof::shared().is_enabled() || Replication::shared().has_backlog()) {
+            std::vector<std::string> logged = to_logged_command(command);
+            Aof::shared().feed(logged);
+            Replication::shared().feed(logged);
+        }
+    }
+    return response;
+}
+
+std::unique_ptr<Response> CommandExecutor::dispatch(const std::vector<std::string> &command) {
+    if (command.size() < 1) {
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "unknown command");
+    }
+
+    std::string name = command[0];
+    if ((name == "set" || name == "zadd" || name == "zincrby" || name == "zunionstore" || name == "zinterstore" || 
+         name == "zdiffstore" || name == "restore" || name == "restore-asking") && 
+        evictor->perform_evictions(*kv_store, *timers, *thread_pool) == Evictor::Result::FAIL) {
+        log("%s: used memory is over maxmemory", name.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_OOM, "command not allowed when used memory > 'maxmemory'");
+    }
+
+    if (name == "set" && command.size() >= 3) {
+        return execute_set(command);
+    }
+
+    if ((name == "zadd" && command.size() >= 4) || (name == "zincrby" && command.size() == 4)) {
+        return execute_zadd(command);
+    }
+
+    if ((name == "zrange" || name == "zrevrange" || name == "zrangebyscore" || name == "zrevrangebyscore" || 
+         name == "zrangebylex" || name == "zrevrangebylex") && command.size() >= 4) {
+        return execute_zrange(command);
+    }
+
+    if ((name == "zunionstore" || name == "zinterstore" || name == "zdiffstore") && command.size() >= 4) {
+        return execute_zstore(command);
+    }
+
+    if (name == "cluster" && command.size() >= 2) {
+        return execute_cluster(command);
+    }
+
+    if ((name == "restore" || name == "restore-asking") && command.size() >= 4) {
+        return execute_restore(command);
+    }
+
+    if (name == "migrate" && command.size() >= 5) {
+        return execute_migrate(command);
+    }
+
+    if (command.size() == 1) {
+        if (name == "keys") {
+            return do_keys();
+        } else if (name == "info") {
+            return do_info();
+        } else if (name == "save") {
+            return do_save();
+        } else if (name == "bgsave") {
+            return do_bgsave();
+        } else if (name == "lastsave") {
+            return do_lastsave();
+        } else if (name == "bgrewriteaof") {
+            return do_bgrewriteaof();
+        }
+    } else if (command.size() == 2) {
+        if (name == "get") {
+            return do_get(command[1]);
+        } else if (name == "del") {
+            return do_del(command[1]);
+        } else if (name == "ttl") {
+            return do_ttl(command[1]);
+        } else if (name == "persist") {
+            return do_persist(command[1]);
+        } else if (name == "pttl") {
+            return do_pttl(command[1]);
+        } else if (name == "zcard") {
+            return do_zcard(command[1]);
+        } else if (name == "dump") {
+            return do_dump(command[1]);
+        } else if (name == "zpopmin" || name == "zpopmax") {
+            return do_zpop(command[1], 1, name == "zpopmax");
+        }
+    } else if (command.size() == 3) {
+        if (name == "zscore") {
+            return do_zscore(command[1], command[2]);
+        } else if (name == "zrem") {
+            return do_zrem(command[1], command[2]);
+        } else if (name == "zrank") {
+            return do_zrank(command[1], command[2]); 
+        } else if (name == "zrevrank") {
+            return do_zrank(command[1], command[2], true);
+        } else if (name == "zpopmin" || name == "zpopmax") {
+            int64_t count;
+            if (!parse_int(command[2], &count) || count < 0) {
+                log("%s: invalid count argument", name.data());
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid count argument");
+            }
+
+            return do_zpop(command[1], count, name == "zpopmax");
+        } else if (name == "config" && command[1] == "get") {
+            return do_config_get(command[2]);
+        } else if (name == "replicaof") {
+            return do_replicaof(command[1], command[2]);
+        } else if (name == "expire") {
+            uint32_t seconds;
+            try {
+                seconds = std::stol(command[2]);
+            } catch (...) {
+                log("expire: invalid seconds argument");
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid seconds argument");
+            }
+
+            return do_expire(command[1], seconds);
+        } else if (name == "pexpire" || name == "expireat" || name == "pexpireat") {
+            int64_t time;
+            if (!parse_int(command[2], &time)) {
+                log("%s: invalid time argument", name.data());
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid time argument");
+            }
+
+            if (name == "pexpire") {
+                return do_pexpire(command[1], time);
+            } else if (name == "expireat") {
+                return do_expireat(command[1], time);
+            }
+            return do_pexpireat(command[1], time);
+        }
+    } else if (command.size() == 4) {
+        if (name == "config" && command[1] == "set") {
+            return do_config_set(command[2], command[3]);
+        } else if (name == "zcount") {
+            ScoreRange range;
+            if (!parse_score_bound(command[2], &range.min, &range.min_exclusive) || 
+                !parse_score_bound(command[3], &range.max, &range.max_exclusive)) {
+                log("zcount: invalid score range");
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "min or max is not a float");
+            }
+
+            return do_zcount(command[1], range);
+        } else if (name == "zremrangebyscore") {
+            ScoreRange range;
+            if (!parse_score_bound(command[2], &range.min, &range.min_exclusive) || 
+                !parse_score_bound(command[3], &range.max, &range.max_exclusive)) {
+                log("zremrangebyscore: invalid score range");
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "min or max is not a float");
+            }
+
+            return do_zremrangebyscore(command[1], range);
+        } else if (name == "zremrangebyrank") {
+            int64_t start, stop;
+            if (!parse_int(command[2], &start) || !parse_int(command[3], &stop)) {
+                log("zremrangebyrank: invalid rank argument");
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid rank argument");
+            }
+
+            return do_zremrangebyrank(command[1], start, stop);
+        } else if (name == "zlexcount" || name == "zremrangebylex") {
+            LexRange range;
+            if (!parse_lex_bound(command[2], &range.min) || !parse_lex_bound(command[3], &range.max)) {
+                log("%s: invalid name range", name.data());
+                return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                     "min or max not valid string range item");
+            }
+
+            if (name == "zlexcount") {
+                return do_zlexcount(command[1], range);
+            }
+            return do_zremrangebylex(command[1], range);
         }
     } else if (command.size() == 6) {
         if (name == "zquery") {
@@ -334,3 +2048,33 @@ std::unique_ptr<Response> CommandExecutor::execute(const std::vector<std::string
     log("request contains unknown command");
     return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "unknown command");
 }
+
+BackgroundJob *CommandExecutor::take_deferred_job() {
+    BackgroundJob *job = deferred_job;
+    deferred_job = NULL;
+    return job;
+}
+
+std::unique_ptr<Response> CommandExecutor::finish_job(BackgroundJob *job) {
+    std::unique_ptr<Response> response = job->finish(*kv_store, *timers, *thread_pool, *evictor);
+    Rdb::shared().add_changes(1);
+
+    // the job's result is logged rather than its command, which would read the sources as they are when replayed
+    for (const std::string &key : job->get_changed_keys()) {
+        Entry *entry = lookup_entry(key);
+        Aof::shared().feed_entry(key, entry);
+        Replication::shared().feed_entry(key, entry);
+    }
+    delete job;
+    return response;
+}
+
+std::unique_ptr<Response> CommandExecutor::execute_now(const std::vector<std::string> &command) {
+    std::unique_ptr<Response> response = execute(command);
+    if (response == nullptr) {
+        BackgroundJob *job = take_deferred_job();
+        job->run();
+        response = finish_job(job);
+    }
+    return response;
+}
@@ -1,13 +1,64 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
 
 #include "../entry/Entry.hpp"
+#include "../evictor/Evictor.hpp"
 #include "../hashmap/HMap.hpp"
-#include "../min-heap/MinHeap.hpp"
 #include "../response/Response.hpp"
+#include "../migrate/MigrateJob.hpp"
 #include "../request/Request.hpp"
+#include "../zstore/ZStoreJob.hpp"
+
+/* Options for the set command */
+struct SetOptions {
+    enum class Condition {
+        ALWAYS,
+        NX, // only set if the key does not exist
+        XX // only set if the key exists
+    };
+
+    Condition condition = Condition::ALWAYS;
+    std::optional<time_t> expiry_time_ms; // monotonic time the key expires at, if an expiry was given
+    bool keep_ttl = false; // keep the key's existing TTL instead of clearing it
+    bool get = false; // return the key's old value instead of "OK"
+};
+
+/* Options for the zadd command */
+struct ZAddOptions {
+    enum class Condition {
+        ALWAYS,
+        NX, // only add new pairs
+        XX // only update existing pairs
+    };
+
+    enum class Comparison {
+        ANY,
+        GT, // only update a pair if its new score is greater
+        LT // only update a pair if its new score is less
+    };
+
+    Condition condition = Condition::ALWAYS;
+    Comparison comparison = Comparison::ANY;
+    bool ch = false; // count updated pairs as well as new ones
+    bool incr = false; // increment the score of a single pair instead of setting it (zincrby)
+};
+
+/* Options for the zrange family of commands */
+struct ZRangeOptions {
+    bool reverse = false; // return pairs from high to low (zrevrange, zrevrangebyscore, zrevrangebylex)
+    bool with_scores = false; // return each pair's score after its name
+    uint64_t offset = 0; // pairs to skip, from LIMIT (by score or lex only)
+    int64_t count = -1; // most pairs to return, from LIMIT (by score or lex only), negative if no limit
+};
+
+/* Options for the restore command */
+struct RestoreOptions {
+    bool replace = false; // overwrite the key if it exists
+    bool append = false; // add the value to the key if it exists, for values sent as several payloads
+};
 
 /* Executes a Redis command */
 class CommandExecutor {
@@ -15,10 +66,15 @@ class CommandExecutor {
         HMap *kv_store;
         TimerManager *timers;
         ThreadPool *thread_pool;
+        Evictor *evictor;
+        BackgroundJob *deferred_job = NULL; // job the last command was handed off to, if any
         
         /**
          * Searches for the Entry with the given key in the kv store.
          * 
+         * If the Entry's TTL has passed but it hasn't been removed by the timer manager yet, it is treated as not 
+         * found (see expire_if_needed()). Otherwise, the Entry's access metadata for eviction is updated.
+         * 
          * @param key   The key of the entry to look for.
          * 
          * @return  Pointer to the Entry if found.
@@ -26,6 +82,30 @@ class CommandExecutor {
          */
         Entry *lookup_entry(const std::string &key);
 
+        /**
+         * Removes the Entry with the given key from the kv store. Expired entries are treated as not found (see 
+         * expire_if_needed()).
+         * 
+         * @param key   The key of the entry to remove.
+         * 
+         * @return  Pointer to the Entry if it was found and hadn't expired. The caller is responsible for deleting it.
+         *          NULL otherwise.
+         */
+        Entry *remove_entry(const std::string &key);
+
+        /**
+         * Handles an Entry whose TTL may have passed.
+         * 
+         * On a primary an expired Entry is deleted, and a del for it is fed to the AOF and replicas. A replica leaves 
+         * it in place for the primary's del, hiding it from clients only.
+         * 
+         * @param entry Pointer to the Entry, which must still be in the kv store.
+         * 
+         * @return  True if the Entry has expired and must be treated as not found.
+         *          False otherwise.
+         */
+        bool expire_if_needed(Entry *entry);
+
         /**
          * Gets the entry for the provided key in the kv store.
          * 
@@ -44,14 +124,34 @@ class CommandExecutor {
         /**
          * Sets the value of the provided key in the kv store. 
          * 
-         * If key already exists, updates its value (regardless of type) and clears its TTL (if set).
+         * If key already exists, updates its value (regardless of type) and clears its TTL (if set), unless the options 
+         * say to keep the TTL or set a new one. The value and TTL are set together, so there is no window where the new 
+         * value exists without its TTL.
+         * 
+         * @param key       The key to set.
+         * @param value     The value for the key.
+         * @param options   Options controlling when the key is set, its TTL, and what is returned.
+         * 
+         * @return  One of the following:
+         *          - StrResponse ("OK"): the key was set.
+         *          - NilResponse: the key was not set because of the NX or XX condition.
+         *          - StrResponse: with the GET option, the old value of the key.
+         *          - NilResponse: with the GET option, the key did not exist.
+         *          - ErrResponse: with the GET option, the value stored at the key is not a string.
+         */
+        std::unique_ptr<Response> do_set(const std::string &key, const std::string &value, const SetOptions &options = SetOptions());
+
+        /**
+         * Parses the options of a set command then executes it.
+         * 
+         * Options: [EX seconds | PX milliseconds | EXAT unix-time-seconds | PXAT unix-time-milliseconds | KEEPTTL] 
+         * [NX | XX] [GET]
          * 
-         * @param key   The key to set.
-         * @param value The value for the key.
+         * @param command   The set command, broken up into its individual strings.
          * 
-         * @return  StrResponse ("OK"): the key was set.
+         * @return  The Response from do_set(), or an ErrResponse if the options are invalid.
          */
-        std::unique_ptr<Response> do_set(const std::string &key, const std::string &value);
+        std::unique_ptr<Response> execute_set(const std::vector<std::string> &command);
 
         /**
          * Deletes the entry for the provided key in the kv store.
@@ -73,26 +173,41 @@ class CommandExecutor {
         std::unique_ptr<Response> do_keys();
 
         /**
-         * Adds a pair to the sorted set stored at the given key.
-         *
-         * If a pair with the given name already exists in the sorted set, its score is updated.
-         * If key does not exist, a new sorted set with the specified pair is created.
-         * If the key exists but does not hold a sorted set, an error is returned.
-         *
-         * @param key   The key of the sorted set.
-         * @param score The pair's score.
-         * @param name  The pair's name.
-         *
+         * Adds pairs to the sorted set stored at the given key, or updates the scores of pairs that already exist.
+         * 
+         * If key does not exist, a new sorted set is created (unless the XX condition is given). A new sorted set is 
+         * built from pairs given in sorted order in O(n). If the key exists but does not hold a sorted set, an error 
+         * is returned.
+         * 
+         * @param key       The key of the sorted set.
+         * @param pairs     The pairs. Names point into the command. Exactly one pair with the INCR option.
+         * @param options   Options controlling which pairs are added or updated and what is returned.
+         * 
          * @return  One of the following:
-         *          - IntResponse: the number of new or updated pairs.
-         *          - ErrResponse: the key does not hold a sorted set.
+         *          - IntResponse: the number of new pairs, or new and updated pairs with the CH option.
+         *          - DblResponse: with the INCR option, the new score of the pair.
+         *          - NilResponse: with the INCR option, the pair was not updated because of a condition.
+         *          - ErrResponse: the key does not hold a sorted set, or INCR made the score NaN.
+         */
+        std::unique_ptr<Response> do_zadd(const std::string &key, const std::vector<SPairView> &pairs, 
+                                          const ZAddOptions &options = ZAddOptions());
+
+        /**
+         * Parses the options and pairs of a zadd or zincrby command then executes it.
+         * 
+         * zadd options: [NX | XX] [GT | LT] [CH] [INCR], followed by one or more score and name arguments. 
+         * zincrby takes a single increment and name.
+         * 
+         * @param command   The zadd or zincrby command, broken up into its individual strings.
+         * 
+         * @return  The Response from do_zadd(), or an ErrResponse if the options or scores are invalid.
          */
-        std::unique_ptr<Response> do_zadd(const std::string &key, double score, const std::string &name);
+        std::unique_ptr<Response> execute_zadd(const std::vector<std::string> &command);
 
         /**
          * Gets the score of name in the sorted set stored at key.
          * 
-         * If the key does not exist, the key does not hold a sorted set, or the name is not in the sorted set, a nil
+         * If the key does not exist, the key does not hold a sorted set, or the name is not in the sorted set, a nil 
          * is returned.
          * 
          * @param key   The key of the sorted set.
@@ -136,21 +251,216 @@ class CommandExecutor {
         std::unique_ptr<Response> do_zquery(const std::string &key, double score, const std::string &name, uint64_t offset, uint64_t limit);
 
         /**
-         * Gets the rank (position in sorted order) of name in the sorted set stored at key. The rank is 0-based, so the
+         * Gets the rank (position in sorted order) of name in the sorted set stored at key. The rank is 0-based, so the 
          * lowest pair is rank 0.
          * 
-         * If the key does not exist, the key does not hold a sorted set, or the name is not in the sorted set, a nil
+         * If the key does not exist, the key does not hold a sorted set, or the name is not in the sorted set, a nil 
          * is returned.
          * 
-         * @param key   The key of the sorted set.
-         * @param name  The name of the pair to rank.
+         * @param key       The key of the sorted set.
+         * @param name      The name of the pair to rank.
+         * @param reverse   (Optional) Rank from high to low instead, so the highest pair is rank 0 (zrevrank).
          * 
          * @return  One of the following:
          *          - NilResponse: if the key does not exist, the key does not hold a sorted set, or the pair does not 
          *            exist in the sorted set.
          *          - IntResponse: the rank of the pair.
          */
-        std::unique_ptr<Response> do_zrank(const std::string &key, const std::string &name);
+        std::unique_ptr<Response> do_zrank(const std::string &key, const std::string &name, bool reverse = false);
+
+        /**
+         * Gets the pairs with ranks start through stop (inclusive) in the sorted set stored at key. Negative ranks 
+         * count back from the end, so -1 is the last pair.
+         * 
+         * If the key exists but does not hold a sorted set, an error is returned.
+         * 
+         * @param key       The key of the sorted set.
+         * @param start     The rank of the first pair.
+         * @param stop      The rank of the last pair.
+         * @param options   The options. With reverse, pairs are ranked from high to low.
+         * 
+         * @return  One of the following:
+         *          - ArrResponse: the names of the pairs, each followed by its score with the WITHSCORES option.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zrange(const std::string &key, int64_t start, int64_t stop, 
+                                            const ZRangeOptions &options = ZRangeOptions());
+
+        /**
+         * Gets the pairs with scores in the given range in the sorted set stored at key.
+         * 
+         * If the key exists but does not hold a sorted set, an error is returned.
+         * 
+         * @param key       The key of the sorted set.
+         * @param range     The range of scores.
+         * @param options   The options.
+         * 
+         * @return  One of the following:
+         *          - ArrResponse: the names of the pairs, each followed by its score with the WITHSCORES option.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zrangebyscore(const std::string &key, const ScoreRange &range, 
+                                                   const ZRangeOptions &options = ZRangeOptions());
+
+        /**
+         * Gets the names of the pairs with names in the given range in the sorted set stored at key. Meant for sorted 
+         * sets whose pairs all have the same score, see SortedSet::range_by_lex().
+         * 
+         * If the key exists but does not hold a sorted set, an error is returned.
+         * 
+         * @param key       The key of the sorted set.
+         * @param range     The range of names.
+         * @param options   The options. with_scores is ignored.
+         * 
+         * @return  One of the following:
+         *          - ArrResponse: the names of the pairs.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zrangebylex(const std::string &key, const LexRange &range, 
+                                                 const ZRangeOptions &options = ZRangeOptions());
+
+        /**
+         * Parses the arguments and options of a zrange, zrevrange, zrangebyscore, zrevrangebyscore, zrangebylex, or 
+         * zrevrangebylex command then executes it.
+         * 
+         * Syntax: zrange|zrevrange <key> <start> <stop> [WITHSCORES] 
+         *         zrangebyscore <key> <min> <max> [WITHSCORES] [LIMIT offset count]
+         *         zrevrangebyscore <key> <max> <min> [WITHSCORES] [LIMIT offset count]
+         *         zrangebylex <key> <min> <max> [LIMIT offset count]
+         *         zrevrangebylex <key> <max> <min> [LIMIT offset count]
+         * 
+         * @param command   The command, broken up into its individual strings.
+         * 
+         * @return  The Response from do_zrange(), do_zrangebyscore(), or do_zrangebylex(), or an ErrResponse if the 
+         *          arguments are invalid.
+         */
+        std::unique_ptr<Response> execute_zrange(const std::vector<std::string> &command);
+
+        /**
+         * Removes the pairs with ranks start through stop (inclusive) from the sorted set stored at key. Negative ranks 
+         * count back from the end, so -1 is the last pair.
+         * 
+         * Large removed ranges are freed asynchronously using the thread pool workers.
+         * 
+         * @param key   The key of the sorted set.
+         * @param start The rank of the first pair.
+         * @param stop  The rank of the last pair.
+         * 
+         * @return  One of the following:
+         *          - IntResponse: the number of pairs removed.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zremrangebyrank(const std::string &key, int64_t start, int64_t stop);
+
+        /**
+         * Removes the pairs with scores in the given range from the sorted set stored at key.
+         * 
+         * Large removed ranges are freed asynchronously using the thread pool workers.
+         * 
+         * @param key   The key of the sorted set.
+         * @param range The range of scores.
+         * 
+         * @return  One of the following:
+         *          - IntResponse: the number of pairs removed.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zremrangebyscore(const std::string &key, const ScoreRange &range);
+
+        /**
+         * Removes the pairs with names in the given range from the sorted set stored at key. See do_zrangebylex().
+         * 
+         * Large removed ranges are freed asynchronously using the thread pool workers.
+         * 
+         * @param key   The key of the sorted set.
+         * @param range The range of names.
+         * 
+         * @return  One of the following:
+         *          - IntResponse: the number of pairs removed.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zremrangebylex(const std::string &key, const LexRange &range);
+
+        /**
+         * Removes and returns the count lowest (zpopmin) or highest (zpopmax) pairs in the sorted set stored at key.
+         * 
+         * @param key   The key of the sorted set.
+         * @param count The number of pairs to pop.
+         * @param max   Whether to pop the highest pairs instead of the lowest.
+         * 
+         * @return  One of the following:
+         *          - ArrResponse: the name and score of each popped pair, in the order they were popped.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zpop(const std::string &key, uint64_t count, bool max);
+
+        /**
+         * Counts the pairs with scores in the given range in the sorted set stored at key.
+         * 
+         * @param key   The key of the sorted set.
+         * @param range The range of scores.
+         * 
+         * @return  One of the following:
+         *          - IntResponse: the number of pairs, 0 if the key does not exist.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zcount(const std::string &key, const ScoreRange &range);
+
+        /**
+         * Counts the pairs with names in the given range in the sorted set stored at key. See do_zrangebylex().
+         * 
+         * @param key   The key of the sorted set.
+         * @param range The range of names.
+         * 
+         * @return  One of the following:
+         *          - IntResponse: the number of pairs, 0 if the key does not exist.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zlexcount(const std::string &key, const LexRange &range);
+
+        /**
+         * Gets the number of pairs in the sorted set stored at key.
+         * 
+         * @param key   The key of the sorted set.
+         * 
+         * @return  One of the following:
+         *          - IntResponse: the number of pairs, 0 if the key does not exist.
+         *          - ErrResponse: the key does not hold a sorted set.
+         */
+        std::unique_ptr<Response> do_zcard(const std::string &key);
+
+        /**
+         * Computes the union, intersection, or difference of the sorted sets stored at the given keys and stores it at 
+         * dest, replacing whatever dest held.
+         * 
+         * The sources are snapshotted up front. If they hold fewer than LARGE_ZSET_SIZE pairs in total, the result is 
+         * computed and stored right away. Otherwise the command is handed off to a ZStoreJob that merges the snapshots 
+         * on a thread pool worker, so the event loop isn't blocked by it. See take_deferred_job().
+         * 
+         * @param op        The set operation.
+         * @param dest      The key to store the result at.
+         * @param keys      The keys of the source sorted sets. Missing keys are treated as empty sets.
+         * @param weights   The weight each source's scores are multiplied by, one per key.
+         * @param aggregate How the scores of a name found in several sources are combined.
+         * 
+         * @return  One of the following:
+         *          - IntResponse: the number of pairs in the result.
+         *          - ErrResponse: a source key does not hold a sorted set.
+         *          - NULL: the command was deferred to a ZStoreJob.
+         */
+        std::unique_ptr<Response> do_zstore(ZStoreOp op, const std::string &dest, const std::vector<std::string> &keys, 
+                                            const std::vector<double> &weights, ZAggregate aggregate);
+
+        /**
+         * Parses the arguments of a zunionstore, zinterstore, or zdiffstore command then executes it.
+         * 
+         * Arguments: <dest> <numkeys> <key> [<key> ...], then for zunionstore and zinterstore [WEIGHTS <weight> ...] 
+         * [AGGREGATE SUM | MIN | MAX]
+         * 
+         * @param command   The command, broken up into its individual strings.
+         * 
+         * @return  The Response from do_zstore(), or an ErrResponse if the arguments are invalid.
+         */
+        std::unique_ptr<Response> execute_zstore(const std::vector<std::string> &command);
 
         /**
          * Sets a timeout on the given key. After the timeout has expired, the key will be deleted.
@@ -164,9 +474,80 @@ class CommandExecutor {
          * @return  One of the following:
          *          - IntReponse: 1 if the timeout was set.
          *          - IntResponse: 0 if timeout was not set.
+         *          - ErrResponse: if the time is out of range.
          */
         std::unique_ptr<Response> do_expire(const std::string &key, time_t seconds);
 
+        /**
+         * Sets a timeout on the given key in milliseconds. Otherwise the same as expire.
+         * 
+         * @param key   The key to set the timeout on.
+         * @param ms    The timeout in milliseconds.
+         * 
+         * @return  One of the following:
+         *          - IntReponse: 1 if the timeout was set.
+         *          - IntResponse: 0 if timeout was not set.
+         *          - ErrResponse: if the time is out of range.
+         */
+        std::unique_ptr<Response> do_pexpire(const std::string &key, time_t ms);
+
+        /**
+         * Sets the given key to expire at an absolute unix time in seconds. A time that has already passed deletes the 
+         * key. Otherwise the same as expire.
+         * 
+         * @param key       The key to set the timeout on.
+         * @param unix_time The unix time in seconds the key expires at.
+         * 
+         * @return  One of the following:
+         *          - IntReponse: 1 if the timeout was set.
+         *          - IntResponse: 0 if timeout was not set.
+         *          - ErrResponse: if the time is out of range.
+         */
+        std::unique_ptr<Response> do_expireat(const std::string &key, time_t unix_time);
+
+        /**
+         * Sets the given key to expire at an absolute unix time in milliseconds. Otherwise the same as expireat.
+         * 
+         * @param key           The key to set the timeout on.
+         * @param unix_time_ms  The unix time in milliseconds the key expires at.
+         * 
+         * @return  One of the following:
+         *          - IntReponse: 1 if the timeout was set.
+         *          - IntResponse: 0 if timeout was not set.
+         *          - ErrResponse: if the time is out of range.
+         */
+        std::unique_ptr<Response> do_pexpireat(const std::string &key, time_t unix_time_ms);
+
+        /**
+         * Sets the expiry of the given key. Shared by the expire family of commands. A key whose expiry has already 
+         * passed is deleted right away.
+         * 
+         * @param cmd       Name of the command, for logging.
+         * @param key       The key to set the timeout on.
+         * @param time      The time argument of the command.
+         * @param unit_ms   The length of one unit of the time in ms: 1000 for seconds, 1 for ms.
+         * @param absolute  Whether the time is a unix time rather than relative to now.
+         * 
+         * @return  One of the following:
+         *          - IntReponse: 1 if the timeout was set or the key was deleted.
+         *          - IntResponse: 0 if timeout was not set.
+         *          - ErrResponse: if the time is out of range.
+         */
+        std::unique_ptr<Response> expire_entry_at(const char *cmd, const std::string &key, int64_t time, 
+                                                  int64_t unit_ms, bool absolute);
+
+        /**
+         * Gets the remaining time-to-live of the given key in milliseconds.
+         * 
+         * @param key   The key to get the TTL for.
+         * 
+         * @return  One of the following:
+         *          - IntResponse: TTL in milliseconds.
+         *          - IntResponse: -1 if the key exists but has no associated expiration.
+         *          - IntResponse: -2 if the key does not exist.
+         */
+        std::unique_ptr<Response> do_pttl(const std::string &key);
+
         /**
          * Gets the remaining time-to-live of the given key.
          * 
@@ -189,39 +570,304 @@ class CommandExecutor {
          *          - IntResponse: 1 if the timeout has been removed.
          */
         std::unique_ptr<Response> do_persist(const std::string &key);
+
+        /**
+         * Gets the value of a configuration parameter.
+         * 
+         * Supported parameters: maxmemory, maxmemory-policy, zset-max-listpack-entries, zset-max-listpack-value, save, 
+         * dbfilename, appendonly, appendfsync, appendfilename, aof-use-rdb-preamble, auto-aof-rewrite-percentage, 
+         * auto-aof-rewrite-min-size, 
+         * repl-backlog-size.
+         * 
+         * @param param The name of the parameter.
+         * 
+         * @return  One of the following:
+         *          - ArrResponse: the name of the parameter followed by its value.
+         *          - ErrResponse: the parameter is not supported.
+         */
+        std::unique_ptr<Response> do_config_get(const std::string &param);
+
+        /**
+         * Sets the value of a configuration parameter.
+         * 
+         * Supported parameters: maxmemory, maxmemory-policy, zset-max-listpack-entries, zset-max-listpack-value, save, 
+         * dbfilename, appendonly, appendfsync, appendfilename, aof-use-rdb-preamble, auto-aof-rewrite-percentage, 
+         * auto-aof-rewrite-min-size, 
+         * repl-backlog-size.
+         * 
+         * @param param The name of the parameter.
+         * @param value The new value of the parameter.
+         * 
+         * @return  One of the following:
+         *          - StrResponse ("OK"): the parameter was set.
+         *          - ErrResponse: the parameter is not supported or the value is invalid.
+         */
+        std::unique_ptr<Response> do_config_set(const std::string &param, const std::string &value);
+
+        /**
+         * Gets information and stats about the server.
+         * 
+         * @return  ArrResponse: a list of "field:value" strings.
+         */
+        std::unique_ptr<Response> do_info();
+
+        /**
+         * Saves a snapshot of the kv store to the snapshot file, blocking until it is written.
+         * 
+         * @return  One of the following:
+         *          - StrResponse ("OK"): the snapshot was saved.
+         *          - ErrResponse: a bgsave is in progress or the snapshot couldn't be written.
+         */
+        std::unique_ptr<Response> do_save();
+
+        /**
+         * Saves a snapshot of the kv store to the snapshot file from a forked child process, so the event loop keeps 
+         * serving commands while it is written.
+         * 
+         * @return  One of the following:
+         *          - StrResponse ("Background saving started"): the child was started.
+         *          - ErrResponse: a bgsave is already in progress or the child couldn't be started.
+         */
+        std::unique_ptr<Response> do_bgsave();
+
+        /**
+         * Gets the time of the last successful save.
+         * 
+         * @return  IntResponse: the unix time in seconds of the last successful save, 0 if there hasn't been one.
+         */
+        std::unique_ptr<Response> do_lastsave();
+
+        /**
+         * Rewrites the append-only file from a forked child process as a snapshot of the kv store, or as the smallest set 
+         * of commands that recreates it if aof-use-rdb-preamble is off, so the event loop keeps serving commands while 
+         * it is written.
+         * 
+         * @return  One of the following:
+         *          - StrResponse ("Background append only file rewriting started"): the child was started.
+         *          - ErrResponse: the append-only file is off, a rewrite is already in progress, or the child couldn't 
+         *            be started.
+         */
+        std::unique_ptr<Response> do_bgrewriteaof();
+
+        /**
+         * Makes the server a replica of another one, or a primary again with "no one". A replica replaces its kv store 
+         * with the primary's once they sync, then applies the primary's writes and rejects writes from clients.
+         * 
+         * @param host  The primary's host, or "no".
+         * @param port  The primary's port, or "one".
+         * 
+         * @return  One of the following:
+         *          - StrResponse ("OK"): the server is now a replica of the primary, or a primary.
+         *          - ErrResponse: the port is invalid.
+         */
+        std::unique_ptr<Response> do_replicaof(const std::string &host, const std::string &port);
+
+        /**
+         * Parses the arguments of a cluster command then executes it. Only available in cluster mode.
+         * 
+         * Subcommands:
+         * - keyslot <key>: the hash slot of a key.
+         * - addslots <slot> [<slot> ...]: assigns slots to this node.
+         * - addslotsrange <start> <end> [<start> <end> ...]: assigns ranges of slots to this node.
+         * - setslot <slot> node <host:port>: assigns a slot to a node, ending any migration or import of it.
+         * - setslot <slot> migrating <host:port>: starts migrating a slot this node owns to another node.
+         * - setslot <slot> importing <host:port>: starts importing a slot from the node that owns it.
+         * - setslot <slot> stable: ends any migration or import of a slot.
+         * - slots: the slot map, as [start, end, host:port] arrays.
+         * - countkeysinslot <slot>: the number of keys this node holds in a slot.
+         * - getkeysinslot <slot> <count>: up to count keys this node holds in a slot.
+         * - myself: the host:port of this node.
+         * 
+         * @param command   The command, broken up into its individual strings.
+         * 
+         * @return  The Response for the subcommand, or an ErrResponse if cluster mode is off or the arguments are 
+         *          invalid.
+         */
+        std::unique_ptr<Response> execute_cluster(const std::vector<std::string> &command);
+
+        /**
+         * Serializes the value stored at key, along with its remaining TTL, into a payload restore can recreate it from. 
+         * See DumpPayload.hpp.
+         * 
+         * @param key   The key to dump.
+         * 
+         * @return  One of the following:
+         *          - StrResponse: the payload.
+         *          - NilResponse: the key does not exist.
+         *          - ErrResponse: the payload wouldn't fit in a restore request. migrate can move the key.
+         */
+        std::unique_ptr<Response> do_dump(const std::string &key);
+
+        /**
+         * Stores a value deserialized from a payload at the given key.
+         * 
+         * If the key already exists, it is replaced with the REPLACE option, or the value is added to it with the APPEND 
+         * option (bytes to the end of a string, pairs to a sorted set), keeping its TTL unless a new one is given. 
+         * Otherwise an error is returned. If the TTL has already passed, the key is deleted instead.
+         * 
+         * @param key               The key to restore.
+         * @param restored          Pointer to the deserialized Entry. Owned by the function.
+         * @param expiry_time_ms    The monotonic time in ms the key expires at, -1 if no TTL was given.
+         * @param options           The options.
+         * 
+         * @return  One of the following:
+         *          - StrResponse ("OK"): the key was restored.
+         *          - ErrResponse: the key exists and neither option was given, or it holds another type than the 
+         *            payload with the APPEND option.
+         */
+        std::unique_ptr<Response> do_restore(const std::string &key, Entry *restored, time_t expiry_time_ms, 
+                                             const RestoreOptions &options);
+
+        /**
+         * Parses the arguments and options of a restore or restore-asking command then executes it.
+         * 
+         * Syntax: restore <key> <ttl> <payload> [REPLACE] [ABSTTL] [APPEND]
+         * 
+         * The ttl is in ms, or a unix time in ms with ABSTTL. 0 keeps the TTL stored in the payload, if any.
+         * 
+         * @param command   The command, broken up into its individual strings.
+         * 
+         * @return  The Response from do_restore(), or an ErrResponse if the arguments or payload are invalid.
+         */
+        std::unique_ptr<Response> execute_restore(const std::vector<std::string> &command);
+
+        /**
+         * Parses the arguments and options of a migrate command then hands it off to a MigrateJob, which sends the keys 
+         * to the target with restore-asking and deletes them here once they've been restored. See 
+         * take_deferred_job().
+         * 
+         * Syntax: migrate <host> <port> <key | ""> <timeout> [COPY] [REPLACE] [KEYS <key> [<key> ...]]
+         * 
+         * The timeout is in ms, 0 to wait forever. With COPY, the keys are kept here. With REPLACE, keys that exist on 
+         * the target are overwritten. The keys are only locked against writes until the job finishes when they're 
+         * moved.
+         * 
+         * @param command   The command, broken up into its individual strings.
+         * 
+         * @return  One of the following:
+         *          - NULL: the command was deferred to a MigrateJob.
+         *          - StrResponse ("NOKEY"): none of the keys exist.
+         *          - ErrResponse: the arguments are invalid, a key is already being migrated, or the keys would be 
+         *            deleted on a replica.
+         */
+        std::unique_ptr<Response> execute_migrate(const std::vector<std::string> &command);
+
+        /**
+         * Rewrites a write command so that replaying it from the append-only file later gives the same result: relative 
+         * expiries (including those stored in restore payloads) are replaced by the absolute expiry the command set.
+         * 
+         * @param command   The command, which must have succeeded.
+         * 
+         * @return  The command to log.
+         */
+        std::vector<std::string> to_logged_command(const std::vector<std::string> &command);
+
+        /**
+         * Executes the given command, without recording it as a change. See execute().
+         */
+        std::unique_ptr<Response> dispatch(const std::vector<std::string> &command);
     public:
-        /* Initializes a CommandExecutor, storing references to the kv store, timer manager, and thread pool */
-        CommandExecutor(HMap *kv_store, TimerManager *timers, ThreadPool *thread_pool) : kv_store(kv_store), timers(timers), thread_pool(thread_pool) {};
+        /* Initializes a CommandExecutor, storing references to the kv store, timer manager, thread pool, and evictor */
+        CommandExecutor(HMap *kv_store, TimerManager *timers, ThreadPool *thread_pool, Evictor *evictor) : kv_store(kv_store), timers(timers), thread_pool(thread_pool), evictor(evictor) {};
 
         /**
          * Executes the given command.
          * 
-         * The following commands are supported:
-         * 1. get <key>
-         * 2. set <key> <value>
-         * 3. del <key>
-         * 4. keys
-         * 5. zadd <key> <score> <name>
-         * 6. zscore <key> <name>
-         * 7. zrem <key> <name>
-         * 8. zquery <key> <score> <name> <offset> <limit>
-         * 9. zrank <key> <name>
-         * 10. expire <key> <seconds>
-         * 11. ttl <key>
-         * 12. persist <key>
+         * The following commands are supported: 
+         * 1. get <key> 
+         * 2. set <key> <value> [EX seconds | PX milliseconds | EXAT unix-time-seconds | PXAT unix-time-milliseconds | 
+         *    KEEPTTL] [NX | XX] [GET]
+         * 3. del <key> 
+         * 4. keys 
+         * 5. zadd <key> [NX | XX] [GT | LT] [CH] [INCR] <score> <name> [<score> <name> ...] 
+         * 6. zscore <key> <name> 
+         * 7. zrem <key> <name> 
+         * 8. zquery <key> <score> <name> <offset> <limit> 
+         * 9. zrank <key> <name> 
+         * 10. expire <key> <seconds> 
+         * 11. ttl <key> 
+         * 12. persist <key> 
+         * 13. info 
+         * 14. pexpire <key> <milliseconds> 
+         * 15. expireat <key> <unix-time-seconds> 
+         * 16. pexpireat <key> <unix-time-milliseconds> 
+         * 17. pttl <key> 
+         * 18. config get <parameter> 
+         * 19. config set <parameter> <value> 
+         * 20. zrevrank <key> <name> 
+         * 21. zrange / zrevrange <key> <start> <stop> [WITHSCORES] 
+         * 22. zrangebyscore / zrevrangebyscore <key> <min> <max> [WITHSCORES] [LIMIT <offset> <count>] 
+         * 23. zcount <key> <min> <max> 
+         * 24. zcard <key> 
+         * 25. zremrangebyrank <key> <start> <stop> 
+         * 26. zremrangebyscore <key> <min> <max> 
+         * 27. zpopmin / zpopmax <key> [count] 
+         * 28. zincrby <key> <increment> <name> 
+         * 29. zunionstore / zinterstore <dest> <numkeys> <key> [<key> ...] [WEIGHTS <weight> ...] 
+         *     [AGGREGATE SUM | MIN | MAX]
+         * 30. zdiffstore <dest> <numkeys> <key> [<key> ...] 
+         * 31. zrangebylex / zrevrangebylex <key> <min> <max> [LIMIT <offset> <count>] 
+         * 32. zlexcount <key> <min> <max> 
+         * 33. zremrangebylex <key> <min> <max> 
+         * 34. save 
+         * 35. bgsave 
+         * 36. lastsave 
+         * 37. bgrewriteaof 
+         * 38. replicaof <host> <port> / replicaof no one 
+         * 39. cluster <subcommand> [<arg> ...], see execute_cluster() 
+         * 40. dump <key> 
+         * 41. restore / restore-asking <key> <ttl> <payload> [REPLACE] [ABSTTL] [APPEND] 
+         * 42. migrate <host> <port> <key | ""> <timeout> [COPY] [REPLACE] [KEYS <key> [<key> ...]]
+         * 
+         * When used memory is over maxmemory, entries are evicted before commands that can grow used memory (set, 
+         * zadd, zincrby, restore, and the zstore commands). If nothing can be evicted, those commands are rejected.
+         * 
+         * Each write command that doesn't fail is counted as a change towards the save points of Rdb, and logged to the 
+         * append-only file if it is on and sent to the replicas. On a replica, write commands from clients are 
+         * rejected. Write commands to keys being moved by migrate are rejected until the move finishes.
          * 
          * @param command   The command to execute, broken up into its individual strings.
          * 
          * @return  Pointer to the Response for executing the command.
+         *          NULL if the command was handed off to a BackgroundJob, see take_deferred_job().
          */
         std::unique_ptr<Response> execute(const std::vector<std::string> &command);
 
+        /**
+         * Takes the BackgroundJob the last command was handed off to. The caller is responsible for running it (e.g. 
+         * with BackgroundJobs) and passing it to finish_job() once it has run.
+         * 
+         * @return  Pointer to the job.
+         *          NULL if the last command wasn't handed off.
+         */
+        BackgroundJob *take_deferred_job();
+
+        /**
+         * Finishes a BackgroundJob that has run, applying its result to the kv store, then deletes it.
+         * 
+         * @param job   Pointer to the job.
+         * 
+         * @return  Pointer to the Response for the command that was handed off to the job.
+         */
+        std::unique_ptr<Response> finish_job(BackgroundJob *job);
+
+        /**
+         * Executes a command, running it in place if it would be handed off to a BackgroundJob. For callers that must 
+         * apply commands one after another, e.g. when replaying the append-only file or the stream from the primary.
+         * 
+         * @param command   The command to execute, broken up into its individual strings.
+         * 
+         * @return  Pointer to the Response for executing the command.
+         */
+        std::unique_ptr<Response> execute_now(const std::vector<std::string> &command);
+
     #ifdef TEST_MODE
     public:      
         ~CommandExecutor() {
             delete kv_store;
             delete timers;
             delete thread_pool;
+            delete evictor;
         }
     #endif
 };
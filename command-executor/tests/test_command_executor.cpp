@@ -1,8 +1,14 @@
 #define TEST_MODE
 
 #include <assert.h>
+#include <cmath>
+#include <unistd.h>
 
 #include "../CommandExecutor.hpp"
+#include "../../aof/Aof.hpp"
+#include "../../rdb/Rdb.hpp"
+#include "../../rdb/components/DumpPayload.hpp"
+#include "../../replication/Replication.hpp"
 #include "../../response/types/ArrResponse.hpp"
 #include "../../response/types/DblResponse.hpp"
 #include "../../response/types/ErrResponse.hpp"
@@ -10,6 +16,7 @@
 #include "../../response/types/NilResponse.hpp"
 #include "../../response/types/StrResponse.hpp"
 #include "../../utils/intrusive_data_structure_utils.hpp"
+#include "../../utils/time_utils.hpp"
 
 /**
  * Creates a CommandExecutor.
@@ -18,7 +25,8 @@ CommandExecutor *create_executor() {
     HMap *kv_store = new HMap();
     TimerManager *timers = new TimerManager();
     ThreadPool *thread_pool = new ThreadPool(4);
-    return new CommandExecutor(kv_store, timers, thread_pool);
+    Evictor *evictor = new Evictor();
+    return new CommandExecutor(kv_store, timers, thread_pool, evictor);
 }
 
 /* Asserts if two Responses are the same. */
@@ -134,6 +142,201 @@ void test_set_existing_non_string_entry() {
     delete executor;
 }
 
+void test_set_with_ex() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"set", "name", "tyler", "EX", "100"});
+    std::unique_ptr<Response> expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"ttl", "name"});
+    expected = std::make_unique<IntResponse>(100);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_set_with_px() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler", "px", "1500"});
+
+    std::unique_ptr<Response> actual = executor->execute({"pttl", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1500);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_set_with_exat() {
+    CommandExecutor *executor = create_executor();
+
+    time_t unix_time = time(NULL) + 100;
+    executor->execute({"set", "name", "tyler", "exat", std::to_string(unix_time)});
+
+    std::unique_ptr<Response> actual = executor->execute({"ttl", "name"});
+    IntResponse *ttl = (IntResponse *) actual.get();
+    assert(ttl->get_int() >= 98 && ttl->get_int() <= 100);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_set_with_pxat_in_past() {
+    HMap *kv_store = new HMap();
+    TimerManager *timers = new TimerManager();
+    CommandExecutor *executor = new CommandExecutor(kv_store, timers, new ThreadPool(4), new Evictor());
+
+    executor->execute({"set", "name", "tyler", "pxat", "1000"});
+    assert(kv_store->length() == 0);
+
+    // also deletes an existing key, without a read in between
+    executor->execute({"set", "name", "tyler", "ex", "10"});
+    executor->execute({"set", "name", "tyler", "pxat", "1000"});
+    assert(kv_store->length() == 0);
+    assert(timers->get_ttl_timers()->is_empty());
+
+    std::unique_ptr<Response> actual = executor->execute({"get", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_set_with_invalid_expire_time() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"set", "name", "tyler", "ex", "ten"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid expire time");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"set", "name", "tyler", "ex", "0"});
+    assert_same(actual, expected);
+
+    // overflows an int64 once converted to ms
+    actual = executor->execute({"set", "name", "tyler", "ex", "9223372036854775807"});
+    assert_same(actual, expected);
+
+    actual = executor->execute({"set", "name", "tyler", "px", "9223372036854775807"});
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_set_with_conflicting_options() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"set", "name", "tyler", "ex", "10", "px", "100"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"set", "name", "tyler", "nx", "xx"});
+    assert_same(actual, expected);
+
+    actual = executor->execute({"set", "name", "tyler", "keepttl", "ex", "10"});
+    assert_same(actual, expected);
+
+    actual = executor->execute({"set", "name", "tyler", "ex"});
+    assert_same(actual, expected);
+
+    actual = executor->execute({"set", "name", "tyler", "bogus"});
+    assert_same(actual, expected);
+
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_set_nx() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"set", "name", "tyler", "nx"});
+    std::unique_ptr<Response> expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"set", "name", "won", "nx"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<StrResponse>("tyler");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_set_xx() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"set", "name", "tyler", "xx"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    executor->execute({"set", "name", "tyler"});
+
+    actual = executor->execute({"set", "name", "won", "xx"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<StrResponse>("won");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_set_keepttl() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler", "ex", "100"});
+    executor->execute({"set", "name", "won", "keepttl"});
+
+    std::unique_ptr<Response> actual = executor->execute({"ttl", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(100);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_set_get() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"set", "name", "tyler", "get"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    actual = executor->execute({"set", "name", "won", "get"});
+    expected = std::make_unique<StrResponse>("tyler");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"set", "name", "again", "nx", "get"});
+    expected = std::make_unique<StrResponse>("won");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_set_get_non_string_entry() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "10", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"set", "myset", "won", "get"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a string");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
 void test_del_non_existent_key() {
     CommandExecutor *executor = create_executor();
 
@@ -304,8 +507,9 @@ void test_zadd_existing_pair() {
 
     executor->execute({"zadd", "myset", "10", "tyler"});
 
+    // only new pairs are counted
     std::unique_ptr<Response> actual = executor->execute({"zadd", "myset", "20", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
     assert_same(actual, expected);
 
     actual = executor->execute({"zscore", "myset", "tyler"});
@@ -316,513 +520,2077 @@ void test_zadd_existing_pair() {
     delete executor;
 }
 
-void test_zscore_non_existent_key() {
+void test_zadd_multiple_pairs() {
     CommandExecutor *executor = create_executor();
 
-    std::unique_ptr<Response> actual = executor->execute({"zscore", "myset", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    executor->execute({"zadd", "myset", "10", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zadd", "myset", "20", "won", "30", "tyler", "5", "eve"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrange", "myset", "0", "-1"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("eve"), new StrResponse("won"), new StrResponse("tyler") });
     assert_same(actual, expected);
 
+    executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zscore_not_a_sorted_set() {
+void test_zadd_large_sorted_input() {
     CommandExecutor *executor = create_executor();
 
-    executor->execute({"set", "myset", "tyler"});
+    // a new set is built straight from sorted pairs, then a repeated name and unsorted pairs are inserted
+    std::vector<std::string> command = { "zadd", "myset" };
+    for (uint32_t i = 0; i < 5000; i++) {
+        command.push_back(std::to_string(i));
+        command.push_back("name" + std::to_string(i));
+    }
+    command.push_back("-1");
+    command.push_back("name4999");
+    command.push_back("-2");
+    command.push_back("extra");
 
-    std::unique_ptr<Response> actual = executor->execute({"zscore", "myset", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    std::unique_ptr<Response> actual = executor->execute(command);
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(5001);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrange", "myset", "0", "2"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("extra"), new StrResponse("name4999"), new StrResponse("name0") });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrank", "myset", "name4998"});
+    expected = std::make_unique<IntResponse>(5000);
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zscore_non_existent_pair() {
+void test_zadd_nx_and_xx() {
     CommandExecutor *executor = create_executor();
 
+    std::unique_ptr<Response> actual = executor->execute({"zadd", "myset", "xx", "10", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"keys"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    assert_same(actual, expected);
+
     executor->execute({"zadd", "myset", "10", "tyler"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zscore", "myset", "won"});
-    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    // NX only adds new pairs
+    actual = executor->execute({"zadd", "myset", "NX", "20", "tyler", "20", "won"});
+    expected = std::make_unique<IntResponse>(1);
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
-    delete executor;
-}
+    actual = executor->execute({"zscore", "myset", "tyler"});
+    expected = std::make_unique<StrResponse>(std::to_string(10.0));
+    assert_same(actual, expected);
 
-void test_zscore_existing_pair() {
-    CommandExecutor *executor = create_executor();
+    // XX only updates existing pairs
+    actual = executor->execute({"zadd", "myset", "xx", "ch", "30", "tyler", "30", "eve"});
+    expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
 
-    executor->execute({"zadd", "myset", "10", "tyler"});
+    actual = executor->execute({"zscore", "myset", "tyler"});
+    expected = std::make_unique<StrResponse>(std::to_string(30.0));
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zscore", "myset", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<StrResponse>(std::to_string(10.0));
+    actual = executor->execute({"zscore", "myset", "eve"});
+    expected = std::make_unique<NilResponse>();
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zrem_non_existent_key() {
+void test_zadd_gt_and_lt() {
     CommandExecutor *executor = create_executor();
 
-    std::unique_ptr<Response> actual = executor->execute({"zrem", "myset", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    executor->execute({"zadd", "myset", "10", "tyler", "10", "won"});
+
+    // GT and LT still add new pairs
+    std::unique_ptr<Response> actual = executor->execute({"zadd", "myset", "gt", "ch", "5", "tyler", "15", "won", "1", "eve"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
     assert_same(actual, expected);
 
-    delete executor;
-}
+    actual = executor->execute({"zrange", "myset", "0", "-1", "withscores"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("eve"), new DblResponse(1), new StrResponse("tyler"), new DblResponse(10), new StrResponse("won"), new DblResponse(15) });
+    assert_same(actual, expected);
 
-void test_zrem_not_a_sorted_set() {
-    CommandExecutor *executor = create_executor();
+    actual = executor->execute({"zadd", "myset", "lt", "ch", "5", "tyler", "20", "won"});
+    expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
 
-    executor->execute({"set", "myset", "tyler"});
+    actual = executor->execute({"zscore", "myset", "tyler"});
+    expected = std::make_unique<StrResponse>(std::to_string(5.0));
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zrem", "myset", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    actual = executor->execute({"zscore", "myset", "won"});
+    expected = std::make_unique<StrResponse>(std::to_string(15.0));
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zrem_non_existent_pair() {
+void test_zadd_ch() {
     CommandExecutor *executor = create_executor();
 
     executor->execute({"zadd", "myset", "10", "tyler"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zrem", "myset", "won"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    // a pair whose score doesn't change isn't counted
+    std::unique_ptr<Response> actual = executor->execute({"zadd", "myset", "CH", "20", "tyler", "10", "won", "10", "won"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zrem_existing_pair() {
+void test_zadd_incr() {
     CommandExecutor *executor = create_executor();
 
-    executor->execute({"zadd", "myset", "10", "tyler"});
+    std::unique_ptr<Response> actual = executor->execute({"zadd", "myset", "incr", "10", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<DblResponse>(10);
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zrem", "myset", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    actual = executor->execute({"zadd", "myset", "incr", "2.5", "tyler"});
+    expected = std::make_unique<DblResponse>(12.5);
     assert_same(actual, expected);
 
-    actual = executor->execute({"zscore", "myset", "tyler"});
+    actual = executor->execute({"zadd", "myset", "incr", "nx", "1", "tyler"});
     expected = std::make_unique<NilResponse>();
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
-    delete executor;
-}
+    actual = executor->execute({"zadd", "myset", "incr", "xx", "1", "won"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
 
-void test_zquery_invalid_score() {
-    CommandExecutor *executor = create_executor();
+    actual = executor->execute({"zadd", "myset", "incr", "gt", "-1", "tyler"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "ten", "tyler", "0", "0"});
-    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid score argument");
+    actual = executor->execute({"zscore", "myset", "tyler"});
+    expected = std::make_unique<StrResponse>(std::to_string(12.5));
     assert_same(actual, expected);
 
+    executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_invalid_offset() {
+void test_zadd_incr_nan() {
     CommandExecutor *executor = create_executor();
 
-    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "inf", "tyler"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "zero", "0"});
-    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid offset argument");
+    std::unique_ptr<Response> actual = executor->execute({"zincrby", "myset", "-inf", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "resulting score is not a number (NaN)");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zscore", "myset", "tyler"});
+    expected = std::make_unique<StrResponse>(std::to_string(INFINITY));
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_invalid_limit() {
+void test_zadd_invalid_options() {
     CommandExecutor *executor = create_executor();
-    
-    executor->execute({"zadd", "myset", "10", "tyler"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "zero"});
-    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid limit argument");
+    std::unique_ptr<Response> actual = executor->execute({"zadd", "myset", "nx", "xx", "10", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "XX and NX options at the same time are not compatible");
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
-    delete executor;
-}
+    actual = executor->execute({"zadd", "myset", "gt", "lt", "10", "tyler"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "GT, LT, and/or NX options at the same time are not compatible");
+    assert_same(actual, expected);
 
-void test_zquery_non_existent_key() {
-    CommandExecutor *executor = create_executor();
-    
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "0"});
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    actual = executor->execute({"zadd", "myset", "nx", "gt", "10", "tyler"});
     assert_same(actual, expected);
 
-    delete executor;
-}
+    actual = executor->execute({"zadd", "myset", "incr", "10", "tyler", "20", "won"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "INCR option supports a single increment-element pair");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zadd", "myset", "10", "tyler", "20"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zadd", "myset", "ch", "nan", "tyler"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid score argument");
+    assert_same(actual, expected);
+
+    // nothing is added when any pair is invalid
+    actual = executor->execute({"zadd", "myset", "10", "tyler", "ten", "won"});
+    assert_same(actual, expected);
+
+    actual = executor->execute({"keys"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zincrby() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"zincrby", "myset", "5", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<DblResponse>(5);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zincrby", "myset", "-7", "tyler"});
+    expected = std::make_unique<DblResponse>(-2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zincrby", "myset", "five", "tyler"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid score argument");
+    assert_same(actual, expected);
+
+    executor->execute({"set", "name", "tyler"});
+    actual = executor->execute({"zincrby", "name", "1", "tyler"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_zrangebylex() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "0", "apple", "0", "app", "0", "banana", "0", "cherry"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrangebylex", "myset", "[app", "(b"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("app"), new StrResponse("apple") });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrevrangebylex", "myset", "+", "-", "LIMIT", "1", "2"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("banana"), new StrResponse("apple") });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrangebylex", "myset", "app", "+"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "min or max not valid string range item");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrangebylex", "myset", "-", "+", "WITHSCORES"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrangebylex", "missing", "-", "+"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zlexcount() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "0", "a", "0", "b", "0", "c"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zlexcount", "myset", "(a", "+"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zlexcount", "missing", "-", "+"});
+    expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    executor->execute({"set", "name", "tyler"});
+    actual = executor->execute({"zlexcount", "name", "-", "+"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_zremrangebylex() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "0", "a", "0", "b", "0", "c", "0", "d"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zremrangebylex", "myset", "[b", "[c"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrange", "myset", "0", "-1"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("a"), new StrResponse("d") });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zremrangebylex", "myset", "[b", "c"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "min or max not valid string range item");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zunionstore() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "set1", "1", "a", "2", "b"});
+    executor->execute({"zadd", "set2", "10", "b", "20", "c"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zunionstore", "dest", "3", "set1", "set2", "missing", 
+                                                          "WEIGHTS", "2", "1", "5"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(3);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrange", "dest", "0", "-1", "withscores"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("a"), new DblResponse(2), 
+                                                                      new StrResponse("b"), new DblResponse(14), 
+                                                                      new StrResponse("c"), new DblResponse(20) });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zunionstore", "dest", "2", "set1", "set2", "aggregate", "max"});
+    expected = std::make_unique<IntResponse>(3);
+    assert_same(actual, expected);
+    actual = executor->execute({"zscore", "dest", "b"});
+    expected = std::make_unique<StrResponse>(std::to_string(10.0));
+    assert_same(actual, expected);
+
+    executor->execute({"del", "set1"});
+    executor->execute({"del", "set2"});
+    executor->execute({"del", "dest"});
+    delete executor;
+}
+
+void test_zinterstore() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "set1", "1", "a", "2", "b", "3", "c"});
+    executor->execute({"zadd", "set2", "10", "b", "20", "c", "30", "d"});
+    executor->execute({"set", "dest", "tyler"}); // replaced whatever its type
+
+    std::unique_ptr<Response> actual = executor->execute({"zinterstore", "dest", "2", "set1", "set2", 
+                                                          "aggregate", "min"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrange", "dest", "0", "-1", "withscores"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("b"), new DblResponse(2), 
+                                                                      new StrResponse("c"), new DblResponse(3) });
+    assert_same(actual, expected);
+
+    // an empty result deletes the destination
+    actual = executor->execute({"zinterstore", "dest", "2", "set1", "missing"});
+    expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+    actual = executor->execute({"zcard", "dest"});
+    assert_same(actual, expected);
+
+    executor->execute({"del", "set1"});
+    executor->execute({"del", "set2"});
+    delete executor;
+}
+
+void test_zdiffstore() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "set1", "1", "a", "2", "b", "3", "c"});
+    executor->execute({"zadd", "set2", "10", "b"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zdiffstore", "dest", "2", "set1", "set2"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrange", "dest", "0", "-1", "withscores"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("a"), new DblResponse(1), 
+                                                                      new StrResponse("c"), new DblResponse(3) });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zdiffstore", "dest", "1", "set1", "weights", "2"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "set1"});
+    executor->execute({"del", "set2"});
+    executor->execute({"del", "dest"});
+    delete executor;
+}
+
+void test_zstore_invalid_arguments() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "set1", "1", "a"});
+    executor->execute({"set", "name", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zunionstore", "dest", "0", "set1"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, 
+                                                                       "at least 1 input key is needed");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zunionstore", "dest", "2", "set1"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zunionstore", "dest", "1", "set1", "weights", "heavy"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "weight value is not a float");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zunionstore", "dest", "1", "set1", "aggregate", "avg"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zunionstore", "dest", "2", "set1", "name"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "set1"});
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_zstore_large_input_deferred() {
+    CommandExecutor *executor = create_executor();
+
+    std::vector<std::string> command = { "zadd", "set1" };
+    for (uint32_t i = 0; i < LARGE_ZSET_SIZE; i++) {
+        command.push_back(std::to_string(i));
+        command.push_back("name" + std::to_string(i));
+    }
+    executor->execute(command);
+
+    // the command is handed off, and the source can keep changing while the job runs against its snapshot
+    std::unique_ptr<Response> actual = executor->execute({"zunionstore", "dest", "1", "set1"});
+    assert(actual == nullptr);
+    BackgroundJob *job = executor->take_deferred_job();
+    assert(job != NULL);
+    assert(executor->take_deferred_job() == NULL);
+
+    executor->execute({"zadd", "set1", "-1", "newname"});
+    executor->execute({"zrem", "set1", "name0"});
+    job->run();
+
+    actual = executor->finish_job(job);
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(LARGE_ZSET_SIZE);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zscore", "dest", "name0"});
+    expected = std::make_unique<StrResponse>(std::to_string(0.0));
+    assert_same(actual, expected);
+    actual = executor->execute({"zscore", "dest", "newname"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    executor->execute({"del", "set1"});
+    executor->execute({"del", "dest"});
+    delete executor;
+}
+
+void test_zscore_non_existent_key() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"zscore", "myset", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zscore_not_a_sorted_set() {
+    CommandExecutor *executor = create_executor();
 
-void test_zquery_not_a_sorted_set() {
-    CommandExecutor *executor = create_executor();
-    
     executor->execute({"set", "myset", "tyler"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "0"});
-    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    std::unique_ptr<Response> actual = executor->execute({"zscore", "myset", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_no_pairs_with_higher_score() {
+void test_zscore_non_existent_pair() {
     CommandExecutor *executor = create_executor();
-    
+
     executor->execute({"zadd", "myset", "10", "tyler"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "11", "tyler", "0", "0"});
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    std::unique_ptr<Response> actual = executor->execute({"zscore", "myset", "won"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_no_pairs_with_higher_name() {
+void test_zscore_existing_pair() {
     CommandExecutor *executor = create_executor();
-    
+
     executor->execute({"zadd", "myset", "10", "tyler"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "won", "0", "0"});
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    std::unique_ptr<Response> actual = executor->execute({"zscore", "myset", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<StrResponse>(std::to_string(10.0));
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_pairs_with_higher_score() {
+void test_zrem_non_existent_key() {
     CommandExecutor *executor = create_executor();
-    
-    executor->execute({"zadd", "myset", "0", "eve"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrem", "myset", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zrem_not_a_sorted_set() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "myset", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrem", "myset", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrem_non_existent_pair() {
+    CommandExecutor *executor = create_executor();
+
     executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "5", "adam", "0", "0"});
-    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    std::unique_ptr<Response> actual = executor->execute({"zrem", "myset", "won"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_pairs_with_higher_name() {
+void test_zrem_existing_pair() {
     CommandExecutor *executor = create_executor();
-    
-    executor->execute({"zadd", "myset", "0", "eve"});
+
     executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "jeff", "0", "0"});
-    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    std::unique_ptr<Response> actual = executor->execute({"zrem", "myset", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zscore", "myset", "tyler"});
+    expected = std::make_unique<NilResponse>();
     assert_same(actual, expected);
 
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_given_pair_in_sorted_set() {
+void test_zquery_invalid_score() {
     CommandExecutor *executor = create_executor();
-    
-    executor->execute({"zadd", "myset", "0", "eve"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "ten", "tyler", "0", "0"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid score argument");
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zquery_invalid_offset() {
+    CommandExecutor *executor = create_executor();
+
     executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "0"});
-    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "zero", "0"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid offset argument");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_invalid_limit() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "10", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "zero"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid limit argument");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_non_existent_key() {
+    CommandExecutor *executor = create_executor();
+    
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "0"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zquery_not_a_sorted_set() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"set", "myset", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "0"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_no_pairs_with_higher_score() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "10", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "11", "tyler", "0", "0"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_no_pairs_with_higher_name() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "10", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "won", "0", "0"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_pairs_with_higher_score() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "0", "eve"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "5", "adam", "0", "0"});
+    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_pairs_with_higher_name() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "0", "eve"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "jeff", "0", "0"});
+    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_given_pair_in_sorted_set() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "0", "eve"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "0"});
+    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_with_offset() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "0", "eve"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "0", "adam", "1", "0"});
+    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_offset_skips_all_results() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "0", "eve"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "0", "adam", "3", "0"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_under_limit() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "0", "eve"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "2"});
+    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zquery_hit_limit() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"zadd", "myset", "0", "eve"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "1"});
+    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrank_non_existent_key() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zrank_not_a_sorted_set() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "myset", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrank_non_existent_pair() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "10", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "won"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrank_lowest_pair() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "adam"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrank_middle_pair() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "tyler"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrank_highest_pair() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "won"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrevrank() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrevrank", "myset", "won"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrevrank", "myset", "adam"});
+    expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrevrank", "myset", "eve"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrange_non_existent_key() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"zrange", "myset", "0", "-1"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zrange_not_a_sorted_set() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "myset", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrange", "myset", "0", "-1"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrange_invalid_rank() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"zrange", "myset", "zero", "-1"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid rank argument");
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zrange() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrange", "myset", "1", "-1"});
+    std::vector<Response *> elements = { new StrResponse("tyler"), new StrResponse("won") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrange", "myset", "0", "0", "WITHSCORES"});
+    elements = { new StrResponse("adam"), new DblResponse(5.0) };
+    expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrevrange() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrevrange", "myset", "0", "1", "withscores"});
+    std::vector<Response *> elements = { new StrResponse("won"), new DblResponse(15.0), new StrResponse("tyler"), new DblResponse(10.0) };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrange_unknown_option() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"zrange", "myset", "0", "-1", "limit", "0", "1"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zrangebyscore_invalid_range() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"zrangebyscore", "myset", "(ten", "20"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "min or max is not a float");
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_zrangebyscore() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrangebyscore", "myset", "(5", "+inf"});
+    std::vector<Response *> elements = { new StrResponse("tyler"), new StrResponse("won") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrangebyscore", "myset", "-inf", "15", "withscores", "limit", "1", "1"});
+    elements = { new StrResponse("tyler"), new DblResponse(10.0) };
+    expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zrevrangebyscore() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zrevrangebyscore", "myset", "(15", "-inf"});
+    std::vector<Response *> elements = { new StrResponse("tyler"), new StrResponse("adam") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrevrangebyscore", "myset", "+inf", "-inf", "LIMIT", "0", "1"});
+    elements = { new StrResponse("won") };
+    expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zcount() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"zcount", "myset", "-inf", "+inf"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    actual = executor->execute({"zcount", "myset", "5", "(15"});
+    expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zcount", "myset", "five", "15"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "min or max is not a float");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zcard() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"zcard", "myset"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+
+    actual = executor->execute({"zcard", "myset"});
+    expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    executor->execute({"set", "name", "tyler"});
+    actual = executor->execute({"zcard", "name"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not a sorted set");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_zremrangebyrank() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zremrangebyrank", "myset", "0", "-2"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrange", "myset", "0", "-1"});
+    std::vector<Response *> elements = { new StrResponse("won") };
+    expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zremrangebyrank", "myset", "5", "10"});
+    expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zremrangebyrank_large_range() {
+    CommandExecutor *executor = create_executor();
+
+    for (uint32_t i = 0; i < 2 * LARGE_ZSET_SIZE; i++) {
+        executor->execute({"zadd", "myset", std::to_string(i), std::to_string(i)});
+    }
+
+    // the removed pairs are freed by the thread pool
+    std::unique_ptr<Response> actual = executor->execute({"zremrangebyrank", "myset", "0", std::to_string(LARGE_ZSET_SIZE - 1)});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(LARGE_ZSET_SIZE);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zcard", "myset"});
+    expected = std::make_unique<IntResponse>(LARGE_ZSET_SIZE);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrank", "myset", std::to_string(LARGE_ZSET_SIZE)});
+    expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zscore", "myset", "0"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    sleep(1); // sleep briefly to allow async delete to finish
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zremrangebyscore() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zremrangebyscore", "myset", "(5", "+inf"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zcard", "myset"});
+    expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zremrangebyscore", "myset", "1", "five"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "min or max is not a float");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zpopmin() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zpopmin", "myset"});
+    std::vector<Response *> elements = { new StrResponse("adam"), new DblResponse(5.0) };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zpopmin", "myset", "5"});
+    elements = { new StrResponse("tyler"), new DblResponse(10.0), new StrResponse("won"), new DblResponse(15.0) };
+    expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zpopmin", "myset"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_zpopmax() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"zadd", "myset", "5", "adam"});
+    executor->execute({"zadd", "myset", "10", "tyler"});
+    executor->execute({"zadd", "myset", "15", "won"});
+
+    std::unique_ptr<Response> actual = executor->execute({"zpopmax", "myset", "2"});
+    std::vector<Response *> elements = { new StrResponse("won"), new DblResponse(15.0), new StrResponse("tyler"), new DblResponse(10.0) };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zrange", "myset", "0", "-1"});
+    elements = { new StrResponse("adam") };
+    expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zpopmax", "myset", "-1"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid count argument");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "myset"});
+    delete executor;
+}
+
+void test_expire_invalid_duration() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"expire", "name", "hundred"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid seconds argument");
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_expire_non_existent_key() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"expire", "status", "10"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_expire_existing_key() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"expire", "name", "10"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"ttl", "name"});
+    IntResponse *actual_int = static_cast<IntResponse *>(actual.get());
+    assert(actual_int->get_int() > 0);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_pexpire_existing_key() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"pexpire", "name", "2500"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"pttl", "name"});
+    expected = std::make_unique<IntResponse>(2500);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"ttl", "name"});
+    expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_pexpire_invalid_time() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"pexpire", "name", "ten"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid time argument");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"expireat", "name", "9223372036854775807"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid expire time");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"pexpire", "name", "9223372036854775807"});
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_expireat_existing_key() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"expireat", "name", std::to_string(time(NULL) + 100)});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"ttl", "name"});
+    IntResponse *ttl = (IntResponse *) actual.get();
+    assert(ttl->get_int() >= 98 && ttl->get_int() <= 100);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_pexpireat_in_past() {
+    HMap *kv_store = new HMap();
+    TimerManager *timers = new TimerManager();
+    CommandExecutor *executor = new CommandExecutor(kv_store, timers, new ThreadPool(4), new Evictor());
+
+    executor->execute({"set", "name", "tyler", "ex", "10"});
+    std::unique_ptr<Response> actual = executor->execute({"pexpireat", "name", "1000"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
+
+    // deleted right away, not left for a read or the timers to find
+    assert(kv_store->length() == 0);
+    assert(timers->get_ttl_timers()->is_empty());
+
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_pttl_non_existent_key() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"pttl", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(-2);
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_pttl_no_ttl() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"pttl", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(-1);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_ttl_non_existent_key() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"ttl", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(-2);
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_ttl_no_ttl() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"ttl", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(-1);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_ttl_has_ttl() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+    executor->execute({"expire", "name", "10"});
+
+    std::unique_ptr<Response> actual = executor->execute({"ttl", "name"});
+    IntResponse *actual_int = static_cast<IntResponse *>(actual.get());
+    assert(actual_int->get_int() > 0);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_persist_non_existent_key() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"persist", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_persist_no_ttl() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"set", "name", "tyler"});
+
+    std::unique_ptr<Response> actual = executor->execute({"persist", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_persist_has_ttl() {
+    CommandExecutor *executor = create_executor();
+    
+    executor->execute({"set", "name", "tyler"});
+    executor->execute({"expire", "name", "10"});
+
+    std::unique_ptr<Response> actual = executor->execute({"persist", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"ttl", "name"});
+    expected = std::make_unique<IntResponse>(-1);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    delete executor;
+}
+
+void test_get_expired_key() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+    executor->execute({"expire", "name", "0"});
+
+    std::unique_ptr<Response> actual = executor->execute({"get", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    actual = executor->execute({"ttl", "name"});
+    expected = std::make_unique<IntResponse>(-2);
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_del_expired_key() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+    executor->execute({"expire", "name", "0"});
+
+    std::unique_ptr<Response> actual = executor->execute({"del", "name"});
+    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_keys_skips_expired_key() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+    executor->execute({"set", "other", "won"});
+    executor->execute({"expire", "name", "0"});
+
+    std::unique_ptr<Response> actual = executor->execute({"keys"});
+    std::vector<Response *> elements = { new StrResponse("other") };
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    assert_same(actual, expected);
+
+    executor->execute({"del", "name"});
+    executor->execute({"del", "other"});
+    delete executor;
+}
+
+void test_info_counts_lazy_expired_keys() {
+    CommandExecutor *executor = create_executor();
+
+    // expire 0 deletes it right away, so it has to expire between commands to be found by a read
+    executor->execute({"set", "name", "tyler", "px", "1"});
+    usleep(2000);
+    update_cached_time();
+    executor->execute({"get", "name"});
+
+    std::unique_ptr<Response> actual = executor->execute({"info"});
+    std::string info = actual->to_string();
+    assert(info.find("keys:0") != std::string::npos);
+    assert(info.find("lazy_expired_keys:1") != std::string::npos);
+    assert(info.find("active_expired_keys:0") != std::string::npos);
+
+    delete executor;
+}
+
+void test_config_get_defaults() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"config", "get", "maxmemory"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("maxmemory"), new StrResponse("0") });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "get", "maxmemory-policy"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("maxmemory-policy"), new StrResponse("noeviction") });
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_config_set() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"config", "set", "maxmemory", "1048576"});
+    std::unique_ptr<Response> expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "maxmemory-policy", "ALLKEYS-LFU"});
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "get", "maxmemory"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("maxmemory"), new StrResponse("1048576") });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "get", "maxmemory-policy"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("maxmemory-policy"), new StrResponse("allkeys-lfu") });
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_config_set_invalid_value() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"config", "set", "maxmemory", "lots"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid maxmemory");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "maxmemory-policy", "allkeys-random"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid maxmemory-policy");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "port", "8000"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "unsupported parameter");
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_config_set_zset_listpack_limits() {
+    CommandExecutor *executor = create_executor();
+
+    std::unique_ptr<Response> actual = executor->execute({"config", "set", "zset-max-listpack-entries", "2"});
+    std::unique_ptr<Response> expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "get", "zset-max-listpack-entries"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("zset-max-listpack-entries"), new StrResponse("2") });
+    assert_same(actual, expected);
+
+    // the third pair converts the sorted set, which keeps its order
+    executor->execute({"zadd", "key", "3", "c"});
+    executor->execute({"zadd", "key", "1", "a"});
+    executor->execute({"zadd", "key", "2", "b"});
+    actual = executor->execute({"zrank", "key", "c"});
+    expected = std::make_unique<IntResponse>(2);
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "zset-max-listpack-value", "256"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid zset-max-listpack-value");
+    assert_same(actual, expected);
+
+    executor->execute({"config", "set", "zset-max-listpack-entries", std::to_string(SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES)});
+
+    delete executor;
+}
+
+void test_set_over_maxmemory_with_noeviction() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"set", "name", "tyler"});
+    executor->execute({"config", "set", "maxmemory", std::to_string(get_used_memory() - 1)});
+
+    std::unique_ptr<Response> actual = executor->execute({"set", "other", "won"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_OOM, "command not allowed when used memory > 'maxmemory'");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"zadd", "myset", "10", "tyler"});
+    assert_same(actual, expected);
+
+    // commands that don't grow used memory are still allowed
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<StrResponse>("tyler");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"del", "name"});
+    expected = std::make_unique<IntResponse>(1);
+    assert_same(actual, expected);
+
+    delete executor;
+}
+
+void test_set_over_maxmemory_evicts_keys() {
+    CommandExecutor *executor = create_executor();
+
+    executor->execute({"config", "set", "maxmemory-policy", "allkeys-lru"});
+    executor->execute({"set", "name", "tyler"});
+    executor->execute({"config", "set", "maxmemory", std::to_string(get_used_memory() - 1)});
+
+    std::unique_ptr<Response> actual = executor->execute({"set", "other", "won"});
+    std::unique_ptr<Response> expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<NilResponse>();
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
+    std::string info = executor->execute({"info"})->to_string();
+    assert(info.find("evicted_keys:1") != std::string::npos);
+    assert(info.find("maxmemory_policy:allkeys-lru") != std::string::npos);
+
+    executor->execute({"del", "other"});
     delete executor;
 }
 
-void test_zquery_with_offset() {
+void test_info_tracks_used_memory() {
     CommandExecutor *executor = create_executor();
-    
-    executor->execute({"zadd", "myset", "0", "eve"});
-    executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "0", "adam", "1", "0"});
-    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
-    assert_same(actual, expected);
+    uint64_t used_memory = get_used_memory();
+    executor->execute({"set", "name", "tyler"});
+    assert(get_used_memory() > used_memory);
+
+    std::string info = executor->execute({"info"})->to_string();
+    assert(info.find("used_memory:" + std::to_string(get_used_memory())) != std::string::npos);
+
+    executor->execute({"del", "name"});
+    assert(get_used_memory() == used_memory);
 
-    executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_offset_skips_all_results() {
+void test_invalid_command() {
     CommandExecutor *executor = create_executor();
     
-    executor->execute({"zadd", "myset", "0", "eve"});
-    executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
-
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "0", "adam", "3", "0"});
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>());
+    std::unique_ptr<Response> actual = executor->execute({"not", "a", "command"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "unknown command");
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_under_limit() {
+void test_write_commands_count_as_changes() {
     CommandExecutor *executor = create_executor();
-    
-    executor->execute({"zadd", "myset", "0", "eve"});
+    uint64_t changes = Rdb::shared().get_stats().changes_since_last_save;
+
+    executor->execute({"set", "name", "tyler"});
     executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
+    executor->execute({"expire", "name", "100"});
+    assert(Rdb::shared().get_stats().changes_since_last_save == changes + 3);
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "2"});
-    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler"), new DblResponse(15.0), new StrResponse("won") };
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
-    assert_same(actual, expected);
+    // reads and failed writes aren't changes
+    executor->execute({"get", "name"});
+    executor->execute({"zscore", "myset", "tyler"});
+    executor->execute({"zadd", "name", "10", "tyler"});
+    assert(Rdb::shared().get_stats().changes_since_last_save == changes + 3);
 
+    executor->execute({"del", "name"});
     executor->execute({"del", "myset"});
     delete executor;
 }
 
-void test_zquery_hit_limit() {
+void test_save_and_lastsave() {
     CommandExecutor *executor = create_executor();
-    
-    executor->execute({"zadd", "myset", "0", "eve"});
-    executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
+    std::string filename = "test_command_executor_" + std::to_string(getpid()) + ".rdb";
 
-    std::unique_ptr<Response> actual = executor->execute({"zquery", "myset", "10", "tyler", "0", "1"});
-    std::vector<Response *> elements = { new DblResponse(10.0), new StrResponse("tyler") };
-    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(elements);
+    std::unique_ptr<Response> actual = executor->execute({"config", "set", "dbfilename", filename});
+    std::unique_ptr<Response> expected = std::make_unique<StrResponse>("OK");
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
-    delete executor;
-}
+    executor->execute({"set", "name", "tyler"});
+    actual = executor->execute({"save"});
+    assert_same(actual, expected);
+    assert(Rdb::shared().get_stats().changes_since_last_save == 0);
+    assert(access(filename.data(), F_OK) == 0);
 
-void test_zrank_non_existent_key() {
-    CommandExecutor *executor = create_executor();
+    actual = executor->execute({"lastsave"});
+    expected = std::make_unique<IntResponse>(Rdb::shared().get_stats().last_save_time);
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    actual = executor->execute({"bgsave"});
+    expected = std::make_unique<StrResponse>("Background saving started");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"save"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "Background save already in progress");
     assert_same(actual, expected);
 
+    actual = executor->execute({"bgsave"});
+    assert_same(actual, expected);
+
+    HMap unused; // cron() only reads the kv store to start a bgsave
+    while (Rdb::shared().get_stats().bgsave_in_progress) {
+        usleep(1000);
+        Rdb::shared().cron(unused);
+    }
+    assert(Rdb::shared().get_stats().last_bgsave_ok);
+
+    unlink(filename.data());
+    Rdb::shared().set_filename("dump.rdb");
+    executor->execute({"del", "name"});
     delete executor;
 }
 
-void test_zrank_not_a_sorted_set() {
+void test_config_set_save() {
     CommandExecutor *executor = create_executor();
 
-    executor->execute({"set", "myset", "tyler"});
+    std::unique_ptr<Response> actual = executor->execute({"config", "get", "save"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("save"), new StrResponse("3600 1 300 100 60 10000") });
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    actual = executor->execute({"config", "set", "save", "10 5"});
+    expected = std::make_unique<StrResponse>("OK");
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
+    actual = executor->execute({"config", "get", "save"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("save"), new StrResponse("10 5") });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "save", "10"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid save");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "dbfilename", "../dump.rdb"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid dbfilename");
+    assert_same(actual, expected);
+
+    executor->execute({"config", "set", "save", "3600 1 300 100 60 10000"});
     delete executor;
 }
 
-void test_zrank_non_existent_pair() {
+void test_config_set_pubsub_limits() {
     CommandExecutor *executor = create_executor();
 
-    executor->execute({"zadd", "myset", "10", "tyler"});
+    std::unique_ptr<Response> actual = executor->execute({"config", "get", "client-output-buffer-limit-pubsub"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("client-output-buffer-limit-pubsub"), new StrResponse("33554432 8388608 60") });
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "won"});
-    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    actual = executor->execute({"config", "set", "client-output-buffer-limit-pubsub", "1048576 0 0"});
+    expected = std::make_unique<StrResponse>("OK");
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
+    actual = executor->execute({"config", "get", "client-output-buffer-limit-pubsub"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("client-output-buffer-limit-pubsub"), new StrResponse("1048576 0 0") });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "client-output-buffer-limit-pubsub", "1048576"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid client-output-buffer-limit-pubsub");
+    assert_same(actual, expected);
+
+    executor->execute({"config", "set", "client-output-buffer-limit-pubsub", "33554432 8388608 60"});
     delete executor;
 }
 
-void test_zrank_lowest_pair() {
+void test_config_set_appendonly() {
     CommandExecutor *executor = create_executor();
+    std::string filename = "test_command_executor_" + std::to_string(getpid()) + ".aof";
 
-    executor->execute({"zadd", "myset", "5", "adam"});
-    executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
+    std::unique_ptr<Response> actual = executor->execute({"config", "get", "appendfsync"});
+    std::unique_ptr<Response> expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("appendfsync"), new StrResponse("everysec") });
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "adam"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    actual = executor->execute({"config", "set", "appendfsync", "sometimes"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid appendfsync");
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
-    delete executor;
-}
+    actual = executor->execute({"config", "set", "appendfilename", filename});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
 
-void test_zrank_middle_pair() {
-    CommandExecutor *executor = create_executor();
+    executor->execute({"set", "name", "tyler"});
+    actual = executor->execute({"config", "set", "appendonly", "yes"});
+    assert_same(actual, expected);
+    assert(Aof::shared().is_enabled());
+    assert(access(filename.data(), F_OK) == 0);
 
-    executor->execute({"zadd", "myset", "5", "adam"});
-    executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
+    // the file can't be switched while it's in use
+    actual = executor->execute({"config", "set", "appendfilename", "other.aof"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid appendfilename");
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "tyler"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    actual = executor->execute({"config", "set", "appendonly", "no"});
+    expected = std::make_unique<StrResponse>("OK");
     assert_same(actual, expected);
+    assert(!Aof::shared().is_enabled());
 
-    executor->execute({"del", "myset"});
+    unlink(filename.data());
+    Aof::shared().set_filename("appendonly.aof");
+    executor->execute({"del", "name"});
     delete executor;
 }
 
-void test_zrank_highest_pair() {
+void test_bgrewriteaof() {
     CommandExecutor *executor = create_executor();
 
-    executor->execute({"zadd", "myset", "5", "adam"});
-    executor->execute({"zadd", "myset", "10", "tyler"});
-    executor->execute({"zadd", "myset", "15", "won"});
+    std::unique_ptr<Response> actual = executor->execute({"bgrewriteaof"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "append-only file is off");
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"zrank", "myset", "won"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(2);
+    actual = executor->execute({"config", "set", "auto-aof-rewrite-percentage", "-1"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid auto-aof-rewrite-percentage");
     assert_same(actual, expected);
 
-    executor->execute({"del", "myset"});
+    actual = executor->execute({"config", "set", "auto-aof-rewrite-min-size", "1mb"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid auto-aof-rewrite-min-size");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "auto-aof-rewrite-percentage", "50"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+    actual = executor->execute({"config", "get", "auto-aof-rewrite-percentage"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("auto-aof-rewrite-percentage"), new StrResponse("50") });
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "auto-aof-rewrite-min-size", "1024"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+    actual = executor->execute({"config", "get", "auto-aof-rewrite-min-size"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("auto-aof-rewrite-min-size"), new StrResponse("1024") });
+    assert_same(actual, expected);
+
+    Aof::shared().set_auto_rewrite_percentage(100);
+    Aof::shared().set_auto_rewrite_min_size(64 * 1024 * 1024);
     delete executor;
 }
 
-void test_expire_invalid_duration() {
+void test_replicaof() {
     CommandExecutor *executor = create_executor();
+    executor->execute({"set", "key", "value"});
 
-    executor->execute({"set", "name", "tyler"});
+    std::unique_ptr<Response> actual = executor->execute({"replicaof", "localhost", "port"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid port");
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"expire", "name", "hundred"});
-    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid seconds argument");
+    actual = executor->execute({"replicaof", "localhost", "1"});
+    expected = std::make_unique<StrResponse>("OK");
     assert_same(actual, expected);
+    assert(Replication::shared().is_replica());
 
-    executor->execute({"del", "name"});
+    // a replica serves reads but rejects writes
+    actual = executor->execute({"get", "key"});
+    expected = std::make_unique<StrResponse>("value");
+    assert_same(actual, expected);
+    actual = executor->execute({"set", "key", "other"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_READONLY, "You can't write against a read only replica.");
+    assert_same(actual, expected);
+    actual = executor->execute({"zadd", "zset", "1", "a"});
+    assert_same(actual, expected);
+
+    actual = executor->execute({"replicaof", "no", "one"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+    assert(!Replication::shared().is_replica());
+    actual = executor->execute({"set", "key", "other"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"config", "set", "repl-backlog-size", "0"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid repl-backlog-size");
+    assert_same(actual, expected);
+    actual = executor->execute({"config", "set", "repl-backlog-size", "4096"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+    actual = executor->execute({"config", "get", "repl-backlog-size"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("repl-backlog-size"), new StrResponse("4096") });
+    assert_same(actual, expected);
+
+    Replication::shared().set_backlog_size(1024 * 1024);
     delete executor;
 }
 
-void test_expire_non_existent_key() {
+/* Dumps a key, asserting that it exists */
+std::string dump(CommandExecutor *executor, const std::string &key) {
+    std::unique_ptr<Response> response = executor->execute({"dump", key});
+    StrResponse *payload = dynamic_cast<StrResponse *>(response.get());
+    assert(payload != NULL);
+    return payload->get_msg();
+}
+
+void test_dump_and_restore() {
     CommandExecutor *executor = create_executor();
+    executor->execute({"set", "name", "tyler", "PX", "100000"});
+    executor->execute({"zadd", "myset", "1", "a", "2", "b"});
 
-    executor->execute({"set", "name", "tyler"});
+    std::unique_ptr<Response> actual = executor->execute({"dump", "missing"});
+    std::unique_ptr<Response> expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"expire", "status", "10"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    std::string name_payload = dump(executor, "name");
+    std::string set_payload = dump(executor, "myset");
+    executor->execute({"del", "name"});
+    executor->execute({"del", "myset"});
+
+    // the payload keeps the TTL unless restore is given one
+    actual = executor->execute({"restore", "name", "0", name_payload});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<StrResponse>("tyler");
+    assert_same(actual, expected);
+    IntResponse *ttl = dynamic_cast<IntResponse *>(executor->execute({"pttl", "name"}).release());
+    assert(ttl->get_int() > 90000 && ttl->get_int() <= 100000);
+    delete ttl;
+
+    actual = executor->execute({"restore", "copy", "0", set_payload});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+    actual = executor->execute({"zrange", "copy", "0", "-1", "WITHSCORES"});
+    expected = std::make_unique<ArrResponse>(std::vector<Response *>{ new StrResponse("a"), new DblResponse(1), new StrResponse("b"), new DblResponse(2) });
+    assert_same(actual, expected);
+    actual = executor->execute({"pttl", "copy"});
+    expected = std::make_unique<IntResponse>(-1);
     assert_same(actual, expected);
 
+    actual = executor->execute({"restore", "other", "5000", set_payload});
+    ttl = dynamic_cast<IntResponse *>(executor->execute({"pttl", "other"}).release());
+    assert(ttl->get_int() > 4000 && ttl->get_int() <= 5000);
+    delete ttl;
+
     executor->execute({"del", "name"});
+    executor->execute({"del", "copy"});
+    executor->execute({"del", "other"});
     delete executor;
 }
 
-void test_expire_existing_key() {
+void test_restore_existing_key() {
     CommandExecutor *executor = create_executor();
-
     executor->execute({"set", "name", "tyler"});
+    executor->execute({"zadd", "myset", "1", "a"});
+    std::string payload = dump(executor, "name");
 
-    std::unique_ptr<Response> actual = executor->execute({"expire", "name", "10"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
+    std::unique_ptr<Response> actual = executor->execute({"restore", "name", "0", payload});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "BUSYKEY Target key name already exists.");
     assert_same(actual, expected);
 
-    actual = executor->execute({"ttl", "name"});
-    IntResponse *actual_int = static_cast<IntResponse *>(actual.get());
-    assert(actual_int->get_int() > 0);
+    actual = executor->execute({"restore", "myset", "0", payload, "REPLACE"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+    actual = executor->execute({"get", "myset"});
+    expected = std::make_unique<StrResponse>("tyler");
+    assert_same(actual, expected);
 
-    executor->execute({"del", "name"});
-    delete executor;
-}
+    // APPEND adds to the value, for values sent as several payloads
+    actual = executor->execute({"restore", "name", "0", payload, "APPEND"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<StrResponse>("tylertyler");
+    assert_same(actual, expected);
 
-void test_ttl_non_existent_key() {
-    CommandExecutor *executor = create_executor();
+    // a chunk can't make up the whole value if the key went away since the last one
+    actual = executor->execute({"restore", "missing", "0", payload, "APPEND"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "no such key");
+    assert_same(actual, expected);
+    actual = executor->execute({"get", "missing"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"ttl", "name"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(-2);
+    executor->execute({"zadd", "zset", "1", "a"});
+    actual = executor->execute({"restore", "zset", "0", payload, "APPEND"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_BAD_TYPE, "value is not the type of the payload");
+    assert_same(actual, expected);
+
+    // a TTL that has already passed deletes the key
+    actual = executor->execute({"restore", "name", "1000", payload, "REPLACE", "ABSTTL"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<NilResponse>();
     assert_same(actual, expected);
 
+    executor->execute({"del", "myset"});
+    executor->execute({"del", "zset"});
     delete executor;
 }
 
-void test_ttl_no_ttl() {
+void test_restore_invalid() {
     CommandExecutor *executor = create_executor();
-
     executor->execute({"set", "name", "tyler"});
+    std::string payload = dump(executor, "name");
 
-    std::unique_ptr<Response> actual = executor->execute({"ttl", "name"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(-1);
+    std::unique_ptr<Response> actual = executor->execute({"restore", "key", "-1", payload});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "Invalid TTL value, must be >= 0");
+    assert_same(actual, expected);
+
+    actual = executor->execute({"restore", "key", "0", payload, "KEEPTTL"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    assert_same(actual, expected);
+
+    // TTLs that overflow the clock, whether given or in the payload
+    actual = executor->execute({"restore", "key", std::to_string(INT64_MAX), payload});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid expire time");
+    assert_same(actual, expected);
+    DumpWriter far(EntryType::STR, INT64_MAX);
+    far.set_str("v", 1);
+    actual = executor->execute({"restore", "key", "0", far.finish()});
+    assert_same(actual, expected);
+
+    // a negative TTL in the payload
+    DumpWriter negative(EntryType::STR, -5);
+    negative.set_str("v", 1);
+    actual = executor->execute({"restore", "key", "0", negative.finish()});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "DUMP payload version or checksum are wrong");
+    assert_same(actual, expected);
+    actual = executor->execute({"get", "key"});
+    expected = std::make_unique<NilResponse>();
+    assert_same(actual, expected);
+
+    payload[0] ^= 1;
+    actual = executor->execute({"restore", "key", "0", payload});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "DUMP payload version or checksum are wrong");
+    assert_same(actual, expected);
+
+    // a dump must fit in a restore request
+    executor->execute({"set", "big", std::string(Request::MAX_LEN, 'x')});
+    actual = executor->execute({"dump", "big"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_TOO_BIG, "value is too big to dump, use migrate to move it");
     assert_same(actual, expected);
 
     executor->execute({"del", "name"});
+    executor->execute({"del", "big"});
     delete executor;
 }
 
-void test_ttl_has_ttl() {
+void test_restore_counts_as_change() {
     CommandExecutor *executor = create_executor();
-
     executor->execute({"set", "name", "tyler"});
-    executor->execute({"expire", "name", "10"});
+    std::string payload = dump(executor, "name");
+    uint64_t changes = Rdb::shared().get_stats().changes_since_last_save;
 
-    std::unique_ptr<Response> actual = executor->execute({"ttl", "name"});
-    IntResponse *actual_int = static_cast<IntResponse *>(actual.get());
-    assert(actual_int->get_int() > 0);
+    executor->execute({"restore", "name", "0", payload, "REPLACE"});
+    executor->execute({"restore", "name", "0", payload}); // fails, the key exists
+    assert(Rdb::shared().get_stats().changes_since_last_save == changes + 1);
 
     executor->execute({"del", "name"});
     delete executor;
 }
 
-void test_persist_non_existent_key() {
+void test_migrate_invalid() {
     CommandExecutor *executor = create_executor();
 
-    std::unique_ptr<Response> actual = executor->execute({"persist", "name"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    std::unique_ptr<Response> actual = executor->execute({"migrate", "localhost", "port", "key", "0"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid port");
     assert_same(actual, expected);
 
-    delete executor;
-}
+    actual = executor->execute({"migrate", "localhost", "1", "key", "-1"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "invalid timeout argument");
+    assert_same(actual, expected);
 
-void test_persist_no_ttl() {
-    CommandExecutor *executor = create_executor();
-    
-    executor->execute({"set", "name", "tyler"});
+    actual = executor->execute({"migrate", "localhost", "1", "key", "0", "KEYS", "other"});
+    expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_INVALID_ARG, "syntax error");
+    assert_same(actual, expected);
 
-    std::unique_ptr<Response> actual = executor->execute({"persist", "name"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(0);
+    actual = executor->execute({"migrate", "localhost", "1", "", "0"});
     assert_same(actual, expected);
 
-    executor->execute({"del", "name"});
+    actual = executor->execute({"migrate", "localhost", "1", "", "0", "KEYS", "missing", "other"});
+    expected = std::make_unique<StrResponse>("NOKEY");
+    assert_same(actual, expected);
+    assert(executor->take_deferred_job() == NULL);
+
     delete executor;
 }
 
-void test_persist_has_ttl() {
+void test_migrate_locks_keys() {
     CommandExecutor *executor = create_executor();
-    
     executor->execute({"set", "name", "tyler"});
-    executor->execute({"expire", "name", "10"});
+    executor->execute({"set", "other", "value"});
 
-    std::unique_ptr<Response> actual = executor->execute({"persist", "name"});
-    std::unique_ptr<Response> expected = std::make_unique<IntResponse>(1);
-    assert_same(actual, expected);
+    // the job isn't run, so the keys stay locked until it's finished
+    std::unique_ptr<Response> actual = executor->execute({"migrate", "localhost", "1", "name", "0"});
+    assert(actual == nullptr);
+    BackgroundJob *job = executor->take_deferred_job();
+    assert(job != NULL);
 
-    actual = executor->execute({"ttl", "name"});
-    expected = std::make_unique<IntResponse>(-1);
+    actual = executor->execute({"set", "name", "other"});
+    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "TRYAGAIN key is being migrated");
+    assert_same(actual, expected);
+    actual = executor->execute({"migrate", "localhost", "1", "name", "0"});
     assert_same(actual, expected);
 
-    executor->execute({"del", "name"});
-    delete executor;
-}
+    // reads and other keys are served as usual
+    actual = executor->execute({"get", "name"});
+    expected = std::make_unique<StrResponse>("tyler");
+    assert_same(actual, expected);
+    actual = executor->execute({"set", "other", "new"});
+    expected = std::make_unique<StrResponse>("OK");
+    assert_same(actual, expected);
 
-void test_invalid_command() {
-    CommandExecutor *executor = create_executor();
-    
-    std::unique_ptr<Response> actual = executor->execute({"not", "a", "command"});
-    std::unique_ptr<Response> expected = std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, "unknown command");
+    // nothing listens on port 1, so the key stays here
+    job->run();
+    actual = executor->finish_job(job);
+    assert(dynamic_cast<ErrResponse *>(actual.get()) != NULL);
+    actual = executor->execute({"set", "name", "other"});
+    expected = std::make_unique<StrResponse>("OK");
     assert_same(actual, expected);
 
+    executor->execute({"del", "name"});
+    executor->execute({"del", "other"});
     delete executor;
 }
 
@@ -835,6 +2603,17 @@ int main() {
     test_set_existing_entry();
     test_set_existing_entry_with_ttl();
     test_set_existing_non_string_entry();
+    test_set_with_ex();
+    test_set_with_px();
+    test_set_with_exat();
+    test_set_with_pxat_in_past();
+    test_set_with_invalid_expire_time();
+    test_set_with_conflicting_options();
+    test_set_nx();
+    test_set_xx();
+    test_set_keepttl();
+    test_set_get();
+    test_set_get_non_string_entry();
 
     test_del_non_existent_key();
     test_del_string_entry();
@@ -850,6 +2629,23 @@ int main() {
     test_zadd_not_a_sorted_set();
     test_zadd_new_pair();
     test_zadd_existing_pair();
+    test_zadd_multiple_pairs();
+    test_zadd_large_sorted_input();
+    test_zadd_nx_and_xx();
+    test_zadd_gt_and_lt();
+    test_zadd_ch();
+    test_zadd_incr();
+    test_zadd_incr_nan();
+    test_zadd_invalid_options();
+    test_zincrby();
+    test_zrangebylex();
+    test_zlexcount();
+    test_zremrangebylex();
+    test_zunionstore();
+    test_zinterstore();
+    test_zdiffstore();
+    test_zstore_invalid_arguments();
+    test_zstore_large_input_deferred();
 
     test_zscore_non_existent_key();
     test_zscore_not_a_sorted_set();
@@ -882,11 +2678,38 @@ int main() {
     test_zrank_lowest_pair();
     test_zrank_middle_pair();
     test_zrank_highest_pair();
+    test_zrevrank();
+
+    test_zrange_non_existent_key();
+    test_zrange_not_a_sorted_set();
+    test_zrange_invalid_rank();
+    test_zrange();
+    test_zrevrange();
+    test_zrange_unknown_option();
+    test_zrangebyscore_invalid_range();
+    test_zrangebyscore();
+    test_zrevrangebyscore();
+    test_zcount();
+    test_zcard();
+
+    test_zremrangebyrank();
+    test_zremrangebyrank_large_range();
+    test_zremrangebyscore();
+    test_zpopmin();
+    test_zpopmax();
 
     test_expire_invalid_duration();
     test_expire_non_existent_key();
     test_expire_existing_key();
 
+    test_pexpire_existing_key();
+    test_pexpire_invalid_time();
+    test_expireat_existing_key();
+    test_pexpireat_in_past();
+
+    test_pttl_non_existent_key();
+    test_pttl_no_ttl();
+
     test_ttl_non_existent_key();
     test_ttl_no_ttl();
     test_ttl_has_ttl();
@@ -895,6 +2718,34 @@ int main() {
     test_persist_no_ttl();
     test_persist_has_ttl();
 
+    test_get_expired_key();
+    test_del_expired_key();
+    test_keys_skips_expired_key();
+
+    test_info_counts_lazy_expired_keys();
+    test_info_tracks_used_memory();
+
+    test_config_get_defaults();
+    test_config_set();
+    test_config_set_invalid_value();
+    test_config_set_zset_listpack_limits();
+
+    test_set_over_maxmemory_with_noeviction();
+    test_set_over_maxmemory_evicts_keys();
+
+    test_write_commands_count_as_changes();
+    test_save_and_lastsave();
+    test_config_set_save();
+    test_config_set_pubsub_limits();
+    test_config_set_appendonly();
+    test_bgrewriteaof();
+    test_replicaof();
+    test_dump_and_restore();
+    test_restore_existing_key();
+    test_restore_invalid();
+    test_restore_counts_as_change();
+    test_migrate_invalid();
+    test_migrate_locks_keys();
     test_invalid_command();
 
     return 0;
@@ -1,23 +1,73 @@
 #include <sys/socket.h>
 
+#include "../aof/Aof.hpp"
+#include "../cluster/Cluster.hpp"
 #include "../command-executor/CommandExecutor.hpp"
 #include "Conn.hpp"
 #include "../response/types/ErrResponse.hpp"
+#include "../constants.hpp"
+#include "../pub-sub/PubSub.hpp"
+#include "../replication/Replication.hpp"
 #include "../utils/log.hpp"
+#include "../utils/time_utils.hpp"
+
+void Conn::reset(int fd, bool want_read, bool want_write, bool want_close) {
+    this->fd = fd;
+    this->want_read = want_read;
+    this->want_write = want_write;
+    this->want_close = want_close;
+    incoming.reset();
+    outgoing.reset();
+    idle_timer = IdleTimer();
+    blocked_job = NULL;
+    is_replica = false;
+    asking = false;
+    shared_replies.clear();
+    shared_replies_size = 0;
+    over_soft_limit_since_ms = 0;
+    channels.clear();
+    patterns.clear();
+}
+
+void Conn::add_shared_reply(const std::shared_ptr<const std::string> &reply) {
+    shared_replies.push_back(reply);
+    shared_replies_size += reply->size();
+    want_write = true;
+}
+
+uint64_t Conn::get_output_size() {
+    return outgoing.size() + shared_replies_size;
+}
+
+bool Conn::is_subscribed() {
+    return !channels.empty() || !patterns.empty();
+}
 
 void Conn::handle_send() {
     handle_send_fn(send);
 }
 
 void Conn::handle_send_fn(ssize_t (*send)(int fd, const void *buf, size_t n, int flags)) {
+    // copied in batches so a subscriber far behind doesn't get its whole backlog duplicated in outgoing
+    while (!shared_replies.empty() && outgoing.size() < SHARED_REPLY_BATCH_SIZE) {
+        const std::string &reply = *shared_replies.front();
+        outgoing.append(reply.data(), reply.size());
+        shared_replies_size -= reply.size();
+        shared_replies.pop_front();
+    }
+
     if (!send_data(send)) {
         return;
     }
 
-    if (outgoing.size() == 0) {
-        // nothing left to send for connection, change state from write to read 
-        want_read = true;
+    if (outgoing.size() == 0 && shared_replies.empty()) {
+        // nothing left to send for connection, change state from write to read unless a command is still running
+        want_read = blocked_job == NULL;
         want_write = false;
+
+        // connection is idle until the next request, don't hold on to buffer memory in the meantime
+        outgoing.release();
+        incoming.release();
     }
 }
 
@@ -37,39 +87,106 @@ bool Conn::send_data(ssize_t (*send)(int fd, const void *buf, size_t n, int flag
     return true;
 }
 
-void Conn::handle_recv(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool) {
-    handle_recv_fn(kv_store, timers, thread_pool, recv, send);
+void Conn::handle_recv(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor) {
+    handle_recv_fn(kv_store, timers, thread_pool, evictor, recv, send);
 }
 
-void Conn::handle_recv_fn(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, ssize_t (*recv)(int fd, void *buf, size_t n, int flags), ssize_t (*send)(int fd, const void *buf, size_t n, int flags)) {
+void Conn::handle_recv_fn(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor, ssize_t (*recv)(int fd, void *buf, size_t n, int flags), ssize_t (*send)(int fd, const void *buf, size_t n, int flags)) {
     if (!recv_data(recv)) {
         return;
     }
 
-    CommandExecutor cmd_executor(&kv_store, &timers, &thread_pool);
-    while (Request *request = parse_request()) {
-        log("connection %d request: %s", fd, request->to_string().data());
+    process_requests(kv_store, timers, thread_pool, evictor, send);
+}
 
-        std::unique_ptr<Response> response = cmd_executor.execute(request->get_cmd());
-        if (response->marshal(outgoing) == Response::MarshalStatus::RES_TOO_BIG) {
-            log("response to connection %d exceeds the size limit", fd);
+void Conn::handle_job_finished(Response &response, HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, 
+                               Evictor &evictor) {
+    handle_job_finished_fn(response, kv_store, timers, thread_pool, evictor, send);
+}
 
-            ErrResponse err(ErrResponse::ErrorCode::ERR_TOO_BIG, "response is too big");
-            err.marshal(outgoing);
-            want_close = true;
+void Conn::handle_job_finished_fn(Response &response, HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, 
+                                  Evictor &evictor, ssize_t (*send)(int fd, const void *buf, size_t n, int flags)) {
+    log("connection %d background command finished", fd);
+    blocked_job = NULL;
+    if (!add_response(response)) {
+        return;
+    }
 
-            return;
+    process_requests(kv_store, timers, thread_pool, evictor, send);
+}
+
+bool Conn::add_response(Response &response) {
+    if (!shared_replies.empty()) {
+        // outgoing is sent before the shared replies, so the response has to queue behind them
+        Buffer buf;
+        if (response.marshal(buf) != Response::MarshalStatus::RES_TOO_BIG) {
+            add_shared_reply(std::make_shared<const std::string>(buf.data(), buf.size()));
+            return true;
+        }
+    }
+
+    if (response.marshal(outgoing) == Response::MarshalStatus::RES_TOO_BIG) {
+        log("response to connection %d exceeds the size limit", fd);
+
+        ErrResponse err(ErrResponse::ErrorCode::ERR_TOO_BIG, "response is too big");
+        err.marshal(outgoing);
+        want_close = true;
+
+        return false;
+    }
+
+    return true;
+}
+
+void Conn::process_requests(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor, 
+                            ssize_t (*send)(int fd, const void *buf, size_t n, int flags)) {
+    CommandExecutor cmd_executor(&kv_store, &timers, &thread_pool, &evictor);
+    while (blocked_job == NULL) {
+        Request *request = parse_request();
+        if (request == NULL) {
+            break;
         }
+        log("connection %d request: %s", fd, request->to_string().data());
 
+        if (Replication::shared().handle_command(this, request->get_cmd(), kv_store)) {
+            delete request;
+            continue;
+        }
+
+        time_t start_us = TRACK_LATENCY ? get_time_us() : 0;
+        std::unique_ptr<Response> response = PubSub::shared().handle_command(this, request->get_cmd());
+        if (response == nullptr) {
+            response = Cluster::shared().route(this, request->get_cmd(), kv_store);
+        }
+        if (response == nullptr) {
+            response = cmd_executor.execute(request->get_cmd());
+        }
+        if (TRACK_LATENCY) {
+            log("connection %d request took %ld us", fd, get_time_us() - start_us);
+        }
         delete request;
+
+        if (response == nullptr) {
+            // command was handed off, hold the remaining requests until it finishes
+            blocked_job = cmd_executor.take_deferred_job();
+            blocked_job->conn = this;
+            BackgroundJobs::shared().submit(blocked_job, thread_pool);
+            want_read = false;
+            log("connection %d blocked on background command", fd);
+        } else if (!add_response(*response)) {
+            return;
+        }
     }
 
-    if (outgoing.size() > 0) {
-        // something to send for connection, change state from read to write
-        want_read = false;
+    if (outgoing.size() > 0 || !shared_replies.empty()) {
+        // something to send for connection, change state from read to write. A replica is streamed to continuously, 
+        // so keep reading its acks meanwhile
+        want_read = is_replica;
         want_write = true;
-        handle_send_fn(send); // The socket is likely ready to write in a request-response protocol, try to write it 
-                              // without waiting for the next iteration
+        if (!Aof::shared().holds_replies()) {
+            handle_send_fn(send); // The socket is likely ready to write in a request-response protocol, try to write 
+                                  // it without waiting for the next iteration
+        }
     }
 }
 
@@ -117,7 +234,15 @@ Request *Conn::parse_request() {
 
 void Conn::handle_close(std::vector<Conn *> &fd_to_conn, TimerManager *timers) {
     close(fd);
+    if (blocked_job != NULL) {
+        blocked_job->conn = NULL; // the job still has to finish, but nobody is waiting for its response
+        blocked_job = NULL;
+    }
     idle_timer.clear_expiry(timers);
+    if (is_replica) {
+        Replication::shared().remove_replica(this);
+    }
+    PubSub::shared().unsubscribe_all(this);
     fd_to_conn[fd] = NULL;
 
     log("closed connection %d", fd);
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+#include "../background-jobs/BackgroundJobs.hpp"
 #include "../buffer/Buffer.hpp"
+#include "../evictor/Evictor.hpp"
 #include "../hashmap/HMap.hpp"
-#include "../min-heap/MinHeap.hpp"
 #include "../request/Request.hpp"
 #include "../timers/IdleTimer.hpp"
 #include "../thread-pool/ThreadPool.hpp"
@@ -22,13 +28,54 @@ class Conn {
 
         IdleTimer idle_timer; // if expiry time reached, connection has been idle for too long
 
+        BackgroundJob *blocked_job = NULL; // job running the connection's current command, if any. Later requests wait 
+                                           // for it so responses stay in order
+
+        bool is_replica = false; // whether the peer is a replica being streamed the write commands
+
+        bool asking = false; // whether the next command may be served for a slot this node is importing
+
+        std::deque<std::shared_ptr<const std::string>> shared_replies; // replies marshalled once for many connections 
+                                                                       // (published messages), sent after outgoing
+        uint64_t shared_replies_size = 0; // bytes in shared_replies
+        time_t over_soft_limit_since_ms = 0; // when its output went over the pub/sub soft limit, 0 if it's under
+
+        std::unordered_set<std::string> channels; // channels it's subscribed to
+        std::unordered_set<std::string> patterns; // patterns it's subscribed to
+
         Conn(int fd, bool want_read, bool want_write, bool want_close) : fd(fd), want_read(want_read), want_write(want_write), want_close(want_close) {};
+
+        /**
+         * Re-initializes a closed Conn so it can be re-used for a new connection.
+         * 
+         * @param fd            The connection's socket.
+         * @param want_read     Whether the connection wants to read.
+         * @param want_write    Whether the connection wants to write.
+         * @param want_close    Whether the connection wants to close.
+         */
+        void reset(int fd, bool want_read, bool want_write, bool want_close);
+
+        /**
+         * Queues a reply shared with other connections, e.g. a published message. It's sent after everything queued 
+         * before it, without being copied until it's about to be sent.
+         * 
+         * @param reply Reference to the marshalled reply.
+         */
+        void add_shared_reply(const std::shared_ptr<const std::string> &reply);
+
+        /* Returns the number of bytes queued on the connection and not yet sent */
+        uint64_t get_output_size();
+
+        /* Returns whether the connection is subscribed to any channel or pattern */
+        bool is_subscribed();
                
         /**
          * Handles when data is ready to be sent over the connection. 
          * 
-         * Sends data in the outgoing buffer over the socket, removing it from the buffer afterwards. The connection's 
-         * intention is also switched to "read" if there is no more data in the outgoing buffer.
+         * Sends data in the outgoing buffer over the socket, removing it from the buffer afterwards. Shared replies are 
+         * copied into the outgoing buffer a batch at a time as it drains. The connection's intention is also switched 
+         * to "read" if there is nothing left to send, and the connection's buffers are returned to the BufferPool until 
+         * it has data again.
          * 
          * If something goes wrong while sending the data, returns early. 
          */
@@ -37,7 +84,7 @@ class Conn {
         /**
          * Handles when data is ready to be received on the connection.
          * 
-         * Receives data on the socket, saving it to the incoming buffer. While requests can be parsed from the incoming
+         * Receives data on the socket, saving it to the incoming buffer. While requests can be parsed from the incoming 
          * buffer, exceutes the commands contained in the requests. Lastly, switches the connection's intention to 
          * "write" if there is data in the outgoing buffer to prevent the connection from always reading.
          * 
@@ -46,20 +93,38 @@ class Conn {
          * @param kv_store      Reference to the kv store.
          * @param timers        Reference to the timer manager.
          * @param thread_pool   Reference to the thread pool used for asynchronous work.
+         * @param evictor       Reference to the evictor.
+         */
+        void handle_recv(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor);
+
+        /**
+         * Handles when the BackgroundJob the connection is blocked on has finished.
+         * 
+         * Adds the job's response to the outgoing buffer, then executes the requests that were waiting on the job and 
+         * tries to send the responses.
+         * 
+         * @param response      Reference to the job's response.
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool used for asynchronous work.
+         * @param evictor       Reference to the evictor.
          */
-        void handle_recv(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool);
+        void handle_job_finished(Response &response, HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, 
+                                 Evictor &evictor);
 
         /**
          * Handles when the connection should be closed.
          * 
          * Closes the socket, clears the idle timer for the connection, and the connection itself from the map of all 
-         * active connections.
+         * active connections. The Conn itself is not deallocated; the caller should return it to the ConnPool.
          * 
          * @param fd_to_conn    Reference to the map of all active connections, indexed by fd.
          * @param timers        Pointer to the timer manager.
          */
         void handle_close(std::vector<Conn *> &fd_to_conn, TimerManager *timers);
     private:
+        static const uint32_t SHARED_REPLY_BATCH_SIZE = 64 * 1024; // bytes of shared replies copied to outgoing at once
+
         /**
          * Sends data over the connection, removing it from the outgoing buffer afterwards.
          * 
@@ -94,6 +159,33 @@ class Conn {
          *          NULL if request cannot be parsed.
          */
         Request *parse_request();
+
+        /**
+         * Adds a response to the outgoing buffer, or behind the shared replies if any are queued so it keeps its order.
+         * 
+         * If the response exceeds the size limit, an error is added instead and the connection's intention is set to 
+         * "close".
+         * 
+         * @param response  Reference to the response.
+         * 
+         * @return  True if the response was added.
+         *          False if it exceeds the size limit.
+         */
+        bool add_response(Response &response);
+
+        /**
+         * While requests can be parsed from the incoming buffer, executes the commands contained in them. Stops early if 
+         * a command is handed off to a BackgroundJob, in which case the job is submitted and the connection blocks on 
+         * it. Lastly, switches the connection's intention to "write" if there is data in the outgoing buffer.
+         * 
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool used for asynchronous work.
+         * @param evictor       Reference to the evictor.
+         * @param send          Function to use for sending data over the socket.
+         */
+        void process_requests(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor, 
+                              ssize_t (*send)(int fd, const void *buf, size_t n, int flags));
     
     #ifdef TEST_MODE
     public:      
@@ -119,8 +211,25 @@ class Conn {
          * @param kv_store      Reference to the kv store.
          * @param timers        Reference to the timer manager.
          * @param thread_pool   Reference to the thread pool used for asynchronous work.
+         * @param evictor       Reference to the evictor.
          * @param recv          Function to use for receiving data over the socket.
          * @param send          Function to use for sending data over the socket.
          */
-        void handle_recv_fn(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, ssize_t (*recv)(int fd, void *buf, size_t n, int flags), ssize_t (*send)(int fd, const void *buf, size_t n, int flags));
+        void handle_recv_fn(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor, ssize_t (*recv)(int fd, void *buf, size_t n, int flags), ssize_t (*send)(int fd, const void *buf, size_t n, int flags));
+
+        /**
+         * Logic for handle_job_finished().
+         * 
+         * In addition to the parameters for handle_job_finished(), accepts a function for sending data over the 
+         * socket. This allows the send to be mocked which improves testability.
+         * 
+         * @param response      Reference to the job's response.
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool used for asynchronous work.
+         * @param evictor       Reference to the evictor.
+         * @param send          Function to use for sending data over the socket.
+         */
+        void handle_job_finished_fn(Response &response, HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, 
+                                    Evictor &evictor, ssize_t (*send)(int fd, const void *buf, size_t n, int flags));
 };
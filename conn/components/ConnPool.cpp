@@ -0,0 +1,34 @@
+#include "ConnPool.hpp"
+#include "../Conn.hpp"
+
+ConnPool::~ConnPool() {
+    for (Conn *conn : free_conns) {
+        delete conn;
+    }
+}
+
+Conn *ConnPool::acquire(int fd, bool want_read, bool want_write, bool want_close) {
+    if (free_conns.empty()) {
+        return new Conn(fd, want_read, want_write, want_close);
+    }
+
+    Conn *conn = free_conns.back();
+    free_conns.pop_back();
+    conn->reset(fd, want_read, want_write, want_close);
+    return conn;
+}
+
+void ConnPool::release(Conn *conn) {
+    if (free_conns.size() >= MAX_FREE_CONNS) {
+        delete conn;
+        return;
+    }
+
+    conn->incoming.reset();
+    conn->outgoing.reset();
+    free_conns.push_back(conn);
+}
+
+uint32_t ConnPool::size() {
+    return free_conns.size();
+}
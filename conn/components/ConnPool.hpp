@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class Conn;
+
+/**
+ * A free list of Conn objects.
+ * 
+ * Closed connections are returned to the pool and handed out again for new connections instead of being deallocated. 
+ * Pooled connections hold no buffer memory.
+ */
+class ConnPool {
+    public:
+        static const uint32_t MAX_FREE_CONNS = 1024;
+
+        ~ConnPool();
+
+        /**
+         * Gets a Conn from the pool, allocating a new one if the pool is empty.
+         * 
+         * @param fd            The connection's socket.
+         * @param want_read     Whether the connection wants to read.
+         * @param want_write    Whether the connection wants to write.
+         * @param want_close    Whether the connection wants to close.
+         * 
+         * @return  Pointer to the Conn.
+         */
+        Conn *acquire(int fd, bool want_read, bool want_write, bool want_close);
+
+        /**
+         * Returns a closed Conn to the pool. If the pool is full, the Conn is deallocated instead.
+         * 
+         * @param conn  Pointer to the Conn.
+         */
+        void release(Conn *conn);
+
+        /* Returns the number of Conns in the pool */
+        uint32_t size();
+    private:
+        std::vector<Conn *> free_conns;
+};
@@ -0,0 +1,77 @@
+#include <assert.h>
+
+#include "../ConnPool.hpp"
+#include "../../Conn.hpp"
+
+void test_acquire_empty_pool() {
+    ConnPool pool;
+
+    Conn *conn = pool.acquire(10, true, false, false);
+
+    assert(conn->fd == 10);
+    assert(conn->want_read == true);
+    assert(conn->want_write == false);
+    assert(conn->want_close == false);
+    assert(pool.size() == 0);
+
+    delete conn;
+}
+
+void test_release_then_acquire_reuses_conn() {
+    ConnPool pool;
+
+    Conn *conn = pool.acquire(10, true, false, false);
+    conn->want_close = true;
+    conn->incoming.append("test", 4);
+    pool.release(conn);
+
+    assert(pool.size() == 1);
+
+    Conn *new_conn = pool.acquire(11, true, false, false);
+
+    assert(new_conn == conn);
+    assert(new_conn->fd == 11);
+    assert(new_conn->want_close == false);
+    assert(new_conn->incoming.size() == 0);
+    assert(new_conn->outgoing.size() == 0);
+    assert(new_conn->idle_timer.is_expiry_set() == false);
+    assert(pool.size() == 0);
+
+    delete new_conn;
+}
+
+void test_release_frees_buffers() {
+    ConnPool pool;
+
+    Conn *conn = pool.acquire(10, true, false, false);
+    conn->incoming.append("test", 4);
+    conn->outgoing.append("test", 4);
+    pool.release(conn);
+
+    assert(conn->incoming.capacity() == 0);
+    assert(conn->outgoing.capacity() == 0);
+}
+
+void test_release_full_pool() {
+    ConnPool pool;
+
+    std::vector<Conn *> conns;
+    for (uint32_t i = 0; i <= ConnPool::MAX_FREE_CONNS; i++) {
+        conns.push_back(pool.acquire(i, true, false, false));
+    }
+    for (Conn *conn : conns) {
+        pool.release(conn);
+    }
+
+    assert(pool.size() == ConnPool::MAX_FREE_CONNS);
+}
+
+int main() {
+    test_acquire_empty_pool();
+
+    test_release_then_acquire_reuses_conn();
+    test_release_frees_buffers();
+    test_release_full_pool();
+
+    return 0;
+}
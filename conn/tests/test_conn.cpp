@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <cstring>
 #include <cerrno>
+#include <poll.h>
 #include <sys/socket.h>
 
 #include "../Conn.hpp"
@@ -15,6 +16,8 @@
 
 StrResponse test_response("this is a message");
 
+Request test_zunionstore_request({"zunionstore", "dest", "1", "bigset"});
+
 Request test_request1({"set", "name", "tyler"});
 StrResponse test_request1_response("OK");
 
@@ -160,6 +163,37 @@ ssize_t recv_test_handle_recv_multiple_requests(int fd, void *buf, size_t n, int
     return Request::HEADER_SIZE + test_request1.length() + Request::HEADER_SIZE + test_request2.length();
 }
 
+ssize_t send_test_all_data_sent(int fd, const void *buf, size_t n, int flags) {
+    (void) fd;
+    (void) buf;
+    (void) flags;
+
+    return n;
+}
+
+std::string sent_data; // everything "sent" by send_test_record()
+
+ssize_t send_test_record(int fd, const void *buf, size_t n, int flags) {
+    (void) fd;
+    (void) flags;
+
+    sent_data.append((const char *) buf, n);
+    return n;
+}
+
+ssize_t recv_test_handle_recv_background_command(int fd, void *buf, size_t n, int flags) {
+    (void) fd;
+    (void) n;
+    (void) flags;
+
+    Buffer temp;
+    test_zunionstore_request.marshal(temp);
+    test_request1.marshal(temp);
+    memcpy(buf, temp.data(), temp.size());
+
+    return temp.size();
+}
+
 /**
  * Asserts that a key is in the kv store.
  * 
@@ -205,6 +239,7 @@ void test_handle_send_all_data_sent()  {
     conn.handle_send_fn(send_test_handle_send_all_data_sent);
 
     assert(conn.outgoing.size() == 0);
+    assert(conn.outgoing.capacity() == 0); // idle connection holds no buffer memory
     assert(conn.want_read == true);
     assert(conn.want_write == false);
     assert(conn.want_close == false);
@@ -222,13 +257,44 @@ void test_handle_send_some_data_sent()  {
     assert(conn.want_close == false);
 }
 
+void test_handle_send_shared_replies() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(4);
+    Evictor evictor;
+    Conn conn(10, true, false, false);
+    test_response.marshal(conn.outgoing);
+    std::shared_ptr<const std::string> shared = std::make_shared<const std::string>("shared reply");
+    conn.add_shared_reply(shared);
+    conn.add_shared_reply(shared);
+    assert(conn.want_write == true);
+    assert(conn.get_output_size() == Response::HEADER_SIZE + test_response.length() + 2 * shared->size());
+
+    // the response to a request received now is sent after the shared replies
+    sent_data.clear();
+    conn.handle_recv_fn(kv_store, timers, thread_pool, evictor, recv_test_handle_recv_one_request, send_test_record);
+
+    Buffer expected;
+    test_response.marshal(expected);
+    expected.append(shared->data(), shared->size());
+    expected.append(shared->data(), shared->size());
+    test_request1_response.marshal(expected);
+    assert(sent_data == std::string(expected.data(), expected.size()));
+    assert(conn.shared_replies.empty());
+    assert(conn.get_output_size() == 0);
+    assert(shared.use_count() == 1); // the connection let go of it once sent
+    assert(conn.want_read == true);
+    assert(conn.want_write == false);
+}
+
 void test_handle_recv_socket_not_ready() {
     HMap kv_store;
     TimerManager timers;
     ThreadPool thread_pool(4);
+    Evictor evictor;
     Conn conn(10, true, false, false);
 
-    conn.handle_recv_fn(kv_store, timers, thread_pool, recv_test_handle_recv_socket_not_ready, send);
+    conn.handle_recv_fn(kv_store, timers, thread_pool, evictor, recv_test_handle_recv_socket_not_ready, send);
 
     assert(conn.incoming.size() == 0);
     assert(conn.want_read == true);
@@ -240,9 +306,10 @@ void test_handle_recv_unexpected_error() {
     HMap kv_store;
     TimerManager timers;
     ThreadPool thread_pool(4);
+    Evictor evictor;
     Conn conn(10, true, false, false);
 
-    conn.handle_recv_fn(kv_store, timers, thread_pool, recv_test_handle_recv_unexpected_error, send);
+    conn.handle_recv_fn(kv_store, timers, thread_pool, evictor, recv_test_handle_recv_unexpected_error, send);
 
     assert(conn.incoming.size() == 0);
     assert(conn.want_read == true);
@@ -254,9 +321,10 @@ void test_handle_recv_peer_terminated_connection() {
     HMap kv_store;
     TimerManager timers;
     ThreadPool thread_pool(4);
+    Evictor evictor;
     Conn conn(10, true, false, false);
 
-    conn.handle_recv_fn(kv_store, timers, thread_pool, recv_test_handle_recv_peer_terminated_connection, send);
+    conn.handle_recv_fn(kv_store, timers, thread_pool, evictor, recv_test_handle_recv_peer_terminated_connection, send);
 
     assert(conn.incoming.size() == 0);
     assert(conn.want_read == true);
@@ -268,9 +336,10 @@ void test_handle_recv_request_too_big() {
     HMap kv_store;
     TimerManager timers;
     ThreadPool thread_pool(4);
+    Evictor evictor;
     Conn conn(10, true, false, false);
 
-    conn.handle_recv_fn(kv_store, timers, thread_pool, recv_test_handle_recv_request_too_big, send);
+    conn.handle_recv_fn(kv_store, timers, thread_pool, evictor, recv_test_handle_recv_request_too_big, send);
 
     assert(conn.incoming.size() == Request::HEADER_SIZE + Request::MAX_LEN + 1);
     assert(conn.want_read == true);
@@ -282,9 +351,10 @@ void test_handle_recv_incomplete_request() {
     HMap kv_store;
     TimerManager timers;
     ThreadPool thread_pool(4);
+    Evictor evictor;
     Conn conn(10, true, false, false);
 
-    conn.handle_recv_fn(kv_store, timers, thread_pool, recv_test_handle_recv_incomplete_request, send);
+    conn.handle_recv_fn(kv_store, timers, thread_pool, evictor, recv_test_handle_recv_incomplete_request, send);
 
     assert(conn.incoming.size() == Request::HEADER_SIZE + test_request1.length() - 10);
     assert(conn.want_read == true);
@@ -296,9 +366,10 @@ void test_handle_recv_one_request() {
     HMap kv_store;
     TimerManager timers;
     ThreadPool thread_pool(4);
+    Evictor evictor;
     Conn conn(10, true, false, false);
 
-    conn.handle_recv_fn(kv_store, timers, thread_pool, recv_test_handle_recv_one_request, send_test_handle_recv_one_request);
+    conn.handle_recv_fn(kv_store, timers, thread_pool, evictor, recv_test_handle_recv_one_request, send_test_handle_recv_one_request);
 
     assert(conn.incoming.size() == 0);
     assert(conn.outgoing.size() == 0); // response sent
@@ -312,9 +383,10 @@ void test_handle_recv_multiple_requests() {
     HMap kv_store;
     TimerManager timers;
     ThreadPool thread_pool(4);
+    Evictor evictor;
     Conn conn(10, true, false, false);
 
-    conn.handle_recv_fn(kv_store, timers, thread_pool, recv_test_handle_recv_multiple_requests, send_test_handle_recv_multiple_requests);
+    conn.handle_recv_fn(kv_store, timers, thread_pool, evictor, recv_test_handle_recv_multiple_requests, send_test_handle_recv_multiple_requests);
 
     assert(conn.incoming.size() == 0);
     assert(conn.outgoing.size() == 0); // responses sent
@@ -324,6 +396,50 @@ void test_handle_recv_multiple_requests() {
     assert_key_in_store("name", kv_store);
 }
 
+void test_handle_recv_background_command() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(4);
+    Evictor evictor;
+    Conn conn(10, true, false, false);
+
+    Entry *entry = new Entry();
+    entry->key = "bigset";
+    entry->type = EntryType::SORTED_SET;
+    entry->node.hval = str_hash(entry->key);
+    for (uint32_t i = 0; i < LARGE_ZSET_SIZE; i++) {
+        std::string name = std::to_string(i);
+        entry->zset.insert(i, name.data(), name.length());
+    }
+    kv_store.insert(&entry->node);
+
+    // the zunionstore is handed off, and the set after it waits so the responses stay in order
+    conn.handle_recv_fn(kv_store, timers, thread_pool, evictor, recv_test_handle_recv_background_command, send_test_all_data_sent);
+
+    assert(conn.blocked_job != NULL);
+    assert(conn.incoming.size() == Request::HEADER_SIZE + test_request1.length());
+    assert(conn.outgoing.size() == 0);
+    assert(conn.want_read == false);
+    assert(conn.want_write == false);
+
+    struct pollfd pfd = { BackgroundJobs::shared().get_fd(), POLLIN, 0 };
+    assert(poll(&pfd, 1, 5000) == 1);
+    std::vector<BackgroundJob *> finished = BackgroundJobs::shared().take_finished();
+    assert(finished.size() == 1 && finished[0]->conn == &conn);
+
+    std::unique_ptr<Response> response = finished[0]->finish(kv_store, timers, thread_pool, evictor);
+    delete finished[0];
+    conn.handle_job_finished_fn(*response, kv_store, timers, thread_pool, evictor, send_test_all_data_sent);
+
+    assert(conn.blocked_job == NULL);
+    assert(conn.incoming.size() == 0);
+    assert(conn.outgoing.size() == 0); // both responses sent
+    assert(conn.want_read == true);
+    assert(conn.want_write == false);
+    assert_key_in_store("dest", kv_store);
+    assert_key_in_store("name", kv_store);
+}
+
 void test_handle_close() {
     Conn conn(10, true, false, false);
     std::vector<Conn *> fd_to_conn(conn.fd + 1);
@@ -342,6 +458,7 @@ int main() {
     test_handle_send_unexpected_error();
     test_handle_send_all_data_sent();
     test_handle_send_some_data_sent();
+    test_handle_send_shared_replies();
 
     test_handle_recv_socket_not_ready();
     test_handle_recv_unexpected_error();
@@ -350,6 +467,7 @@ int main() {
     test_handle_recv_incomplete_request();
     test_handle_recv_one_request();
     test_handle_recv_multiple_requests();
+    test_handle_recv_background_command();
 
     test_handle_close();
     
@@ -2,3 +2,7 @@
 
 const char *PORT = "8000";
 const bool DEBUG = false;
+const bool TRACK_LATENCY = false; // logs how long each command takes using the high-resolution clock
+const bool USE_HUGE_PAGES = false; // backs the slab allocator's arenas with transparent huge pages
+const bool ACTIVE_DEFRAG = true; // moves kv store entries out of sparse slabs when fragmentation is high
+const bool APPEND_ONLY = false; // logs writes to the append-only file, which is replayed at startup instead of the snapshot
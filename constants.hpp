@@ -2,3 +2,7 @@
 
 extern const char *PORT;
 extern const bool DEBUG;
+extern const bool TRACK_LATENCY;
+extern const bool USE_HUGE_PAGES;
+extern const bool ACTIVE_DEFRAG;
+extern const bool APPEND_ONLY;
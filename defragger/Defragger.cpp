@@ -0,0 +1,135 @@
+#include <utility>
+
+#include "Defragger.hpp"
+#include "../cluster/Cluster.hpp"
+#include "../utils/hash_utils.hpp"
+#include "../utils/intrusive_data_structure_utils.hpp"
+#include "../utils/log.hpp"
+#include "../utils/time_utils.hpp"
+
+/* Argument for the defrag_entry() callback */
+struct DefragEntryArg {
+    Defragger *defragger;
+    TimerManager *timers;
+};
+
+Defragger::Defragger(uint32_t threshold_percent, uint64_t ignore_bytes) :
+    threshold_percent(threshold_percent), ignore_bytes(ignore_bytes) {}
+
+void Defragger::run(HMap &kv_store, TimerManager &timers) {
+    if (!stats.running) {
+        time_t now_ms = get_cached_time_ms();
+        if (now_ms - last_check_ms < CHECK_INTERVAL_MS) {
+            return;
+        }
+        last_check_ms = now_ms;
+
+        if (!should_start(SlabAllocator::shared().get_stats())) {
+            return;
+        }
+        log("active defrag started");
+        stats.running = true;
+        cursor = 0;
+    }
+
+    time_t start_us = get_time_us();
+    DefragEntryArg arg = { this, &timers };
+    uint32_t steps = 0;
+    while (true) {
+        if (!large_zsets.empty()) {
+            defrag_large_zset(kv_store);
+        } else {
+            cursor = kv_store.scan(cursor, defrag_entry, &arg);
+            if (cursor == 0) {
+                log("active defrag finished a pass");
+                stats.running = false;
+                stats.passes++;
+                break;
+            }
+        }
+
+        if (++steps % DEFRAG_TIME_CHECK_INTERVAL == 0 && (uint64_t) (get_time_us() - start_us) >= DEFRAG_BUDGET_US) {
+            break;
+        }
+    }
+
+    stats.cycle_us = get_time_us() - start_us;
+}
+
+const DefragStats &Defragger::get_stats() {
+    return stats;
+}
+
+bool Defragger::should_start(const SlabStats &slab_stats) {
+    uint64_t wasted = slab_stats.slab_bytes - slab_stats.used_bytes;
+    return wasted > ignore_bytes && wasted * 100 > slab_stats.slab_bytes * threshold_percent;
+}
+
+void Defragger::defrag_large_zset(HMap &kv_store) {
+    // look the key up again since the sorted set may have been deleted or replaced since the last step
+    LookupEntry lookup_entry;
+    lookup_entry.key = large_zsets.back();
+    lookup_entry.node.hval = str_hash(lookup_entry.key);
+    HNode *node = kv_store.lookup(&lookup_entry.node, are_entries_equal);
+    Entry *entry = node != NULL ? container_of(node, Entry, node) : NULL;
+
+    if (entry != NULL && entry->type == EntryType::SORTED_SET) {
+        zset_cursor = entry->zset.defrag(zset_cursor, &stats.moved);
+    } else {
+        zset_cursor = 0;
+    }
+
+    if (zset_cursor == 0) {
+        large_zsets.pop_back();
+    }
+}
+
+void Defragger::defrag_entry(HNode **from, void *arg) {
+    DefragEntryArg *defrag_arg = (DefragEntryArg *) arg;
+    Defragger *defragger = defrag_arg->defragger;
+    DefragStats &stats = defragger->stats;
+    SlabAllocator &allocator = SlabAllocator::shared();
+
+    stats.scanned++;
+    Entry *entry = container_of(*from, Entry, node);
+
+    if (allocator.defrag_hint(entry, sizeof(Entry))) {
+        Entry *moved = new Entry();
+        moved->node = entry->node;
+        moved->key = std::move(entry->key);
+        moved->type = entry->type;
+        moved->str = std::move(entry->str);
+        moved->zset.swap(entry->zset);
+        defrag_arg->timers->replace(&entry->ttl_timer, &moved->ttl_timer);
+        Cluster::shared().move_key(entry, moved);
+        moved->access = entry->access;
+        moved->memory = entry->memory;
+
+        *from = &moved->node;
+        delete entry;
+        entry = moved;
+        stats.moved++;
+    }
+
+    // short strings are stored inside the Entry, only long ones have a buffer of their own
+    const char *str_data = entry->str.data();
+    bool is_str_inline = str_data >= (const char *) &entry->str && str_data < (const char *) (&entry->str + 1);
+    if (!is_str_inline && allocator.defrag_hint((void *) str_data, entry->str.capacity() + 1)) {
+        SlabString moved;
+        moved.reserve(entry->str.capacity());
+        moved.assign(entry->str);
+        entry->str.swap(moved);
+        stats.moved++;
+    }
+
+    if (entry->type == EntryType::SORTED_SET) {
+        if (entry->zset.length() <= MAX_INLINE_ZSET_SIZE) {
+            uint64_t zset_cursor = 0;
+            do {
+                zset_cursor = entry->zset.defrag(zset_cursor, &stats.moved);
+            } while (zset_cursor != 0);
+        } else {
+            defragger->large_zsets.push_back(entry->key);
+        }
+    }
+}
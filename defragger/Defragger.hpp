@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../entry/Entry.hpp"
+#include "../hashmap/HMap.hpp"
+#include "../slab-allocator/SlabAllocator.hpp"
+#include "../timers/TimerManager.hpp"
+
+/* Stats for active defragmentation */
+struct DefragStats {
+    bool running = false; // whether a pass over the kv store is in progress
+    uint64_t scanned = 0; // entries visited
+    uint64_t moved = 0; // entries, sorted set pairs, and string values moved out of sparse slabs
+    uint64_t passes = 0; // completed passes over the kv store
+    uint64_t cycle_us = 0; // time spent in the last cycle
+};
+
+/**
+ * Reduces fragmentation in the slab allocator by moving long-lived kv store allocations out of sparse slabs, so the 
+ * slabs can be emptied and reused.
+ * 
+ * Runs incrementally from the event loop. Once fragmentation goes over the thresholds, each cycle scans a few slots of 
+ * the kv store within a time budget, moving entries, their string values, and the pairs of their sorted sets wherever 
+ * the slab allocator suggests and fixing up the intrusive links (hash map chains, B+tree, timing wheel) that point 
+ * to them.
+ */
+class Defragger {
+    private:
+        static const uint32_t CHECK_INTERVAL_MS = 100; // how often fragmentation is checked while idle
+        static const uint32_t DEFRAG_BUDGET_US = 1000; // time budget for a cycle
+        static const uint8_t DEFRAG_TIME_CHECK_INTERVAL = 16; // slots scanned between checks of the time budget
+        static const uint32_t MAX_INLINE_ZSET_SIZE = 128; // bigger sorted sets are defragmented over several steps
+
+        uint32_t threshold_percent;
+        uint64_t ignore_bytes;
+        time_t last_check_ms = 0;
+        uint64_t cursor = 0; // next kv store slot to scan
+        std::vector<std::string> large_zsets; // keys of large sorted sets waiting to be defragmented
+        uint64_t zset_cursor = 0; // next slot to scan in the last sorted set in large_zsets
+        DefragStats stats;
+
+        /**
+         * Checks if fragmentation is over the thresholds.
+         * 
+         * @param slab_stats    The slab allocator's stats.
+         * 
+         * @return  True if a pass should be started.
+         *          False otherwise.
+         */
+        bool should_start(const SlabStats &slab_stats);
+
+        /**
+         * Defragments the next few slots of the large sorted set being worked on.
+         * 
+         * @param kv_store  Reference to the kv store.
+         */
+        void defrag_large_zset(HMap &kv_store);
+
+        /**
+         * Callback which defragments an Entry in the kv store.
+         * 
+         * @param from  The address of the pointer to the Entry's HNode in the kv store.
+         * @param arg   Void pointer to a DefragEntryArg.
+         */
+        static void defrag_entry(HNode **from, void *arg);
+    public:
+        static const uint32_t CYCLE_INTERVAL_MS = 1; // max time between cycles while a pass is in progress
+        static const uint32_t DEFAULT_THRESHOLD_PERCENT = 10;
+        static const uint64_t DEFAULT_IGNORE_BYTES = 100 * 1024 * 1024; // 100 MB
+
+        /**
+         * Initializes a Defragger.
+         * 
+         * @param threshold_percent Percentage of slab memory that has to be wasted before defragmentation starts.
+         * @param ignore_bytes      Amount of slab memory that has to be wasted before defragmentation starts.
+         */
+        Defragger(uint32_t threshold_percent = DEFAULT_THRESHOLD_PERCENT, uint64_t ignore_bytes = DEFAULT_IGNORE_BYTES);
+
+        /**
+         * Runs a defragmentation cycle.
+         * 
+         * While no pass is in progress, fragmentation is checked every CHECK_INTERVAL_MS and a pass is started once it 
+         * is over both thresholds. A pass is worked through over as many cycles as it takes.
+         * 
+         * @param kv_store  Reference to the kv store.
+         * @param timers    Reference to the timer manager.
+         */
+        void run(HMap &kv_store, TimerManager &timers);
+
+        /* Returns the defragmentation stats */
+        const DefragStats &get_stats();
+};
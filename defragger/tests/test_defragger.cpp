@@ -0,0 +1,172 @@
+#define TEST_MODE
+
+#include <assert.h>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+#include "../Defragger.hpp"
+#include "../../timers/TTLTimer.hpp"
+#include "../../utils/hash_utils.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+
+/**
+ * Creates an Entry and inserts it into the kv store.
+ *
+ * @param key       The key of the Entry.
+ * @param type      The type of the Entry. String Entries get a value too long to be stored inside the Entry.
+ * @param kv_store  Reference to the kv store.
+ *
+ * @return  Pointer to the Entry.
+ */
+Entry *create_entry(const std::string &key, EntryType type, HMap &kv_store) {
+    Entry *entry = new Entry();
+    entry->key = key;
+    entry->type = type;
+    if (type == EntryType::STR) {
+        entry->str.assign(64, key.back());
+    }
+    entry->node.hval = str_hash(key);
+    kv_store.insert(&entry->node);
+    return entry;
+}
+
+/* Looks up the Entry with the given key in the kv store */
+Entry *lookup(const std::string &key, HMap &kv_store) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = key;
+    lookup_entry.node.hval = str_hash(key);
+    HNode *node = kv_store.lookup(&lookup_entry.node, are_entries_equal);
+    return node != NULL ? container_of(node, Entry, node) : NULL;
+}
+
+/* Returns the resident set size of the process in bytes */
+uint64_t get_rss() {
+    FILE *file = fopen("/proc/self/statm", "r");
+    assert(file != NULL);
+    uint64_t size, resident;
+    assert(fscanf(file, "%lu %lu", &size, &resident) == 2);
+    fclose(file);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/* Deletes all Entries in the kv store */
+void clear_store(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool) {
+    std::vector<Entry *> entries;
+    kv_store.for_each([](HNode *node, void *arg) {
+        ((std::vector<Entry *> *) arg)->push_back(container_of(node, Entry, node));
+    }, &entries);
+    for (Entry *entry : entries) {
+        kv_store.remove(&entry->node, are_entries_equal);
+        delete_entry(entry, &timers, &thread_pool);
+    }
+}
+
+/* Runs the defragger until it finishes a pass */
+void run_pass(Defragger &defragger, HMap &kv_store, TimerManager &timers) {
+    uint64_t passes = defragger.get_stats().passes;
+    while (defragger.get_stats().passes == passes) {
+        defragger.run(kv_store, timers);
+    }
+}
+
+void test_does_not_start_under_threshold() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Defragger defragger(0, UINT64_MAX);
+
+    create_entry("key", EntryType::STR, kv_store);
+    defragger.run(kv_store, timers);
+
+    assert(defragger.get_stats().running == false);
+    assert(defragger.get_stats().scanned == 0);
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_pass_keeps_entries_intact() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Defragger defragger(0, 0);
+
+    // sorted set pairs interleave with the entries' allocations, one small and one large sorted set
+    Entry *small_zset = create_entry("small", EntryType::SORTED_SET, kv_store);
+    Entry *large_zset = create_entry("large", EntryType::SORTED_SET, kv_store);
+    for (uint32_t i = 0; i < 4000; i++) {
+        std::string key = "key" + std::to_string(i);
+        Entry *entry = create_entry(key, EntryType::STR, kv_store);
+        if (i % 2 == 0) {
+            entry->ttl_timer.set_expiry(100, &timers);
+        }
+        std::string name = "name" + std::to_string(i);
+        (i % 8 == 0 ? small_zset : large_zset)->zset.insert(i, name.data(), name.length());
+    }
+
+    // delete most of the first half so its slabs are left sparse
+    for (uint32_t i = 0; i < 2000; i++) {
+        if (i % 4 != 0) {
+            std::string key = "key" + std::to_string(i);
+            Entry *entry = lookup(key, kv_store);
+            kv_store.remove(&entry->node, are_entries_equal);
+            delete_entry(entry, &timers, &thread_pool);
+        }
+    }
+    SlabStats before = SlabAllocator::shared().get_stats();
+    uint64_t rss_before = get_rss();
+
+    run_pass(defragger, kv_store, timers);
+
+    DefragStats stats = defragger.get_stats();
+    assert(stats.running == false);
+    assert(stats.scanned == kv_store.length());
+    assert(stats.moved > 0);
+    SlabStats after = SlabAllocator::shared().get_stats();
+    assert(after.slab_bytes < before.slab_bytes);
+    assert(after.released_bytes - before.released_bytes == before.slab_bytes - after.slab_bytes);
+    assert(get_rss() < rss_before); // the pass allocates too, so only check that the process shrank
+
+    uint32_t num_ttls = 0;
+    for (uint32_t i = 0; i < 4000; i++) {
+        std::string key = "key" + std::to_string(i);
+        Entry *entry = lookup(key, kv_store);
+        if (i < 2000 && i % 4 != 0) {
+            assert(entry == NULL);
+            continue;
+        }
+        assert(entry != NULL);
+        assert(entry->str == SlabString(64, key.back()));
+        if (i % 2 == 0) {
+            assert(entry->ttl_timer.expiry_time_ms != TTLTimer::UNSET);
+            num_ttls++;
+        } else {
+            assert(entry->ttl_timer.expiry_time_ms == TTLTimer::UNSET);
+        }
+    }
+    assert(timers.get_ttl_timers()->length() == num_ttls);
+
+    small_zset = lookup("small", kv_store);
+    large_zset = lookup("large", kv_store);
+    assert(small_zset->zset.length() == 500);
+    assert(large_zset->zset.length() == 3500);
+    int64_t small_rank = 0;
+    int64_t large_rank = 0;
+    for (uint32_t i = 0; i < 4000; i++) {
+        std::string name = "name" + std::to_string(i);
+        SortedSet &zset = (i % 8 == 0 ? small_zset : large_zset)->zset;
+        double score = -1;
+        zset.lookup(name.data(), name.length(), &score);
+        assert(score == i);
+        assert(zset.rank(name.data(), name.length()) == (i % 8 == 0 ? small_rank++ : large_rank++));
+    }
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+int main() {
+    test_does_not_start_under_threshold();
+    test_pass_keeps_entries_intact();
+
+    return 0;
+}
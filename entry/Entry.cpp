@@ -1,15 +1,29 @@
 #include "Entry.hpp"
+#include "../cluster/Cluster.hpp"
 #include "../utils/intrusive_data_structure_utils.hpp"
 #include "../utils/log.hpp"
 
 const uint32_t LARGE_ZSET_SIZE = 1000;
 
+static uint64_t used_memory = 0; // total bytes accounted to Entries
+
 bool are_entries_equal(HNode *node1, HNode *node2) {
     Entry *entry1 = container_of(node1, Entry, node);
     Entry *entry2 = container_of(node2, Entry, node);
     return entry1->key == entry2->key;
 }
 
+uint64_t get_used_memory() {
+    return used_memory;
+}
+
+void update_entry_memory(Entry *entry) {
+    uint64_t memory = SlabAllocator::class_size(sizeof(Entry)) + entry->key.capacity() + entry->str.capacity() + 
+                      entry->zset.memory_usage();
+    used_memory = used_memory - entry->memory + memory;
+    entry->memory = memory;
+}
+
 /* Wrapper function to perform Entry delete as a thread pool task */
 void delete_entry_func(void *arg) {
     delete (Entry *) arg;
@@ -17,6 +31,8 @@ void delete_entry_func(void *arg) {
 
 void delete_entry(Entry *entry, TimerManager *timers, ThreadPool *thread_pool) {
     entry->ttl_timer.clear_expiry(timers);
+    Cluster::shared().remove_key(entry);
+    used_memory -= entry->memory;
 
     if (entry->type == EntryType::SORTED_SET) {
         if (entry->zset.length() >= LARGE_ZSET_SIZE) {
@@ -27,3 +43,21 @@ void delete_entry(Entry *entry, TimerManager *timers, ThreadPool *thread_pool) {
     
     delete entry;
 }
+
+/* Wrapper function to perform a delete of removed sorted set pairs as a thread pool task */
+void delete_zset_pairs_func(void *arg) {
+    SortedSet::free_pairs((BPlusTree *) arg);
+}
+
+void delete_zset_pairs(BPlusTree *pairs, ThreadPool *thread_pool) {
+    if (pairs == NULL) {
+        return;
+    }
+
+    if (pairs->length() >= LARGE_ZSET_SIZE) {
+        thread_pool->add_task({ &delete_zset_pairs_func, (void *) pairs });
+        return;
+    }
+
+    SortedSet::free_pairs(pairs);
+}
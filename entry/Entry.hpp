@@ -1,8 +1,9 @@
 #pragma once
 
 #include "../buffer/Buffer.hpp"
+#include "../cluster/components/SlotNode.hpp"
+#include "../slab-allocator/SlabAllocator.hpp"
 #include "../sorted-set/SortedSet.hpp"
-#include "../min-heap/MinHeap.hpp"
 #include "../timers/IdleTimer.hpp"
 #include "../timers/TTLTimer.hpp"
 #include "../thread-pool/ThreadPool.hpp"
@@ -17,16 +18,31 @@ enum EntryType {
  * Entry in the kv store.
  * 
  * The value of the Entry is one of str or zset depending on the type.
+ * 
+ * Entries and the heap buffers of long string values are allocated from the shared SlabAllocator.
  */
 struct Entry {
     HNode node;
     std::string key;
     // type 
     EntryType type;
-    std::string str;
+    SlabString str;
     SortedSet zset;
     // timers
     TTLTimer ttl_timer;
+    // eviction
+    uint32_t access : 24 = 0; // LRU clock or LFU counter of the last access, depending on the eviction policy
+    uint64_t memory = 0; // bytes accounted to the Entry in the used memory total
+    // cluster
+    SlotNode slot_node; // in the list of keys in its hash slot, while cluster mode is on
+
+    static void *operator new(size_t size) {
+        return SlabAllocator::shared().alloc(size);
+    }
+
+    static void operator delete(void *ptr, size_t size) {
+        SlabAllocator::shared().free(ptr, size);
+    }
 };
 
 /* Simplified version of Entry used for look-ups */
@@ -48,14 +64,41 @@ extern const uint32_t LARGE_ZSET_SIZE;
  */
 bool are_entries_equal(HNode *node1, HNode *node2);
 
+/**
+ * Gets the approximate number of bytes used by all Entries in the kv store.
+ * 
+ * @return  The used memory in bytes.
+ */
+uint64_t get_used_memory();
+
+/**
+ * Recomputes the approximate number of bytes used by an Entry and updates the used memory total to match.
+ * 
+ * Must be called after any change to the size of an Entry's key or value.
+ * 
+ * @param entry Pointer to the Entry.
+ */
+void update_entry_memory(Entry *entry);
+
 /**
  * Deletes (deallocates) an Entry.
  * 
  * For sorted set entries with greater th an or equal to LARGE_ZSET_SIZE pairs, the delete will happen asynchronously 
- * using the thread pool workers.
+ * using the thread pool workers. The Entry's memory is removed from the used memory total immediately.
  * 
  * @param entry         Pointer to the Entry to delete.
  * @param timers        Pointer to the timer manager.
  * @param thread_pool   Pointer to the thread pool used for asynchronous work.
  */
 void delete_entry(Entry *entry, TimerManager *timers, ThreadPool *thread_pool);
+
+/**
+ * Deletes (deallocates) the pairs removed from a sorted set by a range removal.
+ * 
+ * Like delete_entry(), the delete happens asynchronously using the thread pool workers when there are greater than or 
+ * equal to LARGE_ZSET_SIZE pairs.
+ * 
+ * @param pairs         Pointer to the BPlusTree holding the removed pairs. May be NULL.
+ * @param thread_pool   Pointer to the thread pool used for asynchronous work.
+ */
+void delete_zset_pairs(BPlusTree *pairs, ThreadPool *thread_pool);
@@ -0,0 +1,240 @@
+#include <cstdlib>
+#include <utility>
+
+#include "Evictor.hpp"
+#include "../aof/Aof.hpp"
+#include "../replication/Replication.hpp"
+#include "../utils/hash_utils.hpp"
+#include "../utils/intrusive_data_structure_utils.hpp"
+#include "../utils/log.hpp"
+#include "../utils/time_utils.hpp"
+
+void Evictor::init_access(Entry *entry) {
+    entry->access = is_lfu() ? (lfu_minutes() << 8) | LFU_INIT_VAL : lru_clock();
+}
+
+void Evictor::touch(Entry *entry) {
+    if (!is_lfu()) {
+        entry->access = lru_clock();
+        return;
+    }
+
+    uint32_t counter = lfu_decayed_counter(entry);
+    if (counter < 255) {
+        uint32_t base = counter > LFU_INIT_VAL ? counter - LFU_INIT_VAL : 0;
+        double p = 1.0 / (base * LFU_LOG_FACTOR + 1);
+        if ((double) rand() / RAND_MAX < p) {
+            counter++;
+        }
+    }
+    entry->access = (lfu_minutes() << 8) | counter;
+}
+
+Evictor::Result Evictor::perform_evictions(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool) {
+    if (maxmemory == 0 || get_used_memory() <= maxmemory) {
+        return Result::OK;
+    }
+
+    if (Replication::shared().is_replica()) {
+        // the primary evicts and sends a del for each key, so a replica's data stays the same as its primary's
+        return Result::OK;
+    }
+
+    if (policy == EvictionPolicy::NOEVICTION) {
+        return Result::FAIL;
+    }
+
+    time_t start_us = get_time_us();
+    uint32_t evicted = 0;
+    while (get_used_memory() > maxmemory) {
+        Entry *entry = select_victim(kv_store);
+        if (entry == NULL) {
+            log("no keys can be evicted under policy '%s'", policy_name(policy));
+            return Result::FAIL;
+        }
+
+        log("evicted key '%s'", entry->key.data());
+        Aof::shared().feed({ "del", entry->key }); // otherwise the key would come back when the AOF is replayed
+        Replication::shared().feed({ "del", entry->key });
+        kv_store.remove(&entry->node, are_entries_equal);
+        delete_entry(entry, &timers, &thread_pool);
+        stats.evicted++;
+        evicted++;
+
+        if (evicted % EVICTION_TIME_CHECK_INTERVAL == 0 && (uint64_t) (get_time_us() - start_us) >= EVICTION_BUDGET_US) {
+            stats.timed_out++;
+            return get_used_memory() > maxmemory ? Result::RUNNING : Result::OK;
+        }
+    }
+
+    return Result::OK;
+}
+
+void Evictor::populate_pool(HMap &kv_store) {
+    HNode *nodes[SAMPLES];
+    uint32_t count = kv_store.sample(nodes, SAMPLES);
+    for (uint32_t i = 0; i < count; i++) {
+        Entry *entry = container_of(nodes[i], Entry, node);
+        if (is_volatile() && !entry->ttl_timer.is_expiry_set()) {
+            continue;
+        }
+        add_to_pool(score(entry), entry->key);
+    }
+}
+
+void Evictor::add_to_pool(uint64_t score, const std::string &key) {
+    uint32_t k = 0;
+    while (k < pool_len && pool[k].score < score) {
+        k++;
+    }
+
+    for (uint32_t i = 0; i < pool_len; i++) {
+        if (pool[i].key == key) {
+            return;
+        }
+    }
+
+    if (pool_len < POOL_SIZE) {
+        // shift better candidates right to make room
+        for (uint32_t i = pool_len; i > k; i--) {
+            pool[i] = std::move(pool[i - 1]);
+        }
+        pool_len++;
+    } else {
+        if (k == 0) {
+            return; // worse than every candidate in a full pool
+        }
+        // drop the worst candidate by shifting worse candidates left
+        k--;
+        for (uint32_t i = 0; i < k; i++) {
+            pool[i] = std::move(pool[i + 1]);
+        }
+    }
+
+    pool[k].score = score;
+    pool[k].key = key;
+}
+
+Entry *Evictor::select_victim(HMap &kv_store) {
+    if (kv_store.length() == 0) {
+        return NULL;
+    }
+
+    for (uint32_t round = 0; round < MAX_SAMPLE_ROUNDS; round++) {
+        populate_pool(kv_store);
+
+        // candidates may have been deleted or changed since they were added, so take the best one that still applies
+        while (pool_len > 0) {
+            PoolEntry &candidate = pool[--pool_len];
+
+            LookupEntry lookup_entry;
+            lookup_entry.key = std::move(candidate.key);
+            lookup_entry.node.hval = str_hash(lookup_entry.key);
+            HNode *node = kv_store.lookup(&lookup_entry.node, are_entries_equal);
+            if (node == NULL) {
+                continue;
+            }
+
+            Entry *entry = container_of(node, Entry, node);
+            if (is_volatile() && !entry->ttl_timer.is_expiry_set()) {
+                continue;
+            }
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+uint64_t Evictor::score(Entry *entry) {
+    switch (policy) {
+        case EvictionPolicy::ALLKEYS_LFU:
+            return 255 - lfu_decayed_counter(entry);
+        case EvictionPolicy::VOLATILE_TTL:
+            return UINT64_MAX - entry->ttl_timer.expiry_time_ms;
+        default: {
+            // idle time, accounting for the clock wrapping around
+            uint32_t clock = lru_clock();
+            return clock >= entry->access ? clock - entry->access : LRU_CLOCK_MAX - entry->access + clock;
+        }
+    }
+}
+
+bool Evictor::is_volatile() {
+    return policy == EvictionPolicy::VOLATILE_LRU || policy == EvictionPolicy::VOLATILE_TTL;
+}
+
+bool Evictor::is_lfu() {
+    return policy == EvictionPolicy::ALLKEYS_LFU;
+}
+
+uint32_t Evictor::lru_clock() {
+    return (get_cached_time_ms() / 1000) & LRU_CLOCK_MAX;
+}
+
+uint32_t Evictor::lfu_minutes() {
+    return (get_cached_time_ms() / 60000) & 0xFFFF;
+}
+
+uint32_t Evictor::lfu_decayed_counter(Entry *entry) {
+    uint32_t last_decrement = entry->access >> 8;
+    uint32_t counter = entry->access & 0xFF;
+
+    uint32_t now = lfu_minutes();
+    uint32_t elapsed = now >= last_decrement ? now - last_decrement : 0xFFFF - last_decrement + now;
+    uint32_t periods = elapsed / LFU_DECAY_MINUTES;
+    return periods > counter ? 0 : counter - periods;
+}
+
+uint64_t Evictor::get_maxmemory() {
+    return maxmemory;
+}
+
+void Evictor::set_maxmemory(uint64_t maxmemory) {
+    this->maxmemory = maxmemory;
+}
+
+EvictionPolicy Evictor::get_policy() {
+    return policy;
+}
+
+void Evictor::set_policy(EvictionPolicy policy) {
+    this->policy = policy;
+    pool_len = 0;
+}
+
+const EvictionStats &Evictor::get_stats() {
+    return stats;
+}
+
+bool Evictor::parse_policy(const std::string &name, EvictionPolicy *policy) {
+    if (name == "noeviction") {
+        *policy = EvictionPolicy::NOEVICTION;
+    } else if (name == "allkeys-lru") {
+        *policy = EvictionPolicy::ALLKEYS_LRU;
+    } else if (name == "allkeys-lfu") {
+        *policy = EvictionPolicy::ALLKEYS_LFU;
+    } else if (name == "volatile-lru") {
+        *policy = EvictionPolicy::VOLATILE_LRU;
+    } else if (name == "volatile-ttl") {
+        *policy = EvictionPolicy::VOLATILE_TTL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *Evictor::policy_name(EvictionPolicy policy) {
+    switch (policy) {
+        case EvictionPolicy::ALLKEYS_LRU:
+            return "allkeys-lru";
+        case EvictionPolicy::ALLKEYS_LFU:
+            return "allkeys-lfu";
+        case EvictionPolicy::VOLATILE_LRU:
+            return "volatile-lru";
+        case EvictionPolicy::VOLATILE_TTL:
+            return "volatile-ttl";
+        default:
+            return "noeviction";
+    }
+}
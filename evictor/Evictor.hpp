@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../entry/Entry.hpp"
+#include "../hashmap/HMap.hpp"
+#include "../thread-pool/ThreadPool.hpp"
+#include "../timers/TimerManager.hpp"
+
+/* Policy for choosing which keys to evict when used memory is over the limit */
+enum class EvictionPolicy {
+    NOEVICTION, // reject writes instead of evicting
+    ALLKEYS_LRU, // evict the least recently used keys
+    ALLKEYS_LFU, // evict the least frequently used keys
+    VOLATILE_LRU, // evict the least recently used keys with a TTL
+    VOLATILE_TTL // evict the keys with a TTL that expire soonest
+};
+
+/* Stats for evicting kv store entries */
+struct EvictionStats {
+    uint64_t evicted = 0; // entries evicted
+    uint64_t timed_out = 0; // evictions that ran out of time before used memory was under the limit
+};
+
+/**
+ * Evicts kv store entries when used memory goes over the configured limit.
+ *
+ * Eviction is approximated the same way Redis does it: instead of keeping an exact LRU list, a few keys are sampled
+ * from the kv store and the best candidates are kept in a small pool that persists across evictions. Each Entry only
+ * carries 24 bits of access metadata, interpreted depending on the policy:
+ * - LRU: the LRU clock (seconds, wrapping) at the last access.
+ * - LFU: the minute (16 bits, wrapping) the counter was last decremented and a logarithmic access counter (8 bits).
+ */
+class Evictor {
+    public:
+        /* Outcome of perform_evictions() */
+        enum class Result {
+            OK, // used memory is under the limit
+            RUNNING, // used memory is still over the limit but the time budget ran out, the write can go ahead
+            FAIL // used memory is over the limit and nothing can be evicted, the write should be rejected
+        };
+    private:
+        static const uint32_t POOL_SIZE = 16;
+        static const uint32_t SAMPLES = 5; // keys sampled each time the pool is populated
+        static const uint32_t MAX_SAMPLE_ROUNDS = 16; // times the pool is populated looking for a victim
+        static const uint32_t EVICTION_BUDGET_US = 500;
+        static const uint8_t EVICTION_TIME_CHECK_INTERVAL = 16; // entries evicted between checks of the time budget
+        static const uint32_t LRU_CLOCK_MAX = (1 << 24) - 1;
+        static const uint32_t LFU_INIT_VAL = 5; // counter of a new entry, so it isn't evicted before it has a chance
+        static const uint32_t LFU_LOG_FACTOR = 10;
+        static const uint32_t LFU_DECAY_MINUTES = 1; // minutes for the counter to be decremented by 1
+
+        /* Eviction candidate. Keys are copied so the pool doesn't hold pointers to entries that may be deleted. */
+        struct PoolEntry {
+            uint64_t score; // higher is a better candidate
+            std::string key;
+        };
+
+        uint64_t maxmemory = 0; // 0 means no limit
+        EvictionPolicy policy = EvictionPolicy::NOEVICTION;
+        PoolEntry pool[POOL_SIZE]; // sorted by score in ascending order
+        uint32_t pool_len = 0;
+        EvictionStats stats;
+
+        /**
+         * Samples keys from the kv store and adds the ones that are better candidates than what's in the pool.
+         *
+         * @param kv_store  Reference to the kv store.
+         */
+        void populate_pool(HMap &kv_store);
+
+        /**
+         * Adds a key to the pool if its score is high enough, dropping the worst candidate if the pool is full.
+         *
+         * @param score The key's score.
+         * @param key   The key.
+         */
+        void add_to_pool(uint64_t score, const std::string &key);
+
+        /**
+         * Finds the best candidate for eviction.
+         *
+         * @param kv_store  Reference to the kv store.
+         *
+         * @return  Pointer to the Entry to evict.
+         *          NULL if there are no keys that can be evicted under the policy.
+         */
+        Entry *select_victim(HMap &kv_store);
+
+        /**
+         * Gets the eviction score of an Entry under the current policy.
+         *
+         * @param entry Pointer to the Entry.
+         *
+         * @return  The score. Higher is a better candidate for eviction.
+         */
+        uint64_t score(Entry *entry);
+
+        /* Returns true if the policy only evicts entries with a TTL */
+        bool is_volatile();
+
+        /* Returns true if the policy uses LFU access metadata */
+        bool is_lfu();
+
+        /* Returns the current LRU clock */
+        static uint32_t lru_clock();
+
+        /* Returns the current time in minutes, truncated to 16 bits */
+        static uint32_t lfu_minutes();
+
+        /**
+         * Gets the LFU counter of an Entry after decrementing it for the time since it was last decremented.
+         *
+         * @param entry Pointer to the Entry.
+         *
+         * @return  The decayed counter.
+         */
+        static uint32_t lfu_decayed_counter(Entry *entry);
+    public:
+        /**
+         * Initializes the access metadata of a newly created Entry.
+         *
+         * @param entry Pointer to the Entry.
+         */
+        void init_access(Entry *entry);
+
+        /**
+         * Updates the access metadata of an Entry when it is accessed.
+         *
+         * For LFU, the counter is incremented with a probability that goes down as the counter goes up, so the 8 bits
+         * can represent millions of accesses.
+         *
+         * @param entry Pointer to the Entry.
+         */
+        void touch(Entry *entry);
+
+        /**
+         * Evicts entries until used memory is under the limit, the policy doesn't allow eviction, or the time budget runs
+         * out. Called before each write command that can grow used memory, so the work is spread across writes instead
+         * of stalling the event loop. Replicas don't evict, their primary sends a del for each key it evicts.
+         *
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool used for asynchronous work.
+         *
+         * @return  The Result of the evictions.
+         */
+        Result perform_evictions(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool);
+
+        /* Returns the memory limit in bytes. 0 means no limit. */
+        uint64_t get_maxmemory();
+
+        /* Sets the memory limit in bytes. 0 means no limit. */
+        void set_maxmemory(uint64_t maxmemory);
+
+        /* Returns the eviction policy */
+        EvictionPolicy get_policy();
+
+        /* Sets the eviction policy. Clears the pool since the scores of its candidates no longer apply. */
+        void set_policy(EvictionPolicy policy);
+
+        /* Returns the eviction stats */
+        const EvictionStats &get_stats();
+
+        /**
+         * Parses the name of an eviction policy (e.g. "allkeys-lru").
+         *
+         * @param name      The name of the policy.
+         * @param policy    Pointer to an EvictionPolicy where the result will be stored.
+         *
+         * @return  True on success.
+         *          False if the name is not a known policy.
+         */
+        static bool parse_policy(const std::string &name, EvictionPolicy *policy);
+
+        /* Returns the name of an eviction policy */
+        static const char *policy_name(EvictionPolicy policy);
+
+    #ifdef TEST_MODE
+    public:
+        uint32_t get_pool_len() { return pool_len; }
+    #endif
+};
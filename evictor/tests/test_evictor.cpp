@@ -0,0 +1,299 @@
+#define TEST_MODE
+
+#include <assert.h>
+
+#include "../Evictor.hpp"
+#include "../../utils/hash_utils.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+
+/**
+ * Creates a string Entry and inserts it into the kv store.
+ *
+ * @param key       The key of the Entry.
+ * @param kv_store  Reference to the kv store.
+ * @param evictor   Reference to the evictor used to initialize the Entry's access metadata.
+ *
+ * @return  Pointer to the Entry.
+ */
+Entry *create_entry(const std::string &key, HMap &kv_store, Evictor &evictor) {
+    Entry *entry = new Entry();
+    entry->key = key;
+    entry->type = EntryType::STR;
+    entry->str = "value";
+    entry->node.hval = str_hash(key);
+    evictor.init_access(entry);
+    kv_store.insert(&entry->node);
+    update_entry_memory(entry);
+    return entry;
+}
+
+/* Checks if the kv store contains the given key */
+bool contains_key(const std::string &key, HMap &kv_store) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = key;
+    lookup_entry.node.hval = str_hash(key);
+    return kv_store.lookup(&lookup_entry.node, are_entries_equal) != NULL;
+}
+
+/* Deletes all Entries in the kv store */
+void clear_store(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool) {
+    std::vector<Entry *> entries;
+    kv_store.for_each([](HNode *node, void *arg) {
+        ((std::vector<Entry *> *) arg)->push_back(container_of(node, Entry, node));
+    }, &entries);
+    for (Entry *entry : entries) {
+        kv_store.remove(&entry->node, are_entries_equal);
+        delete_entry(entry, &timers, &thread_pool);
+    }
+}
+
+void test_no_maxmemory() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::ALLKEYS_LRU);
+
+    create_entry("a", kv_store, evictor);
+
+    assert(evictor.perform_evictions(kv_store, timers, thread_pool) == Evictor::Result::OK);
+    assert(kv_store.length() == 1);
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_under_maxmemory() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::ALLKEYS_LRU);
+
+    create_entry("a", kv_store, evictor);
+    evictor.set_maxmemory(get_used_memory());
+
+    assert(evictor.perform_evictions(kv_store, timers, thread_pool) == Evictor::Result::OK);
+    assert(kv_store.length() == 1);
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_noeviction_fails() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+
+    create_entry("a", kv_store, evictor);
+    evictor.set_maxmemory(get_used_memory() - 1);
+
+    assert(evictor.perform_evictions(kv_store, timers, thread_pool) == Evictor::Result::FAIL);
+    assert(kv_store.length() == 1);
+    assert(evictor.get_stats().evicted == 0);
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_allkeys_lru_evicts_least_recently_used() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::ALLKEYS_LRU);
+
+    create_entry("a", kv_store, evictor);
+    Entry *old = create_entry("b", kv_store, evictor);
+    create_entry("c", kv_store, evictor);
+    old->access = old->access - 100;
+
+    uint64_t used_memory = get_used_memory();
+    evictor.set_maxmemory(used_memory - 1);
+
+    assert(evictor.perform_evictions(kv_store, timers, thread_pool) == Evictor::Result::OK);
+    assert(kv_store.length() == 2);
+    assert(!contains_key("b", kv_store));
+    assert(get_used_memory() < used_memory);
+    assert(evictor.get_stats().evicted == 1);
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_allkeys_lfu_evicts_least_frequently_used() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::ALLKEYS_LFU);
+
+    Entry *a = create_entry("a", kv_store, evictor);
+    create_entry("b", kv_store, evictor);
+    Entry *c = create_entry("c", kv_store, evictor);
+    evictor.touch(a);
+    evictor.touch(c);
+
+    evictor.set_maxmemory(get_used_memory() - 1);
+
+    assert(evictor.perform_evictions(kv_store, timers, thread_pool) == Evictor::Result::OK);
+    assert(kv_store.length() == 2);
+    assert(!contains_key("b", kv_store));
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_lfu_touch_increments_new_entry_counter() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::ALLKEYS_LFU);
+
+    Entry *entry = create_entry("a", kv_store, evictor);
+    uint32_t counter = entry->access & 0xFF;
+
+    evictor.touch(entry); // counters at or below the initial value are always incremented
+
+    assert((entry->access & 0xFF) == counter + 1);
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_volatile_ttl_evicts_soonest_expiry() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::VOLATILE_TTL);
+
+    create_entry("a", kv_store, evictor);
+    Entry *b = create_entry("b", kv_store, evictor);
+    Entry *c = create_entry("c", kv_store, evictor);
+    b->ttl_timer.set_expiry(100, &timers);
+    c->ttl_timer.set_expiry(10, &timers);
+
+    evictor.set_maxmemory(get_used_memory() - 1);
+
+    assert(evictor.perform_evictions(kv_store, timers, thread_pool) == Evictor::Result::OK);
+    assert(kv_store.length() == 2);
+    assert(!contains_key("c", kv_store));
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_volatile_lru_skips_keys_without_ttl() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::VOLATILE_LRU);
+
+    Entry *a = create_entry("a", kv_store, evictor);
+    Entry *b = create_entry("b", kv_store, evictor);
+    a->access = a->access - 100;
+    b->ttl_timer.set_expiry(100, &timers);
+
+    evictor.set_maxmemory(get_used_memory() - 1);
+
+    assert(evictor.perform_evictions(kv_store, timers, thread_pool) == Evictor::Result::OK);
+    assert(kv_store.length() == 1);
+    assert(contains_key("a", kv_store));
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_volatile_lru_fails_without_volatile_keys() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::VOLATILE_LRU);
+
+    create_entry("a", kv_store, evictor);
+    evictor.set_maxmemory(get_used_memory() - 1);
+
+    assert(evictor.perform_evictions(kv_store, timers, thread_pool) == Evictor::Result::FAIL);
+    assert(kv_store.length() == 1);
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_evicts_until_under_maxmemory() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::ALLKEYS_LRU);
+
+    uint64_t start_memory = get_used_memory();
+    for (int i = 0; i < 100; i++) {
+        create_entry("key" + std::to_string(i), kv_store, evictor);
+    }
+    uint64_t entry_memory = (get_used_memory() - start_memory) / 100;
+    evictor.set_maxmemory(start_memory + 10 * entry_memory);
+
+    Evictor::Result result;
+    while ((result = evictor.perform_evictions(kv_store, timers, thread_pool)) == Evictor::Result::RUNNING);
+
+    assert(result == Evictor::Result::OK);
+    assert(get_used_memory() <= evictor.get_maxmemory());
+    assert(kv_store.length() == 10);
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_set_policy_clears_pool() {
+    HMap kv_store;
+    TimerManager timers;
+    ThreadPool thread_pool(1);
+    Evictor evictor;
+    evictor.set_policy(EvictionPolicy::ALLKEYS_LRU);
+
+    for (int i = 0; i < 4; i++) {
+        create_entry("key" + std::to_string(i), kv_store, evictor);
+    }
+    evictor.set_maxmemory(get_used_memory() - 1);
+    evictor.perform_evictions(kv_store, timers, thread_pool);
+    assert(evictor.get_pool_len() > 0);
+
+    evictor.set_policy(EvictionPolicy::ALLKEYS_LFU);
+    assert(evictor.get_pool_len() == 0);
+
+    clear_store(kv_store, timers, thread_pool);
+}
+
+void test_parse_policy() {
+    EvictionPolicy policies[] = {
+        EvictionPolicy::NOEVICTION,
+        EvictionPolicy::ALLKEYS_LRU,
+        EvictionPolicy::ALLKEYS_LFU,
+        EvictionPolicy::VOLATILE_LRU,
+        EvictionPolicy::VOLATILE_TTL
+    };
+    for (EvictionPolicy policy : policies) {
+        EvictionPolicy parsed;
+        assert(Evictor::parse_policy(Evictor::policy_name(policy), &parsed) == true);
+        assert(parsed == policy);
+    }
+
+    EvictionPolicy parsed;
+    assert(Evictor::parse_policy("allkeys-random", &parsed) == false);
+}
+
+int main() {
+    test_no_maxmemory();
+    test_under_maxmemory();
+    test_noeviction_fails();
+
+    test_allkeys_lru_evicts_least_recently_used();
+    test_allkeys_lfu_evicts_least_frequently_used();
+    test_lfu_touch_increments_new_entry_counter();
+    test_volatile_ttl_evicts_soonest_expiry();
+    test_volatile_lru_skips_keys_without_ttl();
+    test_volatile_lru_fails_without_volatile_keys();
+
+    test_evicts_until_under_maxmemory();
+    test_set_policy_clears_pool();
+
+    test_parse_policy();
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <assert.h>
+#include <utility>
 
 #include "HMap.hpp"
 
@@ -61,6 +62,69 @@ void HMap::for_each(void (*cb)(HNode *, void *), void *cb_arg) {
     }
 }
 
+uint32_t HMap::sample(HNode **nodes, uint32_t n) {
+    uint64_t start = (uint64_t) rand();
+    uint32_t count = newer->sample(start, nodes, n);
+    if (older != NULL && count < n) {
+        count += older->sample(start, nodes + count, n - count);
+    }
+    return count;
+}
+
+uint64_t HMap::scan(uint64_t cursor, void (*cb)(HNode **, void *), void *cb_arg) {
+    HTable *table = newer;
+    uint64_t slot = cursor;
+    if (slot >= newer->num_slots) {
+        table = older;
+        slot -= newer->num_slots;
+        if (table == NULL || slot >= table->num_slots) {
+            return 0;
+        }
+    }
+
+    for (HNode **from = &table->table[slot]; *from != NULL; from = &(*from)->next) {
+        cb(from, cb_arg);
+    }
+
+    uint64_t total_slots = newer->num_slots + (older != NULL ? older->num_slots : 0);
+    return cursor + 1 < total_slots ? cursor + 1 : 0;
+}
+
+void HMap::swap(HMap &other) {
+    std::swap(newer, other.newer);
+    std::swap(older, other.older);
+    std::swap(migrate_pos, other.migrate_pos);
+    std::swap(max_load_factor, other.max_load_factor);
+    std::swap(num_keys_to_rehash, other.num_keys_to_rehash);
+}
+
+void HMap::reserve(uint64_t n) {
+    uint64_t num_slots = newer->num_slots;
+    while (num_slots * max_load_factor <= n) {
+        num_slots *= 2;
+    }
+    if (num_slots == newer->num_slots) {
+        return;
+    }
+
+    HTable *table = new HTable(num_slots);
+    for (HTable *from : { older, newer }) {
+        if (from == NULL) {
+            continue;
+        }
+        for (uint64_t slot = 0; slot < from->num_slots && from->num_keys > 0; slot++) {
+            while (from->table[slot] != NULL) {
+                table->insert(from->detach(&from->table[slot]));
+            }
+        }
+        delete from;
+    }
+
+    newer = table;
+    older = NULL;
+    migrate_pos = 0;
+}
+
 uint32_t HMap::length() {
     return older != NULL ? newer->num_keys + older->num_keys : newer->num_keys;
 }
@@ -62,6 +62,46 @@ class HMap {
          */
         void for_each(void (*cb)(HNode *, void *), void *cb_arg);
 
+        /**
+         * Collects up to n nodes from a random position in the HMap. Nodes in the same chain or neighbouring slots are 
+         * returned together, so the sample is cheap but only approximately random.
+         * 
+         * @param nodes Array to store the nodes in. Must have space for at least n nodes.
+         * @param n     The maximum number of nodes to collect.
+         * 
+         * @return  The number of nodes collected. Can be less than n if the HMap is small or sparse.
+         */
+        uint32_t sample(HNode **nodes, uint32_t n);
+
+        /**
+         * Executes the provided callback function on each of the nodes in one slot of the HMap, so the HMap can be 
+         * iterated over incrementally. The callback is given the address of the pointer to the node (like 
+         * HTable::lookup()) so it can put a different node in its place.
+         * 
+         * Nodes moved by progressive rehashing between calls may be visited twice or not at all.
+         * 
+         * @param cursor    The slot to visit. 0 starts a new iteration.
+         * @param cb        The callback function.
+         * @param cb_arg    An argument for the callback.
+         * 
+         * @return  The cursor for the next slot.
+         *          0 if the iteration is complete.
+         */
+        uint64_t scan(uint64_t cursor, void (*cb)(HNode **, void *), void *cb_arg);
+
+        /* Swaps the contents of two HMaps */
+        void swap(HMap &other);
+
+        /**
+         * Grows the HMap so that n keys fit without it resizing, as when loading a known number of keys.
+         * 
+         * Unlike resize(), the keys already in the HMap are moved all at once rather than progressively, so this is 
+         * meant to be called while the HMap is empty or small.
+         * 
+         * @param n The number of keys.
+         */
+        void reserve(uint64_t n);
+
         /* Returns the number of keys in the HMap */
         uint32_t length();
 
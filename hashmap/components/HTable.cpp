@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <algorithm>
 #include <cstdlib>
 
 #include "HTable.hpp"
@@ -49,3 +50,14 @@ void HTable::for_each(void (*cb)(HNode *, void *), void *cb_arg) {
         }
     }
 }
+
+uint32_t HTable::sample(uint64_t start, HNode **nodes, uint32_t n) {
+    uint32_t count = 0;
+    uint64_t max_slots = std::min(num_slots, (uint64_t) n * SAMPLE_SLOTS_PER_NODE);
+    for (uint64_t i = 0; i < max_slots && count < n; i++) {
+        for (HNode *node = table[(start + i) & mask]; node != NULL && count < n; node = node->next) {
+            nodes[count++] = node;
+        }
+    }
+    return count;
+}
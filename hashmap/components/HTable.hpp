@@ -54,4 +54,18 @@ class HTable {
          *                  different callbacks.
          */
         void for_each(void (*cb)(HNode *, void *), void *cb_arg);
+
+        /**
+         * Collects up to n nodes by walking the slots of the HTable starting from the given slot, wrapping around at the
+         * end. At most n * SAMPLE_SLOTS_PER_NODE slots are visited so a sparse table can't turn this into a full scan.
+         * 
+         * @param start The slot to start from. Taken modulo the number of slots.
+         * @param nodes Array to store the nodes in. Must have space for at least n nodes.
+         * @param n     The maximum number of nodes to collect.
+         * 
+         * @return  The number of nodes collected.
+         */
+        uint32_t sample(uint64_t start, HNode **nodes, uint32_t n);
+
+        static const uint32_t SAMPLE_SLOTS_PER_NODE = 10;
 };
\ No newline at end of file
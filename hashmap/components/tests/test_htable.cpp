@@ -177,6 +177,42 @@ void test_for_each() {
     assert(item3.val == 9 * multiplier);
 }
 
+void test_sample_wraps_around() {
+    HTable table(8);
+    Item item1(0, 4);
+    Item item2(7, 2);
+    Item item3(7, 9);
+    table.insert(&item1.node);
+    table.insert(&item2.node);
+    table.insert(&item3.node);
+
+    HNode *nodes[3];
+    uint32_t count = table.sample(7, nodes, 3);
+    assert(count == 3);
+    assert(nodes[0] == &item3.node);
+    assert(nodes[1] == &item2.node);
+    assert(nodes[2] == &item1.node);
+}
+
+void test_sample_stops_at_n() {
+    HTable table(8);
+    Item item1(2, 4);
+    Item item2(2, 2);
+    table.insert(&item1.node);
+    table.insert(&item2.node);
+
+    HNode *nodes[1];
+    uint32_t count = table.sample(0, nodes, 1);
+    assert(count == 1);
+    assert(nodes[0] == &item2.node);
+}
+
+void test_sample_on_empty_table() {
+    HTable table(8);
+    HNode *nodes[4];
+    assert(table.sample(3, nodes, 4) == 0);
+}
+
 int main() {
     test_constructor();
 
@@ -195,5 +231,9 @@ int main() {
 
     test_for_each();
 
+    test_sample_wraps_around();
+    test_sample_stops_at_n();
+    test_sample_on_empty_table();
+
     return 0;
 }
@@ -306,6 +306,128 @@ void test_multi_step_rehash() {
     clean_up_map(map);
 }
 
+void test_sample() {
+    HMap map;
+    std::vector<Item *> items;
+    for (int i = 0; i < 4; i++) {
+        items.push_back(new Item(i, i));
+        map.insert(&items.back()->node);
+    }
+
+    HNode *nodes[8];
+    uint32_t count = map.sample(nodes, 8);
+    assert(count == 4);
+    for (uint32_t i = 0; i < count; i++) {
+        Item *item = container_of(nodes[i], Item, node);
+        assert(item->val >= 0 && item->val < 4);
+    }
+
+    for (Item *item : items) {
+        delete item;
+    }
+}
+
+/**
+ * Callback which replaces an Item in an HMap with a copy, recording the copy.
+ * 
+ * @param from  The address of the pointer to the Item's HNode.
+ * @param arg   Void pointer to a vector to store the copy in.
+ */
+void replace_with_copy(HNode **from, void *arg) {
+    Item *item = container_of(*from, Item, node);
+    Item *copy = new Item(item->node.hval, item->val);
+    copy->node.next = item->node.next;
+    *from = &copy->node;
+    ((std::vector<Item *> *) arg)->push_back(copy);
+}
+
+void test_scan_replaces_nodes() {
+    HMap map;
+    std::vector<Item *> items;
+    for (int i = 0; i < 20; i++) {
+        items.push_back(new Item(i % 5, i));
+        map.insert(&items.back()->node);
+    }
+
+    std::vector<Item *> copies;
+    uint64_t cursor = 0;
+    uint32_t steps = 0;
+    do {
+        cursor = map.scan(cursor, replace_with_copy, &copies);
+        steps++;
+    } while (cursor != 0);
+
+    assert(steps == map.get_newer()->num_slots);
+    assert(copies.size() == 20);
+    for (Item *item : items) {
+        HNode *node = map.lookup(&item->node, are_items_equal);
+        assert(node != NULL && node != &item->node);
+        assert(container_of(node, Item, node)->val == item->val);
+        delete item;
+    }
+    for (Item *copy : copies) {
+        delete copy;
+    }
+}
+
+void test_swap() {
+    HMap map1;
+    HMap map2;
+    Item item(1, 1);
+    map1.insert(&item.node);
+
+    map1.swap(map2);
+
+    assert(map1.length() == 0);
+    assert(map2.length() == 1);
+    assert(map2.lookup(&item.node, are_items_equal) == &item.node);
+}
+
+void test_reserve() {
+    HMap *map = new HMap();
+    map->reserve(1000);
+    assert(map->get_newer()->num_slots == 128);
+    assert(map->get_older() == NULL);
+
+    // no resize while inserting the reserved keys
+    for (uint32_t i = 0; i < 1000; i++) {
+        Item *item = new Item(i, i);
+        map->insert(&item->node);
+        assert(map->get_older() == NULL);
+    }
+    assert(map->get_newer()->num_slots == 128);
+
+    // smaller reservations don't shrink the map
+    map->reserve(10);
+    assert(map->get_newer()->num_slots == 128);
+
+    clean_up_map(map);
+}
+
+void test_reserve_in_the_middle_of_rehashing() {
+    HMap *map = create_map_in_the_middle_of_rehashing();
+    map->reserve(100);
+    assert(map->get_older() == NULL);
+    assert(map->get_newer()->num_slots == 128);
+    assert(map->length() == 8);
+
+    int sum = 0;
+    map->for_each(add, &sum);
+    assert(sum == 28);
+    for (uint32_t i = 0; i < 8; i++) {
+        Item item(i, i);
+        assert(map->get_newer()->lookup(&item.node, are_items_equal) != NULL);
+    }
+
+    clean_up_map(map);
+}
+
+void test_sample_on_empty_map() {
+    HMap map;
+    HNode *nodes[4];
+    assert(map.sample(nodes, 4) == 0);
+}
+
 int main() {
     test_constructor();
 
@@ -327,5 +449,14 @@ int main() {
 
     test_multi_step_rehash();
 
+    test_sample();
+    test_sample_on_empty_map();
+
+    test_scan_replaces_nodes();
+    test_swap();
+
+    test_reserve();
+    test_reserve_in_the_middle_of_rehashing();
+
     return 0;
 }
@@ -0,0 +1,220 @@
+#include <algorithm>
+
+#include "MigrateJob.hpp"
+#include "../rdb/components/DumpPayload.hpp"
+#include "../request/Request.hpp"
+#include "../response/types/ErrResponse.hpp"
+#include "../response/types/StrResponse.hpp"
+#include "../utils/hash_utils.hpp"
+#include "../utils/intrusive_data_structure_utils.hpp"
+#include "../utils/log.hpp"
+#include "../utils/time_utils.hpp"
+
+std::unordered_set<std::string> MigrateJob::locked;
+
+/* Argument for add_pair_to_chunk() */
+struct ChunkArg {
+    MigrateJob *job;
+    uint32_t item; // index of the item
+    uint32_t max_size; // largest payload that fits in a request
+    DumpWriter *writer; // payload being built
+    bool first; // whether no payload has been queued for the item yet
+    bool ok; // false once the migration has failed, so the remaining pairs are skipped
+};
+
+MigrateJob::MigrateJob(const std::string &target, const MigrateOptions &options, std::vector<MigrateItem> &&items) :
+    target(target), options(options), items(std::move(items)), moved(this->items.size(), false) {
+    if (!options.copy) {
+        for (const MigrateItem &item : this->items) {
+            locked.insert(item.key);
+        }
+    }
+}
+
+MigrateJob::~MigrateJob() {
+    for (MigrateItem &item : items) {
+        delete item.zset;
+        if (!options.copy) {
+            locked.erase(item.key);
+        }
+    }
+}
+
+bool MigrateJob::is_locked(const std::string &key) {
+    return locked.count(key) > 0;
+}
+
+bool MigrateJob::has_locked_keys() {
+    return !locked.empty();
+}
+
+uint32_t MigrateJob::max_payload_size(const std::string &key) {
+    // restore-asking <key> 0 <payload> REPLACE | APPEND, with room to spare for the lengths of the strings
+    uint32_t overhead = 128 + key.size();
+    return overhead >= Request::MAX_LEN ? 0 : Request::MAX_LEN - overhead;
+}
+
+/**
+ * Gets the TTL to send with the last payload of an item.
+ * 
+ * @param item  The item.
+ * 
+ * @return  The remaining TTL in ms, 0 if the key has expired since it was snapshotted, RDB_NO_EXPIRY if it has none.
+ */
+int64_t get_remaining_ttl(const MigrateItem &item) {
+    if (item.expiry_time_ms == -1) {
+        return RDB_NO_EXPIRY;
+    }
+    return std::max<int64_t>(item.expiry_time_ms - get_time_ms(), 0);
+}
+
+bool MigrateJob::add_command(uint32_t i, const std::string &payload, bool first, bool last) {
+    std::vector<std::string> command = { "restore-asking", items[i].key, "0", payload };
+    if (!first) {
+        command.push_back("APPEND");
+    } else if (options.replace) {
+        command.push_back("REPLACE");
+    }
+
+    batch.push_back(std::move(command));
+    if (last) {
+        batch_ends.push_back({ i, batch.size() - 1 });
+    }
+    return batch.size() < BATCH_SIZE || send_batch();
+}
+
+void MigrateJob::add_pair_to_chunk(const SPairView &pair, void *arg) {
+    ChunkArg *chunk = (ChunkArg *) arg;
+    if (!chunk->ok) {
+        return;
+    }
+
+    size_t pair_size = sizeof(pair.score) + sizeof(pair.len) + pair.len;
+    if (chunk->writer->size() + pair_size > chunk->max_size) {
+        DumpWriter empty(EntryType::SORTED_SET, RDB_NO_EXPIRY);
+        if (empty.size() + pair_size > chunk->max_size) {
+            chunk->job->error = "value of key '" + chunk->job->items[chunk->item].key + "' is too big to migrate";
+            chunk->ok = false;
+            return;
+        }
+
+        chunk->ok = chunk->job->add_command(chunk->item, chunk->writer->finish(), chunk->first, false);
+        chunk->first = false;
+        *chunk->writer = std::move(empty);
+    }
+
+    chunk->writer->add_pair(pair);
+}
+
+bool MigrateJob::add_item(uint32_t i) {
+    const MigrateItem &item = items[i];
+    uint32_t max_size = max_payload_size(item.key);
+    if (max_size < MIN_PAYLOAD_SIZE) {
+        error = "key '" + item.key + "' is too long to migrate";
+        return false;
+    }
+
+    if (item.type == EntryType::STR) {
+        size_t pos = 0;
+        bool first = true;
+        do {
+            DumpWriter writer(EntryType::STR, RDB_NO_EXPIRY);
+            size_t n = std::min(item.str.size() - pos, max_size - writer.size() - sizeof(uint32_t));
+            bool last = pos + n == item.str.size();
+            writer.set_str(item.str.data() + pos, n);
+            if (last) {
+                writer.set_ttl(get_remaining_ttl(item));
+            }
+            if (!add_command(i, writer.finish(), first, last)) {
+                return false;
+            }
+            pos += n;
+            first = false;
+        } while (pos < item.str.size());
+        return true;
+    }
+
+    DumpWriter writer(EntryType::SORTED_SET, RDB_NO_EXPIRY);
+    ChunkArg chunk = { this, i, max_size, &writer, true, true };
+    item.zset->for_each(add_pair_to_chunk, &chunk);
+    if (!chunk.ok) {
+        return false;
+    }
+
+    writer.set_ttl(get_remaining_ttl(item));
+    return add_command(i, writer.finish(), chunk.first, true);
+}
+
+bool MigrateJob::send_batch() {
+    if (batch.empty()) {
+        return true;
+    }
+
+    std::vector<std::unique_ptr<Response>> responses = client->execute(batch);
+    uint32_t failed = responses.size(); // index of the first command that failed
+    for (uint32_t i = 0; i < responses.size(); i++) {
+        ErrResponse *err = dynamic_cast<ErrResponse *>(responses[i].get());
+        if (err != NULL) {
+            error = "target " + target + " failed to restore key '" + batch[i][1] + "': " + err->get_err_msg();
+            failed = i;
+            break;
+        }
+    }
+
+    for (auto [item, end] : batch_ends) {
+        moved[item] = end < failed;
+    }
+    batch.clear();
+    batch_ends.clear();
+    return error.empty();
+}
+
+void MigrateJob::run() {
+    ClusterClient target_client(target);
+    target_client.set_timeout(options.timeout_ms);
+    target_client.set_follow_redirects(false); // the keys must end up on the target, even if it redirects them
+    client = &target_client;
+
+    bool ok = true;
+    for (uint32_t i = 0; i < items.size() && ok; i++) {
+        ok = add_item(i);
+    }
+    if (ok) {
+        send_batch();
+    }
+
+    client = NULL;
+    batch.clear();
+    batch_ends.clear();
+}
+
+std::unique_ptr<Response> MigrateJob::finish(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, 
+                                             Evictor &) {
+    uint32_t num_moved = std::count(moved.begin(), moved.end(), true);
+    for (uint32_t i = 0; i < items.size() && !options.copy; i++) {
+        if (!moved[i]) {
+            continue;
+        }
+
+        LookupEntry lookup_entry;
+        lookup_entry.key = items[i].key;
+        lookup_entry.node.hval = str_hash(items[i].key);
+        HNode *node = kv_store.remove(&lookup_entry.node, are_entries_equal);
+        if (node != NULL) {
+            delete_entry(container_of(node, Entry, node), &timers, &thread_pool);
+        }
+        deleted.push_back(items[i].key);
+    }
+
+    if (!error.empty()) {
+        log("migrate: %s, moved %u of %lu keys", error.data(), num_moved, items.size());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN, error);
+    }
+
+    log("migrate: %s %u keys to %s", options.copy ? "copied" : "moved", num_moved, target.data());
+    return std::make_unique<StrResponse>("OK");
+}
+
+std::vector<std::string> MigrateJob::get_changed_keys() {
+    return deleted;
+}
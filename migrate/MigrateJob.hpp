@@ -0,0 +1,158 @@
+#pragma once
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "../background-jobs/BackgroundJobs.hpp"
+#include "../cluster/components/ClusterClient.hpp"
+#include "../entry/Entry.hpp"
+#include "../sorted-set/SortedSet.hpp"
+
+/* A key being migrated, as it was when the migration started */
+struct MigrateItem {
+    std::string key;
+    EntryType type;
+    std::string str; // value of a string
+    SortedSet::Snapshot *zset = NULL; // pairs of a sorted set, deleted with the job
+    time_t expiry_time_ms = -1; // monotonic time the key expires at, -1 if it has no TTL
+};
+
+/* Options for the migrate command */
+struct MigrateOptions {
+    bool copy = false; // keep the keys on this server
+    bool replace = false; // overwrite keys that already exist on the target
+    uint32_t timeout_ms = 0; // longest a send or receive to the target may block, 0 to block forever
+};
+
+/**
+ * Job for migrate: moves keys to another server with restore-asking commands, then deletes them here.
+ * 
+ * The values are sent from Snapshots taken when the command was executed, so the transfer runs on a thread pool worker 
+ * while the event loop keeps serving other keys. Keys being moved are locked until the job finishes (see is_locked()): 
+ * writes to them are rejected with TRYAGAIN, since they would otherwise be lost when the key is deleted.
+ * 
+ * A value too big for one request is sent as several payloads (see DumpPayload.hpp), the first restoring the key and 
+ * the rest appended to it. The TTL is only sent with the last one, so the key can't expire on the target while it is 
+ * half restored. Commands are pipelined BATCH_SIZE at a time, and a key only counts as moved once the target has 
+ * replied to every command for it.
+ */
+class MigrateJob : public BackgroundJob {
+    private:
+        static const uint32_t BATCH_SIZE = 128; // restore commands sent before the target's replies are read
+        static const uint32_t MIN_PAYLOAD_SIZE = 256; // keys too long to leave this much room for a payload can't move
+
+        static std::unordered_set<std::string> locked; // keys of running MigrateJobs that aren't copying
+
+        std::string target; // "host:port"
+        MigrateOptions options;
+        std::vector<MigrateItem> items;
+        std::vector<bool> moved; // set by run(): whether each item was fully restored on the target
+        std::string error; // set by run(): why the migration stopped, empty if every key was moved
+        std::vector<std::string> deleted; // set by finish(): keys deleted from this server
+
+        ClusterClient *client = NULL; // connection to the target, while run() is running
+        std::vector<std::vector<std::string>> batch; // restore commands waiting to be sent
+        std::vector<std::pair<uint32_t, uint32_t>> batch_ends; // items whose last command is in the batch, with the 
+                                                               // index of that command
+
+        /**
+         * Queues the restore commands for an item, sending the batch whenever it fills up.
+         * 
+         * @param i The index of the item.
+         * 
+         * @return  True on success.
+         *          False if the migration failed, with error set.
+         */
+        bool add_item(uint32_t i);
+
+        /**
+         * Callback which adds a sorted set pair to the payload being built for an item, queueing the payload once the 
+         * next pair wouldn't fit.
+         * 
+         * @param pair  The pair.
+         * @param arg   Void pointer to the ChunkArg.
+         */
+        static void add_pair_to_chunk(const SPairView &pair, void *arg);
+
+        /**
+         * Queues a restore command for an item, sending the batch if it's full.
+         * 
+         * @param i         The index of the item.
+         * @param payload   The payload.
+         * @param first     Whether this is the item's first payload.
+         * @param last      Whether this is the item's last payload, which carries the TTL.
+         * 
+         * @return  True on success.
+         *          False if the migration failed, with error set.
+         */
+        bool add_command(uint32_t i, const std::string &payload, bool first, bool last);
+
+        /**
+         * Sends the queued commands and checks the target's replies, marking the items they finished as moved.
+         * 
+         * @return  True on success.
+         *          False if the migration failed, with error set.
+         */
+        bool send_batch();
+
+        /**
+         * Gets the largest payload that fits in a restore request for a key.
+         * 
+         * @param key   The key.
+         * 
+         * @return  The size in bytes.
+         */
+        static uint32_t max_payload_size(const std::string &key);
+    public:
+        /**
+         * Initializes a MigrateJob, locking its keys until it is deleted unless the keys are copied.
+         * 
+         * @param target    The "host:port" of the server to move the keys to.
+         * @param options   The options.
+         * @param items     The keys to move.
+         */
+        MigrateJob(const std::string &target, const MigrateOptions &options, std::vector<MigrateItem> &&items);
+
+        ~MigrateJob();
+
+        /**
+         * Checks if a key is being moved by a MigrateJob.
+         * 
+         * @param key   The key.
+         * 
+         * @return  True if it is, false otherwise.
+         */
+        static bool is_locked(const std::string &key);
+
+        /* Returns whether any key is being moved, so callers can skip looking up the keys of a command */
+        static bool has_locked_keys();
+
+        /* Sends the keys to the target */
+        void run() override;
+
+        /**
+         * Deletes the keys that were moved, unless they were copied.
+         * 
+         * @return  One of the following:
+         *          - StrResponse ("OK"): every key was moved.
+         *          - ErrResponse: the target couldn't be reached or rejected a key. Keys moved before the error are
+         *            still deleted.
+         */
+        std::unique_ptr<Response> finish(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool,
+                                         Evictor &evictor) override;
+
+        /* Returns the keys that were deleted */
+        std::vector<std::string> get_changed_keys() override;
+
+    #ifdef TEST_MODE
+    public:
+        uint32_t get_num_moved() {
+            uint32_t num_moved = 0;
+            for (bool item_moved : moved) {
+                num_moved += item_moved;
+            }
+            return num_moved;
+        }
+    #endif
+};
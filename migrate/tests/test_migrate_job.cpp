@@ -0,0 +1,117 @@
+#include <assert.h>
+
+#include "../MigrateJob.hpp"
+#include "../../background-jobs/BackgroundJobs.hpp"
+#include "../../buffer/Buffer.hpp"
+#include "../../command-executor/CommandExecutor.hpp"
+#include "../../utils/test_utils.hpp"
+
+TimerManager timers;
+ThreadPool thread_pool(2);
+Evictor evictor;
+
+void test_migrate_large_keys(const TestProcess &target) {
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+
+    // neither fits in one restore request, so both are sent as several payloads
+    std::string value(4000, 'x');
+    for (uint32_t i = 0; i < value.size(); i++) {
+        value[i] = 'a' + i % 26;
+    }
+    executor.execute_now({"set", "str", value, "PX", "100000"});
+    for (uint32_t i = 0; i < 5000; i++) {
+        executor.execute_now({"zadd", "zset", std::to_string(i), "name" + std::to_string(i)});
+    }
+
+    std::unique_ptr<Response> response = executor.execute_now({"migrate", "127.0.0.1", target.port, "", "5000", "KEYS", 
+                                                        "str", "zset", "missing"});
+    assert(str_of(response) == "OK");
+    assert(kv_store.length() == 0);
+
+    assert(str_of(send_to(target.addr, {"get", "str"})) == value);
+    int64_t ttl = int_of(send_to(target.addr, {"pttl", "str"}));
+    assert(ttl > 90000 && ttl <= 100000);
+    assert(int_of(send_to(target.addr, {"zcard", "zset"})) == 5000);
+    assert(str_of(send_to(target.addr, {"zscore", "zset", "name4999"})) == std::to_string(4999.0));
+    assert(int_of(send_to(target.addr, {"pttl", "zset"})) == -1);
+
+    // the keys are gone, so there's nothing left to move
+    response = executor.execute_now({"migrate", "127.0.0.1", target.port, "str", "5000"});
+    assert(str_of(response) == "NOKEY");
+
+    send_to(target.addr, {"del", "str"});
+    send_to(target.addr, {"del", "zset"});
+}
+
+void test_migrate_copy_and_replace(const TestProcess &target) {
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    executor.execute_now({"set", "key", "new"});
+    assert(str_of(send_to(target.addr, {"set", "key", "old"})) == "OK");
+
+    // a key that exists on the target isn't overwritten, and stays here
+    std::unique_ptr<Response> response = executor.execute_now({"migrate", "127.0.0.1", target.port, "key", "5000"});
+    ErrResponse *err = dynamic_cast<ErrResponse *>(response.get());
+    assert(err != NULL && err->get_err_msg().find("BUSYKEY") != std::string::npos);
+    assert(str_of(executor.execute_now({"get", "key"})) == "new");
+
+    // COPY keeps the key here, REPLACE overwrites it on the target
+    response = executor.execute_now({"migrate", "127.0.0.1", target.port, "key", "5000", "COPY", "REPLACE"});
+    assert(str_of(response) == "OK");
+    assert(str_of(executor.execute_now({"get", "key"})) == "new");
+    assert(str_of(send_to(target.addr, {"get", "key"})) == "new");
+
+    send_to(target.addr, {"del", "key"});
+    executor.execute_now({"del", "key"});
+}
+
+void test_migrate_on_thread_pool(const TestProcess &target) {
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    std::string value(4000, 'x');
+    executor.execute_now({"set", "key", value});
+    std::string bytes(64 * 1024, 'y');
+
+    // the job's connection allocates Buffers on a worker while this thread keeps allocating its own, as the event loop 
+    // does for its connections
+    assert(executor.execute({"migrate", "127.0.0.1", target.port, "key", "5000"}) == nullptr);
+    BackgroundJobs &jobs = BackgroundJobs::shared();
+    jobs.submit(executor.take_deferred_job(), thread_pool);
+    std::vector<BackgroundJob *> finished;
+    while (finished.empty()) {
+        for (uint32_t i = 0; i < 100; i++) {
+            Buffer buf;
+            buf.append(bytes.data(), (i + 1) * 600);
+        }
+        finished = jobs.take_finished();
+    }
+    assert(str_of(executor.finish_job(finished[0])) == "OK");
+    assert(str_of(send_to(target.addr, {"get", "key"})) == value);
+
+    send_to(target.addr, {"del", "key"});
+}
+
+void test_migrate_unreachable() {
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    executor.execute_now({"set", "key", "value"});
+
+    std::unique_ptr<Response> response = executor.execute_now({"migrate", "127.0.0.1", "1", "key", "100"});
+    assert(dynamic_cast<ErrResponse *>(response.get()) != NULL);
+    assert(str_of(executor.execute_now({"get", "key"})) == "value");
+    assert(!MigrateJob::has_locked_keys());
+
+    executor.execute_now({"del", "key"});
+}
+
+int main() {
+    TestProcess target = start_test_process("server", test_base_port());
+    test_migrate_large_keys(target);
+    test_migrate_copy_and_replace(target);
+    test_migrate_on_thread_pool(target);
+    test_migrate_unreachable();
+    stop_test_process(target);
+
+    return 0;
+}
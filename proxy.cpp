@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <cstdlib>
+#include <netdb.h>
+#include <string>
+#include <vector>
+
+#include "sharding-proxy/Proxy.hpp"
+#include "utils/log.hpp"
+#include "utils/net_utils.hpp"
+
+static const uint32_t DEFAULT_CONNS_PER_BACKEND = 2; // connections the proxy opens to each backend
+
+int main(int argc, char *argv[]) {
+    // ./proxy <port> <host:port> [<host:port> ...] [--conns <n>]
+    if (argc < 3) {
+        fatal("usage: ./proxy <port> <host:port> [<host:port> ...] [--conns <n>]");
+    }
+
+    const char *port = argv[1];
+    std::vector<std::string> backends;
+    uint32_t conns_per_backend = DEFAULT_CONNS_PER_BACKEND;
+    for (int i = 2; i < argc; i++) {
+        if (std::string(argv[i]) == "--conns" && i + 1 < argc) {
+            conns_per_backend = std::max(atoi(argv[++i]), 1);
+        } else {
+            backends.push_back(argv[i]);
+        }
+    }
+    if (backends.empty()) {
+        fatal("no backends given");
+    }
+
+    struct addrinfo *res = get_my_addr_info(port);
+    if (res == NULL) {
+        fatal("failed to get proxy's addrinfo");
+    }
+
+    int listener;
+    if ((listener = start_server(res)) == -1) {
+        fatal("failed to start proxy");
+    }
+    freeaddrinfo(res);
+
+    Proxy proxy(backends, conns_per_backend);
+    log("started proxy on port %s for %lu backends", port, backends.size());
+
+    while (true) {
+        proxy.poll_once(listener, -1);
+    }
+}
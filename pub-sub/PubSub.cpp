@@ -0,0 +1,292 @@
+#include <sstream>
+
+#include "PubSub.hpp"
+#include "../buffer/Buffer.hpp"
+#include "../conn/Conn.hpp"
+#include "../response/types/ArrResponse.hpp"
+#include "../response/types/ErrResponse.hpp"
+#include "../response/types/IntResponse.hpp"
+#include "../response/types/StrResponse.hpp"
+#include "../utils/glob_utils.hpp"
+#include "../utils/hash_utils.hpp"
+#include "../utils/intrusive_data_structure_utils.hpp"
+#include "../utils/log.hpp"
+#include "../utils/time_utils.hpp"
+
+PubSub &PubSub::shared() {
+    static PubSub pub_sub;
+    return pub_sub;
+}
+
+bool PubSub::are_channels_equal(HNode *node1, HNode *node2) {
+    return container_of(node1, Channel, node)->name == container_of(node2, Channel, node)->name;
+}
+
+bool PubSub::are_subscribers_equal(HNode *node1, HNode *node2) {
+    return container_of(node1, Subscriber, node)->conn == container_of(node2, Subscriber, node)->conn;
+}
+
+/* Hashes a connection by its address */
+static uint64_t conn_hash(Conn *conn) {
+    return str_hash((const char *) &conn, sizeof(conn));
+}
+
+PubSub::Channel *PubSub::find(HMap &map, const std::string &name) {
+    Channel key;
+    key.name = name;
+    key.node.hval = str_hash(name);
+    HNode *node = map.lookup(&key.node, are_channels_equal);
+    return node == NULL ? NULL : container_of(node, Channel, node);
+}
+
+bool PubSub::subscribe(HMap &map, Conn *conn, const std::string &name) {
+    Channel *channel = find(map, name);
+    if (channel == NULL) {
+        channel = new Channel();
+        channel->name = name;
+        channel->node.hval = str_hash(name);
+        map.insert(&channel->node);
+    }
+
+    Subscriber key;
+    key.conn = conn;
+    key.node.hval = conn_hash(conn);
+    if (channel->subscribers.lookup(&key.node, are_subscribers_equal) != NULL) {
+        return false;
+    }
+
+    Subscriber *subscriber = new Subscriber();
+    subscriber->conn = conn;
+    subscriber->node.hval = key.node.hval;
+    channel->subscribers.insert(&subscriber->node);
+    return true;
+}
+
+bool PubSub::unsubscribe(HMap &map, Conn *conn, const std::string &name) {
+    Channel *channel = find(map, name);
+    if (channel == NULL) {
+        return false;
+    }
+
+    Subscriber key;
+    key.conn = conn;
+    key.node.hval = conn_hash(conn);
+    HNode *node = channel->subscribers.remove(&key.node, are_subscribers_equal);
+    if (node == NULL) {
+        return false;
+    }
+    delete container_of(node, Subscriber, node);
+
+    if (channel->subscribers.length() == 0) {
+        map.remove(&channel->node, are_channels_equal);
+        delete channel;
+    }
+    return true;
+}
+
+/**
+ * Marshals a push to subscribers once, to be shared by all of them.
+ * 
+ * @param elements  The elements of the push.
+ * 
+ * @return  The marshalled push.
+ *          nullptr if it's too big.
+ */
+static std::shared_ptr<const std::string> marshal_push(const std::vector<std::string> &elements) {
+    std::vector<Response *> responses;
+    for (const std::string &element : elements) {
+        responses.push_back(new StrResponse(element));
+    }
+
+    Buffer buf;
+    if (ArrResponse(responses).marshal(buf) == Response::MarshalStatus::RES_TOO_BIG) {
+        return nullptr;
+    }
+    return std::make_shared<const std::string>(buf.data(), buf.size());
+}
+
+/* Argument for deliver_cb() */
+struct DeliverArg {
+    PubSub *pub_sub;
+    const std::shared_ptr<const std::string> *message;
+};
+
+void PubSub::deliver_cb(HNode *node, void *arg) {
+    DeliverArg *deliver_arg = (DeliverArg *) arg;
+    deliver_arg->pub_sub->deliver_to(container_of(node, Subscriber, node)->conn, *deliver_arg->message);
+}
+
+uint32_t PubSub::deliver(Channel *channel, const std::shared_ptr<const std::string> &message) {
+    DeliverArg arg = { this, &message };
+    channel->subscribers.for_each(deliver_cb, &arg);
+    stats.delivered += channel->subscribers.length();
+    return channel->subscribers.length();
+}
+
+void PubSub::deliver_to(Conn *conn, const std::shared_ptr<const std::string> &message) {
+    if (conn->want_close) {
+        return; // already on its way out, don't grow its output any further
+    }
+    conn->add_shared_reply(message);
+
+    uint64_t size = conn->get_output_size();
+    time_t now_ms = get_cached_time_ms();
+    bool over_hard = limits.hard_bytes > 0 && size > limits.hard_bytes;
+    bool over_soft = limits.soft_bytes > 0 && size > limits.soft_bytes;
+    if (!over_soft) {
+        conn->over_soft_limit_since_ms = 0;
+    } else if (conn->over_soft_limit_since_ms == 0) {
+        conn->over_soft_limit_since_ms = now_ms;
+    }
+
+    if (over_hard || (over_soft && now_ms - conn->over_soft_limit_since_ms >= (time_t) limits.soft_seconds * 1000)) {
+        log("subscriber %d went over the output limit with %lu bytes unsent, disconnecting it", conn->fd, size);
+        conn->want_close = true;
+        slow_subscribers.push_back(conn);
+        stats.slow_disconnects++;
+    }
+}
+
+void PubSub::match_cb(HNode *node, void *arg) {
+    auto *match_arg = (std::pair<const std::string *, std::vector<Channel *> *> *) arg;
+    Channel *pattern = container_of(node, Channel, node);
+    if (glob_match(pattern->name, *match_arg->first)) {
+        match_arg->second->push_back(pattern);
+    }
+}
+
+int64_t PubSub::publish(const std::string &channel, const std::string &message) {
+    std::shared_ptr<const std::string> push = marshal_push({ "message", channel, message });
+    if (push == nullptr) {
+        return -1;
+    }
+    stats.published++;
+
+    int64_t receivers = 0;
+    Channel *subscribed = find(channels, channel);
+    if (subscribed != NULL) {
+        receivers += deliver(subscribed, push);
+    }
+
+    if (patterns.length() > 0) {
+        // every pattern is matched against the channel, each one matching gets its own push
+        std::vector<Channel *> matches;
+        std::pair<const std::string *, std::vector<Channel *> *> match_arg = { &channel, &matches };
+        patterns.for_each(match_cb, &match_arg);
+
+        for (Channel *pattern : matches) {
+            std::shared_ptr<const std::string> pattern_push = marshal_push({ "pmessage", pattern->name, channel,
+                                                                             message });
+            if (pattern_push == nullptr) {
+                log("publish: message to '%s' is too big to push for pattern '%s'", channel.data(),
+                    pattern->name.data());
+                continue;
+            }
+            receivers += deliver(pattern, pattern_push);
+        }
+    }
+
+    return receivers;
+}
+
+std::unique_ptr<Response> PubSub::handle_command(Conn *conn, const std::vector<std::string> &command) {
+    const std::string &name = command[0];
+    if ((name == "subscribe" || name == "psubscribe") && command.size() >= 2) {
+        bool is_pattern = name == "psubscribe";
+        for (uint32_t i = 1; i < command.size(); i++) {
+            if (subscribe(is_pattern ? patterns : channels, conn, command[i])) {
+                (is_pattern ? conn->patterns : conn->channels).insert(command[i]);
+            }
+        }
+        log("%s: connection %d has %lu subscriptions", name.data(), conn->fd,
+            conn->channels.size() + conn->patterns.size());
+        return std::make_unique<IntResponse>(conn->channels.size() + conn->patterns.size());
+    } else if (name == "unsubscribe" || name == "punsubscribe") {
+        bool is_pattern = name == "punsubscribe";
+        std::unordered_set<std::string> &subscribed = is_pattern ? conn->patterns : conn->channels;
+        std::vector<std::string> names(command.begin() + 1, command.end());
+        if (names.empty()) {
+            names.assign(subscribed.begin(), subscribed.end()); // no names, drop every one
+        }
+        for (const std::string &channel : names) {
+            if (unsubscribe(is_pattern ? patterns : channels, conn, channel)) {
+                subscribed.erase(channel);
+            }
+        }
+        log("%s: connection %d has %lu subscriptions", name.data(), conn->fd,
+            conn->channels.size() + conn->patterns.size());
+        return std::make_unique<IntResponse>(conn->channels.size() + conn->patterns.size());
+    } else if (name == "publish" && command.size() == 3) {
+        int64_t receivers = publish(command[1], command[2]);
+        if (receivers == -1) {
+            log("publish: message to '%s' is too big", command[1].data());
+            return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_TOO_BIG, "message is too big");
+        }
+        log("publish: message to '%s' queued on %ld subscribers", command[1].data(), receivers);
+        return std::make_unique<IntResponse>(receivers);
+    } else if (conn->is_subscribed()) {
+        log("connection %d sent '%s' while subscribed", conn->fd, name.data());
+        return std::make_unique<ErrResponse>(ErrResponse::ErrorCode::ERR_UNKNOWN,
+                                             "only (p)subscribe and (p)unsubscribe are allowed while subscribed");
+    }
+
+    return nullptr;
+}
+
+void PubSub::unsubscribe_all(Conn *conn) {
+    for (const std::string &channel : conn->channels) {
+        unsubscribe(channels, conn, channel);
+    }
+    for (const std::string &pattern : conn->patterns) {
+        unsubscribe(patterns, conn, pattern);
+    }
+    conn->channels.clear();
+    conn->patterns.clear();
+
+    // closed some other way first, it mustn't be closed again
+    std::erase(slow_subscribers, conn);
+}
+
+std::vector<Conn *> PubSub::take_slow_subscribers() {
+    std::vector<Conn *> slow;
+    slow.swap(slow_subscribers);
+    return slow;
+}
+
+bool PubSub::set_limits(const std::string &value) {
+    std::istringstream stream(value);
+    std::string fields[3], extra;
+    if (!(stream >> fields[0] >> fields[1] >> fields[2]) || stream >> extra) {
+        return false;
+    }
+
+    uint64_t values[3];
+    for (uint32_t i = 0; i < 3; i++) {
+        char *end;
+        long long n = strtoll(fields[i].data(), &end, 10);
+        if (*end != '\0' || n < 0) {
+            return false;
+        }
+        values[i] = n;
+    }
+
+    limits = { values[0], values[1], values[2] };
+    return true;
+}
+
+std::string PubSub::get_limits() {
+    return std::to_string(limits.hard_bytes) + " " + std::to_string(limits.soft_bytes) + " " +
+           std::to_string(limits.soft_seconds);
+}
+
+uint32_t PubSub::get_num_channels() {
+    return channels.length();
+}
+
+uint32_t PubSub::get_num_patterns() {
+    return patterns.length();
+}
+
+const PubSubStats &PubSub::get_stats() {
+    return stats;
+}
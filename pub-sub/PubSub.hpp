@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../hashmap/HMap.hpp"
+#include "../response/Response.hpp"
+
+// Forward declaration to break circular dependency
+class Conn;
+
+/* How much unsent output a subscriber may pile up before it's disconnected */
+struct PubSubLimits {
+    uint64_t hard_bytes = 32 * 1024 * 1024; // disconnected as soon as it's over this, 0 for no limit
+    uint64_t soft_bytes = 8 * 1024 * 1024; // disconnected if it stays over this for soft_seconds, 0 for no limit
+    uint64_t soft_seconds = 60;
+};
+
+/* Stats for pub/sub */
+struct PubSubStats {
+    uint64_t published = 0; // messages published
+    uint64_t delivered = 0; // messages queued on subscribers, once per subscriber
+    uint64_t slow_disconnects = 0; // subscribers disconnected for going over an output limit
+};
+
+/**
+ * Publish/subscribe messaging.
+ * 
+ * A connection subscribes to channels by name, or to patterns (see glob_match()) matched against the channel names 
+ * messages are published to. Once it has a subscription, the connection only sends (p)subscribe and (p)unsubscribe, 
+ * and receives every message published to its channels pushed as ["message", <channel>, <message>], or 
+ * ["pmessage", <pattern>, <channel>, <message>] for a pattern.
+ * 
+ * Channels and patterns each map to the HMap of their subscribers. A published message is marshalled once into a 
+ * shared buffer that every subscriber's connection holds a reference to until it's sent, so fanning out to many 
+ * subscribers costs a pointer per subscriber rather than a copy.
+ * 
+ * A subscriber that doesn't read its messages as fast as they are published is disconnected once its unsent output 
+ * goes over the hard limit, or stays over the soft limit for long enough, so it can't grow the server's memory without 
+ * bound.
+ */
+class PubSub {
+    private:
+        /* A connection subscribed to a channel or pattern */
+        struct Subscriber {
+            HNode node;
+            Conn *conn;
+        };
+
+        /* A channel or pattern with at least one subscriber */
+        struct Channel {
+            HNode node;
+            std::string name;
+            HMap subscribers;
+        };
+
+        HMap channels;
+        HMap patterns;
+        PubSubLimits limits;
+        PubSubStats stats;
+        std::vector<Conn *> slow_subscribers; // disconnected by the event loop
+
+        static bool are_channels_equal(HNode *node1, HNode *node2);
+
+        static bool are_subscribers_equal(HNode *node1, HNode *node2);
+
+        /* Returns the channel or pattern with a name in a map, NULL if it has no subscribers */
+        static Channel *find(HMap &map, const std::string &name);
+
+        /**
+         * Subscribes a connection to a channel or pattern.
+         * 
+         * @param map   Reference to the map of channels or patterns.
+         * @param conn  Pointer to the connection.
+         * @param name  The channel or pattern.
+         * 
+         * @return  True if the connection is newly subscribed.
+         *          False if it already was.
+         */
+        static bool subscribe(HMap &map, Conn *conn, const std::string &name);
+
+        /**
+         * Unsubscribes a connection from a channel or pattern, dropping it once it has no subscribers left.
+         * 
+         * @param map   Reference to the map of channels or patterns.
+         * @param conn  Pointer to the connection.
+         * @param name  The channel or pattern.
+         * 
+         * @return  True if the connection was subscribed.
+         *          False otherwise.
+         */
+        static bool unsubscribe(HMap &map, Conn *conn, const std::string &name);
+
+        /* Callback for HMap::for_each() that queues a message on a subscriber */
+        static void deliver_cb(HNode *node, void *arg);
+
+        /* Callback for HMap::for_each() that collects the patterns matching a channel */
+        static void match_cb(HNode *node, void *arg);
+
+        /**
+         * Queues a message on every subscriber of a channel or pattern.
+         * 
+         * @param channel   Pointer to the channel or pattern.
+         * @param message   The message, marshalled.
+         * 
+         * @return  The number of subscribers.
+         */
+        uint32_t deliver(Channel *channel, const std::shared_ptr<const std::string> &message);
+
+        /**
+         * Queues a message on a subscriber, marking it to be disconnected if this takes it over an output limit.
+         * 
+         * @param conn      Pointer to the subscriber's connection.
+         * @param message   The message, marshalled.
+         */
+        void deliver_to(Conn *conn, const std::shared_ptr<const std::string> &message);
+    public:
+        /* Returns the PubSub used by the event loop */
+        static PubSub &shared();
+
+        /**
+         * Handles a pub/sub command from a connection: (p)subscribe, (p)unsubscribe, or publish. Called before the 
+         * command reaches the CommandExecutor, it also rejects any other command from a connection with subscriptions.
+         * 
+         * @param conn      Pointer to the connection.
+         * @param command   The command.
+         * 
+         * @return  The response.
+         *          nullptr if it isn't a pub/sub command and the connection may run it.
+         */
+        std::unique_ptr<Response> handle_command(Conn *conn, const std::vector<std::string> &command);
+
+        /**
+         * Publishes a message to a channel.
+         * 
+         * @param channel   The channel.
+         * @param message   The message.
+         * 
+         * @return  The number of subscribers it was queued on, counting a connection once per matching subscription.
+         *          -1 if the message is too big to be pushed.
+         */
+        int64_t publish(const std::string &channel, const std::string &message);
+
+        /* Drops every subscription of a connection that's closing */
+        void unsubscribe_all(Conn *conn);
+
+        /* Returns the subscribers that went over an output limit since the last call, to be disconnected */
+        std::vector<Conn *> take_slow_subscribers();
+
+        /**
+         * Sets the output limits from "<hard bytes> <soft bytes> <soft seconds>".
+         * 
+         * @param value The limits.
+         * 
+         * @return  True if the limits were set.
+         *          False if they are invalid.
+         */
+        bool set_limits(const std::string &value);
+
+        /* Returns the output limits as "<hard bytes> <soft bytes> <soft seconds>" */
+        std::string get_limits();
+
+        /* Returns the number of channels with at least one subscriber */
+        uint32_t get_num_channels();
+
+        /* Returns the number of patterns with at least one subscriber */
+        uint32_t get_num_patterns();
+
+        /* Returns the stats for pub/sub */
+        const PubSubStats &get_stats();
+};
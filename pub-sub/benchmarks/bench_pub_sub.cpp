@@ -0,0 +1,243 @@
+#include <assert.h>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../PubSub.hpp"
+#include "../../conn/Conn.hpp"
+#include "../../request/Request.hpp"
+#include "../../response/types/ArrResponse.hpp"
+#include "../../response/types/StrResponse.hpp"
+#include "../../utils/buf_utils.hpp"
+#include "../../utils/net_utils.hpp"
+#include "../../utils/time_utils.hpp"
+
+// Fans messages out to NUM_SUBSCRIBERS subscribers of one channel. First in-process, comparing publish(), which
+// marshals each message once into a buffer shared by every subscriber, against marshalling it again into each
+// subscriber's outgoing buffer. Then end to end, against a server with that many subscriber connections, reporting
+// how many messages per second reach the subscribers.
+
+const uint32_t NUM_SUBSCRIBERS = 10000;
+const uint32_t NUM_MESSAGES = 100;
+const uint32_t MESSAGE_SIZE = 64;
+const uint32_t NUM_ROUNDS = 5; // in-process
+
+void report(const char *name, uint64_t deliveries, double ms, uint64_t bytes) {
+    printf("%-22s %9lu deliveries %10.2f ms %12.0f deliveries/s %10lu bytes copied\n", name, deliveries, ms,
+           deliveries / ms * 1000, bytes);
+}
+
+void bench_remarshal(std::vector<std::unique_ptr<Conn>> &conns, const std::string &message) {
+    double ms = 0;
+    uint64_t bytes = 0;
+    for (uint32_t round = 0; round < NUM_ROUNDS; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < NUM_MESSAGES; i++) {
+            for (std::unique_ptr<Conn> &conn : conns) {
+                ArrResponse push({ new StrResponse("message"), new StrResponse("channel"), new StrResponse(message) });
+                push.marshal(conn->outgoing);
+            }
+        }
+        ms += elapsed_ms(start);
+
+        for (std::unique_ptr<Conn> &conn : conns) {
+            bytes += conn->outgoing.size();
+            conn->outgoing.reset();
+        }
+    }
+    report("re-marshal per conn", (uint64_t) NUM_ROUNDS * NUM_MESSAGES * conns.size(), ms, bytes);
+}
+
+void bench_shared(std::vector<std::unique_ptr<Conn>> &conns, const std::string &message) {
+    double ms = 0;
+    uint64_t bytes = 0;
+    for (uint32_t round = 0; round < NUM_ROUNDS; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < NUM_MESSAGES; i++) {
+            assert(PubSub::shared().publish("channel", message) == (int64_t) conns.size());
+        }
+        ms += elapsed_ms(start);
+
+        bytes += conns[0]->shared_replies_size; // the same buffers are queued on every conn
+        for (std::unique_ptr<Conn> &conn : conns) {
+            conn->shared_replies.clear();
+            conn->shared_replies_size = 0;
+        }
+    }
+    report("shared buffer", (uint64_t) NUM_ROUNDS * NUM_MESSAGES * conns.size(), ms, bytes);
+}
+
+void bench_in_process() {
+    std::string message(MESSAGE_SIZE, 'x');
+    std::vector<std::unique_ptr<Conn>> conns;
+    for (uint32_t i = 0; i < NUM_SUBSCRIBERS; i++) {
+        conns.push_back(std::make_unique<Conn>(1000 + i, true, false, false));
+    }
+
+    bench_remarshal(conns, message);
+
+    // subscribing logs a line per conn, keep it out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    for (std::unique_ptr<Conn> &conn : conns) {
+        PubSub::shared().handle_command(conn.get(), { "subscribe", "channel" });
+    }
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    close(devnull);
+
+    bench_shared(conns, message);
+    for (std::unique_ptr<Conn> &conn : conns) {
+        PubSub::shared().unsubscribe_all(conn.get());
+    }
+}
+
+/* Starts the server in a directory of its own and waits for it to accept connections */
+pid_t start_server(uint32_t port, std::string &dir) {
+    char path[PATH_MAX];
+    assert(realpath("./server", path) != NULL);
+    char dir_template[] = "/tmp/bench_pub_sub_XXXXXX";
+    assert(mkdtemp(dir_template) != NULL);
+    dir = dir_template;
+
+    pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        std::string port_str = std::to_string(port);
+        char *argv[] = { path, port_str.data(), NULL };
+        if (chdir(dir_template) == 0) {
+            execv(path, argv);
+        }
+        _exit(1);
+    }
+    return pid;
+}
+
+/* Opens a blocking connection to 127.0.0.1, retrying while the server starts */
+int connect_to(uint32_t port) {
+    struct addrinfo hints = {}, *res;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    assert(getaddrinfo("127.0.0.1", std::to_string(port).data(), &hints, &res) == 0);
+    int fd = -1;
+    for (int i = 0; i < 1000 && fd == -1; i++) {
+        fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        assert(fd != -1);
+        if (connect(fd, res->ai_addr, res->ai_addrlen) == -1) {
+            close(fd);
+            fd = -1;
+            usleep(10 * 1000);
+        }
+    }
+    assert(fd != -1);
+    freeaddrinfo(res);
+    return fd;
+}
+
+/* Sends a request and waits for its reply */
+void send_command(int fd, const std::vector<std::string> &command) {
+    Buffer buf;
+    Request(command).marshal(buf);
+    assert(send_all(fd, buf.data(), buf.size()) == 0);
+
+    char header[Response::HEADER_SIZE], body[Response::MAX_LEN];
+    assert(recv_all(fd, header, Response::HEADER_SIZE) == 1);
+    char *p = header;
+    uint32_t len;
+    read_uint32(&len, &p);
+    assert(len <= Response::MAX_LEN && recv_all(fd, body, len) == 1);
+}
+
+void bench_end_to_end() {
+    uint32_t port = 20000 + (getpid() % 1500) * 8;
+    std::string dir;
+    pid_t server = start_server(port, dir);
+
+    std::vector<int> subscribers;
+    for (uint32_t i = 0; i < NUM_SUBSCRIBERS; i++) {
+        subscribers.push_back(connect_to(port));
+        send_command(subscribers.back(), { "subscribe", "channel" });
+    }
+    int publisher = connect_to(port);
+
+    Buffer push;
+    std::string message(MESSAGE_SIZE, 'x');
+    ArrResponse({ new StrResponse("message"), new StrResponse("channel"), new StrResponse(message) }).marshal(push);
+    uint64_t expected = (uint64_t) push.size() * NUM_MESSAGES; // bytes each subscriber should receive
+
+    // every publish pipelined at once, then the subscribers are read until all of them have every message
+    Buffer publishes;
+    for (uint32_t i = 0; i < NUM_MESSAGES; i++) {
+        Request({ "publish", "channel", message }).marshal(publishes);
+    }
+
+    std::vector<struct pollfd> pollfds;
+    for (int fd : subscribers) {
+        pollfds.push_back({ fd, POLLIN, 0 });
+    }
+    std::vector<uint64_t> received(subscribers.size(), 0);
+    uint32_t done = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    assert(send_all(publisher, publishes.data(), publishes.size()) == 0);
+    char buf[64 * 1024];
+    while (done < subscribers.size()) {
+        assert(poll(pollfds.data(), pollfds.size(), 10 * 1000) > 0);
+        for (uint32_t i = 0; i < pollfds.size(); i++) {
+            if (pollfds[i].revents == 0) {
+                continue;
+            }
+            ssize_t n = recv(pollfds[i].fd, buf, sizeof(buf), 0);
+            assert(n > 0);
+            received[i] += n;
+            if (received[i] == expected) {
+                pollfds[i].fd = -1; // has everything, poll() skips it from now on
+                done++;
+            }
+        }
+    }
+    double ms = elapsed_ms(start);
+    printf("%-22s %9lu deliveries %10.2f ms %12.0f deliveries/s\n", "end to end", 
+           (uint64_t) NUM_MESSAGES * subscribers.size(), ms, NUM_MESSAGES * subscribers.size() / ms * 1000);
+
+    for (int fd : subscribers) {
+        close(fd);
+    }
+    close(publisher);
+    kill(server, SIGKILL);
+    waitpid(server, NULL, 0);
+    rmdir(dir.data());
+}
+
+int main() {
+    signal(SIGPIPE, SIG_IGN);
+
+    // a connection per subscriber
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    assert(limit.rlim_cur > NUM_SUBSCRIBERS + 100);
+
+    bench_in_process();
+    bench_end_to_end();
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+#define TEST_MODE
+
+#include <assert.h>
+
+#include "../PubSub.hpp"
+#include "../../conn/Conn.hpp"
+#include "../../response/types/ArrResponse.hpp"
+#include "../../response/types/ErrResponse.hpp"
+#include "../../response/types/IntResponse.hpp"
+#include "../../response/types/StrResponse.hpp"
+#include "../../utils/glob_utils.hpp"
+#include "../../utils/time_utils.hpp"
+
+/* Runs a command from a connection, returning the integer it's answered with */
+int64_t run_int(Conn &conn, const std::vector<std::string> &command) {
+    std::unique_ptr<Response> response = PubSub::shared().handle_command(&conn, command);
+    IntResponse *integer = dynamic_cast<IntResponse *>(response.get());
+    assert(integer != NULL);
+    return integer->get_int();
+}
+
+/* Marshals a push as a subscriber should receive it */
+std::string push_of(const std::vector<std::string> &elements) {
+    std::vector<Response *> responses;
+    for (const std::string &element : elements) {
+        responses.push_back(new StrResponse(element));
+    }
+    Buffer buf;
+    ArrResponse(responses).marshal(buf);
+    return std::string(buf.data(), buf.size());
+}
+
+void test_glob_match() {
+    assert(glob_match("*", ""));
+    assert(glob_match("*", "anything"));
+    assert(glob_match("news.*", "news.sports"));
+    assert(!glob_match("news.*", "weather.today"));
+    assert(glob_match("h?llo", "hello") && glob_match("h?llo", "hallo") && !glob_match("h?llo", "hllo"));
+    assert(glob_match("h*llo", "hllo") && glob_match("h*llo", "heeeello") && !glob_match("h*llo", "hellox"));
+    assert(glob_match("h[ae]llo", "hello") && !glob_match("h[ae]llo", "hillo"));
+    assert(glob_match("h[^e]llo", "hallo") && !glob_match("h[^e]llo", "hello"));
+    assert(glob_match("h[a-c]llo", "hbllo") && !glob_match("h[a-c]llo", "hdllo"));
+    assert(glob_match("a\\*b", "a*b") && !glob_match("a\\*b", "axb"));
+    assert(glob_match("*a*b*c*", "xxaxxbxxcxx") && !glob_match("*a*b*c*", "xxcxxbxxaxx"));
+}
+
+void test_subscribe_and_publish() {
+    PubSub &pub_sub = PubSub::shared();
+    Conn a(10, true, false, false), b(11, true, false, false), c(12, true, false, false);
+
+    assert(run_int(a, { "subscribe", "ch1", "ch2" }) == 2);
+    assert(run_int(a, { "subscribe", "ch1" }) == 2); // already subscribed
+    assert(run_int(b, { "subscribe", "ch1" }) == 1);
+    assert(run_int(c, { "psubscribe", "ch*", "other*" }) == 2);
+    assert(pub_sub.get_num_channels() == 2);
+    assert(pub_sub.get_num_patterns() == 2);
+
+    assert(run_int(a, { "publish", "ch1", "hello" }) == 3);
+    assert(a.shared_replies.size() == 1 && *a.shared_replies[0] == push_of({ "message", "ch1", "hello" }));
+    assert(b.shared_replies.size() == 1 && *b.shared_replies[0] == push_of({ "message", "ch1", "hello" }));
+    assert(c.shared_replies.size() == 1 && *c.shared_replies[0] == push_of({ "pmessage", "ch*", "ch1", "hello" }));
+    assert(a.want_write && b.want_write && c.want_write);
+
+    // marshalled once, every subscriber holds the same buffer
+    assert(a.shared_replies[0].get() == b.shared_replies[0].get());
+
+    assert(pub_sub.publish("ch2", "x") == 2);
+    assert(pub_sub.publish("nobody", "x") == 0);
+    assert(a.shared_replies.size() == 2 && b.shared_replies.size() == 1 && c.shared_replies.size() == 2);
+
+    pub_sub.unsubscribe_all(&a);
+    pub_sub.unsubscribe_all(&b);
+    pub_sub.unsubscribe_all(&c);
+    assert(pub_sub.get_num_channels() == 0);
+    assert(pub_sub.get_num_patterns() == 0);
+}
+
+void test_unsubscribe() {
+    PubSub &pub_sub = PubSub::shared();
+    Conn conn(10, true, false, false);
+
+    assert(run_int(conn, { "subscribe", "a", "b", "c" }) == 3);
+    assert(run_int(conn, { "psubscribe", "p*" }) == 4);
+    assert(run_int(conn, { "unsubscribe", "a", "missing" }) == 3);
+    assert(pub_sub.publish("a", "x") == 0);
+    assert(pub_sub.publish("b", "x") == 1);
+
+    // no names drops every subscription of that kind
+    assert(run_int(conn, { "unsubscribe" }) == 1);
+    assert(pub_sub.get_num_channels() == 0);
+    assert(run_int(conn, { "punsubscribe" }) == 0);
+    assert(pub_sub.get_num_patterns() == 0);
+    assert(!conn.is_subscribed());
+}
+
+void test_subscribed_mode() {
+    PubSub &pub_sub = PubSub::shared();
+    Conn conn(10, true, false, false);
+
+    // anything else goes on to the CommandExecutor
+    assert(pub_sub.handle_command(&conn, { "get", "key" }) == nullptr);
+
+    run_int(conn, { "subscribe", "a" });
+    std::unique_ptr<Response> response = pub_sub.handle_command(&conn, { "get", "key" });
+    assert(dynamic_cast<ErrResponse *>(response.get()) != NULL);
+
+    run_int(conn, { "unsubscribe", "a" });
+    assert(pub_sub.handle_command(&conn, { "get", "key" }) == nullptr);
+}
+
+void test_message_too_big() {
+    PubSub &pub_sub = PubSub::shared();
+    Conn conn(10, true, false, false);
+    run_int(conn, { "subscribe", "a" });
+
+    std::unique_ptr<Response> response = pub_sub.handle_command(&conn, { "publish", "a", std::string(5000, 'x') });
+    assert(dynamic_cast<ErrResponse *>(response.get()) != NULL);
+    assert(conn.shared_replies.empty());
+
+    pub_sub.unsubscribe_all(&conn);
+}
+
+void test_hard_limit() {
+    PubSub &pub_sub = PubSub::shared();
+    assert(pub_sub.set_limits("1000 0 0"));
+    uint64_t disconnects = pub_sub.get_stats().slow_disconnects;
+
+    Conn slow(10, true, false, false), other(11, true, false, false);
+    run_int(slow, { "subscribe", "a" });
+    run_int(other, { "subscribe", "b" });
+
+    uint32_t published = 0;
+    while (!slow.want_close) {
+        assert(pub_sub.publish("a", std::string(100, 'x')) == 1);
+        published++;
+    }
+    assert(published > 1 && slow.get_output_size() > 1000);
+    assert(pub_sub.get_stats().slow_disconnects == disconnects + 1);
+
+    // nothing more is queued on it while it waits to be closed
+    uint64_t size = slow.get_output_size();
+    pub_sub.publish("a", "x");
+    assert(slow.get_output_size() == size);
+
+    std::vector<Conn *> to_close = pub_sub.take_slow_subscribers();
+    assert(to_close.size() == 1 && to_close[0] == &slow);
+    assert(pub_sub.take_slow_subscribers().empty());
+    assert(!other.want_close);
+
+    pub_sub.unsubscribe_all(&slow);
+    pub_sub.unsubscribe_all(&other);
+    assert(pub_sub.set_limits("33554432 8388608 60"));
+}
+
+void test_soft_limit() {
+    PubSub &pub_sub = PubSub::shared();
+    assert(pub_sub.set_limits("0 500 10"));
+    update_cached_time();
+
+    Conn conn(10, true, false, false);
+    run_int(conn, { "subscribe", "a" });
+    for (uint32_t i = 0; i < 10; i++) {
+        pub_sub.publish("a", std::string(100, 'x'));
+    }
+
+    // over the soft limit, but not for long enough yet
+    assert(conn.get_output_size() > 500);
+    assert(conn.over_soft_limit_since_ms != 0);
+    assert(!conn.want_close);
+
+    // back under it, the clock restarts
+    conn.shared_replies.clear();
+    conn.shared_replies_size = 0;
+    pub_sub.publish("a", "x");
+    assert(conn.over_soft_limit_since_ms == 0);
+
+    // over it for the whole period
+    for (uint32_t i = 0; i < 10; i++) {
+        pub_sub.publish("a", std::string(100, 'x'));
+    }
+    assert(!conn.want_close);
+    conn.over_soft_limit_since_ms -= 10 * 1000;
+    pub_sub.publish("a", "x");
+    assert(conn.want_close);
+
+    // unsubscribing a closing subscriber takes it off the list, so it can't be closed twice
+    pub_sub.unsubscribe_all(&conn);
+    assert(pub_sub.take_slow_subscribers().empty());
+    assert(pub_sub.set_limits("33554432 8388608 60"));
+}
+
+void test_set_limits() {
+    PubSub &pub_sub = PubSub::shared();
+    assert(pub_sub.get_limits() == "33554432 8388608 60");
+    assert(pub_sub.set_limits("100 50 5"));
+    assert(pub_sub.get_limits() == "100 50 5");
+
+    assert(!pub_sub.set_limits(""));
+    assert(!pub_sub.set_limits("100 50"));
+    assert(!pub_sub.set_limits("100 50 5 1"));
+    assert(!pub_sub.set_limits("100 -1 5"));
+    assert(!pub_sub.set_limits("100 50 abc"));
+    assert(pub_sub.get_limits() == "100 50 5");
+
+    assert(pub_sub.set_limits("33554432 8388608 60"));
+}
+
+int main() {
+    test_glob_match();
+    test_subscribe_and_publish();
+    test_unsubscribe();
+    test_subscribed_mode();
+    test_message_too_big();
+    test_hard_limit();
+    test_soft_limit();
+    test_set_limits();
+
+    return 0;
+}
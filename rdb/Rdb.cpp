@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Rdb.hpp"
+#include "components/RdbReader.hpp"
+#include "components/RdbWriter.hpp"
+#include "../cluster/Cluster.hpp"
+#include "../utils/file_utils.hpp"
+#include "../utils/hash_utils.hpp"
+#include "../utils/intrusive_data_structure_utils.hpp"
+#include "../utils/log.hpp"
+#include "../utils/proc_utils.hpp"
+#include "../utils/time_utils.hpp"
+
+/* Argument for the write_entry() callback */
+struct WriteArg {
+    RdbWriter *writer;
+    time_t now_ms;
+    time_t now_unix_ms;
+};
+
+/**
+ * Callback which writes an Entry to a snapshot.
+ * 
+ * @param node  The HNode contained by the Entry.
+ * @param arg   Void pointer to a WriteArg.
+ */
+void write_entry(HNode *node, void *arg) {
+    WriteArg *write_arg = (WriteArg *) arg;
+    Entry *entry = container_of(node, Entry, node);
+
+    // monotonic times don't survive a restart, so the expiry is stored as a wall clock time
+    int64_t expiry_unix_ms = RDB_NO_EXPIRY;
+    if (entry->ttl_timer.is_expiry_set()) {
+        expiry_unix_ms = entry->ttl_timer.expiry_time_ms - write_arg->now_ms + write_arg->now_unix_ms;
+    }
+    write_arg->writer->write_entry(entry, expiry_unix_ms);
+}
+
+/**
+ * Gets the memory private to this process that has been written to, which for a forked child is the memory it had to 
+ * copy from its parent.
+ * 
+ * @return  The number of bytes. 0 if it can't be read.
+ */
+uint64_t get_private_dirty_bytes() {
+    FILE *file = fopen("/proc/self/smaps_rollup", "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    uint64_t total_kb = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        unsigned long kb;
+        if (sscanf(line, "Private_Dirty: %lu kB", &kb) == 1) {
+            total_kb += kb;
+        }
+    }
+    fclose(file);
+    return total_kb * 1024;
+}
+
+/* Entry parsed from a snapshot, not yet inserted into the kv store */
+struct LoadedEntry {
+    Entry *entry;
+    int64_t expiry_unix_ms;
+};
+
+/* Entries parsed from a section of a snapshot */
+struct LoadedSection {
+    bool ok = false; // whether the section was intact
+    std::vector<LoadedEntry> entries;
+    uint64_t expired = 0; // entries skipped because their TTL passed
+};
+
+/* Argument for the load_sections() threads */
+struct LoadArg {
+    const char *data;
+    std::vector<RdbSection> sections;
+    std::vector<LoadedSection> results; // one per section
+    std::atomic<uint32_t> next_section{0};
+    time_t now_unix_ms;
+};
+
+/**
+ * Parses a section of a snapshot.
+ * 
+ * @param data          Pointer to the contents of the file.
+ * @param section       The section.
+ * @param now_unix_ms   The current wall clock (unix) time in ms, to skip expired entries.
+ * @param result        Reference to store the parsed entries in.
+ */
+void load_section(const char *data, const RdbSection &section, time_t now_unix_ms, LoadedSection &result) {
+    if (!RdbReader::verify_section(data, section)) {
+        return;
+    }
+
+    RdbReader reader(data, section);
+    result.entries.reserve(section.num_keys);
+    uint32_t num_read = 0;
+    while (true) {
+        LoadedEntry loaded;
+        RdbReader::Status status = reader.read_entry(&loaded.entry, &loaded.expiry_unix_ms);
+        if (status == RdbReader::Status::END) {
+            break;
+        } else if (status == RdbReader::Status::CORRUPT) {
+            return;
+        }
+
+        num_read++;
+        if (loaded.expiry_unix_ms != RDB_NO_EXPIRY && loaded.expiry_unix_ms <= now_unix_ms) {
+            delete loaded.entry;
+            result.expired++;
+            continue;
+        }
+        loaded.entry->node.hval = str_hash(loaded.entry->key);
+        result.entries.push_back(loaded);
+    }
+    result.ok = num_read == section.num_keys;
+}
+
+/**
+ * Snapshot loader thread: parses sections until there are none left. Sections are handed out one at a time, so a 
+ * thread that gets big sorted sets doesn't hold the others up.
+ * 
+ * @param arg   Void pointer to the LoadArg.
+ * 
+ * @return  NULL.
+ */
+void *load_sections(void *arg) {
+    LoadArg *load_arg = (LoadArg *) arg;
+    uint32_t i;
+    while ((i = load_arg->next_section++) < load_arg->sections.size()) {
+        load_section(load_arg->data, load_arg->sections[i], load_arg->now_unix_ms, load_arg->results[i]);
+    }
+    return NULL;
+}
+
+Rdb::Rdb() {
+    last_save_ms = get_time_ms();
+}
+
+Rdb &Rdb::shared() {
+    static Rdb rdb;
+    return rdb;
+}
+
+bool Rdb::write_snapshot(HMap &kv_store, int fd, uint64_t *size) {
+    RdbWriter *writer = new RdbWriter(fd);
+    writer->write_header(kv_store.length());
+    WriteArg arg = { writer, get_time_ms(), get_unix_time_ms() };
+    kv_store.for_each(write_entry, &arg);
+    bool ok = writer->finish();
+    *size = writer->size();
+    delete writer;
+    return ok;
+}
+
+/* Argument for the write_snapshot_cb() callback */
+struct SnapshotArg {
+    HMap *kv_store;
+    uint64_t size;
+};
+
+/* Callback for write_file_atomically() that writes a snapshot of the kv store */
+static bool write_snapshot_cb(int fd, void *arg) {
+    SnapshotArg *snapshot_arg = (SnapshotArg *) arg;
+    return Rdb::write_snapshot(*snapshot_arg->kv_store, fd, &snapshot_arg->size);
+}
+
+bool Rdb::write_file(HMap &kv_store, const std::string &path) {
+    SnapshotArg arg = { &kv_store, 0 };
+    if (!write_file_atomically(path, write_snapshot_cb, &arg)) {
+        log("failed to save snapshot to '%s': %s", path.data(), strerror(errno));
+        return false;
+    }
+
+    log("saved %u keys (%lu bytes) to '%s'", kv_store.length(), arg.size, path.data());
+    return true;
+}
+
+bool Rdb::save(HMap &kv_store) {
+    if (child_pid != -1) {
+        log("save: bgsave already in progress");
+        return false;
+    }
+
+    uint64_t changes = stats.changes_since_last_save;
+    if (!write_file(kv_store, filename)) {
+        return false;
+    }
+    record_save(changes);
+    return true;
+}
+
+/* Argument for the bgsave_child() task */
+struct BgsaveArg {
+    HMap *kv_store;
+    const std::string *filename;
+    int report_fd; // write end of the pipe to the parent
+};
+
+/* Task for the bgsave child: writes the kv store as of the fork, then reports how much memory had to be copied */
+static bool bgsave_child(void *arg) {
+    BgsaveArg *bgsave_arg = (BgsaveArg *) arg;
+    bool ok = Rdb::write_file(*bgsave_arg->kv_store, *bgsave_arg->filename);
+    uint64_t cow_bytes = get_private_dirty_bytes();
+    if (write(bgsave_arg->report_fd, &cow_bytes, sizeof(cow_bytes)) == -1) {
+        log("bgsave: failed to report copy-on-write size");
+    }
+    return ok;
+}
+
+bool Rdb::bgsave(HMap &kv_store) {
+    if (child_pid != -1) {
+        log("bgsave: bgsave already in progress");
+        return false;
+    }
+
+    int fds[2];
+    if (pipe(fds) == -1) {
+        log("bgsave: failed to create pipe: %s", strerror(errno));
+        return false;
+    }
+
+    last_bgsave_try_ms = get_time_ms();
+    BgsaveArg arg = { &kv_store, &filename, fds[1] };
+    pid_t pid = fork_child(bgsave_child, &arg);
+    if (pid == -1) {
+        log("bgsave: failed to fork: %s", strerror(errno));
+        close(fds[0]);
+        close(fds[1]);
+        stats.last_bgsave_ok = false;
+        return false;
+    }
+
+    close(fds[1]);
+    child_fd = fds[0];
+    child_pid = pid;
+    bgsave_start_ms = get_time_ms();
+    changes_at_bgsave = stats.changes_since_last_save;
+    stats.bgsave_in_progress = true;
+    log("bgsave: started child %d", pid);
+    return true;
+}
+
+void Rdb::finish_bgsave(bool ok) {
+    uint64_t cow_bytes = 0;
+    if (read(child_fd, &cow_bytes, sizeof(cow_bytes)) == sizeof(cow_bytes)) {
+        stats.last_cow_bytes = cow_bytes;
+    }
+    close(child_fd);
+    child_fd = -1;
+    child_pid = -1;
+
+    stats.bgsave_in_progress = false;
+    stats.last_bgsave_ok = ok;
+    stats.last_bgsave_ms = get_time_ms() - bgsave_start_ms;
+    if (ok) {
+        record_save(changes_at_bgsave);
+    }
+    log("bgsave: %s in %ld ms, %lu bytes copied on write", ok ? "done" : "failed", stats.last_bgsave_ms, cow_bytes);
+}
+
+void Rdb::record_save(uint64_t changes_at_save) {
+    // writes made while a bgsave was running aren't in its snapshot
+    stats.changes_since_last_save -= changes_at_save;
+    stats.last_save_time = get_unix_time_ms() / 1000;
+    stats.saves++;
+    last_save_ms = get_time_ms();
+}
+
+bool Rdb::load(HMap &kv_store, TimerManager &timers, Evictor &evictor) {
+    int fd = open(filename.data(), O_RDONLY);
+    if (fd == -1) {
+        if (errno == ENOENT) {
+            log("no snapshot to load at '%s'", filename.data());
+            return true;
+        }
+        log("failed to open snapshot '%s': %s", filename.data(), strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        log("snapshot '%s' is empty or can't be read", filename.data());
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log("failed to map snapshot '%s': %s", filename.data(), strerror(errno));
+        return false;
+    }
+    madvise(map, st.st_size, MADV_WILLNEED); // start reading ahead while the index is checked
+
+    bool ok = load_snapshot((const char *) map, st.st_size, kv_store, timers, evictor);
+    munmap(map, st.st_size); // entries hold copies of their keys and values
+    if (!ok) {
+        log("snapshot '%s' is corrupt", filename.data());
+    }
+    return ok;
+}
+
+bool Rdb::load_snapshot(const char *data, size_t len, HMap &kv_store, TimerManager &timers, Evictor &evictor) {
+    time_t start_ms = get_time_ms();
+    LoadArg arg;
+    arg.data = data;
+    arg.now_unix_ms = get_unix_time_ms();
+    uint64_t num_keys;
+    if (!RdbReader::read_index(arg.data, len, &num_keys, &arg.sections)) {
+        return false;
+    }
+    arg.results.resize(arg.sections.size());
+
+    uint32_t num_threads = std::max(1L, std::min((long) arg.sections.size(), sysconf(_SC_NPROCESSORS_ONLN)));
+    std::vector<pthread_t> threads(num_threads);
+    for (pthread_t &thread : threads) {
+        if (pthread_create(&thread, NULL, load_sections, &arg) != 0) {
+            fatal("failed to create snapshot loader thread");
+        }
+    }
+    for (pthread_t thread : threads) {
+        pthread_join(thread, NULL);
+    }
+
+    bool ok = true;
+    for (const LoadedSection &result : arg.results) {
+        ok = ok && result.ok;
+    }
+    if (!ok) {
+        for (const LoadedSection &result : arg.results) {
+            for (const LoadedEntry &loaded : result.entries) {
+                delete loaded.entry;
+            }
+        }
+        return false;
+    }
+
+    // inserting is cheap once the entries are built, and the kv store, timers, and evictor are single-threaded
+    kv_store.reserve(kv_store.length() + num_keys);
+    uint64_t loaded_keys = 0, expired_keys = 0;
+    for (const LoadedSection &result : arg.results) {
+        for (const LoadedEntry &loaded : result.entries) {
+            Entry *entry = loaded.entry;
+            evictor.init_access(entry);
+            kv_store.insert(&entry->node);
+            Cluster::shared().add_key(entry);
+            update_entry_memory(entry);
+            if (loaded.expiry_unix_ms != RDB_NO_EXPIRY) {
+                entry->ttl_timer.set_expiry_at(unix_to_monotonic_ms(loaded.expiry_unix_ms), &timers);
+            }
+        }
+        loaded_keys += result.entries.size();
+        expired_keys += result.expired;
+    }
+
+    log("loaded %lu keys from a snapshot in %ld ms with %u threads, skipped %lu expired keys", loaded_keys, 
+        get_time_ms() - start_ms, num_threads, expired_keys);
+    return true;
+}
+
+void Rdb::cron(HMap &kv_store) {
+    if (child_pid != -1) {
+        ChildState state = reap_child(child_pid, "bgsave");
+        if (state != ChildState::RUNNING) {
+            finish_bgsave(state == ChildState::SUCCEEDED);
+        }
+        return;
+    }
+
+    time_t now_ms = get_time_ms();
+    if (!stats.last_bgsave_ok && now_ms - last_bgsave_try_ms < BGSAVE_RETRY_MS) {
+        return;
+    }
+
+    for (const SavePoint &point : save_points) {
+        if (stats.changes_since_last_save >= point.changes && now_ms - last_save_ms >= point.seconds * 1000) {
+            log("%lu changes in %ld seconds, saving", stats.changes_since_last_save, point.seconds);
+            bgsave(kv_store);
+            return;
+        }
+    }
+}
+
+bool Rdb::needs_cron() {
+    return child_pid != -1 || (stats.changes_since_last_save > 0 && !save_points.empty());
+}
+
+void Rdb::add_changes(uint64_t n) {
+    stats.changes_since_last_save += n;
+}
+
+bool Rdb::set_save_points(const std::string &value) {
+    std::vector<SavePoint> points;
+    std::istringstream stream(value);
+    std::string seconds, changes;
+    while (stream >> seconds) {
+        if (!(stream >> changes)) {
+            return false;
+        }
+
+        char *end1, *end2;
+        long long s = strtoll(seconds.data(), &end1, 10);
+        long long c = strtoll(changes.data(), &end2, 10);
+        if (*end1 != '\0' || *end2 != '\0' || s < 0 || c < 1) {
+            return false;
+        }
+        points.push_back({ (time_t) s, (uint64_t) c });
+    }
+
+    save_points = points;
+    return true;
+}
+
+std::string Rdb::get_save_points() {
+    std::string value;
+    for (const SavePoint &point : save_points) {
+        if (!value.empty()) {
+            value += " ";
+        }
+        value += std::to_string(point.seconds) + " " + std::to_string(point.changes);
+    }
+    return value;
+}
+
+void Rdb::set_filename(const std::string &filename) {
+    this->filename = filename;
+}
+
+const std::string &Rdb::get_filename() {
+    return filename;
+}
+
+const RdbStats &Rdb::get_stats() {
+    return stats;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "../entry/Entry.hpp"
+#include "../evictor/Evictor.hpp"
+#include "../hashmap/HMap.hpp"
+#include "../timers/TimerManager.hpp"
+
+/* Condition for an automatic bgsave: at least changes writes and at least seconds since the last save */
+struct SavePoint {
+    time_t seconds;
+    uint64_t changes;
+};
+
+/* Stats for saving snapshots */
+struct RdbStats {
+    uint64_t changes_since_last_save = 0; // writes that aren't in the last snapshot
+    bool bgsave_in_progress = false;
+    time_t last_save_time = 0; // wall clock (unix) time in seconds of the last successful save, 0 if never
+    bool last_bgsave_ok = true;
+    time_t last_bgsave_ms = 0; // how long the last bgsave took
+    uint64_t last_cow_bytes = 0; // memory the last bgsave's child had to copy because it was written to meanwhile
+    uint64_t saves = 0; // successful saves
+};
+
+/**
+ * Saves point-in-time snapshots of the kv store to a file and loads them back at startup.
+ * 
+ * bgsave forks, and the child writes the snapshot while the parent keeps serving. The child sees the kv store as it was 
+ * at the fork; the kernel copies a page only when the parent writes to it (copy-on-write), so the snapshot costs memory 
+ * in proportion to how much is written during the save rather than to the size of the kv store. Snapshots are written 
+ * to a temporary file then renamed over the old one, so a crash mid-save never leaves a partial snapshot behind.
+ * 
+ * Saves are also triggered automatically from the event loop when any of the save points is reached.
+ */
+class Rdb {
+    private:
+        static const uint32_t BGSAVE_RETRY_MS = 5000; // wait before an automatic bgsave is retried after a failure
+
+        std::string filename = "dump.rdb";
+        std::vector<SavePoint> save_points = { { 3600, 1 }, { 300, 100 }, { 60, 10000 } };
+        pid_t child_pid = -1; // bgsave child, -1 if there is none
+        int child_fd = -1; // read end of the pipe the child reports its copy-on-write size on
+        time_t bgsave_start_ms = 0;
+        uint64_t changes_at_bgsave = 0; // changes_since_last_save when the bgsave started
+        time_t last_save_ms; // monotonic time of the last successful save, or of startup
+        time_t last_bgsave_try_ms = 0;
+        RdbStats stats;
+
+        /**
+         * Handles the bgsave child exiting.
+         * 
+         * @param ok    Whether the child saved the snapshot.
+         */
+        void finish_bgsave(bool ok);
+
+        /* Records a successful save of everything up to changes_at_save */
+        void record_save(uint64_t changes_at_save);
+    public:
+        static const uint32_t CRON_INTERVAL_MS = 100; // how often cron() should run while it has work to do
+
+        Rdb();
+
+        /* Returns the Rdb used by the event loop */
+        static Rdb &shared();
+
+        /**
+         * Writes a snapshot of the kv store to an open file, starting at its current offset.
+         * 
+         * Only reads the kv store, so it's safe to call from a forked child.
+         * 
+         * @param kv_store  Reference to the kv store.
+         * @param fd        The file. Not synced or closed.
+         * @param size      Pointer to store the number of bytes written in.
+         * 
+         * @return  True on success.
+         *          False if a write failed.
+         */
+        static bool write_snapshot(HMap &kv_store, int fd, uint64_t *size);
+
+        /**
+         * Writes a snapshot of the kv store to a file. The snapshot is written to a temporary file and renamed to path 
+         * once it's complete and synced to disk.
+         * 
+         * Only reads the kv store, so it's safe to call from a forked child.
+         * 
+         * @param kv_store  Reference to the kv store.
+         * @param path      Path of the file.
+         * 
+         * @return  True on success.
+         *          False if the file couldn't be written.
+         */
+        static bool write_file(HMap &kv_store, const std::string &path);
+
+        /**
+         * Saves a snapshot of the kv store in the foreground, blocking until it's written.
+         * 
+         * @param kv_store  Reference to the kv store.
+         * 
+         * @return  True on success.
+         *          False if the snapshot couldn't be written.
+         */
+        bool save(HMap &kv_store);
+
+        /**
+         * Starts saving a snapshot of the kv store in a forked child. cron() finishes the bgsave once the child exits.
+         * 
+         * @param kv_store  Reference to the kv store.
+         * 
+         * @return  True if the child was started.
+         *          False if a bgsave is already in progress or the fork failed.
+         */
+        bool bgsave(HMap &kv_store);
+
+        /**
+         * Loads the snapshot file into the kv store. Keys whose TTL passed while the server was down are skipped.
+         * 
+         * The file is mapped into memory and its sections are parsed in parallel by one thread per CPU, then the parsed 
+         * entries are inserted into the kv store, which is sized up front from the key count in the header so it 
+         * never resizes or rehashes while loading.
+         * 
+         * @param kv_store  Reference to the kv store.
+         * @param timers    Reference to the timer manager.
+         * @param evictor   Reference to the evictor.
+         * 
+         * @return  True if the snapshot was loaded or there is no snapshot file.
+         *          False if the snapshot file is corrupt.
+         */
+        bool load(HMap &kv_store, TimerManager &timers, Evictor &evictor);
+
+        /**
+         * Loads a snapshot held in memory into the kv store, the same way as load(). Offsets in the snapshot are 
+         * relative to data, so it can be embedded in a bigger file (e.g. as the preamble of the append-only file).
+         * 
+         * @param data      Pointer to the snapshot.
+         * @param len       Length of the snapshot.
+         * @param kv_store  Reference to the kv store.
+         * @param timers    Reference to the timer manager.
+         * @param evictor   Reference to the evictor.
+         * 
+         * @return  True on success.
+         *          False if the snapshot is corrupt, in which case the kv store is unchanged.
+         */
+        static bool load_snapshot(const char *data, size_t len, HMap &kv_store, TimerManager &timers, Evictor &evictor);
+
+        /**
+         * Reaps a finished bgsave child, then starts a bgsave if a save point has been reached. Called from the event 
+         * loop.
+         * 
+         * @param kv_store  Reference to the kv store.
+         */
+        void cron(HMap &kv_store);
+
+        /* Returns whether cron() has work to do: a bgsave is in progress or there are changes to save */
+        bool needs_cron();
+
+        /* Records writes to the kv store since the last save */
+        void add_changes(uint64_t n);
+
+        /**
+         * Sets the save points from a string of "<seconds> <changes>" pairs. An empty string disables automatic saves.
+         * 
+         * @param value The save points.
+         * 
+         * @return  True on success.
+         *          False if the string is malformed, in which case the save points are unchanged.
+         */
+        bool set_save_points(const std::string &value);
+
+        /* Returns the save points as a string of "<seconds> <changes>" pairs */
+        std::string get_save_points();
+
+        /* Sets the path of the snapshot file */
+        void set_filename(const std::string &filename);
+
+        /* Returns the path of the snapshot file */
+        const std::string &get_filename();
+
+        /* Returns the stats for saving snapshots */
+        const RdbStats &get_stats();
+};
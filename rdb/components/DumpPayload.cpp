@@ -0,0 +1,111 @@
+#include <cstring>
+
+#include "DumpPayload.hpp"
+#include "RdbReader.hpp"
+#include "../../utils/checksum_utils.hpp"
+
+static const uint32_t DUMP_TRAILER_SIZE = sizeof(uint8_t) + sizeof(uint32_t); // version and CRC-32
+static const uint32_t DUMP_TTL_OFFSET = sizeof(uint8_t); // after the type
+static const uint32_t DUMP_COUNT_OFFSET = sizeof(uint8_t) + sizeof(int64_t) + sizeof(uint32_t); // value after the header
+
+/* Appends the bytes of a value to a payload */
+template <typename T>
+void append_value(std::string &payload, const T &value) {
+    payload.append((const char *) &value, sizeof(value));
+}
+
+DumpWriter::DumpWriter(EntryType type, int64_t ttl_ms) {
+    uint8_t rdb_type = type == EntryType::STR ? RDB_TYPE_STR : RDB_TYPE_ZSET;
+    uint32_t key_len = 0;
+    append_value(payload, rdb_type);
+    append_value(payload, ttl_ms);
+    append_value(payload, key_len);
+    if (type == EntryType::SORTED_SET) {
+        append_value(payload, pairs); // patched by finish()
+    }
+}
+
+void DumpWriter::set_str(const char *data, uint32_t len) {
+    append_value(payload, len);
+    payload.append(data, len);
+}
+
+void DumpWriter::add_pair(const SPairView &pair) {
+    append_value(payload, pair.score);
+    append_value(payload, pair.len);
+    payload.append(pair.name, pair.len);
+    pairs++;
+}
+
+void DumpWriter::set_ttl(int64_t ttl_ms) {
+    memcpy(payload.data() + DUMP_TTL_OFFSET, &ttl_ms, sizeof(ttl_ms));
+}
+
+size_t DumpWriter::size() {
+    return payload.size() + DUMP_TRAILER_SIZE;
+}
+
+std::string DumpWriter::finish() {
+    if (payload[0] == RDB_TYPE_ZSET) {
+        memcpy(payload.data() + DUMP_COUNT_OFFSET, &pairs, sizeof(pairs));
+    }
+
+    append_value(payload, RDB_VERSION);
+    uint32_t crc = crc32_update(0, payload.data(), payload.size());
+    append_value(payload, crc);
+    return std::move(payload);
+}
+
+/* Callback which adds a sorted set pair to a DumpWriter */
+void add_pair_to_dump(const SPairView &pair, void *arg) {
+    ((DumpWriter *) arg)->add_pair(pair);
+}
+
+std::string dump_entry(Entry *entry, int64_t ttl_ms) {
+    DumpWriter writer(entry->type, ttl_ms);
+    if (entry->type == EntryType::STR) {
+        writer.set_str(entry->str.data(), entry->str.size());
+    } else {
+        entry->zset.for_each(add_pair_to_dump, &writer);
+    }
+    return writer.finish();
+}
+
+bool read_dump(const std::string &payload, Entry **entry, int64_t *ttl_ms) {
+    if (payload.size() < DUMP_TRAILER_SIZE) {
+        return false;
+    }
+
+    size_t entry_len = payload.size() - DUMP_TRAILER_SIZE;
+    uint8_t version = payload[entry_len];
+    uint32_t crc;
+    memcpy(&crc, payload.data() + entry_len + sizeof(version), sizeof(crc));
+    if (version != RDB_VERSION || crc32_update(0, payload.data(), entry_len + sizeof(version)) != crc) {
+        return false;
+    }
+
+    // a payload holds exactly one entry, so it's read as a section of one
+    RdbSection section = { 0, entry_len, 1, 0 };
+    RdbReader reader(payload.data(), section);
+    Entry *read = NULL;
+    if (reader.read_entry(&read, ttl_ms) != RdbReader::Status::ENTRY) {
+        return false;
+    }
+
+    Entry *extra = NULL;
+    int64_t extra_ttl;
+    if (reader.read_entry(&extra, &extra_ttl) != RdbReader::Status::END) {
+        delete read;
+        delete extra;
+        return false;
+    }
+
+    // what's left of a TTL is never negative
+    if (*ttl_ms < 0 && *ttl_ms != RDB_NO_EXPIRY) {
+        delete read;
+        return false;
+    }
+
+    *entry = read;
+    return true;
+}
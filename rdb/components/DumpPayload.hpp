@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "RdbFormat.hpp"
+#include "../../entry/Entry.hpp"
+
+/**
+ * Serialized value of a single key, as produced by dump and consumed by restore. Layout: 
+ * +----------------------------------+--------------+-------------+ 
+ * | entry (see RdbFormat.hpp)        | version (1B) | CRC-32 (4B) | 
+ * +----------------------------------+--------------+-------------+
+ * 
+ * The entry is encoded exactly as in a snapshot, except that its key is left empty (restore is given the key) and its 
+ * expiry holds the remaining TTL in ms rather than a unix time, so the payload means the same thing on a server whose 
+ * clock differs. The version is the snapshot format's and the CRC-32 covers everything before it.
+ * 
+ * A value too big for one payload is split into several: the first holds the TTL and the start of the value, and each 
+ * later one holds more of the value (more bytes of a string, more pairs of a sorted set) to be appended to it.
+ */
+class DumpWriter {
+    private:
+        std::string payload;
+        uint32_t pairs = 0;
+    public:
+        /**
+         * Starts a payload.
+         * 
+         * @param type      The type of the value.
+         * @param ttl_ms    The remaining TTL in ms, RDB_NO_EXPIRY if the key has none.
+         */
+        DumpWriter(EntryType type, int64_t ttl_ms);
+
+        /**
+         * Sets the bytes of a string value. Only valid for a string payload.
+         * 
+         * @param data  Pointer to the bytes.
+         * @param len   The number of bytes.
+         */
+        void set_str(const char *data, uint32_t len);
+
+        /**
+         * Adds a pair to a sorted set value. Only valid for a sorted set payload.
+         * 
+         * @param pair  The pair.
+         */
+        void add_pair(const SPairView &pair);
+
+        /**
+         * Changes the TTL of the payload.
+         * 
+         * @param ttl_ms    The remaining TTL in ms, RDB_NO_EXPIRY if the key has none.
+         */
+        void set_ttl(int64_t ttl_ms);
+
+        /* Returns the size the payload would be if finished now */
+        size_t size();
+
+        /**
+         * Finishes the payload.
+         * 
+         * @return  The payload.
+         */
+        std::string finish();
+};
+
+/**
+ * Serializes an Entry into a payload.
+ * 
+ * @param entry     Pointer to the Entry.
+ * @param ttl_ms    The Entry's remaining TTL in ms, RDB_NO_EXPIRY if it has none.
+ * 
+ * @return  The payload.
+ */
+std::string dump_entry(Entry *entry, int64_t ttl_ms);
+
+/**
+ * Deserializes a payload into a new Entry. The Entry's key, hash map node, timers, and memory are not set up.
+ * 
+ * @param payload   The payload.
+ * @param entry     Pointer to store the new Entry in. The caller is responsible for deleting it.
+ * @param ttl_ms    Pointer to store the remaining TTL in ms in, RDB_NO_EXPIRY if the key had none.
+ * 
+ * @return  True on success.
+ *          False if the payload is malformed (including a negative TTL), from another version, or fails its checksum.
+ */
+bool read_dump(const std::string &payload, Entry **entry, int64_t *ttl_ms);
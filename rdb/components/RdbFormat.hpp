@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Layout of a snapshot file:
+ * +------------+--------------+---------------+----------+-----+----------+-------+-------------------+-------------+
+ * | magic (5B) | version (1B) | num keys (8B) | section  | ... | EOF (1B) | index | index offset (8B) | CRC-32 (4B) |
+ * +------------+--------------+---------------+----------+-----+----------+-------+-------------------+-------------+
+ * 
+ * The entries are split into sections of about RDB_SECTION_SIZE bytes, so a loader can parse them in parallel. Each 
+ * entry:
+ * +-----------+----------------------+-------------------+-----+-------+
+ * | type (1B) | expiry unix ms (8B)  | key length (4B)   | key | value |
+ * +-----------+----------------------+-------------------+-----+-------+
+ * 
+ * A string value is its length (4B) then its bytes. A sorted set value is its number of pairs (4B) then each pair as 
+ * score (8B), name length (4B), name, from low to high. The expiry is -1 if the key has no TTL.
+ * 
+ * The index is the number of sections (4B) then an RdbSection for each, in file order. The index offset is where the 
+ * index starts. Each section has its own CRC-32 in the index, and the CRC-32 at the end of the file covers the header 
+ * and everything from the EOF byte onward, so every byte is checked and the sections can be checked in parallel. 
+ * Integers and doubles are stored in the machine's byte order.
+ */
+
+static const char RDB_MAGIC[] = "MYRDB";
+static const uint32_t RDB_MAGIC_LEN = 5;
+static const uint8_t RDB_VERSION = 2;
+static const uint32_t RDB_HEADER_SIZE = RDB_MAGIC_LEN + sizeof(uint8_t) + sizeof(uint64_t);
+static const uint32_t RDB_FOOTER_SIZE = sizeof(uint64_t) + sizeof(uint32_t); // index offset and CRC-32
+static const uint64_t RDB_SECTION_SIZE = 4 * 1024 * 1024;
+static const int64_t RDB_NO_EXPIRY = -1;
+
+/* Tag at the start of each entry, or after the last section */
+enum RdbOpcode : uint8_t {
+    RDB_TYPE_STR = 0,
+    RDB_TYPE_ZSET = 1,
+    RDB_EOF = 0xff
+};
+
+/* Index entry of a run of whole entries */
+struct RdbSection {
+    uint64_t offset; // where the section starts in the file
+    uint64_t len;
+    uint32_t num_keys;
+    uint32_t crc; // CRC-32 of the section's bytes
+};
+
+static const uint32_t RDB_SECTION_INDEX_SIZE = 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
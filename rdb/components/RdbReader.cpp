@@ -0,0 +1,141 @@
+#include <cstring>
+#include <vector>
+
+#include "RdbReader.hpp"
+#include "../../utils/buf_utils.hpp"
+#include "../../utils/checksum_utils.hpp"
+
+bool RdbReader::has(size_t n) {
+    return len - pos >= n;
+}
+
+bool RdbReader::read_index(const char *data, size_t len, uint64_t *num_keys, std::vector<RdbSection> *sections) {
+    if (len < RDB_HEADER_SIZE + sizeof(uint8_t) + sizeof(uint32_t) + RDB_FOOTER_SIZE || 
+        memcmp(data, RDB_MAGIC, RDB_MAGIC_LEN) != 0) {
+        return false;
+    }
+
+    char *src = (char *) data + RDB_MAGIC_LEN;
+    uint8_t version;
+    read_uint8(&version, &src);
+    read_int64((int64_t *) num_keys, &src);
+    if (version != RDB_VERSION) {
+        return false;
+    }
+
+    uint64_t index_offset;
+    uint32_t expected;
+    src = (char *) data + len - RDB_FOOTER_SIZE;
+    read_int64((int64_t *) &index_offset, &src);
+    read_uint32(&expected, &src);
+    if (index_offset < RDB_HEADER_SIZE + sizeof(uint8_t) || index_offset > len - RDB_FOOTER_SIZE - sizeof(uint32_t) || 
+        (uint8_t) data[index_offset - 1] != RDB_EOF) {
+        return false;
+    }
+
+    // the sections are checked separately, see verify_section()
+    uint32_t crc = crc32_update(0, data, RDB_HEADER_SIZE);
+    crc = crc32_update(crc, data + index_offset - 1, len - sizeof(uint32_t) - (index_offset - 1));
+    if (crc != expected) {
+        return false;
+    }
+
+    uint32_t num_sections;
+    src = (char *) data + index_offset;
+    read_uint32(&num_sections, &src);
+    if ((len - RDB_FOOTER_SIZE - (index_offset + sizeof(uint32_t))) != (uint64_t) num_sections * RDB_SECTION_INDEX_SIZE) {
+        return false;
+    }
+
+    // the sections must follow one another from the header to the EOF byte
+    uint64_t next_offset = RDB_HEADER_SIZE;
+    uint64_t total_keys = 0;
+    sections->clear();
+    sections->reserve(num_sections);
+    for (uint32_t i = 0; i < num_sections; i++) {
+        RdbSection section;
+        read_int64((int64_t *) &section.offset, &src);
+        read_int64((int64_t *) &section.len, &src);
+        read_uint32(&section.num_keys, &src);
+        read_uint32(&section.crc, &src);
+        if (section.offset != next_offset || section.len > index_offset - 1 - section.offset) {
+            return false;
+        }
+        next_offset += section.len;
+        total_keys += section.num_keys;
+        sections->push_back(section);
+    }
+    return next_offset == index_offset - 1 && total_keys == *num_keys;
+}
+
+bool RdbReader::verify_section(const char *data, const RdbSection &section) {
+    return crc32_update(0, data + section.offset, section.len) == section.crc;
+}
+
+RdbReader::Status RdbReader::read_entry(Entry **entry, int64_t *expiry_unix_ms) {
+    if (pos == len) {
+        return Status::END;
+    }
+
+    char *src = (char *) data + pos;
+    uint8_t type;
+    read_uint8(&type, &src);
+    pos += 1;
+    if (type != RDB_TYPE_STR && type != RDB_TYPE_ZSET) {
+        return Status::CORRUPT;
+    }
+
+    uint32_t key_len;
+    if (!has(sizeof(int64_t) + sizeof(uint32_t))) {
+        return Status::CORRUPT;
+    }
+    read_int64(expiry_unix_ms, &src);
+    read_uint32(&key_len, &src);
+    pos = src - data;
+    if (!has(key_len + sizeof(uint32_t))) {
+        return Status::CORRUPT;
+    }
+
+    Entry *new_entry = new Entry();
+    read_str(new_entry->key, key_len, &src);
+
+    uint32_t n;
+    read_uint32(&n, &src);
+    pos = src - data;
+    if (type == RDB_TYPE_STR) {
+        new_entry->type = EntryType::STR;
+        if (!has(n)) {
+            delete new_entry;
+            return Status::CORRUPT;
+        }
+        new_entry->str.assign(src, n);
+        pos += n;
+    } else {
+        // names point into the file until insert_all() copies them
+        new_entry->type = EntryType::SORTED_SET;
+        std::vector<SPairView> pairs;
+        pairs.reserve(std::min((size_t) n, (len - pos) / (sizeof(double) + sizeof(uint32_t))));
+        for (uint32_t i = 0; i < n; i++) {
+            SPairView pair;
+            if (!has(sizeof(double) + sizeof(uint32_t))) {
+                delete new_entry;
+                return Status::CORRUPT;
+            }
+            read_dbl(&pair.score, &src);
+            read_uint32(&pair.len, &src);
+            pos = src - data;
+            if (!has(pair.len)) {
+                delete new_entry;
+                return Status::CORRUPT;
+            }
+            pair.name = src;
+            src += pair.len;
+            pos += pair.len;
+            pairs.push_back(pair);
+        }
+        new_entry->zset.insert_all(pairs);
+    }
+
+    *entry = new_entry;
+    return Status::ENTRY;
+}
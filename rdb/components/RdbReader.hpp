@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "RdbFormat.hpp"
+#include "../../entry/Entry.hpp"
+
+/**
+ * Parses a snapshot file held in memory. See RdbFormat.hpp for the layout.
+ * 
+ * A RdbReader reads the entries of one section, so the sections of a file can be parsed by several RdbReaders on 
+ * different threads. Every read is bounds checked, so a truncated or corrupted file is reported rather than read past.
+ */
+class RdbReader {
+    private:
+        const char *data;
+        size_t len;
+        size_t pos = 0; // offset of the next byte to read
+
+        /* Checks that n more bytes can be read */
+        bool has(size_t n);
+    public:
+        /* Result of reading an entry */
+        enum class Status {
+            ENTRY, // an entry was read
+            END, // the end of the section was reached
+            CORRUPT // the section is malformed
+        };
+
+        /**
+         * Initializes a RdbReader.
+         * 
+         * @param data      Pointer to the contents of the file. Must outlive the RdbReader.
+         * @param section   The section to read.
+         */
+        RdbReader(const char *data, const RdbSection &section) : data(data + section.offset), len(section.len) {}
+
+        /**
+         * Reads the header and section index of a file, checking them against the file's checksum.
+         * 
+         * @param data      Pointer to the contents of the file.
+         * @param len       Length of the file.
+         * @param num_keys  Pointer to store the number of entries in the file in.
+         * @param sections  Pointer to store the sections in, in file order.
+         * 
+         * @return  True on success.
+         *          False if the file is malformed, from an unsupported version, or its sections don't cover every entry.
+         */
+        static bool read_index(const char *data, size_t len, uint64_t *num_keys, std::vector<RdbSection> *sections);
+
+        /**
+         * Checks a section against its checksum.
+         * 
+         * @param data      Pointer to the contents of the file.
+         * @param section   The section, as returned by read_index().
+         * 
+         * @return  True if the checksum matches.
+         *          False otherwise.
+         */
+        static bool verify_section(const char *data, const RdbSection &section);
+
+        /**
+         * Reads the next entry into a new Entry. The Entry's hash map node, timers, and memory are not set up.
+         * 
+         * Sorted sets are written from low to high, so they are built in O(n) with SortedSet::insert_all().
+         * 
+         * @param entry             Pointer to store the new Entry in. The caller is responsible for deleting it.
+         * @param expiry_unix_ms    Pointer to store the wall clock (unix) time in ms the Entry expires at in, 
+         *                          RDB_NO_EXPIRY if it has no TTL.
+         * 
+         * @return  ENTRY if an entry was read.
+         *          END if the end of the section was reached.
+         *          CORRUPT if the section is malformed.
+         */
+        Status read_entry(Entry **entry, int64_t *expiry_unix_ms);
+};
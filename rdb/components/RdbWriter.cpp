@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+
+#include "RdbWriter.hpp"
+#include "../../utils/checksum_utils.hpp"
+
+void RdbWriter::append(const void *data, uint32_t n) {
+    uint32_t &checksum = in_section ? sections.back().crc : crc;
+    checksum = crc32_update(checksum, data, n);
+    written += n;
+
+    const char *bytes = (const char *) data;
+    while (n > 0) {
+        uint32_t chunk = std::min(n, BUF_SIZE - used);
+        memcpy(buf + used, bytes, chunk);
+        used += chunk;
+        bytes += chunk;
+        n -= chunk;
+        if (used == BUF_SIZE) {
+            flush();
+        }
+    }
+}
+
+void RdbWriter::flush() {
+    uint32_t pos = 0;
+    while (pos < used && !failed) {
+        ssize_t n = write(fd, buf + pos, used - pos);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed = true;
+            break;
+        }
+        pos += n;
+    }
+    used = 0;
+}
+
+void RdbWriter::end_section() {
+    if (in_section) {
+        sections.back().len = written - sections.back().offset;
+        in_section = false;
+    }
+}
+
+void RdbWriter::append_pair(const SPairView &pair, void *arg) {
+    RdbWriter *writer = (RdbWriter *) arg;
+    writer->append(&pair.score, sizeof(pair.score));
+    writer->append(&pair.len, sizeof(pair.len));
+    writer->append(pair.name, pair.len);
+}
+
+void RdbWriter::write_header(uint64_t num_keys) {
+    append(RDB_MAGIC, RDB_MAGIC_LEN);
+    append(&RDB_VERSION, sizeof(RDB_VERSION));
+    append(&num_keys, sizeof(num_keys));
+}
+
+void RdbWriter::write_entry(Entry *entry, int64_t expiry_unix_ms) {
+    if (!in_section) {
+        sections.push_back({ written, 0, 0, 0 });
+        in_section = true;
+    }
+    sections.back().num_keys++;
+
+    uint8_t type = entry->type == EntryType::STR ? RDB_TYPE_STR : RDB_TYPE_ZSET;
+    uint32_t key_len = entry->key.length();
+    append(&type, sizeof(type));
+    append(&expiry_unix_ms, sizeof(expiry_unix_ms));
+    append(&key_len, sizeof(key_len));
+    append(entry->key.data(), key_len);
+
+    if (entry->type == EntryType::STR) {
+        uint32_t len = entry->str.size();
+        append(&len, sizeof(len));
+        append(entry->str.data(), len);
+    } else {
+        uint32_t n = entry->zset.length();
+        append(&n, sizeof(n));
+        entry->zset.for_each(append_pair, this);
+    }
+
+    // sections only end between entries, so each can be parsed on its own
+    if (written - sections.back().offset >= section_size) {
+        end_section();
+    }
+}
+
+bool RdbWriter::finish() {
+    end_section();
+    uint8_t eof = RDB_EOF;
+    append(&eof, sizeof(eof));
+
+    uint64_t index_offset = written;
+    uint32_t num_sections = sections.size();
+    append(&num_sections, sizeof(num_sections));
+    for (const RdbSection &section : sections) {
+        append(&section.offset, sizeof(section.offset));
+        append(&section.len, sizeof(section.len));
+        append(&section.num_keys, sizeof(section.num_keys));
+        append(&section.crc, sizeof(section.crc));
+    }
+    append(&index_offset, sizeof(index_offset));
+
+    uint32_t checksum = crc; // the checksum doesn't cover itself
+    append(&checksum, sizeof(checksum));
+    flush();
+    return !failed;
+}
+
+uint64_t RdbWriter::size() {
+    return written;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include "RdbFormat.hpp"
+#include "../../entry/Entry.hpp"
+
+/**
+ * Serializes kv store entries into a snapshot file. See RdbFormat.hpp for the layout.
+ * 
+ * Writes are buffered so the file is written in large chunks, and the checksums are computed as the bytes go by.
+ */
+class RdbWriter {
+    private:
+        static const uint32_t BUF_SIZE = 64 * 1024;
+
+        int fd;
+        uint64_t section_size;
+        char buf[BUF_SIZE];
+        uint32_t used = 0; // bytes in buf not yet written to the file
+        uint32_t crc = 0; // CRC-32 of the bytes appended outside of sections so far
+        uint64_t written = 0; // bytes appended so far
+        bool failed = false; // whether a write to the file has failed
+        std::vector<RdbSection> sections; // index of the sections written so far
+        bool in_section = false; // whether the last section is still being written
+
+        /* Appends bytes to the file */
+        void append(const void *data, uint32_t n);
+
+        /* Writes the buffered bytes to the file */
+        void flush();
+
+        /* Ends the section being written, if any */
+        void end_section();
+
+        /* Callback which appends a sorted set pair */
+        static void append_pair(const SPairView &pair, void *arg);
+    public:
+        /**
+         * Initializes a RdbWriter.
+         * 
+         * @param fd            The file to write to. Not closed by the RdbWriter.
+         * @param section_size  The size in bytes after which a new section is started.
+         */
+        RdbWriter(int fd, uint64_t section_size = RDB_SECTION_SIZE) : fd(fd), section_size(section_size) {}
+
+        /**
+         * Writes the header.
+         * 
+         * @param num_keys  The number of entries that will be written, used by the loader to size the kv store.
+         */
+        void write_header(uint64_t num_keys);
+
+        /**
+         * Writes an Entry.
+         * 
+         * @param entry             Pointer to the Entry.
+         * @param expiry_unix_ms    The wall clock (unix) time in ms the Entry expires at, RDB_NO_EXPIRY if it has no TTL.
+         */
+        void write_entry(Entry *entry, int64_t expiry_unix_ms);
+
+        /**
+         * Writes the section index and footer, then flushes the file.
+         * 
+         * @return  True if every write succeeded.
+         *          False otherwise.
+         */
+        bool finish();
+
+        /* Returns the number of bytes written so far */
+        uint64_t size();
+};
@@ -0,0 +1,108 @@
+#include <assert.h>
+
+#include "../DumpPayload.hpp"
+
+/* Creates a string entry */
+Entry *make_str_entry(const std::string &value) {
+    Entry *entry = new Entry();
+    entry->type = EntryType::STR;
+    entry->str = value;
+    return entry;
+}
+
+/* Creates a sorted set entry with n pairs named "name<i>" with score i */
+Entry *make_zset_entry(uint32_t n) {
+    Entry *entry = new Entry();
+    entry->type = EntryType::SORTED_SET;
+    for (uint32_t i = 0; i < n; i++) {
+        std::string name = "name" + std::to_string(i);
+        entry->zset.insert(i, name.data(), name.length());
+    }
+    return entry;
+}
+
+void test_str() {
+    Entry *entry = make_str_entry("value");
+    std::string payload = dump_entry(entry, RDB_NO_EXPIRY);
+
+    Entry *restored = NULL;
+    int64_t ttl_ms;
+    assert(read_dump(payload, &restored, &ttl_ms));
+    assert(restored->type == EntryType::STR);
+    assert(restored->str == "value");
+    assert(restored->key.empty());
+    assert(ttl_ms == RDB_NO_EXPIRY);
+
+    delete entry;
+    delete restored;
+}
+
+void test_zset_with_ttl() {
+    Entry *entry = make_zset_entry(1000); // big enough to not be packed
+    std::string payload = dump_entry(entry, 5000);
+
+    Entry *restored = NULL;
+    int64_t ttl_ms;
+    assert(read_dump(payload, &restored, &ttl_ms));
+    assert(restored->type == EntryType::SORTED_SET);
+    assert(restored->zset.length() == 1000);
+    double score;
+    assert(restored->zset.lookup("name999", 7, &score) && score == 999);
+    assert(ttl_ms == 5000);
+
+    delete entry;
+    delete restored;
+}
+
+void test_writer_chunks() {
+    // a sorted set split into two payloads, as migrate sends a big one
+    DumpWriter first(EntryType::SORTED_SET, RDB_NO_EXPIRY);
+    first.add_pair({ 1, "a", 1 });
+    first.add_pair({ 2, "b", 1 });
+    size_t size = first.size();
+    std::string first_payload = first.finish();
+    assert(first_payload.size() == size);
+
+    DumpWriter last(EntryType::SORTED_SET, RDB_NO_EXPIRY);
+    last.add_pair({ 3, "c", 1 });
+    last.set_ttl(100);
+    std::string last_payload = last.finish();
+
+    Entry *restored = NULL;
+    int64_t ttl_ms;
+    assert(read_dump(first_payload, &restored, &ttl_ms));
+    assert(restored->zset.length() == 2 && ttl_ms == RDB_NO_EXPIRY);
+    delete restored;
+    assert(read_dump(last_payload, &restored, &ttl_ms));
+    assert(restored->zset.length() == 1 && ttl_ms == 100);
+    delete restored;
+}
+
+void test_corrupt() {
+    Entry *entry = make_str_entry("value");
+    std::string payload = dump_entry(entry, RDB_NO_EXPIRY);
+    Entry *restored = NULL;
+    int64_t ttl_ms;
+
+    // any flipped byte fails the checksum
+    for (size_t i = 0; i < payload.size(); i++) {
+        std::string corrupt = payload;
+        corrupt[i] ^= 1;
+        assert(!read_dump(corrupt, &restored, &ttl_ms));
+    }
+
+    assert(!read_dump(payload.substr(0, payload.size() - 1), &restored, &ttl_ms));
+    assert(!read_dump("", &restored, &ttl_ms));
+    assert(!read_dump(dump_entry(entry, -5), &restored, &ttl_ms)); // only RDB_NO_EXPIRY may be negative
+    assert(restored == NULL);
+    delete entry;
+}
+
+int main() {
+    test_str();
+    test_zset_with_ttl();
+    test_writer_chunks();
+    test_corrupt();
+
+    return 0;
+}
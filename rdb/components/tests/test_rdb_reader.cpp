@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <cstring>
+#include <unistd.h>
+
+#include "../RdbReader.hpp"
+#include "../RdbWriter.hpp"
+
+/**
+ * Writes entries to a snapshot in memory.
+ * 
+ * @param entries       The entries.
+ * @param expiries      The expiry of each entry, as a unix time in ms.
+ * @param section_size  The size in bytes after which the writer starts a new section.
+ * 
+ * @return  The bytes of the snapshot.
+ */
+std::string write_snapshot(const std::vector<Entry *> &entries, const std::vector<int64_t> &expiries, 
+                           uint64_t section_size = RDB_SECTION_SIZE) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    RdbWriter *writer = new RdbWriter(fds[1], section_size);
+    writer->write_header(entries.size());
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        writer->write_entry(entries[i], expiries[i]);
+    }
+    assert(writer->finish());
+    uint64_t size = writer->size();
+    delete writer;
+    close(fds[1]);
+
+    std::string data(size, '\0');
+    size_t pos = 0;
+    ssize_t n;
+    while ((n = read(fds[0], &data[pos], size - pos)) > 0) {
+        pos += n;
+    }
+    close(fds[0]);
+    assert(pos == size);
+    return data;
+}
+
+/* Creates a string entry */
+Entry *make_str_entry(const std::string &key, const std::string &value) {
+    Entry *entry = new Entry();
+    entry->key = key;
+    entry->type = EntryType::STR;
+    entry->str = value;
+    return entry;
+}
+
+/* Creates a sorted set entry with n pairs named "name<i>" with score i */
+Entry *make_zset_entry(const std::string &key, uint32_t n) {
+    Entry *entry = new Entry();
+    entry->key = key;
+    entry->type = EntryType::SORTED_SET;
+    for (uint32_t i = 0; i < n; i++) {
+        std::string name = "name" + std::to_string(i);
+        entry->zset.insert(i, name.data(), name.length());
+    }
+    return entry;
+}
+
+/**
+ * Reads every entry of a snapshot, checking the index and each section.
+ * 
+ * @param data      The bytes of the snapshot.
+ * @param expiries  Pointer to store the expiry of each entry in.
+ * @param sections  Pointer to store the sections in.
+ * 
+ * @return  Vector containing the entries, in file order.
+ */
+std::vector<Entry *> read_snapshot(const std::string &data, std::vector<int64_t> *expiries, 
+                                   std::vector<RdbSection> *sections) {
+    uint64_t num_keys;
+    assert(RdbReader::read_index(data.data(), data.length(), &num_keys, sections));
+
+    std::vector<Entry *> entries;
+    for (const RdbSection &section : *sections) {
+        assert(RdbReader::verify_section(data.data(), section));
+        RdbReader reader(data.data(), section);
+        Entry *entry;
+        int64_t expiry;
+        while (reader.read_entry(&entry, &expiry) == RdbReader::Status::ENTRY) {
+            entries.push_back(entry);
+            expiries->push_back(expiry);
+        }
+    }
+    assert(entries.size() == num_keys);
+    return entries;
+}
+
+/* Asserts that two entries hold the same key and value */
+void assert_same_entry(Entry *actual, Entry *expected) {
+    assert(actual->key == expected->key);
+    assert(actual->type == expected->type);
+    if (actual->type == EntryType::STR) {
+        assert(actual->str == expected->str);
+        return;
+    }
+
+    assert(actual->zset.length() == expected->zset.length());
+    for (uint32_t i = 0; i < actual->zset.length(); i++) {
+        std::string name = "name" + std::to_string(i);
+        double score;
+        assert(actual->zset.lookup(name.data(), name.length(), &score));
+        assert(score == i);
+    }
+}
+
+void test_round_trip() {
+    std::vector<Entry *> entries = { make_str_entry("str", "value"), make_str_entry("empty", ""), 
+                                     make_zset_entry("small", 5), make_zset_entry("large", 1000) };
+    std::vector<int64_t> expiries = { RDB_NO_EXPIRY, 1234567890123, RDB_NO_EXPIRY, 42 };
+    std::string data = write_snapshot(entries, expiries);
+
+    std::vector<int64_t> read_expiries;
+    std::vector<RdbSection> sections;
+    std::vector<Entry *> read_entries = read_snapshot(data, &read_expiries, &sections);
+    assert(sections.size() == 1);
+    assert(read_entries.size() == entries.size());
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        assert_same_entry(read_entries[i], entries[i]);
+        assert(read_expiries[i] == expiries[i]);
+        delete read_entries[i];
+        delete entries[i];
+    }
+}
+
+void test_sections() {
+    std::vector<Entry *> entries;
+    std::vector<int64_t> expiries;
+    for (uint32_t i = 0; i < 100; i++) {
+        entries.push_back(i % 10 == 0 ? make_zset_entry("zset" + std::to_string(i), 50) : 
+                                         make_str_entry("key" + std::to_string(i), std::string(i, 'x')));
+        expiries.push_back(i % 3 == 0 ? RDB_NO_EXPIRY : i);
+    }
+    std::string data = write_snapshot(entries, expiries, 256);
+
+    // sections only end between entries, so each holds at least one entry
+    std::vector<int64_t> read_expiries;
+    std::vector<RdbSection> sections;
+    std::vector<Entry *> read_entries = read_snapshot(data, &read_expiries, &sections);
+    assert(sections.size() > 10 && sections.size() <= 100);
+    for (const RdbSection &section : sections) {
+        assert(section.num_keys > 0);
+    }
+
+    assert(read_entries.size() == entries.size());
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        assert_same_entry(read_entries[i], entries[i]);
+        assert(read_expiries[i] == expiries[i]);
+        delete read_entries[i];
+        delete entries[i];
+    }
+}
+
+void test_empty() {
+    std::string data = write_snapshot({}, {});
+
+    uint64_t num_keys;
+    std::vector<RdbSection> sections;
+    assert(RdbReader::read_index(data.data(), data.length(), &num_keys, &sections));
+    assert(num_keys == 0);
+    assert(sections.empty());
+}
+
+void test_corrupt() {
+    std::vector<Entry *> entries = { make_str_entry("key1", "value1"), make_str_entry("key2", "value2") };
+    std::string data = write_snapshot(entries, { RDB_NO_EXPIRY, RDB_NO_EXPIRY }, 1);
+    for (Entry *entry : entries) {
+        delete entry;
+    }
+
+    uint64_t num_keys;
+    std::vector<RdbSection> sections;
+    assert(RdbReader::read_index(data.data(), data.length(), &num_keys, &sections));
+    assert(sections.size() == 2);
+    RdbSection first = sections[0];
+
+    // flipped byte in a section is caught by that section's checksum only
+    std::string flipped = data;
+    flipped[sections[1].offset + 3] ^= 1;
+    assert(RdbReader::read_index(flipped.data(), flipped.length(), &num_keys, &sections));
+    assert(RdbReader::verify_section(flipped.data(), sections[0]));
+    assert(!RdbReader::verify_section(flipped.data(), sections[1]));
+
+    // flipped byte in the header or index
+    flipped = data;
+    flipped[RDB_MAGIC_LEN + 1] ^= 1;
+    assert(!RdbReader::read_index(flipped.data(), flipped.length(), &num_keys, &sections));
+    flipped = data;
+    flipped[data.length() - RDB_FOOTER_SIZE - 2] ^= 1;
+    assert(!RdbReader::read_index(flipped.data(), flipped.length(), &num_keys, &sections));
+
+    // bad magic
+    std::string bad_magic = data;
+    bad_magic[0] = 'X';
+    assert(!RdbReader::read_index(bad_magic.data(), bad_magic.length(), &num_keys, &sections));
+
+    // truncated, at any length
+    for (size_t len = 0; len < data.length(); len++) {
+        assert(!RdbReader::read_index(data.data(), len, &num_keys, &sections));
+    }
+
+    // a section that ends in the middle of an entry must not be read past
+    RdbSection truncated = { first.offset, first.len - 3, 1, 0 };
+    RdbReader reader(data.data(), truncated);
+    Entry *entry;
+    int64_t expiry;
+    assert(reader.read_entry(&entry, &expiry) == RdbReader::Status::CORRUPT);
+}
+
+int main() {
+    test_round_trip();
+    test_sections();
+    test_empty();
+    test_corrupt();
+
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include <assert.h>
+#include <cstdio>
+#include <unistd.h>
+
+#include "../Rdb.hpp"
+#include "../../utils/hash_utils.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+#include "../../utils/time_utils.hpp"
+
+TimerManager timers;
+Evictor evictor;
+
+/* Returns a path for a snapshot file unique to this process */
+std::string temp_path(const std::string &name) {
+    return "/tmp/test_rdb_" + std::to_string(getpid()) + "_" + name + ".rdb";
+}
+
+/**
+ * Inserts an entry into the kv store.
+ * 
+ * @param kv_store          Reference to the kv store.
+ * @param entry             Pointer to the entry, with its key and value set.
+ * @param expiry_time_ms    The monotonic time in ms the entry expires at, -1 for no expiry.
+ */
+void insert_entry(HMap &kv_store, Entry *entry, time_t expiry_time_ms = -1) {
+    entry->node.hval = str_hash(entry->key);
+    kv_store.insert(&entry->node);
+    if (expiry_time_ms != -1) {
+        entry->ttl_timer.set_expiry_at(expiry_time_ms, &timers);
+    }
+}
+
+/**
+ * Gets the entry stored at a key.
+ * 
+ * @return  Pointer to the entry.
+ *          NULL if the key doesn't exist.
+ */
+Entry *get_entry(HMap &kv_store, const std::string &key) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = key;
+    lookup_entry.node.hval = str_hash(key);
+    HNode *node = kv_store.lookup(&lookup_entry.node, are_entries_equal);
+    return node == NULL ? NULL : container_of(node, Entry, node);
+}
+
+/* Fills a kv store with a string, a string with a TTL, an expired string, and a large sorted set */
+void fill_kv_store(HMap &kv_store) {
+    Entry *str = new Entry();
+    str->key = "str";
+    str->str = "value";
+    insert_entry(kv_store, str);
+
+    Entry *ttl = new Entry();
+    ttl->key = "ttl";
+    ttl->str = "soon";
+    insert_entry(kv_store, ttl, get_time_ms() + 100000);
+
+    Entry *expired = new Entry();
+    expired->key = "expired";
+    expired->str = "gone";
+    insert_entry(kv_store, expired, get_time_ms() - 1000);
+
+    Entry *zset = new Entry();
+    zset->key = "zset";
+    zset->type = EntryType::SORTED_SET;
+    for (uint32_t i = 0; i < 500; i++) {
+        std::string name = "name" + std::to_string(i);
+        zset->zset.insert(i, name.data(), name.length());
+    }
+    insert_entry(kv_store, zset);
+}
+
+/* Checks that a kv store holds what fill_kv_store() put in it, minus the expired string */
+void check_kv_store(HMap &kv_store) {
+    assert(kv_store.length() == 3);
+
+    Entry *str = get_entry(kv_store, "str");
+    assert(str != NULL && str->type == EntryType::STR && str->str == "value");
+    assert(!str->ttl_timer.is_expiry_set());
+
+    Entry *ttl = get_entry(kv_store, "ttl");
+    assert(ttl != NULL && ttl->str == "soon");
+    assert(ttl->ttl_timer.is_expiry_set());
+    time_t remaining = ttl->ttl_timer.expiry_time_ms - get_time_ms();
+    assert(remaining > 90000 && remaining <= 100000);
+
+    assert(get_entry(kv_store, "expired") == NULL);
+
+    Entry *zset = get_entry(kv_store, "zset");
+    assert(zset != NULL && zset->type == EntryType::SORTED_SET);
+    assert(zset->zset.length() == 500);
+    double score;
+    assert(zset->zset.lookup("name123", 7, &score) && score == 123);
+}
+
+void test_save_and_load() {
+    std::string path = temp_path("save");
+    Rdb rdb;
+    rdb.set_filename(path);
+
+    HMap kv_store;
+    fill_kv_store(kv_store);
+    rdb.add_changes(4);
+    assert(rdb.save(kv_store));
+    assert(rdb.get_stats().changes_since_last_save == 0);
+    assert(rdb.get_stats().saves == 1);
+    assert(rdb.get_stats().last_save_time > 0);
+
+    HMap loaded;
+    assert(rdb.load(loaded, timers, evictor));
+    check_kv_store(loaded);
+
+    unlink(path.data());
+}
+
+void test_load_many_sections() {
+    std::string path = temp_path("sections");
+    Rdb rdb;
+    rdb.set_filename(path);
+
+    // big values spread the entries over several sections, which are loaded in parallel
+    HMap kv_store;
+    for (uint32_t i = 0; i < 20000; i++) {
+        Entry *entry = new Entry();
+        entry->key = "key" + std::to_string(i);
+        entry->str = (i % 5000 == 0 ? std::string(3 * 1024 * 1024, 'a' + i / 5000) : std::to_string(i)).data();
+        insert_entry(kv_store, entry);
+    }
+    assert(rdb.save(kv_store));
+
+    HMap loaded;
+    assert(rdb.load(loaded, timers, evictor));
+    assert(loaded.length() == 20000);
+    for (uint32_t i = 0; i < 20000; i += 1250) {
+        Entry *entry = get_entry(loaded, "key" + std::to_string(i));
+        assert(entry != NULL);
+        if (i % 5000 == 0) {
+            assert(entry->str.size() == 3 * 1024 * 1024 && entry->str[0] == (char) ('a' + i / 5000));
+        } else {
+            assert(entry->str == std::to_string(i).data());
+        }
+    }
+
+    unlink(path.data());
+}
+
+void test_load_missing_file() {
+    Rdb rdb;
+    rdb.set_filename(temp_path("missing"));
+
+    HMap kv_store;
+    assert(rdb.load(kv_store, timers, evictor));
+    assert(kv_store.length() == 0);
+}
+
+void test_load_corrupt_file() {
+    std::string path = temp_path("corrupt");
+    Rdb rdb;
+    rdb.set_filename(path);
+
+    HMap kv_store;
+    fill_kv_store(kv_store);
+    assert(rdb.save(kv_store));
+
+    // flip a byte in the middle of the file
+    FILE *file = fopen(path.data(), "r+");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, size / 2, SEEK_SET);
+    int c = fgetc(file);
+    fseek(file, size / 2, SEEK_SET);
+    fputc(c ^ 0xff, file);
+    fclose(file);
+
+    HMap loaded;
+    assert(!rdb.load(loaded, timers, evictor));
+
+    unlink(path.data());
+}
+
+/* Calls cron() until the running bgsave finishes */
+void wait_for_bgsave(Rdb &rdb, HMap &kv_store) {
+    while (rdb.get_stats().bgsave_in_progress) {
+        usleep(1000);
+        rdb.cron(kv_store);
+    }
+}
+
+void test_bgsave() {
+    std::string path = temp_path("bgsave");
+    Rdb rdb;
+    rdb.set_filename(path);
+
+    HMap kv_store;
+    fill_kv_store(kv_store);
+    rdb.add_changes(4);
+    assert(rdb.bgsave(kv_store));
+    assert(rdb.get_stats().bgsave_in_progress);
+    assert(rdb.needs_cron());
+    assert(!rdb.bgsave(kv_store)); // only one child at a time
+
+    // writes made while the child runs aren't in its snapshot
+    rdb.add_changes(2);
+    Entry *later = new Entry();
+    later->key = "later";
+    later->str = "not saved";
+    insert_entry(kv_store, later);
+
+    wait_for_bgsave(rdb, kv_store);
+    assert(rdb.get_stats().last_bgsave_ok);
+    assert(rdb.get_stats().changes_since_last_save == 2);
+    assert(rdb.get_stats().saves == 1);
+
+    HMap loaded;
+    assert(rdb.load(loaded, timers, evictor));
+    check_kv_store(loaded);
+
+    unlink(path.data());
+}
+
+void test_bgsave_failure() {
+    Rdb rdb;
+    rdb.set_filename("/nonexistent-dir/dump.rdb");
+
+    HMap kv_store;
+    rdb.add_changes(1);
+    assert(rdb.bgsave(kv_store));
+    wait_for_bgsave(rdb, kv_store);
+    assert(!rdb.get_stats().last_bgsave_ok);
+    assert(rdb.get_stats().changes_since_last_save == 1);
+    assert(rdb.get_stats().saves == 0);
+}
+
+void test_save_points() {
+    std::string path = temp_path("save_points");
+    Rdb rdb;
+    rdb.set_filename(path);
+
+    assert(rdb.get_save_points() == "3600 1 300 100 60 10000");
+    assert(!rdb.set_save_points("60"));
+    assert(!rdb.set_save_points("60 abc"));
+    assert(!rdb.set_save_points("-1 10"));
+    assert(rdb.set_save_points("0 3"));
+    assert(rdb.get_save_points() == "0 3");
+
+    HMap kv_store;
+    fill_kv_store(kv_store);
+
+    // not enough changes yet
+    rdb.add_changes(2);
+    rdb.cron(kv_store);
+    assert(!rdb.get_stats().bgsave_in_progress);
+
+    rdb.add_changes(1);
+    rdb.cron(kv_store);
+    assert(rdb.get_stats().bgsave_in_progress);
+    wait_for_bgsave(rdb, kv_store);
+    assert(rdb.get_stats().saves == 1);
+    assert(!rdb.needs_cron());
+
+    // no save points disables automatic saves
+    assert(rdb.set_save_points(""));
+    rdb.add_changes(100);
+    assert(!rdb.needs_cron());
+    rdb.cron(kv_store);
+    assert(!rdb.get_stats().bgsave_in_progress);
+
+    unlink(path.data());
+}
+
+int main() {
+    test_save_and_load();
+    test_load_many_sections();
+    test_load_missing_file();
+    test_load_corrupt_file();
+    test_bgsave();
+    test_bgsave_failure();
+    test_save_points();
+
+    return 0;
+}
@@ -0,0 +1,705 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <random>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Replication.hpp"
+#include "../aof/Aof.hpp"
+#include "../aof/components/AofRecord.hpp"
+#include "../command-executor/CommandExecutor.hpp"
+#include "../conn/Conn.hpp"
+#include "../rdb/Rdb.hpp"
+#include "../request/Request.hpp"
+#include "../response/types/ErrResponse.hpp"
+#include "../response/types/StrResponse.hpp"
+#include "../utils/intrusive_data_structure_utils.hpp"
+#include "../utils/log.hpp"
+#include "../utils/proc_utils.hpp"
+#include "../utils/time_utils.hpp"
+
+Replication::Replication() : replid(new_replid()) {}
+
+Replication &Replication::shared() {
+    static Replication replication;
+    return replication;
+}
+
+std::string Replication::new_replid() {
+    static const char hex_digits[] = "0123456789abcdef";
+    std::random_device rd;
+    std::mt19937_64 gen(((uint64_t) rd() << 32) | rd());
+
+    std::string id(ID_LEN, '0');
+    for (char &c : id) {
+        c = hex_digits[gen() % 16];
+    }
+    return id;
+}
+
+void Replication::set_primary(const std::string &host, const std::string &port) {
+    if (is_replica() && host == primary_host && port == primary_port) {
+        return;
+    }
+
+    // chaining isn't supported, so the replicas of this server have nothing to follow anymore
+    for (ReplicaLink *replica : std::vector<ReplicaLink *>(replicas)) {
+        replica->conn->want_close = true;
+        replica->conn->want_write = true; // wakes the connection up so the event loop closes it
+        remove_replica(replica->conn);
+    }
+    if (child_pid != -1) {
+        kill(child_pid, SIGKILL);
+        waitpid(child_pid, NULL, 0);
+        unlink(snapshot_path.data());
+        child_pid = -1;
+    }
+    delete backlog;
+    backlog = NULL;
+
+    drop_primary_link();
+    primary_host = host;
+    primary_port = port;
+    link_state = PrimaryLinkState::CONNECT;
+    last_connect_ms = 0;
+    log("replicating %s:%s", host.data(), port.data());
+}
+
+void Replication::unset_primary() {
+    if (!is_replica()) {
+        return;
+    }
+
+    drop_primary_link();
+    log("stopped replicating %s:%s", primary_host.data(), primary_port.data());
+    primary_host.clear();
+    primary_port.clear();
+    link_state = PrimaryLinkState::NONE;
+    replid = new_replid(); // writes from now on diverge from the old primary's history
+}
+
+bool Replication::is_replica() {
+    return !primary_host.empty();
+}
+
+bool Replication::rejects_writes() {
+    return is_replica() && !applying;
+}
+
+bool Replication::handle_command(Conn *conn, const std::vector<std::string> &command, HMap &kv_store) {
+    if (command.size() == 3 && command[0] == "psync") {
+        handle_psync(conn, command, kv_store);
+        return true;
+    }
+
+    if (command.size() == 3 && command[0] == "replconf" && command[1] == "ack") {
+        ReplicaLink *replica = find_replica(conn);
+        if (replica == NULL) {
+            return false;
+        }
+
+        char *end;
+        uint64_t ack_offset = strtoull(command[2].data(), &end, 10);
+        if (*end == '\0' && ack_offset <= offset) {
+            replica->ack_offset = ack_offset;
+            replica->last_ack_ms = get_time_ms();
+        }
+        return true; // acks aren't replied to
+    }
+
+    return false;
+}
+
+ReplicaLink *Replication::find_replica(Conn *conn) {
+    for (ReplicaLink *replica : replicas) {
+        if (replica->conn == conn) {
+            return replica;
+        }
+    }
+    return NULL;
+}
+
+void Replication::handle_psync(Conn *conn, const std::vector<std::string> &command, HMap &kv_store) {
+    if (is_replica()) {
+        log("psync: connection %d tried to replicate a replica", conn->fd);
+        ErrResponse err(ErrResponse::ErrorCode::ERR_UNKNOWN, "replicas can't be replicated");
+        err.marshal(conn->outgoing);
+        return;
+    } else if (find_replica(conn) != NULL) {
+        log("psync: connection %d is already a replica", conn->fd);
+        ErrResponse err(ErrResponse::ErrorCode::ERR_UNKNOWN, "already a replica");
+        err.marshal(conn->outgoing);
+        return;
+    }
+
+    if (backlog == NULL) {
+        backlog = new ReplBacklog(backlog_size, offset);
+    }
+
+    ReplicaLink *replica = new ReplicaLink();
+    replica->conn = conn;
+    replica->last_ack_ms = get_time_ms();
+    replicas.push_back(replica);
+    conn->is_replica = true;
+
+    // continue from where the replica left off if its history is ours and the backlog still holds the rest of it
+    char *end;
+    uint64_t replica_offset = strtoull(command[2].data(), &end, 10);
+    Buffer missed;
+    if (command[1] == replid && *end == '\0' && backlog->copy_from(replica_offset, missed)) {
+        StrResponse reply("CONTINUE");
+        reply.marshal(conn->outgoing);
+        conn->outgoing.append(missed.data(), missed.size());
+        conn->want_write = true;
+        replica->state = ReplicaState::ONLINE;
+        replica->ack_offset = replica_offset;
+        stats.partial_syncs++;
+        log("psync: connection %d continues from offset %lu, sent %u bytes from the backlog", conn->fd,
+            replica_offset, missed.size());
+        return;
+    }
+
+    if (command[1] != "?") {
+        stats.partial_sync_errs++;
+    }
+    stats.full_syncs++;
+    log("psync: connection %d needs a full sync", conn->fd);
+
+    // replicas that arrive while a snapshot is being written wait for the next one, since this one misses what was
+    // written since its fork
+    if (child_pid == -1) {
+        start_snapshot(kv_store);
+    }
+}
+
+/* Argument for the snapshot_child() task */
+struct SnapshotChildArg {
+    HMap *kv_store;
+    const std::string *path;
+};
+
+/* Task for the snapshot child: writes the kv store as of the fork, i.e. at the current offset */
+static bool snapshot_child(void *arg) {
+    SnapshotChildArg *child_arg = (SnapshotChildArg *) arg;
+    return Rdb::write_file(*child_arg->kv_store, *child_arg->path);
+}
+
+void Replication::start_snapshot(HMap &kv_store) {
+    snapshot_path = "replsync-" + std::to_string(getpid()) + ".rdb";
+    SnapshotChildArg arg = { &kv_store, &snapshot_path };
+    pid_t pid = fork_child(snapshot_child, &arg);
+    if (pid == -1) {
+        log("replication: failed to fork snapshot child: %s", strerror(errno));
+        return; // retried by cron()
+    }
+
+    child_pid = pid;
+    snapshot_offset = offset;
+    for (ReplicaLink *replica : replicas) {
+        if (replica->state != ReplicaState::WAIT_BGSAVE_START) {
+            continue;
+        }
+
+        StrResponse reply("FULLRESYNC " + replid + " " + std::to_string(snapshot_offset));
+        reply.marshal(replica->conn->outgoing);
+        replica->conn->want_write = true;
+        replica->state = ReplicaState::WAIT_BGSAVE_END;
+        replica->pending.reset();
+    }
+    log("replication: started snapshot child %d at offset %lu", pid, snapshot_offset);
+}
+
+void Replication::finish_snapshot(bool ok) {
+    child_pid = -1;
+    if (!ok) {
+        log("replication: snapshot child failed");
+    }
+
+    for (ReplicaLink *replica : replicas) {
+        if (replica->state != ReplicaState::WAIT_BGSAVE_END) {
+            continue;
+        }
+
+        // each replica reads the file through its own descriptor, so it can be unlinked right away
+        int fd = ok ? open(snapshot_path.data(), O_RDONLY) : -1;
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) == -1) {
+            log("replication: failed to open snapshot for connection %d", replica->conn->fd);
+            if (fd != -1) {
+                close(fd);
+            }
+            replica->conn->want_close = true;
+            replica->conn->want_write = true;
+            continue;
+        }
+
+        replica->snapshot_fd = fd;
+        replica->snapshot_left = st.st_size;
+        replica->conn->outgoing.append_int64(st.st_size);
+        replica->state = ReplicaState::SEND_BULK;
+        send_snapshot_chunks(replica);
+    }
+    unlink(snapshot_path.data());
+}
+
+void Replication::send_snapshot_chunks(ReplicaLink *replica) {
+    Conn *conn = replica->conn;
+    char chunk[64 * 1024];
+    while (replica->snapshot_left > 0 && conn->outgoing.size() < SEND_CHUNK_SIZE) {
+        ssize_t n = read(replica->snapshot_fd, chunk, std::min<uint64_t>(sizeof(chunk), replica->snapshot_left));
+        if (n <= 0) {
+            log("replication: failed to read snapshot for connection %d", conn->fd);
+            conn->want_close = true;
+            conn->want_write = true;
+            return;
+        }
+
+        conn->outgoing.append(chunk, (uint32_t) n);
+        replica->snapshot_left -= n;
+    }
+    conn->want_write = true;
+
+    if (replica->snapshot_left > 0) {
+        return;
+    }
+
+    // the replica gets everything written since the fork right behind the snapshot, then the stream as it's written
+    close(replica->snapshot_fd);
+    replica->snapshot_fd = -1;
+    conn->outgoing.append(replica->pending.data(), replica->pending.size());
+    replica->pending.reset();
+    replica->state = ReplicaState::ONLINE;
+    log("replication: sent snapshot to connection %d", conn->fd);
+}
+
+void Replication::remove_replica(Conn *conn) {
+    auto it = std::find_if(replicas.begin(), replicas.end(), [conn](ReplicaLink *r) { return r->conn == conn; });
+    if (it == replicas.end()) {
+        return;
+    }
+
+    ReplicaLink *replica = *it;
+    if (replica->snapshot_fd != -1) {
+        close(replica->snapshot_fd);
+    }
+    replicas.erase(it);
+    delete replica;
+    conn->is_replica = false;
+    log("replication: connection %d is no longer a replica", conn->fd);
+}
+
+void Replication::propagate(Buffer &records) {
+    backlog->append(records.data(), records.size());
+    offset += records.size();
+
+    for (ReplicaLink *replica : replicas) {
+        if (replica->state == ReplicaState::ONLINE) {
+            replica->conn->outgoing.append(records.data(), records.size());
+            replica->conn->want_write = true;
+        } else if (replica->state != ReplicaState::WAIT_BGSAVE_START) {
+            replica->pending.append(records.data(), records.size());
+        }
+        // replicas waiting for a snapshot to be started get these writes as part of it
+    }
+}
+
+void Replication::feed(const std::vector<std::string> &command) {
+    if (backlog == NULL) {
+        return;
+    }
+
+    Buffer records;
+    append_aof_record(records, command);
+    propagate(records);
+}
+
+void Replication::feed_entry(const std::string &key, Entry *entry) {
+    if (backlog == NULL) {
+        return;
+    }
+
+    Buffer records;
+    append_aof_record(records, { "del", key });
+    if (entry != NULL) {
+        append_entry_records(records, entry);
+    }
+    propagate(records);
+}
+
+void Replication::connect_to_primary() {
+    last_connect_ms = get_time_ms();
+    last_io_ms = last_connect_ms;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *res;
+    if (getaddrinfo(primary_host.data(), primary_port.data(), &hints, &res) != 0) {
+        log("replication: failed to resolve primary %s:%s", primary_host.data(), primary_port.data());
+        return;
+    }
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd == -1 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) == -1) {
+        log("replication: failed to create socket: %s", strerror(errno));
+        if (fd != -1) {
+            close(fd);
+        }
+        freeaddrinfo(res);
+        return;
+    }
+
+    int rv = connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rv == -1 && errno != EINPROGRESS) {
+        log("replication: failed to connect to primary %s:%s: %s", primary_host.data(), primary_port.data(),
+            strerror(errno));
+        close(fd);
+        return;
+    }
+
+    link_fd = fd;
+    link_state = PrimaryLinkState::CONNECTING;
+    log("replication: connecting to primary %s:%s", primary_host.data(), primary_port.data());
+}
+
+void Replication::send_psync() {
+    if (synced) {
+        queue_to_primary({ "psync", replid, std::to_string(offset) });
+    } else {
+        queue_to_primary({ "psync", "?", "-1" }); // nothing to continue from, ask for a full sync
+    }
+    link_state = PrimaryLinkState::HANDSHAKE;
+    log("replication: sent psync");
+}
+
+void Replication::queue_to_primary(const std::vector<std::string> &command) {
+    Request request(command);
+    request.marshal(link_out);
+}
+
+bool Replication::handle_psync_reply() {
+    auto [response, status] = Response::unmarshal(link_in.data(), link_in.size());
+    if (status == Response::UnmarshalStatus::INCOMPLETE_RES) {
+        return false;
+    } else if (status != Response::UnmarshalStatus::SUCCESS) {
+        log("replication: invalid reply to psync");
+        drop_primary_link();
+        return false;
+    }
+    link_in.consume(Response::HEADER_SIZE + (*response)->length());
+
+    StrResponse *str = dynamic_cast<StrResponse *>(*response);
+    std::string reply = str != NULL ? str->get_msg() : (*response)->to_string();
+    delete *response;
+
+    if (reply == "CONTINUE") {
+        synced = true;
+        link_state = PrimaryLinkState::CONNECTED;
+        log("replication: continuing from offset %lu", offset);
+        return true;
+    }
+
+    std::istringstream words(reply);
+    std::string word, new_replid;
+    uint64_t new_offset;
+    if (!(words >> word >> new_replid >> new_offset) || word != "FULLRESYNC") {
+        log("replication: primary refused psync: %s", reply.data());
+        drop_primary_link();
+        return false;
+    }
+
+    replid = new_replid;
+    offset = new_offset;
+    link_state = PrimaryLinkState::TRANSFER;
+    log("replication: full sync from offset %lu", offset);
+    return true;
+}
+
+/**
+ * Callback which gets the key for an Entry in the hash map and stores it in the provided vector.
+ * 
+ * @param node  The HNode contained by the Entry.
+ * @param arg   Void pointer to the vector of keys.
+ */
+static void collect_key(HNode *node, void *arg) {
+    ((std::vector<std::string> *) arg)->push_back(container_of(node, Entry, node)->key);
+}
+
+bool Replication::handle_transfer(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor) {
+    if (transfer_len == 0) {
+        if (link_in.size() < sizeof(transfer_len)) {
+            return false;
+        }
+        memcpy(&transfer_len, link_in.data(), sizeof(transfer_len));
+        link_in.consume(sizeof(transfer_len));
+        transfer.reserve(transfer_len);
+    }
+
+    uint64_t n = std::min<uint64_t>(link_in.size(), transfer_len - transfer.size());
+    transfer.insert(transfer.end(), link_in.data(), link_in.data() + n);
+    link_in.consume((uint32_t) n);
+    if (transfer.size() < transfer_len) {
+        return false;
+    }
+
+    // the primary's data replaces this server's
+    std::vector<std::string> keys;
+    kv_store.for_each(collect_key, (void *) &keys);
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    applying = true;
+    for (const std::string &key : keys) {
+        executor.execute({ "del", key });
+    }
+    applying = false;
+
+    bool ok = Rdb::load_snapshot(transfer.data(), transfer.size(), kv_store, timers, evictor);
+    log("replication: received %lu byte snapshot with %u keys", transfer_len, kv_store.length());
+    transfer = std::vector<char>();
+    transfer_len = 0;
+    if (!ok) {
+        log("replication: snapshot from primary is corrupt");
+        drop_primary_link();
+        return false;
+    }
+
+    if (Aof::shared().is_enabled()) {
+        // the file would otherwise hold the dels above instead of the primary's data
+        Aof::shared().stop();
+        Aof::shared().start(kv_store);
+    }
+
+    synced = true;
+    link_state = PrimaryLinkState::CONNECTED;
+    return true;
+}
+
+void Replication::apply_stream(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor) {
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    std::vector<std::string> command;
+    size_t pos = 0;
+    applying = true;
+    while (pos < link_in.size()) {
+        size_t start = pos;
+        AofRecordStatus status = read_aof_record(link_in.data(), link_in.size(), &pos, &command);
+        if (status == AofRecordStatus::INCOMPLETE) {
+            break;
+        } else if (status == AofRecordStatus::CORRUPT) {
+            log("replication: corrupt record from primary at offset %lu", offset);
+            applying = false;
+            drop_primary_link();
+            return;
+        }
+        offset += pos - start;
+
+        if (command[0] == "ping") {
+            continue;
+        }
+
+        // commands that normally run in the background are run in place, in stream order
+        std::unique_ptr<Response> response = executor.execute_now(command);
+        if (dynamic_cast<ErrResponse *>(response.get()) != NULL) {
+            log("replication: command from primary failed: %s", response->to_string().data());
+        }
+    }
+    applying = false;
+    link_in.consume((uint32_t) pos);
+}
+
+void Replication::drop_primary_link() {
+    if (link_fd != -1) {
+        close(link_fd);
+        log("replication: dropped link to primary");
+    }
+
+    // a half-received snapshot leaves the history of the primary without its data, so don't claim it
+    if (link_state == PrimaryLinkState::TRANSFER) {
+        synced = false;
+    }
+
+    link_fd = -1;
+    link_in.reset();
+    link_out.reset();
+    transfer = std::vector<char>();
+    transfer_len = 0;
+    link_state = is_replica() ? PrimaryLinkState::CONNECT : PrimaryLinkState::NONE;
+}
+
+int Replication::get_link_fd() {
+    return link_fd;
+}
+
+short Replication::get_link_events() {
+    if (link_fd == -1) {
+        return 0;
+    } else if (link_state == PrimaryLinkState::CONNECTING) {
+        return POLLOUT;
+    }
+    return POLLIN | (link_out.size() > 0 ? POLLOUT : 0);
+}
+
+void Replication::handle_link(short revents, HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool,
+                              Evictor &evictor) {
+    if (link_fd == -1) {
+        return;
+    }
+
+    if (link_state == PrimaryLinkState::CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(link_fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err != 0) {
+            log("replication: failed to connect to primary: %s", strerror(err));
+            drop_primary_link();
+            return;
+        }
+        last_io_ms = get_time_ms();
+        send_psync();
+        return; // psync goes out once the socket is polled for writing
+    }
+
+    if ((revents & POLLOUT) && link_out.size() > 0) {
+        ssize_t sent = send(link_fd, link_out.data(), link_out.size(), MSG_NOSIGNAL);
+        if (sent == -1 && errno != EAGAIN) {
+            log("replication: failed to send to primary: %s", strerror(errno));
+            drop_primary_link();
+            return;
+        } else if (sent > 0) {
+            link_out.consume((uint32_t) sent);
+        }
+    }
+
+    if (!(revents & (POLLIN | POLLHUP | POLLERR))) {
+        return;
+    }
+
+    char buf[64 * 1024];
+    ssize_t recvd = recv(link_fd, buf, sizeof(buf), 0);
+    if (recvd == -1 && errno == EAGAIN) {
+        return;
+    } else if (recvd <= 0) {
+        log("replication: primary closed the link");
+        drop_primary_link();
+        return;
+    }
+    link_in.append(buf, (uint32_t) recvd);
+    last_io_ms = get_time_ms();
+
+    if (link_state == PrimaryLinkState::HANDSHAKE && !handle_psync_reply()) {
+        return;
+    }
+    if (link_state == PrimaryLinkState::TRANSFER && !handle_transfer(kv_store, timers, thread_pool, evictor)) {
+        return;
+    }
+    if (link_state == PrimaryLinkState::CONNECTED) {
+        apply_stream(kv_store, timers, thread_pool, evictor);
+    }
+}
+
+void Replication::cron(HMap &kv_store) {
+    time_t now_ms = get_time_ms();
+
+    if (child_pid != -1) {
+        ChildState state = reap_child(child_pid, "replication");
+        if (state != ChildState::RUNNING) {
+            finish_snapshot(state == ChildState::SUCCEEDED);
+        }
+    }
+
+    bool waiting = false;
+    for (ReplicaLink *replica : replicas) {
+        if (replica->state == ReplicaState::SEND_BULK) {
+            send_snapshot_chunks(replica);
+        }
+        waiting = waiting || replica->state == ReplicaState::WAIT_BGSAVE_START;
+    }
+    if (waiting && child_pid == -1) {
+        start_snapshot(kv_store);
+    }
+
+    if (!replicas.empty() && now_ms - last_ping_ms >= PING_INTERVAL_MS) {
+        feed({ "ping" });
+        last_ping_ms = now_ms;
+    }
+
+    if (!is_replica()) {
+        return;
+    }
+
+    if (link_state == PrimaryLinkState::CONNECT) {
+        if (now_ms - last_connect_ms >= RECONNECT_INTERVAL_MS) {
+            connect_to_primary();
+        }
+    } else if (now_ms - last_io_ms >= TIMEOUT_MS) {
+        log("replication: no data from primary in %u ms", TIMEOUT_MS);
+        drop_primary_link();
+    } else if (link_state == PrimaryLinkState::CONNECTED && now_ms - last_ack_ms >= ACK_INTERVAL_MS) {
+        queue_to_primary({ "replconf", "ack", std::to_string(offset) });
+        last_ack_ms = now_ms;
+    }
+}
+
+bool Replication::needs_cron() {
+    return is_replica() || !replicas.empty() || child_pid != -1;
+}
+
+void Replication::set_backlog_size(uint64_t size) {
+    backlog_size = size;
+    if (backlog != NULL) {
+        backlog->resize(size);
+    }
+}
+
+uint64_t Replication::get_backlog_size() {
+    return backlog_size;
+}
+
+uint64_t Replication::get_backlog_start_offset() {
+    return backlog != NULL ? backlog->get_start_offset() : 0;
+}
+
+bool Replication::has_backlog() {
+    return backlog != NULL;
+}
+
+const std::string &Replication::get_replid() {
+    return replid;
+}
+
+uint64_t Replication::get_offset() {
+    return offset;
+}
+
+const std::vector<ReplicaLink *> &Replication::get_replicas() {
+    return replicas;
+}
+
+const std::string &Replication::get_primary_host() {
+    return primary_host;
+}
+
+const std::string &Replication::get_primary_port() {
+    return primary_port;
+}
+
+PrimaryLinkState Replication::get_link_state() {
+    return link_state;
+}
+
+time_t Replication::get_last_io_ms() {
+    return last_io_ms;
+}
+
+const ReplStats &Replication::get_stats() {
+    return stats;
+}
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "components/ReplBacklog.hpp"
+#include "../buffer/Buffer.hpp"
+#include "../entry/Entry.hpp"
+#include "../evictor/Evictor.hpp"
+#include "../hashmap/HMap.hpp"
+#include "../thread-pool/ThreadPool.hpp"
+#include "../timers/TimerManager.hpp"
+
+// Forward declaration to break circular dependency
+class Conn;
+
+/* Where a replica is in being brought up to date by the primary */
+enum class ReplicaState {
+    WAIT_BGSAVE_START, // waiting for the running snapshot child to exit so a new one can be started for it
+    WAIT_BGSAVE_END, // waiting for its snapshot to be written
+    SEND_BULK, // being sent its snapshot
+    ONLINE // being sent the stream of write commands
+};
+
+/* A replica connected to this server, as seen by the primary */
+struct ReplicaLink {
+    Conn *conn;
+    ReplicaState state = ReplicaState::WAIT_BGSAVE_START;
+    Buffer pending; // stream written since the snapshot's fork, sent once the snapshot has been
+    int snapshot_fd = -1; // snapshot being sent, -1 if there is none
+    uint64_t snapshot_left = 0; // bytes of the snapshot not yet sent
+    uint64_t ack_offset = 0; // offset the replica has acknowledged applying
+    time_t last_ack_ms = 0;
+};
+
+/* Where a replica is in connecting to and syncing with its primary */
+enum class PrimaryLinkState {
+    NONE, // not a replica
+    CONNECT, // should connect to the primary
+    CONNECTING, // waiting for a non-blocking connect to finish
+    HANDSHAKE, // sent psync, waiting for the reply
+    TRANSFER, // receiving a snapshot
+    CONNECTED // applying the stream of write commands
+};
+
+/* Stats for replication */
+struct ReplStats {
+    uint64_t full_syncs = 0; // replicas sent a whole snapshot
+    uint64_t partial_syncs = 0; // replicas sent only what they missed from the backlog
+    uint64_t partial_sync_errs = 0; // psyncs that asked for a partial sync but had to be sent a snapshot
+};
+
+/**
+ * Primary-replica replication.
+ * 
+ * A replica connects to its primary like a client and sends psync with the id of the history it has and how far into 
+ * it it got (its offset). If the primary's backlog still holds everything from there on, the primary sends just that 
+ * (partial sync). Otherwise it forks a child to write a snapshot, sends the snapshot, then everything written since the 
+ * fork (full sync). From then on, every write command is sent to the replica as it's logged, in the same record format 
+ * as the append-only file, so the replica applies exactly what the primary logged (e.g. absolute expiries).
+ * 
+ * Both ends run on the event loop. The replica acknowledges its offset every second, which gives the primary each 
+ * replica's lag, and the primary pings every second so a replica can tell a dead link from a quiet one. Replicas serve 
+ * reads but reject writes from clients.
+ */
+class Replication {
+    private:
+        static const uint32_t ID_LEN = 40;
+        static const uint32_t PING_INTERVAL_MS = 1000;
+        static const uint32_t ACK_INTERVAL_MS = 1000;
+        static const uint32_t RECONNECT_INTERVAL_MS = 1000;
+        static const uint32_t TIMEOUT_MS = 60 * 1000; // a link that has been silent this long is dropped
+        static const uint32_t SEND_CHUNK_SIZE = 256 * 1024; // bytes of snapshot queued on a replica at a time
+
+        // history shared with the replicas, or with the primary when this is a replica
+        std::string replid;
+        uint64_t offset = 0; // bytes of the stream written, or applied when this is a replica
+
+        // primary side
+        ReplBacklog *backlog = NULL; // created once the first replica connects
+        uint64_t backlog_size = 1024 * 1024;
+        std::vector<ReplicaLink *> replicas;
+        pid_t child_pid = -1; // snapshot child, -1 if there is none
+        std::string snapshot_path;
+        uint64_t snapshot_offset = 0; // offset when the snapshot child was forked
+        time_t last_ping_ms = 0;
+        ReplStats stats;
+
+        // replica side
+        std::string primary_host; // empty if this is not a replica
+        std::string primary_port;
+        PrimaryLinkState link_state = PrimaryLinkState::NONE;
+        int link_fd = -1;
+        bool synced = false; // whether replid and offset describe data this server holds, so it can ask to continue
+        Buffer link_in; // bytes received from the primary not yet handled
+        Buffer link_out; // bytes not yet sent to the primary
+        std::vector<char> transfer; // snapshot being received
+        uint64_t transfer_len = 0; // size of the snapshot being received, 0 until its header arrives
+        time_t last_io_ms = 0; // last time anything was received from the primary
+        time_t last_connect_ms = 0;
+        time_t last_ack_ms = 0;
+        bool applying = false; // whether a command from the primary is being applied
+
+        /* Generates a new random history id */
+        static std::string new_replid();
+
+        /**
+         * Sends records to the replicas and adds them to the backlog.
+         * 
+         * @param records   Reference to the records.
+         */
+        void propagate(Buffer &records);
+
+        /* Returns the ReplicaLink of a connection, NULL if it isn't a replica */
+        ReplicaLink *find_replica(Conn *conn);
+
+        /**
+         * Handles psync from a connection, turning it into a replica.
+         * 
+         * @param conn      Pointer to the connection.
+         * @param command   The command: psync <replid> <offset>.
+         * @param kv_store  Reference to the kv store.
+         */
+        void handle_psync(Conn *conn, const std::vector<std::string> &command, HMap &kv_store);
+
+        /**
+         * Forks a child to write a snapshot for the replicas waiting for one.
+         * 
+         * @param kv_store  Reference to the kv store.
+         */
+        void start_snapshot(HMap &kv_store);
+
+        /**
+         * Handles the snapshot child exiting, starting to send the snapshot to the replicas waiting for it.
+         * 
+         * @param ok    Whether the child wrote the snapshot.
+         */
+        void finish_snapshot(bool ok);
+
+        /* Queues the next chunks of a snapshot on a replica, then the stream once the whole snapshot is queued */
+        void send_snapshot_chunks(ReplicaLink *replica);
+
+        /* Starts a non-blocking connect to the primary */
+        void connect_to_primary();
+
+        /* Sends psync to the primary once connected, asking to continue from where this server's history ends */
+        void send_psync();
+
+        /**
+         * Queues a command to be sent to the primary.
+         * 
+         * @param command   The command.
+         */
+        void queue_to_primary(const std::vector<std::string> &command);
+
+        /**
+         * Handles the reply to psync.
+         * 
+         * @return  True if the primary agreed to a sync.
+         *          False if more bytes are needed or it refused, in which case the link is dropped.
+         */
+        bool handle_psync_reply();
+
+        /**
+         * Handles the snapshot being received. Once all of it has arrived, it replaces the kv store.
+         * 
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool.
+         * @param evictor       Reference to the evictor.
+         * 
+         * @return  True if the snapshot was loaded.
+         *          False if more bytes are needed or it's corrupt, in which case the link is dropped.
+         */
+        bool handle_transfer(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor);
+
+        /**
+         * Applies the write commands received from the primary.
+         * 
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool.
+         * @param evictor       Reference to the evictor.
+         */
+        void apply_stream(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool, Evictor &evictor);
+
+        /* Closes the link to the primary, to be reconnected by cron() */
+        void drop_primary_link();
+    public:
+        static const uint32_t CRON_INTERVAL_MS = 100; // how often cron() should run while replication is in use
+
+        Replication();
+
+        /* Returns the Replication used by the event loop */
+        static Replication &shared();
+
+        /**
+         * Makes this server a replica of another one. Its kv store is replaced by the primary's once they sync. Any 
+         * replicas of this server are disconnected.
+         * 
+         * @param host  The primary's host.
+         * @param port  The primary's port.
+         */
+        void set_primary(const std::string &host, const std::string &port);
+
+        /* Makes this server a primary again, keeping its data. It starts a new history, since it may now diverge. */
+        void unset_primary();
+
+        /* Returns whether this server is a replica */
+        bool is_replica();
+
+        /* Returns whether writes from clients must be rejected, i.e. this is a replica not applying its primary's */
+        bool rejects_writes();
+
+        /**
+         * Handles a replication command from a connection: psync from a replica connecting, or replconf ack from a 
+         * replica acknowledging its offset. Called before the command reaches the CommandExecutor.
+         * 
+         * @param conn      Pointer to the connection.
+         * @param command   The command.
+         * @param kv_store  Reference to the kv store.
+         * 
+         * @return  True if the command was handled. Replies, if any, are added to the connection's outgoing buffer.
+         *          False if it isn't a replication command.
+         */
+        bool handle_command(Conn *conn, const std::vector<std::string> &command, HMap &kv_store);
+
+        /* Forgets a replica whose connection is closing */
+        void remove_replica(Conn *conn);
+
+        /**
+         * Sends a write command to the replicas. Does nothing if no replica has ever connected.
+         * 
+         * @param command   The command, as logged to the append-only file.
+         */
+        void feed(const std::vector<std::string> &command);
+
+        /**
+         * Sends the commands that recreate an Entry as it is now to the replicas, replacing whatever was at its key.
+         * 
+         * @param key   The key.
+         * @param entry Pointer to the Entry, NULL if the key doesn't exist anymore.
+         */
+        void feed_entry(const std::string &key, Entry *entry);
+
+        /* Returns the socket of the link to the primary, -1 if there is none */
+        int get_link_fd();
+
+        /* Returns the poll events the link to the primary is waiting for */
+        short get_link_events();
+
+        /**
+         * Handles the link to the primary being ready.
+         * 
+         * @param revents       The poll events that happened.
+         * @param kv_store      Reference to the kv store.
+         * @param timers        Reference to the timer manager.
+         * @param thread_pool   Reference to the thread pool.
+         * @param evictor       Reference to the evictor.
+         */
+        void handle_link(short revents, HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool,
+                         Evictor &evictor);
+
+        /**
+         * Does the periodic work of replication. On a primary: finishes snapshot children, sends snapshots, and pings 
+         * the replicas. On a replica: (re)connects to the primary, acknowledges the offset, and drops a silent link. 
+         * Called from the event loop.
+         * 
+         * @param kv_store  Reference to the kv store.
+         */
+        void cron(HMap &kv_store);
+
+        /* Returns whether cron() has work to do: this is a replica or has replicas */
+        bool needs_cron();
+
+        /* Sets the size of the backlog in bytes */
+        void set_backlog_size(uint64_t size);
+
+        /* Returns the size of the backlog in bytes */
+        uint64_t get_backlog_size();
+
+        /* Returns the offset of the oldest byte in the backlog, 0 if there is no backlog */
+        uint64_t get_backlog_start_offset();
+
+        /* Returns whether there is a backlog, which feed() only writes to once the first replica has connected */
+        bool has_backlog();
+
+        /* Returns the id of the history */
+        const std::string &get_replid();
+
+        /* Returns the offset into the history: written on a primary, applied on a replica */
+        uint64_t get_offset();
+
+        /* Returns the replicas connected to this server */
+        const std::vector<ReplicaLink *> &get_replicas();
+
+        /* Returns the host of the primary, empty if this is not a replica */
+        const std::string &get_primary_host();
+
+        /* Returns the port of the primary */
+        const std::string &get_primary_port();
+
+        /* Returns the state of the link to the primary */
+        PrimaryLinkState get_link_state();
+
+        /* Returns the last time, in ms, anything was received from the primary */
+        time_t get_last_io_ms();
+
+        /* Returns the stats for replication */
+        const ReplStats &get_stats();
+};
@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cstring>
+
+#include "ReplBacklog.hpp"
+
+ReplBacklog::ReplBacklog(uint64_t capacity, uint64_t offset) : buf(std::max<uint64_t>(capacity, 1)),
+                                                               end_offset(offset) {}
+
+void ReplBacklog::append(const char *data, size_t n) {
+    end_offset += n;
+    len = std::min<uint64_t>(len + n, buf.size());
+
+    // only the last capacity bytes can survive
+    if (n > buf.size()) {
+        data += n - buf.size();
+        n = buf.size();
+    }
+
+    size_t pos = (end_offset - n) % buf.size();
+    size_t first = std::min(n, buf.size() - pos);
+    memcpy(buf.data() + pos, data, first);
+    memcpy(buf.data(), data + first, n - first);
+}
+
+bool ReplBacklog::copy_from(uint64_t offset, Buffer &out) {
+    if (offset < get_start_offset() || offset > end_offset) {
+        return false;
+    }
+
+    size_t n = end_offset - offset;
+    size_t pos = offset % buf.size();
+    size_t first = std::min(n, buf.size() - pos);
+    out.append(buf.data() + pos, first);
+    out.append(buf.data(), n - first);
+    return true;
+}
+
+void ReplBacklog::resize(uint64_t capacity) {
+    ReplBacklog resized(capacity, get_start_offset());
+    Buffer held;
+    copy_from(get_start_offset(), held);
+    resized.append(held.data(), held.size());
+    *this = std::move(resized);
+}
+
+uint64_t ReplBacklog::get_start_offset() {
+    return end_offset - len;
+}
+
+uint64_t ReplBacklog::get_end_offset() {
+    return end_offset;
+}
+
+uint64_t ReplBacklog::capacity() {
+    return buf.size();
+}
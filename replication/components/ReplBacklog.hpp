@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../../buffer/Buffer.hpp"
+
+/**
+ * Circular buffer holding the most recent bytes of the replication stream.
+ * 
+ * Bytes are addressed by their offset in the stream, counted from the start of the primary's history. A replica that 
+ * was briefly disconnected reconnects with the offset it got up to, and if the backlog still holds everything from 
+ * there on, it's sent only what it missed rather than a whole snapshot.
+ */
+class ReplBacklog {
+    private:
+        std::vector<char> buf;
+        uint64_t end_offset; // offset just past the newest byte held
+        uint64_t len = 0; // bytes held, at most the capacity
+    public:
+        /**
+         * Initializes a ReplBacklog.
+         * 
+         * @param capacity  The number of bytes to hold.
+         * @param offset    The offset of the next byte of the stream.
+         */
+        ReplBacklog(uint64_t capacity, uint64_t offset);
+
+        /**
+         * Appends bytes of the stream, overwriting the oldest ones once the backlog is full.
+         * 
+         * @param data  Pointer to the bytes.
+         * @param n     The number of bytes.
+         */
+        void append(const char *data, size_t n);
+
+        /**
+         * Copies the bytes of the stream from an offset onward.
+         * 
+         * @param offset    The offset.
+         * @param out       Reference to the Buffer to append the bytes to.
+         * 
+         * @return  True on success.
+         *          False if the backlog doesn't hold every byte from the offset on, in which case nothing is copied.
+         */
+        bool copy_from(uint64_t offset, Buffer &out);
+
+        /**
+         * Changes the number of bytes held, keeping the newest ones.
+         * 
+         * @param capacity  The new capacity.
+         */
+        void resize(uint64_t capacity);
+
+        /* Returns the offset of the oldest byte held */
+        uint64_t get_start_offset();
+
+        /* Returns the offset just past the newest byte held */
+        uint64_t get_end_offset();
+
+        /* Returns the number of bytes the backlog can hold */
+        uint64_t capacity();
+};
@@ -0,0 +1,78 @@
+#include <assert.h>
+#include <string>
+
+#include "../ReplBacklog.hpp"
+
+/**
+ * Copies the bytes of a backlog from an offset onward into a string.
+ * 
+ * @return  The bytes.
+ */
+std::string copy_to_string(ReplBacklog &backlog, uint64_t offset) {
+    Buffer out;
+    assert(backlog.copy_from(offset, out));
+    return std::string(out.data(), out.size());
+}
+
+void test_append_and_copy() {
+    ReplBacklog backlog(16, 100);
+    assert(backlog.get_start_offset() == 100);
+    assert(backlog.get_end_offset() == 100);
+    assert(copy_to_string(backlog, 100) == "");
+
+    backlog.append("hello", 5);
+    backlog.append("world", 5);
+    assert(backlog.get_start_offset() == 100);
+    assert(backlog.get_end_offset() == 110);
+    assert(copy_to_string(backlog, 100) == "helloworld");
+    assert(copy_to_string(backlog, 105) == "world");
+
+    // offsets the backlog never held can't be copied
+    Buffer out;
+    assert(!backlog.copy_from(99, out));
+    assert(!backlog.copy_from(111, out));
+    assert(out.size() == 0);
+}
+
+void test_wrap_around() {
+    ReplBacklog backlog(8, 0);
+    backlog.append("abcdef", 6);
+    backlog.append("ghij", 4); // wraps past the end of the array
+
+    assert(backlog.get_start_offset() == 2);
+    assert(backlog.get_end_offset() == 10);
+    assert(copy_to_string(backlog, 2) == "cdefghij");
+    assert(copy_to_string(backlog, 7) == "hij");
+
+    Buffer out;
+    assert(!backlog.copy_from(1, out)); // overwritten
+
+    // an append bigger than the backlog keeps only its end
+    backlog.append("0123456789abc", 13);
+    assert(backlog.get_start_offset() == 15);
+    assert(copy_to_string(backlog, 15) == "56789abc");
+}
+
+void test_resize() {
+    ReplBacklog backlog(8, 0);
+    backlog.append("abcdefghij", 10);
+
+    backlog.resize(4);
+    assert(backlog.capacity() == 4);
+    assert(backlog.get_start_offset() == 6);
+    assert(copy_to_string(backlog, 6) == "ghij");
+
+    backlog.resize(16);
+    backlog.append("klmn", 4);
+    assert(backlog.get_start_offset() == 6);
+    assert(backlog.get_end_offset() == 14);
+    assert(copy_to_string(backlog, 6) == "ghijklmn");
+}
+
+int main() {
+    test_append_and_copy();
+    test_wrap_around();
+    test_resize();
+
+    return 0;
+}
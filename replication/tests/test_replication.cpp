@@ -0,0 +1,253 @@
+#include <assert.h>
+#include <cstring>
+#include <unistd.h>
+
+#include "../Replication.hpp"
+#include "../../aof/components/AofRecord.hpp"
+#include "../../command-executor/CommandExecutor.hpp"
+#include "../../conn/Conn.hpp"
+#include "../../conn/components/ConnPool.hpp"
+#include "../../rdb/Rdb.hpp"
+#include "../../response/types/NilResponse.hpp"
+#include "../../response/types/StrResponse.hpp"
+#include "../../utils/hash_utils.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+#include "../../utils/time_utils.hpp"
+
+TimerManager timers;
+ThreadPool thread_pool(2);
+Evictor evictor;
+
+/**
+ * Takes the string reply at the front of a connection's outgoing buffer.
+ * 
+ * @return  The reply.
+ */
+std::string take_reply(Conn &conn) {
+    auto [response, status] = Response::unmarshal(conn.outgoing.data(), conn.outgoing.size());
+    assert(status == Response::UnmarshalStatus::SUCCESS);
+    conn.outgoing.consume(Response::HEADER_SIZE + (*response)->length());
+
+    StrResponse *str = dynamic_cast<StrResponse *>(*response);
+    assert(str != NULL);
+    std::string reply = str->get_msg();
+    delete *response;
+    return reply;
+}
+
+/**
+ * Takes the records at the front of a connection's outgoing buffer.
+ * 
+ * @return  The commands in the records, minus the pings sent by cron().
+ */
+std::vector<std::vector<std::string>> take_records(Conn &conn) {
+    std::vector<std::vector<std::string>> commands;
+    size_t pos = 0;
+    std::vector<std::string> command;
+    while (read_aof_record(conn.outgoing.data(), conn.outgoing.size(), &pos, &command) == AofRecordStatus::OK) {
+        if (command[0] != "ping") {
+            commands.push_back(command);
+        }
+    }
+    assert(pos == conn.outgoing.size());
+    conn.outgoing.consume(pos);
+    return commands;
+}
+
+/* Gets the entry stored at a key, NULL if the key doesn't exist */
+Entry *get_entry(HMap &kv_store, const std::string &key) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = key;
+    lookup_entry.node.hval = str_hash(key);
+    HNode *node = kv_store.lookup(&lookup_entry.node, are_entries_equal);
+    return node == NULL ? NULL : container_of(node, Entry, node);
+}
+
+/* Runs cron() until a replica has been sent its snapshot */
+void wait_for_online(HMap &kv_store, ReplicaLink *replica) {
+    for (int i = 0; i < 1000 && replica->state != ReplicaState::ONLINE; i++) {
+        usleep(10 * 1000);
+        Replication::shared().cron(kv_store);
+    }
+    assert(replica->state == ReplicaState::ONLINE);
+}
+
+void test_full_sync() {
+    Replication &repl = Replication::shared();
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    executor.execute_now({"set", "before", "1"});
+    executor.execute_now({"zadd", "zset", "1", "a", "2", "b"});
+
+    assert(!repl.has_backlog()); // nothing to feed until a replica connects
+
+    Conn conn(-1, true, false, false);
+    assert(repl.handle_command(&conn, {"psync", "?", "-1"}, kv_store));
+    assert(conn.is_replica);
+    assert(repl.has_backlog());
+    assert(repl.get_replicas().size() == 1);
+    assert(take_reply(conn) == "FULLRESYNC " + repl.get_replid() + " 0");
+
+    // written after the fork, so sent right behind the snapshot rather than in it
+    executor.execute_now({"set", "after", "2", "PX", "100000"});
+    executor.execute_now({"get", "before"}); // reads aren't sent
+    ReplicaLink *replica = repl.get_replicas()[0];
+    wait_for_online(kv_store, replica);
+
+    uint64_t snapshot_len;
+    memcpy(&snapshot_len, conn.outgoing.data(), sizeof(snapshot_len));
+    conn.outgoing.consume(sizeof(snapshot_len));
+    HMap loaded;
+    assert(Rdb::load_snapshot(conn.outgoing.data(), snapshot_len, loaded, timers, evictor));
+    conn.outgoing.consume(snapshot_len);
+    assert(loaded.length() == 2);
+    assert(get_entry(loaded, "before") != NULL);
+    assert(get_entry(loaded, "zset") != NULL);
+    assert(get_entry(loaded, "after") == NULL);
+
+    std::vector<std::vector<std::string>> commands = take_records(conn);
+    assert(commands.size() == 1);
+    assert(commands[0][0] == "set" && commands[0][1] == "after" && commands[0][3] == "pxat"); // absolute expiry
+    assert(repl.get_offset() > 0);
+    assert(repl.get_stats().full_syncs == 1);
+
+    // once online, writes are streamed as they're made
+    executor.execute_now({"del", "before"});
+    commands = take_records(conn);
+    assert(commands.size() == 1);
+    assert(commands[0] == std::vector<std::string>({"del", "before"}));
+
+    // a restored key's TTL is sent as the time it expires at, like set's
+    std::string payload = ((StrResponse *) executor.execute_now({"dump", "after"}).get())->get_msg();
+    executor.execute_now({"restore-asking", "restored", "0", payload});
+    commands = take_records(conn);
+    assert(commands.size() == 1);
+    assert(commands[0][0] == "restore" && commands[0][1] == "restored" && commands[0].back() == "ABSTTL");
+    int64_t expiry_unix_ms = monotonic_to_unix_ms(get_entry(kv_store, "restored")->ttl_timer.expiry_time_ms);
+    assert(std::abs(std::stoll(commands[0][2]) - expiry_unix_ms) <= 10);
+
+    // acks give the replica's lag
+    assert(repl.handle_command(&conn, {"replconf", "ack", std::to_string(repl.get_offset())}, kv_store));
+    assert(replica->ack_offset == repl.get_offset());
+    assert(conn.outgoing.size() == 0); // acks aren't replied to
+
+    repl.remove_replica(&conn);
+    assert(!conn.is_replica);
+    assert(repl.get_replicas().empty());
+}
+
+void test_partial_sync() {
+    Replication &repl = Replication::shared();
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+
+    uint64_t offset = repl.get_offset();
+    executor.execute_now({"set", "missed", "1"});
+    executor.execute_now({"zadd", "missed_zset", "1", "a"});
+
+    // a replica that was at offset reconnects and is sent only what it missed
+    Conn conn(-1, true, false, false);
+    assert(repl.handle_command(&conn, {"psync", repl.get_replid(), std::to_string(offset)}, kv_store));
+    assert(take_reply(conn) == "CONTINUE");
+    assert(repl.get_replicas()[0]->state == ReplicaState::ONLINE);
+    std::vector<std::vector<std::string>> commands = take_records(conn);
+    assert(commands.size() == 2);
+    assert(commands[0] == std::vector<std::string>({"set", "missed", "1"}));
+    assert(commands[1] == std::vector<std::string>({"zadd", "missed_zset", "1", "a"}));
+    assert(repl.get_stats().partial_syncs == 1);
+    repl.remove_replica(&conn);
+
+    // a different history or an offset the backlog doesn't hold needs a full sync
+    uint64_t partial_sync_errs = repl.get_stats().partial_sync_errs;
+    Conn other(-1, true, false, false);
+    assert(repl.handle_command(&other, {"psync", "0123456789", std::to_string(offset)}, kv_store));
+    assert(take_reply(other).rfind("FULLRESYNC ", 0) == 0);
+    wait_for_online(kv_store, repl.get_replicas()[0]);
+    repl.remove_replica(&other);
+
+    repl.set_backlog_size(8);
+    offset = repl.get_offset();
+    executor.execute_now({"set", "overwritten", "1"});
+    Conn late(-1, true, false, false);
+    assert(repl.handle_command(&late, {"psync", repl.get_replid(), std::to_string(offset)}, kv_store));
+    assert(take_reply(late).rfind("FULLRESYNC ", 0) == 0);
+    wait_for_online(kv_store, repl.get_replicas()[0]);
+    repl.remove_replica(&late);
+    assert(repl.get_stats().partial_sync_errs == partial_sync_errs + 2);
+    repl.set_backlog_size(1024 * 1024);
+}
+
+void test_expiry() {
+    Replication &repl = Replication::shared();
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+    std::vector<Conn *> fd_to_conn;
+    ConnPool conn_pool;
+
+    Conn conn(-1, true, false, false);
+    assert(repl.handle_command(&conn, {"psync", repl.get_replid(), std::to_string(repl.get_offset())}, kv_store));
+    assert(take_reply(conn) == "CONTINUE");
+
+    // a primary sends a del for each key it expires, whether on access or in an active expiry cycle
+    executor.execute_now({"set", "lazy", "1", "PX", "1"});
+    executor.execute_now({"set", "active", "1", "PX", "1"});
+    take_records(conn);
+    usleep(20 * 1000);
+    update_cached_time();
+    assert(dynamic_cast<NilResponse *>(executor.execute_now({"get", "lazy"}).get()) != NULL);
+    timers.process_timers(kv_store, fd_to_conn, conn_pool, thread_pool);
+    std::vector<std::vector<std::string>> commands = take_records(conn);
+    assert(commands.size() == 2);
+    assert(commands[0] == std::vector<std::string>({"del", "lazy"}));
+    assert(commands[1] == std::vector<std::string>({"del", "active"}));
+    assert(kv_store.length() == 0);
+    repl.remove_replica(&conn);
+
+    // a replica hides a key whose TTL passed by its clock from clients, but only its primary's del removes it
+    executor.execute_now({"set", "key", "1", "PX", "1"});
+    repl.set_primary("localhost", "1");
+    usleep(20 * 1000);
+    update_cached_time();
+    assert(timers.get_time_until_expiry() == -1);
+    timers.process_timers(kv_store, fd_to_conn, conn_pool, thread_pool);
+    assert(dynamic_cast<NilResponse *>(executor.execute_now({"get", "key"}).get()) != NULL);
+    assert(get_entry(kv_store, "key") != NULL);
+
+    // once it's a primary again, it expires keys itself
+    repl.unset_primary();
+    timers.process_timers(kv_store, fd_to_conn, conn_pool, thread_pool);
+    assert(get_entry(kv_store, "key") == NULL);
+}
+
+void test_replica() {
+    Replication &repl = Replication::shared();
+    HMap kv_store;
+    CommandExecutor executor(&kv_store, &timers, &thread_pool, &evictor);
+
+    repl.set_primary("localhost", "1");
+    assert(repl.is_replica());
+    assert(repl.rejects_writes());
+    assert(repl.get_link_state() == PrimaryLinkState::CONNECT);
+
+    // replicas can't be replicated
+    Conn conn(-1, true, false, false);
+    assert(repl.handle_command(&conn, {"psync", "?", "-1"}, kv_store));
+    assert(!conn.is_replica);
+    assert(repl.get_replicas().empty());
+
+    std::string replid = repl.get_replid();
+    repl.unset_primary();
+    assert(!repl.is_replica());
+    assert(!repl.rejects_writes());
+    assert(repl.get_link_state() == PrimaryLinkState::NONE);
+    assert(repl.get_replid() != replid); // a new history
+}
+
+int main() {
+    test_full_sync();
+    test_partial_sync();
+    test_expiry();
+    test_replica();
+
+    return 0;
+}
@@ -10,7 +10,11 @@ class ErrResponse : public Response {
             ERR_UNKNOWN,
             ERR_TOO_BIG,
             ERR_BAD_TYPE,
-            ERR_INVALID_ARG
+            ERR_INVALID_ARG,
+            ERR_OOM,
+            ERR_READONLY,
+            ERR_MOVED,
+            ERR_ASK
         };
 
         ErrResponse(ErrorCode code, std::string msg);
@@ -3,82 +3,35 @@
 #include <poll.h>
 #include <fcntl.h>
 
+#include "aof/Aof.hpp"
+#include "background-jobs/BackgroundJobs.hpp"
+#include "cluster/Cluster.hpp"
 #include "command-executor/CommandExecutor.hpp"
 #include "conn/Conn.hpp"
+#include "conn/components/ConnPool.hpp"
 #include "constants.hpp"
+#include "defragger/Defragger.hpp"
+#include "pub-sub/PubSub.hpp"
+#include "rdb/Rdb.hpp"
+#include "replication/Replication.hpp"
 #include "timers/TimerManager.hpp"
 #include "utils/intrusive_data_structure_utils.hpp"
 #include "utils/log.hpp"
+#include "utils/net_utils.hpp"
 #include "utils/time_utils.hpp"
 
 HMap kv_store; // key-value store
 std::vector<Conn *> fd_to_conn; // map of all client connections, indexed by fd
+ConnPool conn_pool; // closed connections kept for re-use
 std::vector<struct pollfd> pollfds; // array of pollfds for poll()
 TimerManager timers; // manages idle timers for connections and TTL timers for kv store entries
 ThreadPool thread_pool(4); // pool of worker threads for executing asynchronous tasks
+Evictor evictor; // evicts kv store entries when used memory is over maxmemory
+Defragger defragger; // moves kv store entries out of sparse slabs when fragmentation is high
 
 /**
- * Gets the address info for the machine running this program which can be used in bind().
- * 
- * @return  Pointer to a struct addrinfo on success. Should be freed when no longer in use.
- *          NULL on error.
- */
-struct addrinfo *get_my_addr_info() {
-    struct addrinfo *res;
-    struct addrinfo hints;
-
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;        // IPv4 or IPv6
-    hints.ai_socktype = SOCK_STREAM;    // Stream socket
-    hints.ai_flags = AI_PASSIVE;        // Returns wildcard address
-
-    if (getaddrinfo(NULL, PORT, &hints, &res) != 0) {
-        return NULL;
-    }
-
-    return res;
-}
-
-/**
- * Starts the server by creating a listener socket bound to a pre-defined port. 
- * 
- * @param res   Pointer to a struct addrinfo containing the addrinfo for the server.
- * 
- * @return  The listener socket on success.
- *          -1 on error.
- */
-int start_server(struct addrinfo *res) {
-    struct addrinfo *p;
-    int listener;
-    for (p = res; p != NULL; p = p->ai_next) {
-        if ((listener = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) == -1) {
-            log("%s", strerror(errno));
-            continue;
-        }
-
-        int yes = 1;
-        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));  // Allows port to be re-used
-
-        if (bind(listener, p->ai_addr, p->ai_addrlen) == -1) {
-            log("%s", strerror(errno));
-            close(listener);
-            continue;
-        }
-
-        if (listen(listener, SOMAXCONN) == -1) {
-            log("%s", strerror(errno));
-            close(listener);
-            continue;
-        }
-
-        return listener;
-    }
-
-    return -1;
-}
-
-/**
- * Initializes the pollfds array from the map of open connections (fd_to_conn).
+ * Initializes the pollfds array from the listener, the background job pipe, the link to the primary, and the map of 
+ * open connections (fd_to_conn).
  */
 void init_pollfds(int listener) {
     // reset from last event loop
@@ -87,6 +40,13 @@ void init_pollfds(int listener) {
     struct pollfd pfd = {listener, POLLIN, 0};
     pollfds.push_back(pfd);
 
+    pfd = {BackgroundJobs::shared().get_fd(), POLLIN, 0};
+    pollfds.push_back(pfd);
+
+    // -1 when this server isn't a replica, which poll() ignores
+    pfd = {Replication::shared().get_link_fd(), Replication::shared().get_link_events(), 0};
+    pollfds.push_back(pfd);
+
     for (Conn *conn : fd_to_conn) {
         // conn set to NULL when connection is terminated
         if (conn == NULL) {
@@ -106,33 +66,6 @@ void init_pollfds(int listener) {
     }
 }
 
-/** 
- * Sets a socket so that it is non-blocking.
- * 
- * @param fd    The socket to update.
- * 
- * @return  True on success.
- *          False on error.
- */
-bool set_non_blocking(int fd) {
-    // get current socket flags
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags == -1) {
-        return false;
-    }
-
-    // Add the O_NONBLOCK flag
-    flags |= O_NONBLOCK;
-
-    // update socket flags
-    int result = fcntl(fd, F_SETFL, flags);
-    if (result == -1) {
-        return false;
-    }
-
-    return true;
-}
-
 /**
  * Handles a new connection on the listener socket.
  * 
@@ -151,10 +84,10 @@ void handle_new_connection(int listener) {
         return;
     }
 
-    Conn *conn = new Conn(client, true, false, false);
+    Conn *conn = conn_pool.acquire(client, true, false, false);
     conn->idle_timer.set_expiry(&timers);
 
-    if (fd_to_conn.size() < (uint32_t) conn->fd) {
+    if (fd_to_conn.size() <= (uint32_t) conn->fd) {
         fd_to_conn.resize(conn->fd + 1);
     }
 
@@ -163,8 +96,31 @@ void handle_new_connection(int listener) {
     log("new connection %d", client);
 }
 
-int main() {
-    struct addrinfo *res = get_my_addr_info();
+/**
+ * Finishes the BackgroundJobs that are done running and hands their responses to the connections waiting on them.
+ */
+void handle_finished_jobs() {
+    CommandExecutor cmd_executor(&kv_store, &timers, &thread_pool, &evictor);
+    for (BackgroundJob *job : BackgroundJobs::shared().take_finished()) {
+        Conn *conn = job->conn;
+        std::unique_ptr<Response> response = cmd_executor.finish_job(job);
+        if (conn == NULL) {
+            continue; // connection closed while the job was running
+        }
+
+        conn->handle_job_finished(*response, kv_store, timers, thread_pool, evictor);
+        if (conn->want_close) {
+            conn->handle_close(fd_to_conn, &timers);
+            conn_pool.release(conn);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // ./server [port] [--cluster]
+    const char *port = argc >= 2 ? argv[1] : PORT;
+    bool cluster_mode = argc >= 3 && std::string(argv[2]) == "--cluster";
+    struct addrinfo *res = get_my_addr_info(port);
     if (res == NULL) {
         fatal("failed to get server's addrinfo");
     }
@@ -175,21 +131,52 @@ int main() {
     }
     freeaddrinfo(res);
 
-    log("started server");
+    if (cluster_mode) {
+        Cluster::shared().enable(std::string("127.0.0.1:") + port); // before loading, so every key is indexed
+    }
+
+    if (APPEND_ONLY) {
+        if (!Aof::shared().load(kv_store, timers, thread_pool, evictor)) {
+            fatal("failed to load append-only file");
+        }
+    } else if (!Rdb::shared().load(kv_store, timers, evictor)) {
+        fatal("failed to load snapshot");
+    }
+
+    log("started server on port %s", port);
 
     while (true) {
         init_pollfds(listener);
 
-        if (poll(pollfds.data(), pollfds.size(), timers.get_time_until_expiry()) == -1) {
+        int32_t timeout_ms = timers.get_time_until_expiry();
+        if (ACTIVE_DEFRAG && defragger.get_stats().running && 
+            (timeout_ms == -1 || timeout_ms > (int32_t) Defragger::CYCLE_INTERVAL_MS)) {
+            timeout_ms = Defragger::CYCLE_INTERVAL_MS; // keep the defrag pass moving even if there are no events
+        }
+        if (Rdb::shared().needs_cron() && (timeout_ms == -1 || timeout_ms > (int32_t) Rdb::CRON_INTERVAL_MS)) {
+            timeout_ms = Rdb::CRON_INTERVAL_MS; // reap a finished bgsave child and check the save points on time
+        }
+        if ((Aof::shared().needs_flush() || Aof::shared().needs_cron()) && 
+            (timeout_ms == -1 || timeout_ms > (int32_t) Aof::CRON_INTERVAL_MS)) {
+            // an everysec fsync is due or a rewrite child may finish even if no more writes come in
+            timeout_ms = Aof::CRON_INTERVAL_MS;
+        }
+        if (Replication::shared().needs_cron() && 
+            (timeout_ms == -1 || timeout_ms > (int32_t) Replication::CRON_INTERVAL_MS)) {
+            timeout_ms = Replication::CRON_INTERVAL_MS; // keep snapshots, pings, acks, and reconnects moving
+        }
+
+        if (poll(pollfds.data(), pollfds.size(), timeout_ms) == -1) {
             fatal("failed to poll");
         }
+        update_cached_time(); // everything handled in this iteration uses the same "now"
 
         // listener socket always at index 0 of pollfds
         if (pollfds[0].revents & POLLIN) {
             handle_new_connection(listener);
         }
 
-        for (uint32_t i = 1; i < pollfds.size(); i++) {
+        for (uint32_t i = 3; i < pollfds.size(); i++) {
             uint16_t revents = pollfds[i].revents;
             if (revents == 0) {
                 continue;
@@ -199,7 +186,7 @@ int main() {
             conn->idle_timer.set_expiry(&timers);
 
             if (revents & POLLIN) {
-                conn->handle_recv(kv_store, timers, thread_pool);
+                conn->handle_recv(kv_store, timers, thread_pool, evictor);
             }
 
             if (revents & POLLOUT) {
@@ -208,9 +195,40 @@ int main() {
 
             if (revents & POLLERR || conn->want_close) {
                 conn->handle_close(fd_to_conn, &timers);
+                conn_pool.release(conn);
             }
         }
 
-        timers.process_timers(kv_store, fd_to_conn, thread_pool);
+        // background job pipe always at index 1. Handled after the connections so none of them is closed under the 
+        // loop above
+        if (pollfds[1].revents & POLLIN) {
+            handle_finished_jobs();
+        }
+
+        // link to the primary always at index 2. A command above may have replaced it, in which case its events are 
+        // stale
+        if (pollfds[2].revents != 0 && pollfds[2].fd == Replication::shared().get_link_fd()) {
+            Replication::shared().handle_link(pollfds[2].revents, kv_store, timers, thread_pool, evictor);
+        }
+
+        // subscribers a publish above took over their output limit. Those the loop above already reached were closed 
+        // there, the rest are closed here
+        for (Conn *conn : PubSub::shared().take_slow_subscribers()) {
+            conn->handle_close(fd_to_conn, &timers);
+            conn_pool.release(conn);
+        }
+
+        timers.process_timers(kv_store, fd_to_conn, conn_pool, thread_pool);
+
+        if (ACTIVE_DEFRAG) {
+            defragger.run(kv_store, timers);
+        }
+
+        Rdb::shared().cron(kv_store);
+        Aof::shared().cron(kv_store);
+        Replication::shared().cron(kv_store);
+
+        // one write for everything logged this iteration, before any reply held back for it is sent
+        Aof::shared().flush(thread_pool);
     }
 }
@@ -0,0 +1,256 @@
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Proxy.hpp"
+#include "../cluster/components/KeySlot.hpp"
+#include "../response/types/ErrResponse.hpp"
+#include "../utils/log.hpp"
+#include "../utils/net_utils.hpp"
+
+Proxy::Proxy(const std::vector<std::string> &addrs, uint32_t conns_per_backend) : ring(addrs), backends(addrs.size()) {
+    for (uint32_t i = 0; i < addrs.size(); i++) {
+        for (uint32_t j = 0; j < conns_per_backend; j++) {
+            backends[i].push_back(new BackendConn(addrs[i]));
+        }
+    }
+}
+
+Proxy::~Proxy() {
+    for (ProxyConn *conn : fd_to_conn) {
+        if (conn != NULL) {
+            conn->handle_close();
+            delete conn;
+        }
+    }
+    for (std::vector<BackendConn *> &conns : backends) {
+        for (BackendConn *backend_conn : conns) {
+            delete backend_conn;
+        }
+    }
+}
+
+void Proxy::handle_new_connection(int listener) {
+    int client = accept(listener, NULL, NULL);
+    if (client == -1) {
+        log("failed to accept new connection");
+        return;
+    }
+
+    if (!set_non_blocking(client)) {
+        log("failed to set socket to non-blocking");
+        close(client);
+        return;
+    }
+
+    // replies are written in batches already, don't let Nagle hold one back
+    int yes = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+    if (fd_to_conn.size() <= (uint32_t) client) {
+        fd_to_conn.resize(client + 1);
+    }
+    fd_to_conn[client] = new ProxyConn(client);
+
+    log("new client %d", client);
+}
+
+void Proxy::process_requests(ProxyConn *conn) {
+    while (conn->want_read()) {
+        Request *request = conn->parse_request();
+        if (request == NULL) {
+            break;
+        }
+        debug("client %d request: %s", conn->fd, request->to_string().data());
+
+        stats.requests++;
+        route(conn, request->get_cmd());
+        delete request;
+    }
+}
+
+void Proxy::route(ProxyConn *conn, const std::vector<std::string> &command) {
+    std::vector<std::pair<uint32_t, std::vector<std::string>>> parts;
+    const std::string name = command.empty() ? "" : command[0];
+
+    if ((name == "mget" && command.size() >= 2) || (name == "del" && command.size() >= 3)) {
+        // scatter as one single-key command per key
+        std::string part_name = name == "mget" ? "get" : "del";
+        for (uint32_t i = 1; i < command.size(); i++) {
+            parts.push_back({ ring.get_node(command[i]), { part_name, command[i] } });
+        }
+        send_parts(conn, name == "mget" ? ProxyMerge::ARRAY : ProxyMerge::SUM, parts);
+        return;
+    }
+
+    bool is_keys = name == "keys" && command.size() == 1;
+    if (is_keys || name == "save" || name == "bgsave" || name == "bgrewriteaof" ||
+        (name == "config" && command.size() >= 2 && command[1] == "set")) {
+        for (uint32_t i = 0; i < ring.size(); i++) {
+            parts.push_back({ i, command });
+        }
+        send_parts(conn, is_keys ? ProxyMerge::CONCAT : ProxyMerge::FIRST, parts);
+        return;
+    }
+
+    if (name == "publish") {
+        // subscribers connect to the servers directly, so the message has to reach every one of them
+        for (uint32_t i = 0; i < ring.size(); i++) {
+            parts.push_back({ i, command });
+        }
+        send_parts(conn, ProxyMerge::SUM, parts);
+        return;
+    }
+
+    // a subscription would have messages pushed down a connection shared with other clients
+    if (name == "cluster" || name == "replicaof" || name == "migrate" || name == "subscribe" || 
+        name == "psubscribe" || name == "unsubscribe" || name == "punsubscribe") {
+        ErrResponse err(ErrResponse::ErrorCode::ERR_UNKNOWN, name + " is not supported by the proxy");
+        reply(conn, err);
+        return;
+    }
+
+    std::vector<std::string> keys = get_command_keys(command);
+    uint32_t node = keys.empty() ? 0 : ring.get_node(keys[0]);
+    for (uint32_t i = 1; i < keys.size(); i++) {
+        if (ring.get_node(keys[i]) != node) {
+            ErrResponse err(ErrResponse::ErrorCode::ERR_INVALID_ARG,
+                            "CROSSSLOT Keys in request don't hash to the same backend");
+            reply(conn, err);
+            return;
+        }
+    }
+    parts.push_back({ node, command });
+    send_parts(conn, ProxyMerge::NONE, parts);
+}
+
+void Proxy::send_parts(ProxyConn *conn, ProxyMerge merge,
+                       const std::vector<std::pair<uint32_t, std::vector<std::string>>> &parts) {
+    std::shared_ptr<ProxyRequest> request = std::make_shared<ProxyRequest>(conn, merge, parts.size());
+    conn->in_flight.push_back(request);
+    for (uint32_t i = 0; i < parts.size(); i++) {
+        std::vector<BackendConn *> &conns = backends[parts[i].first];
+        conns[conn->fd % conns.size()]->send(parts[i].second, request, i, done);
+        stats.parts++;
+    }
+}
+
+void Proxy::reply(ProxyConn *conn, Response &response) {
+    std::shared_ptr<ProxyRequest> request = std::make_shared<ProxyRequest>(conn, ProxyMerge::NONE, 1);
+    request->set_reply(0, response);
+    conn->in_flight.push_back(request);
+    done.push_back(request);
+}
+
+void Proxy::flush() {
+    for (std::vector<BackendConn *> &conns : backends) {
+        for (BackendConn *backend_conn : conns) {
+            stats.batches += backend_conn->flush(done);
+        }
+    }
+
+    for (uint32_t i = 0; i < done.size(); i++) {
+        // a client's replies may come back out of order, write_replies() only writes the ones that are next in line
+        ProxyConn *conn = done[i]->conn;
+        if (conn == NULL) {
+            continue; // client closed, or the reply was already written for an earlier request in done
+        }
+
+        conn->write_replies();
+        conn->send_data();
+        if (conn->incoming.size() > 0) {
+            process_requests(conn); // requests held back while the client was at MAX_IN_FLIGHT
+        }
+        if (conn->want_close) {
+            close_conn(conn);
+        }
+    }
+    done.clear();
+}
+
+void Proxy::close_conn(ProxyConn *conn) {
+    fd_to_conn[conn->fd] = NULL;
+    conn->handle_close();
+    delete conn;
+}
+
+void Proxy::poll_once(int listener, int timeout_ms) {
+    pollfds.clear();
+    polled_backends.clear();
+
+    struct pollfd pfd = {listener, POLLIN, 0};
+    pollfds.push_back(pfd);
+
+    for (std::vector<BackendConn *> &conns : backends) {
+        for (BackendConn *backend_conn : conns) {
+            if (backend_conn->fd == -1) {
+                continue;
+            }
+            pfd = {backend_conn->fd, POLLIN, 0};
+            if (backend_conn->want_write()) {
+                pfd.events |= POLLOUT;
+            }
+            pollfds.push_back(pfd);
+            polled_backends.push_back(backend_conn);
+        }
+    }
+
+    for (ProxyConn *conn : fd_to_conn) {
+        if (conn == NULL) {
+            continue;
+        }
+        pfd = {conn->fd, 0, 0};
+        if (conn->want_read()) {
+            pfd.events |= POLLIN;
+        }
+        if (conn->want_write()) {
+            pfd.events |= POLLOUT;
+        }
+        pollfds.push_back(pfd);
+    }
+
+    if (poll(pollfds.data(), pollfds.size(), timeout_ms) == -1) {
+        fatal("failed to poll");
+    }
+
+    // listener socket always at index 0 of pollfds
+    if (pollfds[0].revents & POLLIN) {
+        handle_new_connection(listener);
+    }
+
+    for (uint32_t i = 0; i < polled_backends.size(); i++) {
+        uint16_t revents = pollfds[1 + i].revents;
+        if (revents & (POLLIN | POLLERR | POLLHUP)) {
+            polled_backends[i]->handle_recv(done);
+        }
+        if (revents & POLLOUT) {
+            polled_backends[i]->handle_send(done);
+        }
+    }
+
+    for (uint32_t i = 1 + polled_backends.size(); i < pollfds.size(); i++) {
+        uint16_t revents = pollfds[i].revents;
+        if (revents == 0) {
+            continue;
+        }
+
+        ProxyConn *conn = fd_to_conn[pollfds[i].fd];
+        if (revents & POLLIN && conn->recv_data()) {
+            process_requests(conn);
+        }
+        if (revents & POLLOUT) {
+            conn->send_data();
+        }
+        if (revents & (POLLERR | POLLHUP) || conn->want_close) {
+            close_conn(conn);
+        }
+    }
+
+    // one send per backend for all the parts queued above, then the replies that came back
+    flush();
+}
+
+const ProxyStats &Proxy::get_stats() {
+    return stats;
+}
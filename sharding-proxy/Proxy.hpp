@@ -0,0 +1,124 @@
+#pragma once
+
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <vector>
+
+#include "components/BackendConn.hpp"
+#include "components/HashRing.hpp"
+#include "components/ProxyConn.hpp"
+#include "components/ProxyRequest.hpp"
+
+/* Stats for a Proxy */
+struct ProxyStats {
+    uint64_t requests = 0; // client requests received
+    uint64_t parts = 0; // requests sent to backends; more than requests when some were scattered
+    uint64_t batches = 0; // sends to backends, each carrying every part queued on the connection since the last one
+};
+
+/**
+ * Sharding proxy that spreads keys over a set of backend servers.
+ * 
+ * Clients connect to the proxy instead of to every backend, and the proxy multiplexes all of them over a few pipelined 
+ * connections per backend (see BackendConn), so a backend's connection count stays fixed no matter how many clients 
+ * there are. A connection is picked by the client's socket, so the requests of one client to one backend always share 
+ * a connection and run in the order they were sent.
+ * 
+ * Each request is routed by its keys on a consistent hash ring (see HashRing):
+ * - A command whose keys all map to one backend is forwarded there, and the reply is passed back without being 
+ *   unmarshalled.
+ * - mget and del with several keys are scattered as a get or del per key, and the replies gathered into an array or a 
+ *   count.
+ * - keys is sent to every backend and the results concatenated. save, bgsave, bgrewriteaof, and config set are also 
+ *   sent to every backend. Other commands without keys (e.g. info) go to the first backend.
+ * - Commands whose keys map to different backends (e.g. a zunionstore without a shared hashtag) fail with CROSSSLOT, 
+ *   and commands that only make sense on a single server (cluster, replicaof, migrate) are rejected.
+ * 
+ * Everything runs on one thread in a poll() loop. Parts queued for a backend during an iteration are sent together at 
+ * the end of it, so a busy proxy sends each backend one batch per iteration however many clients contributed to it.
+ */
+class Proxy {
+    private:
+        HashRing ring;
+        std::vector<std::vector<BackendConn *>> backends; // connections to each backend
+        std::vector<ProxyConn *> fd_to_conn; // map of all client connections, indexed by fd
+        std::vector<struct pollfd> pollfds; // array of pollfds for poll()
+        std::vector<BackendConn *> polled_backends; // backend connection at each pollfds index after the listener
+        std::vector<std::shared_ptr<ProxyRequest>> done; // requests answered during the current iteration
+        ProxyStats stats;
+
+        /**
+         * Handles a new connection on the listener socket.
+         * 
+         * @param listener  The listener socket.
+         */
+        void handle_new_connection(int listener);
+
+        /**
+         * Parses and routes the requests in a client's incoming buffer, until the client hits MAX_IN_FLIGHT.
+         * 
+         * @param conn  The client.
+         */
+        void process_requests(ProxyConn *conn);
+
+        /**
+         * Routes a request to the backends. See the class description.
+         * 
+         * @param conn      The client that sent it.
+         * @param command   The command, broken up into its individual strings.
+         */
+        void route(ProxyConn *conn, const std::vector<std::string> &command);
+
+        /**
+         * Queues a client request with its parts, each on the connection to its backend.
+         * 
+         * @param conn      The client that sent it.
+         * @param merge     How the replies to the parts are combined.
+         * @param parts     The backend and command of each part.
+         */
+        void send_parts(ProxyConn *conn, ProxyMerge merge,
+                        const std::vector<std::pair<uint32_t, std::vector<std::string>>> &parts);
+
+        /**
+         * Answers a client request from the proxy itself.
+         * 
+         * @param conn      The client that sent it.
+         * @param response  Reference to the reply.
+         */
+        void reply(ProxyConn *conn, Response &response);
+
+        /* Sends every backend the parts queued for it, then writes the replies of the requests that are done */
+        void flush();
+
+        /**
+         * Closes a client connection and deallocates it.
+         * 
+         * @param conn  The client.
+         */
+        void close_conn(ProxyConn *conn);
+    public:
+        /**
+         * Initializes a Proxy. No backend connection is made until a request needs it.
+         * 
+         * @param addrs             The "host:port" of each backend.
+         * @param conns_per_backend The number of connections to open to each backend.
+         */
+        Proxy(const std::vector<std::string> &addrs, uint32_t conns_per_backend);
+
+        ~Proxy();
+
+        Proxy(const Proxy &) = delete;
+        Proxy &operator=(const Proxy &) = delete;
+
+        /**
+         * Runs one iteration of the event loop: waits for events, then handles them.
+         * 
+         * @param listener      The listener socket clients connect to.
+         * @param timeout_ms    Longest to wait for an event, -1 to wait forever.
+         */
+        void poll_once(int listener, int timeout_ms);
+
+        /* Returns the stats for the proxy */
+        const ProxyStats &get_stats();
+};
@@ -0,0 +1,284 @@
+#include <assert.h>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../components/HashRing.hpp"
+#include "../../buffer/Buffer.hpp"
+#include "../../cluster/components/ClusterClient.hpp"
+#include "../../request/Request.hpp"
+#include "../../response/types/ErrResponse.hpp"
+#include "../../utils/buf_utils.hpp"
+#include "../../utils/net_utils.hpp"
+#include "../../utils/time_utils.hpp"
+
+// Compares app processes sharding keys themselves, each with a connection to every backend, against the same
+// processes going through the proxy with one connection each. Every client pipelines PIPELINE requests at a time (a
+// mix of set and get on random keys) and sends the next batch once all of them are answered. Reports the throughput
+// and how many connections the backends end up holding.
+
+const uint32_t NUM_BACKENDS = 3;
+const uint32_t CONNS_PER_BACKEND = 2;
+const uint32_t CLIENTS[] = { 50, 500 };
+const uint32_t PIPELINE = 16;
+const uint32_t NUM_OPS = 200000;
+const uint32_t NUM_KEYS = 100000;
+
+/* A server or proxy process */
+struct Process {
+    pid_t pid;
+    std::string addr;
+    std::string dir;
+};
+
+/* A client: its connection to each target, and the replies it is still waiting for */
+struct Client {
+    std::vector<int> fds;
+    std::vector<std::string> incoming; // unparsed replies, per connection
+    uint32_t outstanding = 0;
+};
+
+Process start_process(const std::string &binary, const std::vector<std::string> &args, uint32_t port) {
+    char path[PATH_MAX];
+    assert(realpath(("./" + binary).data(), path) != NULL);
+
+    Process process;
+    char dir[] = "/tmp/bench_proxy_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    process.dir = dir;
+    process.addr = "127.0.0.1:" + std::to_string(port);
+
+    std::vector<std::string> argv_strs = { binary, std::to_string(port) };
+    argv_strs.insert(argv_strs.end(), args.begin(), args.end());
+
+    process.pid = fork();
+    assert(process.pid != -1);
+    if (process.pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        std::vector<char *> argv;
+        for (std::string &arg : argv_strs) {
+            argv.push_back(arg.data());
+        }
+        argv.push_back(NULL);
+        if (chdir(dir) == 0) {
+            execv(path, argv.data());
+        }
+        _exit(1);
+    }
+
+    bool up = false;
+    for (int i = 0; i < 1000 && !up; i++) {
+        ClusterClient probe(process.addr);
+        up = dynamic_cast<ErrResponse *>(probe.execute({ { "lastsave" } })[0].get()) == NULL;
+        if (!up) {
+            usleep(10 * 1000);
+        }
+    }
+    assert(up);
+    return process;
+}
+
+void stop_process(Process &process) {
+    kill(process.pid, SIGKILL);
+    waitpid(process.pid, NULL, 0);
+    rmdir(process.dir.data());
+}
+
+/* Opens a blocking connection to "127.0.0.1:<port>" */
+int connect_to(const std::string &addr) {
+    std::string port = addr.substr(addr.rfind(':') + 1);
+    struct addrinfo hints = {}, *res;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    assert(getaddrinfo("127.0.0.1", port.data(), &hints, &res) == 0);
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    assert(fd != -1 && connect(fd, res->ai_addr, res->ai_addrlen) == 0);
+    freeaddrinfo(res);
+    return fd;
+}
+
+/**
+ * Sends a client's next batch, each request to the connection the client routes its key to.
+ * 
+ * @param client    The client.
+ * @param ring      The ring used to pick a connection, NULL if the client has only one.
+ */
+void send_batch(Client &client, const HashRing *ring) {
+    std::vector<Buffer> bufs(client.fds.size());
+    for (uint32_t i = 0; i < PIPELINE; i++) {
+        std::string key = "key:" + std::to_string(rand() % NUM_KEYS);
+        std::vector<std::string> command = rand() % 4 == 0 ? std::vector<std::string>{ "set", key, "value" } :
+                                                             std::vector<std::string>{ "get", key };
+        Request(command).marshal(bufs[ring == NULL ? 0 : ring->get_node(key)]);
+    }
+    for (uint32_t i = 0; i < client.fds.size(); i++) {
+        if (bufs[i].size() > 0) {
+            assert(send_all(client.fds[i], bufs[i].data(), bufs[i].size()) == 0);
+        }
+    }
+    client.outstanding = PIPELINE;
+}
+
+/**
+ * Counts the complete replies at the front of a connection's unparsed data, removing them.
+ * 
+ * @param incoming  Reference to the unparsed data.
+ * 
+ * @return  The number of replies.
+ */
+uint32_t take_replies(std::string &incoming) {
+    uint32_t n = 0;
+    size_t pos = 0;
+    while (incoming.size() - pos >= Response::HEADER_SIZE) {
+        char *p = incoming.data() + pos;
+        uint32_t len;
+        read_uint32(&len, &p);
+        if (incoming.size() - pos < Response::HEADER_SIZE + len) {
+            break;
+        }
+        pos += Response::HEADER_SIZE + len;
+        n++;
+    }
+    incoming.erase(0, pos);
+    return n;
+}
+
+/**
+ * Runs the workload.
+ * 
+ * @param clients   The clients, connected.
+ * @param ring      The ring clients route keys with, NULL if each client has one connection to the proxy.
+ * 
+ * @return  The time taken in ms.
+ */
+double run(std::vector<Client> &clients, const HashRing *ring) {
+    std::vector<struct pollfd> pollfds;
+    std::vector<uint32_t> owners; // client of each pollfd
+    for (uint32_t i = 0; i < clients.size(); i++) {
+        for (int fd : clients[i].fds) {
+            pollfds.push_back({ fd, POLLIN, 0 });
+            owners.push_back(i);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sent = 0, done = 0;
+    for (Client &client : clients) {
+        send_batch(client, ring);
+        sent += PIPELINE;
+    }
+
+    char buf[64 * 1024];
+    while (done < sent) {
+        assert(poll(pollfds.data(), pollfds.size(), -1) > 0);
+        for (uint32_t i = 0; i < pollfds.size(); i++) {
+            if (pollfds[i].revents == 0) {
+                continue;
+            }
+            Client &client = clients[owners[i]];
+            uint32_t conn = 0;
+            while (client.fds[conn] != pollfds[i].fd) {
+                conn++;
+            }
+
+            ssize_t n = recv(pollfds[i].fd, buf, sizeof(buf), 0);
+            assert(n > 0);
+            client.incoming[conn].append(buf, n);
+            uint32_t replies = take_replies(client.incoming[conn]);
+            client.outstanding -= replies;
+            done += replies;
+
+            if (client.outstanding == 0 && sent < NUM_OPS) {
+                send_batch(client, ring);
+                sent += PIPELINE;
+            }
+        }
+    }
+
+    return elapsed_ms(start);
+}
+
+void report(const char *mode, uint32_t num_clients, uint32_t backend_conns, double ms) {
+    printf("%-7s %4u clients %5u backend conns %8u ops %10.2f ms %10.0f ops/s\n", mode, num_clients, backend_conns,
+           NUM_OPS, ms, NUM_OPS / ms * 1000);
+}
+
+void bench_direct(uint32_t num_clients, const std::vector<Process> &backends) {
+    std::vector<std::string> addrs;
+    for (const Process &backend : backends) {
+        addrs.push_back(backend.addr);
+    }
+    HashRing ring(addrs);
+
+    std::vector<Client> clients(num_clients);
+    for (Client &client : clients) {
+        for (const std::string &addr : addrs) {
+            client.fds.push_back(connect_to(addr));
+        }
+        client.incoming.resize(addrs.size());
+    }
+
+    double ms = run(clients, &ring);
+    report("direct", num_clients, num_clients * NUM_BACKENDS, ms);
+
+    for (Client &client : clients) {
+        for (int fd : client.fds) {
+            close(fd);
+        }
+    }
+}
+
+void bench_proxy(uint32_t num_clients, const Process &proxy) {
+    std::vector<Client> clients(num_clients);
+    for (Client &client : clients) {
+        client.fds.push_back(connect_to(proxy.addr));
+        client.incoming.resize(1);
+    }
+
+    double ms = run(clients, NULL);
+    report("proxy", num_clients, NUM_BACKENDS * CONNS_PER_BACKEND, ms);
+
+    for (Client &client : clients) {
+        close(client.fds[0]);
+    }
+}
+
+int main() {
+    srand(0);
+    signal(SIGPIPE, SIG_IGN);
+    uint32_t base_port = 20000 + (getpid() % 1500) * 8;
+
+    std::vector<Process> backends;
+    std::vector<std::string> proxy_args;
+    for (uint32_t i = 0; i < NUM_BACKENDS; i++) {
+        backends.push_back(start_process("server", {}, base_port + i));
+        proxy_args.push_back(backends[i].addr);
+    }
+    proxy_args.push_back("--conns");
+    proxy_args.push_back(std::to_string(CONNS_PER_BACKEND));
+    Process proxy = start_process("proxy", proxy_args, base_port + NUM_BACKENDS);
+
+    for (uint32_t num_clients : CLIENTS) {
+        bench_direct(num_clients, backends);
+        bench_proxy(num_clients, proxy);
+    }
+
+    stop_process(proxy);
+    for (Process &backend : backends) {
+        stop_process(backend);
+    }
+
+    return 0;
+}
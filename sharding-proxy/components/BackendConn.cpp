@@ -0,0 +1,197 @@
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "BackendConn.hpp"
+#include "../../request/Request.hpp"
+#include "../../response/types/ErrResponse.hpp"
+#include "../../utils/buf_utils.hpp"
+#include "../../utils/log.hpp"
+#include "../../utils/net_utils.hpp"
+
+BackendConn::BackendConn(const std::string &addr) : addr(addr) {}
+
+BackendConn::~BackendConn() {
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+bool BackendConn::open() {
+    size_t colon = addr.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    std::string host = addr.substr(0, colon);
+    std::string port = addr.substr(colon + 1);
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.data(), port.data(), &hints, &res) != 0) {
+        return false;
+    }
+
+    for (struct addrinfo *p = res; p != NULL; p = p->ai_next) {
+        if ((fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) == -1) {
+            continue;
+        }
+        if (!set_non_blocking(fd)) {
+            close(fd);
+            fd = -1;
+            continue;
+        }
+
+        // requests are already batched per poll() iteration, so don't let Nagle hold back the next batch until the
+        // replies to the previous one are acked
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        int rc = connect(fd, p->ai_addr, p->ai_addrlen);
+        if (rc == 0 || errno == EINPROGRESS) {
+            connecting = rc != 0;
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd == -1) {
+        log("failed to connect to backend %s", addr.data());
+        return false;
+    }
+    return true;
+}
+
+void BackendConn::fail(std::vector<std::shared_ptr<ProxyRequest>> &done) {
+    log("connection to backend %s failed, failing %lu pending requests", addr.data(), pending.size());
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+    connecting = false;
+    incoming.reset();
+    outgoing.reset();
+
+    ErrResponse err(ErrResponse::ErrorCode::ERR_UNKNOWN, "backend " + addr + " is unreachable");
+    for (Pending &p : pending) {
+        p.request->set_reply(p.part, err);
+        if (p.request->is_done()) {
+            done.push_back(p.request);
+        }
+    }
+    pending.clear();
+}
+
+void BackendConn::send(const std::vector<std::string> &command, const std::shared_ptr<ProxyRequest> &request,
+                       uint32_t part, std::vector<std::shared_ptr<ProxyRequest>> &done) {
+    if (fd == -1 && !open()) {
+        ErrResponse err(ErrResponse::ErrorCode::ERR_UNKNOWN, "backend " + addr + " is unreachable");
+        request->set_reply(part, err);
+        if (request->is_done()) {
+            done.push_back(request);
+        }
+        return;
+    }
+
+    Request(command).marshal(outgoing); // a part is never bigger than the client request it came from
+    pending.push_back({ request, part });
+}
+
+void BackendConn::handle_send(std::vector<std::shared_ptr<ProxyRequest>> &done) {
+    if (fd == -1) {
+        return;
+    }
+
+    if (connecting) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err != 0) {
+            fail(done);
+            return;
+        }
+        connecting = false;
+    }
+
+    if (outgoing.size() == 0) {
+        return;
+    }
+
+    ssize_t sent = ::send(fd, outgoing.data(), outgoing.size(), MSG_NOSIGNAL);
+    if (sent == -1 && errno == EAGAIN) {
+        return;
+    } else if (sent < 0) {
+        fail(done);
+        return;
+    }
+    outgoing.consume((uint32_t) sent);
+}
+
+bool BackendConn::flush(std::vector<std::shared_ptr<ProxyRequest>> &done) {
+    if (fd == -1 || connecting || outgoing.size() == 0) {
+        return false;
+    }
+    handle_send(done);
+    return true;
+}
+
+void BackendConn::handle_recv(std::vector<std::shared_ptr<ProxyRequest>> &done) {
+    if (fd == -1) {
+        return;
+    }
+
+    char buf[64 * 1024];
+    ssize_t recvd = recv(fd, buf, sizeof(buf), 0);
+    if (recvd == -1 && errno == EAGAIN) {
+        return;
+    } else if (recvd <= 0) {
+        fail(done);
+        return;
+    }
+    incoming.append(buf, (uint32_t) recvd);
+
+    while (incoming.size() >= Response::HEADER_SIZE) {
+        char *p = incoming.data();
+        uint32_t len;
+        read_uint32(&len, &p);
+        if (len > Response::MAX_LEN || pending.empty()) {
+            log("unexpected reply from backend %s", addr.data());
+            fail(done);
+            return;
+        } else if (incoming.size() < Response::HEADER_SIZE + len) {
+            break;
+        }
+
+        Pending next = std::move(pending.front());
+        pending.pop_front();
+        next.request->set_reply(next.part, std::string(incoming.data(), Response::HEADER_SIZE + len));
+        incoming.consume(Response::HEADER_SIZE + len);
+        if (next.request->is_done()) {
+            done.push_back(std::move(next.request));
+        }
+    }
+
+    if (pending.empty() && outgoing.size() == 0) {
+        // idle until the next request, don't hold on to buffer memory in the meantime
+        incoming.release();
+        outgoing.release();
+    }
+}
+
+bool BackendConn::want_write() {
+    return fd != -1 && (connecting || outgoing.size() > 0);
+}
+
+bool BackendConn::want_read() {
+    return fd != -1;
+}
+
+const std::string &BackendConn::get_addr() {
+    return addr;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ProxyRequest.hpp"
+#include "../../buffer/Buffer.hpp"
+
+/**
+ * Non-blocking, pipelined connection from the proxy to a backend server.
+ * 
+ * Parts of client requests are queued on the connection and sent together whenever the socket is writable, without 
+ * waiting for the replies to the earlier ones. A server replies to the requests on a connection in the order it 
+ * received them, so the replies are matched up with the pending parts first in, first out.
+ * 
+ * The connection is opened lazily, and if it fails or the backend closes it, every pending part gets an error. The next 
+ * part sent reconnects.
+ */
+class BackendConn {
+    private:
+        /* A part of a client request waiting for its reply */
+        struct Pending {
+            std::shared_ptr<ProxyRequest> request;
+            uint32_t part;
+        };
+
+        std::string addr; // "host:port"
+        bool connecting = false; // whether a non-blocking connect() is in progress
+        Buffer incoming = Buffer(); // replies not yet matched to a pending part
+        Buffer outgoing = Buffer(); // requests not yet sent
+        std::deque<Pending> pending;
+
+        /**
+         * Starts connecting to the backend.
+         * 
+         * @return  True if the connection is open or being opened.
+         *          False if it failed.
+         */
+        bool open();
+
+        /**
+         * Closes the connection after an error, failing every pending part.
+         * 
+         * @param done  Reference to where the requests finished by the failure are added.
+         */
+        void fail(std::vector<std::shared_ptr<ProxyRequest>> &done);
+    public:
+        int fd = -1;
+
+        /**
+         * Initializes a BackendConn. No connection is made until the first part is sent.
+         * 
+         * @param addr  The backend's "host:port".
+         */
+        BackendConn(const std::string &addr);
+
+        ~BackendConn();
+
+        BackendConn(const BackendConn &) = delete;
+        BackendConn &operator=(const BackendConn &) = delete;
+
+        /**
+         * Queues a part of a request to be sent. If the backend can't be reached, the part is failed right away.
+         * 
+         * @param command   The command to send.
+         * @param request   The request the command is a part of.
+         * @param part      The index of the part.
+         * @param done      Reference to where the request is added if the part finishes it.
+         */
+        void send(const std::vector<std::string> &command, const std::shared_ptr<ProxyRequest> &request, uint32_t part,
+                  std::vector<std::shared_ptr<ProxyRequest>> &done);
+
+        /**
+         * Sends as much of the queued requests as the socket takes.
+         * 
+         * @param done  Reference to where the requests finished by a failure are added.
+         */
+        void handle_send(std::vector<std::shared_ptr<ProxyRequest>> &done);
+
+        /**
+         * Sends the queued requests right away, without waiting for poll(), unless the connection is still being opened.
+         * 
+         * @param done  Reference to where the requests finished by a failure are added.
+         * 
+         * @return  True if there was something to send, false otherwise.
+         */
+        bool flush(std::vector<std::shared_ptr<ProxyRequest>> &done);
+
+        /**
+         * Receives replies and hands them to the pending parts.
+         * 
+         * @param done  Reference to where the requests finished by the replies are added.
+         */
+        void handle_recv(std::vector<std::shared_ptr<ProxyRequest>> &done);
+
+        /* Returns whether there are queued requests to send, or a connect to finish */
+        bool want_write();
+
+        /* Returns whether the connection is open. It is read even when no reply is expected, to notice the backend 
+           closing it (e.g. for being idle) */
+        bool want_read();
+
+        /* Returns the backend's "host:port" */
+        const std::string &get_addr();
+
+    #ifdef TEST_MODE
+    public:
+        uint32_t get_num_pending() {
+            return pending.size();
+        }
+    #endif
+};
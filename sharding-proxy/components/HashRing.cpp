@@ -0,0 +1,39 @@
+#include <algorithm>
+
+#include "HashRing.hpp"
+#include "../../cluster/components/KeySlot.hpp"
+#include "../../utils/hash_utils.hpp"
+
+HashRing::HashRing(const std::vector<std::string> &nodes) : num_nodes(nodes.size()) {
+    points.reserve(nodes.size() * VNODES);
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        for (uint32_t j = 0; j < VNODES; j++) {
+            std::string point = nodes[i] + "-" + std::to_string(j);
+            points.push_back({ hash(point.data(), point.size()), i });
+        }
+    }
+    std::sort(points.begin(), points.end());
+}
+
+uint64_t HashRing::hash(const char *str, uint32_t len) {
+    // FNV-1 barely changes the high bits between strings that differ only in the last few characters (e.g. the point
+    // indexes), so finish with the splitmix64 mixer to spread them around the whole ring
+    uint64_t h = str_hash(str, len);
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+uint32_t HashRing::get_node(const std::string &key) const {
+    std::string_view tag = key_hash_tag(key);
+    uint64_t h = hash(tag.data(), tag.size());
+    auto it = std::lower_bound(points.begin(), points.end(), std::make_pair(h, (uint32_t) 0));
+    if (it == points.end()) {
+        it = points.begin(); // wrap around
+    }
+    return it->second;
+}
+
+uint32_t HashRing::size() const {
+    return num_nodes;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Consistent hash ring that maps keys to backends.
+ * 
+ * Each backend is placed on the ring at VNODES points, hashed from its "host:port" and the index of the point. A key 
+ * belongs to the backend owning the first point at or after the key's hash, wrapping around. Since a backend's points 
+ * depend only on its own address, adding or removing one only moves the keys on the arcs it gains or loses (about 1/n 
+ * of them), and the many points per backend keep the arcs, and so the keys, evenly spread.
+ * 
+ * Like cluster slots, only the hashtag of a key is hashed if it has one (see key_hash_tag()), so keys that share one 
+ * always land on the same backend.
+ */
+class HashRing {
+    private:
+        static const uint32_t VNODES = 160; // points per backend
+
+        std::vector<std::pair<uint64_t, uint32_t>> points; // (hash, index of the backend), sorted by hash
+        uint32_t num_nodes;
+
+        /**
+         * Hashes a string onto the ring.
+         * 
+         * @param str   Byte array that stores the string.
+         * @param len   Length of the string.
+         * 
+         * @return  The position on the ring.
+         */
+        static uint64_t hash(const char *str, uint32_t len);
+    public:
+        /**
+         * Initializes a HashRing.
+         * 
+         * @param nodes The "host:port" of each backend. A backend's index in the vector is what get_node() returns.
+         */
+        HashRing(const std::vector<std::string> &nodes);
+
+        /**
+         * Gets the backend a key belongs to.
+         * 
+         * @param key   The key.
+         * 
+         * @return  The index of the backend.
+         */
+        uint32_t get_node(const std::string &key) const;
+
+        /* Returns the number of backends */
+        uint32_t size() const;
+};
@@ -0,0 +1,89 @@
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ProxyConn.hpp"
+#include "../../utils/log.hpp"
+
+bool ProxyConn::recv_data() {
+    char buf[64 * 1024]; // 64 KB, large size is to handle pipelined requests
+
+    ssize_t recvd = recv(fd, buf, sizeof(buf), 0);
+    if (recvd == -1 && errno == EAGAIN) {
+        return false;
+    } else if (recvd < 0) {
+        log("unexpected error when receiving data for client %d", fd);
+        want_close = true;
+        return false;
+    } else if (recvd == 0) {
+        log("client %d terminated connection", fd);
+        want_close = true;
+        return false;
+    }
+
+    incoming.append(buf, (uint32_t) recvd);
+
+    return true;
+}
+
+void ProxyConn::send_data() {
+    if (outgoing.size() == 0) {
+        return;
+    }
+
+    ssize_t sent = send(fd, outgoing.data(), outgoing.size(), MSG_NOSIGNAL);
+    if (sent == -1 && errno == EAGAIN) {
+        return;
+    } else if (sent < 0) {
+        log("unexpected error when sending on client %d", fd);
+        want_close = true;
+        return;
+    }
+
+    outgoing.consume((uint32_t) sent);
+    if (outgoing.size() == 0 && in_flight.empty()) {
+        // client is idle until the next request, don't hold on to buffer memory in the meantime
+        outgoing.release();
+        incoming.release();
+    }
+}
+
+Request *ProxyConn::parse_request() {
+    auto [request, status] = Request::unmarshal(incoming.data(), incoming.size());
+
+    if (status == Request::UnmarshalStatus::INCOMPLETE_REQ) {
+        return NULL;
+    } else if (status == Request::UnmarshalStatus::REQ_TOO_BIG) {
+        log("request in client %d's buffer exceeds the size limit", fd);
+        want_close = true;
+        return NULL;
+    }
+
+    incoming.consume(Request::HEADER_SIZE + (*request)->length());
+
+    return (*request);
+}
+
+void ProxyConn::write_replies() {
+    while (!in_flight.empty() && in_flight.front()->is_done()) {
+        in_flight.front()->write_reply(outgoing);
+        in_flight.pop_front();
+    }
+}
+
+bool ProxyConn::want_read() {
+    return !want_close && in_flight.size() < MAX_IN_FLIGHT;
+}
+
+bool ProxyConn::want_write() {
+    return outgoing.size() > 0;
+}
+
+void ProxyConn::handle_close() {
+    close(fd);
+    for (std::shared_ptr<ProxyRequest> &request : in_flight) {
+        request->conn = NULL;
+    }
+    in_flight.clear();
+    log("closed client %d", fd);
+}
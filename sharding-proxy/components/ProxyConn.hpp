@@ -0,0 +1,74 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+
+#include "ProxyRequest.hpp"
+#include "../../buffer/Buffer.hpp"
+#include "../../request/Request.hpp"
+
+/**
+ * Client connection to the proxy.
+ * 
+ * A client may pipeline requests, which are sent on to the backends as soon as they're parsed. Their replies can come 
+ * back in any order, since each backend answers on its own, so the connection keeps its requests in a queue and only 
+ * writes a reply once every request before it has been answered.
+ */
+class ProxyConn {
+    public:
+        static const uint32_t MAX_IN_FLIGHT = 1024; // requests a client may have waiting on the backends before the
+                                                    // proxy stops reading from it
+
+        int fd = -1;
+        bool want_close = false;
+
+        Buffer incoming = Buffer(); // data to be parsed into requests
+        Buffer outgoing = Buffer(); // replies waiting to be sent
+
+        std::deque<std::shared_ptr<ProxyRequest>> in_flight; // requests not replied to yet, in the order they came in
+
+        ProxyConn(int fd) : fd(fd) {};
+
+        /**
+         * Receives data on the connection, storing it in the incoming buffer.
+         * 
+         * Sets the connection's intention to "close" if an unexpected error occurred or the peer terminated the 
+         * connection.
+         * 
+         * @return  True if data is received successfully.
+         *          False if socket isn't ready, an error occurs, or the peer terminated the connection.
+         */
+        bool recv_data();
+
+        /**
+         * Sends the outgoing buffer over the connection, removing what was sent from it.
+         * 
+         * Sets the connection's intention to "close" if an error occurs.
+         */
+        void send_data();
+
+        /**
+         * Tries to parse a request from the incoming buffer, removing it from the buffer afterwards.
+         * 
+         * If the parsed request exceeds the size limit, the connection's intention is set to "close".
+         * 
+         * @return  Pointer to the Request on success.
+         *          NULL if request cannot be parsed.
+         */
+        Request *parse_request();
+
+        /* Adds the replies of the requests at the front of the queue that are done to the outgoing buffer */
+        void write_replies();
+
+        /* Returns whether the connection should be read: it isn't closing and hasn't hit MAX_IN_FLIGHT */
+        bool want_read();
+
+        /* Returns whether there are replies to send */
+        bool want_write();
+
+        /**
+         * Closes the socket. Requests still waiting on backends are detached from the connection, so their replies are 
+         * dropped when they arrive.
+         */
+        void handle_close();
+};
@@ -0,0 +1,102 @@
+#include "ProxyRequest.hpp"
+#include "../../response/types/ArrResponse.hpp"
+#include "../../response/types/ErrResponse.hpp"
+#include "../../response/types/IntResponse.hpp"
+#include "../../response/types/StrResponse.hpp"
+
+ProxyRequest::ProxyRequest(ProxyConn *conn, ProxyMerge merge, uint32_t num_parts) :
+    replies(num_parts), parts_left(num_parts), conn(conn), merge(merge) {}
+
+void ProxyRequest::set_reply(uint32_t part, std::string &&packet) {
+    replies[part] = std::move(packet);
+    parts_left--;
+}
+
+void ProxyRequest::set_reply(uint32_t part, Response &response) {
+    Buffer buf;
+    response.marshal(buf);
+    set_reply(part, std::string(buf.data(), buf.size()));
+}
+
+bool ProxyRequest::is_done() {
+    return parts_left == 0;
+}
+
+/**
+ * Combines the replies to the parts of a request with SUM, ARRAY, or CONCAT. None of them is an error.
+ * 
+ * @param merge     How the replies are combined.
+ * @param parts     Reference to the replies, unmarshalled. For ARRAY, they are moved into the result.
+ * 
+ * @return  The combined reply.
+ */
+std::unique_ptr<Response> merge_replies(ProxyMerge merge, std::vector<Response *> &parts) {
+    if (merge == ProxyMerge::SUM) {
+        int64_t sum = 0;
+        for (Response *part : parts) {
+            IntResponse *num = dynamic_cast<IntResponse *>(part);
+            sum += num != NULL ? num->get_int() : 0;
+        }
+        return std::make_unique<IntResponse>(sum);
+    } else if (merge == ProxyMerge::ARRAY) {
+        std::unique_ptr<Response> arr = std::make_unique<ArrResponse>(parts);
+        parts.clear();
+        return arr;
+    }
+
+    // the parts own their elements, so the strings (the only thing keys returns) are copied into the new array
+    std::vector<Response *> elements;
+    for (Response *part : parts) {
+        ArrResponse *arr = dynamic_cast<ArrResponse *>(part);
+        if (arr == NULL) {
+            continue;
+        }
+        for (Response *element : arr->get_elements()) {
+            StrResponse *str = dynamic_cast<StrResponse *>(element);
+            if (str != NULL) {
+                elements.push_back(new StrResponse(str->get_msg()));
+            }
+        }
+    }
+    return std::make_unique<ArrResponse>(elements);
+}
+
+void ProxyRequest::write_reply(Buffer &buf) {
+    if (merge == ProxyMerge::NONE) {
+        buf.append(replies[0].data(), replies[0].size());
+        return;
+    }
+
+    std::vector<Response *> parts;
+    int32_t first_err = -1;
+    for (uint32_t i = 0; i < replies.size(); i++) {
+        auto [response, status] = Response::unmarshal(replies[i].data(), replies[i].size());
+        if (status != Response::UnmarshalStatus::SUCCESS) {
+            for (Response *part : parts) {
+                delete part;
+            }
+            ErrResponse err(ErrResponse::ErrorCode::ERR_UNKNOWN, "invalid reply from a backend");
+            err.marshal(buf);
+            return;
+        }
+        if (first_err == -1 && dynamic_cast<ErrResponse *>(*response) != NULL) {
+            first_err = i;
+        }
+        parts.push_back(*response);
+    }
+
+    if (first_err != -1 || merge == ProxyMerge::FIRST) {
+        const std::string &packet = replies[first_err == -1 ? 0 : first_err];
+        buf.append(packet.data(), packet.size());
+    } else {
+        std::unique_ptr<Response> reply = merge_replies(merge, parts);
+        if (reply->marshal(buf) == Response::MarshalStatus::RES_TOO_BIG) {
+            ErrResponse err(ErrResponse::ErrorCode::ERR_TOO_BIG, "response is too big");
+            err.marshal(buf);
+        }
+    }
+
+    for (Response *part : parts) {
+        delete part;
+    }
+}
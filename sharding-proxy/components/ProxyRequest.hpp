@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../../buffer/Buffer.hpp"
+#include "../../response/Response.hpp"
+
+class ProxyConn;
+
+/* How the replies to the parts of a ProxyRequest are combined into the reply to the client */
+enum class ProxyMerge {
+    NONE, // one part, whose reply is forwarded as is
+    SUM, // the integers are added up (e.g. del of several keys)
+    ARRAY, // each reply is one element of an array (e.g. mget)
+    CONCAT, // the elements of the arrays are concatenated (e.g. keys)
+    FIRST // the first reply, unless one of them is an error (e.g. save on every backend)
+};
+
+/**
+ * A client request that was sent to the backends in one or more parts, waiting for their replies.
+ * 
+ * The request is shared by the client connection, which replies to its requests in order, and the BackendConns the 
+ * parts were sent to. A backend fills in its part's reply when it arrives, and the client writes the reply once every 
+ * part has one.
+ */
+class ProxyRequest {
+    private:
+        std::vector<std::string> replies; // response packet of each part, empty until it arrives
+        uint32_t parts_left;
+    public:
+        ProxyConn *conn; // client that sent the request, NULL once it disconnects
+        ProxyMerge merge;
+
+        /**
+         * Initializes a ProxyRequest.
+         * 
+         * @param conn      The client that sent the request.
+         * @param merge     How the replies are combined.
+         * @param num_parts The number of parts.
+         */
+        ProxyRequest(ProxyConn *conn, ProxyMerge merge, uint32_t num_parts);
+
+        /**
+         * Sets the reply to a part.
+         * 
+         * @param part      The index of the part.
+         * @param packet    The marshalled response.
+         */
+        void set_reply(uint32_t part, std::string &&packet);
+
+        /**
+         * Sets the reply to a part to an error, e.g. because its backend is down.
+         * 
+         * @param part      The index of the part.
+         * @param response  Reference to the error.
+         */
+        void set_reply(uint32_t part, Response &response);
+
+        /* Returns whether every part has its reply */
+        bool is_done();
+
+        /**
+         * Combines the replies and adds the result to a buffer. Should only be called once is_done().
+         * 
+         * A reply for a single part is copied without being unmarshalled. If any part failed, the first error is added 
+         * instead of the combined reply.
+         * 
+         * @param buf   The Buffer the reply is added to.
+         */
+        void write_reply(Buffer &buf);
+};
@@ -0,0 +1,67 @@
+#include <assert.h>
+
+#include "../HashRing.hpp"
+
+const uint32_t NUM_KEYS = 30000;
+
+void test_deterministic() {
+    HashRing ring({ "127.0.0.1:7000", "127.0.0.1:7001", "127.0.0.1:7002" });
+    HashRing other({ "127.0.0.1:7000", "127.0.0.1:7001", "127.0.0.1:7002" });
+    for (uint32_t i = 0; i < 1000; i++) {
+        std::string key = "key" + std::to_string(i);
+        assert(ring.get_node(key) == other.get_node(key));
+        assert(ring.get_node(key) < 3);
+    }
+    assert(ring.size() == 3);
+
+    HashRing single({ "127.0.0.1:7000" });
+    assert(single.get_node("a") == 0 && single.get_node("") == 0);
+}
+
+void test_balanced() {
+    HashRing ring({ "127.0.0.1:7000", "127.0.0.1:7001", "127.0.0.1:7002" });
+    uint32_t counts[3] = { 0, 0, 0 };
+    for (uint32_t i = 0; i < NUM_KEYS; i++) {
+        counts[ring.get_node("key:" + std::to_string(i))]++;
+    }
+
+    // every backend gets close to a third of the keys
+    for (uint32_t count : counts) {
+        assert(count > NUM_KEYS / 4 && count < NUM_KEYS * 5 / 12);
+    }
+}
+
+void test_adding_node_moves_few_keys() {
+    HashRing before({ "127.0.0.1:7000", "127.0.0.1:7001", "127.0.0.1:7002" });
+    HashRing after({ "127.0.0.1:7000", "127.0.0.1:7001", "127.0.0.1:7002", "127.0.0.1:7003" });
+
+    uint32_t moved = 0;
+    for (uint32_t i = 0; i < NUM_KEYS; i++) {
+        std::string key = "key:" + std::to_string(i);
+        if (before.get_node(key) != after.get_node(key)) {
+            assert(after.get_node(key) == 3); // keys only move to the new backend
+            moved++;
+        }
+    }
+
+    // about a quarter of the keys, rather than most of them as with hash % n
+    assert(moved > NUM_KEYS / 6 && moved < NUM_KEYS / 3);
+}
+
+void test_hashtags() {
+    HashRing ring({ "127.0.0.1:7000", "127.0.0.1:7001", "127.0.0.1:7002" });
+    for (uint32_t i = 0; i < 100; i++) {
+        std::string tag = "{user:" + std::to_string(i) + "}";
+        assert(ring.get_node(tag + ":name") == ring.get_node(tag + ":friends"));
+        assert(ring.get_node(tag + ":name") == ring.get_node("user:" + std::to_string(i)));
+    }
+}
+
+int main() {
+    test_deterministic();
+    test_balanced();
+    test_adding_node_moves_few_keys();
+    test_hashtags();
+
+    return 0;
+}
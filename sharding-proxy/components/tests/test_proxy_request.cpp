@@ -0,0 +1,110 @@
+#include <assert.h>
+
+#include "../ProxyRequest.hpp"
+#include "../../../response/types/ArrResponse.hpp"
+#include "../../../response/types/ErrResponse.hpp"
+#include "../../../response/types/IntResponse.hpp"
+#include "../../../response/types/NilResponse.hpp"
+#include "../../../response/types/StrResponse.hpp"
+
+/* Marshals a response into a packet, as a backend would send it */
+std::string packet_of(Response &&response) {
+    Buffer buf;
+    response.marshal(buf);
+    return std::string(buf.data(), buf.size());
+}
+
+/* Writes the reply of a request and unmarshals it */
+std::unique_ptr<Response> reply_of(ProxyRequest &request) {
+    Buffer buf;
+    request.write_reply(buf);
+    auto [response, status] = Response::unmarshal(buf.data(), buf.size());
+    assert(status == Response::UnmarshalStatus::SUCCESS);
+    return std::unique_ptr<Response>(*response);
+}
+
+void test_none() {
+    ProxyRequest request(NULL, ProxyMerge::NONE, 1);
+    assert(!request.is_done());
+    request.set_reply(0, packet_of(StrResponse("value")));
+    assert(request.is_done());
+
+    // passed through byte for byte
+    Buffer buf;
+    request.write_reply(buf);
+    assert(std::string(buf.data(), buf.size()) == packet_of(StrResponse("value")));
+}
+
+void test_sum() {
+    ProxyRequest request(NULL, ProxyMerge::SUM, 3);
+    request.set_reply(2, packet_of(IntResponse(1)));
+    request.set_reply(0, packet_of(IntResponse(1)));
+    assert(!request.is_done());
+    request.set_reply(1, packet_of(IntResponse(0)));
+    assert(request.is_done());
+
+    std::unique_ptr<Response> reply = reply_of(request);
+    IntResponse *sum = dynamic_cast<IntResponse *>(reply.get());
+    assert(sum != NULL && sum->get_int() == 2);
+}
+
+void test_array() {
+    // replies arrive out of order but keep the order of the parts
+    ProxyRequest request(NULL, ProxyMerge::ARRAY, 3);
+    request.set_reply(1, packet_of(NilResponse()));
+    request.set_reply(2, packet_of(StrResponse("c")));
+    request.set_reply(0, packet_of(StrResponse("a")));
+
+    std::unique_ptr<Response> reply = reply_of(request);
+    ArrResponse *arr = dynamic_cast<ArrResponse *>(reply.get());
+    assert(arr != NULL && arr->get_elements().size() == 3);
+    assert(((StrResponse *) arr->get_elements()[0])->get_msg() == "a");
+    assert(dynamic_cast<NilResponse *>(arr->get_elements()[1]) != NULL);
+    assert(((StrResponse *) arr->get_elements()[2])->get_msg() == "c");
+}
+
+void test_concat() {
+    ProxyRequest request(NULL, ProxyMerge::CONCAT, 3);
+    request.set_reply(0, packet_of(ArrResponse({ new StrResponse("a"), new StrResponse("b") })));
+    request.set_reply(1, packet_of(ArrResponse({})));
+    request.set_reply(2, packet_of(ArrResponse({ new StrResponse("c") })));
+
+    std::unique_ptr<Response> reply = reply_of(request);
+    ArrResponse *arr = dynamic_cast<ArrResponse *>(reply.get());
+    assert(arr != NULL && arr->get_elements().size() == 3);
+    assert(((StrResponse *) arr->get_elements()[2])->get_msg() == "c");
+}
+
+void test_errors() {
+    // the first error wins over any merge
+    ProxyRequest request(NULL, ProxyMerge::SUM, 3);
+    request.set_reply(0, packet_of(IntResponse(1)));
+    ErrResponse down(ErrResponse::ErrorCode::ERR_UNKNOWN, "backend down");
+    request.set_reply(1, down);
+    request.set_reply(2, packet_of(ErrResponse(ErrResponse::ErrorCode::ERR_UNKNOWN, "other")));
+
+    std::unique_ptr<Response> reply = reply_of(request);
+    ErrResponse *err = dynamic_cast<ErrResponse *>(reply.get());
+    assert(err != NULL && err->get_err_msg() == "backend down");
+
+    ProxyRequest first(NULL, ProxyMerge::FIRST, 2);
+    first.set_reply(0, packet_of(StrResponse("OK")));
+    first.set_reply(1, packet_of(StrResponse("OK")));
+    reply = reply_of(first);
+    StrResponse *ok = dynamic_cast<StrResponse *>(reply.get());
+    assert(ok != NULL && ok->get_msg() == "OK");
+
+    ProxyRequest invalid(NULL, ProxyMerge::SUM, 1);
+    invalid.set_reply(0, "garbage");
+    assert(dynamic_cast<ErrResponse *>(reply_of(invalid).get()) != NULL);
+}
+
+int main() {
+    test_none();
+    test_sum();
+    test_array();
+    test_concat();
+    test_errors();
+
+    return 0;
+}
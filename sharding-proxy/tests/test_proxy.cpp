@@ -0,0 +1,184 @@
+#include <assert.h>
+#include <dirent.h>
+
+#include "../components/HashRing.hpp"
+#include "../../response/types/NilResponse.hpp"
+#include "../../utils/test_utils.hpp"
+
+const uint32_t NUM_BACKENDS = 3;
+const uint32_t CONNS_PER_BACKEND = 2;
+
+/* Counts the open file descriptors of a process */
+uint32_t count_fds(pid_t pid) {
+    DIR *dir = opendir(("/proc/" + std::to_string(pid) + "/fd").data());
+    assert(dir != NULL);
+    uint32_t n = 0;
+    while (readdir(dir) != NULL) {
+        n++;
+    }
+    closedir(dir);
+    return n;
+}
+
+void test_routing(const std::vector<TestProcess> &backends, const TestProcess &proxy) {
+    std::vector<std::string> addrs;
+    for (const TestProcess &backend : backends) {
+        addrs.push_back(backend.addr);
+    }
+    HashRing ring(addrs);
+
+    // one pipelined batch through the proxy
+    std::vector<std::vector<std::string>> commands;
+    for (uint32_t i = 0; i < 300; i++) {
+        commands.push_back({ "set", "key" + std::to_string(i), std::to_string(i) });
+    }
+    ClusterClient client(proxy.addr);
+    for (std::unique_ptr<Response> &response : client.execute(commands)) {
+        assert(str_of(response) == "OK");
+    }
+
+    // every key is on the backend the ring puts it on, and every backend got some
+    for (uint32_t i = 0; i < backends.size(); i++) {
+        assert(len_of(send_to(backends[i].addr, { "keys" })) > 50);
+    }
+    for (uint32_t i = 0; i < 300; i++) {
+        std::string key = "key" + std::to_string(i);
+        assert(str_of(send_to(backends[ring.get_node(key)].addr, { "get", key })) == std::to_string(i));
+    }
+}
+
+void test_pipelined_order(const TestProcess &proxy) {
+    // writes and reads of keys on every backend, interleaved. Each read sees the write just before it
+    std::vector<std::vector<std::string>> commands;
+    for (uint32_t i = 0; i < 3000; i++) {
+        std::string key = "order" + std::to_string(i % 50);
+        commands.push_back({ "set", key, std::to_string(i) });
+        commands.push_back({ "get", key });
+    }
+
+    ClusterClient client(proxy.addr);
+    std::vector<std::unique_ptr<Response>> responses = client.execute(commands);
+    for (uint32_t i = 0; i < 3000; i++) {
+        assert(str_of(responses[2 * i]) == "OK");
+        assert(str_of(responses[2 * i + 1]) == std::to_string(i));
+    }
+
+    for (uint32_t i = 0; i < 50; i++) {
+        send_to(proxy.addr, { "del", "order" + std::to_string(i) });
+    }
+}
+
+void test_scatter_gather(const TestProcess &proxy) {
+    // keys gathers from every backend
+    assert(len_of(send_to(proxy.addr, { "keys" })) == 300);
+
+    std::unique_ptr<Response> response = send_to(proxy.addr, { "mget", "key1", "missing", "key200" });
+    ArrResponse *arr = dynamic_cast<ArrResponse *>(response.get());
+    assert(arr != NULL && arr->get_elements().size() == 3);
+    assert(((StrResponse *) arr->get_elements()[0])->get_msg() == "1");
+    assert(dynamic_cast<NilResponse *>(arr->get_elements()[1]) != NULL);
+    assert(((StrResponse *) arr->get_elements()[2])->get_msg() == "200");
+
+    std::vector<std::string> del = { "del", "missing" };
+    for (uint32_t i = 0; i < 300; i++) {
+        del.push_back("key" + std::to_string(i));
+    }
+    assert(int_of(send_to(proxy.addr, del)) == 300);
+    assert(len_of(send_to(proxy.addr, { "keys" })) == 0);
+
+    // multi-key commands only work if every key is on one backend
+    send_to(proxy.addr, { "zadd", "{z}a", "1", "m" });
+    send_to(proxy.addr, { "zadd", "{z}b", "2", "n" });
+    assert(int_of(send_to(proxy.addr, { "zunionstore", "{z}dest", "2", "{z}a", "{z}b" })) == 2);
+    bool crossed = false;
+    for (uint32_t i = 0; i < 20 && !crossed; i++) {
+        std::unique_ptr<Response> union_response = send_to(proxy.addr, { "zunionstore", "dest" + std::to_string(i), 
+                                                                        "2", "{z}a", "{z}b" });
+        if (dynamic_cast<ErrResponse *>(union_response.get()) != NULL) {
+            assert(err_msg_of(union_response).rfind("CROSSSLOT", 0) == 0);
+            crossed = true;
+        } else {
+            send_to(proxy.addr, { "del", "dest" + std::to_string(i) });
+        }
+    }
+    assert(crossed);
+    assert(int_of(send_to(proxy.addr, { "del", "{z}a", "{z}b", "{z}dest" })) == 3);
+
+    assert(err_msg_of(send_to(proxy.addr, { "cluster", "slots" })).find("not supported") != std::string::npos);
+}
+
+void test_multiplexing(const std::vector<TestProcess> &backends, const TestProcess &proxy) {
+    std::vector<uint32_t> fds_before;
+    for (const TestProcess &backend : backends) {
+        fds_before.push_back(count_fds(backend.pid));
+    }
+
+    // many clients, each with requests for every backend
+    std::vector<std::unique_ptr<ClusterClient>> clients;
+    for (uint32_t i = 0; i < 64; i++) {
+        clients.push_back(std::make_unique<ClusterClient>(proxy.addr));
+        std::vector<std::vector<std::string>> commands;
+        for (uint32_t j = 0; j < 10; j++) {
+            commands.push_back({ "get", "mux" + std::to_string(j) });
+        }
+        for (std::unique_ptr<Response> &response : clients.back()->execute(commands)) {
+            assert(dynamic_cast<NilResponse *>(response.get()) != NULL);
+        }
+    }
+
+    // the backends only see the proxy's connections
+    for (uint32_t i = 0; i < backends.size(); i++) {
+        assert(count_fds(backends[i].pid) <= fds_before[i] + CONNS_PER_BACKEND);
+    }
+}
+
+void test_backend_down(std::vector<TestProcess> &backends, const TestProcess &proxy) {
+    std::vector<std::string> addrs;
+    for (const TestProcess &backend : backends) {
+        addrs.push_back(backend.addr);
+    }
+    HashRing ring(addrs);
+
+    std::string down_key, up_key;
+    for (uint32_t i = 0; down_key.empty() || up_key.empty(); i++) {
+        std::string key = "down" + std::to_string(i);
+        (ring.get_node(key) == 0 ? down_key : up_key) = key;
+    }
+    assert(str_of(send_to(proxy.addr, { "set", up_key, "value" })) == "OK");
+
+    stop_test_process(backends[0]);
+
+    // keys on the dead backend fail, the others are still served
+    ClusterClient client(proxy.addr);
+    std::vector<std::unique_ptr<Response>> responses = client.execute({ { "get", down_key }, { "get", up_key } });
+    assert(err_msg_of(responses[0]).find("unreachable") != std::string::npos);
+    assert(str_of(responses[1]) == "value");
+    assert(err_msg_of(send_to(proxy.addr, { "keys" })).find("unreachable") != std::string::npos);
+
+    send_to(proxy.addr, { "del", up_key });
+}
+
+int main() {
+    std::vector<TestProcess> backends;
+    std::vector<std::string> proxy_args;
+    for (uint32_t i = 0; i < NUM_BACKENDS; i++) {
+        backends.push_back(start_test_process("server", test_base_port() + i));
+        proxy_args.push_back(backends[i].addr);
+    }
+    proxy_args.push_back("--conns");
+    proxy_args.push_back(std::to_string(CONNS_PER_BACKEND));
+    TestProcess proxy = start_test_process("proxy", test_base_port() + NUM_BACKENDS, proxy_args);
+
+    test_routing(backends, proxy);
+    test_pipelined_order(proxy);
+    test_scatter_gather(proxy);
+    test_multiplexing(backends, proxy);
+    test_backend_down(backends, proxy);
+
+    stop_test_process(proxy);
+    for (uint32_t i = 1; i < NUM_BACKENDS; i++) {
+        stop_test_process(backends[i]);
+    }
+
+    return 0;
+}
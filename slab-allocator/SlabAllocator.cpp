@@ -0,0 +1,271 @@
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+#include "SlabAllocator.hpp"
+#include "../constants.hpp"
+
+const uint32_t SlabAllocator::CLASS_SIZES[NUM_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024
+};
+
+SlabAllocator::SlabAllocator(bool huge_pages) : huge_pages(huge_pages) {}
+
+SlabAllocator::~SlabAllocator() {
+    for (char *arena : arenas) {
+        munmap(arena, ARENA_SIZE);
+    }
+}
+
+SlabAllocator &SlabAllocator::shared() {
+    // never destroyed so objects with static storage duration can still be freed at exit
+    static SlabAllocator *allocator = new SlabAllocator(USE_HUGE_PAGES);
+    return *allocator;
+}
+
+size_t SlabAllocator::class_size(size_t n) {
+    int8_t i = class_index(n);
+    return i < 0 ? n : CLASS_SIZES[i];
+}
+
+void *SlabAllocator::alloc(size_t n) {
+    int8_t i = class_index(n);
+    if (i < 0) {
+        large_allocs++;
+        void *ptr = malloc(n);
+        if (ptr == NULL) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+
+    SizeClass &size_class = classes[i];
+    std::lock_guard<std::mutex> lock(size_class.mutex);
+
+    if (size_class.partial == NULL) {
+        Slab *slab = acquire_slab(i);
+        if (slab == NULL) {
+            throw std::bad_alloc();
+        }
+        size_class.partial = slab;
+        size_class.slabs++;
+    }
+
+    Slab *slab = size_class.partial;
+    void *slot = slab->free_list;
+    slab->free_list = *((void **) slot);
+    slab->used++;
+
+    if (slab->used == slab->capacity) {
+        // full, remove from the partial list
+        size_class.partial = slab->next;
+        if (slab->next != NULL) {
+            slab->next->prev = NULL;
+        }
+        slab->next = NULL;
+    }
+
+    size_class.used++;
+    size_class.allocs++;
+
+    return slot;
+}
+
+void SlabAllocator::free(void *ptr, size_t n) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (class_index(n) < 0) {
+        ::free(ptr);
+        return;
+    }
+
+    Slab *slab = (Slab *) ((uintptr_t) ptr & ~((uintptr_t) SLAB_SIZE - 1));
+    SizeClass &size_class = classes[slab->class_idx];
+    std::lock_guard<std::mutex> lock(size_class.mutex);
+
+    *((void **) ptr) = slab->free_list;
+    slab->free_list = ptr;
+
+    if (slab->used == slab->capacity) {
+        // was full, add back to the partial list
+        slab->prev = NULL;
+        slab->next = size_class.partial;
+        if (size_class.partial != NULL) {
+            size_class.partial->prev = slab;
+        }
+        size_class.partial = slab;
+    }
+
+    slab->used--;
+    size_class.used--;
+    size_class.frees++;
+
+    // give empty slabs back to the arenas, but keep the last one so alloc/free at the boundary doesn't thrash
+    if (slab->used == 0 && (slab->prev != NULL || slab->next != NULL)) {
+        if (slab->prev != NULL) {
+            slab->prev->next = slab->next;
+        } else {
+            size_class.partial = slab->next;
+        }
+        if (slab->next != NULL) {
+            slab->next->prev = slab->prev;
+        }
+        size_class.slabs--;
+        release_slab(slab);
+    }
+}
+
+bool SlabAllocator::defrag_hint(void *ptr, size_t n) {
+    if (class_index(n) < 0) {
+        return false;
+    }
+
+    Slab *slab = (Slab *) ((uintptr_t) ptr & ~((uintptr_t) SLAB_SIZE - 1));
+    SizeClass &size_class = classes[slab->class_idx];
+    std::lock_guard<std::mutex> lock(size_class.mutex);
+
+    // stay put in full slabs and slabs at or above the average utilization of the size class
+    if (slab->used == slab->capacity || slab->used * size_class.slabs >= size_class.used) {
+        size_class.defrag_misses++;
+        return false;
+    }
+
+    // find the fullest slab with free slots to move to
+    Slab *target = NULL;
+    Slab *curr = size_class.partial;
+    for (uint32_t i = 0; curr != NULL && i < DEFRAG_MAX_SLABS_CHECKED; curr = curr->next, i++) {
+        if (curr != slab && curr->used > slab->used && (target == NULL || curr->used > target->used)) {
+            target = curr;
+        }
+    }
+    if (target == NULL) {
+        size_class.defrag_misses++;
+        return false;
+    }
+
+    // move the target to the head of the partial list so the next alloc() takes from it
+    if (target != size_class.partial) {
+        target->prev->next = target->next;
+        if (target->next != NULL) {
+            target->next->prev = target->prev;
+        }
+        target->prev = NULL;
+        target->next = size_class.partial;
+        size_class.partial->prev = target;
+        size_class.partial = target;
+    }
+
+    size_class.defrag_hits++;
+    return true;
+}
+
+SlabStats SlabAllocator::get_stats() {
+    SlabStats stats;
+    for (uint8_t i = 0; i < NUM_CLASSES; i++) {
+        SizeClass &size_class = classes[i];
+        std::lock_guard<std::mutex> lock(size_class.mutex);
+        stats.allocs += size_class.allocs;
+        stats.frees += size_class.frees;
+        stats.defrag_hits += size_class.defrag_hits;
+        stats.defrag_misses += size_class.defrag_misses;
+        stats.slab_bytes += size_class.slabs * SLAB_SIZE;
+        stats.used_bytes += size_class.used * CLASS_SIZES[i];
+    }
+
+    std::lock_guard<std::mutex> lock(arena_mutex);
+    stats.large_allocs = large_allocs;
+    stats.arenas = arenas.size();
+    stats.reserved_bytes = arenas.size() * ARENA_SIZE;
+    stats.released_bytes = free_slabs.size() * SLAB_SIZE; // either never touched or released
+
+    return stats;
+}
+
+int8_t SlabAllocator::class_index(size_t n) {
+    if (n > MAX_SIZE) {
+        return -1;
+    }
+    if (n <= 128) {
+        return n == 0 ? 0 : (n + 15) / 16 - 1;
+    }
+    int8_t i = 8;
+    while (CLASS_SIZES[i] < n) {
+        i++;
+    }
+    return i;
+}
+
+Slab *SlabAllocator::acquire_slab(uint8_t class_idx) {
+    Slab *slab;
+    {
+        std::lock_guard<std::mutex> lock(arena_mutex);
+        if (free_slabs.empty() && !map_arena()) {
+            return NULL;
+        }
+        slab = free_slabs.back();
+        free_slabs.pop_back();
+    }
+
+    uint32_t size = CLASS_SIZES[class_idx];
+    slab->prev = NULL;
+    slab->next = NULL;
+    slab->used = 0;
+    slab->capacity = (SLAB_SIZE - SLAB_HEADER_SIZE) / size;
+    slab->class_idx = class_idx;
+
+    // link slots so the lowest address is handed out first
+    char *slots = (char *) slab + SLAB_HEADER_SIZE;
+    slab->free_list = NULL;
+    for (uint32_t i = slab->capacity; i > 0; i--) {
+        void *slot = slots + (i - 1) * size;
+        *((void **) slot) = slab->free_list;
+        slab->free_list = slot;
+    }
+
+    return slab;
+}
+
+void SlabAllocator::release_slab(Slab *slab) {
+    // the pages read back as zeros when the slab is reused, acquire_slab() rewrites everything it needs
+    madvise(slab, SLAB_SIZE, MADV_DONTNEED);
+
+    std::lock_guard<std::mutex> lock(arena_mutex);
+    free_slabs.push_back(slab);
+}
+
+bool SlabAllocator::map_arena() {
+    // over-map so the arena can be aligned to its size, which aligns every slab in it to SLAB_SIZE
+    size_t map_size = 2 * (size_t) ARENA_SIZE;
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    uintptr_t start = (uintptr_t) map;
+    uintptr_t aligned = (start + ARENA_SIZE - 1) & ~((uintptr_t) ARENA_SIZE - 1);
+    if (aligned > start) {
+        munmap(map, aligned - start);
+    }
+    uintptr_t end = aligned + ARENA_SIZE;
+    if (start + map_size > end) {
+        munmap((void *) end, start + map_size - end);
+    }
+
+    char *arena = (char *) aligned;
+    if (huge_pages) {
+        madvise(arena, ARENA_SIZE, MADV_HUGEPAGE); // best effort, falls back to normal pages
+    }
+    arenas.push_back(arena);
+
+    // push in reverse so slabs are handed out from the start of the arena
+    for (uint32_t offset = ARENA_SIZE; offset > 0; offset -= SLAB_SIZE) {
+        free_slabs.push_back((Slab *) (arena + offset - SLAB_SIZE));
+    }
+
+    return true;
+}
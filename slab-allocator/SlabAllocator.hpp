@@ -0,0 +1,191 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "components/Slab.hpp"
+
+/* Stats for a SlabAllocator */
+struct SlabStats {
+    uint64_t allocs = 0; // allocations served from slabs
+    uint64_t frees = 0; // frees returned to slabs
+    uint64_t large_allocs = 0; // allocations too big for a size class, served by malloc
+    uint64_t arenas = 0;
+    uint64_t reserved_bytes = 0; // bytes mapped for arenas
+    uint64_t slab_bytes = 0; // bytes in slabs assigned to a size class
+    uint64_t used_bytes = 0; // bytes in slots handed out, rounded up to their size class
+    uint64_t released_bytes = 0; // bytes in free slabs, which hold no memory until they are reused
+    uint64_t defrag_hits = 0; // objects defrag_hint() said to move
+    uint64_t defrag_misses = 0; // objects defrag_hint() said to leave in place
+
+    /* Returns the ratio of memory held by slabs to memory handed out. 1.0 means no fragmentation. */
+    double fragmentation_ratio() const {
+        return used_bytes == 0 ? 1.0 : (double) slab_bytes / used_bytes;
+    }
+};
+
+/**
+ * Allocator for small, fixed-size objects (Entries, SPairs, short strings) grouped into size classes.
+ *
+ * Memory is mapped from the OS in large arenas which are split into slabs. Each slab serves a single size class, so
+ * objects of the same size are packed together instead of being scattered across the heap by malloc. Slabs that become
+ * empty go back to the arena to be reused by any size class, and their pages are handed back to the OS so that memory
+ * freed by deletes or defragmentation leaves the process's RSS. Requests bigger than the largest size class are passed
+ * through to malloc.
+ *
+ * Each size class has its own lock since objects can be freed by the thread pool workers (e.g. large sorted sets).
+ */
+class SlabAllocator {
+    public:
+        static const uint32_t SLAB_SIZE = 64 * 1024; // 64 KB
+        static const uint32_t ARENA_SIZE = 2 * 1024 * 1024; // 2 MB, the size of a huge page
+        static const uint32_t SLAB_HEADER_SIZE = 64; // space reserved for the Slab header, keeps slots 16-byte aligned
+        static const uint32_t MAX_SIZE = 1024; // largest size class
+        static const uint8_t NUM_CLASSES = 20;
+
+        /**
+         * Initializes a SlabAllocator.
+         *
+         * @param huge_pages    Whether arenas should be backed by transparent huge pages.
+         */
+        SlabAllocator(bool huge_pages = false);
+
+        /* Unmaps all arenas. Objects allocated from them must no longer be in use. */
+        ~SlabAllocator();
+
+        /* Returns the allocator shared by the kv store */
+        static SlabAllocator &shared();
+
+        /* Returns the size an n-byte request is rounded up to, or n if it is too big for a size class */
+        static size_t class_size(size_t n);
+
+        /**
+         * Allocates at least n bytes.
+         *
+         * @param n The number of bytes required.
+         *
+         * @return  Pointer to the allocated memory. Throws std::bad_alloc if no memory is available.
+         */
+        void *alloc(size_t n);
+
+        /**
+         * Frees memory returned by alloc().
+         *
+         * @param ptr   Pointer to the memory. Nothing happens if NULL.
+         * @param n     The number of bytes that were requested from alloc().
+         */
+        void free(void *ptr, size_t n);
+
+        /**
+         * Checks if an object should be moved to reduce fragmentation, i.e. it sits in a slab that is emptier than 
+         * average for its size class and there is a fuller slab with free slots to move it to. If so, that fuller slab 
+         * is made the next one alloc() takes from, so the caller can move the object by allocating a new copy and freeing
+         * the old one.
+         * 
+         * @param ptr   Pointer to the object.
+         * @param n     The number of bytes that were requested from alloc() for the object.
+         * 
+         * @return  True if the object should be moved.
+         *          False otherwise.
+         */
+        bool defrag_hint(void *ptr, size_t n);
+
+        /* Returns the allocator's stats */
+        SlabStats get_stats();
+    private:
+        /* Slabs and stats for a size class */
+        struct SizeClass {
+            std::mutex mutex;
+            Slab *partial = NULL; // slabs with free slots
+            uint64_t slabs = 0;
+            uint64_t used = 0; // slots handed out
+            uint64_t allocs = 0;
+            uint64_t frees = 0;
+            uint64_t defrag_hits = 0;
+            uint64_t defrag_misses = 0;
+        };
+
+        static const uint32_t DEFRAG_MAX_SLABS_CHECKED = 16; // slabs checked for a move target by defrag_hint()
+
+        static const uint32_t CLASS_SIZES[NUM_CLASSES];
+
+        bool huge_pages;
+        SizeClass classes[NUM_CLASSES];
+        std::mutex arena_mutex; // guards arenas and free_slabs, always acquired after a size class's mutex
+        std::vector<char *> arenas;
+        std::vector<Slab *> free_slabs; // slabs not assigned to a size class
+        std::atomic<uint64_t> large_allocs{0};
+
+        /**
+         * Gets the index of the size class for an n-byte request.
+         *
+         * @param n The number of bytes requested.
+         *
+         * @return  The index of the size class.
+         *          -1 if n is larger than the biggest size class.
+         */
+        static int8_t class_index(size_t n);
+
+        /**
+         * Takes a free slab from the arenas, mapping a new arena if there are none, and carves it into slots for a size
+         * class.
+         *
+         * @param class_idx The index of the size class.
+         *
+         * @return  Pointer to the slab.
+         *          NULL if a new arena could not be mapped.
+         */
+        Slab *acquire_slab(uint8_t class_idx);
+
+        /**
+         * Returns an empty slab to the arenas and its pages to the OS.
+         *
+         * @param slab  Pointer to the slab.
+         */
+        void release_slab(Slab *slab);
+
+        /**
+         * Maps a new arena and adds its slabs to the free slabs. Must be called with arena_mutex held.
+         *
+         * @return  True on success.
+         *          False if the arena could not be mapped.
+         */
+        bool map_arena();
+
+    #ifdef TEST_MODE
+    public:
+        uint64_t get_num_free_slabs() { return free_slabs.size(); }
+    #endif
+};
+
+/**
+ * Standard library allocator backed by the shared SlabAllocator, for containers that hold small payloads (e.g. the
+ * value of a string Entry).
+ */
+template <typename T>
+struct SlabStlAllocator {
+    using value_type = T;
+
+    SlabStlAllocator() = default;
+
+    template <typename U>
+    SlabStlAllocator(const SlabStlAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        return (T *) SlabAllocator::shared().alloc(n * sizeof(T));
+    }
+
+    void deallocate(T *ptr, size_t n) {
+        SlabAllocator::shared().free(ptr, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const SlabStlAllocator<U> &) const { return true; }
+};
+
+/* String whose heap buffer (if it's too long for the small string optimization) comes from the shared SlabAllocator */
+using SlabString = std::basic_string<char, std::char_traits<char>, SlabStlAllocator<char>>;
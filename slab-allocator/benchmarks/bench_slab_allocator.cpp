@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../SlabAllocator.hpp"
+#include "../../utils/time_utils.hpp"
+
+// Compares the SlabAllocator to glibc malloc on the allocation pattern of a churning kv store: many small objects of a
+// few sizes (Entries, SPairs with short names, short string values) allocated up front, then freed and replaced in
+// random order, then freed entirely.
+
+const uint32_t NUM_OBJECTS = 1000000;
+const uint32_t NUM_CHURN = 4000000;
+const size_t SIZES[] = { 40, 64, 72, 96, 136, 200 };
+
+void report(const char *name, const char *op, uint64_t n, double ms) {
+    printf("%-8s %-8s %10lu ops %10.2f ms %8.1f ns/op\n", name, op, n, ms, ms * 1e6 / n);
+}
+
+/* Touches the first byte of an object so the allocation isn't optimized out and pages are faulted in */
+void touch(void *ptr) {
+    *((volatile char *) ptr) = 1;
+}
+
+void bench_malloc(const std::vector<size_t> &sizes, const std::vector<uint32_t> &picks) {
+    std::vector<void *> objects(NUM_OBJECTS);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+        objects[i] = malloc(sizes[i]);
+        touch(objects[i]);
+    }
+    report("malloc", "alloc", NUM_OBJECTS, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_CHURN; i++) {
+        uint32_t pick = picks[i];
+        free(objects[pick]);
+        objects[pick] = malloc(sizes[pick]);
+        touch(objects[pick]);
+    }
+    report("malloc", "churn", NUM_CHURN, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+        free(objects[i]);
+    }
+    report("malloc", "free", NUM_OBJECTS, elapsed_ms(start));
+}
+
+void bench_slab(const std::vector<size_t> &sizes, const std::vector<uint32_t> &picks) {
+    SlabAllocator *allocator = new SlabAllocator();
+    std::vector<void *> objects(NUM_OBJECTS);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+        objects[i] = allocator->alloc(sizes[i]);
+        touch(objects[i]);
+    }
+    report("slab", "alloc", NUM_OBJECTS, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_CHURN; i++) {
+        uint32_t pick = picks[i];
+        allocator->free(objects[pick], sizes[pick]);
+        objects[pick] = allocator->alloc(sizes[pick]);
+        touch(objects[pick]);
+    }
+    report("slab", "churn", NUM_CHURN, elapsed_ms(start));
+
+    SlabStats stats = allocator->get_stats();
+    printf("slab     %lu arenas, %lu MB in slabs, fragmentation ratio %.2f\n", stats.arenas,
+           stats.slab_bytes / (1024 * 1024), stats.fragmentation_ratio());
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_OBJECTS; i++) {
+        allocator->free(objects[i], sizes[i]);
+    }
+    report("slab", "free", NUM_OBJECTS, elapsed_ms(start));
+
+    delete allocator;
+}
+
+int main() {
+    srand(0);
+
+    std::vector<size_t> sizes(NUM_OBJECTS);
+    for (size_t &size : sizes) {
+        size = SIZES[rand() % (sizeof(SIZES) / sizeof(SIZES[0]))];
+    }
+
+    std::vector<uint32_t> picks(NUM_CHURN);
+    for (uint32_t &pick : picks) {
+        pick = rand() % NUM_OBJECTS;
+    }
+
+    bench_malloc(sizes, picks);
+    bench_slab(sizes, picks);
+
+    return 0;
+}
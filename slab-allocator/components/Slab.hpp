@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Header at the start of every slab.
+ * 
+ * A slab is a SLAB_SIZE-aligned block of memory carved into equal-size slots for a single size class, so the slab (and
+ * its size class) can be found from any slot by masking off the low bits of the slot's address.
+ */
+struct Slab {
+    Slab *prev; // in the size class's list of slabs with free slots
+    Slab *next;
+    void *free_list; // free slots, linked through their first 8 bytes
+    uint32_t used; // slots handed out
+    uint32_t capacity; // total slots
+    uint8_t class_idx;
+};
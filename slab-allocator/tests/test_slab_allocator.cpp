@@ -0,0 +1,264 @@
+#define TEST_MODE
+
+#include <assert.h>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+#include "../SlabAllocator.hpp"
+
+/* Returns the resident set size of the process in bytes */
+uint64_t get_rss() {
+    FILE *file = fopen("/proc/self/statm", "r");
+    assert(file != NULL);
+    uint64_t size, resident;
+    assert(fscanf(file, "%lu %lu", &size, &resident) == 2);
+    fclose(file);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+void test_class_size() {
+    assert(SlabAllocator::class_size(0) == 16);
+    assert(SlabAllocator::class_size(1) == 16);
+    assert(SlabAllocator::class_size(16) == 16);
+    assert(SlabAllocator::class_size(17) == 32);
+    assert(SlabAllocator::class_size(128) == 128);
+    assert(SlabAllocator::class_size(129) == 160);
+    assert(SlabAllocator::class_size(1000) == 1024);
+    assert(SlabAllocator::class_size(1024) == 1024);
+    assert(SlabAllocator::class_size(1025) == 1025);
+}
+
+void test_alloc_same_class_shares_slab() {
+    SlabAllocator allocator;
+
+    char *ptr1 = (char *) allocator.alloc(40);
+    char *ptr2 = (char *) allocator.alloc(48);
+
+    assert(ptr1 != ptr2);
+    assert(ptr2 - ptr1 == 48);
+    assert(((uintptr_t) ptr1 & 15) == 0);
+    assert(((uintptr_t) ptr1 & ~((uintptr_t) SlabAllocator::SLAB_SIZE - 1)) ==
+           ((uintptr_t) ptr2 & ~((uintptr_t) SlabAllocator::SLAB_SIZE - 1)));
+
+    allocator.free(ptr1, 40);
+    allocator.free(ptr2, 48);
+}
+
+void test_alloc_reuses_freed_slot() {
+    SlabAllocator allocator;
+
+    void *ptr1 = allocator.alloc(64);
+    allocator.alloc(64);
+    allocator.free(ptr1, 64);
+    void *ptr2 = allocator.alloc(64);
+
+    assert(ptr1 == ptr2);
+}
+
+void test_alloc_large() {
+    SlabAllocator allocator;
+
+    char *ptr = (char *) allocator.alloc(4096);
+    memset(ptr, 1, 4096);
+
+    SlabStats stats = allocator.get_stats();
+    assert(stats.large_allocs == 1);
+    assert(stats.allocs == 0);
+    assert(stats.arenas == 0);
+
+    allocator.free(ptr, 4096);
+}
+
+void test_alloc_fills_multiple_slabs() {
+    SlabAllocator allocator;
+    uint32_t slots_per_slab = (SlabAllocator::SLAB_SIZE - SlabAllocator::SLAB_HEADER_SIZE) / 1024;
+
+    std::vector<void *> ptrs;
+    for (uint32_t i = 0; i < 3 * slots_per_slab; i++) {
+        ptrs.push_back(allocator.alloc(1024));
+    }
+
+    SlabStats stats = allocator.get_stats();
+    assert(stats.slab_bytes == 3 * SlabAllocator::SLAB_SIZE);
+    assert(stats.used_bytes == 3 * slots_per_slab * 1024);
+    assert(stats.arenas == 1);
+    assert(stats.reserved_bytes == SlabAllocator::ARENA_SIZE);
+
+    for (void *ptr : ptrs) {
+        allocator.free(ptr, 1024);
+    }
+}
+
+void test_free_releases_empty_slabs() {
+    SlabAllocator allocator;
+    uint32_t slots_per_slab = (SlabAllocator::SLAB_SIZE - SlabAllocator::SLAB_HEADER_SIZE) / 512;
+
+    std::vector<void *> ptrs;
+    for (uint32_t i = 0; i < 3 * slots_per_slab; i++) {
+        ptrs.push_back(allocator.alloc(512));
+    }
+    uint64_t num_free_slabs = allocator.get_num_free_slabs();
+
+    for (void *ptr : ptrs) {
+        allocator.free(ptr, 512);
+    }
+
+    // one empty slab is kept by the size class
+    SlabStats stats = allocator.get_stats();
+    assert(allocator.get_num_free_slabs() == num_free_slabs + 2);
+    assert(stats.slab_bytes == SlabAllocator::SLAB_SIZE);
+    assert(stats.used_bytes == 0);
+    assert(stats.allocs == stats.frees);
+}
+
+void test_free_returns_memory_to_os() {
+    SlabAllocator allocator;
+    uint32_t slots_per_slab = (SlabAllocator::SLAB_SIZE - SlabAllocator::SLAB_HEADER_SIZE) / 1024;
+    uint32_t num_slabs = 24;
+
+    std::vector<void *> ptrs;
+    for (uint32_t i = 0; i < num_slabs * slots_per_slab; i++) {
+        void *ptr = allocator.alloc(1024);
+        memset(ptr, 1, 1024);
+        ptrs.push_back(ptr);
+    }
+    uint64_t released = allocator.get_stats().released_bytes;
+    uint64_t rss = get_rss();
+
+    for (void *ptr : ptrs) {
+        allocator.free(ptr, 1024);
+    }
+
+    // every slab but the one kept by the size class is released
+    uint64_t released_now = (uint64_t) (num_slabs - 1) * SlabAllocator::SLAB_SIZE;
+    assert(allocator.get_stats().released_bytes == released + released_now);
+    assert(get_rss() + released_now / 2 <= rss); // loosely, the rest of the process can touch new pages meanwhile
+
+    // released slabs are reused like any other
+    void *ptr = allocator.alloc(512);
+    memset(ptr, 1, 512);
+    assert(allocator.get_stats().released_bytes == released + released_now - SlabAllocator::SLAB_SIZE);
+    allocator.free(ptr, 512);
+}
+
+void test_fragmentation_ratio() {
+    SlabAllocator allocator;
+    uint32_t slots_per_slab = (SlabAllocator::SLAB_SIZE - SlabAllocator::SLAB_HEADER_SIZE) / 256;
+
+    std::vector<void *> ptrs;
+    for (uint32_t i = 0; i < 2 * slots_per_slab; i++) {
+        ptrs.push_back(allocator.alloc(256));
+    }
+    double packed_ratio = allocator.get_stats().fragmentation_ratio();
+
+    // free every other slot so both slabs stay half empty
+    for (uint32_t i = 0; i < ptrs.size(); i += 2) {
+        allocator.free(ptrs[i], 256);
+    }
+    double sparse_ratio = allocator.get_stats().fragmentation_ratio();
+
+    assert(packed_ratio < 1.01);
+    assert(sparse_ratio > 1.9);
+
+    for (uint32_t i = 1; i < ptrs.size(); i += 2) {
+        allocator.free(ptrs[i], 256);
+    }
+}
+
+void test_free_from_other_threads() {
+    SlabAllocator allocator;
+    std::vector<void *> ptrs[4];
+    for (std::vector<void *> &thread_ptrs : ptrs) {
+        for (uint32_t i = 0; i < 10000; i++) {
+            thread_ptrs.push_back(allocator.alloc(32));
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (std::vector<void *> &thread_ptrs : ptrs) {
+        threads.emplace_back([&allocator, &thread_ptrs]() {
+            for (void *ptr : thread_ptrs) {
+                allocator.free(ptr, 32);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    SlabStats stats = allocator.get_stats();
+    assert(stats.used_bytes == 0);
+    assert(stats.frees == 40000);
+}
+
+void test_defrag_hint() {
+    SlabAllocator allocator;
+    uint32_t slots_per_slab = (SlabAllocator::SLAB_SIZE - SlabAllocator::SLAB_HEADER_SIZE) / 128;
+
+    std::vector<void *> ptrs;
+    for (uint32_t i = 0; i < 3 * slots_per_slab; i++) {
+        ptrs.push_back(allocator.alloc(128));
+    }
+
+    // leave the first slab nearly empty and the second one half full
+    for (uint32_t i = 1; i < slots_per_slab; i++) {
+        allocator.free(ptrs[i], 128);
+    }
+    for (uint32_t i = slots_per_slab; i < 2 * slots_per_slab; i += 2) {
+        allocator.free(ptrs[i], 128);
+    }
+
+    // objects in the fullest slab stay, objects in the emptiest slab move to the half full one
+    assert(allocator.defrag_hint(ptrs[3 * slots_per_slab - 1], 128) == false);
+    assert(allocator.defrag_hint(ptrs[0], 128) == true);
+    void *moved = allocator.alloc(128);
+    uintptr_t slab_mask = ~((uintptr_t) SlabAllocator::SLAB_SIZE - 1);
+    assert(((uintptr_t) moved & slab_mask) == ((uintptr_t) ptrs[slots_per_slab] & slab_mask));
+    allocator.free(ptrs[0], 128);
+
+    SlabStats stats = allocator.get_stats();
+    assert(stats.defrag_hits == 1);
+    assert(stats.defrag_misses == 1);
+    assert(stats.slab_bytes == 2 * SlabAllocator::SLAB_SIZE);
+}
+
+void test_defrag_hint_large() {
+    SlabAllocator allocator;
+    void *ptr = allocator.alloc(4096);
+    assert(allocator.defrag_hint(ptr, 4096) == false);
+    allocator.free(ptr, 4096);
+}
+
+void test_slab_string() {
+    SlabStats before = SlabAllocator::shared().get_stats();
+
+    SlabString str(100, 'a');
+    assert(str.size() == 100);
+    assert(SlabAllocator::shared().get_stats().allocs == before.allocs + 1);
+
+    str.append("bc");
+    assert(str.substr(98) == "aabc");
+}
+
+int main() {
+    test_class_size();
+
+    test_alloc_same_class_shares_slab();
+    test_alloc_reuses_freed_slot();
+    test_alloc_large();
+    test_alloc_fills_multiple_slabs();
+
+    test_free_releases_empty_slabs();
+    test_free_returns_memory_to_os();
+    test_fragmentation_ratio();
+    test_free_from_other_threads();
+
+    test_defrag_hint();
+    test_defrag_hint_large();
+
+    test_slab_string();
+
+    return 0;
+}
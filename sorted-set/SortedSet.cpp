@@ -1,9 +1,15 @@
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <utility>
 
 #include "SortedSet.hpp"
+#include "../slab-allocator/SlabAllocator.hpp"
 #include "../utils/intrusive_data_structure_utils.hpp"
 #include "../utils/hash_utils.hpp"
 
+uint32_t SortedSet::max_listpack_entries = SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES;
+uint32_t SortedSet::max_listpack_value = SortedSet::DEFAULT_MAX_LISTPACK_VALUE;
 
 /**
  * Callback which checks if a HLookupPair and SPair in an HMap are equal.
@@ -42,147 +48,564 @@ bool are_pairs_equal(HNode *node1, HNode *node2) {
 }
 
 /**
- * Callback which compares two SPairs in an AVLTree.
+ * Callback which compares two SPairs in a BPlusTree.
  * 
- * @param node1 The AVLNode contained by the first pair.
- * @param node2 The AVLNode contained by the second pair.
+ * @param item1 Pointer to the first pair.
+ * @param item2 Pointer to the second pair.
  * 
  * @return  < 0 if first pair < second pair
  *          > 0 if first pair > second pair
  *          0 if the two are equal
  */
-int32_t compare_pairs(AVLNode *node1, AVLNode *node2) {
-    SPair *pair1 = container_of(node1, SPair, tree_node);
-    SPair *pair2 = container_of(node2, SPair, tree_node);
-    if (pair1->score != pair2->score) {
-        return pair1->score - pair2->score;
-    }
-    int res = strncmp(pair1->name, pair2->name, std::min(pair1->len, pair2->len));
-    return res != 0 ? res : pair1->len - pair2->len;
+int32_t compare_pairs(const void *item1, void *item2) {
+    const SPair *pair1 = (const SPair *) item1;
+    SPair *pair2 = (SPair *) item2;
+    return compare_score_and_name(pair1->score, pair1->name, pair1->len, pair2->score, pair2->name, pair2->len);
 }
 
 /**
- * Callback which compares an AVLLookupPair and SPair in an AVLTree.
+ * Callback which compares an SPairView and SPair in a BPlusTree.
  * 
- * @param node1 The AVLNode contained by the AVLLookupPair.
- * @param node2 The AVLNode contained by the SPair.
+ * @param item1 Pointer to the SPairView.
+ * @param item2 Pointer to the SPair.
  * 
  * @return  < 0 if first pair < second pair
  *          > 0 if first pair > second pair
  *          0 if the two are equal
  */
-int32_t compare_lookup_pair_to_pair(AVLNode *node1, AVLNode *node2) {
-    AVLLookupPair *pair1 = container_of(node1, AVLLookupPair, node);
-    SPair *pair2 = container_of(node2, SPair, tree_node);
-    if (pair1->score != pair2->score) {
-        return pair1->score - pair2->score;
+int32_t compare_view_to_pair(const void *item1, void *item2) {
+    const SPairView *pair1 = (const SPairView *) item1;
+    SPair *pair2 = (SPair *) item2;
+    return compare_score_and_name(pair1->score, pair1->name, pair1->len, pair2->score, pair2->name, pair2->len);
+}
+
+SortedSet::Snapshot::~Snapshot() {
+    if (index != NULL) {
+        release(index);
     }
-    int res = strncmp(pair1->name, pair2->name, std::min(pair1->len, pair2->len));
-    return res != 0 ? res : pair1->len - pair2->len;
 }
 
-/**
- * Cleans up (deallocates) the SPairs in the SortedSet by traversing the AVL tree.
- * 
- * @param root  Pointer to the root node of the SortedSet's AVL tree.
- */
-void clean_up_sorted_set(AVLNode *root) {
-    if (root == NULL) {
+uint32_t SortedSet::Snapshot::length() {
+    return index != NULL ? index->tree.length() : scores.size();
+}
+
+void SortedSet::Snapshot::for_each(void (*cb)(const SPairView &, void *), void *cb_arg) {
+    if (index == NULL) {
+        for (uint32_t i = 0; i < scores.size(); i++) {
+            cb({ scores[i], names[i].data(), (uint32_t) names[i].length() }, cb_arg);
+        }
         return;
     }
 
-    clean_up_sorted_set(root->left);
-    clean_up_sorted_set(root->right);
-    spair_del(container_of(root, SPair, tree_node));
+    // only the BPlusTree is read, since look-ups in the HMap move pairs between its tables while it's resizing
+    for (BPlusCursor cursor = index->tree.seek(0); cursor.leaf != NULL; BPlusTree::next(cursor)) {
+        SPair *pair = (SPair *) BPlusTree::get(cursor);
+        cb({ pair->score, pair->name, pair->len }, cb_arg);
+    }
 }
 
 SortedSet::~SortedSet() {
-    clean_up_sorted_set(tree.root);
+    if (index != NULL) {
+        release(index);
+    }
 }
 
 bool SortedSet::insert(double score, const char *name, uint32_t len) {
-    SPair *pair = lookup(name, len);
-    if (pair != NULL) {
-        update(pair, score);
-        return false;
+    unshare();
+    if (index == NULL) {
+        if (len > max_listpack_value) {
+            convert_to_index();
+        } else {
+            bool inserted = listpack.insert(score, name, len);
+            if (listpack.length() > max_listpack_entries) {
+                convert_to_index();
+            }
+            return inserted;
+        }
     }
-    pair = spair_new(name, len, score);
-    map.insert(&pair->map_node);
-    tree.insert(&pair->tree_node, compare_pairs);
-    return true;
+    return insert_into_index(score, name, len);
 }
 
-SPair *SortedSet::lookup(const char *name, uint32_t len) {
-    HLookupPair lookup_pair;
-    lookup_pair.node.hval = str_hash(name, len);
-    lookup_pair.name = name;
-    lookup_pair.len = len;
-    HNode *map_node = map.lookup(&lookup_pair.node, is_lookup_pair_equal_to_pair);
-    return map_node != NULL ? container_of(map_node, SPair, map_node) : NULL;
+uint32_t SortedSet::insert_all(const std::vector<SPairView> &pairs) {
+    unshare();
+    uint32_t inserted = 0;
+    uint32_t i = 0;
+    if (length() == 0 && pairs.size() > max_listpack_entries) {
+        if (index == NULL) {
+            listpack.clear();
+        }
+        inserted = i = build_index(pairs);
+    }
+
+    for (; i < pairs.size(); i++) {
+        if (insert(pairs[i].score, pairs[i].name, pairs[i].len)) {
+            inserted++;
+        }
+    }
+    return inserted;
 }
 
-std::vector<SPair *> SortedSet::find_all_ge(double score, const char *name, uint32_t len, int64_t offset, uint64_t limit) {
-    std::vector<SPair *> results;
+bool SortedSet::lookup(const char *name, uint32_t len, double *score) {
+    if (index == NULL) {
+        return listpack.lookup(name, len, score);
+    }
 
-    SPair *pair = find_first_ge(score, name, len);
+    SPair *pair = lookup_in_index(name, len);
     if (pair == NULL) {
-        return results;
+        return false;
+    }
+    if (score != NULL) {
+        *score = pair->score;
     }
+    return true;
+}
+
+std::vector<SPairView> SortedSet::find_all_ge(double score, const char *name, uint32_t len, int64_t offset, uint64_t limit) {
+    if (index == NULL) {
+        return listpack.find_all_ge(score, name, len, offset, limit);
+    }
+
+    std::vector<SPairView> results;
 
-    pair = find_offset(pair, offset);
-    while (pair != NULL && (limit == 0 || results.size() < limit)) {
-        results.push_back(pair);
-        pair = find_offset(pair, 1);
+    uint64_t rank;
+    BPlusCursor cursor = find_first_ge(score, name, len, &rank);
+    if (offset != 0) {
+        // an offset past either end finds nothing
+        if (offset < 0 && (uint64_t) -offset > rank) {
+            return results;
+        }
+        cursor = index->tree.seek(rank + offset);
+    }
+
+    for (; cursor.leaf != NULL && (limit == 0 || results.size() < limit); BPlusTree::next(cursor)) {
+        SPair *pair = (SPair *) BPlusTree::get(cursor);
+        results.push_back({ pair->score, pair->name, pair->len });
     }
 
     return results;
 }
 
 bool SortedSet::remove(const char *name, uint32_t len) {
-    SPair *pair = lookup(name, len);
+    unshare();
+    if (index == NULL) {
+        return listpack.remove(name, len);
+    }
+
+    SPair *pair = lookup_in_index(name, len);
     if (pair == NULL) {
         return false;
     }
 
-    map.remove(&pair->map_node, are_pairs_equal);
-    tree.root = tree.remove(&pair->tree_node);
+    index->map.remove(&pair->map_node, are_pairs_equal);
+    index->tree.remove(pair->score, pair, compare_pairs);
+    name_bytes -= pair->len;
     spair_del(pair);
 
     return true;
 }
 
-int64_t SortedSet::rank(const char *name, uint32_t len) {
-    SPair *pair = lookup(name, len);
-    if (pair == NULL) {
+int64_t SortedSet::rank(const char *name, uint32_t len, bool reverse) {
+    int64_t rank;
+    if (index == NULL) {
+        rank = listpack.rank(name, len);
+    } else {
+        SPair *pair = lookup_in_index(name, len);
+        rank = pair != NULL ? index->tree.rank(pair->score, pair, compare_pairs) : -1;
+    }
+
+    if (rank < 0) {
         return -1;
     }
-    return tree.rank(&pair->tree_node);
+    return reverse ? length() - 1 - rank : rank;
+}
+
+std::vector<SPairView> SortedSet::range_by_rank(int64_t start, int64_t stop, bool reverse) {
+    int64_t n = length();
+    if (start < 0) {
+        start += n;
+    }
+    if (stop < 0) {
+        stop += n;
+    }
+    start = std::max(start, (int64_t) 0);
+    stop = std::min(stop, n - 1);
+    if (start > stop) {
+        return std::vector<SPairView>();
+    }
+
+    if (reverse) {
+        // reverse ranks count down from the highest pair
+        return collect(n - 1 - stop, n - 1 - start, true);
+    }
+    return collect(start, stop, false);
+}
+
+std::vector<SPairView> SortedSet::range_by_score(const ScoreRange &range, bool reverse, uint64_t offset, 
+                                                 int64_t count) {
+    uint64_t low = count_below(range.min, range.min_exclusive);
+    uint64_t high = count_below(range.max, !range.max_exclusive);
+    return collect_range(low, high, reverse, offset, count);
+}
+
+uint64_t SortedSet::count(const ScoreRange &range) {
+    uint64_t low = count_below(range.min, range.min_exclusive);
+    uint64_t high = count_below(range.max, !range.max_exclusive);
+    return high > low ? high - low : 0;
+}
+
+std::vector<SPairView> SortedSet::range_by_lex(const LexRange &range, bool reverse, uint64_t offset, int64_t count) {
+    uint64_t low = count_below(range.min, range.min.exclusive);
+    uint64_t high = count_below(range.max, !range.max.exclusive);
+    return collect_range(low, high, reverse, offset, count);
+}
+
+uint64_t SortedSet::count(const LexRange &range) {
+    uint64_t low = count_below(range.min, range.min.exclusive);
+    uint64_t high = count_below(range.max, !range.max.exclusive);
+    return high > low ? high - low : 0;
+}
+
+uint64_t SortedSet::remove_range_by_rank(int64_t start, int64_t stop, BPlusTree **removed) {
+    *removed = NULL;
+    int64_t n = length();
+    if (start < 0) {
+        start += n;
+    }
+    if (stop < 0) {
+        stop += n;
+    }
+    start = std::max(start, (int64_t) 0);
+    stop = std::min(stop, n - 1);
+    if (start > stop) {
+        return 0;
+    }
+
+    remove_ranks(start, stop, removed);
+    return stop - start + 1;
+}
+
+uint64_t SortedSet::remove_range_by_score(const ScoreRange &range, BPlusTree **removed) {
+    *removed = NULL;
+    uint64_t low = count_below(range.min, range.min_exclusive);
+    uint64_t high = count_below(range.max, !range.max_exclusive);
+    if (high <= low) {
+        return 0;
+    }
+
+    remove_ranks(low, high - 1, removed);
+    return high - low;
+}
+
+uint64_t SortedSet::remove_range_by_lex(const LexRange &range, BPlusTree **removed) {
+    *removed = NULL;
+    uint64_t low = count_below(range.min, range.min.exclusive);
+    uint64_t high = count_below(range.max, !range.max.exclusive);
+    if (high <= low) {
+        return 0;
+    }
+
+    remove_ranks(low, high - 1, removed);
+    return high - low;
+}
+
+void SortedSet::free_pairs(BPlusTree *pairs) {
+    pairs->for_each([](void *pair, void *) { spair_del((SPair *) pair); }, NULL);
+    delete pairs;
+}
+
+void SortedSet::for_each(void (*cb)(const SPairView &, void *), void *cb_arg) {
+    if (index == NULL) {
+        listpack.for_each(cb, cb_arg);
+        return;
+    }
+
+    for (BPlusCursor cursor = index->tree.seek(0); cursor.leaf != NULL; BPlusTree::next(cursor)) {
+        SPair *pair = (SPair *) BPlusTree::get(cursor);
+        cb({ pair->score, pair->name, pair->len }, cb_arg);
+    }
 }
 
 uint32_t SortedSet::length() {
-    return map.length();
+    return index == NULL ? listpack.length() : index->map.length();
+}
+
+uint64_t SortedSet::memory_usage() {
+    if (index == NULL) {
+        return listpack.memory_usage();
+    }
+    return sizeof(Index) + (uint64_t) length() * sizeof(SPair) + name_bytes + index->tree.memory_usage();
+}
+
+bool SortedSet::is_packed() {
+    return index == NULL;
+}
+
+void SortedSet::swap(SortedSet &other) {
+    listpack.swap(other.listpack);
+    std::swap(index, other.index);
+    std::swap(name_bytes, other.name_bytes);
+}
+
+SortedSet::Snapshot *SortedSet::snapshot() {
+    Snapshot *snapshot = new Snapshot();
+    if (index != NULL) {
+        index->refs.fetch_add(1, std::memory_order_relaxed);
+        snapshot->index = index;
+        return snapshot;
+    }
+
+    snapshot->scores.reserve(listpack.length());
+    snapshot->names.reserve(listpack.length());
+    listpack.for_each([](const SPairView &pair, void *arg) {
+        Snapshot *snapshot = (Snapshot *) arg;
+        snapshot->scores.push_back(pair.score);
+        snapshot->names.emplace_back(pair.name, pair.len);
+    }, snapshot);
+    return snapshot;
+}
+
+/* Argument for the defrag_pair() callback */
+struct DefragPairArg {
+    BPlusTree *tree;
+    uint64_t *moved;
+};
+
+/**
+ * Callback which moves an SPair out of a sparse slab if the slab allocator suggests it.
+ * 
+ * @param from  The address of the pointer to the SPair's HNode in the hash map.
+ * @param arg   Void pointer to a DefragPairArg.
+ */
+void defrag_pair(HNode **from, void *arg) {
+    DefragPairArg *defrag_arg = (DefragPairArg *) arg;
+    SPair *pair = container_of(*from, SPair, map_node);
+    size_t size = sizeof(SPair) + pair->len;
+    if (!SlabAllocator::shared().defrag_hint(pair, size)) {
+        return;
+    }
+
+    SPair *moved = (SPair *) SlabAllocator::shared().alloc(size);
+    memcpy((void *) moved, (void *) pair, size);
+    *from = &moved->map_node;
+    defrag_arg->tree->replace(moved->score, pair, moved, compare_pairs);
+    SlabAllocator::shared().free(pair, size);
+    (*defrag_arg->moved)++;
+}
+
+uint64_t SortedSet::defrag(uint64_t cursor, uint64_t *moved) {
+    if (index == NULL) {
+        if (listpack.defrag()) {
+            (*moved)++;
+        }
+        return 0;
+    }
+
+    if (index->refs.load(std::memory_order_acquire) > 1) {
+        return 0;
+    }
+
+    DefragPairArg arg = { &index->tree, moved };
+    return index->map.scan(cursor, defrag_pair, &arg);
+}
+
+void SortedSet::convert_to_index() {
+    index = new Index();
+    listpack.for_each([](const SPairView &pair, void *arg) {
+        ((SortedSet *) arg)->insert_into_index(pair.score, pair.name, pair.len);
+    }, this);
+    listpack.clear();
+}
+
+void SortedSet::unshare() {
+    // a Snapshot releasing the index on another thread makes its reads visible before the count drops
+    if (index == NULL || index->refs.load(std::memory_order_acquire) == 1) {
+        return;
+    }
+
+    // the pairs are already in order, so the copy's BPlusTree is built bottom-up
+    Index *copy = new Index();
+    std::vector<double> scores;
+    std::vector<void *> items;
+    scores.reserve(index->tree.length());
+    items.reserve(index->tree.length());
+    for (BPlusCursor cursor = index->tree.seek(0); cursor.leaf != NULL; BPlusTree::next(cursor)) {
+        SPair *pair = (SPair *) BPlusTree::get(cursor);
+        SPair *pair_copy = spair_new(pair->name, pair->len, pair->score);
+        copy->map.insert(&pair_copy->map_node);
+        scores.push_back(pair->score);
+        items.push_back(pair_copy);
+    }
+    copy->tree.build(scores.data(), items.data(), items.size());
+
+    release(index);
+    index = copy;
+}
+
+void SortedSet::release(Index *index) {
+    if (index->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        index->tree.for_each([](void *pair, void *) { spair_del((SPair *) pair); }, NULL);
+        delete index;
+    }
+}
+
+bool SortedSet::insert_into_index(double score, const char *name, uint32_t len) {
+    SPair *pair = lookup_in_index(name, len);
+    if (pair != NULL) {
+        update(pair, score);
+        return false;
+    }
+    pair = spair_new(name, len, score);
+    name_bytes += len;
+    index->map.insert(&pair->map_node);
+    index->tree.insert(score, pair, compare_pairs);
+    return true;
+}
+
+uint32_t SortedSet::build_index(const std::vector<SPairView> &pairs) {
+    if (index == NULL) {
+        index = new Index();
+    }
+
+    std::vector<double> scores;
+    std::vector<void *> items;
+    scores.reserve(pairs.size());
+    items.reserve(pairs.size());
+    for (uint32_t i = 0; i < pairs.size(); i++) {
+        const SPairView &pair = pairs[i];
+        if (i > 0 && compare_score_and_name(pairs[i - 1].score, pairs[i - 1].name, pairs[i - 1].len, pair.score, 
+                                            pair.name, pair.len) >= 0) {
+            break;
+        }
+        // a repeated name can still be in order if its score went up, and is left to insert() to update
+        if (lookup_in_index(pair.name, pair.len) != NULL) {
+            break;
+        }
+
+        SPair *spair = spair_new(pair.name, pair.len, pair.score);
+        name_bytes += pair.len;
+        index->map.insert(&spair->map_node);
+        scores.push_back(pair.score);
+        items.push_back(spair);
+    }
+
+    index->tree.build(scores.data(), items.data(), items.size());
+    return items.size();
+}
+
+SPair *SortedSet::lookup_in_index(const char *name, uint32_t len) {
+    HLookupPair lookup_pair;
+    lookup_pair.node.hval = str_hash(name, len);
+    lookup_pair.name = name;
+    lookup_pair.len = len;
+    HNode *map_node = index->map.lookup(&lookup_pair.node, is_lookup_pair_equal_to_pair);
+    return map_node != NULL ? container_of(map_node, SPair, map_node) : NULL;
 }
 
 void SortedSet::update(SPair *pair, double score) {
-    // detach pair from AVLTree
-    tree.root = tree.remove(&pair->tree_node);
+    // detach pair from BPlusTree
+    index->tree.remove(pair->score, pair, compare_pairs);
 
     // re-insert to fix order
-    pair->tree_node = AVLNode(); // reset node data
     pair->score = score;
-    tree.insert(&pair->tree_node, compare_pairs);
+    index->tree.insert(score, pair, compare_pairs);
 }
 
-SPair *SortedSet::find_first_ge(double score, const char *name, uint32_t len) {
-    AVLLookupPair lookup_pair;
-    lookup_pair.score = score;
-    lookup_pair.name = name;
-    lookup_pair.len = len;
-    AVLNode *node = tree.find_first_ge(&lookup_pair.node, compare_lookup_pair_to_pair);
-    return node != NULL ? container_of(node, SPair, tree_node) : NULL;
+uint64_t SortedSet::count_below(double score, bool inclusive) {
+    if (index == NULL) {
+        return listpack.count_below(score, inclusive);
+    }
+
+    if (inclusive) {
+        if (score == std::numeric_limits<double>::infinity()) {
+            return length();
+        }
+        // pairs <= score are exactly the pairs < the next double after it
+        score = std::nextafter(score, std::numeric_limits<double>::infinity());
+    }
+
+    // the empty name is the lowest name, so this finds the first pair with a score >= score
+    uint64_t rank;
+    find_first_ge(score, "", 0, &rank);
+    return rank;
+}
+
+uint64_t SortedSet::count_below(const LexBound &bound, bool inclusive) {
+    if (bound.infinity != 0 || length() == 0) {
+        return bound.infinity > 0 ? length() : 0;
+    }
+
+    // the smallest name greater than a name is the name followed by a zero byte
+    std::string name = inclusive ? bound.name + '\0' : bound.name;
+    double score = collect(0, 0, false)[0].score;
+    if (index == NULL) {
+        return listpack.count_below(score, name.data(), name.length());
+    }
+
+    uint64_t rank;
+    find_first_ge(score, name.data(), name.length(), &rank);
+    return rank;
+}
+
+void SortedSet::remove_ranks(uint64_t first, uint64_t last, BPlusTree **removed) {
+    unshare();
+    if (index == NULL) {
+        listpack.remove_range(first, last);
+        *removed = NULL;
+        return;
+    }
+
+    BPlusTree *pairs = new BPlusTree();
+    index->tree.remove_range(first, last, *pairs);
+    for (BPlusCursor cursor = pairs->seek(0); cursor.leaf != NULL; BPlusTree::next(cursor)) {
+        SPair *pair = (SPair *) BPlusTree::get(cursor);
+        index->map.remove(&pair->map_node, are_pairs_equal);
+        name_bytes -= pair->len;
+    }
+    *removed = pairs;
+}
+
+std::vector<SPairView> SortedSet::collect(uint64_t first, uint64_t last, bool reverse) {
+    if (index == NULL) {
+        std::vector<SPairView> results = listpack.range(first, last);
+        if (reverse) {
+            std::reverse(results.begin(), results.end());
+        }
+        return results;
+    }
+
+    std::vector<SPairView> results;
+    results.reserve(last - first + 1);
+    BPlusCursor cursor = index->tree.seek(reverse ? last : first);
+    for (uint64_t i = first; i <= last; i++) {
+        SPair *pair = (SPair *) BPlusTree::get(cursor);
+        results.push_back({ pair->score, pair->name, pair->len });
+        if (reverse) {
+            BPlusTree::prev(cursor);
+        } else {
+            BPlusTree::next(cursor);
+        }
+    }
+    return results;
+}
+
+std::vector<SPairView> SortedSet::collect_range(uint64_t low, uint64_t high, bool reverse, uint64_t offset, 
+                                                int64_t count) {
+    if (high <= low || offset >= high - low || count == 0) {
+        return std::vector<SPairView>();
+    }
+
+    uint64_t n = high - low - offset;
+    if (count > 0 && (uint64_t) count < n) {
+        n = count;
+    }
+
+    if (reverse) {
+        return collect(high - offset - n, high - offset - 1, true);
+    }
+    return collect(low + offset, low + offset + n - 1, false);
 }
 
-SPair *SortedSet::find_offset(SPair *pair, int64_t offset) {
-    AVLNode *node = tree.find_offset(&pair->tree_node, offset);
-    return node != NULL ? container_of(node, SPair, tree_node) : NULL;
+BPlusCursor SortedSet::find_first_ge(double score, const char *name, uint32_t len, uint64_t *rank) {
+    SPairView key = { score, name, len };
+    return index->tree.find_first_ge(score, &key, compare_view_to_pair, rank);
 }
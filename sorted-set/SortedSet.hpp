@@ -1,14 +1,82 @@
 #pragma once
 
+#include <atomic>
+#include <limits>
+#include <string>
 #include <vector>
 
+#include "./components/Listpack.hpp"
 #include "./components/SPair.hpp"
-#include "../avl-tree/AVLTree.hpp"
+#include "../b-plus-tree/BPlusTree.hpp"
 #include "../hashmap/HMap.hpp"
 
-/* A collection of (score, name) pairs ordered from low to high */
+/* Range of scores to query a SortedSet with. Either end can be infinite. */
+struct ScoreRange {
+    double min = -std::numeric_limits<double>::infinity();
+    bool min_exclusive = false;
+    double max = std::numeric_limits<double>::infinity();
+    bool max_exclusive = false;
+};
+
+/* One end of a LexRange: a name, or an end lower ("-") or higher ("+") than every name */
+struct LexBound {
+    std::string name;
+    bool exclusive = false;
+    int8_t infinity = 0; // -1 if lower than every name, 1 if higher than every name, 0 if bounded by name
+};
+
+/* Range of names to query a SortedSet whose pairs all have the same score with. Defaults to every name. */
+struct LexRange {
+    LexBound min = { "", false, -1 };
+    LexBound max = { "", false, 1 };
+};
+
+/**
+ * A collection of (score, name) pairs ordered from low to high.
+ * 
+ * Small SortedSets are stored in a Listpack. Once a SortedSet has more than max_listpack_entries pairs or a name longer 
+ * than max_listpack_value bytes, it is converted to SPairs indexed by an HMap and a BPlusTree, and stays that way.
+ * 
+ * The index of a large SortedSet can be shared with Snapshots that are read from other threads. The SortedSet copies 
+ * its index before it is next modified while it's shared (copy-on-write), so Snapshots never see a change.
+ */
 class SortedSet {
+    private:
+        struct Index;
     public:
+        /**
+         * Read-only view of the pairs of a SortedSet at the time it was taken. Unlike the SortedSet, a Snapshot can be 
+         * read and deleted from any thread, one thread at a time.
+         */
+        class Snapshot {
+            public:
+                ~Snapshot();
+
+                /* Returns the number of pairs in the Snapshot */
+                uint32_t length();
+
+                /**
+                 * Applies a callback to each pair in the Snapshot, from low to high.
+                 * 
+                 * @param cb        The callback function. Names are valid until the Snapshot is deleted.
+                 * @param cb_arg    Void pointer to an argument for the callback.
+                 */
+                void for_each(void (*cb)(const SPairView &, void *), void *cb_arg);
+            private:
+                friend class SortedSet;
+
+                Index *index = NULL; // shared with the SortedSet, NULL if the SortedSet was packed
+                std::vector<double> scores; // scores of a packed SortedSet's pairs
+                std::vector<std::string> names; // names of a packed SortedSet's pairs
+        };
+
+
+        static const uint32_t DEFAULT_MAX_LISTPACK_ENTRIES = 128;
+        static const uint32_t DEFAULT_MAX_LISTPACK_VALUE = 64;
+
+        static uint32_t max_listpack_entries; // most pairs a SortedSet can hold before it's converted
+        static uint32_t max_listpack_value; // longest name a SortedSet can hold before it's converted
+
         ~SortedSet();
         
         /**
@@ -24,16 +92,31 @@ class SortedSet {
          */
         bool insert(double score, const char *name, uint32_t len);
 
+        /**
+         * Inserts many (score, name) pairs into the SortedSet, as if by calling insert() on each in turn, so a name 
+         * given more than once ends up with its last score.
+         * 
+         * When the SortedSet is empty and too many pairs are given to fit in a Listpack, the leading pairs that are 
+         * already in strictly increasing order (with no name repeated) are indexed in O(n) by building the BPlusTree 
+         * bottom-up, and only the rest are inserted one at a time. Loading a set from sorted input is therefore linear.
+         * 
+         * @param pairs The pairs to insert.
+         * 
+         * @return  The number of new pairs inserted.
+         */
+        uint32_t insert_all(const std::vector<SPairView> &pairs);
+
         /** 
          * Searches for a pair with the given name in the SortedSet.
          * 
          * @param name  Byte array that stores the name.
          * @param len   Length of the name.
+         * @param score (Optional) Pointer to store the score of the pair in.
          * 
-         * @return  A pointer to the pair if found.
-         *          NULL if a pair is not found.
+         * @return  True if the pair is found.
+         *          False if a pair is not found.
          */
-        SPair *lookup(const char *name, uint32_t len);
+        bool lookup(const char *name, uint32_t len, double *score = NULL);
 
         /**
          * Finds all pairs in the SortedSet greater than or equal to the given (score, name) pair. Optionally accepts an 
@@ -46,10 +129,10 @@ class SortedSet {
          * @param offset    (Optional) Number of pairs to exclude at the beginning of the result. Default is 0.
          * @param limit     (Optional) Maximum number of pairs to return. Default is 0 (no limit).
          * 
-         * @return  Vector containing pointers to pairs in the SortedSet that are greater than or equal to the given 
-         *          pair.
+         * @return  Vector containing the pairs in the SortedSet that are greater than or equal to the given pair. Names 
+         *          are only valid until the SortedSet is next modified.
          */
-        std::vector<SPair *>find_all_ge(double score, const char *name, uint32_t len, int64_t offset = 0, uint64_t limit = 0);
+        std::vector<SPairView> find_all_ge(double score, const char *name, uint32_t len, int64_t offset = 0, uint64_t limit = 0);
 
         /**
          * Removes the pair with the given name from the SortedSet.
@@ -67,19 +150,209 @@ class SortedSet {
          * 
          * The rank is 0-based, so the lowest pair is rank 0.
          * 
-         * @param name  Byte array that stores the name.
-         * @param len   Length of the name.
+         * @param name      Byte array that stores the name.
+         * @param len       Length of the name.
+         * @param reverse   (Optional) Rank from high to low instead, so the highest pair is rank 0. Default is false.
          * 
          * @return  The rank of the pair if found.
          *          -1 if the pair does not exist.
          */
-        int64_t rank(const char *name, uint32_t len);
+        int64_t rank(const char *name, uint32_t len, bool reverse = false);
+
+        /**
+         * Gets the pairs with ranks start through stop (inclusive) in the SortedSet, in O(log n + k) for k pairs.
+         * 
+         * Negative ranks count back from the end, so -1 is the last pair. Ranks past either end are clamped.
+         * 
+         * @param start     The rank of the first pair.
+         * @param stop      The rank of the last pair.
+         * @param reverse   (Optional) Rank and return the pairs from high to low instead. Default is false.
+         * 
+         * @return  Vector containing the pairs. Names are only valid until the SortedSet is next modified.
+         */
+        std::vector<SPairView> range_by_rank(int64_t start, int64_t stop, bool reverse = false);
+
+        /**
+         * Gets the pairs with scores in the given range, in O(log n + k) for k pairs.
+         * 
+         * @param range     The range of scores.
+         * @param reverse   (Optional) Return the pairs from high to low instead. Default is false.
+         * @param offset    (Optional) Number of pairs to skip at the beginning of the result. Default is 0.
+         * @param count     (Optional) Maximum number of pairs to return. Negative means no limit. Default is -1.
+         * 
+         * @return  Vector containing the pairs. Names are only valid until the SortedSet is next modified.
+         */
+        std::vector<SPairView> range_by_score(const ScoreRange &range, bool reverse = false, uint64_t offset = 0, 
+                                              int64_t count = -1);
+
+        /**
+         * Counts the pairs with scores in the given range, in O(log n) for large SortedSets.
+         * 
+         * @param range The range of scores.
+         * 
+         * @return  The number of pairs.
+         */
+        uint64_t count(const ScoreRange &range);
+
+        /**
+         * Gets the pairs with names in the given range, in O(log n + k) for k pairs. Pairs are ordered by name within a 
+         * score, so this is only meaningful when every pair has the same score, like Redis' by-lex commands.
+         * 
+         * @param range     The range of names.
+         * @param reverse   (Optional) Return the pairs from high to low instead. Default is false.
+         * @param offset    (Optional) Number of pairs to skip at the beginning of the result. Default is 0.
+         * @param count     (Optional) Maximum number of pairs to return. Negative means no limit. Default is -1.
+         * 
+         * @return  Vector containing the pairs. Names are only valid until the SortedSet is next modified.
+         */
+        std::vector<SPairView> range_by_lex(const LexRange &range, bool reverse = false, uint64_t offset = 0, 
+                                            int64_t count = -1);
+
+        /**
+         * Counts the pairs with names in the given range, in O(log n) for large SortedSets. See range_by_lex().
+         * 
+         * @param range The range of names.
+         * 
+         * @return  The number of pairs.
+         */
+        uint64_t count(const LexRange &range);
+
+        /**
+         * Removes the pairs with ranks start through stop (inclusive) from the SortedSet. Negative ranks count back 
+         * from the end, so -1 is the last pair. Ranks past either end are clamped.
+         * 
+         * Large SortedSets cut the range out of their BPlusTree in O(log n) and only unlink the removed pairs from the 
+         * hash map, leaving them to be freed by the caller, so a big range can be freed off the main thread.
+         * 
+         * @param start     The rank of the first pair.
+         * @param stop      The rank of the last pair.
+         * @param removed   Pointer to store a BPlusTree holding the removed SPairs in, to be freed with free_pairs(). 
+         *                  Set to NULL if there is nothing left to free.
+         * 
+         * @return  The number of pairs removed.
+         */
+        uint64_t remove_range_by_rank(int64_t start, int64_t stop, BPlusTree **removed);
+
+        /**
+         * Removes the pairs with scores in the given range from the SortedSet. See remove_range_by_rank().
+         * 
+         * @param range     The range of scores.
+         * @param removed   Pointer to store a BPlusTree holding the removed SPairs in, to be freed with free_pairs(). 
+         *                  Set to NULL if there is nothing left to free.
+         * 
+         * @return  The number of pairs removed.
+         */
+        uint64_t remove_range_by_score(const ScoreRange &range, BPlusTree **removed);
+
+        /**
+         * Removes the pairs with names in the given range from the SortedSet. See range_by_lex() and 
+         * remove_range_by_rank().
+         * 
+         * @param range     The range of names.
+         * @param removed   Pointer to store a BPlusTree holding the removed SPairs in, to be freed with free_pairs(). 
+         *                  Set to NULL if there is nothing left to free.
+         * 
+         * @return  The number of pairs removed.
+         */
+        uint64_t remove_range_by_lex(const LexRange &range, BPlusTree **removed);
+
+        /* Deallocates the SPairs removed from a SortedSet by a range removal, then the BPlusTree holding them */
+        static void free_pairs(BPlusTree *pairs);
+
+        /**
+         * Applies a callback to each pair in the SortedSet, from low to high. Only reads the SortedSet, so it's safe to 
+         * call from a forked child.
+         * 
+         * @param cb        The callback function. Names are only valid until the SortedSet is next modified.
+         * @param cb_arg    Void pointer to an argument for the callback.
+         */
+        void for_each(void (*cb)(const SPairView &, void *), void *cb_arg);
 
         /* Returns the number of pairs in the SortedSet */
         uint32_t length();
+
+        /* Returns the approximate number of bytes allocated for the pairs in the SortedSet */
+        uint64_t memory_usage();
+
+        /* Returns whether the SortedSet is stored in a Listpack */
+        bool is_packed();
+
+        /* Swaps the contents of two SortedSets */
+        void swap(SortedSet &other);
+
+        /**
+         * Takes a Snapshot of the SortedSet. A large SortedSet shares its index with the Snapshot in O(1), a packed one 
+         * is copied.
+         * 
+         * @return  Pointer to the Snapshot. The caller is responsible for deleting it.
+         */
+        Snapshot *snapshot();
+
+        /**
+         * Moves the pairs in one slot of the SortedSet's hash map out of sparse slabs, fixing up their hash map and 
+         * BPlusTree links. Called repeatedly with the returned cursor to defragment the whole SortedSet incrementally. A 
+         * packed SortedSet is defragmented in one call, and one whose index is shared with a Snapshot is skipped.
+         * 
+         * @param cursor    The slot to defragment. 0 starts from the beginning.
+         * @param moved     Pointer to a counter that is incremented for each pair (or Listpack) moved.
+         * 
+         * @return  The cursor for the next slot.
+         *          0 if the whole SortedSet has been defragmented.
+         */
+        uint64_t defrag(uint64_t cursor, uint64_t *moved);
     private:
-        HMap map; // used for point queries
-        AVLTree tree; // used for range and rank queries
+        /* SPairs indexed for large SortedSets */
+        struct Index {
+            HMap map; // used for point queries
+            BPlusTree tree; // used for range and rank queries, and by Snapshots
+            std::atomic<uint32_t> refs = 1; // the SortedSet and any Snapshots sharing the index
+        };
+
+        Listpack listpack; // used while the SortedSet is small
+        Index *index = NULL; // NULL while the SortedSet is packed
+        uint64_t name_bytes = 0; // total length of the names of the pairs in the index
+
+        /* Moves the pairs in the Listpack into a new index */
+        void convert_to_index();
+
+        /* Copies the index if it's shared with a Snapshot, so it can be modified. Called before every modification. */
+        void unshare();
+
+        /* Drops a reference to an index, deallocating it and its SPairs if it was the last one */
+        static void release(Index *index);
+
+        /**
+         * Inserts a new pair into the index, or updates the existing pair.
+         * 
+         * @param score The score.
+         * @param name  Byte array that stores the name.
+         * @param len   Length of the name.
+         * 
+         * @return  True if the a new pair is inserted.
+         *          False if the pair already exists.
+         */
+        bool insert_into_index(double score, const char *name, uint32_t len);
+
+        /**
+         * Creates the index for an empty SortedSet from the longest run of pairs at the front of the given pairs that 
+         * are in strictly increasing order, building its BPlusTree bottom-up.
+         * 
+         * @param pairs The pairs. Must not be empty.
+         * 
+         * @return  The number of pairs indexed, at least 1.
+         */
+        uint32_t build_index(const std::vector<SPairView> &pairs);
+
+        /** 
+         * Searches for an SPair with the given name in the index.
+         * 
+         * @param name  Byte array that stores the name.
+         * @param len   Length of the name.
+         * 
+         * @return  A pointer to the pair if found.
+         *          NULL if a pair is not found.
+         */
+        SPair *lookup_in_index(const char *name, uint32_t len);
 
         /**
          * Updates the given pair and adjusts its order in the SortedSet.
@@ -89,26 +362,72 @@ class SortedSet {
          */
         void update(SPair *pair, double score);
 
+        /**
+         * Counts the pairs with a score less than the given score, or less than or equal to it if inclusive. This is the 
+         * rank of the first pair past the score.
+         * 
+         * @param score     The score.
+         * @param inclusive Whether to count pairs equal to the score.
+         * 
+         * @return  The number of pairs.
+         */
+        uint64_t count_below(double score, bool inclusive);
+
+        /**
+         * Counts the pairs with the score of the lowest pair and a name less than the bound's, or less than or equal to 
+         * it if inclusive. This is the rank of the first pair past the bound when every pair has the same score.
+         * 
+         * @param bound     The bound.
+         * @param inclusive Whether to count the pair with the bound's name.
+         * 
+         * @return  The number of pairs.
+         */
+        uint64_t count_below(const LexBound &bound, bool inclusive);
+
+        /**
+         * Gets the pairs with ranks low through high (exclusive), after skipping offset of them from the start (or the 
+         * end if reverse).
+         * 
+         * @param low       The rank of the first pair in the range.
+         * @param high      One past the rank of the last pair in the range.
+         * @param reverse   Whether to return the pairs from high to low.
+         * @param offset    Number of pairs to skip.
+         * @param count     Maximum number of pairs to return. Negative means no limit.
+         * 
+         * @return  Vector containing the pairs.
+         */
+        std::vector<SPairView> collect_range(uint64_t low, uint64_t high, bool reverse, uint64_t offset, int64_t count);
+
+        /**
+         * Removes the pairs with ranks first through last (inclusive).
+         * 
+         * @param first     The rank of the first pair. Must be <= last.
+         * @param last      The rank of the last pair. Must be < length().
+         * @param removed   Pointer to store a BPlusTree holding the removed SPairs in, or NULL if there are none to 
+         *                  free.
+         */
+        void remove_ranks(uint64_t first, uint64_t last, BPlusTree **removed);
+
+        /**
+         * Gets the pairs with ranks first through last (inclusive).
+         * 
+         * @param first     The rank of the first pair. Must be <= last.
+         * @param last      The rank of the last pair. Must be < length().
+         * @param reverse   Whether to return the pairs from high to low.
+         * 
+         * @return  Vector containing the pairs.
+         */
+        std::vector<SPairView> collect(uint64_t first, uint64_t last, bool reverse);
+
         /**
          * Finds the first pair in the SortedSet greater than or equal to the given (score, name) pair. 
          * 
          * @param score The score.
          * @param name  Byte array that stores the name.
          * @param len   Length of the name.
+         * @param rank  Pointer to store the rank of the pair in. Set to length() if no such pair exists.
          * 
-         * @return  Pointer to the pair if found.
-         *          NULL if no such pair exists in the SortedSet.
-         */
-        SPair *find_first_ge(double score, const char *name, uint32_t len);
-
-        /**
-         * Finds the pair located offset positions away from the specified pair in the SortedSet.
-         *
-         * @param pair      Pointer to the starting pair.
-         * @param offset    Number of positions away the offset pair is from the starting pair.
-         *
-         * @return  Pointer to the pair if found.
-         *          NULL if no such pair exists in the SortedSet.
+         * @return  Cursor to the pair in the BPlusTree. Past the end if no such pair exists.
          */
-        SPair *find_offset(SPair *pair, int64_t offset);
+        BPlusCursor find_first_ge(double score, const char *name, uint32_t len, uint64_t *rank);
 };
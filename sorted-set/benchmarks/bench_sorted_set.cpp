@@ -0,0 +1,100 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <string>
+#include <vector>
+
+#include "../SortedSet.hpp"
+#include "../../slab-allocator/SlabAllocator.hpp"
+#include "../../utils/time_utils.hpp"
+
+// Compares the listpack and indexed (HMap + BPlusTree) encodings of SortedSet on many small sorted sets: bytes per pair,
+// and the throughput of the operations behind zadd, zscore, zrank, zquery and zrem.
+
+const uint32_t NUM_PAIRS = 1000000; // spread over NUM_PAIRS / size sorted sets
+const uint32_t SIZES[] = { 8, 32, 64, 128 };
+
+void report(const char *encoding, uint32_t size, const char *op, uint64_t n, double ms) {
+    printf("%-8s size %-4u %-8s %10lu ops %10.2f ms %8.1f ns/op\n", encoding, size, op, n, ms, ms * 1e6 / n);
+}
+
+/* Returns the bytes currently allocated by malloc and the shared slab allocator */
+uint64_t allocated_bytes() {
+    return mallinfo2().uordblks + SlabAllocator::shared().get_stats().used_bytes;
+}
+
+void bench(const char *encoding, uint32_t size, const std::vector<std::string> &names) {
+    uint32_t num_sets = NUM_PAIRS / size;
+    uint64_t base = allocated_bytes();
+
+    std::vector<SortedSet *> sets(num_sets);
+    for (SortedSet *&set : sets) {
+        set = new SortedSet();
+    }
+
+    // scores are random so pairs are inserted out of order
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < size; i++) {
+        for (SortedSet *set : sets) {
+            set->insert(rand() % 1000, names[i].data(), names[i].length());
+        }
+    }
+    report(encoding, size, "zadd", (uint64_t) num_sets * size, elapsed_ms(start));
+
+    printf("%-8s size %-4u %.1f bytes/pair\n", encoding, size, (double) (allocated_bytes() - base) / NUM_PAIRS);
+
+    double score;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < size; i++) {
+        for (SortedSet *set : sets) {
+            set->lookup(names[i].data(), names[i].length(), &score);
+        }
+    }
+    report(encoding, size, "zscore", (uint64_t) num_sets * size, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < size; i++) {
+        for (SortedSet *set : sets) {
+            set->rank(names[i].data(), names[i].length());
+        }
+    }
+    report(encoding, size, "zrank", (uint64_t) num_sets * size, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (SortedSet *set : sets) {
+        set->find_all_ge(500, "", 0, 0, 10);
+    }
+    report(encoding, size, "zquery", num_sets, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < size; i++) {
+        for (SortedSet *set : sets) {
+            set->remove(names[i].data(), names[i].length());
+        }
+    }
+    report(encoding, size, "zrem", (uint64_t) num_sets * size, elapsed_ms(start));
+
+    for (SortedSet *set : sets) {
+        delete set;
+    }
+}
+
+int main() {
+    srand(0);
+
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < SIZES[sizeof(SIZES) / sizeof(SIZES[0]) - 1]; i++) {
+        names.push_back("member:" + std::to_string(i));
+    }
+
+    for (uint32_t size : SIZES) {
+        SortedSet::max_listpack_entries = SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES;
+        bench("listpack", size, names);
+
+        SortedSet::max_listpack_entries = 0;
+        bench("indexed", size, names);
+    }
+
+    return 0;
+}
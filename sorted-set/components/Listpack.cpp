@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "Listpack.hpp"
+#include "../../slab-allocator/SlabAllocator.hpp"
+
+Listpack::~Listpack() {
+    clear();
+}
+
+bool Listpack::insert(double score, const char *name, uint32_t len) {
+    bool exists = remove(name, len);
+
+    // pairs are ordered, so the new pair goes in front of the first pair greater than it
+    uint32_t pos = 0;
+    while (pos < used) {
+        SPairView pair = read(pos);
+        if (compare_score_and_name(pair.score, pair.name, pair.len, score, name, len) > 0) {
+            break;
+        }
+        pos += PAIR_HEADER_SIZE + pair.len;
+    }
+
+    uint32_t size = PAIR_HEADER_SIZE + len;
+    reserve(used + size);
+    memmove(buf + pos + size, buf + pos, used - pos);
+    memcpy(buf + pos, &score, sizeof(double));
+    buf[pos + sizeof(double)] = (uint8_t) len;
+    memcpy(buf + pos + PAIR_HEADER_SIZE, name, len);
+    used += size;
+    count++;
+
+    return !exists;
+}
+
+bool Listpack::lookup(const char *name, uint32_t len, double *score) {
+    int64_t pos = find(name, len);
+    if (pos < 0) {
+        return false;
+    }
+    if (score != NULL) {
+        *score = read(pos).score;
+    }
+    return true;
+}
+
+std::vector<SPairView> Listpack::find_all_ge(double score, const char *name, uint32_t len, int64_t offset,
+                                             uint64_t limit) {
+    std::vector<SPairView> results;
+
+    int64_t first = -1;
+    uint32_t i = 0;
+    for (uint32_t pos = 0; pos < used; i++) {
+        SPairView pair = read(pos);
+        if (compare_score_and_name(pair.score, pair.name, pair.len, score, name, len) >= 0) {
+            first = i;
+            break;
+        }
+        pos += PAIR_HEADER_SIZE + pair.len;
+    }
+    if (first < 0 || first + offset < 0 || first + offset >= count) {
+        return results;
+    }
+
+    uint32_t start = first + offset;
+    i = 0;
+    for (uint32_t pos = 0; pos < used && (limit == 0 || results.size() < limit); i++) {
+        SPairView pair = read(pos);
+        if (i >= start) {
+            results.push_back(pair);
+        }
+        pos += PAIR_HEADER_SIZE + pair.len;
+    }
+
+    return results;
+}
+
+std::vector<SPairView> Listpack::range(uint32_t first, uint32_t last) {
+    std::vector<SPairView> results;
+    uint32_t i = 0;
+    for (uint32_t pos = 0; pos < used && i <= last; i++) {
+        SPairView pair = read(pos);
+        if (i >= first) {
+            results.push_back(pair);
+        }
+        pos += PAIR_HEADER_SIZE + pair.len;
+    }
+    return results;
+}
+
+void Listpack::remove_range(uint32_t first, uint32_t last) {
+    uint32_t start = 0;
+    uint32_t end = 0;
+    uint32_t i = 0;
+    for (uint32_t pos = 0; pos < used && i <= last; i++) {
+        if (i == first) {
+            start = pos;
+        }
+        pos += PAIR_HEADER_SIZE + read(pos).len;
+        end = pos;
+    }
+
+    memmove(buf + start, buf + end, used - end);
+    used -= end - start;
+    count -= last - first + 1;
+    if (count == 0) {
+        clear();
+    }
+}
+
+uint32_t Listpack::count_below(double score, bool inclusive) {
+    uint32_t n = 0;
+    for (uint32_t pos = 0; pos < used; n++) {
+        SPairView pair = read(pos);
+        if (inclusive ? pair.score > score : pair.score >= score) {
+            break;
+        }
+        pos += PAIR_HEADER_SIZE + pair.len;
+    }
+    return n;
+}
+
+uint32_t Listpack::count_below(double score, const char *name, uint32_t len) {
+    uint32_t n = 0;
+    for (uint32_t pos = 0; pos < used; n++) {
+        SPairView pair = read(pos);
+        if (compare_score_and_name(pair.score, pair.name, pair.len, score, name, len) >= 0) {
+            break;
+        }
+        pos += PAIR_HEADER_SIZE + pair.len;
+    }
+    return n;
+}
+
+bool Listpack::remove(const char *name, uint32_t len) {
+    int64_t pos = find(name, len);
+    if (pos < 0) {
+        return false;
+    }
+
+    uint32_t size = PAIR_HEADER_SIZE + len;
+    memmove(buf + pos, buf + pos + size, used - pos - size);
+    used -= size;
+    count--;
+    if (count == 0) {
+        clear();
+    }
+
+    return true;
+}
+
+int64_t Listpack::rank(const char *name, uint32_t len) {
+    uint32_t rank;
+    if (find(name, len, &rank) < 0) {
+        return -1;
+    }
+    return rank;
+}
+
+void Listpack::for_each(void (*cb)(const SPairView &, void *), void *cb_arg) {
+    for (uint32_t pos = 0; pos < used;) {
+        SPairView pair = read(pos);
+        cb(pair, cb_arg);
+        pos += PAIR_HEADER_SIZE + pair.len;
+    }
+}
+
+uint32_t Listpack::length() {
+    return count;
+}
+
+uint64_t Listpack::memory_usage() {
+    return capacity;
+}
+
+void Listpack::clear() {
+    SlabAllocator::shared().free(buf, capacity);
+    buf = NULL;
+    used = 0;
+    capacity = 0;
+    count = 0;
+}
+
+void Listpack::swap(Listpack &other) {
+    std::swap(buf, other.buf);
+    std::swap(used, other.used);
+    std::swap(capacity, other.capacity);
+    std::swap(count, other.count);
+}
+
+bool Listpack::defrag() {
+    if (buf == NULL || !SlabAllocator::shared().defrag_hint(buf, capacity)) {
+        return false;
+    }
+
+    char *moved = (char *) SlabAllocator::shared().alloc(capacity);
+    memcpy(moved, buf, used);
+    SlabAllocator::shared().free(buf, capacity);
+    buf = moved;
+    return true;
+}
+
+SPairView Listpack::read(uint32_t pos) {
+    SPairView pair;
+    memcpy(&pair.score, buf + pos, sizeof(double)); // may be unaligned
+    pair.len = (uint8_t) buf[pos + sizeof(double)];
+    pair.name = buf + pos + PAIR_HEADER_SIZE;
+    return pair;
+}
+
+int64_t Listpack::find(const char *name, uint32_t len, uint32_t *rank) {
+    uint32_t i = 0;
+    for (uint32_t pos = 0; pos < used; i++) {
+        SPairView pair = read(pos);
+        if (pair.len == len && memcmp(pair.name, name, len) == 0) {
+            if (rank != NULL) {
+                *rank = i;
+            }
+            return pos;
+        }
+        pos += PAIR_HEADER_SIZE + pair.len;
+    }
+    return -1;
+}
+
+void Listpack::reserve(uint32_t n) {
+    if (n <= capacity) {
+        return;
+    }
+
+    // past the largest size class the buffer comes from malloc, so grow geometrically to keep inserts amortized
+    uint32_t new_capacity = SlabAllocator::class_size(n);
+    if (new_capacity > SlabAllocator::MAX_SIZE) {
+        new_capacity = std::max(n, capacity + capacity / 2);
+    }
+
+    char *new_buf = (char *) SlabAllocator::shared().alloc(new_capacity);
+    if (buf != NULL) {
+        memcpy(new_buf, buf, used);
+        SlabAllocator::shared().free(buf, capacity);
+    }
+    buf = new_buf;
+    capacity = new_capacity;
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "SPair.hpp"
+
+/**
+ * Compact encoding for small SortedSets: (score, name) pairs packed one after another in a single buffer, ordered from
+ * low to high.
+ * 
+ * Each pair is stored as its 8-byte score, a 1-byte name length, and the name, so names can be at most MAX_NAME_LEN
+ * bytes. Compared to an SPair in an HMap and BPlusTree there are no per-pair allocations or node pointers, at the cost
+ * of O(n) look-ups and updates, which is cheap (and cache friendly) while n is small. The buffer is allocated from the
+ * shared SlabAllocator.
+ */
+class Listpack {
+    private:
+        static const uint32_t PAIR_HEADER_SIZE = sizeof(double) + sizeof(uint8_t);
+
+        char *buf = NULL;
+        uint32_t used = 0; // bytes of buf holding pairs
+        uint32_t capacity = 0; // bytes allocated for buf
+        uint32_t count = 0; // number of pairs
+
+        /**
+         * Decodes the pair at the given position in the buffer.
+         * 
+         * @param pos   Byte offset of the pair.
+         * 
+         * @return  The pair.
+         */
+        SPairView read(uint32_t pos);
+
+        /**
+         * Finds the position of the pair with the given name.
+         * 
+         * @param name  Byte array that stores the name.
+         * @param len   Length of the name.
+         * @param rank  (Optional) Pointer to store the rank of the pair in.
+         * 
+         * @return  Byte offset of the pair if found.
+         *          -1 if the pair does not exist.
+         */
+        int64_t find(const char *name, uint32_t len, uint32_t *rank = NULL);
+
+        /**
+         * Makes sure the buffer can hold at least n bytes, growing it to the size class n falls in.
+         * 
+         * @param n The number of bytes required.
+         */
+        void reserve(uint32_t n);
+    public:
+        static const uint32_t MAX_NAME_LEN = UINT8_MAX;
+
+        ~Listpack();
+
+        /**
+         * Inserts a new (score, name) pair into the Listpack if it doesn't already exist. Otherwise, updates the score
+         * of the existing pair.
+         * 
+         * @param score The score.
+         * @param name  Byte array that stores the name. At most MAX_NAME_LEN bytes.
+         * @param len   Length of the name.
+         * 
+         * @return  True if a new pair is inserted.
+         *          False if the pair already exists.
+         */
+        bool insert(double score, const char *name, uint32_t len);
+
+        /**
+         * Searches for a pair with the given name in the Listpack.
+         * 
+         * @param name  Byte array that stores the name.
+         * @param len   Length of the name.
+         * @param score (Optional) Pointer to store the score of the pair in.
+         * 
+         * @return  True if the pair is found.
+         *          False otherwise.
+         */
+        bool lookup(const char *name, uint32_t len, double *score = NULL);
+
+        /**
+         * Finds all pairs in the Listpack greater than or equal to the given (score, name) pair, skipping offset pairs
+         * from the first one and returning at most limit pairs.
+         * 
+         * @param score     The score.
+         * @param name      Byte array that stores the name.
+         * @param len       Length of the name.
+         * @param offset    Number of pairs to exclude at the beginning of the result. May be negative.
+         * @param limit     Maximum number of pairs to return. 0 means no limit.
+         * 
+         * @return  Vector containing the pairs.
+         */
+        std::vector<SPairView> find_all_ge(double score, const char *name, uint32_t len, int64_t offset, uint64_t limit);
+
+        /**
+         * Gets the pairs with ranks first through last (inclusive) in the Listpack.
+         * 
+         * @param first The rank of the first pair. Must be <= last.
+         * @param last  The rank of the last pair. Must be < length().
+         * 
+         * @return  Vector containing the pairs, from low to high.
+         */
+        std::vector<SPairView> range(uint32_t first, uint32_t last);
+
+        /**
+         * Removes the pairs with ranks first through last (inclusive) from the Listpack.
+         * 
+         * @param first The rank of the first pair. Must be <= last.
+         * @param last  The rank of the last pair. Must be < length().
+         */
+        void remove_range(uint32_t first, uint32_t last);
+
+        /**
+         * Counts the pairs in the Listpack with a score less than the given score, or less than or equal to it if 
+         * inclusive. This is the rank of the first pair past the score.
+         * 
+         * @param score     The score.
+         * @param inclusive Whether to count pairs equal to the score.
+         * 
+         * @return  The number of pairs.
+         */
+        uint32_t count_below(double score, bool inclusive);
+
+        /**
+         * Counts the pairs in the Listpack less than the given (score, name) pair. This is the rank the pair has, or 
+         * would have if it was inserted.
+         * 
+         * @param score The score.
+         * @param name  Byte array that stores the name.
+         * @param len   Length of the name.
+         * 
+         * @return  The number of pairs.
+         */
+        uint32_t count_below(double score, const char *name, uint32_t len);
+
+        /**
+         * Removes the pair with the given name from the Listpack.
+         * 
+         * @param name  Byte array that stores the name.
+         * @param len   Length of the name.
+         * 
+         * @return  True if the pair is removed.
+         *          False if the pair does not exist.
+         */
+        bool remove(const char *name, uint32_t len);
+
+        /**
+         * Finds the rank (position in sorted order) of the pair with the given name in the Listpack.
+         * 
+         * @param name  Byte array that stores the name.
+         * @param len   Length of the name.
+         * 
+         * @return  The rank of the pair if found.
+         *          -1 if the pair does not exist.
+         */
+        int64_t rank(const char *name, uint32_t len);
+
+        /**
+         * Applies a callback to each pair in the Listpack, from low to high.
+         * 
+         * @param cb        The callback function.
+         * @param cb_arg    Void pointer to an argument for the callback.
+         */
+        void for_each(void (*cb)(const SPairView &, void *), void *cb_arg);
+
+        /* Returns the number of pairs in the Listpack */
+        uint32_t length();
+
+        /* Returns the number of bytes allocated for the Listpack's buffer */
+        uint64_t memory_usage();
+
+        /* Frees the buffer and removes all pairs */
+        void clear();
+
+        /* Swaps the contents of two Listpacks */
+        void swap(Listpack &other);
+
+        /**
+         * Moves the buffer out of a sparse slab if the slab allocator suggests it.
+         * 
+         * @return  True if the buffer was moved.
+         *          False otherwise.
+         */
+        bool defrag();
+};
@@ -1,15 +1,15 @@
-#include <stdlib.h>
+#include <algorithm>
 #include <cstring>
 
 #include "SPair.hpp"
+#include "../../slab-allocator/SlabAllocator.hpp"
 #include "../../utils/hash_utils.hpp"
 
 SPair *spair_new(const char *name, uint32_t len, double score) {
-    SPair *pair = (SPair *) malloc(sizeof(SPair) + len);
-    // explicitly initialize all members because memory allocated by malloc is not initialized
+    SPair *pair = (SPair *) SlabAllocator::shared().alloc(sizeof(SPair) + len);
+    // explicitly initialize all members because memory allocated by the slab allocator is not initialized
     pair->map_node = HNode(); 
     pair->map_node.hval = str_hash(name, len);
-    pair->tree_node = AVLNode(); 
     pair->score = score;
     pair->len = len;
     memcpy(&pair->name, name, len);
@@ -17,5 +17,17 @@ SPair *spair_new(const char *name, uint32_t len, double score) {
 }
 
 void spair_del(SPair *pair) {
-    free(pair);
+    SlabAllocator::shared().free(pair, sizeof(SPair) + pair->len);
+}
+
+int32_t compare_score_and_name(double score1, const char *name1, uint32_t len1, double score2, const char *name2, 
+                               uint32_t len2) {
+    if (score1 != score2) {
+        return score1 < score2 ? -1 : 1;
+    }
+    int res = memcmp(name1, name2, std::min(len1, len2));
+    if (res != 0) {
+        return res;
+    }
+    return len1 == len2 ? 0 : (len1 < len2 ? -1 : 1);
 }
@@ -3,12 +3,10 @@
 #include <cstdint>
 
 #include "../../hashmap/components/HNode.hpp"
-#include "../../avl-tree/components/AVLNode.hpp"
 
 /* Pair stored in a SortedSet */
 struct SPair {
     HNode map_node;
-    AVLNode tree_node;
 
     double score = 0;
     uint32_t len = 0;
@@ -16,10 +14,11 @@ struct SPair {
 };
 
 /**
- * Simplified version of SPair to use for look-ups in the AVLTree.
+ * Score and name of a pair returned by SortedSet queries, whichever encoding the pair is stored in. 
+ * 
+ * The name points into the SortedSet, so it is only valid until the SortedSet is next modified.
  */
-struct AVLLookupPair {
-    AVLNode node;
+struct SPairView {
     double score = 0;
     const char *name = NULL;
     uint32_t len = 0;
@@ -37,7 +36,8 @@ struct HLookupPair {
 /**
  * Dynamically allocates an SPair.
  * 
- * Can't use "new" because SPair contains a flexible array which C++ does not know how to allocate. 
+ * Can't use "new" because SPair contains a flexible array which C++ does not know how to allocate. Pairs are allocated 
+ * from the shared SlabAllocator.
  * 
  * @param name  Byte array that store the name.
  * @param len   Length of the name.
@@ -53,3 +53,20 @@ SPair *spair_new(const char *name, uint32_t len, double score);
  * @param pair  Pointer to the SPair to delete.
  */
 void spair_del(SPair *pair);
+
+/**
+ * Compares two (score, name) pairs, ordering by score and then by name.
+ * 
+ * @param score1    The score of the first pair.
+ * @param name1     Byte array that stores the name of the first pair.
+ * @param len1      Length of the first name.
+ * @param score2    The score of the second pair.
+ * @param name2     Byte array that stores the name of the second pair.
+ * @param len2      Length of the second name.
+ * 
+ * @return  < 0 if first pair < second pair
+ *          > 0 if first pair > second pair
+ *          0 if the two are equal
+ */
+int32_t compare_score_and_name(double score1, const char *name1, uint32_t len1, double score2, const char *name2, 
+                               uint32_t len2);
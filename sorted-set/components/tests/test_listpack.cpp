@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <string>
+
+#include "../Listpack.hpp"
+
+/**
+ * Callback which appends a pair's name to a string.
+ *
+ * @param pair  The pair.
+ * @param arg   Void pointer to the string.
+ */
+void append_name(const SPairView &pair, void *arg) {
+    ((std::string *) arg)->append(pair.name, pair.len);
+}
+
+/* Returns the names of the pairs in the Listpack, in order */
+std::string names(Listpack &listpack) {
+    std::string result;
+    listpack.for_each(append_name, &result);
+    return result;
+}
+
+void test_insert_keeps_order() {
+    Listpack listpack;
+
+    assert(listpack.insert(2, "c", 1) == true);
+    assert(listpack.insert(1, "b", 1) == true);
+    assert(listpack.insert(2, "a", 1) == true);
+    assert(listpack.insert(0, "d", 1) == true);
+
+    assert(listpack.length() == 4);
+    assert(names(listpack) == "dbac");
+}
+
+void test_insert_existing_pair_updates_score() {
+    Listpack listpack;
+    listpack.insert(1, "a", 1);
+    listpack.insert(2, "b", 1);
+
+    assert(listpack.insert(3, "a", 1) == false);
+
+    double score;
+    assert(listpack.lookup("a", 1, &score) == true);
+    assert(score == 3);
+    assert(listpack.length() == 2);
+    assert(names(listpack) == "ba");
+}
+
+void test_lookup_names_differing_in_length() {
+    Listpack listpack;
+    listpack.insert(1, "ab", 2);
+
+    assert(listpack.lookup("a", 1) == false);
+    assert(listpack.lookup("abc", 3) == false);
+    assert(listpack.lookup("ab", 2) == true);
+}
+
+void test_remove() {
+    Listpack listpack;
+    listpack.insert(1, "a", 1);
+    listpack.insert(2, "b", 1);
+    listpack.insert(3, "c", 1);
+
+    assert(listpack.remove("b", 1) == true);
+    assert(listpack.remove("b", 1) == false);
+
+    assert(listpack.length() == 2);
+    assert(names(listpack) == "ac");
+    assert(listpack.rank("c", 1) == 1);
+}
+
+void test_remove_last_pair_frees_buffer() {
+    Listpack listpack;
+    listpack.insert(1, "a", 1);
+    assert(listpack.memory_usage() > 0);
+
+    listpack.remove("a", 1);
+
+    assert(listpack.memory_usage() == 0);
+}
+
+void test_find_all_ge_with_negative_offset() {
+    Listpack listpack;
+    listpack.insert(1, "a", 1);
+    listpack.insert(2, "b", 1);
+    listpack.insert(3, "c", 1);
+
+    std::vector<SPairView> results = listpack.find_all_ge(2, "b", 1, -1, 2);
+    assert(results.size() == 2);
+    assert(results[0].score == 1);
+    assert(results[1].score == 2);
+
+    results = listpack.find_all_ge(2, "b", 1, -2, 0);
+    assert(results.size() == 0);
+}
+
+void test_range() {
+    Listpack listpack;
+    listpack.insert(1, "a", 1);
+    listpack.insert(2, "b", 1);
+    listpack.insert(3, "c", 1);
+
+    std::vector<SPairView> results = listpack.range(1, 2);
+    assert(results.size() == 2);
+    assert(results[0].score == 2);
+    assert(results[1].score == 3);
+
+    results = listpack.range(0, 0);
+    assert(results.size() == 1);
+    assert(results[0].score == 1);
+}
+
+void test_remove_range() {
+    Listpack listpack;
+    listpack.insert(1, "a", 1);
+    listpack.insert(2, "bb", 2);
+    listpack.insert(3, "ccc", 3);
+    listpack.insert(4, "d", 1);
+
+    listpack.remove_range(1, 2);
+    assert(listpack.length() == 2);
+    assert(listpack.rank("a", 1) == 0);
+    assert(listpack.rank("d", 1) == 1);
+    assert(listpack.lookup("bb", 2) == false);
+
+    listpack.remove_range(0, 1);
+    assert(listpack.length() == 0);
+    assert(listpack.memory_usage() == 0);
+}
+
+void test_count_below() {
+    Listpack listpack;
+    listpack.insert(1, "a", 1);
+    listpack.insert(2, "b", 1);
+    listpack.insert(2, "c", 1);
+
+    assert(listpack.count_below(0, true) == 0);
+    assert(listpack.count_below(2, false) == 1);
+    assert(listpack.count_below(2, true) == 3);
+    assert(listpack.count_below(5, false) == 3);
+}
+
+void test_count_below_pair() {
+    Listpack listpack;
+    listpack.insert(1, "a", 1);
+    listpack.insert(2, "b", 1);
+    listpack.insert(2, "c", 1);
+
+    assert(listpack.count_below(2, "", 0) == 1);
+    assert(listpack.count_below(2, "b", 1) == 1);
+    assert(listpack.count_below(2, "bb", 2) == 2);
+    assert(listpack.count_below(2, "d", 1) == 3);
+}
+
+void test_grows_past_largest_size_class() {
+    Listpack listpack;
+    std::string name(Listpack::MAX_NAME_LEN, 'a');
+    for (uint32_t i = 0; i < 64; i++) {
+        name[0] = 'a' + i % 26;
+        name[1] = 'a' + i / 26;
+        listpack.insert(i, name.data(), name.length());
+    }
+
+    assert(listpack.length() == 64);
+    assert(listpack.memory_usage() >= 64 * (9 + Listpack::MAX_NAME_LEN));
+    assert(listpack.rank(name.data(), name.length()) == 63);
+}
+
+void test_swap() {
+    Listpack listpack1;
+    Listpack listpack2;
+    listpack1.insert(1, "a", 1);
+
+    listpack1.swap(listpack2);
+
+    assert(listpack1.length() == 0);
+    assert(listpack1.memory_usage() == 0);
+    assert(listpack2.lookup("a", 1) == true);
+}
+
+int main() {
+    test_insert_keeps_order();
+    test_insert_existing_pair_updates_score();
+
+    test_lookup_names_differing_in_length();
+
+    test_remove();
+    test_remove_last_pair_frees_buffer();
+
+    test_find_all_ge_with_negative_offset();
+    test_range();
+    test_count_below();
+    test_count_below_pair();
+    test_remove_range();
+
+    test_grows_past_largest_size_class();
+    test_swap();
+
+    return 0;
+}
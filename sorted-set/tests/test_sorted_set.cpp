@@ -1,7 +1,9 @@
 #include <assert.h>
 #include <cstring>
+#include <string>
 
 #include "../SortedSet.hpp"
+#include "../../slab-allocator/SlabAllocator.hpp"
 
 void test_insert_pair() {
     SortedSet set;
@@ -9,10 +11,9 @@ void test_insert_pair() {
 
     assert(set.length() == 1);
 
-    SPair *pair = set.lookup("tyler", 5);
-    assert(pair->len == 5);
-    assert(strncmp(pair->name, "tyler", pair->len) == 0);
-    assert(pair->score == 10);
+    double score;
+    assert(set.lookup("tyler", 5, &score) == true);
+    assert(score == 10);
 }
 
 void test_insert_existing_pair() {
@@ -22,25 +23,45 @@ void test_insert_existing_pair() {
 
     assert(set.length() == 1);
 
-    SPair *pair = set.lookup("tyler", 5);
-    assert(pair->len == 5);
-    assert(strncmp(pair->name, "tyler", pair->len) == 0);
-    assert(pair->score == 20);
+    double score;
+    assert(set.lookup("tyler", 5, &score) == true);
+    assert(score == 20);
+}
+
+void test_insert_all() {
+    SortedSet set;
+    // in order until the repeated name, which takes its last score
+    std::vector<SPairView> pairs = { { 1, "a", 1 }, { 2, "b", 1 }, { 3, "a", 1 }, { 0, "c", 1 } };
+    assert(set.insert_all(pairs) == 3);
+    assert(set.length() == 3);
+
+    double score;
+    assert(set.lookup("a", 1, &score) == true);
+    assert(score == 3);
+    assert(set.rank("c", 1) == 0);
+    assert(set.rank("b", 1) == 1);
+    assert(set.rank("a", 1) == 2);
+
+    // only new pairs are counted once the set isn't empty
+    pairs = { { 5, "b", 1 }, { 4, "d", 1 } };
+    assert(set.insert_all(pairs) == 1);
+    assert(set.length() == 4);
+    assert(set.rank("b", 1) == 3);
 }
 
 void test_lookup_on_empty_set() {
     SortedSet set;
 
-    SPair *pair = set.lookup("tyler", 5);
-    assert(pair == NULL);
+    bool found = set.lookup("tyler", 5);
+    assert(found == false);
 }
 
 void test_lookup_non_existent_pair() {
     SortedSet set;
     set.insert(0, "won", 3);
 
-    SPair *pair = set.lookup("tyler", 5);
-    assert(pair == NULL);
+    bool found = set.lookup("tyler", 5);
+    assert(found == false);
 }
 
 void test_lookup_pair() {
@@ -48,15 +69,14 @@ void test_lookup_pair() {
     set.insert(10, "tyler", 5);
     set.insert(0, "won", 3);
 
-    SPair *pair = set.lookup("tyler", 5);
-    assert(pair->len == 5);
-    assert(strncmp(pair->name, "tyler", pair->len) == 0);
-    assert(pair->score == 10);
+    double score;
+    assert(set.lookup("tyler", 5, &score) == true);
+    assert(score == 10);
 }
 
 void test_find_all_ge_on_empty_set() {
     SortedSet set;
-    std::vector<SPair *> results = set.find_all_ge(10, "tyler", 5);
+    std::vector<SPairView> results = set.find_all_ge(10, "tyler", 5);
     assert(results.size() == 0);
 }
 
@@ -65,7 +85,7 @@ void test_find_all_ge_no_pairs_with_higher_score() {
     set.insert(10, "tyler", 5);
     set.insert(0, "won", 3);
 
-    std::vector<SPair *> results = set.find_all_ge(11, "jeff", 4);
+    std::vector<SPairView> results = set.find_all_ge(11, "jeff", 4);
     assert(results.size() == 0);
 }
 
@@ -74,7 +94,7 @@ void test_find_all_ge_no_pairs_with_higher_name() {
     set.insert(10, "tyler", 5);
     set.insert(10, "won", 3);
 
-    std::vector<SPair *> results = set.find_all_ge(10, "zed", 3);
+    std::vector<SPairView> results = set.find_all_ge(10, "zed", 3);
     assert(results.size() == 0);
 }
 
@@ -84,12 +104,12 @@ void test_find_all_ge_pairs_with_higher_score_found() {
     set.insert(10, "tyler", 5);
     set.insert(0, "won", 3);
 
-    std::vector<SPair *> results = set.find_all_ge(5, "adam", 4);
+    std::vector<SPairView> results = set.find_all_ge(5, "adam", 4);
     assert(results.size() == 2);
-    assert(results[0]->score == 10);
-    assert(strncmp(results[0]->name, "tyler", results[0]->len) == 0);
-    assert(results[1]->score == 11);
-    assert(strncmp(results[1]->name, "jeff", results[1]->len) == 0);
+    assert(results[0].score == 10);
+    assert(strncmp(results[0].name, "tyler", results[0].len) == 0);
+    assert(results[1].score == 11);
+    assert(strncmp(results[1].name, "jeff", results[1].len) == 0);
 }
 
 void test_find_all_ge_pairs_with_higher_name_found() {
@@ -98,12 +118,12 @@ void test_find_all_ge_pairs_with_higher_name_found() {
     set.insert(10, "tyler", 5);
     set.insert(10, "adam", 4);
 
-    std::vector<SPair *> results = set.find_all_ge(10, "mark", 4);
+    std::vector<SPairView> results = set.find_all_ge(10, "mark", 4);
     assert(results.size() == 2);
-    assert(results[0]->score == 10);
-    assert(strncmp(results[0]->name, "tyler", results[0]->len) == 0);
-    assert(results[1]->score == 10);
-    assert(strncmp(results[1]->name, "zed", results[1]->len) == 0);
+    assert(results[0].score == 10);
+    assert(strncmp(results[0].name, "tyler", results[0].len) == 0);
+    assert(results[1].score == 10);
+    assert(strncmp(results[1].name, "zed", results[1].len) == 0);
 }
 
 void test_find_all_ge_given_pair_in_set() {
@@ -112,12 +132,12 @@ void test_find_all_ge_given_pair_in_set() {
     set.insert(10, "tyler", 5);
     set.insert(0, "won", 3);
 
-    std::vector<SPair *> results = set.find_all_ge(10, "tyler", 5);
+    std::vector<SPairView> results = set.find_all_ge(10, "tyler", 5);
     assert(results.size() == 2);
-    assert(results[0]->score == 10);
-    assert(strncmp(results[0]->name, "tyler", results[0]->len) == 0);
-    assert(results[1]->score == 11);
-    assert(strncmp(results[1]->name, "jeff", results[1]->len) == 0);
+    assert(results[0].score == 10);
+    assert(strncmp(results[0].name, "tyler", results[0].len) == 0);
+    assert(results[1].score == 11);
+    assert(strncmp(results[1].name, "jeff", results[1].len) == 0);
 }
 
 void test_find_all_ge_with_offset() {
@@ -126,10 +146,10 @@ void test_find_all_ge_with_offset() {
     set.insert(10, "tyler", 5);
     set.insert(0, "won", 3);
 
-    std::vector<SPair *> results = set.find_all_ge(5, "adam", 4, 1);
+    std::vector<SPairView> results = set.find_all_ge(5, "adam", 4, 1);
     assert(results.size() == 1);
-    assert(results[0]->score == 11);
-    assert(strncmp(results[0]->name, "jeff", results[0]->len) == 0);
+    assert(results[0].score == 11);
+    assert(strncmp(results[0].name, "jeff", results[0].len) == 0);
 }
 
 void test_find_all_ge_offset_skips_all_results() {
@@ -138,7 +158,7 @@ void test_find_all_ge_offset_skips_all_results() {
     set.insert(10, "tyler", 5);
     set.insert(0, "won", 3);
 
-    std::vector<SPair *> results = set.find_all_ge(10, "tyler", 5, 2);
+    std::vector<SPairView> results = set.find_all_ge(10, "tyler", 5, 2);
     assert(results.size() == 0);
 }
 
@@ -148,10 +168,10 @@ void test_find_all_ge_under_limit() {
     set.insert(10, "tyler", 5);
     set.insert(0, "won", 3);
 
-    std::vector<SPair *> results = set.find_all_ge(10, "zed", 3, 0, 2);
+    std::vector<SPairView> results = set.find_all_ge(10, "zed", 3, 0, 2);
     assert(results.size() == 1);
-    assert(results[0]->score == 11);
-    assert(strncmp(results[0]->name, "jeff", results[0]->len) == 0);
+    assert(results[0].score == 11);
+    assert(strncmp(results[0].name, "jeff", results[0].len) == 0);
 }
 
 void test_find_all_ge_hit_limit() {
@@ -160,12 +180,12 @@ void test_find_all_ge_hit_limit() {
     set.insert(10, "tyler", 5);
     set.insert(0, "won", 3);
 
-    std::vector<SPair *> results = set.find_all_ge(0, "adam", 4, 0, 2);
+    std::vector<SPairView> results = set.find_all_ge(0, "adam", 4, 0, 2);
     assert(results.size() == 2);
-    assert(results[0]->score == 0);
-    assert(strncmp(results[0]->name, "won", results[0]->len) == 0);
-    assert(results[1]->score == 10);
-    assert(strncmp(results[1]->name, "tyler", results[1]->len) == 0);
+    assert(results[0].score == 0);
+    assert(strncmp(results[0].name, "won", results[0].len) == 0);
+    assert(results[1].score == 10);
+    assert(strncmp(results[1].name, "tyler", results[1].len) == 0);
 }
 
 void test_remove_non_existent_pair() {
@@ -233,9 +253,508 @@ void test_rank_highest_pair() {
     assert(rank == 2);
 }
 
-int main() {
+void test_rank_reverse() {
+    SortedSet set;
+    set.insert(10, "tyler", 5);
+    set.insert(0, "won", 3);
+    set.insert(-4, "lucy", 4);
+
+    assert(set.rank("tyler", 5, true) == 0);
+    assert(set.rank("won", 3, true) == 1);
+    assert(set.rank("lucy", 4, true) == 2);
+    assert(set.rank("jim", 3, true) == -1);
+}
+
+/* Creates a SortedSet with the pairs (1, a), (2, b), (2, c), (3, d), (4, e) */
+void fill_set(SortedSet &set) {
+    set.insert(3, "d", 1);
+    set.insert(1, "a", 1);
+    set.insert(4, "e", 1);
+    set.insert(2, "c", 1);
+    set.insert(2, "b", 1);
+}
+
+/* Returns the names of the pairs concatenated together */
+std::string names_of(const std::vector<SPairView> &pairs) {
+    std::string names;
+    for (const SPairView &pair : pairs) {
+        names.append(pair.name, pair.len);
+    }
+    return names;
+}
+
+void test_range_by_rank() {
+    SortedSet set;
+    fill_set(set);
+
+    assert(names_of(set.range_by_rank(0, -1)) == "abcde");
+    assert(names_of(set.range_by_rank(1, 2)) == "bc");
+    assert(names_of(set.range_by_rank(-2, -1)) == "de");
+    assert(names_of(set.range_by_rank(-100, 100)) == "abcde");
+    assert(set.range_by_rank(3, 1).empty());
+    assert(set.range_by_rank(5, 10).empty());
+
+    std::vector<SPairView> pairs = set.range_by_rank(0, 0);
+    assert(pairs.size() == 1);
+    assert(pairs[0].score == 1);
+}
+
+void test_range_by_rank_reverse() {
+    SortedSet set;
+    fill_set(set);
+
+    assert(names_of(set.range_by_rank(0, -1, true)) == "edcba");
+    assert(names_of(set.range_by_rank(1, 2, true)) == "dc");
+    assert(names_of(set.range_by_rank(-1, -1, true)) == "a");
+}
+
+void test_range_by_rank_on_empty_set() {
+    SortedSet set;
+
+    assert(set.range_by_rank(0, -1).empty());
+    assert(set.range_by_rank(0, -1, true).empty());
+}
+
+void test_range_by_score() {
+    SortedSet set;
+    fill_set(set);
+
+    ScoreRange range;
+    assert(names_of(set.range_by_score(range)) == "abcde");
+
+    range.min = 2;
+    range.max = 3;
+    assert(names_of(set.range_by_score(range)) == "bcd");
+
+    range.min_exclusive = true;
+    assert(names_of(set.range_by_score(range)) == "d");
+
+    range.min_exclusive = false;
+    range.max_exclusive = true;
+    assert(names_of(set.range_by_score(range)) == "bc");
+
+    range.min = 2.5;
+    range.max = 2.75;
+    assert(set.range_by_score(range).empty());
+
+    range.min = 5;
+    range.max = 1;
+    assert(set.range_by_score(range).empty());
+}
+
+void test_range_by_score_reverse() {
+    SortedSet set;
+    fill_set(set);
+
+    ScoreRange range;
+    range.min = 2;
+    range.max = 4;
+    range.max_exclusive = true;
+    assert(names_of(set.range_by_score(range, true)) == "dcb");
+}
+
+void test_range_by_score_with_limit() {
+    SortedSet set;
+    fill_set(set);
+
+    ScoreRange range;
+    assert(names_of(set.range_by_score(range, false, 1, 2)) == "bc");
+    assert(names_of(set.range_by_score(range, false, 3, 10)) == "de");
+    assert(names_of(set.range_by_score(range, false, 3, -1)) == "de");
+    assert(names_of(set.range_by_score(range, true, 1, 2)) == "dc");
+    assert(set.range_by_score(range, false, 5, 1).empty());
+    assert(set.range_by_score(range, false, 0, 0).empty());
+}
+
+void test_count() {
+    SortedSet set;
+    assert(set.count(ScoreRange()) == 0);
+
+    fill_set(set);
+
+    ScoreRange range;
+    assert(set.count(range) == 5);
+
+    range.min = 2;
+    range.max = 2;
+    assert(set.count(range) == 2);
+
+    range.min_exclusive = true;
+    assert(set.count(range) == 0);
+
+    range.min = 1;
+    range.max = 4;
+    range.max_exclusive = true;
+    assert(set.count(range) == 3);
+
+    range.min = 4;
+    range.max = 1;
+    assert(set.count(range) == 0);
+}
+
+/* Fills a set with names that all have the same score, as used by the by-lex commands */
+void fill_lex_set(SortedSet &set) {
+    const char *names[] = { "d", "apple", "b", "e", "app", "c", "a" };
+    for (const char *name : names) {
+        set.insert(0, name, strlen(name));
+    }
+}
+
+/* Returns a LexRange from "[", "(", "-", or "+" bounds */
+LexRange lex_range(const std::string &min, const std::string &max) {
+    LexRange range;
+    for (auto [arg, bound] : { std::make_pair(min, &range.min), std::make_pair(max, &range.max) }) {
+        if (arg == "-" || arg == "+") {
+            bound->infinity = arg == "-" ? -1 : 1;
+        } else {
+            bound->name = arg.substr(1);
+            bound->exclusive = arg[0] == '(';
+            bound->infinity = 0;
+        }
+    }
+    return range;
+}
+
+void test_range_by_lex() {
+    SortedSet set;
+    assert(set.range_by_lex(LexRange()).empty());
+
+    fill_lex_set(set);
+
+    assert(names_of(set.range_by_lex(LexRange())) == "aappapplebcde");
+    assert(names_of(set.range_by_lex(lex_range("[app", "[b"))) == "appappleb");
+    assert(names_of(set.range_by_lex(lex_range("(app", "(b"))) == "apple");
+    assert(names_of(set.range_by_lex(lex_range("-", "(b"))) == "aappapple");
+    assert(names_of(set.range_by_lex(lex_range("[c", "+"))) == "cde");
+    assert(names_of(set.range_by_lex(lex_range("[bb", "[cc"))) == "c");
+    assert(set.range_by_lex(lex_range("[c", "[b")).empty());
+    assert(set.range_by_lex(lex_range("+", "-")).empty());
+}
+
+void test_range_by_lex_reverse_with_limit() {
+    SortedSet set;
+    fill_lex_set(set);
+
+    assert(names_of(set.range_by_lex(lex_range("[app", "+"), true)) == "edcbappleapp");
+    assert(names_of(set.range_by_lex(lex_range("[app", "+"), true, 1, 2)) == "dc");
+    assert(names_of(set.range_by_lex(lex_range("[app", "+"), false, 1, 2)) == "appleb");
+    assert(set.range_by_lex(lex_range("[app", "+"), false, 10).empty());
+}
+
+void test_count_by_lex() {
+    SortedSet set;
+    assert(set.count(LexRange()) == 0);
+
+    fill_lex_set(set);
+
+    assert(set.count(LexRange()) == 7);
+    assert(set.count(lex_range("[a", "(b")) == 3);
+    assert(set.count(lex_range("(e", "+")) == 0);
+}
+
+/* Frees the pairs removed by a range removal, if there are any */
+void free_removed(BPlusTree *removed) {
+    if (removed != NULL) {
+        SortedSet::free_pairs(removed);
+    }
+}
+
+void test_remove_range_by_lex() {
+    SortedSet set;
+    fill_lex_set(set);
+
+    BPlusTree *removed;
+    assert(set.remove_range_by_lex(lex_range("[app", "[apple"), &removed) == 2);
+    free_removed(removed);
+    assert(names_of(set.range_by_lex(LexRange())) == "abcde");
+
+    assert(set.remove_range_by_lex(lex_range("(e", "+"), &removed) == 0);
+    assert(removed == NULL);
+    assert(set.length() == 5);
+}
+
+void test_remove_range_by_rank() {
+    SortedSet set;
+    fill_set(set);
+
+    BPlusTree *removed;
+    assert(set.remove_range_by_rank(1, 2, &removed) == 2);
+    free_removed(removed);
+    assert(names_of(set.range_by_rank(0, -1)) == "ade");
+    assert(set.lookup("b", 1) == false);
+    assert(set.lookup("c", 1) == false);
+
+    assert(set.remove_range_by_rank(-1, 10, &removed) == 1);
+    free_removed(removed);
+    assert(names_of(set.range_by_rank(0, -1)) == "ad");
+
+    assert(set.remove_range_by_rank(2, 3, &removed) == 0);
+    assert(removed == NULL);
+    assert(set.length() == 2);
+}
+
+void test_remove_range_by_score() {
+    SortedSet set;
+    fill_set(set);
+
+    ScoreRange range;
+    range.min = 2;
+    range.max = 3;
+    range.max_exclusive = true;
+
+    BPlusTree *removed;
+    assert(set.remove_range_by_score(range, &removed) == 2);
+    free_removed(removed);
+    assert(names_of(set.range_by_rank(0, -1)) == "ade");
+    assert(set.rank("d", 1) == 1);
+
+    assert(set.remove_range_by_score(range, &removed) == 0);
+    assert(removed == NULL);
+
+    assert(set.remove_range_by_score(ScoreRange(), &removed) == 3);
+    free_removed(removed);
+    assert(set.length() == 0);
+}
+
+void test_memory_usage_packed() {
+    SortedSet set;
+    assert(set.memory_usage() == 0);
+
+    // 9-byte header (score and name length) per pair, rounded up to the slab size class
+    set.insert(10, "tyler", 5);
+    set.insert(0, "won", 3);
+    assert(set.memory_usage() == SlabAllocator::class_size(2 * 9 + 8));
+
+    set.remove("tyler", 5);
+    set.remove("won", 3);
+    assert(set.memory_usage() == 0);
+}
+
+void test_memory_usage_indexed() {
+    SortedSet set;
+    set.insert(10, "tyler", 5);
+    set.insert(0, "won", 3);
+    SortedSet::max_listpack_entries = 0;
+    set.insert(5, "jeff", 4);
+    SortedSet::max_listpack_entries = SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES;
+
+    uint64_t usage = set.memory_usage();
+    assert(usage > 3 * sizeof(SPair) + 12);
+
+    set.insert(20, "tyler", 5);
+    assert(set.memory_usage() == usage);
+
+    set.remove("tyler", 5);
+    assert(set.memory_usage() == usage - sizeof(SPair) - 5);
+}
+
+void test_converts_past_max_entries() {
+    SortedSet set;
+    for (uint32_t i = 0; i < SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES; i++) {
+        std::string name = "name" + std::to_string(i);
+        set.insert(-(double) i, name.data(), name.length());
+    }
+    assert(set.is_packed() == true);
+
+    set.insert(1, "last", 4);
+    assert(set.is_packed() == false);
+    assert(set.length() == SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES + 1);
+
+    // pairs keep their order across the conversion
+    std::vector<SPairView> results = set.find_all_ge(-1e9, "", 0);
+    assert(results.size() == set.length());
+    for (uint32_t i = 0; i < SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES; i++) {
+        std::string name = "name" + std::to_string(SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES - 1 - i);
+        assert(std::string(results[i].name, results[i].len) == name);
+        assert(set.rank(name.data(), name.length()) == i);
+    }
+    assert(set.rank("last", 4) == SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES);
+
+    // stays indexed once it shrinks again
+    set.remove("last", 4);
+    assert(set.is_packed() == false);
+}
+
+void test_converts_past_max_value() {
+    SortedSet set;
+    set.insert(1, "tyler", 5);
+    std::string long_name(SortedSet::DEFAULT_MAX_LISTPACK_VALUE, 'a');
+    set.insert(2, long_name.data(), long_name.length());
+    assert(set.is_packed() == true);
+
+    long_name.push_back('a');
+    set.insert(3, long_name.data(), long_name.length());
+
+    assert(set.is_packed() == false);
+    assert(set.length() == 3);
+    assert(set.rank(long_name.data(), long_name.length()) == 2);
+    assert(set.rank("tyler", 5) == 0);
+}
+
+void test_insert_all_builds_from_sorted_input() {
+    // sorted input with one pair out of order near the end
+    std::vector<std::string> names;
+    std::vector<SPairView> pairs;
+    for (uint32_t i = 0; i < 1000; i++) {
+        names.push_back("name" + std::to_string(i));
+    }
+    for (uint32_t i = 0; i < 1000; i++) {
+        pairs.push_back({ i == 990 ? -1.0 : i, names[i].data(), (uint32_t) names[i].length() });
+    }
+
+    SortedSet set;
+    assert(set.insert_all(pairs) == 1000);
+    assert(set.is_packed() == false);
+    assert(set.length() == 1000);
+    assert(set.rank("name990", 7) == 0);
+    assert(set.rank("name0", 5) == 1);
+    assert(set.rank("name999", 7) == 999);
+
+    std::vector<SPairView> results = set.range_by_rank(0, -1);
+    for (uint32_t i = 1; i < results.size(); i++) {
+        assert(results[i - 1].score <= results[i].score);
+    }
+
+    // a set that isn't empty takes the pairs one at a time
+    assert(set.insert_all(pairs) == 0);
+    assert(set.length() == 1000);
+
+    // a small input stays packed
+    SortedSet small;
+    pairs.resize(SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES);
+    assert(small.insert_all(pairs) == SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES);
+    assert(small.is_packed() == true);
+}
+
+void test_update_keeps_order_with_fractional_scores() {
+    SortedSet set;
+    set.insert(1.5, "a", 1);
+    set.insert(1.25, "b", 1);
+    set.insert(1.75, "c", 1);
+
+    assert(set.rank("b", 1) == 0);
+    assert(set.rank("a", 1) == 1);
+    assert(set.rank("c", 1) == 2);
+
+    set.insert(1.9, "a", 1);
+    assert(set.rank("a", 1) == 2);
+}
+
+/* Callback which appends a pair to a vector of strings as "<name>:<score>" */
+void collect_pair(const SPairView &pair, void *arg) {
+    std::vector<std::string> *out = (std::vector<std::string> *) arg;
+    out->push_back(std::string(pair.name, pair.len) + ":" + std::to_string((int) pair.score));
+}
+
+void test_snapshot_unchanged_by_writes() {
+    SortedSet set;
+    set.insert(2, "b", 1);
+    set.insert(1, "a", 1);
+    set.insert(3, "c", 1);
+
+    SortedSet::Snapshot *snapshot = set.snapshot();
+    set.insert(0, "d", 1);
+    set.insert(5, "a", 1);
+    set.remove("b", 1);
+    BPlusTree *removed;
+    set.remove_range_by_rank(0, 0, &removed);
+    free_removed(removed);
+
+    assert(snapshot->length() == 3);
+    std::vector<std::string> pairs;
+    snapshot->for_each(collect_pair, &pairs);
+    assert((pairs == std::vector<std::string>{ "a:1", "b:2", "c:3" }));
+
+    // the set has its own copy once it's written to
+    double score;
+    assert(set.lookup("a", 1, &score) == true && score == 5);
+    assert(set.lookup("b", 1, &score) == false);
+    assert(set.length() == 2);
+
+    delete snapshot;
+}
+
+void test_snapshot_outlives_set() {
+    SortedSet *set = new SortedSet();
+    set->insert(1, "a", 1);
+    set->insert(2, "b", 1);
+
+    SortedSet::Snapshot *snapshot = set->snapshot();
+    delete set;
+
+    std::vector<std::string> pairs;
+    snapshot->for_each(collect_pair, &pairs);
+    assert((pairs == std::vector<std::string>{ "a:1", "b:2" }));
+
+    delete snapshot;
+}
+
+void test_swap() {
+    SortedSet set1;
+    SortedSet set2;
+    set1.insert(10, "tyler", 5);
+
+    set1.swap(set2);
+
+    assert(set1.length() == 0);
+    assert(set1.memory_usage() == 0);
+    assert(set2.length() == 1);
+    assert(set2.lookup("tyler", 5) == true);
+}
+
+void test_defrag_keeps_pairs_intact() {
+    // interleave two sets then delete one so the other's pairs are left in half empty slabs
+    SortedSet set;
+    SortedSet *other = new SortedSet();
+    for (uint32_t i = 0; i < 2000; i++) {
+        std::string name = "name" + std::to_string(i);
+        set.insert(i, name.data(), name.length());
+        other->insert(i, name.data(), name.length());
+    }
+    delete other;
+
+    // thin out the first half so its slabs are emptier than the rest
+    for (uint32_t i = 0; i < 1000; i++) {
+        if (i % 4 != 0) {
+            std::string name = "name" + std::to_string(i);
+            set.remove(name.data(), name.length());
+        }
+    }
+
+    uint64_t moved = 0;
+    uint64_t cursor = 0;
+    do {
+        cursor = set.defrag(cursor, &moved);
+    } while (cursor != 0);
+
+    assert(moved > 0);
+    assert(set.length() == 1250);
+    for (uint32_t i = 0; i < 2000; i++) {
+        std::string name = "name" + std::to_string(i);
+        double score = -1;
+        bool found = set.lookup(name.data(), name.length(), &score);
+        if (i < 1000 && i % 4 != 0) {
+            assert(found == false);
+        } else {
+            assert(found == true && score == i);
+        }
+    }
+
+    // ranks come from the subtree sizes, so they only hold if the moved nodes were relinked correctly
+    int64_t rank = 0;
+    for (uint32_t i = 0; i < 2000; i++) {
+        if (i >= 1000 || i % 4 == 0) {
+            std::string name = "name" + std::to_string(i);
+            assert(set.rank(name.data(), name.length()) == rank++);
+        }
+    }
+}
+
+/* Runs the tests that apply to both encodings */
+void run_encoding_tests() {
     test_insert_pair();
     test_insert_existing_pair();
+    test_insert_all();
 
     test_lookup_on_empty_set();
     test_lookup_non_existent_pair();
@@ -260,6 +779,45 @@ int main() {
     test_rank_lowest_pair();
     test_rank_middle_pair();
     test_rank_highest_pair();
+    test_rank_reverse();
+
+    test_range_by_rank();
+    test_range_by_rank_reverse();
+    test_range_by_rank_on_empty_set();
+    test_range_by_score();
+    test_range_by_score_reverse();
+    test_range_by_score_with_limit();
+    test_count();
+
+    test_remove_range_by_rank();
+    test_remove_range_by_score();
+
+    test_range_by_lex();
+    test_range_by_lex_reverse_with_limit();
+    test_count_by_lex();
+    test_remove_range_by_lex();
+
+    test_update_keeps_order_with_fractional_scores();
+    test_swap();
+
+    test_snapshot_unchanged_by_writes();
+    test_snapshot_outlives_set();
+}
+
+int main() {
+    run_encoding_tests();
+
+    // run again with every SortedSet converted to the indexed encoding on its first insert
+    SortedSet::max_listpack_entries = 0;
+    run_encoding_tests();
+    SortedSet::max_listpack_entries = SortedSet::DEFAULT_MAX_LISTPACK_ENTRIES;
+
+    test_memory_usage_packed();
+    test_memory_usage_indexed();
+    test_converts_past_max_entries();
+    test_converts_past_max_value();
+    test_insert_all_builds_from_sorted_input();
+    test_defrag_keeps_pairs_intact();
 
     return 0;
 }
@@ -3,7 +3,7 @@
 
 void IdleTimer::set_expiry(TimerManager *timers) {
     time_t old_expiry_time = expiry_time_ms;
-    expiry_time_ms = get_time_ms() + IDLE_TIMEOUT_MS;
+    expiry_time_ms = get_cached_time_ms() + IDLE_TIMEOUT_MS;
     if (old_expiry_time == UNSET) {
         timers->add(this);
     } else {
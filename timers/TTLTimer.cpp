@@ -1,10 +1,13 @@
 #include "TTLTimer.hpp"
-#include "../utils/intrusive_data_structure_utils.hpp"
 #include "../utils/time_utils.hpp"
 
 void TTLTimer::set_expiry(time_t seconds, TimerManager *timers) {
-    time_t old_expiry_time = expiry_time_ms;
-    expiry_time_ms = get_time_ms() + seconds * 1000;
+    set_expiry_at(get_cached_time_ms() + seconds * 1000, timers);
+}
+
+void TTLTimer::set_expiry_at(time_t expiry_time_ms, TimerManager *timers) {
+    time_t old_expiry_time = this->expiry_time_ms;
+    this->expiry_time_ms = expiry_time_ms;
     if (old_expiry_time == UNSET) {
         timers->add(this);
     } else {
@@ -24,8 +27,6 @@ bool TTLTimer::is_expiry_set() {
     return expiry_time_ms != UNSET;
 }
 
-bool is_ttl_timer_less(MHNode *node1, MHNode *node2) {
-    TTLTimer *timer1 = container_of(node1, TTLTimer, node);
-    TTLTimer *timer2 = container_of(node2, TTLTimer, node);
-    return timer1->expiry_time_ms < timer2->expiry_time_ms;
+bool TTLTimer::is_expired(time_t now_ms) {
+    return is_expiry_set() && expiry_time_ms <= now_ms;
 }
@@ -3,7 +3,7 @@
 #include <ctime>
 
 #include "TimerManager.hpp"
-#include "../min-heap/MinHeap.hpp"
+#include "../timing-wheel/TimingWheel.hpp"
 
 /**
  * A timer to track the TTL (time-to-live) of an entry in the kv store. 
@@ -15,7 +15,7 @@ class TTLTimer {
         static const int8_t UNSET = -1;
 
         time_t expiry_time_ms = UNSET;
-        MHNode node;
+        TWNode node;
 
         /** 
          * Sets the expiry of the timer and adds it to the timer manager. If the timer is already managed by the timer 
@@ -26,6 +26,15 @@ class TTLTimer {
          */
         void set_expiry(time_t seconds, TimerManager *timers);
 
+        /** 
+         * Sets the expiry of the timer to an absolute monotonic time and adds it to the timer manager. If the timer is 
+         * already managed by the timer manager, tells the manager that the timer's expiry has been updated.
+         * 
+         * @param expiry_time_ms    The monotonic time in ms the timer expires at.
+         * @param timers            Pointer to the timer manager.
+         */
+        void set_expiry_at(time_t expiry_time_ms, TimerManager *timers);
+
         /**
          * Clears the expiry of the timer and removes it from the timer manager. Only does this if the expiry is set.
          * 
@@ -35,15 +44,7 @@ class TTLTimer {
 
         /* Checks if the timer's expiry is set */
         bool is_expiry_set();
-};
 
-/**
- * Callback which checks if one TTLTimer is less than another in a MinHeap.
- * 
- * @param node1 The MHNode contained by the first TTLTimer.
- * @param node2 The MHNode contained by the second TTLTimer.
- * 
- * @return  True if the first TTLTimer is less than the second TTLTimer.
- *          False otherwise.
- */
-bool is_ttl_timer_less(MHNode *node1, MHNode *node2);
+        /* Checks if the timer's expiry is set and has been reached by the given time */
+        bool is_expired(time_t now_ms);
+};
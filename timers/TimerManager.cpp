@@ -1,15 +1,18 @@
 #include "IdleTimer.hpp"
 #include "TimerManager.hpp"
 #include "TTLTimer.hpp"
+#include "../aof/Aof.hpp"
 #include "../conn/Conn.hpp"
+#include "../conn/components/ConnPool.hpp"
 #include "../entry/Entry.hpp"
+#include "../replication/Replication.hpp"
 #include "../utils/intrusive_data_structure_utils.hpp"
 #include "../utils/log.hpp"
 #include "../utils/time_utils.hpp"
 
 int32_t TimerManager::get_time_until_expiry() {
     time_t next_expiry_ms = -1;
-    time_t now_ms = get_time_ms();
+    time_t now_ms = get_cached_time_ms();
 
     if (!idle_timers.is_empty()) {
         QNode *node = idle_timers.front();
@@ -17,12 +20,10 @@ int32_t TimerManager::get_time_until_expiry() {
         next_expiry_ms = timer->expiry_time_ms;
     }
 
-    if (!ttl_timers.is_empty()) {
-        MHNode *node = ttl_timers.min();
-        TTLTimer *timer = container_of(node, TTLTimer, node);
-        if (next_expiry_ms == -1 || timer->expiry_time_ms < next_expiry_ms) {
-            next_expiry_ms = timer->expiry_time_ms;
-        }
+    // replicas leave expiry to their primary, so their TTL timers never fire
+    int64_t next_ttl_expiry_ms = Replication::shared().is_replica() ? -1 : ttl_timers.next_expiry_ms();
+    if (next_ttl_expiry_ms != -1 && (next_expiry_ms == -1 || next_ttl_expiry_ms < next_expiry_ms)) {
+        next_expiry_ms = next_ttl_expiry_ms;
     }
 
     if (next_expiry_ms == -1) {
@@ -34,8 +35,8 @@ int32_t TimerManager::get_time_until_expiry() {
     return next_expiry_ms - now_ms;
 }
 
-void TimerManager::process_timers(HMap &kv_store, std::vector<Conn *> &fd_to_conn, ThreadPool &thread_pool) {
-    time_t now_ms = get_time_ms();
+void TimerManager::process_timers(HMap &kv_store, std::vector<Conn *> &fd_to_conn, ConnPool &conn_pool, ThreadPool &thread_pool) {
+    time_t now_ms = get_cached_time_ms();
     while (!idle_timers.is_empty()) {
         QNode *node = idle_timers.front();
         IdleTimer *timer = container_of(node, IdleTimer, node);
@@ -43,25 +44,68 @@ void TimerManager::process_timers(HMap &kv_store, std::vector<Conn *> &fd_to_con
             break;
         }
         Conn *conn = container_of(timer, Conn, idle_timer);
+        if (conn->is_subscribed()) {
+            timer->set_expiry(this); // a subscriber waits for messages, it's not idle
+            continue;
+        }
         log("connection %d exceeded idle timeout", conn->fd);
         conn->handle_close(fd_to_conn, this);
+        conn_pool.release(conn);
+    }
+
+    expire_entries(now_ms, kv_store, thread_pool);
+}
+
+void TimerManager::expire_entries(time_t now_ms, HMap &kv_store, ThreadPool &thread_pool) {
+    if (Replication::shared().is_replica()) {
+        return;
     }
 
-    uint32_t count = 0;
-    while (!ttl_timers.is_empty() && count < MAX_TTL_EXPIRATIONS) {
-        MHNode *node = ttl_timers.min();
+    time_t start_us = get_time_us();
+    time_t budget_us = EXPIRY_BUDGET_US * expiry_stats.effort;
+
+    uint64_t expired = 0;
+    bool timed_out = false;
+    TWNode *node;
+    while ((node = ttl_timers.pop_expired(now_ms)) != NULL) {
         TTLTimer *timer = container_of(node, TTLTimer, node);
-        if (timer->expiry_time_ms > now_ms) {
-            break;
-        }
         Entry *entry = container_of(timer, Entry, ttl_timer);
         log("key '%s' expired", entry->key.data());
+        Aof::shared().feed({ "del", entry->key });
+        Replication::shared().feed({ "del", entry->key });
         kv_store.remove(&entry->node, are_entries_equal);
         delete_entry(entry, this, &thread_pool);
-        count++;
+        expired++;
+
+        if (expired % EXPIRY_TIME_CHECK_INTERVAL == 0 && get_time_us() - start_us >= budget_us) {
+            timed_out = true;
+            break;
+        }
+    }
+
+    expiry_stats.cycle_expired = expired;
+    expiry_stats.cycle_us = get_time_us() - start_us;
+    expiry_stats.cycle_timed_out = timed_out;
+    expiry_stats.active_expired += expired;
+
+    if (timed_out) {
+        expiry_stats.timed_out_cycles++;
+        if (expiry_stats.effort < MAX_EXPIRY_EFFORT) {
+            expiry_stats.effort++;
+        }
+    } else if (expiry_stats.effort > 1) {
+        expiry_stats.effort--;
     }
 }
 
+void TimerManager::record_lazy_expiry() {
+    expiry_stats.lazy_expired++;
+}
+
+const ExpiryStats &TimerManager::get_expiry_stats() {
+    return expiry_stats;
+}
+
 void TimerManager::add(IdleTimer *timer) {
     idle_timers.push(&timer->node);
 }
@@ -76,13 +120,19 @@ void TimerManager::remove(IdleTimer *timer) {
 }
 
 void TimerManager::add(TTLTimer *timer) {
-    ttl_timers.insert(&timer->node, is_ttl_timer_less);
+    ttl_timers.insert(&timer->node, timer->expiry_time_ms);
 }
 
 void TimerManager::update(TTLTimer *timer) {
-    ttl_timers.update(&timer->node, is_ttl_timer_less);
+    ttl_timers.update(&timer->node, timer->expiry_time_ms);
 }
 
 void TimerManager::remove(TTLTimer *timer) {
-    ttl_timers.remove(&timer->node, is_ttl_timer_less);
+    ttl_timers.remove(&timer->node);
+}
+
+void TimerManager::replace(TTLTimer *old_timer, TTLTimer *new_timer) {
+    new_timer->expiry_time_ms = old_timer->expiry_time_ms;
+    old_timer->expiry_time_ms = TTLTimer::UNSET;
+    ttl_timers.replace(&old_timer->node, &new_timer->node);
 }
@@ -3,42 +3,85 @@
 #include <vector>
 
 #include "../hashmap/HMap.hpp"
-#include "../min-heap/MinHeap.hpp"
+#include "../timing-wheel/TimingWheel.hpp"
 #include "../queue/Queue.hpp"
 #include "../thread-pool/ThreadPool.hpp"
 
 // Forward declarations to break circular dependency
 class Conn;
+class ConnPool;
 class IdleTimer;
 class TTLTimer;
 
+/* Stats for expiring kv store entries whose TTL has passed */
+struct ExpiryStats {
+    // last active expiry cycle
+    uint64_t cycle_expired = 0; // entries expired
+    uint64_t cycle_us = 0; // time spent
+    bool cycle_timed_out = false; // whether the cycle ran out of time before the backlog was cleared
+    uint8_t effort = 1; // effort level the cycle ran at
+
+    // totals
+    uint64_t active_expired = 0; // entries expired by active expiry cycles
+    uint64_t lazy_expired = 0; // entries expired when accessed
+    uint64_t timed_out_cycles = 0;
+};
+
 /* Manages expirations of idle connection timers and TTL timers for kv store entries */
 class TimerManager {
     private:
-        static const uint16_t MAX_TTL_EXPIRATIONS = 1000;
+        static const uint32_t EXPIRY_BUDGET_US = 1000; // time budget for an active expiry cycle at effort level 1
+        static const uint8_t MAX_EXPIRY_EFFORT = 10;
+        static const uint8_t EXPIRY_TIME_CHECK_INTERVAL = 16; // entries expired between checks of the time budget
         
         Queue idle_timers; // can use a queue because idle timers have a fixed timeout value
-        MinHeap ttl_timers;
+        TimingWheel ttl_timers;
+        ExpiryStats expiry_stats;
+
+        /**
+         * Runs an active expiry cycle, removing entries whose TTL has passed until there are none left or the cycle's 
+         * time budget runs out.
+         * 
+         * The budget scales with the effort level. The effort level goes up after a cycle that ran out of time with 
+         * expired entries left over, and back down after a cycle that cleared the backlog, so a big expiry wave is 
+         * worked through over several event loop iterations instead of stalling one.
+         * 
+         * Each removed entry is fed to the AOF and replicas as a del. Replicas skip the cycle and wait for their 
+         * primary's dels instead, so a skewed clock can't make their data diverge.
+         * 
+         * @param now_ms        The current time in ms.
+         * @param kv_store      Reference to the kv store.
+         * @param thread_pool   Reference to the thread pool used for asynchronous work.
+         */
+        void expire_entries(time_t now_ms, HMap &kv_store, ThreadPool &thread_pool);
     public:
         /**
          * Gets the time until the next timer expires.
          * 
          * @return  The time until the next timer expires.
          *          0 if the next timer has already expired.
-         *          -1 if there are no active timers.
+         *          -1 if there are no active timers. TTL timers don't count on a replica.
          */
         int32_t get_time_until_expiry();
 
         /**
          * Checks the idle and TTL timers to see if any have expired.
          * 
-         * If a timer has expired, the associated connection or entry is removed.
+         * If a timer has expired, the associated connection or entry is removed. Closed connections are returned to the 
+         * connection pool.
          * 
          * @param kv_store      Reference to the kv store.
          * @param fd_to_conn    Reference to the map of all connections, indexed by fd.
+         * @param conn_pool     Reference to the pool that closed connections are returned to.
          * @param thread_pool   Reference to the thread pool used for asynchronous work.
          */
-        void process_timers(HMap &kv_store, std::vector<Conn *> &fd_to_conn, ThreadPool &thread_pool);
+        void process_timers(HMap &kv_store, std::vector<Conn *> &fd_to_conn, ConnPool &conn_pool, ThreadPool &thread_pool);
+
+        /* Records that an entry was expired when it was accessed rather than by an active expiry cycle */
+        void record_lazy_expiry();
+
+        /* Returns the expiry stats */
+        const ExpiryStats &get_expiry_stats();
 
         /* Adds an idle timer to be managed by the TimerManager */
         void add(IdleTimer *timer);
@@ -58,9 +101,12 @@ class TimerManager {
         /* Removes a TTL timer from being managed by the TimerManager */
         void remove(TTLTimer *timer);
 
+        /* Moves a TTL timer's expiry to another timer, which takes its place in the expiration order */
+        void replace(TTLTimer *old_timer, TTLTimer *new_timer);
+
     #ifdef TEST_MODE
     public:      
         Queue *get_idle_timers() { return &idle_timers; };
-        MinHeap *get_ttl_timers() { return &ttl_timers; }; 
+        TimingWheel *get_ttl_timers() { return &ttl_timers; }; 
     #endif
 };
@@ -7,7 +7,7 @@
 void test_set_expiry_new_timer() {
     TTLTimer timer;
     TimerManager timers;
-    MinHeap *ttl_timers = timers.get_ttl_timers();
+    TimingWheel *ttl_timers = timers.get_ttl_timers();
 
     assert(ttl_timers->is_empty() == true);
     
@@ -15,13 +15,13 @@ void test_set_expiry_new_timer() {
 
     assert(timer.expiry_time_ms > 0);
     assert(ttl_timers->is_empty() == false);
-    assert(ttl_timers->min() == &timer.node);
+    assert(ttl_timers->next_expiry_ms() != -1);
 }
 
 void test_set_expiry_existing_timer() {
     TTLTimer timer;
     TimerManager timers;
-    MinHeap *ttl_timers = timers.get_ttl_timers();
+    TimingWheel *ttl_timers = timers.get_ttl_timers();
 
     assert(ttl_timers->is_empty() == true);
 
@@ -29,7 +29,7 @@ void test_set_expiry_existing_timer() {
 
     assert(timer.expiry_time_ms > 0);
     assert(ttl_timers->is_empty() == false);
-    assert(ttl_timers->min() == &timer.node);
+    assert(ttl_timers->next_expiry_ms() != -1);
 
     time_t old_expiry_time = timer.expiry_time_ms;
     timer.set_expiry(100, &timers);
@@ -37,15 +37,16 @@ void test_set_expiry_existing_timer() {
     assert(timer.expiry_time_ms > 0);
     assert(timer.expiry_time_ms >= old_expiry_time);
     assert(ttl_timers->is_empty() == false);
-    assert(ttl_timers->min() == &timer.node);
-    ttl_timers->remove(&timer.node, is_ttl_timer_less);
+    assert(ttl_timers->next_expiry_ms() != -1);
+    assert(ttl_timers->length() == 1);
+    ttl_timers->remove(&timer.node);
     assert(ttl_timers->is_empty() == true);
 }
 
 void test_clear_expiry_expiry_not_set() {
     TTLTimer timer;
     TimerManager timers;
-    MinHeap *ttl_timers = timers.get_ttl_timers();
+    TimingWheel *ttl_timers = timers.get_ttl_timers();
 
     assert(timer.expiry_time_ms == TTLTimer::UNSET);
     assert(ttl_timers->is_empty() == true);
@@ -59,7 +60,7 @@ void test_clear_expiry_expiry_not_set() {
 void test_clear_expiry_expiry_set() {
     TTLTimer timer;
     TimerManager timers;
-    MinHeap *ttl_timers = timers.get_ttl_timers();
+    TimingWheel *ttl_timers = timers.get_ttl_timers();
 
     assert(ttl_timers->is_empty() == true);
 
@@ -67,7 +68,7 @@ void test_clear_expiry_expiry_set() {
 
     assert(timer.expiry_time_ms > 0);
     assert(ttl_timers->is_empty() == false);
-    assert(ttl_timers->min() == &timer.node);
+    assert(ttl_timers->next_expiry_ms() != -1);
 
     timer.clear_expiry(&timers);
 
@@ -0,0 +1,163 @@
+#include <algorithm>
+
+#include "TimingWheel.hpp"
+
+TimingWheel::TimingWheel() {
+    for (TWNode &head : slots) {
+        head.prev = &head;
+        head.next = &head;
+    }
+    for (uint64_t &bitmap : occupied) {
+        bitmap = 0;
+    }
+}
+
+void TimingWheel::insert(TWNode *node, uint64_t expiry_ms) {
+    node->expiry_ms = expiry_ms;
+    place(node);
+    num_nodes++;
+}
+
+void TimingWheel::update(TWNode *node, uint64_t expiry_ms) {
+    remove(node);
+    insert(node, expiry_ms);
+}
+
+void TimingWheel::remove(TWNode *node) {
+    if (node->prev == NULL) {
+        return;
+    }
+
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+
+    TWNode *head = &slots[node->slot];
+    if (node->slot != OVERFLOW_SLOT && head->next == head) {
+        occupied[node->slot / SLOTS] &= ~(1ULL << (node->slot % SLOTS));
+    }
+
+    node->prev = NULL;
+    node->next = NULL;
+    num_nodes--;
+}
+
+void TimingWheel::replace(TWNode *old_node, TWNode *new_node) {
+    if (old_node->prev == NULL) {
+        return;
+    }
+
+    *new_node = *old_node;
+    new_node->prev->next = new_node;
+    new_node->next->prev = new_node;
+
+    old_node->prev = NULL;
+    old_node->next = NULL;
+}
+
+TWNode *TimingWheel::pop_expired(uint64_t now_ms) {
+    while (true) {
+        uint16_t slot;
+        int64_t event_ms = next_event(&slot);
+        if (event_ms == -1 || (uint64_t) event_ms > now_ms) {
+            // nothing happens between the current time and now so the wheel can skip straight to it
+            current_ms = std::max(current_ms, now_ms);
+            return NULL;
+        }
+
+        current_ms = event_ms;
+
+        if (slot < SLOTS) {
+            TWNode *node = slots[slot].next;
+            remove(node);
+            return node;
+        }
+
+        cascade(slot);
+    }
+}
+
+int64_t TimingWheel::next_expiry_ms() {
+    uint16_t slot;
+    return next_event(&slot);
+}
+
+bool TimingWheel::is_empty() {
+    return num_nodes == 0;
+}
+
+uint64_t TimingWheel::length() {
+    return num_nodes;
+}
+
+void TimingWheel::place(TWNode *node) {
+    uint64_t expiry_ms = std::max(node->expiry_ms, current_ms);
+
+    // the highest bit that differs between the expiry and current time determines the level
+    uint64_t diff = expiry_ms ^ current_ms;
+    uint8_t level = diff == 0 ? 0 : (63 - __builtin_clzll(diff)) / LEVEL_BITS;
+
+    uint16_t slot = OVERFLOW_SLOT;
+    if (level < LEVELS) {
+        uint8_t index = (expiry_ms >> (level * LEVEL_BITS)) & (SLOTS - 1);
+        slot = level * SLOTS + index;
+        occupied[level] |= 1ULL << index;
+    }
+
+    TWNode *head = &slots[slot];
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+    node->slot = slot;
+}
+
+int64_t TimingWheel::next_event(uint16_t *slot) {
+    // a non-empty slot in a lower level is always processed before one in a higher level, so the first one found wins
+    for (uint8_t level = 0; level < LEVELS; level++) {
+        uint8_t shift = level * LEVEL_BITS;
+        uint8_t index = (current_ms >> shift) & (SLOTS - 1);
+
+        // the current slot in level 0 can still hold nodes that are due now, but the current slot in higher levels has 
+        // already been cascaded
+        uint8_t first = level == 0 ? index : index + 1;
+        if (first == SLOTS) {
+            continue;
+        }
+
+        uint64_t candidates = occupied[level] >> first << first;
+        if (candidates == 0) {
+            continue;
+        }
+
+        uint64_t found = __builtin_ctzll(candidates);
+        *slot = level * SLOTS + found;
+        uint64_t block_start_ms = current_ms >> (shift + LEVEL_BITS) << (shift + LEVEL_BITS);
+        return block_start_ms | (found << shift);
+    }
+
+    TWNode *overflow = &slots[OVERFLOW_SLOT];
+    if (overflow->next != overflow) {
+        *slot = OVERFLOW_SLOT;
+        uint8_t shift = LEVELS * LEVEL_BITS;
+        return ((current_ms >> shift) + 1) << shift;
+    }
+
+    return -1;
+}
+
+void TimingWheel::cascade(uint16_t slot) {
+    TWNode *head = &slots[slot];
+    TWNode *node = head->next;
+
+    head->prev = head;
+    head->next = head;
+    if (slot != OVERFLOW_SLOT) {
+        occupied[slot / SLOTS] &= ~(1ULL << (slot % SLOTS));
+    }
+
+    while (node != head) {
+        TWNode *next = node->next;
+        place(node);
+        node = next;
+    }
+}
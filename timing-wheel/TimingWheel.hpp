@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+
+#include "components/TWNode.hpp"
+
+/**
+ * Hierarchical timing wheel with millisecond resolution.
+ * 
+ * Level 0 has one slot per millisecond, and each level above it has slots that span all of the level below it. A node 
+ * is placed in the lowest level whose slots can tell its expiry time apart from the wheel's current time. As time 
+ * advances, the nodes in a higher level slot are cascaded down into lower levels until they reach level 0 and expire. 
+ * Insert, remove, and update are O(1). Each level keeps a bitmap of non-empty slots so empty stretches of time are 
+ * skipped instead of stepped through one millisecond at a time.
+ */
+class TimingWheel {
+    public:
+        static const uint8_t LEVEL_BITS = 6;
+        static const uint8_t SLOTS = 1 << LEVEL_BITS; // slots per level (64)
+        static const uint8_t LEVELS = 6; // covers 2^36 ms (~2 years), later expiries wait in an overflow list
+
+        TimingWheel();
+
+        /**
+         * Inserts a node into the TimingWheel. Expiry times before the wheel's current time expire on the next advance.
+         * 
+         * @param node      The node to insert.
+         * @param expiry_ms The node's expiry time in ms.
+         */
+        void insert(TWNode *node, uint64_t expiry_ms);
+
+        /**
+         * Moves a node in the TimingWheel to a new expiry time.
+         * 
+         * @param node      The node to update.
+         * @param expiry_ms The node's new expiry time in ms.
+         */
+        void update(TWNode *node, uint64_t expiry_ms);
+
+        /**
+         * Removes a node from the TimingWheel. Does nothing if the node is not in the wheel.
+         * 
+         * @param node  The node to remove.
+         */
+        void remove(TWNode *node);
+
+        /**
+         * Advances the wheel up to the given time and removes one node that has expired by then.
+         * 
+         * @param now_ms    The current time in ms.
+         * 
+         * @return  Pointer to an expired node.
+         *          NULL if no node has expired.
+         */
+        TWNode *pop_expired(uint64_t now_ms);
+
+        /**
+         * Puts a node in the place of another node in the TimingWheel, e.g. when the struct holding the node has moved 
+         * in memory. The new node takes on the old node's expiry. Nothing happens if the old node is not in the 
+         * TimingWheel.
+         * 
+         * @param old_node  Pointer to the node in the TimingWheel.
+         * @param new_node  Pointer to the node to put in its place.
+         */
+        void replace(TWNode *old_node, TWNode *new_node);
+
+        /**
+         * Gets the earliest time the wheel needs to be advanced to. For nodes in level 0 this is their exact expiry 
+         * time. For nodes in higher levels it is a lower bound: the time their slot is cascaded.
+         * 
+         * @return  The next time in ms.
+         *          -1 if the wheel is empty.
+         */
+        int64_t next_expiry_ms();
+
+        /* Checks if the TimingWheel is empty */
+        bool is_empty();
+
+        /* Returns the number of nodes in the TimingWheel */
+        uint64_t length();
+    private:
+        static const uint16_t OVERFLOW_SLOT = LEVELS * SLOTS;
+
+        TWNode slots[LEVELS * SLOTS + 1]; // dummy heads of circular lists, the last is the overflow list
+        uint64_t occupied[LEVELS]; // bitmap of non-empty slots in each level
+        uint64_t current_ms = 0; // time the wheel has been advanced to
+        uint64_t num_nodes = 0;
+
+        /**
+         * Adds a node to the slot that matches its expiry time relative to the wheel's current time.
+         * 
+         * @param node  The node to add. Its expiry time must already be set.
+         */
+        void place(TWNode *node);
+
+        /**
+         * Finds the next time after the current time (or at it, for level 0) that a slot needs to be processed.
+         * 
+         * @param slot  Pointer to a uint16_t where the index of the slot will be stored.
+         * 
+         * @return  The time the slot needs to be processed in ms.
+         *          -1 if the wheel is empty.
+         */
+        int64_t next_event(uint16_t *slot);
+
+        /**
+         * Moves all nodes in a slot to the slots that match their expiry time relative to the wheel's current time.
+         * 
+         * @param slot  Index of the slot.
+         */
+        void cascade(uint16_t slot);
+
+    #ifdef TEST_MODE
+    public:
+        uint64_t get_current_ms() { return current_ms; }
+    #endif
+};
@@ -0,0 +1,127 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../TimingWheel.hpp"
+#include "../../min-heap/MinHeap.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+#include "../../utils/time_utils.hpp"
+
+// Compares the TimingWheel to the MinHeap it replaced for TTL timers on churn-heavy expire workloads: every key gets a 
+// TTL, most TTLs are rescheduled or cancelled before they fire (e.g. set with a new TTL, persist, del), and the rest 
+// expire as time advances.
+
+const uint32_t NUM_TIMERS = 1000000;
+const uint32_t NUM_RESCHEDULES = 4000000;
+const uint64_t MAX_TTL_MS = 60 * 60 * 1000; // 1 hour
+
+struct HeapTimer {
+    MHNode node;
+    uint64_t expiry_ms;
+};
+
+struct WheelTimer {
+    TWNode node;
+};
+
+bool is_heap_timer_less(MHNode *node1, MHNode *node2) {
+    return container_of(node1, HeapTimer, node)->expiry_ms < container_of(node2, HeapTimer, node)->expiry_ms;
+}
+
+void report(const char *name, const char *op, uint64_t n, double ms) {
+    printf("%-12s %-12s %10lu ops %10.2f ms %8.1f ns/op\n", name, op, n, ms, ms * 1e6 / n);
+}
+
+void bench_min_heap(const std::vector<uint64_t> &expiries, const std::vector<uint32_t> &picks) {
+    std::vector<HeapTimer> timers(NUM_TIMERS);
+    MinHeap heap;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_TIMERS; i++) {
+        timers[i].expiry_ms = expiries[i];
+        heap.insert(&timers[i].node, is_heap_timer_less);
+    }
+    report("min-heap", "insert", NUM_TIMERS, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_RESCHEDULES; i++) {
+        HeapTimer &timer = timers[picks[i]];
+        timer.expiry_ms = expiries[(i + 7) % NUM_TIMERS];
+        heap.update(&timer.node, is_heap_timer_less);
+    }
+    report("min-heap", "reschedule", NUM_RESCHEDULES, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_TIMERS; i += 2) {
+        heap.remove(&timers[i].node, is_heap_timer_less);
+    }
+    report("min-heap", "cancel", NUM_TIMERS / 2, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    uint64_t expired = 0;
+    for (uint64_t now_ms = 0; now_ms <= MAX_TTL_MS; now_ms += 100) {
+        while (!heap.is_empty()) {
+            HeapTimer *timer = container_of(heap.min(), HeapTimer, node);
+            if (timer->expiry_ms > now_ms) {
+                break;
+            }
+            heap.remove(&timer->node, is_heap_timer_less);
+            expired++;
+        }
+    }
+    report("min-heap", "expire", expired, elapsed_ms(start));
+}
+
+void bench_timing_wheel(const std::vector<uint64_t> &expiries, const std::vector<uint32_t> &picks) {
+    std::vector<WheelTimer> timers(NUM_TIMERS);
+    TimingWheel *wheel = new TimingWheel();
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_TIMERS; i++) {
+        wheel->insert(&timers[i].node, expiries[i]);
+    }
+    report("timing-wheel", "insert", NUM_TIMERS, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_RESCHEDULES; i++) {
+        wheel->update(&timers[picks[i]].node, expiries[(i + 7) % NUM_TIMERS]);
+    }
+    report("timing-wheel", "reschedule", NUM_RESCHEDULES, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_TIMERS; i += 2) {
+        wheel->remove(&timers[i].node);
+    }
+    report("timing-wheel", "cancel", NUM_TIMERS / 2, elapsed_ms(start));
+
+    start = std::chrono::steady_clock::now();
+    uint64_t expired = 0;
+    for (uint64_t now_ms = 0; now_ms <= MAX_TTL_MS; now_ms += 100) {
+        while (wheel->pop_expired(now_ms) != NULL) {
+            expired++;
+        }
+    }
+    report("timing-wheel", "expire", expired, elapsed_ms(start));
+
+    delete wheel;
+}
+
+int main() {
+    srand(0);
+
+    std::vector<uint64_t> expiries(NUM_TIMERS);
+    for (uint64_t &expiry_ms : expiries) {
+        expiry_ms = 1 + ((uint64_t) rand() * RAND_MAX + rand()) % MAX_TTL_MS;
+    }
+
+    std::vector<uint32_t> picks(NUM_RESCHEDULES);
+    for (uint32_t &pick : picks) {
+        pick = rand() % NUM_TIMERS;
+    }
+
+    bench_min_heap(expiries, picks);
+    bench_timing_wheel(expiries, picks);
+
+    return 0;
+}
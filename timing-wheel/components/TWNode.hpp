@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* Node in a TimingWheel */
+struct TWNode {
+    TWNode *prev = NULL;
+    TWNode *next = NULL;
+    uint64_t expiry_ms = 0;
+    uint16_t slot = 0; // index of the slot list the node is in (level * SLOTS + slot in level)
+};
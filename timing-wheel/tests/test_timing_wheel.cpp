@@ -0,0 +1,275 @@
+#define TEST_MODE
+
+#include <assert.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "../TimingWheel.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+
+struct Item {
+    TWNode node;
+    uint64_t id;
+};
+
+/**
+ * Pops all nodes that have expired by the given time.
+ * 
+ * @param wheel     Pointer to the TimingWheel.
+ * @param now_ms    The current time in ms.
+ * 
+ * @return  Vector of the expired Items, in the order they were popped.
+ */
+std::vector<Item *> pop_all_expired(TimingWheel *wheel, uint64_t now_ms) {
+    std::vector<Item *> expired;
+    while (TWNode *node = wheel->pop_expired(now_ms)) {
+        expired.push_back(container_of(node, Item, node));
+    }
+    return expired;
+}
+
+void test_empty_wheel() {
+    TimingWheel wheel;
+
+    assert(wheel.is_empty() == true);
+    assert(wheel.length() == 0);
+    assert(wheel.next_expiry_ms() == -1);
+    assert(wheel.pop_expired(1000) == NULL);
+    assert(wheel.get_current_ms() == 1000);
+}
+
+void test_insert_level_0() {
+    TimingWheel wheel;
+    Item item;
+
+    wheel.insert(&item.node, 10);
+
+    assert(wheel.is_empty() == false);
+    assert(wheel.length() == 1);
+    assert(wheel.next_expiry_ms() == 10);
+}
+
+void test_pop_before_expiry() {
+    TimingWheel wheel;
+    Item item;
+
+    wheel.insert(&item.node, 10);
+
+    assert(wheel.pop_expired(9) == NULL);
+    assert(wheel.length() == 1);
+}
+
+void test_pop_at_expiry() {
+    TimingWheel wheel;
+    Item item;
+
+    wheel.insert(&item.node, 10);
+
+    assert(wheel.pop_expired(10) == &item.node);
+    assert(wheel.is_empty() == true);
+    assert(wheel.pop_expired(10) == NULL);
+}
+
+void test_pop_past_expiry() {
+    TimingWheel wheel;
+    wheel.pop_expired(1000);
+    Item item;
+
+    wheel.insert(&item.node, 500); // already expired
+
+    assert(wheel.next_expiry_ms() == 1000);
+    assert(wheel.pop_expired(1000) == &item.node);
+}
+
+void test_pop_higher_level_cascades() {
+    TimingWheel wheel;
+    Item item;
+
+    uint64_t expiry_ms = 3 * 60 * 60 * 1000; // 3 hours, level 2
+    wheel.insert(&item.node, expiry_ms);
+
+    assert(wheel.next_expiry_ms() <= (int64_t) expiry_ms);
+    assert(wheel.pop_expired(expiry_ms - 1) == NULL);
+    assert(wheel.next_expiry_ms() == (int64_t) expiry_ms);
+    assert(wheel.pop_expired(expiry_ms) == &item.node);
+}
+
+void test_pop_overflow() {
+    TimingWheel wheel;
+    Item item;
+
+    uint64_t expiry_ms = (1ULL << 40) + 123;
+    wheel.insert(&item.node, expiry_ms);
+
+    assert(wheel.pop_expired(expiry_ms - 1) == NULL);
+    assert(wheel.pop_expired(expiry_ms) == &item.node);
+}
+
+void test_pop_in_expiry_order() {
+    TimingWheel wheel;
+    Item items[4];
+    uint64_t expiries[4] = {70000, 5, 300, 64};
+    for (uint64_t i = 0; i < 4; i++) {
+        items[i].id = i;
+        wheel.insert(&items[i].node, expiries[i]);
+    }
+
+    std::vector<Item *> expired = pop_all_expired(&wheel, 100000);
+
+    assert(expired.size() == 4);
+    assert(expired[0]->id == 1);
+    assert(expired[1]->id == 3);
+    assert(expired[2]->id == 2);
+    assert(expired[3]->id == 0);
+}
+
+void test_remove() {
+    TimingWheel wheel;
+    Item item1;
+    Item item2;
+
+    wheel.insert(&item1.node, 10);
+    wheel.insert(&item2.node, 20);
+    wheel.remove(&item1.node);
+
+    assert(wheel.length() == 1);
+    assert(wheel.next_expiry_ms() == 20);
+    assert(wheel.pop_expired(100) == &item2.node);
+}
+
+void test_remove_twice() {
+    TimingWheel wheel;
+    Item item;
+
+    wheel.insert(&item.node, 10);
+    wheel.remove(&item.node);
+    wheel.remove(&item.node);
+
+    assert(wheel.is_empty() == true);
+}
+
+void test_remove_popped_node() {
+    TimingWheel wheel;
+    Item item;
+
+    wheel.insert(&item.node, 10);
+    wheel.pop_expired(10);
+    wheel.remove(&item.node);
+
+    assert(wheel.is_empty() == true);
+}
+
+void test_update_later() {
+    TimingWheel wheel;
+    Item item;
+
+    wheel.insert(&item.node, 10);
+    wheel.update(&item.node, 100000);
+
+    assert(wheel.length() == 1);
+    assert(wheel.pop_expired(10) == NULL);
+    assert(wheel.pop_expired(100000) == &item.node);
+}
+
+void test_update_earlier() {
+    TimingWheel wheel;
+    Item item;
+
+    wheel.insert(&item.node, 100000);
+    wheel.update(&item.node, 10);
+
+    assert(wheel.length() == 1);
+    assert(wheel.pop_expired(10) == &item.node);
+}
+
+void test_random_matches_sorted_order() {
+    TimingWheel wheel;
+    srand(0);
+
+    const uint32_t n = 5000;
+    std::vector<Item> items(n);
+    std::vector<std::pair<uint64_t, uint64_t>> expected;
+    for (uint64_t i = 0; i < n; i++) {
+        items[i].id = i;
+        uint64_t expiry_ms = rand() % 10000000;
+        wheel.insert(&items[i].node, expiry_ms);
+        expected.push_back({expiry_ms, i});
+    }
+    std::sort(expected.begin(), expected.end());
+
+    // advance in uneven steps, checking nothing expires early or late
+    std::vector<uint64_t> popped;
+    for (uint64_t now_ms = 0; now_ms <= 10000000; now_ms += 1 + rand() % 5000) {
+        for (Item *item : pop_all_expired(&wheel, now_ms)) {
+            assert(item->node.expiry_ms <= now_ms);
+            popped.push_back(item->node.expiry_ms);
+        }
+        int64_t next_ms = wheel.next_expiry_ms();
+        assert(next_ms == -1 || (uint64_t) next_ms > now_ms);
+    }
+    for (Item *item : pop_all_expired(&wheel, 10000000)) {
+        popped.push_back(item->node.expiry_ms);
+    }
+
+    assert(wheel.is_empty() == true);
+    assert(popped.size() == n);
+    assert(std::is_sorted(popped.begin(), popped.end()));
+}
+
+void test_replace() {
+    TimingWheel wheel;
+    Item items[3];
+    for (uint64_t i = 0; i < 3; i++) {
+        items[i].id = i;
+        wheel.insert(&items[i].node, 10);
+    }
+
+    Item moved;
+    moved.id = 1;
+    wheel.replace(&items[1].node, &moved.node);
+
+    assert(items[1].node.prev == NULL);
+    assert(wheel.length() == 3);
+    std::vector<Item *> popped = pop_all_expired(&wheel, 10);
+    assert(popped.size() == 3);
+    assert(std::find(popped.begin(), popped.end(), &moved) != popped.end());
+    assert(std::find(popped.begin(), popped.end(), &items[1]) == popped.end());
+}
+
+void test_replace_node_not_in_wheel() {
+    TimingWheel wheel;
+    Item item;
+    Item moved;
+
+    wheel.replace(&item.node, &moved.node);
+
+    assert(moved.node.prev == NULL);
+    assert(wheel.is_empty() == true);
+}
+
+int main() {
+    test_empty_wheel();
+    test_insert_level_0();
+
+    test_pop_before_expiry();
+    test_pop_at_expiry();
+    test_pop_past_expiry();
+    test_pop_higher_level_cascades();
+    test_pop_overflow();
+    test_pop_in_expiry_order();
+
+    test_remove();
+    test_remove_twice();
+    test_remove_popped_node();
+
+    test_update_later();
+    test_update_earlier();
+
+    test_random_matches_sorted_order();
+
+    test_replace();
+    test_replace_node_not_in_wheel();
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <array>
+
+#include "checksum_utils.hpp"
+
+/* Builds the lookup table of the CRC of every byte value, reflected form */
+static std::array<uint32_t, 256> make_crc32_table() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t n) {
+    static const std::array<uint32_t, 256> table = make_crc32_table();
+
+    const uint8_t *bytes = (const uint8_t *) data;
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/* Builds the lookup table of the CRC of every byte value, unreflected form */
+static std::array<uint16_t, 256> make_crc16_table() {
+    std::array<uint16_t, 256> table;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint16_t crc = i << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+uint16_t crc16(const void *data, size_t n) {
+    static const std::array<uint16_t, 256> table = make_crc16_table();
+
+    const uint8_t *bytes = (const uint8_t *) data;
+    uint16_t crc = 0;
+    for (size_t i = 0; i < n; i++) {
+        crc = (crc << 8) ^ table[((crc >> 8) ^ bytes[i]) & 0xff];
+    }
+    return crc;
+}
@@ -0,0 +1,28 @@
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Updates a CRC-32 (IEEE 802.3 polynomial, as used by zlib and gzip) with more data. Start with a crc of 0 and feed 
+ * the data through in as many pieces as needed.
+ * 
+ * Reference: https://en.wikipedia.org/wiki/Cyclic_redundancy_check
+ * 
+ * @param crc   The CRC of the data so far.
+ * @param data  Pointer to the data.
+ * @param n     Length of the data.
+ * 
+ * @return  The CRC of the data so far followed by the given data.
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t n);
+
+/**
+ * Computes the CRC-16 (CCITT polynomial, XMODEM variant) of some data.
+ * 
+ * Reference: https://en.wikipedia.org/wiki/Cyclic_redundancy_check
+ * 
+ * @param data  Pointer to the data.
+ * @param n     Length of the data.
+ * 
+ * @return  The CRC of the data.
+ */
+uint16_t crc16(const void *data, size_t n);
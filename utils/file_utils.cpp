@@ -0,0 +1,24 @@
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file_utils.hpp"
+
+bool write_file_atomically(const std::string &path, bool (*write_cb)(int fd, void *arg), void *arg) {
+    std::string tmp_path = path + ".tmp-" + std::to_string(getpid());
+    int fd = open(tmp_path.data(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+
+    bool ok = write_cb(fd, arg) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp_path.data(), path.data()) == -1) {
+        int err = errno;
+        unlink(tmp_path.data());
+        errno = err;
+        return false;
+    }
+    return true;
+}
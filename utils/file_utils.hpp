@@ -0,0 +1,14 @@
+#include <string>
+
+/**
+ * Replaces a file atomically: the contents are written to a temporary file next to it, synced to disk, then renamed 
+ * over it, so a crash leaves either the old file or the whole new one.
+ * 
+ * @param path      The path of the file.
+ * @param write_cb  Writes the contents to the temporary file's fd. Returns true on success.
+ * @param arg       Argument passed to write_cb.
+ * 
+ * @return  True on success.
+ *          False on error (and sets errno accordingly). The temporary file is removed.
+ */
+bool write_file_atomically(const std::string &path, bool (*write_cb)(int fd, void *arg), void *arg);
@@ -0,0 +1,91 @@
+#include <utility>
+
+#include "glob_utils.hpp"
+
+/**
+ * Matches one character against the token of a pattern at pos, which is anything but "*".
+ * 
+ * @param pattern   The pattern.
+ * @param pos       The position of the token.
+ * @param c         The character.
+ * @param next      Pointer to where the position after the token will be stored.
+ * 
+ * @return  True if the token matches the character.
+ *          False otherwise.
+ */
+static bool match_token(std::string_view pattern, size_t pos, char c, size_t *next) {
+    if (pattern[pos] == '?') {
+        *next = pos + 1;
+        return true;
+    }
+
+    if (pattern[pos] == '\\' && pos + 1 < pattern.size()) {
+        *next = pos + 2;
+        return pattern[pos + 1] == c;
+    }
+
+    if (pattern[pos] != '[') {
+        *next = pos + 1;
+        return pattern[pos] == c;
+    }
+
+    // a set, running to the next unescaped "]" or the end of the pattern
+    size_t i = pos + 1;
+    bool negate = i < pattern.size() && pattern[i] == '^';
+    if (negate) {
+        i++;
+    }
+    bool found = false;
+    while (i < pattern.size() && pattern[i] != ']') {
+        if (pattern[i] == '\\' && i + 1 < pattern.size()) {
+            found |= pattern[i + 1] == c;
+            i += 2;
+        } else if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+            char lo = pattern[i], hi = pattern[i + 2];
+            if (lo > hi) {
+                std::swap(lo, hi);
+            }
+            found |= c >= lo && c <= hi;
+            i += 3;
+        } else {
+            found |= pattern[i] == c;
+            i++;
+        }
+    }
+    *next = i < pattern.size() ? i + 1 : i;
+    return found != negate;
+}
+
+bool glob_match(std::string_view pattern, std::string_view str) {
+    // every token but "*" matches exactly one character, so on a mismatch it's enough to retry from the last "*" with 
+    // it covering one more character
+    size_t p = 0, s = 0;
+    size_t star = std::string_view::npos, star_s = 0;
+    while (s < str.size()) {
+        if (p < pattern.size()) {
+            if (pattern[p] == '*') {
+                star = p++;
+                star_s = s;
+                continue;
+            }
+
+            size_t next;
+            if (match_token(pattern, p, str[s], &next)) {
+                p = next;
+                s++;
+                continue;
+            }
+        }
+
+        if (star == std::string_view::npos) {
+            return false;
+        }
+        p = star + 1;
+        s = ++star_s;
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
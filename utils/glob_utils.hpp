@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string_view>
+
+/**
+ * Matches a string against a glob-style pattern.
+ * 
+ * Supports "*" (any run of characters), "?" (any one character), "[abc]", "[^abc]", and "[a-z]" (one character in or 
+ * not in a set), and "\" to match the next character literally.
+ * 
+ * @param pattern   The pattern.
+ * @param str       The string.
+ * 
+ * @return  True if the whole string matches the pattern.
+ *          False otherwise.
+ */
+bool glob_match(std::string_view pattern, std::string_view str);
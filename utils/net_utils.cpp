@@ -1,5 +1,11 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
+#include "log.hpp"
 #include "net_utils.hpp"
 
 ssize_t send_all(int sockfd, const char *buf, size_t n) {
@@ -24,5 +30,70 @@ int recv_all(int sockfd, char *buf, size_t n) {
         n -= (size_t) recvd;
         buf += recvd;
     }
-    return 0;
+    return 1;
+}
+
+struct addrinfo *get_my_addr_info(const char *port) {
+    struct addrinfo *res;
+    struct addrinfo hints;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;        // IPv4 or IPv6
+    hints.ai_socktype = SOCK_STREAM;    // Stream socket
+    hints.ai_flags = AI_PASSIVE;        // Returns wildcard address
+
+    if (getaddrinfo(NULL, port, &hints, &res) != 0) {
+        return NULL;
+    }
+
+    return res;
+}
+
+int start_server(struct addrinfo *res) {
+    struct addrinfo *p;
+    int listener;
+    for (p = res; p != NULL; p = p->ai_next) {
+        if ((listener = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) == -1) {
+            log("%s", strerror(errno));
+            continue;
+        }
+
+        int yes = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));  // Allows port to be re-used
+
+        if (bind(listener, p->ai_addr, p->ai_addrlen) == -1) {
+            log("%s", strerror(errno));
+            close(listener);
+            continue;
+        }
+
+        if (listen(listener, SOMAXCONN) == -1) {
+            log("%s", strerror(errno));
+            close(listener);
+            continue;
+        }
+
+        return listener;
+    }
+
+    return -1;
+}
+
+bool set_non_blocking(int fd) {
+    // get current socket flags
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+        return false;
+    }
+
+    // Add the O_NONBLOCK flag
+    flags |= O_NONBLOCK;
+
+    // update socket flags
+    int result = fcntl(fd, F_SETFL, flags);
+    if (result == -1) {
+        return false;
+    }
+
+    return true;
 }
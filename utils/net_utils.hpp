@@ -24,3 +24,33 @@ ssize_t send_all(int sockfd, const char *buf, size_t n);
  *          -1 on error (and sets errno accordingly).
  */
 int recv_all(int sockfd, char *buf, size_t n);
+
+/**
+ * Gets the address info for the machine running this program which can be used in bind().
+ * 
+ * @param port  The port to listen on.
+ * 
+ * @return  Pointer to a struct addrinfo on success. Should be freed when no longer in use.
+ *          NULL on error.
+ */
+struct addrinfo *get_my_addr_info(const char *port);
+
+/**
+ * Starts listening by creating a listener socket bound to the address in res.
+ * 
+ * @param res   Pointer to a struct addrinfo containing the address to listen on.
+ * 
+ * @return  The listener socket on success.
+ *          -1 on error.
+ */
+int start_server(struct addrinfo *res);
+
+/** 
+ * Sets a socket so that it is non-blocking.
+ * 
+ * @param fd    The socket to update.
+ * 
+ * @return  True on success.
+ *          False on error.
+ */
+bool set_non_blocking(int fd);
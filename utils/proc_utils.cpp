@@ -0,0 +1,29 @@
+#include <cstdio>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "log.hpp"
+#include "proc_utils.hpp"
+
+pid_t fork_child(bool (*task)(void *arg), void *arg) {
+    fflush(stdout); // otherwise the child would print the parent's buffered logs again
+    pid_t pid = fork();
+    if (pid == 0) {
+        bool ok = task(arg);
+        fflush(stdout);
+        _exit(ok ? 0 : 1); // skip the parent's atexit handlers and destructors
+    }
+    return pid;
+}
+
+ChildState reap_child(pid_t pid, const char *name) {
+    int status;
+    pid_t reaped = waitpid(pid, &status, WNOHANG);
+    if (reaped == 0) {
+        return ChildState::RUNNING;
+    } else if (reaped == -1) {
+        log("%s: lost track of child %d", name, pid);
+        return ChildState::FAILED;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? ChildState::SUCCEEDED : ChildState::FAILED;
+}
@@ -0,0 +1,35 @@
+#include <sys/types.h>
+
+// Helpers for forking children that work on a copy-on-write snapshot of the parent's memory (e.g. bgsave)
+
+/* The state of a child forked by fork_child() */
+enum class ChildState {
+    RUNNING,
+    SUCCEEDED,
+    FAILED
+};
+
+/**
+ * Forks a child that runs a task and exits. The child sees the parent's memory frozen as of the fork, so the task can 
+ * read the kv store while the parent goes on changing it.
+ * 
+ * @param task  The task, run in the child. Returns true on success.
+ * @param arg   Argument passed to the task.
+ * 
+ * @return  The pid of the child in the parent.
+ *          -1 if the fork failed (and sets errno accordingly).
+ */
+pid_t fork_child(bool (*task)(void *arg), void *arg);
+
+/**
+ * Checks whether a child forked by fork_child() has exited, without blocking. Once it returns something other than 
+ * RUNNING, the child is gone and must not be checked again.
+ * 
+ * @param pid   The pid of the child.
+ * @param name  What the child was forked for, for logging.
+ * 
+ * @return  RUNNING if the child hasn't exited yet.
+ *          SUCCEEDED if its task succeeded.
+ *          FAILED if its task failed, it was killed, or it could not be waited for.
+ */
+ChildState reap_child(pid_t pid, const char *name);
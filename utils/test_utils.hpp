@@ -0,0 +1,157 @@
+#pragma once
+
+#include <assert.h>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../cluster/components/ClusterClient.hpp"
+#include "../response/types/ArrResponse.hpp"
+#include "../response/types/ErrResponse.hpp"
+#include "../response/types/IntResponse.hpp"
+#include "../response/types/StrResponse.hpp"
+
+// Helpers for tests that run servers (or the proxy) as separate processes and talk to them over the network. Header
+// only, so that they're only built into the tests that use them.
+
+/* A server or proxy process started by a test, in a directory of its own */
+struct TestProcess {
+    pid_t pid;
+    std::string port;
+    std::string addr; // "127.0.0.1:<port>"
+    std::string dir;
+};
+
+/* Returns the first of 8 ports set aside for this test, below the ephemeral ports clients connect from */
+inline uint32_t test_base_port() {
+    return 20000 + (getpid() % 1500) * 8;
+}
+
+/**
+ * Starts a process from a binary in the current directory and waits for it to accept connections. Its output is 
+ * discarded, and it is killed if the test dies first.
+ * 
+ * @param binary    The binary's name, e.g. "server".
+ * @param port      The port to listen on, passed as the first argument.
+ * @param args      The arguments after the port.
+ * 
+ * @return  The process.
+ */
+inline TestProcess start_test_process(const std::string &binary, uint32_t port, const std::vector<std::string> &args = {}) {
+    char path[PATH_MAX];
+    assert(realpath(("./" + binary).data(), path) != NULL);
+
+    TestProcess process;
+    char dir[] = "/tmp/test_process_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    process.dir = dir;
+    process.port = std::to_string(port);
+    process.addr = "127.0.0.1:" + process.port;
+
+    std::vector<std::string> argv_strs = { binary, process.port };
+    argv_strs.insert(argv_strs.end(), args.begin(), args.end());
+
+    process.pid = fork();
+    assert(process.pid != -1);
+    if (process.pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL); // don't outlive a failed test
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        std::vector<char *> argv;
+        for (std::string &arg : argv_strs) {
+            argv.push_back(arg.data());
+        }
+        argv.push_back(NULL);
+        if (chdir(dir) == 0) {
+            execv(path, argv.data());
+        }
+        _exit(1);
+    }
+
+    bool up = false;
+    for (int i = 0; i < 1000 && !up; i++) {
+        ClusterClient probe(process.addr);
+        up = dynamic_cast<ErrResponse *>(probe.execute({ { "lastsave" } })[0].get()) == NULL;
+        if (!up) {
+            usleep(10 * 1000);
+        }
+    }
+    assert(up);
+    return process;
+}
+
+/* Kills a process started by start_test_process() and removes its directory */
+inline void stop_test_process(TestProcess &process) {
+    kill(process.pid, SIGKILL);
+    waitpid(process.pid, NULL, 0);
+
+    DIR *dir = opendir(process.dir.data());
+    if (dir != NULL) {
+        struct dirent *file;
+        while ((file = readdir(dir)) != NULL) {
+            std::string name = file->d_name;
+            if (name != "." && name != "..") {
+                unlink((process.dir + "/" + name).data());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(process.dir.data());
+}
+
+/**
+ * Sends a command to a process, with a client that doesn't know the slot map, so it can only follow redirects.
+ * 
+ * @param addr      The process's "host:port".
+ * @param command   The command.
+ * 
+ * @return  The response, after any redirects.
+ */
+inline std::unique_ptr<Response> send_to(const std::string &addr, const std::vector<std::string> &command) {
+    ClusterClient client(addr);
+    return std::move(client.execute({ command })[0]);
+}
+
+/* Returns the message of a StrResponse */
+inline std::string str_of(const std::unique_ptr<Response> &response) {
+    StrResponse *str = dynamic_cast<StrResponse *>(response.get());
+    assert(str != NULL);
+    return str->get_msg();
+}
+
+/* Returns the integer of an IntResponse */
+inline int64_t int_of(const std::unique_ptr<Response> &response) {
+    IntResponse *integer = dynamic_cast<IntResponse *>(response.get());
+    assert(integer != NULL);
+    return integer->get_int();
+}
+
+/* Returns the code of an ErrResponse */
+inline ErrResponse::ErrorCode err_code_of(const std::unique_ptr<Response> &response) {
+    ErrResponse *err = dynamic_cast<ErrResponse *>(response.get());
+    assert(err != NULL);
+    return err->get_err_code();
+}
+
+/* Returns the message of an ErrResponse */
+inline std::string err_msg_of(const std::unique_ptr<Response> &response) {
+    ErrResponse *err = dynamic_cast<ErrResponse *>(response.get());
+    assert(err != NULL);
+    return err->get_err_msg();
+}
+
+/* Returns the number of elements of an ArrResponse */
+inline uint32_t len_of(const std::unique_ptr<Response> &response) {
+    ArrResponse *arr = dynamic_cast<ArrResponse *>(response.get());
+    assert(arr != NULL);
+    return arr->get_elements().size();
+}
@@ -8,3 +8,44 @@ time_t get_time_ms() {
     }
     return res.tv_sec * 1000 + res.tv_nsec / 1000 / 1000;
 }
+
+time_t get_unix_time_ms() {
+    timespec res;
+    if (clock_gettime(CLOCK_REALTIME, &res) == -1) {
+        fatal("failed to get time");
+    }
+    return res.tv_sec * 1000 + res.tv_nsec / 1000 / 1000;
+}
+
+time_t get_time_us() {
+    timespec res;
+    if (clock_gettime(CLOCK_MONOTONIC, &res) == -1) {
+        fatal("failed to get time");
+    }
+    return res.tv_sec * 1000 * 1000 + res.tv_nsec / 1000;
+}
+
+static time_t cached_time_ms = -1;
+
+void update_cached_time() {
+    cached_time_ms = get_time_ms();
+}
+
+time_t get_cached_time_ms() {
+    if (cached_time_ms == -1) {
+        update_cached_time();
+    }
+    return cached_time_ms;
+}
+
+time_t unix_to_monotonic_ms(time_t unix_time_ms) {
+    return get_cached_time_ms() + (unix_time_ms - get_unix_time_ms());
+}
+
+time_t monotonic_to_unix_ms(time_t monotonic_ms) {
+    return get_unix_time_ms() + (monotonic_ms - get_cached_time_ms());
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -1,4 +1,31 @@
+#include <chrono>
 #include <ctime>
 
 /* Returns the current monotonic time in ms. */
 time_t get_time_ms();
+
+/* Returns the current wall clock (unix) time in ms. */
+time_t get_unix_time_ms();
+
+/* Converts a wall clock (unix) time in ms to the equivalent monotonic time in ms. */
+time_t unix_to_monotonic_ms(time_t unix_time_ms);
+
+/* Converts a monotonic time in ms to the equivalent wall clock (unix) time in ms. */
+time_t monotonic_to_unix_ms(time_t monotonic_ms);
+
+/* Returns the current monotonic time in us. Meant for measuring latency rather than for timers. */
+time_t get_time_us();
+
+/**
+ * Refreshes the cached monotonic time returned by get_cached_time_ms(). 
+ * 
+ * The event loop calls this once per iteration so everything handled in the same iteration sees one consistent "now" 
+ * without reading the clock again.
+ */
+void update_cached_time();
+
+/* Returns the monotonic time in ms as of the last call to update_cached_time(), reading the clock if never called. */
+time_t get_cached_time_ms();
+
+/* Returns the ms elapsed since start, with sub-ms precision. Meant for benchmarks. */
+double elapsed_ms(std::chrono::steady_clock::time_point start);
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <unordered_map>
+
+#include "ZStoreJob.hpp"
+#include "../cluster/Cluster.hpp"
+#include "../entry/Entry.hpp"
+#include "../response/types/IntResponse.hpp"
+#include "../utils/hash_utils.hpp"
+#include "../utils/intrusive_data_structure_utils.hpp"
+#include "../utils/log.hpp"
+
+/* Merged score of a name, and the number of sources it has been found in */
+struct MergedScore {
+    double score;
+    uint32_t seen;
+};
+
+typedef std::unordered_map<std::string_view, MergedScore> MergedScores;
+
+/* Argument for the merge callbacks */
+struct MergeArg {
+    MergedScores *scores;
+    double weight;
+    ZAggregate aggregate;
+    uint32_t seen; // number of sources merged before this one
+};
+
+/**
+ * Multiplies a score by a weight. Like Redis, 0 * inf is taken to be 0 rather than NaN.
+ * 
+ * @param score     The score.
+ * @param weight    The weight.
+ * 
+ * @return  The weighted score.
+ */
+double weigh(double score, double weight) {
+    double weighted = score * weight;
+    return std::isnan(weighted) ? 0 : weighted;
+}
+
+/**
+ * Combines two scores of the same name. Like Redis, inf + -inf is taken to be 0 rather than NaN.
+ * 
+ * @param score1    The first score.
+ * @param score2    The second score.
+ * @param aggregate How to combine the scores.
+ * 
+ * @return  The combined score.
+ */
+double combine(double score1, double score2, ZAggregate aggregate) {
+    if (aggregate == ZAggregate::MIN) {
+        return std::min(score1, score2);
+    } else if (aggregate == ZAggregate::MAX) {
+        return std::max(score1, score2);
+    }
+    double sum = score1 + score2;
+    return std::isnan(sum) ? 0 : sum;
+}
+
+/* Callback which adds a pair of a source to the union */
+void merge_union(const SPairView &pair, void *arg) {
+    MergeArg *merge_arg = (MergeArg *) arg;
+    double score = weigh(pair.score, merge_arg->weight);
+    auto [it, inserted] = merge_arg->scores->try_emplace(std::string_view(pair.name, pair.len), MergedScore{ score, 1 });
+    if (!inserted) {
+        it->second.score = combine(it->second.score, score, merge_arg->aggregate);
+    }
+}
+
+/* Callback which adds a pair of a source to the intersection if its name was in every source before it */
+void merge_inter(const SPairView &pair, void *arg) {
+    MergeArg *merge_arg = (MergeArg *) arg;
+    double score = weigh(pair.score, merge_arg->weight);
+    if (merge_arg->seen == 0) {
+        merge_arg->scores->emplace(std::string_view(pair.name, pair.len), MergedScore{ score, 1 });
+        return;
+    }
+
+    auto it = merge_arg->scores->find(std::string_view(pair.name, pair.len));
+    if (it != merge_arg->scores->end() && it->second.seen == merge_arg->seen) {
+        it->second.score = combine(it->second.score, score, merge_arg->aggregate);
+        it->second.seen++;
+    }
+}
+
+/* Callback which removes a pair of a later source from the difference */
+void merge_diff(const SPairView &pair, void *arg) {
+    MergeArg *merge_arg = (MergeArg *) arg;
+    if (merge_arg->seen == 0) {
+        merge_arg->scores->emplace(std::string_view(pair.name, pair.len), MergedScore{ pair.score, 1 });
+        return;
+    }
+    merge_arg->scores->erase(std::string_view(pair.name, pair.len));
+}
+
+ZStoreJob::ZStoreJob(ZStoreOp op, const std::string &dest, const std::vector<SortedSet::Snapshot *> &sources,
+                     const std::vector<double> &weights, ZAggregate aggregate) :
+    op(op), dest(dest), sources(sources), weights(weights), aggregate(aggregate) {}
+
+ZStoreJob::~ZStoreJob() {
+    for (SortedSet::Snapshot *source : sources) {
+        delete source;
+    }
+    delete result;
+}
+
+uint64_t ZStoreJob::input_size() {
+    uint64_t size = 0;
+    for (SortedSet::Snapshot *source : sources) {
+        size += source->length();
+    }
+    return size;
+}
+
+std::vector<SPairView> ZStoreJob::merge() {
+    // an intersection can't be bigger than its smallest source, so start from it to keep the map small
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < sources.size(); i++) {
+        order.push_back(i);
+    }
+    if (op == ZStoreOp::INTER) {
+        std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            return sources[a]->length() < sources[b]->length();
+        });
+    }
+
+    void (*cb)(const SPairView &, void *) = op == ZStoreOp::UNION ? merge_union :
+                                            op == ZStoreOp::INTER ? merge_inter : merge_diff;
+    MergedScores scores;
+    scores.reserve(sources[order[0]]->length());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        if (op != ZStoreOp::UNION && scores.empty() && i > 0) {
+            break; // nothing left to intersect with or subtract from
+        }
+        MergeArg arg = { &scores, weights[order[i]], aggregate, i };
+        sources[order[i]]->for_each(cb, &arg);
+    }
+
+    std::vector<SPairView> pairs;
+    pairs.reserve(scores.size());
+    for (auto &[name, merged] : scores) {
+        if (op == ZStoreOp::INTER && merged.seen != sources.size()) {
+            continue;
+        }
+        pairs.push_back({ merged.score, name.data(), (uint32_t) name.length() });
+    }
+
+    std::sort(pairs.begin(), pairs.end(), [](const SPairView &a, const SPairView &b) {
+        return compare_score_and_name(a.score, a.name, a.len, b.score, b.name, b.len) < 0;
+    });
+    return pairs;
+}
+
+void ZStoreJob::run() {
+    // the pairs are sorted, so a large result is built in O(n) rather than by inserting them one by one
+    result = new SortedSet();
+    result->insert_all(merge());
+}
+
+std::unique_ptr<Response> ZStoreJob::finish(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool,
+                                            Evictor &evictor) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = dest;
+    lookup_entry.node.hval = str_hash(dest);
+    HNode *node = kv_store.remove(&lookup_entry.node, are_entries_equal);
+    if (node != NULL) {
+        delete_entry(container_of(node, Entry, node), &timers, &thread_pool);
+    }
+
+    uint32_t length = result->length();
+    if (length == 0) {
+        log("zstore: result is empty, deleted key '%s'", dest.data());
+        return std::make_unique<IntResponse>(0);
+    }
+
+    Entry *entry = new Entry();
+    entry->key = dest;
+    entry->type = EntryType::SORTED_SET;
+    entry->zset.swap(*result);
+    entry->node.hval = lookup_entry.node.hval;
+    evictor.init_access(entry);
+    kv_store.insert(&entry->node);
+    Cluster::shared().add_key(entry);
+    update_entry_memory(entry);
+    log("zstore: stored %u pairs at key '%s'", length, dest.data());
+
+    return std::make_unique<IntResponse>(length);
+}
+
+std::vector<std::string> ZStoreJob::get_changed_keys() {
+    return { dest };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../background-jobs/BackgroundJobs.hpp"
+#include "../sorted-set/SortedSet.hpp"
+
+/* Set operation computed by a ZStoreJob */
+enum class ZStoreOp {
+    UNION, // zunionstore
+    INTER, // zinterstore
+    DIFF // zdiffstore
+};
+
+/* How the weighted scores of a name found in several sorted sets are combined */
+enum class ZAggregate {
+    SUM,
+    MIN,
+    MAX
+};
+
+/**
+ * Job for zunionstore, zinterstore, and zdiffstore: merges Snapshots of the source sorted sets into a new sorted set,
+ * then stores it at the destination key in one step.
+ * 
+ * The merge only reads the Snapshots, so it can run on a thread pool worker while the event loop keeps changing the
+ * source sets. The result is built off the event loop as well, and installed in O(1) by finish().
+ */
+class ZStoreJob : public BackgroundJob {
+    private:
+        ZStoreOp op;
+        std::string dest;
+        std::vector<SortedSet::Snapshot *> sources;
+        std::vector<double> weights; // one per source, unused by DIFF
+        ZAggregate aggregate;
+        SortedSet *result = NULL; // set by run()
+
+        /**
+         * Computes the pairs of the result.
+         * 
+         * @return  Vector containing the pairs, from low to high. Names point into the Snapshots.
+         */
+        std::vector<SPairView> merge();
+    public:
+        /**
+         * Initializes a ZStoreJob.
+         * 
+         * @param op        The set operation.
+         * @param dest      The key to store the result at.
+         * @param sources   Snapshots of the source sorted sets, with an empty Snapshot for each missing key. Deleted
+         *                  with the job.
+         * @param weights   The weight each source's scores are multiplied by, one per source.
+         * @param aggregate How the scores of a name found in several sources are combined.
+         */
+        ZStoreJob(ZStoreOp op, const std::string &dest, const std::vector<SortedSet::Snapshot *> &sources,
+                  const std::vector<double> &weights, ZAggregate aggregate);
+
+        ~ZStoreJob();
+
+        /* Returns the total number of pairs in the sources */
+        uint64_t input_size();
+
+        /* Merges the sources into the result */
+        void run() override;
+
+        /**
+         * Replaces the destination key with the result, or deletes it if the result is empty.
+         * 
+         * @return  IntResponse: the number of pairs in the result.
+         */
+        std::unique_ptr<Response> finish(HMap &kv_store, TimerManager &timers, ThreadPool &thread_pool,
+                                         Evictor &evictor) override;
+
+        /* Returns the destination key */
+        std::vector<std::string> get_changed_keys() override;
+};
@@ -0,0 +1,207 @@
+#include <assert.h>
+#include <cmath>
+
+#include "../ZStoreJob.hpp"
+#include "../../entry/Entry.hpp"
+#include "../../response/types/IntResponse.hpp"
+#include "../../utils/hash_utils.hpp"
+#include "../../utils/intrusive_data_structure_utils.hpp"
+
+TimerManager timers;
+ThreadPool thread_pool(1);
+Evictor evictor;
+
+/**
+ * Runs a ZStoreJob over the given sets and stores the result at "dest".
+ * 
+ * @param op        The set operation.
+ * @param sets      The source sets.
+ * @param weights   The weight of each source.
+ * @param aggregate How scores are combined.
+ * @param kv_store  Reference to the kv store to store the result in.
+ * 
+ * @return  The number of pairs in the result.
+ */
+int64_t run_job(ZStoreOp op, std::vector<SortedSet *> sets, std::vector<double> weights, ZAggregate aggregate, 
+                HMap &kv_store) {
+    std::vector<SortedSet::Snapshot *> sources;
+    for (SortedSet *set : sets) {
+        sources.push_back(set->snapshot());
+    }
+
+    ZStoreJob job(op, "dest", sources, weights, aggregate);
+    job.run();
+    std::unique_ptr<Response> response = job.finish(kv_store, timers, thread_pool, evictor);
+
+    IntResponse *count = (IntResponse *) response.get();
+    return count->get_int();
+}
+
+/**
+ * Gets the sorted set stored at "dest".
+ * 
+ * @param kv_store  Reference to the kv store.
+ * 
+ * @return  Pointer to the sorted set.
+ *          NULL if "dest" doesn't exist.
+ */
+SortedSet *get_dest(HMap &kv_store) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = "dest";
+    lookup_entry.node.hval = str_hash("dest");
+    HNode *node = kv_store.lookup(&lookup_entry.node, are_entries_equal);
+    return node == NULL ? NULL : &container_of(node, Entry, node)->zset;
+}
+
+/**
+ * Deletes the entry stored at "dest", if any.
+ * 
+ * @param kv_store  Reference to the kv store.
+ */
+void clear_dest(HMap &kv_store) {
+    LookupEntry lookup_entry;
+    lookup_entry.key = "dest";
+    lookup_entry.node.hval = str_hash("dest");
+    HNode *node = kv_store.remove(&lookup_entry.node, are_entries_equal);
+    if (node != NULL) {
+        delete_entry(container_of(node, Entry, node), &timers, &thread_pool);
+    }
+}
+
+/**
+ * Gets the score of a name in a set.
+ * 
+ * @param set   Pointer to the set.
+ * @param name  The name.
+ * 
+ * @return  The score, NaN if the name isn't in the set.
+ */
+double score_of(SortedSet *set, const std::string &name) {
+    double score;
+    return set->lookup(name.data(), name.length(), &score) ? score : NAN;
+}
+
+void test_union_with_weights() {
+    HMap kv_store;
+    SortedSet set1, set2;
+    set1.insert(1, "a", 1);
+    set1.insert(2, "b", 1);
+    set2.insert(10, "b", 1);
+    set2.insert(20, "c", 1);
+
+    assert(run_job(ZStoreOp::UNION, { &set1, &set2 }, { 3, 1 }, ZAggregate::SUM, kv_store) == 3);
+
+    SortedSet *dest = get_dest(kv_store);
+    assert(score_of(dest, "a") == 3);
+    assert(score_of(dest, "b") == 16);
+    assert(score_of(dest, "c") == 20);
+    clear_dest(kv_store);
+}
+
+void test_union_aggregate_min_max() {
+    HMap kv_store;
+    SortedSet set1, set2;
+    set1.insert(1, "a", 1);
+    set2.insert(5, "a", 1);
+
+    run_job(ZStoreOp::UNION, { &set1, &set2 }, { 1, 1 }, ZAggregate::MIN, kv_store);
+    assert(score_of(get_dest(kv_store), "a") == 1);
+
+    run_job(ZStoreOp::UNION, { &set1, &set2 }, { 1, 1 }, ZAggregate::MAX, kv_store);
+    assert(score_of(get_dest(kv_store), "a") == 5);
+    clear_dest(kv_store);
+}
+
+void test_nan_scores_become_zero() {
+    HMap kv_store;
+    SortedSet set1, set2;
+    set1.insert(INFINITY, "a", 1);
+    set2.insert(-INFINITY, "a", 1);
+    set2.insert(INFINITY, "b", 1);
+
+    // inf + -inf and inf * 0 are both taken to be 0
+    run_job(ZStoreOp::UNION, { &set1, &set2 }, { 1, 1 }, ZAggregate::SUM, kv_store);
+    assert(score_of(get_dest(kv_store), "a") == 0);
+
+    run_job(ZStoreOp::UNION, { &set2 }, { 0 }, ZAggregate::SUM, kv_store);
+    assert(score_of(get_dest(kv_store), "b") == 0);
+    clear_dest(kv_store);
+}
+
+void test_inter() {
+    HMap kv_store;
+    SortedSet set1, set2, set3;
+    for (uint32_t i = 0; i < 100; i++) {
+        std::string name = std::to_string(i);
+        set1.insert(i, name.data(), name.length());
+        if (i % 2 == 0) {
+            set2.insert(1, name.data(), name.length());
+        }
+        if (i % 3 == 0) {
+            set3.insert(1, name.data(), name.length());
+        }
+    }
+
+    // multiples of 6 below 100
+    assert(run_job(ZStoreOp::INTER, { &set1, &set2, &set3 }, { 1, 1, 1 }, ZAggregate::SUM, kv_store) == 17);
+    assert(score_of(get_dest(kv_store), "6") == 8);
+    assert(std::isnan(score_of(get_dest(kv_store), "4")));
+    clear_dest(kv_store);
+}
+
+void test_diff() {
+    HMap kv_store;
+    SortedSet set1, set2;
+    set1.insert(1, "a", 1);
+    set1.insert(2, "b", 1);
+    set1.insert(3, "c", 1);
+    set2.insert(10, "b", 1);
+
+    assert(run_job(ZStoreOp::DIFF, { &set1, &set2 }, { 1, 1 }, ZAggregate::SUM, kv_store) == 2);
+    assert(score_of(get_dest(kv_store), "a") == 1);
+    assert(score_of(get_dest(kv_store), "c") == 3);
+    clear_dest(kv_store);
+}
+
+void test_empty_result_deletes_dest() {
+    HMap kv_store;
+    SortedSet set1, set2;
+    set1.insert(1, "a", 1);
+    set2.insert(1, "b", 1);
+
+    run_job(ZStoreOp::UNION, { &set1 }, { 1 }, ZAggregate::SUM, kv_store);
+    assert(get_dest(kv_store) != NULL);
+
+    assert(run_job(ZStoreOp::INTER, { &set1, &set2 }, { 1, 1 }, ZAggregate::SUM, kv_store) == 0);
+    assert(get_dest(kv_store) == NULL);
+}
+
+void test_large_result_is_indexed() {
+    HMap kv_store;
+    SortedSet set;
+    for (uint32_t i = 0; i < LARGE_ZSET_SIZE; i++) {
+        std::string name = "name" + std::to_string(i);
+        set.insert(LARGE_ZSET_SIZE - i, name.data(), name.length());
+    }
+
+    assert(run_job(ZStoreOp::UNION, { &set }, { 2 }, ZAggregate::SUM, kv_store) == LARGE_ZSET_SIZE);
+
+    SortedSet *dest = get_dest(kv_store);
+    assert(dest->length() == LARGE_ZSET_SIZE);
+    assert(score_of(dest, "name0") == 2 * LARGE_ZSET_SIZE);
+    std::vector<SPairView> lowest = dest->range_by_rank(0, 0);
+    assert(lowest.size() == 1 && lowest[0].score == 2);
+    clear_dest(kv_store);
+}
+
+int main() {
+    test_union_with_weights();
+    test_union_aggregate_min_max();
+    test_nan_scores_become_zero();
+    test_inter();
+    test_diff();
+    test_empty_result_deletes_dest();
+    test_large_result_is_indexed();
+
+    return 0;
+}